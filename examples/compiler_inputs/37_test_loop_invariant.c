@@ -0,0 +1,21 @@
+int sum(int n, int k) {
+    int s = 0;
+    int i = 0;
+    while (i < n) {
+        int j = 0;
+        while (j < n) {
+            if (j == i) {
+                j = j + 1;
+                continue;
+            }
+            s = s + i * k + j * 3 + (n * k - 1) / 2;
+            j = j + 1;
+        }
+        i = i + 1;
+    }
+    return s;
+}
+
+int main() {
+    return sum(6, 5) % 256;
+}
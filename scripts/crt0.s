@@ -5,15 +5,25 @@
 # - QEMU 用户模式启动时会提供有效且 16 字节对齐的栈指针
 # - 不需要额外分配栈空间，main 函数会管理自己的栈帧
 # - 使用 Linux RISC-V 系统调用约定退出
+# - 与 profile_rt.s 一起链接时，退出前调用 __toyc_prof_dump 写出剖析数据（弱引用，未链接时跳过）
 
     .text
     .globl _start
+    .weak __toyc_prof_dump
 
 _start:
     # 直接调用 main 函数
     # QEMU 用户模式已提供有效的 sp，无需额外分配
     call    main
-    
+
+    # 插桩程序：保存退出码，写出 toyc.profraw
+    lui     t0, %hi(__toyc_prof_dump)
+    addi    t0, t0, %lo(__toyc_prof_dump)
+    beqz    t0, 1f
+    mv      s1, a0
+    jalr    t0
+    mv      a0, s1
+1:
     # main 返回后，返回值在 a0 中
     # 使用 Linux RISC-V exit 系统调用
     # a0 = 退出码（已由 main 设置）
@@ -9,6 +9,8 @@ set -eu
 
 SRC_DIR="${1:-examples/compiler_inputs}"
 OUT_DIR="test/asm"
+# 目标指令集（RV_ARCH=rv32imc 时 ToyC 输出压缩指令，与 verify_output.sh 保持一致）
+RV_ARCH="${RV_ARCH:-rv32im}"
 
 # ---------- 查找 ToyC 可执行文件 ----------
 TOYC=""
@@ -30,6 +32,12 @@ fi
 
 mkdir -p "$OUT_DIR"
 
+# ---------- ToyC 批量编译（单进程、多线程，避免逐文件启动进程） ----------
+BATCH_LOG="$(mktemp)"
+trap 'rm -f "$BATCH_LOG"' EXIT
+"$TOYC" --batch "$SRC_DIR" -o "$OUT_DIR" --suffix _toyc -j 0 --march="$RV_ARCH" \
+  >"$BATCH_LOG" 2>/dev/null || true
+
 TOTAL=0; OK=0; FAIL=0
 
 for c in "$SRC_DIR"/*.c; do
@@ -39,8 +47,8 @@ for c in "$SRC_DIR"/*.c; do
   TOTAL=$((TOTAL + 1))
   echo ">>> $base"
 
-  # 1. ToyC → asm（使用 -o 将汇编写入文件）
-  if "$TOYC" "$c" -o "$OUT_DIR/${base}_toyc.s" 2>/dev/null; then
+  # 1. ToyC → asm（批量编译的结果）
+  if grep -qF -- "-> $OUT_DIR/${base}_toyc.s" "$BATCH_LOG"; then
     echo "  ToyC  → $OUT_DIR/${base}_toyc.s"
   else
     echo "  ToyC  → FAILED"
@@ -50,7 +58,7 @@ for c in "$SRC_DIR"/*.c; do
 
   # 2. Clang → asm（需安装 clang + RISC-V 后端）
   if command -v clang >/dev/null 2>&1; then
-    if clang -S --target=riscv32-unknown-elf -march=rv32im -mabi=ilp32 \
+    if clang -S --target=riscv32-unknown-elf -march="$RV_ARCH" -mabi=ilp32 \
          -O0 "$c" -o "$OUT_DIR/${base}_clang.s" 2>/dev/null; then
       echo "  Clang → $OUT_DIR/${base}_clang.s"
     else
@@ -0,0 +1,83 @@
+#!/usr/bin/env bash
+# perf_check.sh — 生成代码性能回归检查：在内置模拟器 toyc_sim 上运行 ToyC 与 Clang -O2 的目标文件，
+# 比较动态指令数、栈区访存（溢出 / 保存恢复）与代码大小，并与检入的基线比较
+#
+# 用法:  bash scripts/perf_check.sh [源目录]                    # 与基线比较，回归时返回 1
+#        UPDATE_BASELINE=1 bash scripts/perf_check.sh [源目录]  # 重新生成基线
+# 默认:  examples/compiler_inputs
+#
+# 环境变量:
+#   TOYC_FLAGS      ToyC 的编译选项（默认 -O2；基线按此选项生成）
+#   RV_ARCH         目标指令集（默认 rv32im，同时传给 ToyC 与 Clang）
+#   BASELINE        基线文件（默认 examples/perf_baseline.json）
+#   PERF_THRESHOLD  允许的增加比例（默认 0.02）
+#   TOYC / TOYC_PERF  可执行文件路径（默认在 ./build 等目录中查找）
+# 没有安装 Clang（或其不支持 RISC-V）时只测量 ToyC，与 Clang 的比值取自基线中记录的数据
+
+set -eu
+[[ -n "${BASH_VERSION:-}" ]] && set -o pipefail
+
+SRC_DIR="${1:-examples/compiler_inputs}"
+OUT_DIR="test/perf"
+TOYC_FLAGS="${TOYC_FLAGS:--O2}"
+RV_ARCH="${RV_ARCH:-rv32im}"
+BASELINE="${BASELINE:-examples/perf_baseline.json}"
+PERF_THRESHOLD="${PERF_THRESHOLD:-0.02}"
+
+# ---------- 查找 ToyC 与 toyc_perf 可执行文件 ----------
+find_tool() {
+  local name="$1" candidate
+  for candidate in "./build-linux/$name" "./build/$name" "./build/$name.exe" "./$name"; do
+    [[ -f "$candidate" ]] && { echo "$candidate"; return 0; }
+  done
+  return 1
+}
+TOYC="${TOYC:-$(find_tool toyc || true)}"
+TOYC_PERF="${TOYC_PERF:-$(find_tool toyc_perf || true)}"
+if [[ -z "$TOYC" ]] || [[ -z "$TOYC_PERF" ]]; then
+  echo "Error: toyc / toyc_perf not found (searched ./build/ and ./)"
+  echo "Please run 'cmake --build build' first."
+  exit 1
+fi
+
+if [[ ! -d "$SRC_DIR" ]]; then
+  echo "Error: Source directory '$SRC_DIR' does not exist"
+  exit 1
+fi
+
+mkdir -p "$OUT_DIR"
+rm -f "$OUT_DIR"/*_toyc.o "$OUT_DIR"/*_clang.o
+
+# ---------- ToyC 批量编译为目标文件（代码字节数与链接后一致） ----------
+# shellcheck disable=SC2086
+"$TOYC" --batch "$SRC_DIR" -o "$OUT_DIR" --suffix _toyc -c -j 0 --march="$RV_ARCH" $TOYC_FLAGS \
+  >/dev/null 2>&1 || echo "Warning: some files failed to compile with ToyC"
+
+# ---------- Clang -O2 参考（-mno-relax：不依赖链接器松弛，代码字节数即最终大小） ----------
+HAVE_CLANG=false
+if command -v clang >/dev/null 2>&1 &&
+   clang --target=riscv32-unknown-elf -march="$RV_ARCH" -mabi=ilp32 -c -x c /dev/null \
+     -o /dev/null 2>/dev/null; then
+  HAVE_CLANG=true
+  for c in "$SRC_DIR"/*.c; do
+    [[ -f "$c" ]] || continue
+    base="$(basename "$c" .c)"
+    clang --target=riscv32-unknown-elf -march="$RV_ARCH" -mabi=ilp32 -mno-relax -O2 \
+      -c "$c" -o "$OUT_DIR/${base}_clang.o" 2>/dev/null ||
+      echo "Warning: clang failed on $base"
+  done
+else
+  echo "Note: Clang with RISC-V support not found, using reference data from $BASELINE"
+fi
+
+# ---------- 测量与比较 ----------
+if [[ "${UPDATE_BASELINE:-0}" == 1 ]]; then
+  if [[ "$HAVE_CLANG" != true ]]; then
+    echo "Warning: baseline written without Clang reference data"
+  fi
+  "$TOYC_PERF" "$OUT_DIR" --json "$BASELINE"
+  echo "Baseline written to $BASELINE"
+else
+  "$TOYC_PERF" "$OUT_DIR" --json "$OUT_DIR/perf.json" --compare "$BASELINE" \
+    --threshold "$PERF_THRESHOLD"
+fi
@@ -0,0 +1,59 @@
+# ToyC 剖析运行时（--profile-generate）
+# 与 crt0.s、插桩汇编一起链接，main 返回后由 _start 调用
+#
+# 说明：
+# - 插桩函数把剖析记录（计数器个数 | 名字表 | 计数器）放在 toyc_prof 段，
+#   链接器把各目标文件的 toyc_prof 段首尾相接，并定义 __start_toyc_prof / __stop_toyc_prof
+# - __toyc_prof_dump 把整段原样写入当前目录下的 toyc.profraw（覆盖旧文件），
+#   供 toyc --profile-use=toyc.profraw 读取；没有插桩代码时段为空，不创建文件
+# - 使用 Linux RISC-V 系统调用：openat = 56，write = 64，close = 57
+
+    .text
+    .globl  __toyc_prof_dump
+    .weak   __start_toyc_prof
+    .weak   __stop_toyc_prof
+
+__toyc_prof_dump:
+    addi    sp, sp, -16
+    sw      ra, 12(sp)
+    sw      s0, 8(sp)
+    sw      s1, 4(sp)
+
+    # s0 = 段起始地址，s1 = 段长度
+    lui     s0, %hi(__start_toyc_prof)
+    addi    s0, s0, %lo(__start_toyc_prof)
+    lui     s1, %hi(__stop_toyc_prof)
+    addi    s1, s1, %lo(__stop_toyc_prof)
+    sub     s1, s1, s0
+    beqz    s1, .Ldone
+
+    # fd = openat(AT_FDCWD, "toyc.profraw", O_WRONLY | O_CREAT | O_TRUNC, 0644)
+    li      a0, -100
+    lui     a1, %hi(.Lpath)
+    addi    a1, a1, %lo(.Lpath)
+    li      a2, 0x241
+    li      a3, 0644
+    li      a7, 56
+    ecall
+    bltz    a0, .Ldone
+
+    # write(fd, 段起始地址, 段长度); close(fd)
+    sw      a0, 0(sp)
+    mv      a1, s0
+    mv      a2, s1
+    li      a7, 64
+    ecall
+    lw      a0, 0(sp)
+    li      a7, 57
+    ecall
+
+.Ldone:
+    lw      s1, 4(sp)
+    lw      s0, 8(sp)
+    lw      ra, 12(sp)
+    addi    sp, sp, 16
+    ret
+
+    .section .rodata
+.Lpath:
+    .asciz  "toyc.profraw"
@@ -1,6 +1,7 @@
 #!/usr/bin/env bash
 
 # 结果验证脚本：编译运行 ToyC 和 Clang 生成的汇编，对比输出结果
+# 用法: verify_output.sh [-j N] [源目录] [单个文件]（-j 0 使用全部 CPU）
 # 支持两种运行方式:
 #   - Linux/WSL: Clang 汇编/链接 + QEMU 用户模式
 #   - macOS:     riscv64-unknown-elf-gcc 汇编/链接 + spike + pk (rv32)
@@ -10,6 +11,23 @@ if [[ -n "${BASH_VERSION:-}" ]]; then
     set -o pipefail
 fi
 
+# 并行验证：-j N（或环境变量 JOBS）同时验证 N 个测试，各测试的输出先写入日志，按文件顺序输出
+JOBS="${JOBS:-1}"
+while [[ $# -gt 0 ]]; do
+  case "$1" in
+    -j) JOBS="${2:-}"; shift; [[ $# -gt 0 ]] && shift ;;
+    -j*) JOBS="${1#-j}"; shift ;;
+    *) break ;;
+  esac
+done
+if ! [[ "$JOBS" =~ ^[0-9]+$ ]]; then
+  echo "Error: Invalid job count '$JOBS'"
+  exit 1
+fi
+if [[ "$JOBS" -eq 0 ]]; then
+  JOBS="$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)"
+fi
+
 # 支持通过参数指定源目录，默认为 examples/compiler_inputs
 SRC_DIR="${1:-examples/compiler_inputs}"
 # 支持指定单个文件进行测试
@@ -29,8 +47,8 @@ if [[ ! -d "$ASM_DIR" ]]; then
   exit 1
 fi
 
-# RISC-V 架构参数
-RV_ARCH="rv32im"
+# RISC-V 架构参数（RV_ARCH=rv32imc 时验证 --march=rv32imc 生成的压缩指令汇编）
+RV_ARCH="${RV_ARCH:-rv32im}"
 RV_ABI="ilp32"
 CLANG_TARGET="riscv32-unknown-elf"
 
@@ -234,60 +252,45 @@ else
   TEST_FILES=("$SRC_DIR"/*.c)
 fi
 
-# 遍历所有测试文件
-for c_file in "${TEST_FILES[@]}"; do
-  # 跳过不存在的情况
-  if [[ ! -f "$c_file" ]]; then
-    echo "No .c files found in $SRC_DIR"
-    exit 0
-  fi
-  
+# ========== 验证单个测试：输出日志，返回 0 通过 / 1 失败 / 2 跳过 ==========
+verify_one() {
+  local c_file="$1"
+  local base toyc_asm clang_asm toyc_exe clang_exe
+  local toyc_output toyc_exitcode clang_output clang_exitcode
   base="$(basename "$c_file" .c)"
   toyc_asm="$ASM_DIR/${base}_toyc.s"
   clang_asm="$ASM_DIR/${base}_clang.s"
   
-  TOTAL=$((TOTAL + 1))
-  
   # 检查汇编文件是否存在且不为空
   if [[ ! -f "$toyc_asm" ]] || [[ ! -s "$toyc_asm" ]]; then
     echo "─────────────────────────────────────────"
     echo "Testing: $base"
     echo "  ⚠ SKIPPED: ToyC assembly not found or empty (compilation failed)"
-    SKIPPED=$((SKIPPED + 1))
-    continue
+    return 2
   fi
   
   if [[ ! -f "$clang_asm" ]] || [[ ! -s "$clang_asm" ]]; then
     echo "─────────────────────────────────────────"
     echo "Testing: $base"
     echo "  ⚠ SKIPPED: Clang assembly not found or empty (reference missing)"
-    SKIPPED=$((SKIPPED + 1))
-    continue
+    return 2
   fi
   
   echo "─────────────────────────────────────────"
   echo "Testing: $base"
   
-  # 构建链接参数（如果有 libgcc 则添加）
-  LINK_LIBS=""
-  if [[ -n "$LIBGCC_PATH" ]]; then
-    LINK_LIBS="$LIBGCC_PATH"
-  fi
-  
   # 编译 ToyC 生成的汇编
   toyc_exe="$TEMP_DIR/${base}_toyc"
   if ! link_asm "$toyc_asm" "$toyc_exe"; then
     echo "  ❌ ToyC assembly compilation failed"
-    FAILED=$((FAILED + 1))
-    continue
+    return 1
   fi
   
   # 编译 Clang 生成的汇编
   clang_exe="$TEMP_DIR/${base}_clang"
   if ! link_asm "$clang_asm" "$clang_exe"; then
     echo "  ❌ Clang assembly compilation failed"
-    FAILED=$((FAILED + 1))
-    continue
+    return 1
   fi
   
   # 运行 ToyC 生成的可执行文件
@@ -322,20 +325,72 @@ for c_file in "${TEST_FILES[@]}"; do
   # 判断是否一致
   if [[ "$toyc_exitcode" -eq "$clang_exitcode" ]] && [[ "$toyc_output" == "$clang_output" ]]; then
     echo "  ✅ Result: CORRECT"
-    PASSED=$((PASSED + 1))
-  else
-    echo "  ❌ Result: INCORRECT"
-    if [[ "$toyc_exitcode" -ne "$clang_exitcode" ]]; then
-      echo "     Exit code mismatch: expected $clang_exitcode, got $toyc_exitcode"
-    fi
-    if [[ "$toyc_output" != "$clang_output" ]]; then
-      echo "     Output mismatch"
-      echo "     Expected: '$clang_output'"
-      echo "     Got:      '$toyc_output'"
-    fi
-    FAILED=$((FAILED + 1))
+    return 0
   fi
-done
+  echo "  ❌ Result: INCORRECT"
+  if [[ "$toyc_exitcode" -ne "$clang_exitcode" ]]; then
+    echo "     Exit code mismatch: expected $clang_exitcode, got $toyc_exitcode"
+  fi
+  if [[ "$toyc_output" != "$clang_output" ]]; then
+    echo "     Output mismatch"
+    echo "     Expected: '$clang_output'"
+    echo "     Got:      '$toyc_output'"
+  fi
+  return 1
+}
+
+# record_result：按 verify_one 的返回值累计
+record_result() {
+  case "$1" in
+    0) PASSED=$((PASSED + 1)) ;;
+    2) SKIPPED=$((SKIPPED + 1)) ;;
+    *) FAILED=$((FAILED + 1)) ;;
+  esac
+}
+
+if [[ ! -f "${TEST_FILES[0]}" ]]; then
+  echo "No .c files found in $SRC_DIR"
+  exit 0
+fi
+
+if [[ "$JOBS" -le 1 ]]; then
+  # 串行：逐个验证并直接输出
+  for c_file in "${TEST_FILES[@]}"; do
+    TOTAL=$((TOTAL + 1))
+    rc=0
+    verify_one "$c_file" || rc=$?
+    record_result "$rc"
+  done
+else
+  # 并行：每个测试在后台子 shell 中验证，日志与返回值写入 LOG_DIR/<序号>；
+  # 在途数达到 JOBS 时等待最早启动的一个并输出它的日志，输出顺序与串行相同
+  LOG_DIR="$TEMP_DIR/logs"
+  mkdir -p "$LOG_DIR"
+  rm -f "$LOG_DIR"/*.log "$LOG_DIR"/*.status
+  PIDS=()
+  NEXT=0
+  flush_oldest() {
+    wait "${PIDS[$NEXT]}" || true
+    cat "$LOG_DIR/$NEXT.log"
+    record_result "$(cat "$LOG_DIR/$NEXT.status" 2>/dev/null || echo 1)"
+    NEXT=$((NEXT + 1))
+  }
+  for c_file in "${TEST_FILES[@]}"; do
+    (
+      rc=0
+      verify_one "$c_file" > "$LOG_DIR/$TOTAL.log" 2>&1 || rc=$?
+      echo "$rc" > "$LOG_DIR/$TOTAL.status"
+    ) &
+    PIDS[$TOTAL]=$!
+    TOTAL=$((TOTAL + 1))
+    if [[ $((TOTAL - NEXT)) -ge "$JOBS" ]]; then
+      flush_oldest
+    fi
+  done
+  while [[ "$NEXT" -lt "$TOTAL" ]]; do
+    flush_oldest
+  done
+fi
 
 echo "========================================="
 echo "  Verification Summary"
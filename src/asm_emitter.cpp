@@ -0,0 +1,33 @@
+#include "asm_emitter.h"
+
+namespace toyc {
+
+// directive：模块级伪指令直接写入输出流
+void AsmEmitter::directive(std::string_view text) { os_ << "    " << text << '\n'; }
+
+// beginFunction：清空片段缓冲区（保留缓冲区容量）
+void AsmEmitter::beginFunction() { fragment_.clear(); }
+
+// instr：追加一条带 4 空格缩进的汇编指令
+void AsmEmitter::instr(std::string_view line) {
+    fragment_.append("    ");
+    fragment_.append(line);
+    fragment_.push_back('\n');
+}
+
+// label：追加一个标签行
+void AsmEmitter::label(std::string_view name) {
+    fragment_.append(name);
+    fragment_.append(":\n");
+}
+
+// raw：追加原样文本
+void AsmEmitter::raw(std::string_view text) { fragment_.append(text); }
+
+// finishFunction：将当前函数片段一次性写入输出流
+void AsmEmitter::finishFunction() {
+    os_.write(fragment_.data(), static_cast<std::streamsize>(fragment_.size()));
+    fragment_.clear();
+}
+
+} // namespace toyc
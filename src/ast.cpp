@@ -7,6 +7,52 @@ static void printIndent(int level, std::ostream &os) {
         os << "  ";
 }
 
+// spelling：二元运算符的源码拼写
+const char *spelling(BinaryOp op) {
+    switch (op) {
+    case BinaryOp::Add:
+        return "+";
+    case BinaryOp::Sub:
+        return "-";
+    case BinaryOp::Mul:
+        return "*";
+    case BinaryOp::Div:
+        return "/";
+    case BinaryOp::Mod:
+        return "%";
+    case BinaryOp::Lt:
+        return "<";
+    case BinaryOp::Gt:
+        return ">";
+    case BinaryOp::Le:
+        return "<=";
+    case BinaryOp::Ge:
+        return ">=";
+    case BinaryOp::Eq:
+        return "==";
+    case BinaryOp::Ne:
+        return "!=";
+    case BinaryOp::And:
+        return "&&";
+    case BinaryOp::Or:
+        return "||";
+    }
+    return "?";
+}
+
+// spelling：一元运算符的源码拼写
+const char *spelling(UnaryOp op) {
+    switch (op) {
+    case UnaryOp::Plus:
+        return "+";
+    case UnaryOp::Minus:
+        return "-";
+    case UnaryOp::Not:
+        return "!";
+    }
+    return "?";
+}
+
 // NumberExpr 打印实现：输出 Number(value)，value 为数字字面量
 void NumberExpr::print(int level, std::ostream &os) const {
     printIndent(level, os);
@@ -24,7 +70,7 @@ void IdentifierExpr::print(int level, std::ostream &os) const {
 // 2. 递归打印 lhs 和 rhs，缩进层级加 1
 void BinaryExpr::print(int level, std::ostream &os) const {
     printIndent(level, os);
-    os << "Binary(" << op << ")\n";
+    os << "Binary(" << spelling(op) << ")\n";
     lhs->print(level + 1, os);
     rhs->print(level + 1, os);
 }
@@ -32,7 +78,7 @@ void BinaryExpr::print(int level, std::ostream &os) const {
 // UnaryExpr 打印实现：输出 Unary(op)，然后打印子表达式，缩进层级加 1
 void UnaryExpr::print(int level, std::ostream &os) const {
     printIndent(level, os);
-    os << "Unary(" << op << ")\n";
+    os << "Unary(" << spelling(op) << ")\n";
     expr->print(level + 1, os);
 }
 
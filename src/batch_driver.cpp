@@ -0,0 +1,258 @@
+#include "batch_driver.h"
+#include "codegen_cache.h"
+#include "ir_builder.h"
+#include "ir_parser.h"
+#include "ir_passes.h"
+#include "parser.h"
+#include "riscv_codegen.h"
+#include "source_buffer.h"
+#include "statistics.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace toyc {
+
+#pragma region 输入展开
+
+namespace {
+
+// isSourceFile：批量模式识别的输入扩展名
+bool isSourceFile(const fs::path &p) {
+    auto ext = p.extension();
+    return ext == ".c" || ext == ".tc" || ext == ".ll";
+}
+
+void expandInput(const std::string &arg, std::vector<std::string> &out);
+
+// expandDirectory：目录中的源文件按文件名排序后追加
+void expandDirectory(const fs::path &dir, std::vector<std::string> &out) {
+    std::vector<std::string> files;
+    for (auto &entry : fs::directory_iterator(dir))
+        if (entry.is_regular_file() && isSourceFile(entry.path()))
+            files.push_back(entry.path().string());
+    std::sort(files.begin(), files.end());
+    out.insert(out.end(), files.begin(), files.end());
+}
+
+// expandListFile：@list 文件中每行一个路径
+void expandListFile(const std::string &listPath, std::vector<std::string> &out) {
+    std::ifstream ifs(listPath);
+    if (!ifs.is_open())
+        throw std::runtime_error("cannot open list file '" + listPath + "'");
+    std::string line;
+    while (std::getline(ifs, line)) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+        expandInput(line, out);
+    }
+}
+
+void expandInput(const std::string &arg, std::vector<std::string> &out) {
+    if (arg.size() > 1 && arg[0] == '@')
+        expandListFile(arg.substr(1), out);
+    else if (fs::is_directory(arg))
+        expandDirectory(arg, out);
+    else
+        out.push_back(arg);
+}
+
+} // namespace
+
+// collectBatchInputs：依次展开每个参数（目录 / @list / 文件）
+std::vector<std::string> collectBatchInputs(const std::vector<std::string> &args) {
+    std::vector<std::string> inputs;
+    for (const auto &arg : args)
+        expandInput(arg, inputs);
+    return inputs;
+}
+
+// batchOutputPath：outputDir（为空时取输入所在目录）/ 基本名 + suffix + 扩展名
+std::string batchOutputPath(const BatchOptions &opts, const std::string &input) {
+    fs::path in(input);
+    fs::path dir = opts.outputDir.empty() ? in.parent_path() : fs::path(opts.outputDir);
+    std::string name = in.stem().string() + opts.suffix + (opts.emitObject ? ".o" : ".s");
+    return (dir / name).string();
+}
+
+#pragma endregion
+
+#pragma region 单个翻译单元
+
+namespace {
+
+/**
+ * @brief 编译一个翻译单元并写出结果文件
+ * @param optLevel IR 优化级别
+ * @param inlineLimit 内联阈值
+ * @param regAlloc 寄存器分配算法
+ * @param schedule 指令调度的延迟模型（为空时不调度）
+ * @param compressed 输出 RV32C 压缩指令
+ * @param vectorize 优化后执行循环向量化（RVV）
+ * @param ipra  过程间寄存器分配
+ * @param omitFramePointer 省略帧指针，s0 参与分配
+ * @param pool  批量模式的线程池（为空时函数级代码生成在当前线程串行执行）
+ * @param cache 增量编译缓存（可为空）
+ * @details 失败时抛出异常（ParseError / std::runtime_error 等），并删除写了一半的输出文件
+ */
+void compileUnit(const std::string &input, const std::string &output, bool emitObject,
+                 int optLevel, int inlineLimit, RegAllocKind regAlloc,
+                 const std::optional<mir::LatencyModel> &schedule, bool compressed,
+                 bool vectorize, bool ipra, bool omitFramePointer, ThreadPool *pool,
+                 CodeGenCache *cache) {
+    SourceBuffer source = SourceBuffer::open(input); // 映射源码，Token 直接引用映射区
+
+    std::unique_ptr<ir::Module> mod;
+    if (fs::path(input).extension() == ".ll") {
+        IRParser parser;
+        mod = parser.parseModule(source.text());
+        if (!mod || mod->functions.empty())
+            throw std::runtime_error("failed to parse LLVM IR");
+    } else {
+        CompUnit unit;
+        {
+            stats::ScopedTimer timer(stats::Phase::Parse);
+            Parser parser(source.text());
+            unit = parser.parseCompUnit();
+        }
+        stats::ScopedTimer timer(stats::Phase::IRBuild);
+        IRBuilder builder;
+        mod = builder.buildModule(unit);
+    }
+    opt::optimizeModule(*mod, optLevel, inlineLimit);
+    if (vectorize)
+        opt::vectorizeLoops(*mod);
+
+    std::ofstream ofs(output, emitObject ? std::ios::binary : std::ios::out);
+    if (!ofs.is_open())
+        throw std::runtime_error("cannot open output file '" + output + "'");
+    try {
+        std::optional<RISCVCodeGen> gen;
+        if (pool)
+            gen.emplace(*pool);
+        else
+            gen.emplace(1);
+        gen->setCache(cache);
+        gen->setRegAlloc(regAlloc);
+        gen->setSchedule(schedule);
+        gen->setCompressed(compressed);
+        gen->setIPRA(ipra);
+        gen->setOmitFramePointer(omitFramePointer);
+        if (emitObject)
+            gen->generateObject(*mod, ofs);
+        else
+            gen->generate(*mod, ofs);
+    } catch (...) {
+        ofs.close();
+        std::error_code ec;
+        fs::remove(output, ec);
+        throw;
+    }
+}
+
+} // namespace
+
+#pragma endregion
+
+#pragma region 批量调度
+
+/**
+ * @brief 在一个进程内编译全部输入
+ * @details jobs <= 1 时在调用线程上依次编译；否则每个输入作为一个任务提交到工作窃取线程池，
+ *   调用线程按输入顺序等待并输出结果，日志顺序与线程调度无关
+ */
+int runBatch(const BatchOptions &opts, std::ostream &log) {
+    const size_t n = opts.inputs.size();
+    if (!opts.outputDir.empty()) {
+        std::error_code ec;
+        fs::create_directories(opts.outputDir, ec);
+    }
+
+    std::optional<CodeGenCache> cache;
+    if (!opts.cacheDir.empty())
+        cache.emplace(opts.cacheDir, std::string("regalloc=") + regAllocKindName(opts.regAlloc) +
+                                         (opts.compressed ? " march=rv32imc" : "") +
+                                         (opts.ipra ? " ipra" : "") +
+                                         (opts.omitFramePointer ? " omit-frame-pointer" : "") +
+                                         (opts.schedule ? " sched=" + opts.schedule->toString()
+                                                        : std::string()));
+
+    struct Slot {
+        std::string output;
+        std::string error; // 为空表示成功
+        bool done = false;
+    };
+    std::vector<Slot> slots(n);
+    for (size_t i = 0; i < n; ++i)
+        slots[i].output = batchOutputPath(opts, opts.inputs[i]);
+
+    auto runOne = [&](size_t i, ThreadPool *pool) {
+        std::string error;
+        try {
+            compileUnit(opts.inputs[i], slots[i].output, opts.emitObject, opts.optLevel,
+                        opts.inlineLimit, opts.regAlloc, opts.schedule, opts.compressed,
+                        opts.vectorize, opts.ipra, opts.omitFramePointer, pool,
+                        cache ? &*cache : nullptr);
+        } catch (const std::exception &e) {
+            error = e.what();
+            if (error.empty())
+                error = "unknown error";
+        }
+        return error;
+    };
+
+    int failures = 0;
+    auto report = [&](size_t i) {
+        if (slots[i].error.empty()) {
+            log << "OK   " << opts.inputs[i] << " -> " << slots[i].output << '\n';
+        } else {
+            log << "FAIL " << opts.inputs[i] << ": " << slots[i].error << '\n';
+            ++failures;
+        }
+    };
+
+    if (opts.jobs <= 1 || n <= 1) {
+        for (size_t i = 0; i < n; ++i) {
+            slots[i].error = runOne(i, nullptr);
+            report(i);
+        }
+    } else {
+        std::mutex mu;
+        std::condition_variable cv;
+        ThreadPool pool(opts.jobs);
+        for (size_t i = 0; i < n; ++i) {
+            pool.submit([&, i] {
+                std::string error = runOne(i, &pool);
+                std::lock_guard lock(mu);
+                slots[i].error = std::move(error);
+                slots[i].done = true;
+                cv.notify_all();
+            });
+        }
+        for (size_t i = 0; i < n; ++i) {
+            std::unique_lock lock(mu);
+            cv.wait(lock, [&] { return slots[i].done; });
+            report(i);
+        }
+    }
+
+    log << "Batch: " << (static_cast<int>(n) - failures) << "/" << n << " succeeded";
+    if (cache)
+        log << " (cache: " << cache->hits() << " hits, " << cache->misses() << " misses)";
+    log << '\n';
+    return failures;
+}
+
+#pragma endregion
+
+} // namespace toyc
@@ -0,0 +1,547 @@
+// ToyC 编译吞吐基准
+// 用合成程序生成器构造几类典型负载（深表达式、大量局部变量、多参数调用、大量函数、深层循环嵌套），
+// 对每类负载分阶段重复计时：
+//   parse → ir-build → ir-print → ir-parse → bir-read → regalloc → asm → obj，以及端到端的 total
+// 每个阶段输出 min / median / mean / stddev（毫秒）。--json 写出结果文件供 CI 保存，
+// --compare 与基线文件逐项比较中位数，变慢超过阈值时返回 1
+//
+// 生成器使用固定种子的 xorshift，同一 --scale 下生成的程序在所有平台上逐字节相同
+
+#include "ast.h"
+#include "ir.h"
+#include "ir_binary.h"
+#include "ir_builder.h"
+#include "ir_parser.h"
+#include "parser.h"
+#include "reg_alloc.h"
+#include "riscv_codegen.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+#pragma region 合成程序生成器
+
+namespace {
+
+// Rng：xorshift64（结果与标准库实现无关，保证生成的程序可复现）
+class Rng {
+  public:
+    explicit Rng(uint64_t seed) : state_(seed) {}
+    uint64_t next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_;
+    }
+    int below(int n) { return static_cast<int>(next() % static_cast<uint64_t>(n)); }
+
+  private:
+    uint64_t state_;
+};
+
+/**
+ * @brief 生成深度为 depth 的随机表达式
+ * @param vars 可引用的变量名
+ * @details 叶子为变量或小常量；内部节点为算术 / 比较 / 逻辑二元运算或一元运算，全部加括号。
+ *   除数与模数只用非零常量，生成的程序也可以运行
+ */
+void genExpr(std::string &out, Rng &rng, const std::vector<std::string> &vars, int depth) {
+    if (depth == 0) {
+        if (rng.below(3) == 0)
+            out += std::to_string(rng.below(100));
+        else
+            out += vars[rng.below(static_cast<int>(vars.size()))];
+        return;
+    }
+    static const char *const kOps[] = {"+", "-", "*", "<", ">", "<=", ">=", "==", "!=", "&&", "||"};
+    int pick = rng.below(14);
+    if (pick == 13) {
+        out += rng.below(2) ? "(-" : "(!";
+        genExpr(out, rng, vars, depth - 1);
+        out += ")";
+        return;
+    }
+    out += "(";
+    genExpr(out, rng, vars, depth - 1);
+    if (pick >= 11) {
+        out += pick == 11 ? " / " : " % ";
+        out += std::to_string(rng.below(9) + 1);
+    } else {
+        out += ' ';
+        out += kOps[pick];
+        out += ' ';
+        genExpr(out, rng, vars, depth - 1);
+    }
+    out += ")";
+}
+
+// paramList：生成 "int p0, int p1, ..." 与对应的变量名列表
+std::string paramList(int n, std::vector<std::string> &names) {
+    std::string s;
+    for (int i = 0; i < n; ++i) {
+        names.push_back("p" + std::to_string(i));
+        s += (i ? ", int " : "int ") + names.back();
+    }
+    return s;
+}
+
+// genDeepExpr：每个函数返回一棵深度约 12 的表达式树（数千个节点）
+std::string genDeepExpr(int scale) {
+    Rng rng(1);
+    std::string src;
+    const int funcs = 20 * scale;
+    for (int f = 0; f < funcs; ++f) {
+        std::vector<std::string> vars;
+        src += "int expr" + std::to_string(f) + "(" + paramList(3, vars) + ") {\n    return ";
+        genExpr(src, rng, vars, 12);
+        src += ";\n}\n\n";
+    }
+    src += "int main() {\n    int s = 0;\n";
+    for (int f = 0; f < funcs; ++f)
+        src += "    s = s + expr" + std::to_string(f) + "(s, 1, 2);\n";
+    src += "    return s;\n}\n";
+    return src;
+}
+
+// genManyVars：每个函数声明 150 个同时活跃的局部变量（寄存器压力与溢出）
+std::string genManyVars(int scale) {
+    Rng rng(2);
+    std::string src;
+    const int funcs = 20 * scale, vars = 150;
+    for (int f = 0; f < funcs; ++f) {
+        src += "int vars" + std::to_string(f) + "(int seed) {\n";
+        for (int v = 0; v < vars; ++v) {
+            src += "    int v" + std::to_string(v) + " = ";
+            src += v == 0 ? "seed" : "v" + std::to_string(rng.below(v));
+            src += " + " + std::to_string(rng.below(50)) + ";\n";
+        }
+        src += "    return v0";
+        for (int v = 1; v < vars; ++v)
+            src += (v % 2 ? " + v" : " - v") + std::to_string(v);
+        src += ";\n}\n\n";
+    }
+    src += "int main() {\n    int s = 0;\n";
+    for (int f = 0; f < funcs; ++f)
+        src += "    s = s + vars" + std::to_string(f) + "(" + std::to_string(f) + ");\n";
+    src += "    return s;\n}\n";
+    return src;
+}
+
+// genManyArgs：16 参数函数组成的调用链（超过 8 个参数的栈传参与 caller-saved 保存）
+std::string genManyArgs(int scale) {
+    std::string src;
+    const int funcs = 40 * scale, params = 16;
+    for (int f = 0; f < funcs; ++f) {
+        std::vector<std::string> names;
+        src += "int args" + std::to_string(f) + "(" + paramList(params, names) + ") {\n";
+        if (f == 0) {
+            src += "    return p0";
+            for (int i = 1; i < params; ++i)
+                src += (i % 3 ? " + p" : " - p") + std::to_string(i);
+            src += ";\n}\n\n";
+            continue;
+        }
+        src += "    int r = args" + std::to_string(f - 1) + "(";
+        for (int i = 0; i < params; ++i)
+            src += (i ? ", p" : "p") + std::to_string((i + f) % params);
+        src += ");\n    return r + p" + std::to_string(f % params) + ";\n}\n\n";
+    }
+    src += "int main() {\n    return args" + std::to_string(funcs - 1) + "(";
+    for (int i = 0; i < params; ++i)
+        src += (i ? ", " : "") + std::to_string(i);
+    src += ");\n}\n";
+    return src;
+}
+
+// genManyFuncs：大量小函数（函数级开销：建块、分配器初始化、prologue/epilogue）
+std::string genManyFuncs(int scale) {
+    Rng rng(4);
+    std::string src;
+    const int funcs = 1000 * scale;
+    for (int f = 0; f < funcs; ++f) {
+        src += "int fn" + std::to_string(f) + "(int x) {\n";
+        src += "    if (x > " + std::to_string(rng.below(100)) + ")\n";
+        src += "        return x - " + std::to_string(rng.below(10)) + ";\n";
+        src += "    return x * " + std::to_string(rng.below(10) + 1) + ";\n}\n\n";
+    }
+    src += "int main() {\n    int s = 0;\n";
+    for (int f = 0; f < funcs; ++f)
+        src += "    s = fn" + std::to_string(f) + "(s);\n";
+    src += "    return s;\n}\n";
+    return src;
+}
+
+// genDeepLoops：8 层嵌套 while，含 if / break / continue（控制流图与活跃性迭代）
+std::string genDeepLoops(int scale) {
+    Rng rng(5);
+    std::string src;
+    const int funcs = 20 * scale, depth = 8;
+    for (int f = 0; f < funcs; ++f) {
+        src += "int loops" + std::to_string(f) + "(int n) {\n    int s = 0;\n";
+        std::string indent = "    ";
+        for (int d = 0; d < depth; ++d) {
+            std::string i = "i" + std::to_string(d);
+            src += indent + "int " + i + " = 0;\n";
+            src += indent + "while (" + i + " < n) {\n";
+            indent += "    ";
+            src += indent + i + " = " + i + " + 1;\n";
+            switch (rng.below(3)) {
+            case 0:
+                src += indent + "if (" + i + " == " + std::to_string(rng.below(5) + 2) +
+                       ") continue;\n";
+                break;
+            case 1:
+                src += indent + "if (s > " + std::to_string(1000 + rng.below(1000)) +
+                       ") break;\n";
+                break;
+            default:
+                src += indent + "s = s + " + i + " % " + std::to_string(rng.below(7) + 2) + ";\n";
+                break;
+            }
+        }
+        src += indent + "s = s + 1;\n";
+        for (int d = depth; d > 0; --d) {
+            indent.resize(indent.size() - 4);
+            src += indent + "}\n";
+        }
+        src += "    return s;\n}\n\n";
+    }
+    src += "int main() {\n    int s = 0;\n";
+    for (int f = 0; f < funcs; ++f)
+        src += "    s = s + loops" + std::to_string(f) + "(3);\n";
+    src += "    return s;\n}\n";
+    return src;
+}
+
+struct Workload {
+    const char *name;
+    std::string (*generate)(int scale);
+};
+
+const Workload kWorkloads[] = {
+    {"deep_expr", genDeepExpr},   {"many_vars", genManyVars},   {"many_args", genManyArgs},
+    {"many_funcs", genManyFuncs}, {"deep_loops", genDeepLoops},
+};
+
+} // namespace
+
+#pragma endregion
+
+#pragma region 计时与统计
+
+namespace {
+
+// Sample：一个 (负载, 阶段) 的计时统计（毫秒）
+struct Sample {
+    std::string workload, stage;
+    double min = 0, median = 0, mean = 0, stddev = 0;
+};
+
+// measure：预热一次后重复 reps 次，返回统计量
+Sample measure(const std::string &workload, const std::string &stage, int reps,
+               const std::function<void()> &fn) {
+    fn();
+    std::vector<double> ms;
+    ms.reserve(reps);
+    for (int r = 0; r < reps; ++r) {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        auto t1 = std::chrono::steady_clock::now();
+        ms.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    std::sort(ms.begin(), ms.end());
+    Sample s{workload, stage};
+    s.min = ms.front();
+    s.median = ms.size() % 2 ? ms[ms.size() / 2] : (ms[ms.size() / 2 - 1] + ms[ms.size() / 2]) / 2;
+    for (double v : ms)
+        s.mean += v;
+    s.mean /= ms.size();
+    for (double v : ms)
+        s.stddev += (v - s.mean) * (v - s.mean);
+    s.stddev = ms.size() > 1 ? std::sqrt(s.stddev / (ms.size() - 1)) : 0;
+    return s;
+}
+
+// sink：防止编译器把结果未被使用的阶段整个优化掉
+volatile size_t gSink = 0;
+
+/**
+ * @brief 对一个负载运行全部阶段
+ * @details 每个阶段的输入由前一阶段预先准备好（只计本阶段的时间）；
+ *   regalloc 只做寄存器分配，asm / obj 包含分配 + 指令选择 + 输出，total 为源码到汇编的端到端时间
+ */
+std::vector<Sample> benchWorkload(const std::string &name, const std::string &src, int reps) {
+    std::vector<Sample> out;
+
+    Parser firstParser(src);
+    CompUnit unit = firstParser.parseCompUnit();
+    auto mod = toyc::IRBuilder().buildModule(unit);
+    const std::string irText = mod->toString();
+    std::ostringstream birStream;
+    toyc::writeBinaryIR(*mod, birStream);
+    const std::string bir = birStream.str();
+
+    out.push_back(measure(name, "parse", reps, [&] {
+        Parser parser(src);
+        gSink = gSink + parser.parseCompUnit().funcs.size();
+    }));
+    out.push_back(measure(name, "ir-build", reps, [&] {
+        gSink = gSink + toyc::IRBuilder().buildModule(unit)->functions.size();
+    }));
+    out.push_back(measure(name, "ir-print", reps, [&] { gSink = gSink + mod->toString().size(); }));
+    out.push_back(measure(name, "ir-parse", reps, [&] {
+        gSink = gSink + toyc::IRParser().parseModule(irText)->functions.size();
+    }));
+    out.push_back(measure(name, "bir-read", reps, [&] {
+        gSink = gSink + toyc::BinaryIRReader(bir).readModule()->functions.size();
+    }));
+    out.push_back(measure(name, "regalloc", reps, [&] {
+        for (auto &func : mod->functions) {
+            toyc::LinearScanAllocator allocator(toyc::RegInfo::shared());
+            gSink = gSink + allocator.allocate(*func).vregToPhys.size();
+        }
+    }));
+    out.push_back(measure(name, "asm", reps, [&] {
+        gSink = gSink + toyc::generateRISCVAssembly(*mod).size();
+    }));
+    out.push_back(measure(name, "obj", reps, [&] {
+        std::ostringstream os;
+        toyc::generateRISCVObject(*mod, os);
+        gSink = gSink + os.str().size();
+    }));
+    out.push_back(measure(name, "total", reps, [&] {
+        Parser parser(src);
+        CompUnit u = parser.parseCompUnit();
+        auto m = toyc::IRBuilder().buildModule(u);
+        gSink = gSink + toyc::generateRISCVAssembly(*m).size();
+    }));
+    return out;
+}
+
+} // namespace
+
+#pragma endregion
+
+#pragma region 结果输出与基线比较
+
+namespace {
+
+// printTable：人类可读的结果表
+void printTable(const std::vector<Sample> &samples) {
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-12s %-9s %10s %10s %10s %10s\n", "workload", "stage",
+                  "min(ms)", "median", "mean", "stddev");
+    std::cout << line;
+    for (const auto &s : samples) {
+        std::snprintf(line, sizeof(line), "%-12s %-9s %10.3f %10.3f %10.3f %10.3f\n",
+                      s.workload.c_str(), s.stage.c_str(), s.min, s.median, s.mean, s.stddev);
+        std::cout << line;
+    }
+}
+
+// writeJson：每个结果占一行，键顺序固定，便于 diff 与 readJson 读取
+void writeJson(std::ostream &os, const std::vector<Sample> &samples, int reps, int scale) {
+    char line[256];
+    os << "{\n  \"schema\": 1,\n  \"reps\": " << reps << ",\n  \"scale\": " << scale
+       << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const auto &s = samples[i];
+        std::snprintf(line, sizeof(line),
+                      "    {\"workload\": \"%s\", \"stage\": \"%s\", \"min_ms\": %.4f, "
+                      "\"median_ms\": %.4f, \"mean_ms\": %.4f, \"stddev_ms\": %.4f}%s\n",
+                      s.workload.c_str(), s.stage.c_str(), s.min, s.median, s.mean, s.stddev,
+                      i + 1 < samples.size() ? "," : "");
+        os << line;
+    }
+    os << "  ]\n}\n";
+}
+
+// jsonField：从 writeJson 写出的一行中取出字段的原始文本（找不到时返回空串）
+std::string jsonField(const std::string &line, const std::string &key) {
+    std::string pat = "\"" + key + "\": ";
+    size_t p = line.find(pat);
+    if (p == std::string::npos)
+        return {};
+    p += pat.size();
+    if (line[p] == '"') {
+        size_t e = line.find('"', p + 1);
+        return e == std::string::npos ? std::string{} : line.substr(p + 1, e - p - 1);
+    }
+    size_t e = line.find_first_of(",}", p);
+    return line.substr(p, e - p);
+}
+
+// readBaseline：读取 writeJson 格式的基线文件（workload/stage → median_ms）
+std::map<std::pair<std::string, std::string>, double> readBaseline(const std::string &path) {
+    std::map<std::pair<std::string, std::string>, double> base;
+    std::ifstream ifs(path);
+    if (!ifs.is_open())
+        throw std::runtime_error("cannot open baseline '" + path + "'");
+    std::string line;
+    while (std::getline(ifs, line)) {
+        std::string w = jsonField(line, "workload"), st = jsonField(line, "stage");
+        std::string med = jsonField(line, "median_ms");
+        if (!w.empty() && !st.empty() && !med.empty())
+            base[{w, st}] = std::strtod(med.c_str(), nullptr);
+    }
+    return base;
+}
+
+/**
+ * @brief 与基线逐项比较中位数
+ * @param threshold 允许的相对变慢比例（如 0.10 表示 10%）
+ * @param floorMs   绝对差低于此值时视为噪声，不判为回归
+ * @return 回归项个数
+ */
+int compareBaseline(const std::vector<Sample> &samples,
+                    const std::map<std::pair<std::string, std::string>, double> &base,
+                    double threshold, double floorMs) {
+    char line[160];
+    int regressions = 0;
+    std::cout << "\n";
+    std::snprintf(line, sizeof(line), "%-12s %-9s %10s %10s %8s\n", "workload", "stage", "base",
+                  "now", "ratio");
+    std::cout << line;
+    for (const auto &s : samples) {
+        auto it = base.find({s.workload, s.stage});
+        if (it == base.end()) {
+            std::snprintf(line, sizeof(line), "%-12s %-9s %10s %10.3f %8s\n", s.workload.c_str(),
+                          s.stage.c_str(), "-", s.median, "new");
+            std::cout << line;
+            continue;
+        }
+        double ratio = it->second > 0 ? s.median / it->second : 1.0;
+        bool regressed = ratio > 1.0 + threshold && s.median - it->second > floorMs;
+        regressions += regressed;
+        std::snprintf(line, sizeof(line), "%-12s %-9s %10.3f %10.3f %7.2fx%s\n",
+                      s.workload.c_str(), s.stage.c_str(), it->second, s.median, ratio,
+                      regressed ? "  REGRESSION" : "");
+        std::cout << line;
+    }
+    return regressions;
+}
+
+// printUsage：输出命令行帮助
+void printUsage(const char *prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "Options:\n"
+              << "  --reps <N>          Timed repetitions per stage (default 10, after 1 warm-up)\n"
+              << "  --scale <K>         Multiply workload sizes by K (default 1)\n"
+              << "  --workload <name>   Only run the named workload (repeatable)\n"
+              << "  --json <file>       Write results as JSON\n"
+              << "  --compare <file>    Compare medians with baseline JSON, exit 1 on regression\n"
+              << "  --threshold <r>     Allowed slowdown ratio for --compare (default 0.10)\n"
+              << "  --dump <dir>        Write the generated programs to <dir> and exit\n"
+              << "  --list              List workloads\n";
+}
+
+} // namespace
+
+#pragma endregion
+
+int main(int argc, char *argv[]) {
+    int reps = 10, scale = 1;
+    double threshold = 0.10;
+    std::string jsonPath, comparePath, dumpDir;
+    std::vector<std::string> only;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--reps" && hasValue)
+            reps = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--scale" && hasValue)
+            scale = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--workload" && hasValue)
+            only.push_back(argv[++i]);
+        else if (arg == "--json" && hasValue)
+            jsonPath = argv[++i];
+        else if (arg == "--compare" && hasValue)
+            comparePath = argv[++i];
+        else if (arg == "--threshold" && hasValue)
+            threshold = std::strtod(argv[++i], nullptr);
+        else if (arg == "--dump" && hasValue)
+            dumpDir = argv[++i];
+        else if (arg == "--list") {
+            for (const auto &w : kWorkloads)
+                std::cout << w.name << "\n";
+            return 0;
+        } else {
+            printUsage(argv[0]);
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+
+    std::vector<const Workload *> selected;
+    for (const auto &w : kWorkloads) {
+        if (only.empty() || std::find(only.begin(), only.end(), w.name) != only.end())
+            selected.push_back(&w);
+    }
+    if (selected.empty()) {
+        std::cerr << "Error: no matching workload\n";
+        return 1;
+    }
+
+    // --dump：只写出生成的程序（可直接交给 toyc 或 clang 检查）
+    if (!dumpDir.empty()) {
+        fs::create_directories(dumpDir);
+        for (const Workload *w : selected) {
+            std::ofstream(fs::path(dumpDir) / (std::string(w->name) + ".c")) << w->generate(scale);
+        }
+        return 0;
+    }
+
+    std::cout << "=== ToyC Compile-Time Benchmark (reps=" << reps << ", scale=" << scale
+              << ") ===\n";
+    std::vector<Sample> samples;
+    try {
+        for (const Workload *w : selected) {
+            std::string src = w->generate(scale);
+            size_t lines = std::count(src.begin(), src.end(), '\n');
+            std::cout << w->name << ": " << src.size() << " bytes, " << lines << " lines\n";
+            auto results = benchWorkload(w->name, src, reps);
+            samples.insert(samples.end(), results.begin(), results.end());
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    std::cout << "\n";
+    printTable(samples);
+
+    if (!jsonPath.empty()) {
+        std::ofstream ofs(jsonPath);
+        if (!ofs.is_open()) {
+            std::cerr << "Error: Cannot open output file '" << jsonPath << "'\n";
+            return 1;
+        }
+        writeJson(ofs, samples, reps, scale);
+    }
+
+    if (!comparePath.empty()) {
+        try {
+            int regressions = compareBaseline(samples, readBaseline(comparePath), threshold, 0.05);
+            std::cout << "\n=== " << regressions << " regression(s) over " << threshold * 100
+                      << "% ===\n";
+            return regressions == 0 ? 0 : 1;
+        } catch (const std::exception &e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
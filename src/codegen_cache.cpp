@@ -0,0 +1,282 @@
+#include "codegen_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+namespace toyc {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// ======================== 辅助函数 ========================
+
+constexpr char kMagic[4] = {'T', 'C', 'G', 'C'};
+constexpr uint32_t kFormatVersion = 4; // 条目格式或 MachineFunction 结构变化时递增
+
+// hash64：FNV-1a（64 位），seed 作为初始值；两个不同 seed 的结果分别用作文件名与校验值
+uint64_t hash64(std::string_view data, uint64_t seed) {
+    uint64_t h = seed;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+constexpr uint64_t kHashSeed = 0xcbf29ce484222325ULL;
+constexpr uint64_t kCheckSeed = 0x84222325cbf29ce4ULL;
+
+// compilerIdentity：当前可执行文件的大小与修改时间（无法获取时退化为本文件的编译时间）
+std::string compilerIdentity() {
+    std::error_code ec;
+    fs::path exe = fs::read_symlink("/proc/self/exe", ec);
+    if (!ec) {
+        auto size = fs::file_size(exe, ec);
+        if (!ec) {
+            auto mtime = fs::last_write_time(exe, ec);
+            if (!ec)
+                return std::to_string(size) + ":" +
+                       std::to_string(mtime.time_since_epoch().count());
+        }
+    }
+    return __DATE__ " " __TIME__;
+}
+
+// ByteWriter：条目序列化（定长小端整数 + 长度前缀字符串）
+class ByteWriter {
+  public:
+    void u8(uint8_t v) { buf_.push_back(static_cast<char>(v)); }
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; ++i)
+            u8(static_cast<uint8_t>(v >> (8 * i)));
+    }
+    void u64(uint64_t v) {
+        u32(static_cast<uint32_t>(v));
+        u32(static_cast<uint32_t>(v >> 32));
+    }
+    void i32(int32_t v) { u32(static_cast<uint32_t>(v)); }
+    void str(std::string_view s) {
+        u32(static_cast<uint32_t>(s.size()));
+        buf_.append(s);
+    }
+    void raw(const char *p, size_t n) { buf_.append(p, n); }
+    const std::string &data() const { return buf_; }
+
+  private:
+    std::string buf_;
+};
+
+// ByteReader：条目反序列化；越界时置 ok_ = false 并返回 0 / 空串，由调用方统一检查
+class ByteReader {
+  public:
+    explicit ByteReader(std::string_view data) : data_(data) {}
+
+    bool ok() const { return ok_; }
+    bool atEnd() const { return pos_ == data_.size(); }
+
+    uint8_t u8() {
+        if (pos_ >= data_.size()) {
+            ok_ = false;
+            return 0;
+        }
+        return static_cast<uint8_t>(data_[pos_++]);
+    }
+    uint32_t u32() {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= static_cast<uint32_t>(u8()) << (8 * i);
+        return v;
+    }
+    uint64_t u64() {
+        uint64_t lo = u32();
+        return lo | (static_cast<uint64_t>(u32()) << 32);
+    }
+    int32_t i32() { return static_cast<int32_t>(u32()); }
+    std::string_view str() {
+        uint32_t n = u32();
+        if (!ok_ || n > data_.size() - pos_) {
+            ok_ = false;
+            return {};
+        }
+        std::string_view s = data_.substr(pos_, n);
+        pos_ += n;
+        return s;
+    }
+    // count：读取元素个数（每个元素至少 minBytes 字节，超出剩余数据时视为损坏）
+    uint32_t count(size_t minBytes) {
+        uint32_t n = u32();
+        if (!ok_ || n > (data_.size() - pos_) / minBytes) {
+            ok_ = false;
+            return 0;
+        }
+        return n;
+    }
+
+  private:
+    std::string_view data_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+// encodeEntry：魔数 | 版本 | 键校验值 | 负载哈希 | 负载（MachineFunction）
+std::string encodeEntry(uint64_t check, const mir::MachineFunction &MF) {
+    ByteWriter w;
+    w.str(MF.name);
+    w.i32(MF.frameSize);
+    w.u32(static_cast<uint32_t>(MF.calleeSavedRegs.size()));
+    for (int reg : MF.calleeSavedRegs)
+        w.i32(reg);
+    w.u32(static_cast<uint32_t>(MF.blocks.size()));
+    for (const auto &MBB : MF.blocks) {
+        w.str(MBB.label);
+        w.u32(static_cast<uint32_t>(MBB.insts.size()));
+        for (const auto &MI : MBB.insts) {
+            w.u8(static_cast<uint8_t>(MI.opcode));
+            w.u8(static_cast<uint8_t>(MI.rd));
+            w.u8(static_cast<uint8_t>(MI.rs1));
+            w.u8(static_cast<uint8_t>(MI.rs2));
+            w.i32(MI.imm);
+            w.i32(MI.target);
+            w.str(MI.sym.str());
+        }
+    }
+    w.u32(static_cast<uint32_t>(MF.profileBlocks.size()));
+    for (const std::string &block : MF.profileBlocks)
+        w.str(block);
+    ByteWriter entry;
+    entry.raw(kMagic, sizeof(kMagic));
+    entry.u32(kFormatVersion);
+    entry.u64(check);
+    entry.u64(hash64(w.data(), kHashSeed));
+    entry.raw(w.data().data(), w.data().size());
+    return entry.data();
+}
+
+// decodeEntry：解码并校验条目（负载哈希发现位翻转，结构检查发现越界），任何不一致都返回 std::nullopt
+std::optional<mir::MachineFunction> decodeEntry(std::string_view data, uint64_t check) {
+    if (data.size() < sizeof(kMagic) || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0)
+        return std::nullopt;
+    constexpr size_t kHeaderSize = sizeof(kMagic) + 4 + 8 + 8;
+    if (data.size() < kHeaderSize)
+        return std::nullopt;
+    ByteReader header(data.substr(sizeof(kMagic), kHeaderSize - sizeof(kMagic)));
+    const std::string_view payload = data.substr(kHeaderSize);
+    if (header.u32() != kFormatVersion || header.u64() != check ||
+        header.u64() != hash64(payload, kHashSeed))
+        return std::nullopt;
+    ByteReader r(payload);
+
+    mir::MachineFunction MF;
+    MF.name = r.str();
+    MF.frameSize = r.i32();
+    MF.calleeSavedRegs.resize(r.count(4));
+    for (int &reg : MF.calleeSavedRegs)
+        reg = r.i32();
+    MF.blocks.resize(r.count(8));
+    for (auto &MBB : MF.blocks) {
+        MBB.label = r.str();
+        MBB.insts.resize(r.count(16));
+        for (auto &MI : MBB.insts) {
+            uint8_t op = r.u8();
+            if (op > static_cast<uint8_t>(mir::MOpcode::ProfCount))
+                return std::nullopt;
+            MI.opcode = static_cast<mir::MOpcode>(op);
+            MI.rd = static_cast<int8_t>(r.u8());
+            MI.rs1 = static_cast<int8_t>(r.u8());
+            MI.rs2 = static_cast<int8_t>(r.u8());
+            MI.imm = r.i32();
+            MI.target = r.i32();
+            MI.sym = ir::Symbol(r.str());
+            if (MI.target < -1 || MI.target >= static_cast<int32_t>(MF.blocks.size()))
+                return std::nullopt;
+        }
+        if (!r.ok())
+            return std::nullopt;
+    }
+    MF.profileBlocks.resize(r.count(4));
+    for (std::string &block : MF.profileBlocks)
+        block = r.str();
+    if (!r.ok() || !r.atEnd())
+        return std::nullopt;
+    return MF;
+}
+
+} // namespace
+
+// ======================== CodeGenCache ========================
+
+CodeGenCache::CodeGenCache(fs::path dir, std::string_view options) : dir_(std::move(dir)) {
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    config_ = "toyc-cgcache-" + std::to_string(kFormatVersion) + "|" + compilerIdentity() + "|";
+    config_ += options;
+    config_ += '\n';
+}
+
+// key：配置前缀 + 函数 IR 文本 + maxVregId（IR 文本不包含它，但它影响寄存器分配的数据结构大小）
+// + 各块的剖析计数（--profile-use 时影响溢出权重与块布局；没有剖析数据时全为 -1）+ 调用方给出的上下文
+CodeGenCache::Key CodeGenCache::key(const ir::Function &func, std::string_view context) const {
+    std::string text = config_;
+    text += func.toString();
+    text += '\n';
+    text += std::to_string(func.maxVregId);
+    for (const auto &bb : func.blocks) {
+        text += ' ';
+        text += std::to_string(bb->profileCount);
+    }
+    if (!context.empty()) {
+        text += '\n';
+        text += context;
+    }
+    return {hash64(text, kHashSeed), hash64(text, kCheckSeed)};
+}
+
+// entryPath：<dir>/<16 位十六进制哈希>.mf
+fs::path CodeGenCache::entryPath(const Key &key) const {
+    char name[24];
+    std::snprintf(name, sizeof(name), "%016llx.mf", static_cast<unsigned long long>(key.hash));
+    return dir_ / name;
+}
+
+// lookup：读取整个条目文件并解码，文件缺失或校验失败都计为未命中
+std::optional<mir::MachineFunction> CodeGenCache::lookup(const Key &key) const {
+    std::ifstream ifs(entryPath(key), std::ios::binary);
+    std::optional<mir::MachineFunction> MF;
+    if (ifs.is_open()) {
+        std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        MF = decodeEntry(data, key.check);
+    }
+    (MF ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+    return MF;
+}
+
+// store：写入同目录下的临时文件后 rename，读者永远看不到写了一半的条目
+void CodeGenCache::store(const Key &key, const mir::MachineFunction &MF) const {
+    fs::path path = entryPath(key);
+    std::ostringstream tmpName;
+    tmpName << path.filename().string() << ".tmp." << getpid() << "."
+            << std::this_thread::get_id();
+    fs::path tmp = dir_ / tmpName.str();
+    bool written = false;
+    {
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open())
+            return;
+        const std::string data = encodeEntry(key.check, MF);
+        ofs.write(data.data(), static_cast<std::streamsize>(data.size()));
+        written = static_cast<bool>(ofs.flush());
+    }
+    std::error_code ec;
+    if (written)
+        fs::rename(tmp, path, ec);
+    if (!written || ec)
+        fs::remove(tmp, ec);
+}
+
+} // namespace toyc
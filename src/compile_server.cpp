@@ -0,0 +1,224 @@
+#include "compile_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace toyc {
+
+#pragma region 请求处理
+
+CompileServer::CompileServer(const ServerOptions &opts) : context_(opts.jobs, opts.cacheDir) {}
+
+/**
+ * @brief 处理一个 compile 请求
+ * @details 结果先写入内存，成功时整体作为响应负载，失败时改为发送诊断（不会发出半份汇编）
+ */
+bool CompileServer::compile(const std::vector<std::string> &args, std::string_view source,
+                            std::string &out) {
+    ++requests_;
+    CompileOptions opts;
+    CompileResult result = parseCompileOptions(args, opts);
+    std::ostringstream os;
+    if (result)
+        result = context_.compile(source, opts, os);
+    out = result ? std::move(os).str() : result.message();
+    return result.ok();
+}
+
+#pragma endregion
+
+#pragma region 传输
+
+namespace {
+
+// kMaxPayload：单个请求负载的上限（防止格式错误的长度字段触发巨量分配）
+constexpr size_t kMaxPayload = size_t(1) << 30;
+
+// FdReader：带缓冲地从描述符读取文本行与定长负载（EINTR 时重试）
+class FdReader {
+  public:
+    explicit FdReader(int fd) : fd_(fd) {}
+
+    // readLine：读取一行（不含换行符，去掉行尾的 \r）；输入已结束时返回 false
+    bool readLine(std::string &line) {
+        line.clear();
+        for (;;) {
+            if (pos_ == end_ && !fill())
+                return !line.empty();
+            const char *begin = buf_ + pos_;
+            const char *nl = static_cast<const char *>(std::memchr(begin, '\n', end_ - pos_));
+            if (nl) {
+                line.append(begin, nl);
+                pos_ += static_cast<size_t>(nl - begin) + 1;
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                return true;
+            }
+            line.append(begin, end_ - pos_);
+            pos_ = end_;
+        }
+    }
+
+    // readExact：读取恰好 n 字节；输入提前结束时返回 false
+    bool readExact(size_t n, std::string &data) {
+        data.clear();
+        data.reserve(n);
+        while (data.size() < n) {
+            if (pos_ == end_ && !fill())
+                return false;
+            size_t take = std::min(n - data.size(), end_ - pos_);
+            data.append(buf_ + pos_, take);
+            pos_ += take;
+        }
+        return true;
+    }
+
+  private:
+    int fd_;
+    char buf_[65536];
+    size_t pos_ = 0, end_ = 0;
+
+    bool fill() {
+        ssize_t n;
+        do
+            n = ::read(fd_, buf_, sizeof(buf_));
+        while (n < 0 && errno == EINTR);
+        pos_ = 0;
+        end_ = n > 0 ? static_cast<size_t>(n) : 0;
+        return n > 0;
+    }
+};
+
+// writeAll：写出全部数据（对端已关闭等错误时返回 false）
+bool writeAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+    return true;
+}
+
+// reply：写出一个响应（ok / error + 负载长度 + 负载）
+bool reply(int fd, bool ok, std::string_view payload) {
+    std::string header = (ok ? "ok " : "error ") + std::to_string(payload.size()) + "\n";
+    return writeAll(fd, header) && writeAll(fd, payload);
+}
+
+} // namespace
+
+/**
+ * @brief 逐个处理一个连接上的请求
+ * @details 未知命令只回复 error，连接继续；长度字段错误时无法再找到下一个请求的边界，
+ *   回复 error 后结束本连接。对端断开（读到输入结束或写失败）同样结束本连接
+ */
+bool CompileServer::serve(int in, int out) {
+    FdReader reader(in);
+    std::string line, payload, result;
+    while (reader.readLine(line)) {
+        std::istringstream header(line);
+        std::string command;
+        if (!(header >> command))
+            continue;
+        if (command == "quit")
+            return true;
+        if (command == "shutdown")
+            return false;
+        if (command == "ping") {
+            if (!reply(out, true, {}))
+                return true;
+            continue;
+        }
+        if (command != "compile") {
+            if (!reply(out, false, "unknown command '" + command + "'"))
+                return true;
+            continue;
+        }
+        std::string length;
+        header >> length;
+        size_t size = 0;
+        if (length.empty() || length.size() > 10 ||
+            length.find_first_not_of("0123456789") != std::string::npos ||
+            (size = std::stoul(length)) > kMaxPayload) {
+            reply(out, false, "invalid payload length '" + length + "'");
+            return true;
+        }
+        std::vector<std::string> args;
+        for (std::string arg; header >> arg;)
+            args.push_back(arg);
+        if (!reader.readExact(size, payload))
+            return true;
+        bool ok = compile(args, payload, result);
+        if (!reply(out, ok, result))
+            return true;
+    }
+    return true;
+}
+
+/**
+ * @brief 启动编译服务
+ * @details 未指定套接字时在 stdin / stdout 上服务，输入结束即退出；否则在 Unix 域套接字上
+ *   逐个接受连接，直到某个连接发送 shutdown，退出时删除套接字文件。
+ *   忽略 SIGPIPE：客户端提前断开只让本次写失败，不终止服务
+ */
+int runServer(const ServerOptions &opts) {
+    std::signal(SIGPIPE, SIG_IGN);
+    CompileServer server(opts);
+    if (opts.socketPath.empty()) {
+        server.serve(STDIN_FILENO, STDOUT_FILENO);
+        return 0;
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (opts.socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: Socket path too long '" << opts.socketPath << "'\n";
+        return 1;
+    }
+    std::memcpy(addr.sun_path, opts.socketPath.c_str(), opts.socketPath.size() + 1);
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::cerr << "Error: Cannot create socket: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    ::unlink(opts.socketPath.c_str()); // 上次异常退出留下的套接字文件
+    if (::bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listener, 16) != 0) {
+        std::cerr << "Error: Cannot listen on '" << opts.socketPath
+                  << "': " << std::strerror(errno) << "\n";
+        ::close(listener);
+        return 1;
+    }
+    std::cerr << "toyc server listening on " << opts.socketPath << "\n";
+
+    int status = 0;
+    for (bool running = true; running;) {
+        int conn = ::accept(listener, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Error: accept failed: " << std::strerror(errno) << "\n";
+            status = 1;
+            break;
+        }
+        running = server.serve(conn, conn);
+        ::close(conn);
+    }
+    ::close(listener);
+    ::unlink(opts.socketPath.c_str());
+    return status;
+}
+
+#pragma endregion
+
+} // namespace toyc
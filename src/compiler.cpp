@@ -0,0 +1,242 @@
+#include "compiler.h"
+#include "codegen_cache.h"
+#include "ir_builder.h"
+#include "ir_parser.h"
+#include "parser.h"
+#include "riscv_codegen.h"
+#include "statistics.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace toyc {
+
+#pragma region 选项与诊断
+
+std::optional<mir::LatencyModel> CompileOptions::resolveSchedule() const {
+    if (schedule == 0 || (schedule < 0 && optLevel == 0))
+        return std::nullopt;
+    return tuning;
+}
+
+const char *diagnosticKindName(Diagnostic::Kind kind) {
+    switch (kind) {
+    case Diagnostic::Kind::InvalidOption:
+        return "invalid-option";
+    case Diagnostic::Kind::SyntaxError:
+        return "syntax-error";
+    case Diagnostic::Kind::InvalidIR:
+        return "invalid-ir";
+    case Diagnostic::Kind::UnknownFunction:
+        return "unknown-function";
+    case Diagnostic::Kind::CodeGenError:
+        return "codegen-error";
+    }
+    return "error";
+}
+
+std::string CompileResult::message() const {
+    std::string text;
+    for (const Diagnostic &d : diagnostics) {
+        if (!text.empty())
+            text += '\n';
+        text += d.message;
+    }
+    return text;
+}
+
+namespace {
+
+// parseNumber：解析 [0, limit] 内的十进制整数，格式错误时返回 -1
+long parseNumber(std::string_view s, long limit) {
+    if (s.empty() || s.size() > 10)
+        return -1;
+    long n = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9')
+            return -1;
+        n = n * 10 + (c - '0');
+    }
+    return n <= limit ? n : -1;
+}
+
+// failure：只含一条诊断的结果
+CompileResult failure(Diagnostic::Kind kind, std::string message, int line = 0) {
+    CompileResult result;
+    result.diagnostics.push_back({kind, std::move(message), line});
+    return result;
+}
+
+} // namespace
+
+/**
+ * @brief 按命令行写法解析编译选项
+ * @details 与 toyc 命令行的单文件选项一一对应（-c / --ir 选择输出形式，-x c|ll 选择输入语言）；
+ *   格式错误时不修改之后的选项，返回指出该选项的 InvalidOption 诊断
+ */
+CompileResult parseCompileOptions(const std::vector<std::string> &args, CompileOptions &opts) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string &arg = args[i];
+        auto value = [&](size_t prefix) { return std::string_view(arg).substr(prefix); };
+        bool valid = true;
+        if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+            opts.optLevel = arg[2] - '0';
+        } else if (arg.rfind("-finline-limit=", 0) == 0) {
+            long n = parseNumber(value(15), 1000000);
+            valid = n >= 0;
+            if (valid)
+                opts.inlineLimit = static_cast<int>(n);
+        } else if (arg.rfind("--regalloc=", 0) == 0) {
+            valid = parseRegAllocKind(arg.substr(11), opts.regAlloc);
+        } else if (arg.rfind("--march=", 0) == 0) {
+            std::string_view name = value(8);
+            valid = name == "rv32im" || name == "rv32imc" || name == "rv32imv" ||
+                    name == "rv32imcv";
+            if (valid) {
+                opts.compressed = name.size() > 6 && name[6] == 'c';
+                opts.vectorize = name.back() == 'v';
+            }
+        } else if (arg == "-fipra" || arg == "-fno-ipra") {
+            opts.ipra = arg == "-fipra";
+        } else if (arg == "-fomit-frame-pointer" || arg == "-fno-omit-frame-pointer") {
+            opts.omitFramePointer = arg == "-fomit-frame-pointer";
+        } else if (arg == "-fschedule-insns" || arg == "-fno-schedule-insns") {
+            opts.schedule = arg == "-fschedule-insns";
+        } else if (arg.rfind("-mtune=", 0) == 0) {
+            auto model = mir::parseLatencyModel(value(7));
+            valid = model.has_value();
+            if (valid)
+                opts.tuning = *model;
+        } else if (arg == "-x" && i + 1 < args.size()) {
+            const std::string &lang = args[++i];
+            if (lang != "c" && lang != "ll")
+                return failure(Diagnostic::Kind::InvalidOption,
+                               "unknown input language '" + lang + "' (use c or ll)");
+            opts.language = lang == "ll" ? InputLanguage::IR : InputLanguage::ToyC;
+        } else if (arg == "--ir") {
+            opts.output = OutputKind::IR;
+        } else if (arg == "-c") {
+            opts.output = OutputKind::Object;
+        } else if (arg == "--function" && i + 1 < args.size()) {
+            opts.functions.push_back(args[++i]);
+        } else {
+            valid = false;
+        }
+        if (!valid)
+            return failure(Diagnostic::Kind::InvalidOption, "invalid option '" + arg + "'");
+    }
+    return {};
+}
+
+#pragma endregion
+
+#pragma region 编译上下文
+
+CompilerContext::CompilerContext(unsigned jobs, std::string cacheDir)
+    : cacheDir_(std::move(cacheDir)) {
+    if (jobs > 1)
+        pool_ = std::make_unique<ThreadPool>(jobs);
+}
+
+CompilerContext::~CompilerContext() = default;
+
+// cacheFor：缓存键前缀与命令行编译相同，同一目录中两者的条目互相命中
+CodeGenCache *CompilerContext::cacheFor(const CompileOptions &opts,
+                                        const std::optional<mir::LatencyModel> &schedule) {
+    if (cacheDir_.empty())
+        return nullptr;
+    std::string options = std::string("regalloc=") + regAllocKindName(opts.regAlloc);
+    if (opts.compressed)
+        options += " march=rv32imc";
+    if (opts.resolveIPRA())
+        options += " ipra";
+    if (opts.omitFramePointer)
+        options += " omit-frame-pointer";
+    if (schedule)
+        options += " sched=" + schedule->toString();
+    auto &cache = caches_[options];
+    if (!cache)
+        cache = std::make_unique<CodeGenCache>(cacheDir_, options);
+    return cache.get();
+}
+
+/**
+ * @brief 编译一个内存中的翻译单元
+ * @details 与命令行的整模块路径相同：解析（或读入 LLVM IR）→ 筛选函数 → IR 优化 → 向量化 →
+ *   代码生成。各阶段的异常转为对应种类的 Diagnostic，不会逃出本函数
+ */
+CompileResult CompilerContext::compile(std::string_view source, const CompileOptions &opts,
+                                       std::ostream &out) {
+    ++compilations_;
+    std::unique_ptr<ir::Module> mod;
+    try {
+        if (opts.language == InputLanguage::IR) {
+            IRParser parser;
+            mod = parser.parseModule(source, pool_ ? pool_->size() : 1);
+            if (!mod || mod->functions.empty())
+                return failure(Diagnostic::Kind::InvalidIR, "failed to parse LLVM IR");
+        } else {
+            CompUnit unit;
+            {
+                stats::ScopedTimer timer(stats::Phase::Parse);
+                Parser parser(source);
+                unit = parser.parseCompUnit();
+            }
+            stats::ScopedTimer timer(stats::Phase::IRBuild);
+            IRBuilder builder;
+            mod = builder.buildModule(unit);
+        }
+    } catch (const ParseError &e) {
+        return failure(Diagnostic::Kind::SyntaxError, e.what(), e.line);
+    } catch (const std::exception &e) {
+        return failure(opts.language == InputLanguage::IR ? Diagnostic::Kind::InvalidIR
+                                                          : Diagnostic::Kind::SyntaxError,
+                       e.what());
+    }
+
+    for (const std::string &name : opts.functions)
+        if (std::none_of(mod->functions.begin(), mod->functions.end(),
+                         [&](const auto &f) { return f->name == name; }))
+            return failure(Diagnostic::Kind::UnknownFunction,
+                           "function '" + name + "' not found");
+    if (!opts.functions.empty())
+        std::erase_if(mod->functions, [&](const auto &f) {
+            return std::find(opts.functions.begin(), opts.functions.end(), f->name) ==
+                   opts.functions.end();
+        });
+
+    opt::optimizeModule(*mod, opts.optLevel, opts.inlineLimit);
+    if (opts.vectorize)
+        opt::vectorizeLoops(*mod);
+    if (opts.output == OutputKind::IR) {
+        out << mod->toString();
+        return {};
+    }
+
+    try {
+        const std::optional<mir::LatencyModel> schedule = opts.resolveSchedule();
+        std::optional<RISCVCodeGen> gen;
+        if (pool_)
+            gen.emplace(*pool_);
+        else
+            gen.emplace(1);
+        gen->setCache(cacheFor(opts, schedule));
+        gen->setRegAlloc(opts.regAlloc);
+        gen->setSchedule(schedule);
+        gen->setCompressed(opts.compressed);
+        gen->setIPRA(opts.resolveIPRA());
+        gen->setOmitFramePointer(opts.omitFramePointer);
+        if (opts.output == OutputKind::Object)
+            gen->generateObject(*mod, out);
+        else
+            gen->generate(*mod, out);
+    } catch (const std::exception &e) {
+        return failure(Diagnostic::Kind::CodeGenError, e.what());
+    }
+    return {};
+}
+
+#pragma endregion
+
+} // namespace toyc
@@ -0,0 +1,175 @@
+#include "ir_analysis.h"
+#include "ir_passes.h"
+#include "reg_alloc.h"
+#include "statistics.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+namespace {
+
+// DefSite：一次定义所在的位置
+struct DefSite {
+    const BasicBlock *block;
+    size_t index;
+};
+
+// liveAfter：vreg 在 block 第 index 条指令之后是否活跃（块内先遇到 use 为活跃，先遇到 def 为死亡，
+// 扫到块尾时取 liveOut）
+bool liveAfter(int vreg, const BasicBlock &block, size_t index) {
+    for (size_t i = index + 1; i < block.insts.size(); ++i) {
+        const Instruction *I = block.insts[i];
+        if (I->readsReg(vreg))
+            return true;
+        if (I->defReg() == vreg)
+            return false;
+    }
+    return block.liveOut.test(vreg);
+}
+
+/**
+ * @brief 向前传播：把候选拷贝目标的 use 替换为拷贝来源
+ * @details 候选：%d = copy v，%d 不是参数且只有这一处定义（支配它的全部 use）。
+ *   v 为常量时总可以传播；v 为 vreg 时，要求 v 的每一处定义之后 %d 都不活跃 ——
+ *   否则存在一条 拷贝 → v 被改写 → 读 %d 的路径，读到的不再是拷贝时的值。
+ *   phi 消除产生的 %p = copy %t（%t 在各前驱末尾被写）在 %p 不跨越回边上的写入时满足条件。
+ *   接受 %d → v 会给 v 增加 use、改变 v 的活跃范围，因此 v 本身已被替换、或 %d 已作为
+ *   其他候选的来源时不再接受（留给下一次调用）；其余候选的判定互不影响，一次活跃性分析即可
+ */
+size_t forwardCopies(Function &F, const std::vector<Instruction *> &candidates) {
+    if (candidates.empty())
+        return 0;
+    LivenessAnalysis().run(F);
+
+    // 候选来源 vreg 的全部定义位置（只在可达块中查找，不可达块的定义不会执行）
+    std::unordered_map<int, std::vector<DefSite>> sourceDefs;
+    for (const Instruction *I : candidates)
+        if (I->ops[0].isVReg())
+            sourceDefs.try_emplace(I->ops[0].regId());
+    for (const BasicBlock *bb : F.rpoOrder)
+        for (size_t i = 0; i < bb->insts.size(); ++i) {
+            auto it = sourceDefs.find(bb->insts[i]->defReg());
+            if (it != sourceDefs.end())
+                it->second.push_back(DefSite{bb, i});
+        }
+
+    std::unordered_map<int, Operand> replacement; // %d → 替换它的操作数
+    std::unordered_set<int> sources;              // 已接受的候选读取的 vreg
+    std::unordered_set<const Instruction *> removed;
+    for (const Instruction *I : candidates) {
+        int d = I->defReg();
+        const Operand &src = I->ops[0];
+        if (src.isVReg()) {
+            int s = src.regId();
+            if (replacement.count(s) || sources.count(d))
+                continue;
+            const auto &defs = sourceDefs[s];
+            if (std::any_of(defs.begin(), defs.end(), [&](const DefSite &site) {
+                    return liveAfter(d, *site.block, site.index);
+                }))
+                continue;
+            sources.insert(s);
+        } else if (sources.count(d)) {
+            continue;
+        }
+        replacement.emplace(d, src);
+        removed.insert(I);
+    }
+    if (removed.empty())
+        return 0;
+
+    for (auto &bb : F.blocks) {
+        std::erase_if(bb->insts, [&](const Instruction *I) { return removed.count(I) != 0; });
+        for (Instruction *I : bb->insts)
+            for (Operand &op : I->ops)
+                if (op.isVReg())
+                    if (auto it = replacement.find(op.regId()); it != replacement.end())
+                        op = it->second;
+    }
+    return removed.size();
+}
+
+
+/**
+ * @brief 把拷贝并入来源的定义：%x = op ...; ...; %t = copy %x  →  %t = op ...; ...
+ * @details 要求 %x 不是参数、只有一处定义且与拷贝在同一块中位于其前、唯一的 use 就是这条拷贝，
+ *   并且两者之间没有指令读写 %t（否则会提前看到新值）。定义指令自身读取 %t 不受影响
+ *   （指令先读操作数再写结果），phi 消除在回边上产生的 %x = add %t, 1; %t = copy %x
+ *   由此变为 %t = add %t, 1
+ */
+size_t sinkCopiesIntoDefs(Function &F) {
+    const DefUseChains chains(F); // 并入只改写定义指令的结果，各 vreg 的定义 / 使用数不受影响
+    std::unordered_set<int> params(F.paramVregs.begin(), F.paramVregs.end());
+
+    size_t sunk = 0;
+    for (auto &bb : F.blocks) {
+        auto &insts = bb->insts;
+        std::unordered_map<int, size_t> defAt; // 本块中定义的 vreg → 指令下标
+        std::vector<size_t> dead;
+        for (size_t i = 0; i < insts.size(); ++i) {
+            Instruction *I = insts[i];
+            int t = I->defReg();
+            if (I->opcode == Opcode::Copy && I->ops[0].isVReg() && I->ops[0].regId() != t) {
+                int x = I->ops[0].regId();
+                auto def = defAt.find(x);
+                if (def != defAt.end() && chains.numDefs(x) == 1 && chains.numUses(x) == 1 &&
+                    !params.count(x) && insts[def->second]->opcode != Opcode::Alloca) {
+                    bool touched = false;
+                    for (size_t k = def->second + 1; k < i && !touched; ++k) {
+                        const Instruction *J = insts[k];
+                        touched = J->defReg() == t || J->readsReg(t);
+                    }
+                    if (!touched) {
+                        insts[def->second]->def = I->def;
+                        dead.push_back(i);
+                        defAt[t] = def->second;
+                        continue;
+                    }
+                }
+            }
+            if (t >= 0)
+                defAt[t] = i;
+        }
+        for (auto it = dead.rbegin(); it != dead.rend(); ++it)
+            insts.erase(insts.begin() + static_cast<std::ptrdiff_t>(*it));
+        sunk += dead.size();
+    }
+    return sunk;
+}
+
+} // namespace
+
+/**
+ * @brief 拷贝传播
+ * @details 先向前传播（forwardCopies），再把剩下的拷贝并入来源的定义（sinkCopiesIntoDefs）
+ */
+int propagateCopies(Function &F) {
+    const size_t n = static_cast<size_t>(F.maxVregId + 1);
+    std::vector<int> defCount(n, 0);
+    std::vector<Instruction *> candidates;
+    for (auto &bb : F.blocks)
+        for (Instruction *I : bb->insts) {
+            int d = I->defReg();
+            if (d < 0 || static_cast<size_t>(d) >= n)
+                continue;
+            ++defCount[d];
+            if (I->opcode == Opcode::Copy && !(I->ops[0].isVReg() && I->ops[0].regId() == d))
+                candidates.push_back(I);
+        }
+    std::unordered_set<int> params(F.paramVregs.begin(), F.paramVregs.end());
+    std::erase_if(candidates, [&](const Instruction *I) {
+        return defCount[I->defReg()] != 1 || params.count(I->defReg());
+    });
+    size_t removed = forwardCopies(F, candidates);
+    removed += sinkCopiesIntoDefs(F);
+    stats::add(stats::Counter::PropagatedCopies, removed);
+    return static_cast<int>(removed);
+}
+
+} // namespace opt
+} // namespace toyc
@@ -0,0 +1,126 @@
+#include "ir_analysis.h"
+#include "ir_passes.h"
+#include "statistics.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+namespace {
+
+// localSlots：地址不逃逸的 alloca（只作为 load / store 的地址出现），其内容只会被 store 改写
+std::unordered_set<int> localSlots(const Function &F) {
+    std::unordered_set<int> slots;
+    for (auto &bb : F.blocks)
+        for (const Instruction *I : bb->insts)
+            if (I->opcode == Opcode::Alloca)
+                slots.insert(I->defReg());
+    for (auto &bb : F.blocks)
+        for (const Instruction *I : bb->insts)
+            for (size_t k = 0; k < I->ops.size(); ++k) {
+                bool address = (I->opcode == Opcode::Load && k == 0) ||
+                               (I->opcode == Opcode::Store && k == 1);
+                if (I->ops[k].isVReg() && !address)
+                    slots.erase(I->ops[k].regId());
+            }
+    return slots;
+}
+
+/**
+ * @brief 删除死存储
+ * @details 1. 从未被 load 的槽：它的全部 store 都是死的
+ *   2. 块内被覆盖的 store：同一槽的两次 store 之间没有读取它的 load，前一次是死的
+ *   返回删除的 store 条数（槽本身没有 use 后由 DCE 删除）
+ */
+size_t eliminateDeadStores(Function &F) {
+    std::unordered_set<int> slots = localSlots(F);
+    if (slots.empty())
+        return 0;
+    std::unordered_set<int> loaded;
+    for (auto &bb : F.blocks)
+        for (const Instruction *I : bb->insts)
+            if (I->opcode == Opcode::Load && I->ops[0].isVReg())
+                loaded.insert(I->ops[0].regId());
+
+    size_t removed = 0;
+    for (auto &bb : F.blocks) {
+        std::unordered_map<int, size_t> pending; // 槽 → 本块中尚未被读取的最近一次 store
+        std::vector<char> dead(bb->insts.size(), 0);
+        for (size_t i = 0; i < bb->insts.size(); ++i) {
+            const Instruction *I = bb->insts[i];
+            if (I->opcode == Opcode::Load && I->ops[0].isVReg()) {
+                pending.erase(I->ops[0].regId());
+            } else if (I->opcode == Opcode::Store && I->ops[1].isVReg() &&
+                       slots.count(I->ops[1].regId())) {
+                int slot = I->ops[1].regId();
+                if (!loaded.count(slot)) {
+                    dead[i] = 1;
+                    continue;
+                }
+                auto [it, inserted] = pending.try_emplace(slot, i);
+                if (!inserted) {
+                    dead[it->second] = 1;
+                    it->second = i;
+                }
+            }
+        }
+        size_t i = 0;
+        std::erase_if(bb->insts, [&](const Instruction *) { return dead[i++] != 0; });
+        removed += static_cast<size_t>(std::count(dead.begin(), dead.end(), 1));
+    }
+    return removed;
+}
+
+// hasSideEffects：指令是否必须保留（store / call / 终结指令）
+bool hasSideEffects(const Instruction *I) {
+    return I->opcode == Opcode::Store || I->opcode == Opcode::Call || I->isTerminator();
+}
+
+/**
+ * @brief 删除结果未被使用的指令
+ * @details 从有副作用的指令出发，沿操作数的定义标记活跃（phi 之间的环只要没有外部 use 就整体删除），
+ *   其余指令删除。除法可以删除：RISC-V 的 div / rem 除数为 0 时不陷入
+ */
+size_t eliminateDeadInstructions(Function &F) {
+    const DefUseChains chains(F);
+    std::vector<Instruction *> work;
+    std::unordered_set<const Instruction *> live;
+    for (auto &bb : F.blocks)
+        for (Instruction *I : bb->insts)
+            if (hasSideEffects(I) && live.insert(I).second)
+                work.push_back(I);
+    while (!work.empty()) {
+        const Instruction *I = work.back();
+        work.pop_back();
+        I->forEachUse([&](int u) {
+            for (Instruction *D : chains.defs(u))
+                if (live.insert(D).second)
+                    work.push_back(D);
+        });
+    }
+
+    size_t removed = 0;
+    for (auto &bb : F.blocks)
+        removed += std::erase_if(bb->insts, [&](const Instruction *I) { return !live.count(I); });
+    return removed;
+}
+
+} // namespace
+
+/**
+ * @brief 死代码与死存储删除
+ * @details 先删死存储（使只被写入的槽失去全部 use），再做一遍活跃标记删除无用指令与槽
+ */
+int eliminateDeadCode(Function &F) {
+    size_t removed = eliminateDeadStores(F);
+    removed += eliminateDeadInstructions(F);
+    stats::add(stats::Counter::DeadInsts, removed);
+    return static_cast<int>(removed);
+}
+
+} // namespace opt
+} // namespace toyc
@@ -0,0 +1,736 @@
+#include "elf_writer.h"
+#include "statistics.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace toyc {
+
+using mir::CForm;
+using mir::MachineFunction;
+using mir::MachineInstr;
+using mir::MOpcode;
+
+#pragma region ELF 常量
+
+namespace {
+
+// ELF32 / RISC-V 常量（取自 System V ABI 与 RISC-V psABI）
+constexpr uint16_t ET_REL = 1;
+constexpr uint16_t EM_RISCV = 243;
+constexpr uint32_t SHT_PROGBITS = 1, SHT_SYMTAB = 2, SHT_STRTAB = 3, SHT_RELA = 4;
+constexpr uint32_t SHF_ALLOC = 0x2, SHF_EXECINSTR = 0x4, SHF_INFO_LINK = 0x40;
+constexpr uint8_t STB_LOCAL = 0, STB_GLOBAL = 1;
+constexpr uint8_t STT_NOTYPE = 0, STT_FUNC = 2, STT_SECTION = 3;
+constexpr uint32_t R_RISCV_CALL_PLT = 19;
+constexpr uint32_t EF_RISCV_RVC = 0x1;
+
+constexpr uint32_t EHDR_SIZE = 52, SHDR_SIZE = 40, SYM_SIZE = 16, RELA_SIZE = 12;
+
+// 节下标（固定布局）
+enum SectionIndex : uint16_t {
+    SEC_NULL,
+    SEC_TEXT,
+    SEC_RELA_TEXT,
+    SEC_SYMTAB,
+    SEC_STRTAB,
+    SEC_SHSTRTAB,
+    SEC_COUNT
+};
+
+// 符号表固定前缀：[0] 空符号，[1] .text 节符号；全局符号从下标 2 开始
+constexpr uint32_t FIRST_GLOBAL_SYM = 2;
+
+#pragma endregion
+
+#pragma region RV32IM / RVV 指令编码
+
+// 基本操作码（inst[6:0]）
+constexpr uint32_t OP = 0x33, OP_IMM = 0x13, LOAD = 0x03, STORE = 0x23, BRANCH = 0x63,
+                   JAL = 0x6f, JALR = 0x67, LUI = 0x37, AUIPC = 0x17;
+
+constexpr int X0 = 0, RA = 1, T1 = 6;
+
+bool fitsImm12(int64_t v) { return v >= -2048 && v <= 2047; }
+
+uint32_t encR(uint32_t funct7, int rs2, int rs1, uint32_t funct3, int rd) {
+    return funct7 << 25 | uint32_t(rs2) << 20 | uint32_t(rs1) << 15 | funct3 << 12 |
+           uint32_t(rd) << 7 | OP;
+}
+
+uint32_t encI(uint32_t opcode, int rd, uint32_t funct3, int rs1, int32_t imm) {
+    return (uint32_t(imm) & 0xfff) << 20 | uint32_t(rs1) << 15 | funct3 << 12 | uint32_t(rd) << 7 |
+           opcode;
+}
+
+uint32_t encS(uint32_t funct3, int rs1, int rs2, int32_t imm) {
+    uint32_t u = uint32_t(imm);
+    return (u >> 5 & 0x7f) << 25 | uint32_t(rs2) << 20 | uint32_t(rs1) << 15 | funct3 << 12 |
+           (u & 0x1f) << 7 | STORE;
+}
+
+uint32_t encB(uint32_t funct3, int rs1, int rs2, int32_t off) {
+    uint32_t u = uint32_t(off);
+    return (u >> 12 & 1) << 31 | (u >> 5 & 0x3f) << 25 | uint32_t(rs2) << 20 |
+           uint32_t(rs1) << 15 | funct3 << 12 | (u >> 1 & 0xf) << 8 | (u >> 11 & 1) << 7 | BRANCH;
+}
+
+uint32_t encU(uint32_t opcode, int rd, uint32_t imm20) {
+    return (imm20 & 0xfffff) << 12 | uint32_t(rd) << 7 | opcode;
+}
+
+uint32_t encJ(int rd, int32_t off) {
+    uint32_t u = uint32_t(off);
+    return (u >> 20 & 1) << 31 | (u >> 1 & 0x3ff) << 21 | (u >> 11 & 1) << 20 |
+           (u >> 12 & 0xff) << 12 | uint32_t(rd) << 7 | JAL;
+}
+
+// RVV：OP-V 主操作码与 funct3 类别（OPIVV / OPMVV / OPIVX / OPMVX），只使用不带掩码的形式（vm = 1）
+constexpr uint32_t OP_V = 0x57;
+constexpr uint32_t OPIVV = 0, OPMVV = 2, OPIVX = 4, OPMVX = 6, OPCFG = 7;
+
+uint32_t encV(uint32_t funct6, int vs2, int rs1, uint32_t funct3, int vd) {
+    return funct6 << 26 | 1u << 25 | uint32_t(vs2) << 20 | uint32_t(rs1) << 15 | funct3 << 12 |
+           uint32_t(vd) << 7 | OP_V;
+}
+
+// splitHiLo：把 32 位常量拆为 lui 高 20 位与 addi 低 12 位（低位符号扩展后由高位补偿）
+void splitHiLo(int32_t value, uint32_t &hi20, int32_t &lo12) {
+    lo12 = static_cast<int32_t>(uint32_t(value) << 20) >> 20;
+    hi20 = (uint32_t(value) - uint32_t(lo12)) >> 12;
+}
+
+// BranchForm：条件分支伪指令归一化为真实 B 型指令（bgt/ble 交换操作数，bnez 比较 x0）
+struct BranchForm {
+    uint32_t funct3;
+    int rs1, rs2;
+};
+
+BranchForm branchForm(const MachineInstr &MI) {
+    switch (MI.opcode) {
+    case MOpcode::BEQ:
+        return {0, MI.rs1, MI.rs2};
+    case MOpcode::BNE:
+        return {1, MI.rs1, MI.rs2};
+    case MOpcode::BLT:
+        return {4, MI.rs1, MI.rs2};
+    case MOpcode::BGE:
+        return {5, MI.rs1, MI.rs2};
+    case MOpcode::BGT:
+        return {4, MI.rs2, MI.rs1};
+    case MOpcode::BLE:
+        return {5, MI.rs2, MI.rs1};
+    case MOpcode::BNEZ:
+        return {1, MI.rs1, X0};
+    default:
+        throw std::logic_error("branchForm: not a branch");
+    }
+}
+
+// checkImm12：I/S 型立即数越界时报错（汇编器同样会拒绝此类指令）
+void checkImm12(const MachineFunction &MF, const MachineInstr &MI) {
+    if (!fitsImm12(MI.imm))
+        throw std::runtime_error("immediate " + std::to_string(MI.imm) + " out of range for '" +
+                                 mir::mopcodeName(MI.opcode) + "' in function '" + MF.name +
+                                 "'");
+}
+
+#pragma endregion
+
+#pragma region RV32C 指令编码
+
+// 压缩指令的象限（inst[1:0]）
+constexpr uint16_t C0 = 0, C1 = 1, C2 = 2;
+
+bool fitsImm6(int64_t v) { return v >= -32 && v <= 31; }
+
+// bits：取 v[hi:lo] 放到第 at 位起（压缩格式的立即数字段大多是打乱的位片段）
+uint16_t bits(uint32_t v, int hi, int lo, int at) {
+    return static_cast<uint16_t>((v >> lo & ((1u << (hi - lo + 1)) - 1)) << at);
+}
+
+// creg：x8-x15 → 3 位寄存器字段
+uint16_t creg(int reg) { return static_cast<uint16_t>(reg - 8); }
+
+// encCI：funct3 | imm[5] | rd | imm[4:0] | op（c.li / c.addi / c.slli）
+uint16_t encCI(uint16_t funct3, int rd, uint32_t imm, uint16_t op) {
+    return static_cast<uint16_t>(funct3 << 13 | bits(imm, 5, 5, 12) | rd << 7 |
+                                 bits(imm, 4, 0, 2) | op);
+}
+
+// encCR：funct4 | rd/rs1 | rs2 | op（c.mv / c.add / c.jr）
+uint16_t encCR(uint16_t funct4, int rd, int rs2, uint16_t op) {
+    return static_cast<uint16_t>(funct4 << 12 | rd << 7 | rs2 << 2 | op);
+}
+
+// encCB：c.beqz（funct3 = 110）/ c.bnez（111），偏移 ±256 字节
+uint16_t encCB(uint16_t funct3, int rs1, int32_t off) {
+    uint32_t u = uint32_t(off);
+    return static_cast<uint16_t>(funct3 << 13 | bits(u, 8, 8, 12) | bits(u, 4, 3, 10) |
+                                 creg(rs1) << 7 | bits(u, 7, 6, 5) | bits(u, 2, 1, 3) |
+                                 bits(u, 5, 5, 2) | C1);
+}
+
+// encCJ：c.j，偏移 ±2KiB
+uint16_t encCJ(int32_t off) {
+    uint32_t u = uint32_t(off);
+    return static_cast<uint16_t>(5 << 13 | bits(u, 11, 11, 12) | bits(u, 4, 4, 11) |
+                                 bits(u, 9, 8, 9) | bits(u, 10, 10, 8) | bits(u, 6, 6, 7) |
+                                 bits(u, 7, 7, 6) | bits(u, 3, 1, 3) | bits(u, 5, 5, 2) | C1);
+}
+
+// encCLui：c.lui rd, nzimm（hi20 为 lui 的 20 位立即数，须是 6 位有符号数的符号扩展）
+uint16_t encCLui(int rd, uint32_t hi20) {
+    return static_cast<uint16_t>(3 << 13 | bits(hi20, 5, 5, 12) | rd << 7 | bits(hi20, 4, 0, 2) |
+                                 C1);
+}
+
+// compressibleLui：lui rd, hi20 能否写成 c.lui（rd 不为 x0 / sp，立即数非零且在 6 位有符号范围内）
+bool compressibleLui(int rd, uint32_t hi20) {
+    return rd != X0 && rd != 2 && ((hi20 >= 1 && hi20 <= 31) || (hi20 >= 0xfffe0 && hi20 <= 0xfffff));
+}
+
+// compressedBranchReg：可写成 c.beqz / c.bnez 时返回被比较的寄存器（x8-x15），否则返回 -1
+int compressedBranchReg(const MachineInstr &MI) {
+    BranchForm bf = branchForm(MI);
+    if (bf.funct3 > 1)
+        return -1;
+    int reg = bf.rs2 == X0 ? bf.rs1 : bf.rs1 == X0 ? bf.rs2 : -1;
+    return mir::isCompressibleReg(reg) ? reg : -1;
+}
+
+// encodeCompressed：按 mir::compressedForm 选出的形式编码 16 位指令
+uint16_t encodeCompressed(const MachineInstr &MI, CForm form) {
+    const uint32_t imm = uint32_t(MI.imm);
+    switch (form) {
+    case CForm::Li:
+        return encCI(2, MI.rd, imm, C1);
+    case CForm::Mv:
+        return encCR(0x8, MI.rd, MI.rs1, C2);
+    case CForm::Add:
+        return encCR(0x9, MI.rd, MI.rd == MI.rs1 ? MI.rs2 : MI.rs1, C2);
+    case CForm::Sub:
+        return static_cast<uint16_t>(0x8c00 | creg(MI.rd) << 7 | creg(MI.rs2) << 2 | C1);
+    case CForm::Addi:
+        return encCI(0, MI.rd, imm, C1);
+    case CForm::Addi16sp:
+        return static_cast<uint16_t>(3 << 13 | bits(imm, 9, 9, 12) | 2 << 7 | bits(imm, 4, 4, 6) |
+                                     bits(imm, 6, 6, 5) | bits(imm, 8, 7, 3) | bits(imm, 5, 5, 2) |
+                                     C1);
+    case CForm::Addi4spn:
+        return static_cast<uint16_t>(bits(imm, 5, 4, 11) | bits(imm, 9, 6, 7) | bits(imm, 2, 2, 6) |
+                                     bits(imm, 3, 3, 5) | creg(MI.rd) << 2 | C0);
+    case CForm::Andi:
+        return static_cast<uint16_t>(0x8800 | bits(imm, 5, 5, 12) | creg(MI.rd) << 7 |
+                                     bits(imm, 4, 0, 2) | C1);
+    case CForm::Slli:
+        return encCI(0, MI.rd, imm & 0x1f, C2);
+    case CForm::Srli:
+        return static_cast<uint16_t>(0x8000 | creg(MI.rd) << 7 | bits(imm, 4, 0, 2) | C1);
+    case CForm::Srai:
+        return static_cast<uint16_t>(0x8400 | creg(MI.rd) << 7 | bits(imm, 4, 0, 2) | C1);
+    case CForm::Lw:
+    case CForm::Sw:
+        return static_cast<uint16_t>((form == CForm::Lw ? 0x4000 : 0xc000) | bits(imm, 5, 3, 10) |
+                                     creg(MI.rs1) << 7 | bits(imm, 2, 2, 6) | bits(imm, 6, 6, 5) |
+                                     creg(form == CForm::Lw ? MI.rd : MI.rs2) << 2 | C0);
+    case CForm::Lwsp:
+        return static_cast<uint16_t>(0x4000 | bits(imm, 5, 5, 12) | MI.rd << 7 |
+                                     bits(imm, 4, 2, 4) | bits(imm, 7, 6, 2) | C2);
+    case CForm::Swsp:
+        return static_cast<uint16_t>(0xc000 | bits(imm, 5, 2, 9) | bits(imm, 7, 6, 7) |
+                                     MI.rs2 << 2 | C2);
+    case CForm::Jr:
+        return encCR(0x8, RA, X0, C2);
+    case CForm::None:
+        break;
+    }
+    throw std::logic_error("encodeCompressed: not a compressed form");
+}
+
+} // namespace
+
+#pragma endregion
+
+#pragma region 函数编码
+
+int ELFObjectWriter::getOrAddSymbol(const std::string &name) {
+    auto [it, inserted] = symIndex_.try_emplace(name, static_cast<int>(symbols_.size()));
+    if (inserted)
+        symbols_.push_back(Symbol{name});
+    return it->second;
+}
+
+void ELFObjectWriter::emit16(uint16_t half) {
+    text_.push_back(static_cast<uint8_t>(half));
+    text_.push_back(static_cast<uint8_t>(half >> 8));
+}
+
+void ELFObjectWriter::emit32(uint32_t word) {
+    emit16(static_cast<uint16_t>(word));
+    emit16(static_cast<uint16_t>(word >> 16));
+}
+
+/**
+ * @brief 编码一个机器函数并追加到 .text
+ * @details 两阶段：
+ *   1. 布局 — 按每条指令的编码长度计算块偏移；条件分支与 j 从最短的形式开始（压缩模式下可压缩的
+ *      为 2 字节），越界时依次放宽为 4 字节与 8 字节（反转分支 + jal），迭代至不动点（长度只增不减，
+ *      必然收敛）
+ *   2. 编码 — 块内跳转直接写入 PC 相对偏移；call / tail 写入 auipc+jalr 并记录 R_RISCV_CALL_PLT
+ *      （tail 经 t1 跳转、不写 ra）；压缩模式下 mir::compressedForm 选出的指令写 16 位编码
+ */
+void ELFObjectWriter::addFunction(const MachineFunction &MF) {
+    stats::ScopedTimer timer(stats::Phase::Emit);
+    if (!MF.profileBlocks.empty())
+        throw std::runtime_error("profile instrumentation in function '" + MF.name +
+                                 "' requires assembly output");
+    const uint32_t funcStart = static_cast<uint32_t>(text_.size());
+
+    // liParts：li 展开后各部分的长度（addi 一条，或 lui + 可选的 addi）
+    auto liParts = [&](const MachineInstr &MI, uint32_t &luiSize, uint32_t &addiSize) {
+        uint32_t hi20;
+        int32_t lo12;
+        splitHiLo(MI.imm, hi20, lo12);
+        luiSize = compressed_ && compressibleLui(MI.rd, hi20) ? 2 : 4;
+        addiSize = lo12 == 0 ? 0 : compressed_ && fitsImm6(lo12) ? 2 : 4;
+    };
+
+    // 阶段 1：布局与分支松弛
+    std::vector<std::vector<uint8_t>> instSize(MF.blocks.size());
+    std::vector<uint32_t> blockOffset(MF.blocks.size() + 1);
+    for (size_t bi = 0; bi < MF.blocks.size(); ++bi) {
+        for (const MachineInstr &MI : MF.blocks[bi].insts) {
+            uint32_t size = 4;
+            switch (MI.opcode) {
+            case MOpcode::LI:
+                if (compressed_ && mir::compressedForm(MI) != CForm::None) {
+                    size = 2;
+                } else if (!fitsImm12(MI.imm)) {
+                    uint32_t luiSize, addiSize;
+                    liParts(MI, luiSize, addiSize);
+                    size = luiSize + addiSize;
+                }
+                break;
+            case MOpcode::CALL:
+            case MOpcode::TAIL:
+                size = 8;
+                break;
+            case MOpcode::J:
+                size = compressed_ ? 2 : 4;
+                break;
+            case MOpcode::FrameSetup:
+            case MOpcode::FrameDestroy:
+                throw std::logic_error("ELFObjectWriter: unexpanded frame pseudo in " + MF.name);
+            case MOpcode::ProfCount:
+                throw std::logic_error("ELFObjectWriter: profile counter in " + MF.name);
+            default:
+                if (!compressed_)
+                    break;
+                if (MI.isBranch())
+                    size = compressedBranchReg(MI) >= 0 ? 2 : 4;
+                else if (mir::compressedForm(MI) != CForm::None)
+                    size = 2;
+                break;
+            }
+            instSize[bi].push_back(static_cast<uint8_t>(size));
+        }
+    }
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        uint32_t pc = 0;
+        for (size_t bi = 0; bi < MF.blocks.size(); ++bi) {
+            blockOffset[bi] = pc;
+            for (uint8_t size : instSize[bi])
+                pc += size;
+        }
+        blockOffset[MF.blocks.size()] = pc;
+
+        for (size_t bi = 0; bi < MF.blocks.size(); ++bi) {
+            uint32_t instPc = blockOffset[bi];
+            for (size_t ii = 0; ii < MF.blocks[bi].insts.size(); ++ii) {
+                const MachineInstr &MI = MF.blocks[bi].insts[ii];
+                uint8_t &size = instSize[bi][ii];
+                // 当前长度的可达范围：c.beqz / c.bnez ±256，B 型 ±4KiB，c.j ±2KiB
+                int64_t range = 0;
+                if (MI.isBranch() && size < 8)
+                    range = size == 2 ? 256 : 4096;
+                else if (MI.opcode == MOpcode::J && size == 2)
+                    range = 2048;
+                if (range != 0) {
+                    int64_t disp = int64_t(blockOffset[MI.target]) - instPc;
+                    if (disp < -range || disp > range - 2) {
+                        size = size == 2 ? 4 : 8;
+                        changed = true;
+                    }
+                }
+                instPc += size;
+            }
+        }
+    }
+
+    // 阶段 2：编码
+    size_t numCompressed = 0;
+    for (size_t bi = 0; bi < MF.blocks.size(); ++bi) {
+        for (size_t ii = 0; ii < MF.blocks[bi].insts.size(); ++ii) {
+            const MachineInstr &MI = MF.blocks[bi].insts[ii];
+            const uint8_t size = instSize[bi][ii];
+            const int32_t pc = static_cast<int32_t>(text_.size() - funcStart);
+            auto jumpDisp = [&](int32_t from) -> int32_t {
+                int32_t disp = static_cast<int32_t>(blockOffset[MI.target]) - from;
+                if (disp < -(1 << 20) || disp >= (1 << 20))
+                    throw std::runtime_error("jump target out of range in function '" + MF.name +
+                                             "'");
+                return disp;
+            };
+            if (CForm form = compressed_ ? mir::compressedForm(MI) : CForm::None;
+                form != CForm::None) {
+                emit16(encodeCompressed(MI, form));
+                ++numCompressed;
+                continue;
+            }
+
+            switch (MI.opcode) {
+            case MOpcode::LI: {
+                if (fitsImm12(MI.imm)) {
+                    emit32(encI(OP_IMM, MI.rd, 0, X0, MI.imm));
+                    break;
+                }
+                uint32_t hi20, luiSize, addiSize;
+                int32_t lo12;
+                splitHiLo(MI.imm, hi20, lo12);
+                liParts(MI, luiSize, addiSize);
+                if (luiSize == 2)
+                    emit16(encCLui(MI.rd, hi20));
+                else
+                    emit32(encU(LUI, MI.rd, hi20));
+                if (addiSize == 2)
+                    emit16(encCI(0, MI.rd, uint32_t(lo12), C1));
+                else if (addiSize == 4)
+                    emit32(encI(OP_IMM, MI.rd, 0, MI.rd, lo12));
+                numCompressed += (luiSize == 2) + (addiSize == 2);
+                break;
+            }
+            case MOpcode::MV:
+                emit32(encI(OP_IMM, MI.rd, 0, MI.rs1, 0));
+                break;
+            case MOpcode::ADD:
+                emit32(encR(0x00, MI.rs2, MI.rs1, 0, MI.rd));
+                break;
+            case MOpcode::SUB:
+                emit32(encR(0x20, MI.rs2, MI.rs1, 0, MI.rd));
+                break;
+            case MOpcode::SLT:
+                emit32(encR(0x00, MI.rs2, MI.rs1, 2, MI.rd));
+                break;
+            case MOpcode::MUL:
+                emit32(encR(0x01, MI.rs2, MI.rs1, 0, MI.rd));
+                break;
+            case MOpcode::MULH:
+                emit32(encR(0x01, MI.rs2, MI.rs1, 1, MI.rd));
+                break;
+            case MOpcode::DIV:
+                emit32(encR(0x01, MI.rs2, MI.rs1, 4, MI.rd));
+                break;
+            case MOpcode::REM:
+                emit32(encR(0x01, MI.rs2, MI.rs1, 6, MI.rd));
+                break;
+            case MOpcode::ADDI:
+                checkImm12(MF, MI);
+                emit32(encI(OP_IMM, MI.rd, 0, MI.rs1, MI.imm));
+                break;
+            case MOpcode::XORI:
+                checkImm12(MF, MI);
+                emit32(encI(OP_IMM, MI.rd, 4, MI.rs1, MI.imm));
+                break;
+            case MOpcode::ANDI:
+                checkImm12(MF, MI);
+                emit32(encI(OP_IMM, MI.rd, 7, MI.rs1, MI.imm));
+                break;
+            case MOpcode::SLLI: // 移位量占 imm[4:0]，srai 另置 imm[10]
+                emit32(encI(OP_IMM, MI.rd, 1, MI.rs1, MI.imm & 0x1f));
+                break;
+            case MOpcode::SRLI:
+                emit32(encI(OP_IMM, MI.rd, 5, MI.rs1, MI.imm & 0x1f));
+                break;
+            case MOpcode::SRAI:
+                emit32(encI(OP_IMM, MI.rd, 5, MI.rs1, 0x400 | (MI.imm & 0x1f)));
+                break;
+            case MOpcode::SEQZ: // sltiu rd, rs, 1
+                emit32(encI(OP_IMM, MI.rd, 3, MI.rs1, 1));
+                break;
+            case MOpcode::SNEZ: // sltu rd, x0, rs
+                emit32(encR(0x00, MI.rs1, X0, 3, MI.rd));
+                break;
+            case MOpcode::LW:
+                checkImm12(MF, MI);
+                emit32(encI(LOAD, MI.rd, 2, MI.rs1, MI.imm));
+                break;
+            case MOpcode::LB:
+                checkImm12(MF, MI);
+                emit32(encI(LOAD, MI.rd, 0, MI.rs1, MI.imm));
+                break;
+            case MOpcode::SW:
+                checkImm12(MF, MI);
+                emit32(encS(2, MI.rs1, MI.rs2, MI.imm));
+                break;
+            case MOpcode::SB:
+                checkImm12(MF, MI);
+                emit32(encS(0, MI.rs1, MI.rs2, MI.imm));
+                break;
+            case MOpcode::BEQ:
+            case MOpcode::BNE:
+            case MOpcode::BLT:
+            case MOpcode::BGE:
+            case MOpcode::BGT:
+            case MOpcode::BLE:
+            case MOpcode::BNEZ: {
+                BranchForm bf = branchForm(MI);
+                if (size == 2) {
+                    emit16(encCB(6 + bf.funct3, compressedBranchReg(MI), jumpDisp(pc)));
+                    ++numCompressed;
+                } else if (size == 4) {
+                    emit32(encB(bf.funct3, bf.rs1, bf.rs2, jumpDisp(pc)));
+                } else {
+                    // 长分支：反转条件（funct3 最低位取反）跳过紧随其后的 jal
+                    emit32(encB(bf.funct3 ^ 1, bf.rs1, bf.rs2, 8));
+                    emit32(encJ(X0, jumpDisp(pc + 4)));
+                }
+                break;
+            }
+            case MOpcode::J:
+                if (size == 2) {
+                    emit16(encCJ(jumpDisp(pc)));
+                    ++numCompressed;
+                } else {
+                    emit32(encJ(X0, jumpDisp(pc)));
+                }
+                break;
+            case MOpcode::CALL: {
+                int sym = getOrAddSymbol(MI.sym.str());
+                relocs_.push_back({static_cast<uint32_t>(text_.size()), sym, R_RISCV_CALL_PLT});
+                emit32(encU(AUIPC, RA, 0));
+                emit32(encI(JALR, RA, 0, RA, 0));
+                break;
+            }
+            case MOpcode::TAIL: {
+                int sym = getOrAddSymbol(MI.sym.str());
+                relocs_.push_back({static_cast<uint32_t>(text_.size()), sym, R_RISCV_CALL_PLT});
+                emit32(encU(AUIPC, T1, 0));
+                emit32(encI(JALR, X0, 0, T1, 0));
+                break;
+            }
+            case MOpcode::RET:
+                emit32(encI(JALR, X0, 0, RA, 0));
+                break;
+            case MOpcode::VSETVLI:
+                emit32(encI(OP_V, MI.rd, OPCFG, MI.rs1, MI.imm & 0x7ff));
+                break;
+            case MOpcode::VADD_VV:
+                emit32(encV(0x00, MI.rs1, MI.rs2, OPIVV, MI.rd));
+                break;
+            case MOpcode::VSUB_VV:
+                emit32(encV(0x02, MI.rs1, MI.rs2, OPIVV, MI.rd));
+                break;
+            case MOpcode::VMUL_VV:
+                emit32(encV(0x25, MI.rs1, MI.rs2, OPMVV, MI.rd));
+                break;
+            case MOpcode::VDIV_VV:
+                emit32(encV(0x21, MI.rs1, MI.rs2, OPMVV, MI.rd));
+                break;
+            case MOpcode::VREM_VV:
+                emit32(encV(0x23, MI.rs1, MI.rs2, OPMVV, MI.rd));
+                break;
+            case MOpcode::VADD_VX:
+                emit32(encV(0x00, MI.rs1, MI.rs2, OPIVX, MI.rd));
+                break;
+            case MOpcode::VMV_V_X:
+                emit32(encV(0x17, 0, MI.rs1, OPIVX, MI.rd));
+                break;
+            case MOpcode::VID_V:
+                emit32(encV(0x14, 0, 0x11, OPMVV, MI.rd));
+                break;
+            case MOpcode::VREDSUM_VS:
+                emit32(encV(0x00, MI.rs1, MI.rs2, OPMVV, MI.rd));
+                break;
+            case MOpcode::VMV_S_X:
+                emit32(encV(0x10, 0, MI.rs1, OPMVX, MI.rd));
+                break;
+            case MOpcode::VMV_X_S:
+                emit32(encV(0x10, MI.rs1, 0, OPMVV, MI.rd));
+                break;
+            case MOpcode::FrameSetup:
+            case MOpcode::FrameDestroy:
+            case MOpcode::ProfCount:
+                break; // 布局阶段已报错
+            }
+        }
+    }
+
+    Symbol &fn = symbols_[getOrAddSymbol(MF.name)];
+    if (fn.defined)
+        throw std::runtime_error("duplicate definition of function '" + MF.name + "'");
+    fn.defined = true;
+    fn.value = funcStart;
+    fn.size = static_cast<uint32_t>(text_.size()) - funcStart;
+    stats::add(stats::Counter::CompressedInsts, numCompressed);
+    stats::add(stats::Counter::TextBytes, fn.size);
+}
+
+#pragma endregion
+
+#pragma region ELF 输出
+
+namespace {
+
+// ByteWriter：小端序字节缓冲区
+struct ByteWriter {
+    std::vector<uint8_t> bytes;
+
+    void u8(uint8_t v) { bytes.push_back(v); }
+    void u16(uint16_t v) {
+        u8(static_cast<uint8_t>(v));
+        u8(static_cast<uint8_t>(v >> 8));
+    }
+    void u32(uint32_t v) {
+        u16(static_cast<uint16_t>(v));
+        u16(static_cast<uint16_t>(v >> 16));
+    }
+    void append(const std::vector<uint8_t> &data) {
+        bytes.insert(bytes.end(), data.begin(), data.end());
+    }
+    void align(size_t a) {
+        while (bytes.size() % a)
+            bytes.push_back(0);
+    }
+    uint32_t size() const { return static_cast<uint32_t>(bytes.size()); }
+};
+
+// StrTab：ELF 字符串表（首字节为空串）
+struct StrTab {
+    std::vector<uint8_t> data{0};
+
+    uint32_t add(const std::string &s) {
+        uint32_t off = static_cast<uint32_t>(data.size());
+        data.insert(data.end(), s.begin(), s.end());
+        data.push_back(0);
+        return off;
+    }
+};
+
+} // namespace
+
+/**
+ * @brief 输出 ELF32 可重定位目标文件
+ * @details 文件布局：ELF 头 | .text | .rela.text | .symtab | .strtab | .shstrtab | 节头表
+ *   符号表：空符号、.text 节符号（局部），随后是全局符号（已定义函数为 STT_FUNC，外部引用为 UND）
+ */
+void ELFObjectWriter::write(std::ostream &os) const {
+    stats::ScopedTimer timer(stats::Phase::Emit);
+    // 符号表与字符串表
+    StrTab strtab;
+    ByteWriter symtab;
+    auto putSym = [&](uint32_t name, uint32_t value, uint32_t size, uint8_t bind, uint8_t type,
+                      uint16_t shndx) {
+        symtab.u32(name);
+        symtab.u32(value);
+        symtab.u32(size);
+        symtab.u8(static_cast<uint8_t>(bind << 4 | type));
+        symtab.u8(0);
+        symtab.u16(shndx);
+    };
+    putSym(0, 0, 0, STB_LOCAL, STT_NOTYPE, SEC_NULL);
+    putSym(0, 0, 0, STB_LOCAL, STT_SECTION, SEC_TEXT);
+    for (const auto &sym : symbols_) {
+        uint32_t name = strtab.add(sym.name);
+        if (sym.defined)
+            putSym(name, sym.value, sym.size, STB_GLOBAL, STT_FUNC, SEC_TEXT);
+        else
+            putSym(name, 0, 0, STB_GLOBAL, STT_NOTYPE, SEC_NULL);
+    }
+
+    ByteWriter rela;
+    for (const auto &r : relocs_) {
+        rela.u32(r.offset);
+        rela.u32((static_cast<uint32_t>(r.symbol) + FIRST_GLOBAL_SYM) << 8 | r.type);
+        rela.u32(0); // r_addend
+    }
+
+    StrTab shstrtab;
+    const uint32_t nameText = shstrtab.add(".text");
+    const uint32_t nameRela = shstrtab.add(".rela.text");
+    const uint32_t nameSymtab = shstrtab.add(".symtab");
+    const uint32_t nameStrtab = shstrtab.add(".strtab");
+    const uint32_t nameShstrtab = shstrtab.add(".shstrtab");
+
+    // 节内容按顺序排布在 ELF 头之后
+    ByteWriter body;
+    body.bytes.resize(EHDR_SIZE);
+    auto place = [&](const std::vector<uint8_t> &data, size_t align) {
+        body.align(align);
+        uint32_t off = body.size();
+        body.append(data);
+        return off;
+    };
+    const uint32_t offText = place(text_, 4);
+    const uint32_t offRela = place(rela.bytes, 4);
+    const uint32_t offSymtab = place(symtab.bytes, 4);
+    const uint32_t offStrtab = place(strtab.data, 1);
+    const uint32_t offShstrtab = place(shstrtab.data, 1);
+    body.align(4);
+    const uint32_t shoff = body.size();
+
+    // 节头表
+    auto putShdr = [&](uint32_t name, uint32_t type, uint32_t flags, uint32_t offset, uint32_t size,
+                       uint32_t link, uint32_t info, uint32_t align, uint32_t entsize) {
+        body.u32(name);
+        body.u32(type);
+        body.u32(flags);
+        body.u32(0); // sh_addr
+        body.u32(offset);
+        body.u32(size);
+        body.u32(link);
+        body.u32(info);
+        body.u32(align);
+        body.u32(entsize);
+    };
+    putShdr(0, 0, 0, 0, 0, 0, 0, 0, 0);
+    putShdr(nameText, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, offText,
+            static_cast<uint32_t>(text_.size()), 0, 0, 4, 0);
+    putShdr(nameRela, SHT_RELA, SHF_INFO_LINK, offRela, rela.size(), SEC_SYMTAB, SEC_TEXT, 4,
+            RELA_SIZE);
+    putShdr(nameSymtab, SHT_SYMTAB, 0, offSymtab, symtab.size(), SEC_STRTAB, FIRST_GLOBAL_SYM, 4,
+            SYM_SIZE);
+    putShdr(nameStrtab, SHT_STRTAB, 0, offStrtab, static_cast<uint32_t>(strtab.data.size()), 0, 0,
+            1, 0);
+    putShdr(nameShstrtab, SHT_STRTAB, 0, offShstrtab, static_cast<uint32_t>(shstrtab.data.size()),
+            0, 0, 1, 0);
+
+    // ELF 头（回填到缓冲区起始处）
+    ByteWriter ehdr;
+    const uint8_t ident[16] = {0x7f, 'E', 'L', 'F', 1 /*ELFCLASS32*/, 1 /*ELFDATA2LSB*/,
+                               1 /*EV_CURRENT*/};
+    for (uint8_t b : ident)
+        ehdr.u8(b);
+    ehdr.u16(ET_REL);
+    ehdr.u16(EM_RISCV);
+    ehdr.u32(1); // e_version
+    ehdr.u32(0); // e_entry
+    ehdr.u32(0); // e_phoff
+    ehdr.u32(shoff);
+    ehdr.u32(compressed_ ? EF_RISCV_RVC : 0); // e_flags：软浮点 ABI，压缩模式下置 RVC 位
+    ehdr.u16(static_cast<uint16_t>(EHDR_SIZE));
+    ehdr.u16(0); // e_phentsize
+    ehdr.u16(0); // e_phnum
+    ehdr.u16(static_cast<uint16_t>(SHDR_SIZE));
+    ehdr.u16(SEC_COUNT);
+    ehdr.u16(SEC_SHSTRTAB);
+    std::copy(ehdr.bytes.begin(), ehdr.bytes.end(), body.bytes.begin());
+
+    os.write(reinterpret_cast<const char *>(body.bytes.data()),
+             static_cast<std::streamsize>(body.bytes.size()));
+}
+
+#pragma endregion
+
+} // namespace toyc
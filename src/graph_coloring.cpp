@@ -0,0 +1,642 @@
+#include "ir_analysis.h"
+#include "ir_passes.h"
+#include "reg_alloc.h"
+#include "statistics.h"
+#include <algorithm>
+#include <climits>
+
+namespace toyc {
+
+using namespace ir;
+
+namespace {
+
+// 预着色节点的度（不会被简化，也不会被递减）
+constexpr int kInfiniteDegree = INT_MAX / 2;
+
+// SparseLiveSet：反向扫描中的活跃集合（插入 / 删除 / 查询 O(1)，遍历只访问成员）
+class SparseLiveSet {
+  public:
+    explicit SparseLiveSet(size_t n) : index_(n, -1) {}
+    bool contains(int v) const { return index_[v] >= 0; }
+    void insert(int v) {
+        if (index_[v] < 0) {
+            index_[v] = static_cast<int>(dense_.size());
+            dense_.push_back(v);
+        }
+    }
+    void erase(int v) {
+        int i = index_[v];
+        if (i < 0)
+            return;
+        int last = dense_.back();
+        dense_[i] = last;
+        index_[last] = i;
+        dense_.pop_back();
+        index_[v] = -1;
+    }
+    void clear() {
+        for (int v : dense_)
+            index_[v] = -1;
+        dense_.clear();
+    }
+    const std::vector<int> &members() const { return dense_; }
+
+  private:
+    std::vector<int> index_; // vreg → dense_ 下标（-1 = 不在集合中）
+    std::vector<int> dense_;
+};
+
+// edgeKey：无向边 (u, v) 的打包键
+uint64_t edgeKey(int u, int v) {
+    if (u > v)
+        std::swap(u, v);
+    return (static_cast<uint64_t>(static_cast<uint32_t>(u)) << 32) | static_cast<uint32_t>(v);
+}
+
+} // namespace
+
+#pragma region 图着色分配器实现
+
+GraphColoringAllocator::GraphColoringAllocator(const RegInfo &regInfo) : RegisterAllocator(regInfo) {
+    colorOrder_.assign(regInfo_.allocatableRegs.begin(), regInfo_.allocatableRegs.end());
+    K_ = static_cast<int>(colorOrder_.size());
+}
+
+/**
+ * @brief 对函数执行图着色寄存器分配
+ * @param F 目标函数 IR（含 phi 时先消除为拷贝）
+ * @return 分配结果
+ * @details 流程：
+ *   1. phi 消除 + 拷贝传播 + 活跃性分析
+ *   2. 构建冲突图与传送列表（build），预着色不跨越调用的寄存器参数，收集调用约定偏好
+ *   3. 迭代：简化 → 合并 → 冻结 → 选择潜在溢出，直到所有工作表为空
+ *   4. 按栈逆序着色（assignColors），着色失败的节点溢出到栈
+ *   5. 填写 AllocationResult（含每个调用点需要保存的调用者保存寄存器）
+ */
+AllocationResult GraphColoringAllocator::allocate(ir::Function &F) {
+    if (opt::hasPhis(F)) {
+        opt::eliminatePhis(F);
+        opt::propagateCopies(F);
+    }
+
+    {
+        stats::ScopedTimer timer(stats::Phase::Liveness);
+        LivenessAnalysis().run(F);
+    }
+
+    {
+        stats::ScopedTimer timer(stats::Phase::GraphColor);
+        reset(F);
+        build(F);
+        hints_ = computeRegHints(F);
+        precolorParameters(F);
+        makeWorklist();
+        while (!simplifyWorklist_.empty() || !worklistMoves_.empty() || !freezeWorklist_.empty() ||
+               !spillWorklist_.empty()) {
+            if (!simplifyWorklist_.empty())
+                simplify();
+            else if (!worklistMoves_.empty())
+                coalesce();
+            else if (!freezeWorklist_.empty())
+                freeze();
+            else
+                selectSpill();
+        }
+        assignColors();
+        buildResult(F);
+    }
+    rematerializeConstants(F, result_);
+    colorStackSlots(F, result_);
+
+    size_t coalesced = std::count(moveState_.begin(), moveState_.end(), MoveState::Coalesced);
+    if (debugOutput_) {
+        size_t nodes = 0;
+        for (NodeState s : state_)
+            nodes += s != NodeState::None;
+        *debugOutput_ << "graph: " << nodes << " nodes, " << adjSet_.size() << " edges, "
+                      << moves_.size() << " moves (" << coalesced << " coalesced), "
+                      << result_.vregToStack.size() << " on stack\n";
+    }
+    stats::add(stats::Counter::VRegs, static_cast<uint64_t>(F.maxVregId + 1));
+    stats::add(stats::Counter::Spills, result_.vregToStack.size());
+    stats::add(stats::Counter::SpillCost, result_.spillCost);
+    stats::add(stats::Counter::CoalescedMoves, coalesced);
+    return result_;
+}
+
+/**
+ * @brief 重置全部状态并确定参与着色的节点
+ * @details 在可达块中出现（def 或 use）的 vreg 是节点；alloca 的结果是帧内偏移，
+ *   栈传入的参数（第 9 个起）固定在调用者的出参区，二者都不进入寄存器，不是节点
+ */
+void GraphColoringAllocator::reset(const ir::Function &F) {
+    const size_t n = static_cast<size_t>(F.maxVregId + 1);
+    result_ = AllocationResult{};
+    state_.assign(n, NodeState::None);
+    degree_.assign(n, 0);
+    alias_.assign(n, -1);
+    color_.assign(n, -1);
+    weight_.assign(n, 0);
+    callClobbers_.assign(n, 0);
+    adjList_.assign(n, {});
+    adjSet_.clear();
+    moveList_.assign(n, {});
+    moves_.clear();
+    moveState_.clear();
+    simplifyWorklist_.clear();
+    freezeWorklist_.clear();
+    spillWorklist_.clear();
+    worklistMoves_.clear();
+    selectStack_.clear();
+    callLive_.clear();
+
+    for (auto *bb : F.rpoOrder)
+        for (auto *inst : bb->insts) {
+            if (int d = inst->defReg(); d >= 0)
+                state_[d] = NodeState::Initial;
+            inst->forEachUse([&](int u) { state_[u] = NodeState::Initial; });
+        }
+    for (auto *bb : F.rpoOrder)
+        for (auto *inst : bb->insts)
+            if (inst->opcode == Opcode::Alloca)
+                state_[inst->defReg()] = NodeState::None;
+    for (size_t i = 8; i < F.paramVregs.size(); ++i)
+        state_[F.paramVregs[i]] = NodeState::None;
+}
+
+/**
+ * @brief 构建冲突图、传送列表、溢出权重与调用点的活跃集合
+ * @details 每个基本块从 liveOut 出发反向扫描：
+ *   - 定义 d 与此刻（指令之后）活跃的所有节点冲突；copy d = s 的 s 先移出活跃集合，
+ *     d 与 s 不因这条拷贝冲突，二者记为一条可合并的传送
+ *   - call 之后仍活跃的节点（call 自身的结果除外）并入该调用破坏的寄存器（callClobbers_），并记下这个集合
+ *   - 每次 def / use 为节点累计所在块执行频率（blockFrequency）的溢出权重，传送的权重同样取所在块的频率
+ *   入口块的 liveIn（参数与未定义即使用的 vreg）在函数入口同时活跃，两两冲突。
+ *   传送按权重降序排列，合并时先处理循环中的拷贝
+ */
+void GraphColoringAllocator::build(ir::Function &F) {
+    auto isNode = [&](int v) { return v >= 0 && state_[v] != NodeState::None; };
+    const LoopInfo &loops = F.analyses().loops();
+    SparseLiveSet live(state_.size());
+
+    for (auto *bb : F.rpoOrder) {
+        const uint64_t w = blockFrequency(F, loops, bb);
+
+        live.clear();
+        bb->liveOut.forEach([&](int v) {
+            if (isNode(v))
+                live.insert(v);
+        });
+        for (auto it = bb->insts.rbegin(); it != bb->insts.rend(); ++it) {
+            const Instruction &inst = **it;
+            int d = isNode(inst.defReg()) ? inst.defReg() : -1;
+            if (d >= 0)
+                weight_[d] += w;
+            inst.forEachUse([&](int u) {
+                if (isNode(u))
+                    weight_[u] += w;
+            });
+
+            if (inst.opcode == Opcode::Copy && d >= 0 && inst.ops[0].isVReg()) {
+                int s = inst.ops[0].regId();
+                if (isNode(s) && s != d) {
+                    live.erase(s);
+                    moves_.push_back(Move{d, s, w});
+                }
+            }
+            if (inst.isCallInst()) {
+                const RegMask clobbers = callClobbers(inst);
+                std::vector<int> after;
+                for (int v : live.members())
+                    if (v != inst.defReg()) {
+                        callClobbers_[v] |= clobbers;
+                        after.push_back(v);
+                    }
+                std::sort(after.begin(), after.end());
+                callLive_.emplace_back(&inst, std::move(after));
+            }
+            if (d >= 0) {
+                for (int v : live.members())
+                    addEdge(d, v);
+                live.erase(d);
+            }
+            inst.forEachUse([&](int u) {
+                if (isNode(u))
+                    live.insert(u);
+            });
+        }
+
+        if (bb == F.entryBlock()) {
+            const auto &entryLive = live.members();
+            for (size_t i = 0; i < entryLive.size(); ++i)
+                for (size_t j = i + 1; j < entryLive.size(); ++j)
+                    addEdge(entryLive[i], entryLive[j]);
+        }
+    }
+
+    std::stable_sort(moves_.begin(), moves_.end(),
+                     [](const Move &a, const Move &b) { return a.weight > b.weight; });
+    moveState_.assign(moves_.size(), MoveState::Worklist);
+    for (size_t i = 0; i < moves_.size(); ++i) {
+        int m = static_cast<int>(i);
+        moveList_[moves_[i].dst].push_back(m);
+        moveList_[moves_[i].src].push_back(m);
+        worklistMoves_.insert(m);
+    }
+}
+
+// addEdge：加入冲突边 (u, v)；预着色节点不维护邻接表，度恒为无穷
+void GraphColoringAllocator::addEdge(int u, int v) {
+    if (u == v || !adjSet_.insert(edgeKey(u, v)).second)
+        return;
+    if (state_[u] != NodeState::Precolored) {
+        adjList_[u].push_back(v);
+        ++degree_[u];
+    }
+    if (state_[v] != NodeState::Precolored) {
+        adjList_[v].push_back(u);
+        ++degree_[v];
+    }
+}
+
+bool GraphColoringAllocator::adjacent(int u, int v) const {
+    return adjSet_.count(edgeKey(u, v)) != 0;
+}
+
+/**
+ * @brief 预着色寄存器参数
+ * @details 与线性扫描相同：前 8 个参数到达 a0-a7，到达寄存器不被跨越的调用破坏的直接绑定到它
+ *   （预着色节点）；跨越调用的作为普通节点着色（通常得到 s 寄存器），由代码生成在入口处搬移。
+ *   预着色之前加入的边已经计入对方的度，预着色节点自身的邻接表在这里清空
+ */
+void GraphColoringAllocator::precolorParameters(const ir::Function &F) {
+    for (size_t i = 0; i < F.paramVregs.size() && i < 8; ++i) {
+        int vreg = F.paramVregs[i];
+        if (state_[vreg] != NodeState::Initial ||
+            !preservedAcross(10 + static_cast<int>(i), callClobbers_[vreg]))
+            continue;
+        state_[vreg] = NodeState::Precolored;
+        color_[vreg] = 10 + static_cast<int>(i); // a0=x10 .. a7=x17
+        degree_[vreg] = kInfiniteDegree;
+        adjList_[vreg].clear();
+    }
+}
+
+// makeWorklist：把初始节点按度与是否与传送相关分入 spill / freeze / simplify 工作表
+void GraphColoringAllocator::makeWorklist() {
+    for (size_t i = 0; i < state_.size(); ++i) {
+        int n = static_cast<int>(i);
+        if (state_[n] != NodeState::Initial)
+            continue;
+        if (degree_[n] >= K_)
+            moveNode(n, NodeState::Spill);
+        else if (moveRelated(n))
+            moveNode(n, NodeState::Freeze);
+        else
+            moveNode(n, NodeState::Simplify);
+    }
+}
+
+// forEachAdjacent：枚举仍在图中的邻居（不含已简化入栈与已合并的节点）
+template <typename Fn> void GraphColoringAllocator::forEachAdjacent(int n, Fn &&fn) const {
+    for (int m : adjList_[n])
+        if (state_[m] != NodeState::SelectStack && state_[m] != NodeState::Coalesced)
+            fn(m);
+}
+
+// moveRelated：节点是否还有尚未处理（待合并或暂缓）的传送
+bool GraphColoringAllocator::moveRelated(int n) const {
+    for (int m : moveList_[n])
+        if (moveState_[m] == MoveState::Worklist || moveState_[m] == MoveState::Active)
+            return true;
+    return false;
+}
+
+// moveNode：把节点移入 to 对应的工作表（同时移出原工作表）
+void GraphColoringAllocator::moveNode(int n, NodeState to) {
+    switch (state_[n]) {
+    case NodeState::Simplify:
+        simplifyWorklist_.erase(n);
+        break;
+    case NodeState::Freeze:
+        freezeWorklist_.erase(n);
+        break;
+    case NodeState::Spill:
+        spillWorklist_.erase(n);
+        break;
+    default:
+        break;
+    }
+    state_[n] = to;
+    switch (to) {
+    case NodeState::Simplify:
+        simplifyWorklist_.insert(n);
+        break;
+    case NodeState::Freeze:
+        freezeWorklist_.insert(n);
+        break;
+    case NodeState::Spill:
+        spillWorklist_.insert(n);
+        break;
+    default:
+        break;
+    }
+}
+
+// simplify：移走一个低度、与传送无关的节点（压入选择栈），邻居的度随之减一
+void GraphColoringAllocator::simplify() {
+    int n = *simplifyWorklist_.begin();
+    moveNode(n, NodeState::SelectStack);
+    selectStack_.push_back(n);
+    forEachAdjacent(n, [&](int m) { decrementDegree(m); });
+}
+
+// decrementDegree：度从 K 降到 K - 1 的节点变为低度，它与邻居的传送重新参与合并
+void GraphColoringAllocator::decrementDegree(int m) {
+    if (state_[m] == NodeState::Precolored)
+        return;
+    if (degree_[m]-- != K_)
+        return;
+    enableMoves(m);
+    forEachAdjacent(m, [&](int t) { enableMoves(t); });
+    if (state_[m] == NodeState::Spill)
+        moveNode(m, moveRelated(m) ? NodeState::Freeze : NodeState::Simplify);
+}
+
+// enableMoves：节点 n 暂缓（Active）的传送回到合并工作表
+void GraphColoringAllocator::enableMoves(int n) {
+    for (int m : moveList_[n])
+        if (moveState_[m] == MoveState::Active) {
+            moveState_[m] = MoveState::Worklist;
+            worklistMoves_.insert(m);
+        }
+}
+
+/**
+ * @brief 尝试合并一条传送（权重最大者优先）
+ * @details 两端已冲突、或两端都是预着色节点时传送受限（Constrained），永不合并；
+ *   一端预着色时用 George 测试（另一端的每个邻居要么低度，要么已与预着色节点冲突），
+ *   否则用 Briggs 测试（合并后高度邻居少于 K 个）。跨越调用的节点不与颜色会被这些调用破坏的
+ *   预着色节点（a0-a7 中的参数）合并，否则它只能留在每个调用点都要保存的寄存器中。
+ *   测试不通过的传送暂缓（Active），邻居的度下降后可能重新参与
+ */
+void GraphColoringAllocator::coalesce() {
+    int m = *worklistMoves_.begin();
+    worklistMoves_.erase(worklistMoves_.begin());
+    int x = getAlias(moves_[m].src), y = getAlias(moves_[m].dst);
+    int u = x, v = y;
+    if (state_[y] == NodeState::Precolored)
+        std::swap(u, v);
+    const bool uPre = state_[u] == NodeState::Precolored;
+
+    if (u == v) {
+        moveState_[m] = MoveState::Coalesced;
+        addWorkList(u);
+    } else if (state_[v] == NodeState::Precolored || adjacent(u, v) ||
+               (uPre && !preservedAcross(color_[u], callClobbers_[v]))) {
+        moveState_[m] = MoveState::Constrained;
+        addWorkList(u);
+        addWorkList(v);
+    } else {
+        bool safe = true;
+        if (uPre)
+            forEachAdjacent(v, [&](int t) { safe = safe && ok(t, u); });
+        else
+            safe = conservative(u, v);
+        if (safe) {
+            moveState_[m] = MoveState::Coalesced;
+            combine(u, v);
+            addWorkList(u);
+        } else {
+            moveState_[m] = MoveState::Active;
+        }
+    }
+}
+
+// addWorkList：低度且不再与传送相关的节点从冻结表转入简化表
+void GraphColoringAllocator::addWorkList(int u) {
+    if (state_[u] == NodeState::Freeze && !moveRelated(u) && degree_[u] < K_)
+        moveNode(u, NodeState::Simplify);
+}
+
+// ok：George 测试的单个邻居条件
+bool GraphColoringAllocator::ok(int t, int r) const {
+    return degree_[t] < K_ || state_[t] == NodeState::Precolored || adjacent(t, r);
+}
+
+// conservative：Briggs 测试——u、v 合并后的邻居中度 >= K 的少于 K 个
+bool GraphColoringAllocator::conservative(int u, int v) const {
+    std::vector<int> nodes;
+    forEachAdjacent(u, [&](int t) { nodes.push_back(t); });
+    forEachAdjacent(v, [&](int t) { nodes.push_back(t); });
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    int k = 0;
+    for (int t : nodes)
+        if (degree_[t] >= K_)
+            ++k;
+    return k < K_;
+}
+
+// getAlias：沿合并链找到代表节点
+int GraphColoringAllocator::getAlias(int n) const {
+    while (state_[n] == NodeState::Coalesced)
+        n = alias_[n];
+    return n;
+}
+
+/**
+ * @brief 把 v 合并进 u
+ * @details v 的传送、邻居、溢出权重与跨越调用破坏的寄存器并入 u；
+ *   合并后 u 变为高度时从冻结表转入溢出表
+ */
+void GraphColoringAllocator::combine(int u, int v) {
+    moveNode(v, NodeState::Coalesced);
+    alias_[v] = u;
+    moveList_[u].insert(moveList_[u].end(), moveList_[v].begin(), moveList_[v].end());
+    weight_[u] += weight_[v];
+    callClobbers_[u] |= callClobbers_[v];
+    enableMoves(v);
+    forEachAdjacent(v, [&](int t) {
+        addEdge(t, u);
+        decrementDegree(t);
+    });
+    if (degree_[u] >= K_ && state_[u] == NodeState::Freeze)
+        moveNode(u, NodeState::Spill);
+}
+
+// freeze：放弃一个低度节点的全部传送，使它可以被简化
+void GraphColoringAllocator::freeze() {
+    int u = *freezeWorklist_.begin();
+    moveNode(u, NodeState::Simplify);
+    freezeMoves(u);
+}
+
+// freezeMoves：冻结 u 的未处理传送；另一端因此与传送无关且低度时转入简化表
+void GraphColoringAllocator::freezeMoves(int u) {
+    for (int m : moveList_[u]) {
+        if (moveState_[m] != MoveState::Worklist && moveState_[m] != MoveState::Active)
+            continue;
+        int x = moves_[m].dst, y = moves_[m].src;
+        int v = getAlias(y) == getAlias(u) ? getAlias(x) : getAlias(y);
+        worklistMoves_.erase(m);
+        moveState_[m] = MoveState::Frozen;
+        if (state_[v] == NodeState::Freeze && !moveRelated(v) && degree_[v] < K_)
+            moveNode(v, NodeState::Simplify);
+    }
+}
+
+/**
+ * @brief 选择一个潜在溢出节点（乐观着色：先简化入栈，着色时仍可能得到颜色）
+ * @details 取 权重 / 度 最小者：访存代价低、同时移走后让出最多冲突的节点（相同时取 vreg 小者）
+ */
+void GraphColoringAllocator::selectSpill() {
+    int best = -1;
+    for (int n : spillWorklist_) {
+        if (best < 0) {
+            best = n;
+            continue;
+        }
+        // weight[n] / degree[n] < weight[best] / degree[best]（交叉相乘，避免浮点）
+        uint64_t lhs = weight_[n] * static_cast<uint64_t>(degree_[best]);
+        uint64_t rhs = weight_[best] * static_cast<uint64_t>(degree_[n]);
+        if (lhs < rhs)
+            best = n;
+    }
+    moveNode(best, NodeState::Simplify);
+    freezeMoves(best);
+}
+
+/**
+ * @brief 按选择栈逆序着色
+ * @details 可用颜色 = 可分配寄存器 − 已着色 / 预着色邻居（取代表节点）的颜色。
+ *   跨越调用的节点只要还有能原样跨越这些调用的寄存器就只在它们之中选（按 ABI 即被调用者保存
+ *   寄存器，序言 / 尾声各保存一次，而不是每个调用点；过程间分配时还包括被调函数不改写的调用者
+ *   保存寄存器）；在候选颜色中优先取已着色的传送伙伴的颜色（偏置着色：
+ *   未能合并的传送在两端同色时仍然是空操作）或调用约定偏好，二者按权重比较，
+ *   都没有时按寄存器优先级取第一个。偏好先汇总到代表节点（合并进来的节点的偏好同样有效）。
+ *   没有可用颜色的节点成为实际溢出；最后已合并的节点取其代表节点的颜色
+ */
+void GraphColoringAllocator::assignColors() {
+    for (size_t v = 0; v < hints_.size(); ++v) {
+        int rep = getAlias(static_cast<int>(v));
+        if (static_cast<size_t>(rep) != v && hints_[v].weight > hints_[rep].weight)
+            hints_[rep] = hints_[v];
+    }
+
+    std::vector<char> forbidden(32);
+    std::vector<int> candidates;
+    while (!selectStack_.empty()) {
+        int n = selectStack_.back();
+        selectStack_.pop_back();
+
+        std::fill(forbidden.begin(), forbidden.end(), 0);
+        for (int w : adjList_[n]) {
+            int a = getAlias(w);
+            if (state_[a] == NodeState::Colored || state_[a] == NodeState::Precolored)
+                forbidden[color_[a]] = 1;
+        }
+        candidates.clear();
+        for (int r : colorOrder_)
+            if (!forbidden[r])
+                candidates.push_back(r);
+        if (candidates.empty()) {
+            state_[n] = NodeState::Spilled;
+            logSpill({n, SpillReason::Uncolorable, 1, -1, weight_[n], -1});
+            continue;
+        }
+        if (callClobbers_[n]) {
+            auto kept = std::stable_partition(candidates.begin(), candidates.end(), [&](int r) {
+                return preservedAcross(r, callClobbers_[n]);
+            });
+            if (kept != candidates.begin())
+                candidates.erase(kept, candidates.end());
+        }
+
+        int chosen = candidates.front();
+        uint64_t bestWeight = 0;
+        const RegHint &hint = hints_[n];
+        if (hint.reg >= 0 && std::find(candidates.begin(), candidates.end(), hint.reg) !=
+                                 candidates.end()) {
+            chosen = hint.reg;
+            bestWeight = hint.weight;
+        }
+        for (int m : moveList_[n]) {
+            int partner = getAlias(moves_[m].dst) == n ? getAlias(moves_[m].src)
+                                                        : getAlias(moves_[m].dst);
+            if ((state_[partner] != NodeState::Colored &&
+                 state_[partner] != NodeState::Precolored) ||
+                moves_[m].weight <= bestWeight)
+                continue;
+            if (std::find(candidates.begin(), candidates.end(), color_[partner]) !=
+                candidates.end()) {
+                chosen = color_[partner];
+                bestWeight = moves_[m].weight;
+            }
+        }
+        state_[n] = NodeState::Colored;
+        color_[n] = chosen;
+    }
+}
+
+/**
+ * @brief 填写分配结果
+ * @details 溢出的代表节点各分配一个栈槽，合并进它的节点共用（genCopy 对同槽拷贝不生成指令）；
+ *   每个调用点需要保存的寄存器取调用之后仍活跃、着色在调用者保存寄存器中的节点（去重后升序）
+ */
+void GraphColoringAllocator::buildResult(const ir::Function &F) {
+    int nextSpillSlot = 0;
+    std::vector<int> slot(state_.size(), 0);
+
+    for (size_t i = 0; i < F.paramVregs.size(); ++i) {
+        int vreg = F.paramVregs[i];
+        if (i < 8) {
+            int argReg = 10 + static_cast<int>(i);
+            result_.paramVregToLocation[vreg] = argReg;
+            if (state_[vreg] == NodeState::None) // 未使用的参数：仍记在到达寄存器上
+                result_.vregToPhys[vreg] = argReg;
+        } else {
+            int stackOffset = static_cast<int>(i - 8 + 1) * 4;
+            result_.vregToStack[vreg] = stackOffset;
+            result_.paramVregToLocation[vreg] = stackOffset;
+        }
+    }
+
+    for (size_t i = 0; i < state_.size(); ++i) {
+        int n = static_cast<int>(i);
+        if (state_[n] == NodeState::None)
+            continue;
+        int a = getAlias(n);
+        if (state_[a] == NodeState::Spilled) {
+            if (slot[a] == 0) {
+                slot[a] = -(++nextSpillSlot) * 4;
+                result_.spillCost += weight_[a];
+            }
+            result_.vregToStack[n] = slot[a];
+        } else {
+            result_.vregToPhys[n] = color_[a];
+            result_.usedPhysRegs.insert(color_[a]);
+            if (regInfo_.isCalleeSaved(color_[a]))
+                result_.calleeSavedRegs.insert(color_[a]);
+        }
+    }
+
+    for (auto &[call, live] : callLive_) {
+        const RegMask clobbers = callClobbers(*call);
+        std::vector<int> saves;
+        for (int v : live) {
+            auto phys = result_.vregToPhys.find(v);
+            if (phys != result_.vregToPhys.end() && phys->second >= 0 &&
+                (clobbers & regBit(phys->second)))
+                saves.push_back(phys->second);
+        }
+        std::sort(saves.begin(), saves.end());
+        saves.erase(std::unique(saves.begin(), saves.end()), saves.end());
+        result_.callSaves[call] = std::move(saves);
+    }
+}
+
+#pragma endregion
+
+} // namespace toyc
@@ -0,0 +1,249 @@
+#include "ir_analysis.h"
+#include "ir_passes.h"
+#include "statistics.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+namespace {
+
+// ======================== 表达式键 ========================
+
+// packOperand：操作数打包为 64 位（种类 << 32 | 值），用于比较与哈希
+uint64_t packOperand(const Operand &op) {
+    return static_cast<uint64_t>(op.kind()) << 32 | static_cast<uint32_t>(op.regId());
+}
+
+// ExprKey：一条纯指令的值编号键（操作码 + 谓词 + 类型 + 规范化后的操作数）
+// load 的操作数为 [alloca, 槽版本, 合流纪元]，同一键意味着读取同一内存状态
+struct ExprKey {
+    Opcode opcode;
+    CmpPred pred;
+    uint32_t type;
+    uint64_t ops[3];
+
+    bool operator==(const ExprKey &o) const {
+        return opcode == o.opcode && pred == o.pred && type == o.type &&
+               std::equal(ops, ops + 3, o.ops);
+    }
+};
+
+struct ExprKeyHash {
+    size_t operator()(const ExprKey &k) const {
+        uint64_t h = static_cast<uint64_t>(k.opcode) << 8 | static_cast<uint64_t>(k.pred);
+        h = h * 0x9E3779B97F4A7C15ULL ^ k.type;
+        for (uint64_t op : k.ops)
+            h = (h ^ op) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>(h ^ h >> 29);
+    }
+};
+
+// swappedPred：交换比较两侧后的谓词（sgt a, b ≡ slt b, a）
+CmpPred swappedPred(CmpPred pred) {
+    switch (pred) {
+    case CmpPred::SLT:
+        return CmpPred::SGT;
+    case CmpPred::SGT:
+        return CmpPred::SLT;
+    case CmpPred::SLE:
+        return CmpPred::SGE;
+    case CmpPred::SGE:
+        return CmpPred::SLE;
+    default:
+        return pred; // eq / ne 对称
+    }
+}
+
+// ======================== 值编号 ========================
+
+// GVN：沿支配树先序遍历的作用域哈希表值编号
+class GVN {
+  public:
+    explicit GVN(Function &F) : F_(F) {}
+
+    int run();
+
+  private:
+    Function &F_;
+    std::unordered_map<ExprKey, Operand, ExprKeyHash> table_; // 可用表达式 → 代表值
+    std::vector<ExprKey> undo_;                  // 插入顺序，离开支配树子树时回退
+    std::unordered_map<int, Operand> replace_;   // 被删除指令的 def → 代表值
+    std::unordered_map<int, uint64_t> slotVersion_; // alloca vreg → 最近一次 store 的版本
+    uint64_t epoch_ = 0;                         // 当前合流纪元（多前驱块入口处更新）
+    uint64_t nextVersion_ = 0;
+
+    int visitBlock(BasicBlock *bb);
+    bool keyOf(const Instruction *I, ExprKey &key);
+    ExprKey loadKey(const Operand &slot, Symbol type) {
+        auto it = slotVersion_.find(slot.regId());
+        uint64_t version = it == slotVersion_.end() ? 0 : it->second;
+        return ExprKey{Opcode::Load, CmpPred::EQ, type.id(), {packOperand(slot), version, epoch_}};
+    }
+    void insert(const ExprKey &key, Operand value) {
+        if (table_.emplace(key, value).second)
+            undo_.push_back(key);
+    }
+    Operand resolve(Operand op) const;
+};
+
+// resolve：沿替换链找到最终代表值
+Operand GVN::resolve(Operand op) const {
+    while (op.isVReg()) {
+        auto it = replace_.find(op.regId());
+        if (it == replace_.end())
+            break;
+        op = it->second;
+    }
+    return op;
+}
+
+/**
+ * @brief 计算纯指令的键
+ * @details 二元运算与比较：加法、乘法与 eq / ne 的操作数按打包值排序，sgt / sge 交换为 slt / sle，
+ *   使 a*b 与 b*a、a > b 与 b < a 得到同一个编号。sdiv / srem 同样是纯的（除数为 0 时两次
+ *   执行结果一致，保留第一条即可）。load 只在地址是 alloca 时编号（键含槽版本与合流纪元）；
+ *   call / alloca / store / phi 不编号
+ */
+bool GVN::keyOf(const Instruction *I, ExprKey &key) {
+    switch (I->opcode) {
+    case Opcode::Add:
+    case Opcode::Sub:
+    case Opcode::Mul:
+    case Opcode::SDiv:
+    case Opcode::SRem:
+    case Opcode::ICmp: {
+        uint64_t a = packOperand(I->ops[0]), b = packOperand(I->ops[1]);
+        CmpPred pred = I->opcode == Opcode::ICmp ? I->cmpPred : CmpPred::EQ;
+        bool commutative = I->opcode == Opcode::Add || I->opcode == Opcode::Mul ||
+                           (I->opcode == Opcode::ICmp &&
+                            (pred == CmpPred::EQ || pred == CmpPred::NE));
+        if ((commutative && a > b) ||
+            (I->opcode == Opcode::ICmp && (pred == CmpPred::SGT || pred == CmpPred::SGE))) {
+            std::swap(a, b);
+            if (I->opcode == Opcode::ICmp)
+                pred = swappedPred(pred);
+        }
+        key = ExprKey{I->opcode, pred, I->type.id(), {a, b, 0}};
+        return true;
+    }
+    case Opcode::Load:
+        if (!I->ops[0].isVReg() || !slotVersion_.count(I->ops[0].regId()))
+            return false;
+        key = loadKey(I->ops[0], I->type);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 处理一个块：操作数先替换为代表值，再查表
+ * @details 命中则删除指令并记录替换；未命中则登记为新的代表。
+ *   store 给槽一个新版本，并把 i32 的存入值登记为该版本的 load 结果（i1 槽的 store 可能
+ *   存入未规范化的 i32 值，不做转发）
+ */
+int GVN::visitBlock(BasicBlock *bb) {
+    int removed = 0;
+    std::erase_if(bb->insts, [&](Instruction *I) {
+        for (Operand &op : I->ops)
+            op = resolve(op);
+        if (I->opcode == Opcode::Store) {
+            if (I->ops[1].isVReg() && slotVersion_.count(I->ops[1].regId())) {
+                slotVersion_[I->ops[1].regId()] = ++nextVersion_;
+                if (I->type == "i32")
+                    insert(loadKey(I->ops[1], I->type), I->ops[0]);
+            }
+            return false;
+        }
+        ExprKey key;
+        if (!keyOf(I, key))
+            return false;
+        auto it = table_.find(key);
+        if (it == table_.end()) {
+            insert(key, Operand::vreg(I->defReg()));
+            return false;
+        }
+        replace_[I->defReg()] = it->second;
+        ++removed;
+        return true;
+    });
+    return removed;
+}
+
+/**
+ * @brief 执行 GVN
+ * @details 支配树先序遍历（显式栈，深层嵌套的函数不会耗尽调用栈）：进入块时记下撤销日志长度，
+ *   处理完整棵子树后回退，兄弟子树看不到彼此的表达式。代表值的定义支配命中处，替换总是合法的。
+ *   load 的可用性不能跨越合流：多前驱块入口处换一个新纪元，之前登记的 load 键不再命中
+ *   （单前驱块的唯一前驱就是其直接支配者，顺序执行，store 已经更新了槽版本）。
+ *   最后把所有操作数（包括回边上的 phi 入口）替换为代表值
+ */
+int GVN::run() {
+    if (F_.blocks.empty())
+        return 0;
+    // 只跟踪地址不逃逸的 alloca（只作为 load / store 的地址出现），其内容只会被 store 改写
+    for (auto &bb : F_.blocks)
+        for (const Instruction *I : bb->insts)
+            if (I->opcode == Opcode::Alloca)
+                slotVersion_[I->defReg()] = 0;
+    for (auto &bb : F_.blocks)
+        for (const Instruction *I : bb->insts)
+            for (size_t k = 0; k < I->ops.size(); ++k) {
+                bool address = (I->opcode == Opcode::Load && k == 0) ||
+                               (I->opcode == Opcode::Store && k == 1);
+                if (I->ops[k].isVReg() && !address)
+                    slotVersion_.erase(I->ops[k].regId());
+            }
+
+    F_.buildCFG();
+    const DominatorTree &DT = F_.analyses().domTree();
+    struct Scope {
+        BasicBlock *bb;
+        size_t undoSize; // 进入该块前的撤销日志长度
+        uint64_t epoch;  // 进入该块前的合流纪元
+    };
+    int removed = 0;
+    std::vector<BasicBlock *> stack{F_.entryBlock()};
+    std::vector<Scope> scopes; // 当前块在支配树上的祖先链
+    while (!stack.empty()) {
+        BasicBlock *bb = stack.back();
+        stack.pop_back();
+        // 离开不是 bb 祖先的子树：撤销它们登记的表达式
+        while (!scopes.empty() && !DT.dominates(scopes.back().bb, bb)) {
+            for (size_t n = undo_.size(); n > scopes.back().undoSize; --n)
+                table_.erase(undo_[n - 1]);
+            undo_.resize(scopes.back().undoSize);
+            epoch_ = scopes.back().epoch;
+            scopes.pop_back();
+        }
+        scopes.push_back(Scope{bb, undo_.size(), epoch_});
+        if (bb->preds.size() > 1)
+            epoch_ = ++nextVersion_;
+        removed += visitBlock(bb);
+        const auto &children = DT.children(bb);
+        stack.insert(stack.end(), children.rbegin(), children.rend());
+    }
+
+    if (!replace_.empty())
+        for (auto &bb : F_.blocks)
+            for (Instruction *I : bb->insts)
+                for (Operand &op : I->ops)
+                    op = resolve(op);
+    return removed;
+}
+
+} // namespace
+
+// eliminateCommonSubexpressions：对单个函数执行 GVN
+int eliminateCommonSubexpressions(Function &F) {
+    int removed = GVN(F).run();
+    stats::add(stats::Counter::GVNEliminated, static_cast<uint64_t>(removed));
+    return removed;
+}
+
+} // namespace opt
+} // namespace toyc
@@ -0,0 +1,30 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace toyc {
+
+// AsmEmitter：流式汇编输出器
+// 每个函数的汇编先写入一个函数级片段缓冲区，函数完成后整体写入 std::ostream。
+// 片段缓冲区在函数之间复用，已完成的函数不会再被扫描、替换或重新分配
+class AsmEmitter {
+  public:
+    explicit AsmEmitter(std::ostream &os) : os_(os) {}
+
+    // -------- 模块级输出（直接写入输出流）--------
+    void directive(std::string_view text); // 输出一行缩进的伪指令（如 ".text"）
+
+    // -------- 函数级片段 --------
+    void beginFunction();              // 开始新函数片段（清空缓冲区）
+    void instr(std::string_view line); // 追加一条缩进后的汇编指令
+    void label(std::string_view name); // 追加一个标签行 "name:"
+    void raw(std::string_view text);   // 追加原样文本
+    void finishFunction();             // 结束当前函数，将片段写入输出流
+
+  private:
+    std::ostream &os_;     // 最终输出流
+    std::string fragment_; // 当前函数的片段缓冲区（跨函数复用容量）
+};
+
+} // namespace toyc
@@ -1,123 +1,269 @@
 #pragma once
+#include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <memory>
-#include <string>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 //--------------------------------------------------------
 // 抽象语法树（AST）所有节点的抽象基类
+// 节点全部分配在 ASTArena 中，随解析结果 CompUnit 一次性整体释放，不逐个析构：
+// 因此节点类型必须可平凡析构（名字为 arena 中的 string_view，子节点为裸指针，列表为 arena 中的 span）
 //--------------------------------------------------------
+
+// 节点种类标签：构造时写入，遍历 AST 时用 switch 分派而不做 RTTI 查询
+// 表达式种类排在最前（Number..Call），isExpr() 只需一次比较
+enum class NodeKind {
+    // 表达式
+    Number,
+    Identifier,
+    Binary,
+    Unary,
+    Call,
+    // 语句
+    Assign,
+    Decl,
+    If,
+    While,
+    Break,
+    Continue,
+    Return,
+    Block,
+    // 函数定义
+    FuncDef,
+};
+
 struct ASTNode {
-    virtual ~ASTNode() = default;                                         // 虚析构，确保派生类正确析构
+    const NodeKind kind; // 节点种类
+
     virtual void print(int indent, std::ostream &os = std::cout) const = 0; // 纯虚函数：打印节点，indent 表示缩进级别
+
+    // isExpr：是否为表达式节点
+    bool isExpr() const { return kind <= NodeKind::Call; }
+
+  protected:
+    explicit ASTNode(NodeKind k) : kind(k) {}
+    ~ASTNode() = default; // 非虚且受保护：节点只能由 arena 整体回收，不能 delete
 };
 
-// 智能指针别名：指向 ASTNode 的共享所有权指针
-using ASTPtr = std::shared_ptr<ASTNode>;
+// 子节点指针别名：非拥有的裸指针，节点的生命周期由所属 ASTArena 管理
+using ASTPtr = ASTNode *;
+
+// cast：已按 kind 确定类型后的向下转换（每个具体节点类型定义 static constexpr Kind）
+template <typename T> const T &cast(const ASTNode &n) {
+    assert(n.kind == T::Kind);
+    return static_cast<const T &>(n);
+}
+
+// dynCast：kind 匹配时返回 T*，否则返回 nullptr（一次整数比较，替代 dynamic_cast）
+template <typename T> const T *dynCast(const ASTNode *n) {
+    return n && n->kind == T::Kind ? static_cast<const T *>(n) : nullptr;
+}
+
+// 二元运算符（解析时由 Token 类型直接确定，IR 生成按枚举分派，不再比较字符串）
+enum class BinaryOp { Add, Sub, Mul, Div, Mod, Lt, Gt, Le, Ge, Eq, Ne, And, Or };
+
+// 一元运算符
+enum class UnaryOp { Plus, Minus, Not };
+
+// 运算符的源码拼写（用于 AST 打印，如 BinaryOp::Le → "<="）
+const char *spelling(BinaryOp op);
+const char *spelling(UnaryOp op);
+
+// Ident：驻留后的标识符（同一 CompUnit 中同名标识符的 text 指向同一份 arena 文本，id 也相同）
+struct Ident {
+    std::string_view text; // 标识符文本（arena 中）
+    uint32_t id = 0;       // 驻留编号：按首次出现的顺序从 0 连续分配，可直接作数组下标
+};
+
+//--------------------------------------------------------
+// ASTArena：AST 节点与名字的单调内存池
+// 节点按顺序从大块内存中切分（无逐节点堆分配、无引用计数），析构时整块归还
+//--------------------------------------------------------
+class ASTArena {
+  public:
+    ASTArena() = default;
+    ASTArena(const ASTArena &) = delete;
+    ASTArena &operator=(const ASTArena &) = delete;
+
+    // make：在 arena 中构造一个节点
+    template <typename T, typename... Args> T *make(Args &&...args) {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "AST nodes are released with the arena and never destroyed one by one");
+        return new (resource_.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // copyString：把名字复制到 arena 中（AST 不依赖源码缓冲区的生命周期）
+    std::string_view copyString(std::string_view s) {
+        if (s.empty())
+            return {};
+        char *p = static_cast<char *>(resource_.allocate(s.size(), 1));
+        std::memcpy(p, s.data(), s.size());
+        return {p, s.size()};
+    }
+
+    // intern：驻留标识符，同名只复制一次并得到同一个编号（变量名经此进入 AST，
+    // IRBuilder 的符号表按编号下标查找，不再比较字符串）
+    Ident intern(std::string_view s) {
+        auto it = names_.find(s);
+        if (it != names_.end())
+            return {it->first, it->second};
+        Ident ident{copyString(s), static_cast<uint32_t>(names_.size())};
+        names_.emplace(ident.text, ident.id);
+        return ident;
+    }
+    // nameCount：已驻留的不同标识符个数（编号都小于它）
+    size_t nameCount() const { return names_.size(); }
+
+    // copyList：把临时收集的列表元素复制为 arena 中的定长数组
+    template <typename T> std::span<T> copyList(std::span<const T> items) {
+        static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+        if (items.empty())
+            return {};
+        T *p = static_cast<T *>(resource_.allocate(items.size_bytes(), alignof(T)));
+        std::memcpy(static_cast<void *>(p), items.data(), items.size_bytes());
+        return {p, items.size()};
+    }
+
+  private:
+    std::pmr::monotonic_buffer_resource resource_{64 * 1024}; // 首块 64 KiB，之后按几何级数增长
+    std::unordered_map<std::string_view, uint32_t> names_;    // 标识符文本（arena 中）→ 驻留编号
+};
 
 //--------------------------------------------------------
 // 表达式基类（继承自 ASTNode）
 //--------------------------------------------------------
-struct Expr : ASTNode {};
+struct Expr : ASTNode {
+  protected:
+    using ASTNode::ASTNode;
+};
 
 // 数字字面量表达式节点
 struct NumberExpr : Expr {
+    static constexpr NodeKind Kind = NodeKind::Number;
     int value;                                                           // 存储数字值
-    explicit NumberExpr(int v) : value(v) {}                             // 构造时初始化数字
+    explicit NumberExpr(int v) : Expr(Kind), value(v) {}                 // 构造时初始化数字
     void print(int indent, std::ostream &os = std::cout) const override; // 按缩进打印数字
 };
 
 // 标识符表达式节点
 struct IdentifierExpr : Expr {
-    std::string name;                                                    // 变量名或函数名
-    explicit IdentifierExpr(std::string n) : name(std::move(n)) {}      // 构造时移动字符串
+    static constexpr NodeKind Kind = NodeKind::Identifier;
+    std::string_view name;                                               // 变量名（arena 中）
+    uint32_t sym;                                                        // 变量名的驻留编号
+    explicit IdentifierExpr(Ident n) : Expr(Kind), name(n.text), sym(n.id) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 按缩进打印标识符
 };
 
 // 二元运算表达式节点
 struct BinaryExpr : Expr {
-    std::string op;  // 运算符（如 "+", "-", "==", "!=" 等）
+    static constexpr NodeKind Kind = NodeKind::Binary;
+    BinaryOp op;     // 运算符
     ASTPtr lhs, rhs; // 左右子表达式
-    BinaryExpr(std::string o, ASTPtr l, ASTPtr r)
-        : op(std::move(o)), lhs(std::move(l)), rhs(std::move(r)) {}
+    BinaryExpr(BinaryOp o, ASTPtr l, ASTPtr r) : Expr(Kind), op(o), lhs(l), rhs(r) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 按缩进打印运算及子节点
 };
 
 // 一元运算表达式节点
 struct UnaryExpr : Expr {
-    std::string op; // 运算符（如 "-", "!"）
-    ASTPtr expr;    // 作用对象表达式
-    UnaryExpr(std::string o, ASTPtr e) : op(std::move(o)), expr(std::move(e)) {}
+    static constexpr NodeKind Kind = NodeKind::Unary;
+    UnaryOp op;  // 运算符
+    ASTPtr expr; // 作用对象表达式
+    UnaryExpr(UnaryOp o, ASTPtr e) : Expr(Kind), op(o), expr(e) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 按缩进打印运算符及子表达式
 };
 
 // 函数调用表达式节点
 struct CallExpr : Expr {
-    std::string callee;                                                  // 被调用函数名称
-    std::vector<ASTPtr> args;                                            // 参数列表
-    explicit CallExpr(std::string c) : callee(std::move(c)) {}          // 构造时初始化函数名
+    static constexpr NodeKind Kind = NodeKind::Call;
+    std::string_view callee;                                             // 被调用函数名称
+    std::span<ASTPtr> args;                                              // 参数列表（arena 中）
+    CallExpr(std::string_view c, std::span<ASTPtr> a) : Expr(Kind), callee(c), args(a) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 按缩进打印调用信息及参数
 };
 
 //--------------------------------------------------------
 // 语句基类（继承自 ASTNode）
 //--------------------------------------------------------
-struct Stmt : ASTNode {};
+struct Stmt : ASTNode {
+  protected:
+    using ASTNode::ASTNode;
+};
 
 // 赋值语句节点
 struct AssignStmt : Stmt {
-    std::string name; // 被赋值变量名
-    ASTPtr expr;      // 右值表达式
-    AssignStmt(std::string n, ASTPtr e) : name(std::move(n)), expr(std::move(e)) {}
+    static constexpr NodeKind Kind = NodeKind::Assign;
+    std::string_view name; // 被赋值变量名
+    uint32_t sym;          // 变量名的驻留编号
+    ASTPtr expr;           // 右值表达式
+    AssignStmt(Ident n, ASTPtr e) : Stmt(Kind), name(n.text), sym(n.id), expr(e) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 打印赋值语句
 };
 
 // 声明语句节点（int x = expr;）
 struct DeclStmt : Stmt {
-    std::string name; // 声明变量名
-    ASTPtr expr;      // 初始化表达式
-    DeclStmt(std::string n, ASTPtr e) : name(std::move(n)), expr(std::move(e)) {}
+    static constexpr NodeKind Kind = NodeKind::Decl;
+    std::string_view name; // 声明变量名
+    uint32_t sym;          // 变量名的驻留编号
+    ASTPtr expr;           // 初始化表达式
+    DeclStmt(Ident n, ASTPtr e) : Stmt(Kind), name(n.text), sym(n.id), expr(e) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 打印声明语句
 };
 
 // if 语句节点，包括可选的 else 分支
 struct IfStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::If;
     ASTPtr cond;     // 条件表达式
     ASTPtr thenStmt; // then 分支语句
     ASTPtr elseStmt; // else 分支语句（可空）
-    IfStmt(ASTPtr c, ASTPtr t, ASTPtr e)
-        : cond(std::move(c)), thenStmt(std::move(t)), elseStmt(std::move(e)) {}
+    IfStmt(ASTPtr c, ASTPtr t, ASTPtr e) : Stmt(Kind), cond(c), thenStmt(t), elseStmt(e) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 打印 if/else 结构
 };
 
 // while 循环语句节点
 struct WhileStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::While;
     ASTPtr cond; // 循环条件
     ASTPtr body; // 循环体语句
-    WhileStmt(ASTPtr c, ASTPtr b) : cond(std::move(c)), body(std::move(b)) {}
+    WhileStmt(ASTPtr c, ASTPtr b) : Stmt(Kind), cond(c), body(b) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 打印 while 结构
 };
 
 // break 语句节点
 struct BreakStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Break;
+    BreakStmt() : Stmt(Kind) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 按缩进打印 "Break"
 };
 
 // continue 语句节点
 struct ContinueStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Continue;
+    ContinueStmt() : Stmt(Kind) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 按缩进打印 "Continue"
 };
 
 // 返回语句节点
 struct ReturnStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Return;
     ASTPtr expr; // 返回值表达式（可空，void 函数无返回值）
-    explicit ReturnStmt(ASTPtr e) : expr(std::move(e)) {}
+    explicit ReturnStmt(ASTPtr e) : Stmt(Kind), expr(e) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 按缩进打印 return 及表达式
 };
 
 // 语句块节点：表示大括号 {} 中的多条语句
 struct BlockStmt : Stmt {
-    std::vector<ASTPtr> stmts;                                           // 内部语句列表
+    static constexpr NodeKind Kind = NodeKind::Block;
+    std::span<ASTPtr> stmts;                                             // 内部语句列表（arena 中）
+    explicit BlockStmt(std::span<ASTPtr> s) : Stmt(Kind), stmts(s) {}
     void print(int indent, std::ostream &os = std::cout) const override; // 打印块及内部所有语句
 };
 
@@ -127,14 +273,28 @@ struct BlockStmt : Stmt {
 
 // 函数参数结构：仅包含参数名（类型统一为 int）
 struct Param {
-    std::string name; // 参数名称
+    std::string_view name; // 参数名称
+    uint32_t sym = 0;      // 参数名的驻留编号
 };
 
 // 函数定义节点：包含返回类型、函数名、参数列表和函数体
 struct FuncDef : ASTNode {
-    std::string retType;                                                 // 返回类型（"int" 或 "void"）
-    std::string name;                                                    // 函数名称
-    std::vector<Param> params;                                           // 参数列表
-    std::shared_ptr<BlockStmt> body;                                     // 函数体
+    static constexpr NodeKind Kind = NodeKind::FuncDef;
+    FuncDef() : ASTNode(Kind) {}
+    std::string_view retType;                                            // 返回类型（"int" 或 "void"）
+    std::string_view name;                                               // 函数名称
+    std::span<Param> params;                                             // 参数列表（arena 中）
+    BlockStmt *body = nullptr;                                           // 函数体
     void print(int indent, std::ostream &os = std::cout) const override; // 打印函数签名及函数体
 };
+
+//--------------------------------------------------------
+// CompUnit：一次解析的结果（编译单元）
+// 持有全部节点所在的 arena；移动 CompUnit 不会使节点指针失效，销毁时整棵树一次释放
+//--------------------------------------------------------
+struct CompUnit {
+    std::unique_ptr<ASTArena> arena; // 节点与名字的存储
+    std::vector<FuncDef *> funcs;    // 按源码顺序的函数定义
+
+    bool empty() const { return funcs.empty(); }
+};
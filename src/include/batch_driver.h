@@ -0,0 +1,46 @@
+#pragma once
+#include "ir_passes.h"
+#include "machine_ir.h"
+#include "reg_alloc.h"
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace toyc {
+
+// BatchOptions：批量编译参数
+struct BatchOptions {
+    std::vector<std::string> inputs; // 输入文件（已由 collectBatchInputs 展开）
+    std::string outputDir;           // 输出目录（为空时输出到输入文件所在目录）
+    std::string suffix;              // 输出文件名后缀，插在扩展名之前（如 "_toyc" → a_toyc.s）
+    bool emitObject = false;         // true 输出 .o（ELF），否则输出 .s
+    unsigned jobs = 1;               // 工作线程数
+    int optLevel = 0;                // IR 优化级别（-O0 / -O1 / -O2）
+    int inlineLimit = opt::kDefaultInlineLimit; // 内联阈值（-finline-limit，0 表示不内联）
+    RegAllocKind regAlloc = RegAllocKind::Linear; // 寄存器分配算法（--regalloc）
+    std::optional<mir::LatencyModel> schedule;    // 指令调度的延迟模型（为空表示不调度）
+    bool compressed = false;                      // RV32C 压缩指令（--march=rv32imc）
+    bool vectorize = false;                       // RVV 循环向量化（--march=rv32imv）
+    bool ipra = false;                            // 过程间寄存器分配（-fipra）
+    bool omitFramePointer = false;                // 省略帧指针（-fomit-frame-pointer）
+    std::string cacheDir;            // 增量编译缓存目录（为空表示不使用；所有输入共享）
+};
+
+// collectBatchInputs：展开批量输入
+//   目录   → 其中的 .c/.tc/.ll 文件（按文件名排序，不递归）
+//   @list  → list 文件中每行一个路径（忽略空行与 # 注释行，路径同样可以是目录）
+//   其他   → 原样作为输入文件
+std::vector<std::string> collectBatchInputs(const std::vector<std::string> &args);
+
+// batchOutputPath：输入文件对应的输出路径（outputDir/基本名 + suffix + .s/.o）
+std::string batchOutputPath(const BatchOptions &opts, const std::string &input);
+
+// runBatch：在一个进程内编译全部输入，返回失败的文件数
+// 每个翻译单元是工作窃取线程池中的一个任务，其内部的函数级代码生成再作为子任务提交到同一个
+// 线程池，空闲线程会窃取大文件的函数任务；所有工作线程共享同一个只读 RegInfo，
+// 寄存器分配的临时结构使用各线程自己的内存池。
+// 每个文件的结果（OK / FAIL 及原因）按输入顺序写入 log，最后输出汇总行（启用缓存时附带命中统计）
+int runBatch(const BatchOptions &opts, std::ostream &log);
+
+} // namespace toyc
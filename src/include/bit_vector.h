@@ -0,0 +1,107 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+namespace toyc {
+
+// BitVector：定长稠密位向量，用作活跃性分析中的虚拟寄存器集合
+// 以 64 位字为单位存储，并集/差集等集合运算按字并行执行，
+// 大小一般由 Function::maxVregId + 1 决定
+class BitVector {
+  public:
+    BitVector() = default;
+    explicit BitVector(size_t nbits) { resize(nbits); }
+
+    // resize：调整位数并清零所有位
+    void resize(size_t nbits) {
+        nbits_ = nbits;
+        words_.assign((nbits + 63) / 64, 0);
+    }
+    size_t size() const { return nbits_; }
+
+    // clear：清零所有位（保持位数不变）
+    void clear() { std::fill(words_.begin(), words_.end(), 0); }
+
+    // -------- 单个位操作 --------
+    bool test(int i) const {
+        return i >= 0 && static_cast<size_t>(i) < nbits_ && (words_[i >> 6] >> (i & 63)) & 1;
+    }
+    void set(int i) { words_[i >> 6] |= uint64_t(1) << (i & 63); }
+    void reset(int i) { words_[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+
+    // any / count：是否存在置位 / 置位个数
+    bool any() const {
+        for (uint64_t w : words_)
+            if (w)
+                return true;
+        return false;
+    }
+    size_t count() const {
+        size_t n = 0;
+        for (uint64_t w : words_)
+            n += std::popcount(w);
+        return n;
+    }
+
+    // -------- 集合运算（按字并行）--------
+
+    // unionWith：*this ∪= o，返回 *this 是否发生变化
+    bool unionWith(const BitVector &o) {
+        uint64_t changed = 0;
+        for (size_t w = 0; w < words_.size(); ++w) {
+            uint64_t nw = words_[w] | o.words_[w];
+            changed |= nw ^ words_[w];
+            words_[w] = nw;
+        }
+        return changed != 0;
+    }
+
+    // subtract：*this −= o
+    void subtract(const BitVector &o) {
+        for (size_t w = 0; w < words_.size(); ++w)
+            words_[w] &= ~o.words_[w];
+    }
+
+    // assignUnionDiff：*this = a ∪ (b − c)，返回 *this 是否发生变化
+    // 对应活跃性传递函数 liveIn = use ∪ (liveOut − def)，一趟完成
+    bool assignUnionDiff(const BitVector &a, const BitVector &b, const BitVector &c) {
+        uint64_t changed = 0;
+        for (size_t w = 0; w < words_.size(); ++w) {
+            uint64_t nw = a.words_[w] | (b.words_[w] & ~c.words_[w]);
+            changed |= nw ^ words_[w];
+            words_[w] = nw;
+        }
+        return changed != 0;
+    }
+
+    bool operator==(const BitVector &o) const { return words_ == o.words_; }
+    bool operator!=(const BitVector &o) const { return !(*this == o); }
+
+    // forEach：按升序遍历所有置位的下标
+    template <typename Fn> void forEach(Fn &&fn) const {
+        for (size_t w = 0; w < words_.size(); ++w) {
+            uint64_t bits = words_[w];
+            while (bits) {
+                int b = std::countr_zero(bits);
+                fn(static_cast<int>(w * 64 + b));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    // toSet：导出为 std::set<int>（仅供 ra_debug 等调试输出使用）
+    std::set<int> toSet() const {
+        std::set<int> s;
+        forEach([&](int i) { s.insert(i); });
+        return s;
+    }
+
+  private:
+    size_t nbits_ = 0;           // 位数
+    std::vector<uint64_t> words_; // 位存储（每字 64 位）
+};
+
+} // namespace toyc
@@ -0,0 +1,58 @@
+#pragma once
+#include "ir.h"
+#include "machine_ir.h"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace toyc {
+
+// ======================== 增量编译缓存 ========================
+//
+// CodeGenCache：按函数内容哈希缓存代码生成结果的磁盘缓存
+// 键 = 哈希(缓存格式版本 | 编译器标识 | 代码生成选项 | 函数的 IR 文本 | maxVregId | 上下文)，
+// 值 = 该函数寄存器分配 + 指令选择 + 栈帧展开之后的 mir::MachineFunction。
+// 缓存的是机器函数而不是汇编文本，因此汇编输出与 -c 目标文件共用同一份缓存，
+// 命中时跳过 LinearScanAllocator 与 FunctionCodeGen，直接交给 AsmPrinter / ELFObjectWriter。
+//
+// 每个条目是缓存目录下的一个文件（<16 位十六进制键>.mf），先写临时文件再 rename，
+// 多个线程或进程同时读写同一目录是安全的；文件损坏、截断或校验不符时按未命中处理。
+// 编译器标识取自可执行文件的大小与修改时间：重新构建编译器后旧条目自动失效
+class CodeGenCache {
+  public:
+    // dir：缓存目录（不存在时创建）；options：影响代码生成结果的选项（不同选项互不命中）
+    explicit CodeGenCache(std::filesystem::path dir, std::string_view options = {});
+
+    // Key：一个函数的缓存键（文件名取 hash，check 用于发现哈希碰撞）
+    struct Key {
+        uint64_t hash = 0;
+        uint64_t check = 0;
+    };
+
+    // key：计算函数的缓存键（序列化一次函数的 IR 文本）；context 是函数之外影响其代码的信息
+    // （-fipra 时被调函数的寄存器掩码），一并计入键
+    Key key(const ir::Function &func, std::string_view context = {}) const;
+
+    // lookup：读取缓存的机器函数，未命中时返回 std::nullopt
+    std::optional<mir::MachineFunction> lookup(const Key &key) const;
+
+    // store：写入缓存条目（写入失败时静默放弃，不影响编译结果）
+    void store(const Key &key, const mir::MachineFunction &MF) const;
+
+    // hits / misses：本对象的命中 / 未命中次数（线程安全）
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+  private:
+    std::filesystem::path dir_;
+    std::string config_; // 格式版本 + 编译器标识 + 选项，作为每个键的前缀
+    mutable std::atomic<uint64_t> hits_{0};
+    mutable std::atomic<uint64_t> misses_{0};
+
+    std::filesystem::path entryPath(const Key &key) const;
+};
+
+} // namespace toyc
@@ -0,0 +1,56 @@
+#pragma once
+#include "compiler.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace toyc {
+
+// ======================== 常驻编译服务 ========================
+//
+// toyc --server：一个进程连续处理多次编译请求。线程池（连同各工作线程的寄存器分配内存池）、
+// 只读共享的 RegInfo 与增量编译缓存在请求之间保留，小文件的编译不再被进程启动与初始化主导。
+// 请求与响应都是 "一行文本头 + 定长负载"，负载为任意字节，不需要转义：
+//   请求  compile <字节数> [选项...]\n<源码>
+//           选项与命令行相同：-O<n>、-finline-limit=、--regalloc=、--march=、-fipra / -fno-ipra、
+//           -fomit-frame-pointer、-fschedule-insns / -fno-schedule-insns、-mtune=、--function <名字>，
+//           另有 -x c|ll（输入语言，默认 c）、--ir（输出优化后的 IR）、-c（输出 ELF 目标文件）
+//         ping\n                    检查服务是否存活（响应 ok 0）
+//         quit\n                    结束本连接（stdin 模式下即停止服务）
+//         shutdown\n                停止服务
+//   响应  ok <字节数>\n<汇编 / IR / 目标文件>   或   error <字节数>\n<诊断信息>
+// 请求按到达顺序逐个处理，全部经由同一个 CompilerContext 编译（函数级代码生成仍在线程池中并行）
+
+// ServerOptions：toyc --server 的参数
+struct ServerOptions {
+    unsigned jobs = 1;      // 函数级代码生成的工作线程数（> 1 时建立线程池，在请求之间复用）
+    std::string cacheDir;   // 增量编译缓存目录（为空表示不使用；所有请求共享）
+    std::string socketPath; // Unix 域套接字路径（为空时通过 stdin / stdout 通信）
+};
+
+// CompileServer：编译服务的常驻状态与请求处理
+class CompileServer {
+  public:
+    explicit CompileServer(const ServerOptions &opts);
+
+    // compile：处理一个 compile 请求（args 为选项，source 为输入）
+    // 成功返回 true，out 为汇编 / IR / 目标文件；失败返回 false，out 为诊断信息（不抛出异常）
+    bool compile(const std::vector<std::string> &args, std::string_view source, std::string &out);
+
+    // serve：在描述符 in / out 上逐个处理请求，直到 quit、shutdown 或输入结束
+    // 收到 shutdown 时返回 false，其余情况返回 true
+    bool serve(int in, int out);
+
+    // requests：已处理的 compile 请求数
+    uint64_t requests() const { return requests_; }
+
+  private:
+    CompilerContext context_; // 在请求之间保留的线程池与缓存
+    uint64_t requests_ = 0;
+};
+
+// runServer：按 opts 启动服务（Unix 域套接字上逐个接受连接，或 stdin / stdout），返回进程退出码
+int runServer(const ServerOptions &opts);
+
+} // namespace toyc
@@ -0,0 +1,120 @@
+#pragma once
+#include "ir_passes.h"
+#include "machine_ir.h"
+#include "reg_alloc.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace toyc {
+
+class CodeGenCache;
+class ThreadPool;
+
+// ======================== 嵌入式编译接口 ========================
+//
+// CompilerContext：不经过命令行、不启动进程的编译入口。输入是内存中的源码，结果写入调用方提供的
+// 输出流，错误以 Diagnostic 返回（不打印、不退出进程）。同一个上下文可以反复使用：
+// 线程池（连同各工作线程的寄存器分配内存池）与增量编译缓存在调用之间保留，进程级的字符串驻留表
+// 与 RegInfo 本就只建立一次。toyc --server 的每个请求都经由同一个 CompilerContext 编译
+
+// InputLanguage：输入语言
+enum class InputLanguage : uint8_t {
+    ToyC, // ToyC 源码（.c / .tc）
+    IR,   // LLVM IR 文本（.ll）
+};
+
+// OutputKind：输出形式
+enum class OutputKind : uint8_t {
+    Assembly, // RISC-V 汇编文本
+    IR,       // 优化后的 LLVM IR 文本
+    Object,   // ELF32 可重定位目标文件
+};
+
+// CompileOptions：一次编译的选项（含义与同名命令行选项相同）
+struct CompileOptions {
+    InputLanguage language = InputLanguage::ToyC;
+    OutputKind output = OutputKind::Assembly;
+    int optLevel = 0;                             // -O0 / -O1 / -O2
+    int inlineLimit = opt::kDefaultInlineLimit;   // -finline-limit（0 表示不内联）
+    RegAllocKind regAlloc = RegAllocKind::Linear; // --regalloc
+    int schedule = -1;                            // -fschedule-insns（-1 表示 -O1 起开启）
+    mir::LatencyModel tuning;                     // -mtune 选择的延迟模型
+    bool compressed = false;                      // --march=rv32imc
+    bool vectorize = false;                       // --march=rv32imv
+    int ipra = -1;                                // -fipra（-1 表示 -O2 开启）
+    bool omitFramePointer = false;                // -fomit-frame-pointer
+    std::vector<std::string> functions;           // --function（为空表示全部函数）
+
+    // resolveSchedule：本次编译使用的延迟模型（不调度时为 std::nullopt）
+    std::optional<mir::LatencyModel> resolveSchedule() const;
+    // resolveIPRA：是否执行过程间寄存器分配
+    bool resolveIPRA() const { return ipra < 0 ? optLevel >= 2 : ipra != 0; }
+};
+
+// Diagnostic：一条结构化的编译错误
+struct Diagnostic {
+    enum class Kind : uint8_t {
+        InvalidOption,   // 选项无法识别或取值非法
+        SyntaxError,     // ToyC 源码语法错误
+        InvalidIR,       // LLVM IR 文本无法解析
+        UnknownFunction, // --function 指定的函数不存在
+        CodeGenError,    // 代码生成 / 目标文件编码失败
+    };
+    Kind kind;
+    std::string message; // 不含换行的错误描述
+    int line = 0;        // 源码行号（未知为 0）
+};
+
+// diagnosticKindName：Diagnostic::Kind → "invalid-option" 等短名
+const char *diagnosticKindName(Diagnostic::Kind kind);
+
+// CompileResult：编译结果（diagnostics 为空表示成功）
+struct CompileResult {
+    std::vector<Diagnostic> diagnostics;
+
+    bool ok() const { return diagnostics.empty(); }
+    explicit operator bool() const { return ok(); }
+    // message：全部诊断的文本，每条一行（成功时为空）
+    std::string message() const;
+};
+
+// parseCompileOptions：按命令行写法解析选项（-O2、--march=rv32imc、-x ll、--ir、-c、
+// --function <名字> 等），追加到 opts；遇到第一个无法识别的选项时返回 InvalidOption 诊断
+CompileResult parseCompileOptions(const std::vector<std::string> &args, CompileOptions &opts);
+
+// CompilerContext：可重复使用的编译上下文（不可复制；同一时刻只应由一个线程调用 compile）
+class CompilerContext {
+  public:
+    // jobs：函数级代码生成的工作线程数（> 1 时建立线程池，在调用之间复用）
+    // cacheDir：增量编译缓存目录（为空表示不使用；按代码生成选项各建一个缓存对象）
+    explicit CompilerContext(unsigned jobs = 1, std::string cacheDir = {});
+    ~CompilerContext();
+    CompilerContext(const CompilerContext &) = delete;
+    CompilerContext &operator=(const CompilerContext &) = delete;
+
+    // compile：编译 source，结果写入 out
+    // 解析、筛选函数与优化在写出任何内容之前完成，这些阶段的错误不会留下部分输出；
+    // 代码生成阶段失败（CodeGenError）时 out 中可能已有部分内容
+    CompileResult compile(std::string_view source, const CompileOptions &opts, std::ostream &out);
+
+    // compilations：已执行的 compile 次数
+    uint64_t compilations() const { return compilations_; }
+
+  private:
+    std::unique_ptr<ThreadPool> pool_; // jobs <= 1 时为空，在调用线程上串行
+    std::string cacheDir_;
+    std::map<std::string, std::unique_ptr<CodeGenCache>> caches_; // 代码生成选项 → 缓存
+    uint64_t compilations_ = 0;
+
+    // cacheFor：选项对应的增量编译缓存（首次使用时建立；未启用缓存时返回空）
+    CodeGenCache *cacheFor(const CompileOptions &opts,
+                           const std::optional<mir::LatencyModel> &schedule);
+};
+
+} // namespace toyc
@@ -0,0 +1,53 @@
+#pragma once
+#include "machine_ir.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace toyc {
+
+// ELFObjectWriter：把 mir::MachineFunction 直接编码为 RV32IM 机器码，并输出 ELF32 可重定位目标文件
+// 产物包含 .text、每个函数的全局 STT_FUNC 符号、被调用但未定义的外部符号，
+// 以及 call 指令对应的 R_RISCV_CALL_PLT 重定位（.rela.text），可直接交给链接器使用。
+// 函数内部的分支/跳转在编码时直接解析；条件分支超出 ±4KiB 时改写为 "反转分支 + jal"。
+// 压缩模式（RV32IMC）下可压缩的指令与距离足够近的 beqz / bnez / j 使用 16 位编码
+class ELFObjectWriter {
+  public:
+    explicit ELFObjectWriter(bool compressed = false) : compressed_(compressed) {}
+
+    // addFunction：编码一个函数并追加到 .text（FrameSetup/FrameDestroy 须已展开）
+    // 立即数或跳转距离超出编码范围时抛出 std::runtime_error
+    void addFunction(const mir::MachineFunction &MF);
+
+    // write：输出完整的 ELF32 目标文件
+    void write(std::ostream &os) const;
+
+  private:
+    // Symbol：符号表项（不含空符号与节符号）
+    struct Symbol {
+        std::string name;     // 符号名
+        uint32_t value = 0;   // .text 内偏移
+        uint32_t size = 0;    // 函数字节数
+        bool defined = false; // 是否在本文件中定义
+    };
+    // Reloc：.rela.text 中的一项重定位
+    struct Reloc {
+        uint32_t offset; // 被修正指令在 .text 中的偏移
+        int symbol;      // 目标符号在 symbols_ 中的下标
+        uint32_t type;   // 重定位类型（R_RISCV_*）
+    };
+
+    bool compressed_;                               // 使用 RV32C 压缩编码（--march=rv32imc）
+    std::vector<uint8_t> text_;                     // .text 内容
+    std::vector<Symbol> symbols_;                   // 全局符号（按首次出现顺序）
+    std::unordered_map<std::string, int> symIndex_; // 符号名 → symbols_ 下标
+    std::vector<Reloc> relocs_;                     // .text 的重定位
+
+    int getOrAddSymbol(const std::string &name);
+    void emit16(uint16_t half);
+    void emit32(uint32_t word);
+};
+
+} // namespace toyc
@@ -1,13 +1,22 @@
 #pragma once
+#include "bit_vector.h"
+#include "small_vector.h"
+#include "string_interner.h"
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <set>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 namespace toyc {
+
+class AnalysisManager; // ir_analysis.h
+
 namespace ir {
 
 // ======================== 指令操作码 ========================
@@ -37,6 +46,10 @@ enum class Opcode {
 
     // 函数调用
     Call, // %result = call type @func(args...) — 函数调用
+
+    // SSA（仅由优化流水线产生，IRBuilder 不会生成）
+    Phi,  // %result = phi type [ v, %pred ], ... — 按前驱块选择入口值（mem2reg 放置）
+    Copy, // %result = copy type v                 — 寄存器拷贝（phi 消除插入，非 LLVM 语法）
 };
 
 // opcodeToString：将 Opcode 转换为 LLVM IR 文本表示（如 "add", "br", "ret"）
@@ -63,13 +76,51 @@ std::string cmpPredToString(CmpPred pred);
 // stringToCmpPred：从文本解析比较谓词
 CmpPred stringToCmpPred(const std::string &s);
 
+// ======================== 驻留字符串 ========================
+
+// Symbol 类：驻留字符串的 32 位句柄，用于标签名、类型名（"i32"/"i1"/"void"）和被调函数名
+// 相同内容的字符串共享同一个句柄，比较与拷贝都是整数操作；
+// 可由 std::string 隐式构造，也可隐式转换回 const std::string &
+class Symbol {
+  public:
+    Symbol() = default; // 空串
+    Symbol(std::string_view s) : id_(StringInterner::global().intern(s)) {}
+    Symbol(const std::string &s) : Symbol(std::string_view(s)) {}
+    Symbol(const char *s) : Symbol(std::string_view(s)) {}
+
+    // fromId：由已有句柄直接构造（不查表）
+    static Symbol fromId(uint32_t id) {
+        Symbol s;
+        s.id_ = id;
+        return s;
+    }
+
+    uint32_t id() const { return id_; }
+    bool empty() const { return id_ == 0; }
+    const std::string &str() const { return StringInterner::global().str(id_); }
+    operator const std::string &() const { return str(); }
+
+    bool operator==(Symbol o) const { return id_ == o.id_; }
+    bool operator!=(Symbol o) const { return id_ != o.id_; }
+    bool operator==(const char *s) const { return str() == s; }
+    bool operator!=(const char *s) const { return str() != s; }
+    bool operator==(const std::string &s) const { return str() == s; }
+    bool operator!=(const std::string &s) const { return str() != s; }
+
+    friend std::ostream &operator<<(std::ostream &os, Symbol s) { return os << s.str(); }
+
+  private:
+    uint32_t id_ = 0; // 驻留表句柄（0 表示空串）
+};
+
 // ======================== 操作数 ========================
 
 // Operand 类：表示 IR 指令的操作数，可以是虚拟寄存器、立即数、标签或布尔字面量
+// 统一为 "种类 + 32 位值" 的 8 字节表示，标签名以 Symbol 句柄的形式存放在 value_ 中
 class Operand {
   public:
     // 操作数类型枚举
-    enum class Kind {
+    enum class Kind : uint8_t {
         None,    // 空操作数
         VReg,    // 虚拟寄存器（如 %1, %2）
         Imm,     // 立即数（如 42）
@@ -94,10 +145,10 @@ class Operand {
         o.value_ = val;
         return o;
     }
-    static Operand label(const std::string &name) { // 创建标签操作数
+    static Operand label(Symbol name) { // 创建标签操作数
         Operand o;
         o.kind_ = Kind::Label;
-        o.label_ = name;
+        o.value_ = static_cast<int32_t>(name.id());
         return o;
     }
     static Operand boolLit(bool val) { // 创建布尔字面量操作数
@@ -119,29 +170,35 @@ class Operand {
     int regId() const { return value_; }          // 获取虚拟寄存器 ID
     int immValue() const { return value_; }       // 获取立即数值
     bool boolValue() const { return value_ != 0; } // 获取布尔值
-    const std::string &labelName() const { return label_; } // 获取标签名
+    Symbol labelSym() const { return isLabel() ? Symbol::fromId(static_cast<uint32_t>(value_)) : Symbol(); } // 标签句柄
+    const std::string &labelName() const { return labelSym().str(); }              // 获取标签名
 
     // toString：序列化为 LLVM IR 文本（如 "%1", "42", "true", "%entry"）
     std::string toString() const;
 
   private:
     Kind kind_ = Kind::None; // 操作数种类
-    int value_ = 0;          // 整数值（寄存器ID / 立即数 / 布尔值）
-    std::string label_;       // 标签名称（仅 Label 类型使用）
+    int32_t value_ = 0;      // 整数值（寄存器ID / 立即数 / 布尔值 / 标签句柄）
 };
+static_assert(sizeof(Operand) == 8, "Operand should stay kind + 32-bit value");
 
 // ======================== 指令 ========================
 
+// OperandList / RegList：指令的操作数列表与寄存器编号列表，3 个以内不产生堆分配
+using OperandList = SmallVector<Operand, 3>;
+using RegList = SmallVector<int, 3>;
+
 // Instruction 类：表示一条 IR 指令，包含操作码、操作数、结果定义等信息
 class Instruction {
   public:
     Opcode opcode;                // 指令操作码
-    std::string type;             // 操作类型（"i32", "i1", "void"）
+    Symbol type;                  // 操作类型（"i32", "i1", "void"）
     Operand def;                  // 结果寄存器（若无定义则为 None）
-    std::vector<Operand> ops;     // 操作数列表
+    OperandList ops;              // 操作数列表（≤3 个时内联存储）
     CmpPred cmpPred = CmpPred::EQ; // 比较谓词（仅 ICmp 指令使用）
-    std::string callee;           // 被调用函数名（仅 Call 指令使用）
+    Symbol callee;                // 被调用函数名（仅 Call 指令使用）
     bool nsw = false;             // no-signed-wrap 标志（算术运算使用）
+    bool tail = false;            // 尾调用标记（仅 Call 使用：紧跟返回其结果的 ret，可先撤销栈帧再跳转）
     int align = 4;                // 内存对齐（Alloca/Load/Store 使用）
 
     int index = -1;   // 线性化后的全局顺序编号（用于活跃性分析）
@@ -162,6 +219,21 @@ class Instruction {
     static Instruction makeRetVoid();
     static Instruction makeCall(Operand def, const std::string &retType, const std::string &callee,
                                 std::vector<Operand> args);
+    static Instruction makePhi(Operand def, const std::string &type);
+    static Instruction makeCopy(Operand def, const std::string &type, Operand value);
+
+    // -------- Phi 入口（ops 按 [值, 前驱标签] 成对存放）--------
+
+    // addIncoming：追加一个 (值, 前驱块标签) 入口
+    void addIncoming(Operand value, Symbol pred) {
+        ops.push_back(value);
+        ops.push_back(Operand::label(pred));
+    }
+    // numIncoming / incomingValue / incomingBlock：第 k 个入口的值与前驱块标签
+    size_t numIncoming() const { return ops.size() / 2; }
+    Operand &incomingValue(size_t k) { return ops[2 * k]; }
+    const Operand &incomingValue(size_t k) const { return ops[2 * k]; }
+    Symbol incomingBlock(size_t k) const { return ops[2 * k + 1].labelSym(); }
 
     // -------- 查询接口（基于 opcode 判断，无需正则匹配）--------
 
@@ -169,7 +241,49 @@ class Instruction {
     int defReg() const;
 
     // useRegs：返回指令使用（读取）的所有虚拟寄存器 ID
-    std::vector<int> useRegs() const;
+    RegList useRegs() const;
+
+    // forEachUse：按 useRegs 的顺序对每个读取的虚拟寄存器调用 fn(int)，不构造列表
+    // （活跃性、区间构建与代码生成对每条指令反复查询，实参多于 3 个的 call 也不分配内存）
+    template <typename Fn> void forEachUse(Fn &&fn) const {
+        switch (opcode) {
+        case Opcode::Load:   // ops[0] = ptr
+        case Opcode::CondBr: // ops[0] = 条件，ops[1,2] = 目标标签
+        case Opcode::Ret:    // ops[0] = 返回值
+        case Opcode::Copy:   // ops[0] = 来源
+            if (!ops.empty() && ops[0].isVReg())
+                fn(ops[0].regId());
+            return;
+        case Opcode::Store: // ops[0] = value，ops[1] = ptr
+        case Opcode::Add:
+        case Opcode::Sub:
+        case Opcode::Mul:
+        case Opcode::SDiv:
+        case Opcode::SRem:
+        case Opcode::ICmp:
+        case Opcode::Call: // ops 全部为实参
+            for (const Operand &op : ops)
+                if (op.isVReg())
+                    fn(op.regId());
+            return;
+        case Opcode::Phi: // 偶数下标为入口值，奇数下标为前驱标签
+            for (size_t k = 0; k < numIncoming(); ++k)
+                if (incomingValue(k).isVReg())
+                    fn(incomingValue(k).regId());
+            return;
+        case Opcode::Alloca:
+        case Opcode::Br:
+        case Opcode::RetVoid:
+            return;
+        }
+    }
+
+    // readsReg：指令是否读取 vreg
+    bool readsReg(int vreg) const {
+        bool found = false;
+        forEachUse([&](int u) { found |= u == vreg; });
+        return found;
+    }
 
     // isTerminator：判断是否为终结指令（br/condbr/ret/retvoid）
     bool isTerminator() const;
@@ -192,6 +306,31 @@ class Instruction {
     std::string toString() const;
 };
 
+// ======================== 指令池 ========================
+
+// InstructionPool：函数级指令池，按固定容量的 slab 连续分配指令对象
+// 指令地址在函数生命周期内保持不变；按发射顺序分配，同一基本块的指令在内存中基本相邻，
+// 遍历时不再逐条追踪独立的堆对象。池析构时统一析构所有指令
+class InstructionPool {
+  public:
+    InstructionPool() = default;
+    ~InstructionPool();
+    InstructionPool(const InstructionPool &) = delete;
+    InstructionPool &operator=(const InstructionPool &) = delete;
+
+    // create：在池中构造一条指令并返回其（稳定的）地址
+    Instruction *create(Instruction &&inst);
+    // size：池中已分配的指令条数
+    size_t size() const { return count_; }
+
+  private:
+    static constexpr size_t kSlabSize = 256; // 每个 slab 容纳的指令条数
+
+    std::vector<Instruction *> slabs_; // 未初始化的原始存储，每块 kSlabSize 条
+    size_t used_ = kSlabSize;          // 当前（最后一个）slab 已用条数
+    size_t count_ = 0;                 // 已分配的指令总数
+};
+
 // ======================== 基本块 ========================
 
 // BasicBlock 类：表示控制流图中的一个基本块
@@ -199,14 +338,15 @@ class BasicBlock {
   public:
     int id = -1;          // 基本块编号
     std::string name;     // 基本块标签名（如 "entry", "if.then"）
-    std::vector<std::unique_ptr<Instruction>> insts; // 指令列表
+    std::vector<Instruction *> insts; // 指令列表（指令由所属函数的 InstructionPool 持有）
+    int64_t profileCount = -1;        // --profile-use 读入的执行次数（-1 表示没有剖析数据）
 
     std::vector<BasicBlock *> succs; // 后继基本块列表
     std::vector<BasicBlock *> preds; // 前驱基本块列表
 
-    // 活跃性分析数据（用于寄存器分配）
-    std::set<int> defSet, useSet;   // 基本块内定义和使用的寄存器集合
-    std::set<int> liveIn, liveOut;  // 块入口和出口的活跃寄存器集合
+    // 活跃性分析数据（用于寄存器分配，位宽为 maxVregId + 1）
+    BitVector defSet, useSet;   // 基本块内定义和使用的寄存器集合
+    BitVector liveIn, liveOut;  // 块入口和出口的活跃寄存器集合
 
     // firstPos/lastPos：返回块内第一条/最后一条指令的位置（用于活跃区间计算）
     int firstPos() const;
@@ -221,6 +361,52 @@ struct FuncParam {
     std::string type = "i32";  // 参数类型（ToyC 中统一为 i32）
 };
 
+// ======================== 向量内核 ========================
+
+// VectorKernel：循环向量化（opt::vectorizeLoops，--march=rv32imv）生成的内核函数的向量化描述。
+// 内核 @k(cnt, p1, ..., pm) 返回 sum(E(j), j = 0 .. cnt-1)（cnt 按无符号数计），E 由 values 中的向量值按顺序算出；
+// 函数体另有等价的标量循环（--ir 输出与不识别描述的后端使用），代码生成见 generateVectorKernel
+struct VectorKernel {
+    // Value：一个按元素计算的向量值
+    struct Value {
+        enum class Kind : uint8_t {
+            Param, // 形参 index 广播到各元素
+            Const, // 常量 imm 广播到各元素
+            Index, // 迭代序号 j
+            Acc,   // 累加器（归约的上一次部分和，只被第一个运算读取一次）
+            Op,    // opcode（add/sub/mul/sdiv/srem）作用于 values[lhs]、values[rhs]
+        } kind;
+        Opcode opcode = Opcode::Add;
+        int lhs = -1, rhs = -1; // Op 的操作数（values 下标，只引用在前的值）
+        int32_t imm = 0;        // Param 的形参下标 / Const 的常量
+    };
+    std::vector<Value> values;
+    int result = -1; // 新的累加器值（Acc 经 add / sub 链得到，恒等于 Acc + E(j)）
+};
+
+// ======================== 紧凑 CFG ========================
+
+// CFG：Function::buildCFG 建立的控制流图快照。块以 id 编号（要求 id 等于其在 Function::blocks 中的
+// 下标，与 DominatorTree 相同），Br / CondBr 的标签在建立时一次解析为块号；边按 CSR 存储：
+// 块 b 的后继为 succ[succBegin[b], succBegin[b + 1])，前驱同理，顺序与 BasicBlock::succs / preds 一致。
+// RPO、活跃性与支配树在这些数组上迭代，不查标签表、不逐块分配小数组。
+// 就地修改 BasicBlock::succs / preds 的变换（CFG 化简）不会同步到这里，之后须再次 buildCFG
+struct CFG {
+    std::vector<uint32_t> succBegin, succ; // 后继（CSR，succBegin 有 size() + 1 项）
+    std::vector<uint32_t> predBegin, pred; // 前驱（CSR）
+
+    size_t size() const { return succBegin.empty() ? 0 : succBegin.size() - 1; }
+    std::span<const uint32_t> succs(size_t b) const {
+        return {succ.data() + succBegin[b], succ.data() + succBegin[b + 1]};
+    }
+    std::span<const uint32_t> preds(size_t b) const {
+        return {pred.data() + predBegin[b], pred.data() + predBegin[b + 1]};
+    }
+
+    // fillPreds：由后继数组按块顺序计数回填前驱数组（size 个结点）
+    void fillPreds(size_t size);
+};
+
 // ======================== 函数 ========================
 
 // Function 类：表示一个 IR 函数，包含参数、基本块、CFG 信息
@@ -232,17 +418,39 @@ class Function {
     std::vector<std::unique_ptr<BasicBlock>> blocks;    // 基本块列表（按序）
     std::unordered_map<std::string, BasicBlock *> blockMap; // 标签名 → 基本块的快速查找表
     std::vector<BasicBlock *> rpoOrder;                 // 逆后序遍历顺序（用于数据流分析）
+    CFG cfg;                                            // 紧凑 CFG（buildCFG 时建立）
     std::vector<int> paramVregs;                        // 函数参数对应的虚拟寄存器 ID
     int maxVregId = -1;                                 // 最大虚拟寄存器编号
+    InstructionPool instPool;                           // 本函数所有指令的存储
+    uint64_t cfgVersion = 0;                            // CFG 版本号（每次 buildCFG 递增）
+    // 循环向量化生成的内核函数的向量化描述（其余函数为空；不随 .bir 序列化，读回后按标量编译）
+    std::shared_ptr<const VectorKernel> vectorKernel;
+
+    Function();
+    ~Function();
+    Function(const Function &) = delete;
+    Function &operator=(const Function &) = delete;
+
+    // newInst：在指令池中创建一条指令（调用方负责将其加入某个基本块）
+    Instruction *newInst(Instruction inst) { return instPool.create(std::move(inst)); }
 
-    // buildCFG：根据分支指令构建控制流图（计算 succs/preds）
+    // buildCFG：根据分支指令构建控制流图（cfg 与各块的 succs/preds），并使缓存的 CFG 分析失效
     void buildCFG();
 
+    // clone：深拷贝函数（指令复制到新函数自己的指令池，CFG 重新构建；不复制分析缓存与活跃性数据）
+    std::unique_ptr<Function> clone() const;
+
+    // analyses：本函数的分析缓存（支配树 / 后支配树 / 循环森林，见 ir_analysis.h）
+    AnalysisManager &analyses();
+
     // entryBlock：返回函数入口基本块
     BasicBlock *entryBlock() const;
 
     // toString：将函数序列化为 LLVM IR 文本
     std::string toString() const;
+
+  private:
+    std::unique_ptr<AnalysisManager> analyses_;
 };
 
 // ======================== 模块 ========================
@@ -255,6 +463,10 @@ class Module {
     std::string targetTriple = "riscv32-unknown-elf";   // 目标三元组
     std::vector<std::unique_ptr<Function>> functions;   // 函数定义列表
 
+    // strings：标签/类型/被调函数名使用的字符串驻留表
+    // 驻留表为进程级共享，使不同模块（及并行编译的线程）之间的 Symbol 可以直接比较
+    StringInterner &strings() const { return StringInterner::global(); }
+
     // toString：将模块序列化为完整的 LLVM IR 文本
     std::string toString() const;
 };
@@ -0,0 +1,246 @@
+#pragma once
+#include "ir.h"
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace toyc {
+
+// ======================== 支配树 ========================
+//
+// DominatorTree：函数 CFG 的支配树与支配边界（供 mem2reg 等 SSA 变换使用）
+// 直接支配者用 Cooper-Harvey-Kennedy 迭代算法在逆后序上求解，支配边界按前驱回溯 idom 链计算；
+// 支配关系查询用支配树先序 / 后序编号，O(1) 完成。
+// 要求 BasicBlock::id 等于其在 Function::blocks 中的下标，且已调用 Function::buildCFG；
+// CFG 改变后须重新构造（通过 AnalysisManager 获取时自动完成）。
+// 从入口不可达的块不在树中（idom 为空，不支配也不被支配）
+class DominatorTree {
+  public:
+    explicit DominatorTree(const ir::Function &F) : DominatorTree(F, false) {}
+
+    // rpo：树中基本块的逆后序（根在最前；后支配树中为反向 CFG 的逆后序）
+    const std::vector<ir::BasicBlock *> &rpo() const { return rpo_; }
+
+    // isReachable：基本块是否在树中
+    bool isReachable(const ir::BasicBlock *bb) const { return rpoIndex_[bb->id] >= 0; }
+
+    // idom：直接支配者（根与不在树中的块返回 nullptr）
+    ir::BasicBlock *idom(const ir::BasicBlock *bb) const { return idom_[bb->id]; }
+
+    // children：支配树上的子节点（按逆后序）
+    const std::vector<ir::BasicBlock *> &children(const ir::BasicBlock *bb) const {
+        return children_[bb->id];
+    }
+
+    // frontier：支配边界 DF(bb)
+    const std::vector<ir::BasicBlock *> &frontier(const ir::BasicBlock *bb) const {
+        return frontier_[bb->id];
+    }
+
+    // dominates：a 是否支配 b（树中每个块都支配自身）
+    bool dominates(const ir::BasicBlock *a, const ir::BasicBlock *b) const;
+
+  protected:
+    // reverse 为 true 时在反向 CFG 上求解：所有没有后继的块挂在一个虚拟出口下
+    DominatorTree(const ir::Function &F, bool reverse);
+
+  private:
+    std::vector<ir::BasicBlock *> rpo_;
+    std::vector<int> rpoIndex_;                            // 块 id → 逆后序下标（不在树中为 -1）
+    std::vector<ir::BasicBlock *> idom_;                   // 块 id → 直接支配者
+    std::vector<std::vector<ir::BasicBlock *>> children_;  // 块 id → 支配树子节点
+    std::vector<std::vector<ir::BasicBlock *>> frontier_;  // 块 id → 支配边界
+    std::vector<int> preNum_, postNum_;                    // 支配树先序 / 后序编号
+
+    // 求解用的整数图即紧凑 CFG（CSR）：结点 0..n-1 为基本块；正向直接使用 Function::cfg，
+    // 反向图由它翻转得到，结点 n 为虚拟出口
+    static ir::CFG reverseGraph(const ir::Function &F);
+    void solve(const ir::Function &F, const ir::CFG &G, int root);
+};
+
+// ======================== 后支配树 ========================
+//
+// PostDominatorTree：反向 CFG 上的支配树，a 后支配 b ⇔ 从 b 到函数出口的每条路径都经过 a。
+// 多个出口块（ret）汇入一个虚拟出口，它们的 idom 为 nullptr；
+// 到不了任何出口的块（死循环）不在树中。frontier 即反向支配边界（控制依赖）
+class PostDominatorTree : public DominatorTree {
+  public:
+    explicit PostDominatorTree(const ir::Function &F) : DominatorTree(F, true) {}
+};
+
+// ======================== 循环森林 ========================
+
+// Loop：一个自然循环（同一头结点的所有回边合并为一个循环）
+struct Loop {
+    ir::BasicBlock *header = nullptr;     // 循环头（支配循环内所有块）
+    Loop *parent = nullptr;               // 外层循环（最外层为 nullptr）
+    std::vector<Loop *> subLoops;         // 直接内层循环
+    std::vector<ir::BasicBlock *> blocks; // 循环内所有块（含内层循环的块，按逆后序，头结点在前）
+    std::vector<ir::BasicBlock *> latches; // 回边的源块
+    int depth = 1;                        // 嵌套深度（最外层为 1）
+
+    // contains：other 是否为本循环或其内层循环（块 bb 是否在循环内：contains(LI.loopFor(bb))）
+    bool contains(const Loop *other) const;
+};
+
+// LoopInfo：函数的自然循环森林
+// 回边 t → h 满足 h 支配 t；按逆后序的逆序处理头结点（内层循环先发现），
+// 从回边源块沿前驱反向收集循环体，遇到已归属内层循环的块直接跳到该内层循环的最外层头结点，
+// 因此每个块在每一层嵌套上只被访问常数次。不可归约的环（没有支配它的头结点）不视为循环
+class LoopInfo {
+  public:
+    LoopInfo(const ir::Function &F, const DominatorTree &DT);
+
+    // loopFor：包含该块的最内层循环（不在任何循环中为 nullptr）
+    Loop *loopFor(const ir::BasicBlock *bb) const { return innermost_[bb->id]; }
+
+    // loopDepth：块的循环嵌套深度（不在循环中为 0）
+    int loopDepth(const ir::BasicBlock *bb) const {
+        Loop *L = innermost_[bb->id];
+        return L ? L->depth : 0;
+    }
+
+    // isLoopHeader：块是否为某个循环的头结点
+    bool isLoopHeader(const ir::BasicBlock *bb) const {
+        Loop *L = innermost_[bb->id];
+        return L && L->header == bb;
+    }
+
+    // topLevelLoops：最外层循环（按头结点的逆后序）
+    const std::vector<Loop *> &topLevelLoops() const { return topLevel_; }
+
+    // size：循环总数
+    size_t size() const { return loops_.size(); }
+
+  private:
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::vector<Loop *> topLevel_;
+    std::vector<Loop *> innermost_; // 块 id → 最内层循环
+};
+
+// blockFrequency：块在每次函数调用中的估计执行次数（溢出权重与寄存器偏好的单位）
+// 没有剖析数据时为 10^循环深度（深度上限 9）；函数有剖析数据（入口块计数 > 0）时
+// 以 1/kProfileFrequencyScale 次为单位：计数已知的块取 计数 × scale / 入口计数（至少为 1），
+// 其余块（优化中新建、插桩构建里没有的块）仍按 scale × 10^循环深度 估计
+constexpr uint64_t kProfileFrequencyScale = 16;
+uint64_t blockFrequency(const ir::Function &F, const LoopInfo &loops, const ir::BasicBlock *bb);
+
+// ======================== def-use 链 ========================
+//
+// DefUseChains：函数中每个 vreg 的定义指令与读取它的指令，扫描两遍建立（先计数再填充），
+// 存放在按 vreg 编号的扁平数组中（CSR）：v 的定义为 defs_[defBegin_[v], defBegin_[v + 1])，
+// 使用同理。两者都按块、块内指令的顺序排列，一条指令多次读取同一 vreg 时出现多次。
+// "读取 %v 的全部指令" 为 O(使用数) 查询，不再扫描整个函数；SSA 之前（-O0 的拷贝、phi 消除后）
+// 一个 vreg 可以有多处定义。只反映建立时的指令：增删指令或改写操作数之后须重新建立
+// （不由 AnalysisManager 缓存，它只跟踪 CFG 版本）。参数与未定义的 vreg 没有定义指令
+class DefUseChains {
+  public:
+    explicit DefUseChains(const ir::Function &F);
+
+    // size：vreg 编号的上界（不小于 maxVregId + 1，覆盖指令中出现的全部编号）
+    size_t size() const { return defBegin_.size() - 1; }
+
+    // defs / uses：定义 / 读取 vreg 的指令（编号越界时为空）
+    std::span<ir::Instruction *const> defs(int vreg) const {
+        return slice(defs_, defBegin_, vreg);
+    }
+    std::span<ir::Instruction *const> uses(int vreg) const {
+        return slice(uses_, useBegin_, vreg);
+    }
+    size_t numDefs(int vreg) const { return defs(vreg).size(); }
+    size_t numUses(int vreg) const { return uses(vreg).size(); }
+
+  private:
+    std::vector<uint32_t> defBegin_, useBegin_; // vreg → 区间起点（size() + 1 项）
+    std::vector<ir::Instruction *> defs_, uses_;
+
+    static std::span<ir::Instruction *const> slice(const std::vector<ir::Instruction *> &items,
+                                                   const std::vector<uint32_t> &begin, int vreg) {
+        if (vreg < 0 || static_cast<size_t>(vreg) + 1 >= begin.size())
+            return {};
+        return {items.data() + begin[vreg], items.data() + begin[vreg + 1]};
+    }
+};
+
+// ======================== 调用图 ========================
+//
+// CallGraph：模块内函数之间的调用关系（只记录模块中有定义的被调函数）。
+// 强连通分量用 Tarjan 算法（显式栈，深调用链不会耗尽调用栈）求出，按自底向上的顺序排列：
+// 每个分量的被调函数都在更早的分量中（或就在本分量内，即递归）。
+// 函数增删或调用关系改变后须重新构造（唯一的例外是 refreshSelfRecursion）
+class CallGraph {
+  public:
+    explicit CallGraph(const ir::Module &M);
+
+    // function：按名字查找模块中定义的函数（未定义为 nullptr）
+    ir::Function *function(const std::string &name) const;
+
+    // callees：F 调用的（模块内定义的）函数，按首次出现的顺序去重
+    const std::vector<ir::Function *> &callees(const ir::Function *F) const {
+        return callees_[indexOf(F)];
+    }
+
+    // bottomUpSCCs：强连通分量，被调者所在的分量在前
+    const std::vector<std::vector<ir::Function *>> &bottomUpSCCs() const { return sccs_; }
+
+    // isRecursive：F 是否直接调用自身或与其他函数互相递归
+    bool isRecursive(const ir::Function *F) const { return recursive_[indexOf(F)] != 0; }
+
+    // refreshSelfRecursion：F 被改写后重新判断自递归 —— 单独成一个分量且不再调用自身时
+    // 不再视为递归（自递归消除把递归改写为循环之后，F 可以被内联进调用者）
+    void refreshSelfRecursion(const ir::Function *F);
+
+    // sameSCC：两个函数是否在同一个强连通分量中
+    bool sameSCC(const ir::Function *a, const ir::Function *b) const {
+        return sccOf_[indexOf(a)] == sccOf_[indexOf(b)];
+    }
+
+  private:
+    std::vector<ir::Function *> functions_;
+    std::unordered_map<std::string, int> byName_;
+    std::unordered_map<const ir::Function *, int> index_;
+    std::vector<std::vector<ir::Function *>> callees_; // 函数下标 → 被调函数
+    std::vector<std::vector<ir::Function *>> sccs_;
+    std::vector<int> sccOf_;      // 函数下标 → 分量下标
+    std::vector<char> recursive_; // 函数下标 → 是否递归
+
+    int indexOf(const ir::Function *F) const { return index_.at(F); }
+};
+
+// ======================== 分析管理器 ========================
+//
+// AnalysisManager：挂在 ir::Function 上的分析缓存（通过 Function::analyses() 获取）。
+// 各分析在首次请求时计算并缓存；Function::buildCFG 会递增 cfgVersion，
+// 下一次请求时发现版本变化即丢弃全部缓存，因此 CFG 变换之后只需照常调用 buildCFG。
+// 若函数尚未构建过 CFG，首次请求时自动调用 buildCFG。
+// 只改动指令、不改动 CFG 的变换（如 mem2reg 的重命名）之后，缓存的结果仍然有效
+class AnalysisManager {
+  public:
+    explicit AnalysisManager(ir::Function &F) : F_(F) {}
+
+    // domTree：支配树（含支配边界）
+    const DominatorTree &domTree();
+
+    // postDomTree：后支配树
+    const PostDominatorTree &postDomTree();
+
+    // loops：自然循环森林（依赖支配树）
+    const LoopInfo &loops();
+
+    // invalidate：丢弃全部缓存的分析
+    void invalidate();
+
+  private:
+    ir::Function &F_;
+    uint64_t version_ = 0; // 缓存对应的 Function::cfgVersion
+    std::unique_ptr<DominatorTree> dom_;
+    std::unique_ptr<PostDominatorTree> postDom_;
+    std::unique_ptr<LoopInfo> loops_;
+
+    // sync：CFG 版本变化时丢弃缓存
+    void sync();
+};
+
+} // namespace toyc
@@ -0,0 +1,73 @@
+#pragma once
+#include "ir.h"
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace toyc {
+
+// ======================== 二进制 IR（.bir） ========================
+//
+// 文件布局（整数均为 LEB128 变长编码，有符号值先做 zigzag 变换）：
+//   魔数 "TBIR" | 版本号
+//   字符串表：个数 N，随后 N-1 个 (长度, 字节)（下标 0 固定为空串，不存储）
+//   模块头：name / sourceFile / targetTriple 的字符串下标
+//   函数索引：个数 F，随后 F 个 (函数名下标, 函数体偏移, 函数体长度)，偏移相对于函数体区起点
+//   函数体区：各函数体依次排列
+//
+// 函数体：返回类型、参数 (名, 类型)、paramVregs、maxVregId，随后按序存储基本块 (名, 指令列表)。
+// 每条指令以 1 字节开头：低 4 位为 Opcode，高 4 位标记 nsw（call 为 tail）/ 非默认 align /
+// 非默认谓词 / callee，只有被标记的字段才会写出；操作数以 1 字节种类开头，标签以字符串下标存储。
+// 标签名、类型名和被调函数名全部进入字符串表，读取时一次性驻留为 Symbol。
+
+// writeBinaryIR：把模块序列化为 .bir（读回后与原模块的 toString() 完全一致）
+void writeBinaryIR(const ir::Module &mod, std::ostream &os);
+
+// isBinaryIR：data 是否以 .bir 魔数开头
+bool isBinaryIR(std::string_view data);
+
+// BinaryIRReader：读取 .bir 数据
+// 构造时只解析文件头、字符串表和函数索引；函数体在 readFunction 时按索引定位后解码，
+// 因此可以只取出其中的个别函数。data 必须比 reader 活得更久。
+// 数据截断、版本不符或字段越界时抛出 std::runtime_error
+class BinaryIRReader {
+  public:
+    explicit BinaryIRReader(std::string_view data);
+
+    // numFunctions / functionName：函数索引
+    size_t numFunctions() const { return index_.size(); }
+    const std::string &functionName(size_t i) const { return symbols_[index_[i].name].str(); }
+
+    // findFunction：按名字查找函数下标，不存在时返回 -1
+    int findFunction(std::string_view name) const;
+
+    // readFunction：解码第 i 个函数
+    std::unique_ptr<ir::Function> readFunction(size_t i) const;
+
+    // readModule：解码整个模块
+    std::unique_ptr<ir::Module> readModule() const;
+
+    // readModule：解码模块头与下标列表中的函数（按列表顺序）
+    std::unique_ptr<ir::Module> readModule(const std::vector<size_t> &functions) const;
+
+  private:
+    // FunctionEntry：函数索引项
+    struct FunctionEntry {
+        uint32_t name;   // 函数名的字符串下标
+        uint64_t offset; // 函数体在函数体区中的偏移
+        uint64_t size;   // 函数体字节数
+    };
+
+    std::string_view data_;
+    std::vector<ir::Symbol> symbols_;  // 字符串表（已驻留）
+    uint32_t moduleName_ = 0;          // 模块头字段的字符串下标
+    uint32_t sourceFile_ = 0;
+    uint32_t targetTriple_ = 0;
+    std::vector<FunctionEntry> index_; // 函数索引
+    size_t bodyBase_ = 0;              // 函数体区在 data_ 中的起点
+};
+
+} // namespace toyc
@@ -1,7 +1,8 @@
 #pragma once
 #include "ast.h"
 #include "ir.h"
-#include <map>
+#include "parser.h"
+#include "symbol_table.h"
 #include <vector>
 
 namespace toyc {
@@ -10,11 +11,13 @@ namespace toyc {
 // 采用递归下降方式遍历 AST，生成对应的 IR 指令
 class IRBuilder {
   public:
-    // 构造函数
-    IRBuilder();
+    IRBuilder() = default;
 
     // 生成完整的模块 IR（包含所有函数）
-    std::unique_ptr<ir::Module> buildModule(const std::vector<std::shared_ptr<FuncDef>> &funcs);
+    std::unique_ptr<ir::Module> buildModule(const CompUnit &unit);
+
+    // 为单个函数生成 IR（函数之间不共享状态，调用处统一按 i32 返回值生成）
+    std::unique_ptr<ir::Function> buildFunction(const FuncDef &funcDef);
 
   private:
     int vregCounter_ = 0;          // 虚拟寄存器计数器
@@ -23,14 +26,11 @@ class IRBuilder {
     bool isMainFunction_ = false;  // 标记是否为 main 函数
     bool hasReturn_ = false;       // 标记函数是否已有返回语句
 
-    ir::Module *module_ = nullptr;       // 当前模块指针
     ir::Function *currentFunc_ = nullptr; // 当前函数指针
     ir::BasicBlock *currentBB_ = nullptr; // 当前基本块（指令插入点）
 
-    // 作用域栈：每个作用域包含变量名 → alloca 结果寄存器的映射
-    std::vector<std::map<std::string, ir::Operand>> scopeStack_;
-    // 已加载值缓存：变量名 → load 结果寄存器，避免重复 load
-    std::map<std::string, ir::Operand> loadedValues_;
+    // 块作用域符号表：驻留编号 → alloca 结果寄存器，并缓存各变量已加载的值以避免重复 load
+    ScopedSymbolTable symbols_;
 
     std::vector<std::string> breakLabels_;    // break 跳转目标标签栈
     std::vector<std::string> continueLabels_; // continue 跳转目标标签栈
@@ -48,54 +48,68 @@ class IRBuilder {
     // 发射一条指令到当前基本块
     void emit(ir::Instruction inst);
 
-    // -------- 作用域管理 --------
-
-    void enterScope();  // 进入新作用域
-    void exitScope();   // 退出当前作用域
-    // 在当前作用域添加变量（变量名 → alloca 寄存器）
-    void addVariable(const std::string &name, const ir::Operand &allocaReg);
-    // 从当前作用域开始向外查找变量
-    ir::Operand findVariable(const std::string &name);
-
     // -------- 函数/语句/表达式生成 --------
 
-    // 为单个函数生成 IR
-    void buildFunction(const std::shared_ptr<FuncDef> &funcDef);
     // 生成语句块 IR
-    void buildBlock(const std::shared_ptr<BlockStmt> &block);
-    // 生成单条语句 IR（根据实际类型 dispatch）
-    void buildStmt(const ASTPtr &stmt);
+    void buildBlock(const BlockStmt &block);
+    // 生成单条语句 IR（按节点种类标签 dispatch）
+    void buildStmt(const ASTNode *stmt);
     // 生成表达式 IR，返回结果操作数
-    ir::Operand buildExpr(const ASTPtr &expr);
+    ir::Operand buildExpr(const ASTNode *expr);
+    // 生成变量读取 IR（命中已加载值缓存时不再 load）
+    ir::Operand buildIdentifier(const IdentifierExpr &e);
 
     // 生成赋值语句 IR
-    void buildAssign(const std::shared_ptr<AssignStmt> &assign);
+    void buildAssign(const AssignStmt &assign);
     // 生成声明语句 IR
-    void buildDecl(const std::shared_ptr<DeclStmt> &decl);
+    void buildDecl(const DeclStmt &decl);
     // 生成 if 语句 IR（含条件分支和合并块）
-    void buildIf(const std::shared_ptr<IfStmt> &ifStmt);
+    void buildIf(const IfStmt &ifStmt);
     // 生成 while 循环 IR（含条件块、循环体块、出口块）
-    void buildWhile(const std::shared_ptr<WhileStmt> &whileStmt);
+    void buildWhile(const WhileStmt &whileStmt);
     // 生成返回语句 IR
-    void buildReturn(const std::shared_ptr<ReturnStmt> &retStmt);
+    void buildReturn(const ReturnStmt &retStmt);
     // 生成 break 语句 IR（跳转到最近的循环出口）
     void buildBreak();
     // 生成 continue 语句 IR（跳转到最近的循环条件块）
     void buildContinue();
 
     // 生成二元运算 IR（算术/比较/逻辑由此分发）
-    ir::Operand buildBinaryOp(const std::string &op, const ASTPtr &lhs, const ASTPtr &rhs);
+    ir::Operand buildBinaryOp(BinaryOp op, const ASTNode *lhs, const ASTNode *rhs);
     // 生成一元运算 IR（负号/逻辑非）
-    ir::Operand buildUnaryOp(const std::string &op, const ASTPtr &expr);
+    ir::Operand buildUnaryOp(UnaryOp op, const ASTNode *expr);
     // 生成比较运算 IR（==, !=, <, >, <=, >=）
-    ir::Operand buildComparison(const std::string &op, const ASTPtr &lhs, const ASTPtr &rhs);
+    ir::Operand buildComparison(BinaryOp op, const ASTNode *lhs, const ASTNode *rhs);
     // 生成逻辑运算 IR（&& / ||，实现短路语义）
-    ir::Operand buildLogicalOp(const std::string &op, const ASTPtr &lhs, const ASTPtr &rhs);
+    ir::Operand buildLogicalOp(BinaryOp op, const ASTNode *lhs, const ASTNode *rhs);
     // 生成函数调用 IR
-    ir::Operand buildCall(const std::shared_ptr<CallExpr> &call);
+    ir::Operand buildCall(const CallExpr &call);
 };
 
 // 便捷函数：从 AST 生成 LLVM IR 文本
-std::string generateLLVMIR(const std::vector<std::shared_ptr<FuncDef>> &funcs);
+std::string generateLLVMIR(const CompUnit &unit);
+
+// LazySourceModule：按需解析的 ToyC 源码模块（对应 .ll 输入的 LazyIRModule）
+// 构造时只用 Parser::indexFunctions 做一遍词法扫描找出函数边界，take(i) 时才把第 i 个函数
+// 解析为 AST、生成 IR，随即释放 AST。配合流水线代码生成，解析 → 生成 IR → 分配 → 输出逐函数
+// 进行，峰值内存与最大的单个函数而非整个翻译单元成正比。
+// 不同下标的函数互不共享状态，可以在多个线程上同时取出；source 必须比本对象活得更久
+class LazySourceModule {
+  public:
+    explicit LazySourceModule(std::string_view source);
+
+    // size / name：函数索引（与源码中的定义顺序一致）
+    size_t size() const { return funcs_.size(); }
+    std::string_view name(size_t i) const { return funcs_[i].name; }
+
+    // find：按名字查找函数下标，不存在时返回 -1
+    int find(std::string_view name) const;
+
+    // take：解析第 i 个函数并生成其 IR（语法错误时抛出 ParseError，行号与整个文件一致）
+    std::unique_ptr<ir::Function> take(size_t i) const;
+
+  private:
+    std::vector<SourceFunction> funcs_;
+};
 
 } // namespace toyc
@@ -2,33 +2,79 @@
 #include "ir.h"
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace toyc {
 
 // IRParser 类：将 LLVM IR 文本解析为结构化 ir::Module / ir::Function
-// 通过正则表达式逐行匹配 IR 指令，构建结构化的 IR 表示
+// 解析直接在输入文本（可以是 mmap 映射区的 string_view）上用游标进行，不复制函数体、不构造子串：
+// 先由 indexFunctions 一次扫描定位每个 define 的定义行与函数体区间，再逐个函数就地解析。
+// 各函数的解析互不依赖，parseModule 可把它们分配到多个线程上并行完成
 class IRParser {
   public:
-    // 解析完整的 LLVM IR 文本为 Module（包含所有函数）
-    std::unique_ptr<ir::Module> parseModule(const std::string &irText);
+    // FunctionText：一个函数在输入文本中的位置（视图指向输入文本，须比其使用者活得更久）
+    struct FunctionText {
+        std::string_view defLine; // "define ..." 行（已去除首尾空白）
+        std::string_view body;    // 定义行之后、"}" 行之前的全部文本
+    };
 
-    // 解析单个函数（若 funcName 为空则取第一个函数）
-    std::unique_ptr<ir::Function> parseFunction(const std::string &irText,
-                                                const std::string &funcName = "");
+    // indexFunctions：扫描出所有完整函数（以 "}" 行结尾）的定义行与函数体区间
+    static std::vector<FunctionText> indexFunctions(std::string_view irText);
 
-  private:
-    // 从函数定义行和函数体文本构建 Function 对象
-    std::unique_ptr<ir::Function> parseFunctionFromDefAndBody(const std::string &defLine,
-                                                              const std::string &body);
+    // functionName：定义行中的函数名（"@name" 中的 name）
+    static std::string_view functionName(std::string_view defLine);
+
+    // 解析完整的 LLVM IR 文本为 Module（jobs > 1 时各函数并行解析，函数顺序与输入一致）
+    std::unique_ptr<ir::Module> parseModule(std::string_view irText, unsigned jobs = 1) const;
+
+    // 解析单个函数（若 funcName 为空则取第一个函数）；只解析被选中的函数
+    std::unique_ptr<ir::Function> parseFunction(std::string_view irText,
+                                                std::string_view funcName = {}) const;
+
+    // 解析 indexFunctions 定位到的单个函数
+    std::unique_ptr<ir::Function> parseFunction(const FunctionText &text) const;
 
-    // 解析单行 LLVM IR 指令为结构化 Instruction
-    ir::Instruction parseInstruction(const std::string &line);
+  private:
+    // 解析单行 LLVM IR 指令为结构化 Instruction（无法识别时返回 ret void 占位）
+    ir::Instruction parseInstruction(std::string_view line) const;
 
     // 解析函数定义行中的参数列表（提取 %N 形式的虚拟寄存器 ID）
-    std::vector<int> parseParameters(const std::string &defLine);
+    std::vector<int> parseParameters(std::string_view defLine) const;
+
+    // 解析操作数文本（如 "%3" → VReg, "42" → Imm, "true" → BoolLit）
+    ir::Operand parseOperand(std::string_view text) const;
+};
 
-    // 解析操作数字符串（如 "%3" → VReg, "42" → Imm, "true" → BoolLit）
-    ir::Operand parseOperand(const std::string &text);
+// LazyIRModule：按需加载的 IR 模块
+// 构造时只用 indexFunctions 扫描一次 define 边界，函数体在首次访问时才解析；
+// 只需要个别函数（如 --function）时其余函数不会被解析，流水线代码生成时可以用 take
+// 逐个取出函数、编译后立即释放，内存占用与单个函数而非整个模块成正比。
+// 不同下标的函数互不共享状态，可以在多个线程上同时加载；irText 必须比本对象活得更久
+class LazyIRModule {
+  public:
+    explicit LazyIRModule(std::string_view irText);
+
+    // size / name：函数索引（与输入中的 define 顺序一致）
+    size_t size() const { return texts_.size(); }
+    std::string_view name(size_t i) const { return IRParser::functionName(texts_[i].defLine); }
+
+    // find：按名字查找函数下标，不存在时返回 -1
+    int find(std::string_view name) const;
+
+    // isLoaded：第 i 个函数是否已解析并缓存
+    bool isLoaded(size_t i) const { return loaded_[i] != nullptr; }
+
+    // function：第 i 个函数（首次访问时解析并缓存，之后直接返回）
+    ir::Function &function(size_t i);
+
+    // take：取出第 i 个函数的所有权（未解析时现场解析），本对象不再缓存它
+    std::unique_ptr<ir::Function> take(size_t i);
+
+  private:
+    IRParser parser_;
+    std::vector<IRParser::FunctionText> texts_;          // 各函数的定义行与函数体区间
+    std::vector<std::unique_ptr<ir::Function>> loaded_; // 已解析的函数（未解析为空）
 };
 
 } // namespace toyc
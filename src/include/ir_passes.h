@@ -0,0 +1,111 @@
+#pragma once
+#include "ir.h"
+
+namespace toyc {
+
+class CallGraph;
+
+namespace opt {
+
+// ======================== IR 优化流水线 ========================
+//
+// 在 IRBuilder / IRParser 产出的 ir::Function 上就地进行的变换。
+// -O0 不做任何变换（输出与未引入优化流水线时逐字节一致）；-O1 起执行 mem2reg、自递归消除、SCCP、GVN、循环优化、DCE、CFG 化简与函数内联，
+// 此后 IR 中可能出现 phi，代码生成前由 LinearScanAllocator 调用 eliminatePhis 消除
+
+// promoteMemoryToRegisters：mem2reg —— 把只被 load / store 直接访问的 alloca 提升为 SSA 值
+// 步骤：截断终结指令之后的死代码 → 删除不可达块 → 在定义块的迭代支配边界放置 phi →
+//   沿支配树重命名（load 替换为当前到达值，store 删除）→ 删除无用 / 平凡 phi。
+// 存入 i1 槽的非布尔值先规范化为 icmp ne v, 0（-O0 下按字节截断的行为在此修正）。
+// 返回被提升的 alloca 个数
+int promoteMemoryToRegisters(ir::Function &F);
+
+// removeUnreachableBlocks：删除从入口不可达的块并按原顺序重新编号，返回是否删除了块。
+// 调用后 CFG 已重建；不修改 phi（引用已删除前驱的入口由调用方用 prunePhiIncomings 处理）
+bool removeUnreachableBlocks(ir::Function &F);
+
+// prunePhiIncomings：按当前 CFG 删除 phi 中来自非前驱块的入口，只剩一个入口的 phi 用该值替代
+void prunePhiIncomings(ir::Function &F);
+
+// eliminateTailRecursion：自递归消除 —— 以 "return F(args);" 或 "return x op F(args);"（op 为 add / mul）
+// 结尾的自递归改写为循环：入口拆出循环头，形参在循环头由 phi 合并（实参成为回边的入口），
+// 累加器形式另设 phi %acc（初值为 op 的单位元），其余 ret v 改为 ret %acc op v。
+// 调用与 ret 之间隔着返回块的 phi 时，先把返回块复制进调用所在的前驱。返回消除的递归调用数
+int eliminateTailRecursion(ir::Function &F);
+
+// markTailCalls：尾调用标记 —— 紧跟返回其结果的 ret（或 ret void）的 call 置 tail，其余清除。
+// 代码生成据此撤销栈帧后直接跳转到被调函数。返回被标记的调用数
+int markTailCalls(ir::Function &F);
+
+// propagateConstants：稀疏条件常量传播（SCCP）—— 在 SSA 值的格（未知 / 常量 / 非常量）与
+// CFG 边的可执行性上同时求不动点：phi 只合并可执行入边上的值，常量条件的 br i1 只打通一侧。
+// 随后把常量值的 use 替换为立即数、删除被折叠的 add/sub/mul/sdiv/srem/icmp/copy/phi，
+// 常量条件分支改写为 br，删除不可达块并修剪 phi 的失效入口。
+// 除数为 0（以及 INT_MIN / -1）的 sdiv / srem 不折叠，保留运行时行为。返回折叠的指令与分支数
+int propagateConstants(ir::Function &F);
+
+// eliminateCommonSubexpressions：基于支配树的全局值编号（GVN）—— 沿支配树先序遍历，
+// 以作用域哈希表记录可用的纯表达式（add/sub/mul/sdiv/srem/icmp，交换律与 sgt/sge 规范化），
+// 被支配的重复计算删除并改用先前的结果。alloca 上的 load 以 [槽, store 版本, 合流纪元] 编号：
+// 中间没有 store 且不经过合流点的重复 load 被删除，i32 store 的值直接转发给之后的 load。
+// 返回删除的指令数
+int eliminateCommonSubexpressions(ir::Function &F);
+
+// optimizeLoops：循环不变量外提（LICM）与归纳变量强度削减 —— 基于循环森林，先为缺少前置块的
+// 循环在头结点之前插入 <header>_ph 块；自内向外处理每个循环：操作数都在循环外定义的纯运算
+// （add/sub/mul/sdiv/srem/icmp）移到前置块末尾，基本归纳变量 %i（phi [init, 前置块], [%i ± c, 回边块]）
+// 与循环不变量 k 的乘积 %i * k 改为新的 phi 递推 %j（每次迭代加 c*k）。返回外提与削减的指令数
+int optimizeLoops(ir::Function &F);
+
+// eliminateDeadCode：死存储与死代码删除 —— 从未被 load 的槽的 store、块内被同一槽的下一次 store
+// 覆盖的 store 删除；随后从 store / call / 终结指令出发沿操作数标记活跃，其余指令（含无用的
+// phi 环与 alloca）删除。返回删除的指令数
+int eliminateDeadCode(ir::Function &F);
+
+// simplifyCFG：CFG 化简 —— 删除不可达块，迭代到不动点：两个目标相同的 br i1 改为 br，
+// 只含 "phi i1 + br i1" 的块（&& / || 的汇合点）被前驱直接跳过、常量入口直达目标、icmp 入口改为前驱的 br i1，
+// 只含 br 的空块被前驱直接跳过（目标块 phi 的入口随之改写），唯一前驱以 br 跳来的块并入前驱。
+// 返回删除的块数
+int simplifyCFG(ir::Function &F);
+
+// hasPhis：函数中是否还有 phi 指令
+bool hasPhis(const ir::Function &F);
+
+// eliminatePhis：phi 消除 —— 每个 phi 引入新的临时寄存器 %t，
+// 各前驱在终结指令之前插入 %t = copy v，phi 本身替换为 %d = copy %t。
+// 临时寄存器只在 phi 所在块入口被读取，因此关键边与 "交换" 型 phi 组都无需拆边。
+// 前驱以 icmp + br i1 结尾时拷贝插在 icmp 之前，保持比较与分支相邻（分支融合仍然生效）
+void eliminatePhis(ir::Function &F);
+
+// propagateCopies：拷贝传播 —— 只有一处定义的 %d = copy v，在 v 的任何定义之后 %d 都不再活跃时，
+// 把 %d 的全部 use 替换为 v 并删除拷贝（v 为常量时无条件）。分配器在 phi 消除后调用，
+// 去掉块首的 %d = copy %t（循环头的 phi 通常满足条件，%t 与 %d 成为同一个值）。
+// 会重新执行活跃性分析（CFG 与 rpoOrder 随之重建）；返回删除的拷贝条数
+int propagateCopies(ir::Function &F);
+
+// kDefaultInlineLimit：-finline-limit 的默认值（内联后净增指令数的阈值）
+constexpr int kDefaultInlineLimit = 40;
+
+// inlineCalls：函数内联 —— 把 F 中对模块内非递归函数（不与 F 在同一个强连通分量中）的调用点
+// 替换为被调函数体：调用处拆块，被调函数的块复制到其后（vreg 平移、形参替换为实参），
+// ret 改为跳回拆出的后半块，返回值直接替换或用 phi 合并。代价为被调函数指令数减去调用开销，
+// 阈值 limit 按调用点的循环深度翻倍（最多 4 倍）；limit <= 0 时不内联。返回内联的调用点数
+int inlineCalls(ir::Function &F, const CallGraph &CG, int limit);
+
+// vectorizeLoops：循环向量化（--march=rv32imv，在 optimizeModule 之后对整个模块执行一次）——
+// 头结点只有 phi 与 i < n 比较、循环体是一个只含 add/sub/mul/sdiv/srem 的直线块、phi 都是归纳变量
+// 或唯一的加法归约（迭代之间没有其它依赖）的最内层循环，整个迭代空间交给新生成的内核函数
+// @__vec_<函数名>_<序号>(cnt, 循环不变量...)：它返回各次迭代对归约值的贡献之和，带有
+// VectorKernel 描述，代码生成为按 vsetvli 分段（strip-mining）的 RVV 循环。前置块在循环的入口条件
+// 成立时调用内核、把各 phi 前进 cnt 步，原循环保留为标量回退。返回向量化的循环数
+int vectorizeLoops(ir::Module &mod);
+
+// optimizeFunction：按优化级别对单个函数执行流水线（level <= 0 时不做任何事）
+void optimizeFunction(ir::Function &F, int level);
+
+// optimizeModule：按调用图的强连通分量自底向上处理每个函数：先执行 optimizeFunction，
+// 再把已经优化完的被调函数内联进来（inlineLimit > 0 时），有内联时再执行一遍 optimizeFunction
+void optimizeModule(ir::Module &mod, int level, int inlineLimit = kDefaultInlineLimit);
+
+} // namespace opt
+} // namespace toyc
@@ -1,19 +1,23 @@
 #pragma once
 #include "token.h"
 
-// 词法分析器类：负责将源代码字符串拆分成 Token 流
+// 词法分析器类：负责将源代码拆分成 Token 流
+// 只保存源码的 string_view，不复制；Token 的 lexeme 是源码的切片。
+// 字符分类使用 256 项查找表，空白 / 标识符 / 数字的连续段按 16 字节块（SSE2 / NEON）扫描，
+// 关键字通过完美哈希一次比较识别；不支持 SIMD 的平台退化为逐字节查表，结果完全相同
 class Lexer {
   public:
-    // 构造函数：传入整个源代码文本
-    explicit Lexer(const std::string &source);
+    // 构造函数：传入源代码文本（调用方保证其生命周期覆盖全部 Token 的使用）
+    // firstLine：source 第一行的行号（从文件中间切出的片段按原文件行号报告）
+    explicit Lexer(std::string_view source, int firstLine = 1);
 
     // 返回下一个 Token
     Token nextToken();
 
   private:
-    std::string src; // 源代码文本
-    size_t pos = 0;  // 当前扫描位置
-    int line = 1;    // 当前行号，从 1 开始
+    std::string_view src; // 源代码文本（不拥有）
+    size_t pos = 0;       // 当前扫描位置
+    int line = 1;         // 当前行号，从 1 开始
 
     // 查看当前字符但不消费
     char peek() const;
@@ -24,6 +28,12 @@ class Lexer {
     // 跳过空白字符（空格、制表符、换行）
     void skipWhitespace();
 
+    // 跳过 "//" 单行注释（当前位置为第一个 '/'）
+    void skipLineComment();
+
+    // 跳过 "/* */" 多行注释（当前位置为 '/'）
+    void skipBlockComment();
+
     // 生成一个指定类型的 Token
     Token makeToken(TokenType type);
 
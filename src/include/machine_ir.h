@@ -0,0 +1,275 @@
+#pragma once
+#include "asm_emitter.h"
+#include "ir.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace toyc {
+namespace mir {
+
+// ======================== 机器指令操作码 ========================
+
+// MOpcode 枚举：代码生成使用的 RV32IM 指令（含汇编器伪指令与栈帧伪指令）
+enum class MOpcode : uint8_t {
+    // 立即数 / 寄存器传送
+    LI, // li   rd, imm
+    MV, // mv   rd, rs1
+
+    // 算术 / 逻辑（寄存器-寄存器）
+    ADD,
+    SUB,
+    MUL,
+    MULH, // 有符号乘积的高 32 位
+    DIV,
+    REM,
+    SLT,
+
+    // 算术 / 逻辑（寄存器-立即数）
+    ADDI,
+    XORI,
+    ANDI,
+    SLLI, // 移位量为 imm（0-31）
+    SRLI,
+    SRAI,
+
+    // 单操作数比较伪指令
+    SEQZ, // seqz rd, rs1
+    SNEZ, // snez rd, rs1
+
+    // 访存：LW/LB 为 rd, imm(rs1)；SW/SB 为 rs2, imm(rs1)
+    LW,
+    LB,
+    SW,
+    SB,
+
+    // 条件分支：rs1, rs2, target
+    BEQ,
+    BNE,
+    BLT,
+    BGE,
+    BGT,
+    BLE,
+    BNEZ, // bnez rs1, target
+
+    // 跳转 / 调用 / 返回
+    J,    // j    target
+    CALL, // call sym
+    TAIL, // tail sym（尾调用：栈帧已撤销，跳转后由被调函数直接返回到调用者的调用者）
+    RET,  // ret
+
+    // RVV 向量指令（--march=rv32imv 的向量内核，SEW = 32，不带掩码）：vd / vs2 / vs1 依次放在
+    // rd / rs1 / rs2，标量操作数（x 寄存器）同样放在这些字段，由操作码决定寄存器属于哪个寄存器堆
+    VSETVLI,    // vsetvli rd, rs1, vtype（imm 为 vtype 编码，见 vtypeE32M1）
+    VADD_VV,    // vadd.vv vd, vs2, vs1
+    VSUB_VV,    // vsub.vv vd, vs2, vs1（vs2 - vs1）
+    VMUL_VV,    // vmul.vv vd, vs2, vs1
+    VDIV_VV,    // vdiv.vv vd, vs2, vs1（vs2 / vs1）
+    VREM_VV,    // vrem.vv vd, vs2, vs1
+    VADD_VX,    // vadd.vx vd, vs2, rs（rs2 为 x 寄存器）
+    VMV_V_X,    // vmv.v.x vd, rs（rs1 为 x 寄存器，广播到各元素）
+    VID_V,      // vid.v vd（各元素为自己的下标）
+    VREDSUM_VS, // vredsum.vs vd, vs2, vs1（vd[0] = vs1[0] + vs2 各元素之和）
+    VMV_S_X,    // vmv.s.x vd, rs（rs1 为 x 寄存器，写入元素 0）
+    VMV_X_S,    // vmv.x.s rd, vs2（rd 为 x 寄存器，读取元素 0）
+
+    // 栈帧伪指令：栈帧大小确定后由 expandFramePseudos 展开为真实指令
+    FrameSetup,   // prologue
+    FrameDestroy, // epilogue
+
+    // 剖析插桩伪指令（--profile-generate）：sym 为本函数计数器数组的标签，imm 为计数器的字节偏移；
+    // 输出为 lui t0 / lw t1 / addi t1 / sw t1 四条指令，只用保留的临时寄存器 t0 / t1
+    ProfCount,
+};
+
+// mopcodeName：返回操作码的汇编助记符（伪指令返回空串）
+const char *mopcodeName(MOpcode op);
+
+// vtypeE32M1：vsetvli 的 vtype 编码（SEW = 32、LMUL = 1、非活跃元素 agnostic）；
+// tailAgnostic 为假时（tu）vl 之外的尾部元素保持原值
+constexpr int vtypeE32M1(bool tailAgnostic) { return 0x80 | (tailAgnostic ? 0x40 : 0) | 0x10; }
+
+// ======================== 机器指令 ========================
+
+// MachineInstr：一条 RISC-V 机器指令，寄存器为物理寄存器编号（x0-x31，向量指令的向量操作数为
+// v0-v31），-1 表示不使用
+struct MachineInstr {
+    MOpcode opcode = MOpcode::RET;
+    int8_t rd = -1;      // 目标寄存器
+    int8_t rs1 = -1;     // 源寄存器 1（访存指令中为基址寄存器）
+    int8_t rs2 = -1;     // 源寄存器 2（store 指令中为被存储的值）
+    int32_t imm = 0;     // 立即数 / 访存偏移
+    int32_t target = -1; // 分支/跳转目标：所属 MachineFunction 中的块下标
+    ir::Symbol sym;      // call / tail 目标函数名
+
+    // -------- 工厂方法 --------
+    static MachineInstr li(int rd, int imm);
+    static MachineInstr mv(int rd, int rs);
+    static MachineInstr rrr(MOpcode op, int rd, int rs1, int rs2); // add/sub/mul/mulh/div/rem/slt
+    static MachineInstr rri(MOpcode op, int rd, int rs1, int imm); // addi/xori/andi/移位
+    static MachineInstr rr(MOpcode op, int rd, int rs1);           // seqz/snez
+    static MachineInstr load(MOpcode op, int rd, int base, int offset);
+    static MachineInstr store(MOpcode op, int rs, int base, int offset);
+    static MachineInstr branch(MOpcode op, int rs1, int rs2, int target);
+    static MachineInstr bnez(int rs, int target);
+    static MachineInstr jump(int target);
+    static MachineInstr call(ir::Symbol callee);
+    static MachineInstr tail(ir::Symbol callee);
+    static MachineInstr ret();
+    static MachineInstr pseudo(MOpcode op); // FrameSetup / FrameDestroy
+    static MachineInstr profCount(ir::Symbol counters, int index); // 计数器 counters[index] 加一
+    static MachineInstr vsetvli(int rd, int avl, int vtype); // 其余向量指令用 rrr / rr 构造
+
+    bool isBranch() const; // 条件分支（含 bnez）
+    bool isVector() const; // RVV 向量指令
+    // definesVectorReg：rd 是向量寄存器（vsetvli / vmv.x.s 写的是 x 寄存器）
+    bool definesVectorReg() const {
+        return isVector() && opcode != MOpcode::VSETVLI && opcode != MOpcode::VMV_X_S;
+    }
+    bool isFramePseudo() const {
+        return opcode == MOpcode::FrameSetup || opcode == MOpcode::FrameDestroy;
+    }
+};
+
+// ======================== 机器基本块 / 函数 ========================
+
+// MachineBasicBlock：机器基本块，与 IR 基本块一一对应（下标相同）
+struct MachineBasicBlock {
+    std::string label;               // 汇编标签（入口块不输出标签行）
+    std::vector<MachineInstr> insts; // 指令序列
+};
+
+// MachineFunction：一个函数的机器代码及栈帧信息
+struct MachineFunction {
+    std::string name;                      // 函数名
+    std::vector<MachineBasicBlock> blocks; // 机器基本块（blocks[0] 为入口）
+    int frameSize = 0;                     // 栈帧总大小（16 字节对齐）
+    std::vector<int> calleeSavedRegs;      // 需在 prologue/epilogue 保存的被调用者保存寄存器
+    bool framePointer = true;              // s0 是否作为帧指针（-fomit-frame-pointer 时为假）
+    bool savesReturnAddress = true;        // prologue 是否保存 ra（叶函数为假）
+    bool usesVector = false;               // 含 RVV 指令（向量内核；汇编输出临时启用 v 扩展）
+
+    // --profile-generate：计数器编号 → IR 块名（为空表示未插桩）；打印时随函数输出剖析记录
+    std::vector<std::string> profileBlocks;
+    // --profile-use：各块的执行计数（与 blocks 同下标，-1 表示未知；为空表示没有剖析数据），
+    // 只供块布局使用，布局后随块一起重排
+    std::vector<int64_t> blockCounts;
+};
+
+// profileCounterLabel：函数计数器数组的局部标签（.Lprof_<函数名>）
+std::string profileCounterLabel(std::string_view function);
+
+// expandFramePseudos：按 frameSize / calleeSavedRegs 把 FrameSetup/FrameDestroy 展开为真实指令
+// prologue: addi sp → sw ra/s0 → addi s0 → sw callee-saved
+// epilogue: lw callee-saved → lw ra/s0 → addi sp
+// 省略帧指针时不保存 / 设置 s0（分配器用到 s0 时它与其余被调用者保存寄存器一起保存），叶函数不保存 ra，
+// frameSize 为 0 时两者都展开为空
+void expandFramePseudos(MachineFunction &MF);
+
+// shrinkWrap：收缩包装（shrink_wrap.cpp），在 expandFramePseudos 之前执行。FrameSetup 从入口移到
+// 支配全部栈帧使用（sp / s0 / 被调用者保存寄存器 / call）且不在环上的块，不经过它的返回路径删除
+// FrameDestroy；早返回因此不再建立与撤销栈帧。返回是否移动了伪指令
+bool shrinkWrap(MachineFunction &MF);
+
+// ======================== 机器级优化 ========================
+
+// runPeephole：栈帧展开之后的块布局与窥孔优化（peephole.cpp），返回删除的指令条数
+// 块按静态分支预测重排（入口保持在首位，留在循环内的后继优先，循环中途 return / break 的冷路径
+// 移到末尾，循环旋转为条件在底部，不可达块删除；有 blockCounts 时冷块与后继偏好改由实测计数决定），跳向下一块的 j 删除、
+// "bcc next; j Y" 反转为 "b!cc Y"，块内按规则表消除冗余的 sw / lw 与拷贝
+int runPeephole(MachineFunction &MF);
+
+// ======================== 指令调度 ========================
+
+// LatencyModel：单发射顺序流水线的延迟模型，各项为结果从发射到可被后续指令读取的周期数
+// （1 表示紧随其后的指令即可使用，不停顿）。预置模型按名字选择（-mtune），各项可单独覆盖
+struct LatencyModel {
+    std::string name = "generic"; // 预置模型名
+    int alu = 1;                  // li / mv / 算术逻辑 / 比较
+    int load = 2;                 // lw / lb
+    int mul = 3;                  // mul / mulh
+    int div = 33;                 // div / rem
+
+    // latency：指令结果的延迟（访存 / 乘除以外的指令为 alu）
+    int latency(const MachineInstr &MI) const;
+    // toString：完整描述（"generic,alu=1,load=2,mul=3,div=33"），可被 parseLatencyModel 读回
+    std::string toString() const;
+};
+
+// parseLatencyModel：解析 "<预置模型>[,alu=N][,load=N][,mul=N][,div=N]"（N 为 1-64），
+// 模型名未知或字段格式错误时返回 std::nullopt
+std::optional<LatencyModel> parseLatencyModel(std::string_view spec);
+
+// latencyModelNames：预置模型名（以 ", " 分隔，供帮助信息使用）
+std::string latencyModelNames();
+
+// scheduleBlocks：逐块列表调度（scheduler.cpp），在寄存器分配、栈帧展开与窥孔优化之后执行，
+// 把 load / mul / div 与其使用者拉开；返回按模型估计消除的停顿周期数
+int scheduleBlocks(MachineFunction &MF, const LatencyModel &model);
+
+// ======================== RV32C 压缩指令 ========================
+
+// CForm：指令可用的 16 位压缩形式（--march=rv32imc）。条件分支与 j 能否压缩取决于跳转距离，
+// 不在此列：ELFObjectWriter 在布局时决定，汇编输出交给汇编器（.option rvc）
+enum class CForm : uint8_t {
+    None,
+    Li,       // c.li rd, imm6
+    Mv,       // c.mv rd, rs2
+    Add,      // c.add rd, rs2（rd 与一个源操作数相同）
+    Sub,      // c.sub rd', rs2'
+    Addi,     // c.addi rd, nzimm6
+    Addi16sp, // c.addi16sp sp, nzimm（16 的倍数）
+    Addi4spn, // c.addi4spn rd', sp, nzuimm（4 的倍数）
+    Andi,     // c.andi rd', imm6
+    Slli,     // c.slli rd, shamt
+    Srli,     // c.srli rd', shamt
+    Srai,     // c.srai rd', shamt
+    Lw,       // c.lw rd', uimm(rs1')
+    Sw,       // c.sw rs2', uimm(rs1')
+    Lwsp,     // c.lwsp rd, uimm(sp)
+    Swsp,     // c.swsp rs2, uimm(sp)
+    Jr,       // c.jr ra（ret）
+};
+
+// isCompressibleReg：x8-x15（压缩指令 3 位寄存器字段 rd' / rs1' / rs2' 可以编码的寄存器）
+inline bool isCompressibleReg(int reg) { return reg >= 8 && reg <= 15; }
+
+// compressedForm：MI 的压缩形式（寄存器与立即数都满足编码约束时），否则为 CForm::None
+CForm compressedForm(const MachineInstr &MI);
+
+// ======================== 汇编打印 ========================
+
+// AsmPrinter：将 MachineFunction 一趟格式化为 GNU 汇编文本，写入 AsmEmitter
+// 整数与寄存器名直接追加到复用的行缓冲区，不产生临时字符串
+class AsmPrinter {
+  public:
+    // compressed：可压缩的指令输出为 c.* 形式（--march=rv32imc）
+    explicit AsmPrinter(AsmEmitter &out, bool compressed = false)
+        : out_(out), compressed_(compressed) {}
+
+    // printFunction：输出 .globl、函数标签、所有基本块与 .size（插桩函数随后输出 toyc_prof 剖析记录）
+    void printFunction(const MachineFunction &MF);
+
+  private:
+    AsmEmitter &out_;
+    bool compressed_;
+    std::string line_; // 行缓冲区（跨指令复用容量）
+
+    void printInst(const MachineFunction &MF, const MachineInstr &MI);
+    void printCompressed(const MachineInstr &MI, CForm form);
+    void printProfCount(const MachineInstr &MI);
+    void printProfileRecord(const MachineFunction &MF);
+    void appendReg(int reg);
+    void appendVReg(int reg);
+    void appendImm(int value);
+};
+
+// regName：物理寄存器编号 → ABI 名称（如 10 → "a0"）
+const char *regName(int reg);
+// vectorRegName：向量寄存器编号 → 名称（如 2 → "v2"）
+const char *vectorRegName(int reg);
+
+} // namespace mir
+} // namespace toyc
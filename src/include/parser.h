@@ -1,19 +1,52 @@
 #pragma once
 #include "ast.h"
 #include "lexer.h"
+#include <stdexcept>
+#include <vector>
+
+// ParseError：语法错误（what() 为不含换行的错误描述，如 "Unexpected token ';' at line 3"）
+struct ParseError : std::runtime_error {
+    explicit ParseError(const std::string &message, int line = 0)
+        : std::runtime_error(message), line(line) {}
+    int line; // 出错 Token 所在行（未知为 0）
+};
+
+// SourceFunction：源码中一个顶层函数定义的位置（到下一个函数定义之前为止）
+struct SourceFunction {
+    std::string_view text; // 函数定义的源码片段（引用原缓冲区）
+    std::string_view name; // 函数名（定义格式错误时可能为空，由解析报告错误）
+    int line;              // 片段第一行的行号
+};
 
-// Parser 类：将 Token 流解析为 AST
+// Parser 类：将 Token 流解析为 AST（语法错误时抛出 ParseError）
+// 节点分配在结果 CompUnit 的 arena 中；语句/实参列表先压入共享的 listStack，
+// 列表结束时整体复制进 arena，不为每个节点维护 vector
 class Parser {
   public:
-    // 构造函数：初始化 Lexer 并预读两个 Token
-    explicit Parser(const std::string &source);
+    // 构造函数：初始化 Lexer 并预读两个 Token（source 须在解析期间保持有效）
+    // firstLine：source 第一行在原文件中的行号（解析 indexFunctions 切出的单个函数时使用）
+    explicit Parser(std::string_view source, int firstLine = 1);
 
     // 解析编译单元 CompUnit → FuncDef+
-    std::vector<std::shared_ptr<FuncDef>> parseCompUnit();
+    CompUnit parseCompUnit();
+
+    // indexFunctions：只做词法扫描，按括号深度找出顶层函数定义的边界（不建立 AST）
+    // 与 parseCompUnit 一致，遇到第一个不以 int / void 开头的顶层 Token 即停止
+    static std::vector<SourceFunction> indexFunctions(std::string_view source);
 
   private:
-    Lexer lex;      // 词法分析器实例
-    Token cur, nxt; // 当前和下一个 Token，用于预读实现
+    Lexer lex;                     // 词法分析器实例
+    Token cur, nxt;                // 当前和下一个 Token，用于预读实现
+    ASTArena *arena = nullptr;     // 当前 CompUnit 的节点内存池
+    std::vector<ASTPtr> listStack; // 正在收集的列表元素（嵌套列表按栈顺序追加）
+
+    // takeList：把 listStack 中 mark 之后的元素复制进 arena 并弹出
+    std::span<ASTPtr> takeList(size_t mark);
+
+    // name：把当前 Token 的文本复制进 arena
+    std::string_view name() const { return arena->copyString(cur.lexeme); }
+    // ident：驻留当前标识符 Token（同名标识符共享文本与编号）
+    Ident ident() const { return arena->intern(cur.lexeme); }
 
     // advance：将 nxt 赋值给 cur，然后读取下一个 Token 到 nxt
     void advance();
@@ -21,17 +54,20 @@ class Parser {
     // match：如果 cur.type 与 expected 相符，则 advance 并返回 true
     bool match(TokenType expected);
 
-    // expect：断言当前 Token 类型为 expected，否则报告错误并退出
+    // expect：断言当前 Token 类型为 expected，否则抛出 ParseError
     void expect(TokenType expected);
 
+    // fail：抛出 ParseError（行号取当前 Token）
+    [[noreturn]] void fail(const std::string &message);
+
     // 解析函数定义 FuncDef → ("int" ∣ "void") ID "(" (Param ("," Param)∗)? ")" Block
-    std::shared_ptr<FuncDef> parseFuncDef();
+    FuncDef *parseFuncDef();
 
     // 解析形参列表 Param → "int" ID ("," "int" ID)*
-    std::vector<Param> parseParams();
+    std::span<Param> parseParams();
 
     // 解析语句块 Block → "{" Stmt∗ "}"
-    std::shared_ptr<BlockStmt> parseBlock();
+    BlockStmt *parseBlock();
 
     // 解析单条语句 Stmt → 声明|赋值|if|while|return|break|continue|表达式
     ASTPtr parseStmt();
@@ -0,0 +1,41 @@
+#pragma once
+#include "ir.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace toyc {
+
+// ======================== 剖析数据 ========================
+//
+// ProfileData：--profile-use 读入的块执行计数（函数名 → 块名 → 次数）
+// 数据来自 --profile-generate 插桩程序退出时写出的 toyc.profraw：
+// 若干条首尾相接的记录，每条是一个插桩函数的 计数器个数 | 名字表字节数 | 名字表 | 计数器
+// （格式见 AsmPrinter::printProfileRecord）。同一函数出现多次时计数相加，
+// 因此多次运行的 .profraw 直接拼接（cat a.profraw b.profraw）即是合并后的剖析数据。
+// 按块名而不是块下标对应，插桩构建与使用剖析的构建之间函数有所改动时，仍能对上的块照常使用
+class ProfileData {
+  public:
+    // parse：解析 .profraw 的内容，格式错误时抛出 std::runtime_error
+    static ProfileData parse(std::string_view raw);
+
+    // load：读取并解析 .profraw 文件，无法读取或格式错误时抛出 std::runtime_error
+    static ProfileData load(const std::string &path);
+
+    bool empty() const { return functions_.empty(); }
+    size_t numFunctions() const { return functions_.size(); }
+
+    // count：块的执行次数（函数或块不在剖析数据中时返回 -1）
+    int64_t count(std::string_view function, std::string_view block) const;
+
+    // annotate：把计数写入同名函数中同名块的 profileCount（对不上的块保持原值），
+    // 返回函数是否在剖析数据中
+    bool annotate(ir::Function &F) const;
+    void annotate(ir::Module &M) const;
+
+  private:
+    std::unordered_map<std::string, std::unordered_map<std::string, int64_t>> functions_;
+};
+
+} // namespace toyc
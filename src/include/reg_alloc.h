@@ -1,10 +1,13 @@
 #pragma once
 #include "ir.h"
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -27,19 +30,24 @@ struct LiveRange {
 };
 
 // LiveInterval：虚拟寄存器的活跃区间，由多个 LiveRange 合并而成
+// ranges 的存储来自所属 LiveIntervalTable 的函数级内存池
 class LiveInterval {
   public:
-    int vreg = -1;                 // 对应的虚拟寄存器 ID
-    std::vector<LiveRange> ranges; // 排序后的活跃范围列表
-    int spillSlot = -1;            // 溢出栈槽偏移，-1 表示未溢出
-    int physReg = -1;              // 分配到的物理寄存器 ID，-1 表示未分配
+    int vreg = -1;                       // 对应的虚拟寄存器 ID
+    std::pmr::vector<LiveRange> ranges;  // 排序后的活跃范围列表（互不重叠且不相邻）
+    int spillSlot = -1;                  // 溢出栈槽偏移，-1 表示未溢出
+    int physReg = -1;                    // 分配到的物理寄存器 ID，-1 表示未分配
+    uint64_t weight = 0;                 // 溢出权重：每次 def / use 计所在块的执行频率（blockFrequency）
+    bool crossesCall = false;            // 是否跨越调用（调用之后仍活跃，优先分配能跨越调用的寄存器）
+    uint32_t callClobbers = 0;           // 跨越的调用会破坏的寄存器（RegMask，ABI 下为全部调用者保存寄存器）
 
     LiveInterval() = default;
-    explicit LiveInterval(int v) : vreg(v) {}
+    explicit LiveInterval(int v, std::pmr::memory_resource *mr = std::pmr::get_default_resource())
+        : vreg(v), ranges(mr) {}
 
-    // 添加活跃范围并自动合并重叠/相邻区间
+    // 添加活跃范围并就地合并重叠/相邻区间（二分定位，追加到末尾为 O(1)）
     void addRange(int start, int end);
-    // 检查指定位置是否在活跃区间内
+    // 检查指定位置是否在活跃区间内（二分查找）
     bool contains(int pos) const;
     // 返回最早的活跃起始位置
     int start() const;
@@ -50,8 +58,43 @@ class LiveInterval {
     bool operator<(const LiveInterval &o) const { return start() < o.start(); }
 };
 
+// LiveIntervalTable：以 vreg 为下标的稠密活跃区间表
+// 区间对象及其 ranges 均分配在函数级单调内存池中，随表一起整体释放，
+// 内存与耗时只与活跃范围的数量相关，而与 addRange 的调用次数无关
+class LiveIntervalTable {
+  public:
+    explicit LiveIntervalTable(int numVregs = 0);
+    ~LiveIntervalTable();
+    LiveIntervalTable(LiveIntervalTable &&) = default;
+    LiveIntervalTable(const LiveIntervalTable &) = delete;
+    LiveIntervalTable &operator=(const LiveIntervalTable &) = delete;
+
+    // 取出 vreg 对应的区间，不存在时在内存池中创建
+    LiveInterval &getOrCreate(int vreg);
+    // 取出 vreg 对应的区间，不存在时返回 nullptr
+    LiveInterval *get(int vreg) const {
+        return vreg >= 0 && static_cast<size_t>(vreg) < byVreg_.size() ? byVreg_[vreg] : nullptr;
+    }
+    size_t numVregs() const { return byVreg_.size(); }
+
+    // forEach：按 vreg 升序遍历所有非空区间
+    template <typename Fn> void forEach(Fn &&fn) const {
+        for (LiveInterval *iv : byVreg_)
+            if (iv && !iv->empty())
+                fn(*iv);
+    }
+
+  private:
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena_; // 函数级内存池（上游：线程内存池）
+    std::vector<LiveInterval *> byVreg_;                         // vreg → 区间（未出现为空）
+};
+
 // ======================== 物理寄存器 ========================
 
+// RegMask：物理寄存器位集，第 i 位对应 xi
+using RegMask = uint32_t;
+constexpr RegMask regBit(int reg) { return RegMask{1} << reg; }
+
 // PhysReg：物理寄存器描述
 struct PhysReg {
     int id = 0;               // 寄存器编号（x0-x31）
@@ -74,37 +117,75 @@ struct PhysRegComparator {
 };
 
 // RegInfo：目标架构（RV32I）物理寄存器信息
-// 描述 x0-x31 共 32 个寄存器的属性及可分配集合
+// 描述 x0-x31 共 32 个寄存器的属性及可分配集合，以及 V 扩展的 v0-v31
 class RegInfo {
   public:
     std::vector<PhysReg> physRegs;                    // 32 个物理寄存器描述
     std::set<int, PhysRegComparator> allocatableRegs; // 可参与分配的寄存器集合
+    std::vector<PhysReg> vectorRegs;                  // RVV 向量寄存器 v0-v31 描述
+    std::vector<int> allocatableVectorRegs;           // 向量内核可用的向量寄存器（按优先级）
 
-    // 构造函数：初始化 RV32I 寄存器描述
-    RegInfo();
+    // 构造函数：初始化 RV32I 寄存器描述；compressed 为真时（RV32IMC）x8-x15 中的寄存器在同类
+    // （调用者保存 / 被调用者保存）中优先分配，使更多指令可以压缩；omitFramePointer 为真时
+    // s0 不作为帧指针，参与分配（被调用者保存）
+    explicit RegInfo(bool compressed = false, bool omitFramePointer = false);
+    // shared：进程级只读实例（首次调用时构造，线程安全），供代码生成器与批量编译共享
+    static const RegInfo &shared(bool compressed = false, bool omitFramePointer = false);
 
     bool isReserved(int id) const;    // 是否为保留寄存器
     bool isCallerSaved(int id) const; // 是否为调用者保存
     bool isCalleeSaved(int id) const; // 是否为被调用者保存
     const PhysReg &getReg(int id) const { return physRegs[id]; }
     std::string getRegName(int id) const; // 获取寄存器名称
+    // hasFramePointer：s0 是否保留为帧指针（局部变量按 s0 寻址）
+    bool hasFramePointer() const { return physRegs[8].reserved; }
+    // callerSavedMask：ABI 规定调用会破坏的全部调用者保存寄存器
+    RegMask callerSavedMask() const { return callerSavedMask_; }
+
+  private:
+    RegMask callerSavedMask_ = 0;
+};
+
+// ======================== 过程间寄存器使用信息 ========================
+
+// RegUsageInfo：过程间寄存器分配（-fipra）中各函数实际会改写的调用者保存寄存器
+// 被调函数先于调用者完成代码生成并发布自己的掩码（函数体内写入的寄存器，加上它调用的函数的掩码），
+// 调用者的分配器只把掩码中的寄存器视为被该调用破坏：跨越调用的值可以留在其余调用者保存寄存器里，
+// 调用点也只保存 / 恢复真正被破坏的寄存器。没有发布掩码的函数（模块外定义的、与调用者处在同一个
+// 递归分量中的）按 ABI 处理。发布与查询可以在不同线程上进行
+class RegUsageInfo {
+  public:
+    explicit RegUsageInfo(const RegInfo &regInfo) : abiMask_(regInfo.callerSavedMask()) {}
+
+    // publish：记录函数的掩码（只保留调用者保存寄存器）
+    void publish(ir::Symbol function, RegMask clobbers);
+    // clobbers：函数可能改写的调用者保存寄存器（未发布时为 ABI 掩码）
+    RegMask clobbers(ir::Symbol function) const;
+    // callClobbers：调用点破坏的寄存器 = 被调函数的掩码 | 本次调用写入的实参寄存器 | 有结果时的 a0
+    RegMask callClobbers(const ir::Instruction &call) const;
+    RegMask abiMask() const { return abiMask_; }
+
+  private:
+    RegMask abiMask_;
+    mutable std::mutex mu_;
+    std::unordered_map<uint32_t, RegMask> masks_; // Symbol 句柄 → 掩码
 };
 
 // ======================== 活跃性分析 ========================
 
 // LivenessAnalysis：基于数据流方程的活跃性分析
-// 计算每个基本块的 useSet/defSet/liveIn/liveOut
+// 计算每个基本块的 useSet/defSet/liveIn/liveOut（稠密位向量，工作表求解）
 class LivenessAnalysis {
   public:
     // 执行完整的活跃性分析流程（构建 CFG → 计算 use/def → 迭代求解）
     void run(ir::Function &F);
-    // 从入口块开始构建逆后序（RPO）遍历序列
-    static std::vector<ir::BasicBlock *> buildRPO(ir::BasicBlock *entry);
+    // 在紧凑 CFG（F.cfg）上从入口块开始构建逆后序（RPO）遍历序列
+    static std::vector<ir::BasicBlock *> buildRPO(const ir::Function &F);
 
   private:
     // 扫描所有指令，计算每个基本块的 useSet（先使用后定义）和 defSet
     void computeUseDefSets(ir::Function &F);
-    // 反向迭代求解 liveIn/liveOut 直到不动点
+    // 工作表驱动求解 liveIn/liveOut 直到不动点（仅重访后继发生变化的块）
     void computeLivenessIteratively(ir::Function &F);
 };
 
@@ -112,23 +193,81 @@ class LivenessAnalysis {
 class LiveIntervalBuilder {
   public:
     /**
-     * @param F         目标函数 IR
-     * @param LA        已完成的活跃性分析
-     * @param splitting 是否使用简化区间模式
+     * @param F          目标函数 IR
+     * @param LA         已完成的活跃性分析
+     * @param simplified 是否使用简化区间模式（仅 def/use 点，用于调试；区间分裂见 LiveRangeSplitter）
      */
-    LiveIntervalBuilder(ir::Function &F, const LivenessAnalysis &LA, bool splitting = false);
-    // 构建所有虚拟寄存器的活跃区间映射
-    std::unordered_map<int, std::unique_ptr<LiveInterval>> build();
+    LiveIntervalBuilder(ir::Function &F, const LivenessAnalysis &LA, bool simplified = false);
+    // 构建所有虚拟寄存器的活跃区间表（alloca 定义的地址 vreg 不参与分配，区间为空）
+    LiveIntervalTable build();
 
   private:
     ir::Function &F_;
     const LivenessAnalysis &LA_;
-    bool splitting_;
+    bool simplified_;
+
+    // 一趟构建所有 vreg 的精确活跃区间（liveOut 播种 + 块内反向扫描）
+    void buildPreciseIntervals(LiveIntervalTable &table);
+    // 一趟构建所有 vreg 的简化区间（仅在 def/use 点各加一个点区间）
+    void buildSimplifiedIntervals(LiveIntervalTable &table);
+};
+
+// ======================== 活跃区间分裂 ========================
+
+// LiveRangeSplitter：把溢出的 vreg 分裂成若干短的新 vreg（分裂片段），供下一轮线性扫描重新分配。
+// 被分裂的 vreg 此后固定在它的溢出栈槽中，片段与它之间用 copy 连接（reload / 写回）：
+//   - 循环片段：一个最外层循环内的全部引用；在进入循环头的边上 reload（入口处活跃时），
+//     循环内有定义时在离开循环的边上写回（出口目标处活跃时）
+//   - 块片段：循环外基本块内、两次调用之间的一段引用；首次引用为 use 时在其前 reload，
+//     最后一次定义之后写回（片段结束后仍活跃时）。调用处结束片段，片段不跨越调用
+// 边上的拷贝：前驱只有一个后继时放在前驱的终结指令前，后继只有一个前驱时放在后继块首，
+// 否则拆分该边（新建只含拷贝与 br 的块，追加到函数末尾）。
+// 依赖刚在该函数上完成的活跃性分析（liveIn / liveOut）与循环森林
+class LiveRangeSplitter {
+  public:
+    // Piece：一个新建的分裂片段
+    struct Piece {
+        int vreg;    // 片段的 vreg
+        int parent;  // 被分裂的 vreg
+        bool isLoop; // 是否为循环片段（再次溢出时还可以分裂为块片段）
+    };
+
+    /**
+     * @param F          目标函数（活跃性分析已完成）
+     * @param candidates 本轮将要分裂的 vreg（一次扫描收集它们出现的基本块）
+     */
+    LiveRangeSplitter(ir::Function &F, const std::vector<int> &candidates);
+
+    // splitAcrossLoops：按最外层循环与循环外的基本块分裂 vreg
+    void splitAcrossLoops(int vreg);
+    // splitIntoBlocks：按基本块（及块内的调用）分裂 vreg
+    void splitIntoBlocks(int vreg);
+    // commit：把边上的拷贝插入函数（所有分裂完成后调用一次），之后需重新做活跃性分析
+    void commit();
 
-    // 为单个 vreg 构建精确的活跃区间（考虑跨基本块的活跃传播）
-    void buildIntervalForVreg(int vreg, std::unique_ptr<LiveInterval> &interval);
-    // 为单个 vreg 构建简化区间（仅在 def/use 点各加一个点区间）
-    void buildSimplifiedIntervalForVreg(int vreg, std::unique_ptr<LiveInterval> &interval);
+    const std::vector<Piece> &pieces() const { return pieces_; }
+
+    // removeCopies：删除片段与其父 vreg 之间的拷贝（片段再次溢出、与父 vreg 共用栈槽时，拷贝是空操作）
+    static void removeCopies(ir::Function &F, const std::unordered_map<int, int> &pieceToParent);
+
+  private:
+    ir::Function &F_;
+    std::unordered_map<int, std::vector<ir::BasicBlock *>> refBlocks_; // vreg → 出现过的块（按块序）
+    std::vector<Piece> pieces_;
+    int numEdgeBlocks_ = 0;
+
+    // 待插入的边拷贝：块尾（终结指令前）/ 块首，按创建顺序插入
+    std::vector<ir::BasicBlock *> endOrder_, startOrder_;
+    std::unordered_map<ir::BasicBlock *, std::vector<ir::Instruction *>> atEnd_, atStart_;
+    std::map<std::pair<int, int>, ir::BasicBlock *> edgeBlocks_; // (from, to) → 拆边新建的块
+
+    int newPiece(int parent, bool isLoop);
+    ir::Instruction *makeCopy(int dst, int src);
+    // splitBlock：把 vreg 在块 bb 内的引用改写为块片段
+    void splitBlock(int vreg, ir::BasicBlock *bb);
+    // insertOnEdge：在边 from → to 上放置拷贝（位置见类注释）
+    void insertOnEdge(ir::BasicBlock *from, ir::BasicBlock *to, ir::Instruction *copy);
+    ir::BasicBlock *splitEdge(ir::BasicBlock *from, ir::BasicBlock *to);
 };
 
 // ======================== 分配结果 ========================
@@ -138,11 +277,137 @@ class AllocationResult {
   public:
     std::unordered_map<int, int> vregToPhys;  // vreg → 物理寄存器 ID（-1 = 已溢出）
     std::unordered_map<int, int> vregToStack; // vreg → 栈字节偏移（仅溢出的 vreg）
+    std::unordered_map<int, int> allocaColors; // alloca vreg → 栈槽颜色（颜色相同的共用栈空间）
+    std::unordered_map<int, int> rematValues;  // vreg → 常量（溢出但在每个 use 处用 li 重新生成）
     std::unordered_map<int, int> paramVregToLocation; // 参数 vreg → 位置（寄存器 ID 或栈偏移）
     std::set<int> usedPhysRegs;                       // 实际使用过的物理寄存器集合
     std::set<int> calleeSavedRegs; // 使用过的被调用者保存寄存器（需在函数入口/出口保护）
+    uint64_t spillCost = 0;        // 被溢出区间的权重之和（按循环深度加权的访存次数估计）
+    // call 指令 → 跨越它、分配在调用者保存寄存器中的物理寄存器（升序，代码生成只保存 / 恢复这些）
+    std::unordered_map<const ir::Instruction *, std::vector<int>> callSaves;
+};
+
+// ======================== 溢出记录 ========================
+
+// SpillReason：一次溢出决定的原因
+enum class SpillReason : uint8_t {
+    NoFreeReg,   // 线性扫描：没有空闲寄存器，当前区间的 权重 / 剩余跨度 不小于 active 中可换出的区间
+    Evicted,     // 线性扫描：被后开始的区间换出（本区间的 权重 / 剩余跨度 更小），寄存器转给对方
+    Uncolorable, // 图着色：作为潜在溢出入栈，着色时邻居已占满全部可分配寄存器
+};
+
+// spillReasonName：SpillReason → "no-free-reg" / "evicted" / "uncolorable"
+const char *spillReasonName(SpillReason reason);
+
+// SpillDecision：分配器做出的一次溢出决定（RegisterAllocator::setSpillLog 开启记录）
+struct SpillDecision {
+    int vreg;           // 被溢出的 vreg（图着色为合并后的代表节点）
+    SpillReason reason; // 溢出原因
+    int round;          // 线性扫描的分配轮次（从 1 开始，之后的轮次分配分裂片段）；图着色为 1
+    int pos;            // 做出决定的位置（线性扫描为当前区间的起点；图着色为 -1）
+    uint64_t weight;    // 被溢出 vreg 的溢出权重（计入 spillCost）
+    int evictedBy;      // Evicted 时取得其寄存器的 vreg，否则为 -1
 };
 
+// ======================== 常量重物化 ========================
+
+// rematerializeConstants：溢出的、只由同一常量定义的 vreg 改为重物化（rematerialize.cpp），从
+// vregToStack 移到 rematValues，返回改写的栈槽数。在栈槽着色之前执行，F 同 colorStackSlots
+int rematerializeConstants(const ir::Function &F, AllocationResult &result);
+
+// ======================== 栈槽着色 ========================
+
+// colorStackSlots：分配完成后的栈槽着色（stack_coloring.cpp）。活跃区间互不相交的溢出栈槽重新
+// 编号为同一个槽（分裂片段、合并的 vreg 原本共用的槽作为整体），内存活跃范围互不冲突的 alloca
+// 填入同一颜色（allocaColors）。F 为代码生成将使用的函数（分裂后的副本），会重新做活跃性分析
+void colorStackSlots(ir::Function &F, AllocationResult &result);
+
+// ======================== 寄存器偏好 ========================
+
+// RegHint：调用约定决定的寄存器偏好
+struct RegHint {
+    int reg = -1;        // 偏好的物理寄存器（-1 = 无偏好）
+    uint64_t weight = 0; // 偏好成立时省下的 mv 次数（按块执行频率加权）
+};
+
+// computeRegHints：以 vreg 为下标的寄存器偏好 —— ret 的返回值 → a0，call 的第 i 个参数（i < 8）→ a_i，
+// call 的结果 → a0。分配器在寄存器空闲时取偏好的寄存器，代码生成中对应的 mv 随之消失。
+// 同一 vreg 有多个偏好时取累计权重最大的（相同时取编号小的寄存器）。
+// 依赖已完成的活跃性分析（rpoOrder）与 F.analyses().loops()
+std::vector<RegHint> computeRegHints(ir::Function &F);
+
+// ======================== 分配器接口 ========================
+
+// RegAllocKind：可选的寄存器分配算法（--regalloc=linear|graph）
+enum class RegAllocKind : uint8_t {
+    Linear, // 线性扫描（默认）：编译快
+    Graph,  // 图着色（迭代合并）：编译慢一些，拷贝更少
+};
+
+// parseRegAllocKind：解析 "linear" / "graph"，无法识别时返回 false
+bool parseRegAllocKind(const std::string &name, RegAllocKind &kind);
+// regAllocKindName：RegAllocKind → "linear" / "graph"
+const char *regAllocKindName(RegAllocKind kind);
+
+// RegisterAllocator：寄存器分配器的公共接口
+// 代码生成只依赖这里的接口：分配结果、可能的函数副本与溢出临时寄存器（t0/t1，不参与分配）
+class RegisterAllocator {
+  public:
+    explicit RegisterAllocator(const RegInfo &regInfo) : regInfo_(regInfo) {}
+    virtual ~RegisterAllocator() = default;
+
+    /**
+     * @brief 对函数执行寄存器分配
+     * @param F 目标函数 IR（含 phi 时先消除为拷贝）
+     * @return 分配结果（vreg→physReg / vreg→stack 映射）
+     */
+    virtual AllocationResult allocate(ir::Function &F) = 0;
+
+    // splitFunction：分配时改写了函数（插入拷贝等）时返回改写后的副本（代码生成须使用它），
+    // 否则为 nullptr。allocate 本身不改动传入函数的指令（phi 消除除外）
+    virtual ir::Function *splitFunction() const { return nullptr; }
+
+    const AllocationResult &getAllocationResult() const { return result_; }
+
+    // setRegUsage：启用过程间寄存器分配，调用按被调函数发布的掩码破坏寄存器（为空时按 ABI）
+    void setRegUsage(const RegUsageInfo *usage) { regUsage_ = usage; }
+    // setSpillLog：把每次溢出决定追加到 log（为空时不记录，默认不记录；供 ra_debug --batch 分析）
+    void setSpillLog(std::vector<SpillDecision> *log) { spillLog_ = log; }
+
+    // 分配溢出临时寄存器（t0/t1 交替使用）
+    int allocateSpillTempReg();
+    // 判断是否为溢出临时寄存器
+    bool isSpillTempReg(int regId) const;
+
+  protected:
+    const RegInfo &regInfo_; // 目标架构寄存器信息
+    AllocationResult result_; // 分配结果
+    const RegUsageInfo *regUsage_ = nullptr; // 过程间寄存器使用信息（为空表示按 ABI）
+    std::vector<SpillDecision> *spillLog_ = nullptr; // 溢出决定记录（为空表示不记录）
+
+    // logSpill：开启记录时追加一次溢出决定
+    void logSpill(const SpillDecision &decision) {
+        if (spillLog_)
+            spillLog_->push_back(decision);
+    }
+
+    // callClobbers：call 指令破坏的寄存器
+    RegMask callClobbers(const ir::Instruction &call) const {
+        return regUsage_ ? regUsage_->callClobbers(call) : regInfo_.callerSavedMask();
+    }
+    // preservedAcross：reg 中的值能否原样跨越 clobbers 描述的调用（被调用者保存寄存器总是可以）
+    bool preservedAcross(int reg, RegMask clobbers) const {
+        return regInfo_.isCalleeSaved(reg) || (reg > 0 && !(clobbers & regBit(reg)));
+    }
+
+    int spillTempReg1_ = 5, spillTempReg2_ = 6; // 溢出临时寄存器 ID（t0, t1）
+    bool spillTempCounter_ = false;             // 交替选择计数器
+};
+
+// createRegisterAllocator：按算法创建分配器
+std::unique_ptr<RegisterAllocator> createRegisterAllocator(RegAllocKind kind,
+                                                           const RegInfo &regInfo);
+
 // ======================== 线性扫描分配器 ========================
 
 // LinearScanAllocator：基于活跃区间的线性扫描寄存器分配器
@@ -151,69 +416,106 @@ class AllocationResult {
 //   2. 活跃性分析 + 指令编号
 //   3. 构建活跃区间
 //   4. 按起始位置排序，线性扫描分配物理寄存器
-//   5. 无空闲寄存器时，溢出结束最晚的区间
-class LinearScanAllocator {
+//   5. 无空闲寄存器时，溢出 权重 / 剩余跨度 最小的区间（权重：按循环深度加权的 def/use 次数）；
+//      跨越调用的区间优先取能原样跨越这些调用的寄存器（按 ABI 即 s1-s11；-fipra 时还包括被调函数
+//      不改写的调用者保存寄存器），其余区间优先取调用者保存寄存器；
+//      始于 %d = copy %s 且 %s 在此结束的区间直接接过 %s 的寄存器，其余区间先试调用约定偏好（a0-a7，
+//      偏好的寄存器被恰在此处结束的操作数占用时同样接过）
+//   6. 有溢出时（分裂开启）：在函数副本上把溢出的 vreg 分裂为循环 / 块片段，回到 1 重新分配
+//      （second-chance：片段各自再争取寄存器，至多 kMaxRounds 轮）
+class LinearScanAllocator : public RegisterAllocator {
   public:
     explicit LinearScanAllocator(const RegInfo &regInfo);
 
-    /**
-     * @brief 对函数执行寄存器分配
-     * @param F 目标函数 IR
-     * @return 分配结果（vreg→physReg / vreg→stack 映射）
-     */
-    AllocationResult allocate(ir::Function &F);
+    AllocationResult allocate(ir::Function &F) override;
 
     void setDebugMode(bool enable) { debugMode_ = enable; }
     void setDebugOutput(std::ostream *os) { debugOutput_ = os; }
+    // setSplitting：是否启用活跃区间分裂与二次分配（默认开启）
+    void setSplitting(bool enable) { splitting_ = enable; }
+
+    // splitFunction：分配中发生了分裂时，返回插入了分裂拷贝的函数副本
+    ir::Function *splitFunction() const override { return splitFunc_.get(); }
 
-    const AllocationResult &getAllocationResult() const { return result_; }
     // 获取实际使用过的物理寄存器集合
     std::set<int> getUsedPhysRegs() const;
     // 获取使用过的被调用者保存寄存器集合
     std::set<int> getCalleeSavedRegs() const;
 
-    // 分配溢出临时寄存器（t0/t1 交替使用）
-    int allocateSpillTempReg();
-    // 判断是否为溢出临时寄存器
-    bool isSpillTempReg(int regId) const;
-
     // 调试输出：打印所有活跃区间
-    void dumpIntervals(const std::unordered_map<int, std::unique_ptr<LiveInterval>> &intervals);
+    void dumpIntervals(const LiveIntervalTable &intervals);
 
   private:
-    const RegInfo &regInfo_;                 // 目标架构寄存器信息
     bool debugMode_ = false;                 // 调试模式开关
     std::ostream *debugOutput_ = &std::cout; // 调试输出流
 
     std::vector<bool> isPhysRegUsed_;               // 物理寄存器使用标记（32 位）
     std::set<int, PhysRegComparator> freePhysRegs_; // 当前空闲的物理寄存器集合
 
-    int spillTempReg1_ = 5, spillTempReg2_ = 6; // 溢出临时寄存器 ID（t0, t1）
-    bool spillTempCounter_ = false;             // 交替选择计数器
-    std::set<int> allocatedVregs_;              // 已分配的虚拟寄存器集合
+    std::set<int> allocatedVregs_; // 已分配的虚拟寄存器集合
 
     std::vector<LiveInterval *> active_; // 当前活跃的区间列表（按结束位置排序）
-    AllocationResult result_;            // 分配结果
     int nextSpillSlot_ = 0;              // 下一个溢出槽编号
+    int round_ = 1;                      // 当前分配轮次（溢出记录用）
+
+    // -------- 区间分裂 --------
+    static constexpr int kMaxRounds = 4;            // 分配轮数上限（第一轮 + 至多三轮二次分配）
+    bool splitting_ = true;                         // 是否启用分裂
+    std::unique_ptr<ir::Function> splitFunc_;       // 插入了分裂拷贝的函数副本
+    std::unordered_map<int, int> splitParent_;      // 片段 vreg → 被分裂的 vreg
+    std::unordered_set<int> loopPieces_;            // 循环片段
+    std::unordered_map<int, int> homeSlots_;        // 固定在栈上的 vreg → 栈槽（不再参与分配）
+
+    // -------- 分配轮次 --------
+    // allocateRound：对 F 做一轮完整的线性扫描（固定在栈上的 vreg 预先绑定到栈槽）
+    void allocateRound(ir::Function &F);
+    // splitSpilled：分裂本轮溢出的 vreg（首次分裂时复制原函数），返回是否有新的片段
+    bool splitSpilled(ir::Function &original);
+    // spillSlotFor：区间溢出时使用的栈槽（片段与其根 vreg 共用栈槽）
+    int spillSlotFor(const LiveInterval &interval);
+    // splitRoot：沿片段链找到最初被分裂的 vreg
+    int splitRoot(int vreg) const;
 
     // -------- 参数处理 --------
-    // 将参数 vreg 绑定到 a0-a7 或栈位置
-    void processParameters(const std::vector<int> &paramVregs);
+    // 将参数 vreg 绑定到 a0-a7 或栈位置（跨越调用的寄存器参数不绑定，与普通区间一起分配）
+    void processParameters(const std::vector<int> &paramVregs, const LiveIntervalTable &intervals);
+
+    // -------- 调用点 --------
+    std::vector<const ir::Instruction *> calls_; // 本轮函数中的 call 指令（按位置升序）
+    std::vector<RegMask> callMasks_;             // 与 calls_ 同下标：该调用破坏的寄存器
+    // markCallCrossings：收集 call 指令，标记跨越调用的区间
+    void markCallCrossings(ir::Function &F, const LiveIntervalTable &intervals);
+    // collectCallSaves：为每个 call 记录需要保存的调用者保存寄存器
+    void collectCallSaves(const LiveIntervalTable &intervals);
+    // forEachCrossedCall：枚举区间跨越的调用下标，fn 返回 false 时停止
+    template <typename Fn> void forEachCrossedCall(const LiveInterval &iv, Fn &&fn);
 
     // -------- 指令编号 --------
     // 为所有指令按 RPO 顺序分配线性位置编号
     void assignInstrPositions(ir::Function &F);
 
+    // -------- 寄存器偏好 --------
+    std::vector<RegHint> hints_;   // 本轮的调用约定偏好（computeRegHints）
+    std::vector<int> copySource_;  // 指令编号 → copy 的来源 vreg（非 copy 或来源为常量时为 -1）
+    // collectCopySources：记录本轮每条 vreg 到 vreg 拷贝的来源
+    void collectCopySources(ir::Function &F);
+    // takeDyingReg：区间始于指令 I 的 def 时，接过恰在 I 处结束的区间的寄存器
+    // （I 是拷贝时为来源的寄存器，否则为调用约定偏好）
+    bool takeDyingReg(LiveInterval &interval);
+
+    // -------- 溢出权重 --------
+    // 按所在块的循环深度累计每个区间的 def/use 权重
+    void computeSpillWeights(ir::Function &F, const LiveIntervalTable &intervals);
+
     // -------- 线性扫描核心 --------
     // 执行线性扫描分配算法
-    AllocationResult
-    runLinearScan(const std::unordered_map<int, std::unique_ptr<LiveInterval>> &intervals);
+    AllocationResult runLinearScan(const LiveIntervalTable &intervals);
 
     // 过期回收：释放在 curStart 之前已经结束的活跃区间占用的物理寄存器
     void expireOldIntervals(int curStart);
     // 为区间分配一个空闲的物理寄存器
     void allocatePhysicalReg(LiveInterval &interval);
-    // 溢出处理：将当前区间或 active 中结束最晚的区间溢出到栈
+    // 溢出处理：将当前区间或 active 中 权重 / 剩余跨度 最小的区间溢出到栈
     void spillAtInterval(LiveInterval &interval);
     // 分配一个新的栈溢出槽（每次 -4 字节）
     int allocateSpillSlot();
@@ -221,8 +523,9 @@ class LinearScanAllocator {
     // -------- 物理寄存器管理 --------
     // 初始化空闲寄存器池
     void initializeFreeRegs();
-    // 从空闲池中分配一个优先级最高的寄存器
-    int allocatePhysReg();
+    // 从空闲池中分配一个寄存器：hint 空闲时取 hint，否则取优先级最高的
+    // （clobbers 非零时区间跨越调用：先按优先级取能原样跨越这些调用的寄存器）
+    int allocatePhysReg(RegMask clobbers = 0, int hint = -1);
     // 将物理寄存器归还到空闲池
     void freePhysReg(int physId);
 
@@ -233,4 +536,99 @@ class LinearScanAllocator {
     void insertActiveInterval(LiveInterval *interval);
 };
 
+// ======================== 图着色分配器 ========================
+
+// GraphColoringAllocator：Chaitin-Briggs 图着色 + George-Appel 迭代合并（iterated register coalescing）
+// 核心流程：
+//   1. 活跃性分析后反向扫描每个基本块，构建冲突图；copy 指令记为可合并的传送（move）
+//   2. 不跨越调用的寄存器参数预着色为到达寄存器（与线性扫描相同），其余 vreg 参与着色
+//   3. 简化（度 < K 且与传送无关）→ 合并（Briggs / George 保守测试）→ 冻结 → 潜在溢出
+//      （权重 / 度 最小者），直到冲突图为空
+//   4. 按栈逆序着色：优先取已着色的传送伙伴的颜色或调用约定偏好（a0-a7，取权重大者），
+//      跨越调用的 vreg 优先取能原样跨越这些调用的寄存器（同线性扫描）
+//   5. 着色失败的 vreg 成为实际溢出，代码生成经 t0/t1 访问（溢出临时寄存器不在冲突图中，
+//      因此不需要改写程序再来一轮）
+// 比线性扫描慢（冲突图的规模与同时活跃的 vreg 对数成正比），换来更少的拷贝与溢出
+class GraphColoringAllocator : public RegisterAllocator {
+  public:
+    explicit GraphColoringAllocator(const RegInfo &regInfo);
+
+    AllocationResult allocate(ir::Function &F) override;
+
+    // 调试输出：着色过程中的合并 / 溢出统计
+    void setDebugOutput(std::ostream *os) { debugOutput_ = os; }
+
+  private:
+    // 节点状态（每个 vreg 恰好处于其中之一）
+    enum class NodeState : uint8_t {
+        None,        // 不参与着色（未出现、alloca、栈传入参数）
+        Precolored,  // 预着色（绑定在到达寄存器上的参数）
+        Initial,     // 尚未放入工作表
+        Simplify,    // 低度、与传送无关
+        Freeze,      // 低度、与传送相关
+        Spill,       // 高度
+        Coalesced,   // 已合并到别的节点（alias_）
+        SelectStack, // 已简化，等待着色
+        Colored,     // 已着色
+        Spilled,     // 实际溢出
+    };
+    // 传送状态
+    enum class MoveState : uint8_t { Worklist, Active, Coalesced, Constrained, Frozen };
+
+    struct Move {
+        int dst, src;
+        uint64_t weight; // 块执行频率：合并掉它省下的动态 mv 数
+    };
+
+    std::ostream *debugOutput_ = nullptr;
+    int K_ = 0;                         // 可分配寄存器数
+    std::vector<int> colorOrder_;       // 可分配寄存器（按优先级）
+    std::vector<NodeState> state_;      // vreg → 节点状态
+    std::vector<int> degree_;           // vreg → 当前度
+    std::vector<int> alias_;            // 已合并节点 → 合并目标
+    std::vector<int> color_;            // vreg → 物理寄存器
+    std::vector<uint64_t> weight_;      // vreg → 溢出权重（def/use 次数 × 块执行频率）
+    std::vector<RegMask> callClobbers_; // vreg → 跨越的调用破坏的寄存器（0 表示不跨越调用）
+    std::vector<RegHint> hints_;        // vreg → 调用约定偏好（着色前汇总到合并后的代表节点）
+    std::vector<std::vector<int>> adjList_;  // vreg → 邻居
+    std::unordered_set<uint64_t> adjSet_;    // (min, max) 打包的冲突边
+    std::vector<std::vector<int>> moveList_; // vreg → 相关传送
+    std::vector<Move> moves_;
+    std::vector<MoveState> moveState_;
+    std::set<int> simplifyWorklist_, freezeWorklist_, spillWorklist_;
+    std::set<int> worklistMoves_; // 待合并的传送（moves_ 按权重降序，下标小者先合并）
+    std::vector<int> selectStack_;
+    // 每个 call 指令之后仍活跃的 vreg（不含 call 的结果），着色后转为 callSaves
+    std::vector<std::pair<const ir::Instruction *, std::vector<int>>> callLive_;
+
+    // -------- 构建 --------
+    void reset(const ir::Function &F);
+    void build(ir::Function &F);
+    void addEdge(int u, int v);
+    bool adjacent(int u, int v) const;
+    void precolorParameters(const ir::Function &F);
+    void makeWorklist();
+
+    // -------- 简化 / 合并 / 冻结 / 溢出 --------
+    template <typename Fn> void forEachAdjacent(int n, Fn &&fn) const;
+    bool moveRelated(int n) const;
+    void simplify();
+    void decrementDegree(int m);
+    void enableMoves(int n);
+    void coalesce();
+    void addWorkList(int u);
+    bool ok(int t, int r) const;
+    bool conservative(int u, int v) const;
+    int getAlias(int n) const;
+    void combine(int u, int v);
+    void freeze();
+    void freezeMoves(int u);
+    void selectSpill();
+    void moveNode(int n, NodeState to);
+
+    // -------- 着色与结果 --------
+    void assignColors();
+    void buildResult(const ir::Function &F);
+};
+
 } // namespace toyc
@@ -1,58 +1,80 @@
 #pragma once
+#include "asm_emitter.h"
 #include "ir.h"
+#include "machine_ir.h"
 #include "reg_alloc.h"
+#include <functional>
 #include <map>
 #include <memory>
-#include <set>
+#include <optional>
+#include <ostream>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace toyc {
 
-// RISC-V32 代码生成器：从结构化 IR（ir::Module）生成 RISC-V 汇编文本
-// 核心流程：
-//   1. precomputeAllocations — 对每个函数执行线性扫描寄存器分配
-//   2. generateFunction      — 按函数生成汇编（prologue → 指令 → epilogue）
-//   3. 占位符替换            — 函数结束后回填实际栈帧大小
-class RISCVCodeGen {
+class ThreadPool;
+class CodeGenCache;
+
+// FunctionLoader：按下标提供第 i 个 IR 函数（可以在调用时才解析 / 解码），编译完成后即被释放
+using FunctionLoader = std::function<std::unique_ptr<ir::Function>(size_t)>;
+// MachineFunctionConsumer：按函数顺序接收完成的机器函数
+using MachineFunctionConsumer = std::function<void(const mir::MachineFunction &)>;
+
+// FunctionCodeGen：单个函数的代码生成上下文
+// 持有一个函数指令选择期间的全部可变状态（alloca 偏移、比较缓存、栈帧尺寸、当前机器基本块），
+// 不同函数的上下文之间不共享可变状态，因此可以在多个线程上同时运行
+class FunctionCodeGen {
   public:
-    RISCVCodeGen();
-    // 主入口：生成整个模块的 RISC-V 汇编
-    std::string generate(ir::Module &module);
+    // instrument：--profile-generate，每个块入口放置一个执行计数器
+    // schedModel：指令调度的延迟模型（为空时不调度）
+    FunctionCodeGen(const RegInfo &regInfo, RegisterAllocator &allocator,
+                    const ir::Function &func, bool instrument = false,
+                    const mir::LatencyModel *schedModel = nullptr);
+
+    // run：指令选择 → 计算栈帧 → 展开栈帧伪指令 → 窥孔优化 → 指令调度，返回完整的机器函数
+    mir::MachineFunction run();
 
   private:
-    RegInfo regInfo_; // 目标架构寄存器信息
-    std::map<std::string, std::unique_ptr<LinearScanAllocator>> funcAllocators_; // 函数名 → 分配器
+    const RegInfo &regInfo_;         // 目标架构寄存器信息
+    RegisterAllocator &allocator_;   // 本函数的寄存器分配器（已完成分配）
+    const AllocationResult &alloc_;  // 分配结果（allocator_ 持有）
+    const ir::Function &func_;       // 当前 IR 函数（用于标签 → 块下标）
+    bool isMainFunction_;            // 是否为 main 函数
+    bool instrument_;                // 是否插入块计数器（--profile-generate）
+    const mir::LatencyModel *schedModel_; // 指令调度的延迟模型（为空表示不调度）
+    bool hasReturn_ = false;         // 当前函数是否已有 return
+    int lastDefReg_ = 10;            // resolveDef 返回的寄存器（供 spillDefIfNeeded 使用）
 
-    // -------- 每个函数的运行时状态 --------
-    std::string currentFunction_; // 当前处理的函数名
-    bool isMainFunction_ = false; // 是否为 main 函数
-    bool hasReturn_ = false;      // 当前函数是否已有 return
-    std::string output_;          // 汇编输出缓冲区
-    std::string lastDefRegName_; // resolveDef 返回的寄存器名（供 spillDefIfNeeded 使用）
+    // -------- 机器代码构建 --------
+    mir::MachineBasicBlock *currentMBB_ = nullptr; // 当前插入的机器基本块
 
     // -------- alloca/栈偏移 --------
     std::map<int, int> allocaOffsets_; // alloca vreg → 栈偏移
     int stackOffset_ = 0;              // 已分配的局部变量栈空间
     int totalStackSize_ = 0;           // 函数总栈帧大小
-    int frameOverhead_ = 0;            // ra + s0 + callee-saved 字节数
+    int frameOverhead_ = 0;            // ra（非叶函数）+ s0（使用帧指针时）+ callee-saved 字节数
+    bool savesReturnAddress_ = true;   // 是否保存 ra（叶函数不保存）
+    bool usesFramePointer_ = true;     // 是否设置 s0 为帧指针（省略帧指针或无栈上数据的叶函数为假）
     int callSaveSize_ = 0;             // 函数调用时 caller-saved 保存区字节数
     int callArgAreaSize_ = 0;          // 超过 8 个参数时的出栈参数区字节数
 
     // -------- 比较信息延迟合并到分支（branch fusion） --------
     struct CmpInfo {
-        ir::CmpPred pred;           // 比较谓词
-        std::string lhsReg, rhsReg; // 已解析的左右操作数寄存器名
+        ir::CmpPred pred;   // 比较谓词
+        int lhsReg, rhsReg; // 已解析的左右操作数物理寄存器
     };
-    std::unordered_map<int, CmpInfo> cmpMap_; // vreg → CmpInfo
-
-    // -------- 预计算寄存器分配 --------
-    // 对模块中每个函数执行线性扫描，结果保存到 funcAllocators_
-    void precomputeAllocations(ir::Module &module);
+    std::unordered_map<int, CmpInfo> cmpMap_; // vreg → CmpInfo（只对紧随其后的 br i1 有效）
+    // -------- 融合比较：结果只被紧随其后的 br i1 读取的 icmp 不生成 slt/seqz 等，由分支直接比较操作数 --------
+    struct FusedBranch {
+        const ir::Instruction *cmp; // 提供操作数与谓词的 icmp
+        bool negated;               // 条件为 icmp eq %cmp, 0（谓词取反）
+    };
+    std::unordered_set<const ir::Instruction *> fusedCmps_; // 不生成指令的 icmp
+    std::unordered_map<int, FusedBranch> fusedBranches_;    // br i1 的条件 vreg → 融合比较
 
-    // -------- 函数级生成 --------
-    void generateFunction(ir::Function &func); // 生成单个函数的完整汇编
-    void resetFunctionState();                 // 重置每函数状态
+    void collectFusedCompares(); // 标记融合比较（fusedCmps_）
 
     // -------- 指令级生成（基于 opcode 分派，无需字符串匹配） --------
     void generateInst(const ir::Instruction &inst); // 分派入口
@@ -60,30 +82,163 @@ class RISCVCodeGen {
     void genStore(const ir::Instruction &inst);     // store  → sw/sb
     void genLoad(const ir::Instruction &inst);      // load   → lw/lb
     void genBinOp(const ir::Instruction &inst); // add/sub/mul/div/rem → 算术指令（含 addi 优化）
+    // 常量乘数 / 除数 → 移位、加减与 mulh 序列（不适用时返回 false）
+    bool genConstantMulDiv(const ir::Instruction &inst, int defReg);
     void genICmp(const ir::Instruction &inst);   // icmp   → slt/sub+seqz 等 + 缓存 CmpInfo
     void genCondBr(const ir::Instruction &inst); // br cond → branch fusion 或 bnez
     void genBr(const ir::Instruction &inst);     // br      → j
     void genRet(const ir::Instruction &inst);    // ret     → mv a0 + epilogue + ret
     void genCall(const ir::Instruction &inst);   // call    → 保存/恢复 caller-saved + call
+    void genTailCall(const ir::Instruction &inst); // call + ret → 传参 + epilogue + tail
+    void genCallArgs(const ir::Instruction &inst); // 实参送入 a0-a7 与出栈参数区
+    void genCopy(const ir::Instruction &inst);   // copy    → mv / li（phi 消除的产物）
+    void genParamMoves(); // 函数入口：把另行分配的参数从到达寄存器搬到分配的位置
+    // emitParallelMoves：按并行语义执行一组 (目标, 来源) 寄存器移动（环借助溢出临时寄存器打开）
+    void emitParallelMoves(std::vector<std::pair<int, int>> moves);
 
     // -------- 操作数解析 --------
-    std::string resolveUse(const ir::Operand &op); // 将 Operand 解析为物理寄存器名（含溢出加载）
-    std::string resolveDef(const ir::Operand &op); // 将 def Operand 解析为目标寄存器名
+    int resolveUse(const ir::Operand &op); // 将 Operand 解析为物理寄存器（含溢出加载）
+    int resolveDef(const ir::Operand &op); // 将 def Operand 解析为目标物理寄存器
+    int blockIndex(const ir::Operand &label) const; // 标签操作数 → 机器基本块下标
+    bool savesAcrossCall(const ir::Instruction &inst) const; // 调用点是否需保存调用者保存寄存器
+    // 调用点是否与紧随的 ret 一起生成为尾调用
+    bool isTailCallSite(const std::vector<ir::Instruction *> &insts, size_t i) const;
     int getAllocaOffset(int vreg);                 // 查找 alloca vreg 的栈偏移
+    std::pair<int, int> frameAddress(int offset) const; // s0 - offset → (基址, 偏移)
     int spillSlotToSpOffset(int slot);             // 溢出槽偏移 → sp 正偏移
+    void loadStackSlot(int reg, int slot);         // 从溢出槽 / 栈传入参数加载到 reg
+    bool loadSpilled(int reg, int vreg); // 不在寄存器中的 vreg 装入 reg（li 重物化或从栈加载）
     void spillDefIfNeeded(const ir::Instruction &inst); // 若 def 被溢出，写回栈
 
-    // -------- 汇编输出 --------
-    void emit(const std::string &line); // 输出一条缩进后的汇编指令
+    // -------- 机器指令输出 --------
+    void emit(const mir::MachineInstr &mi); // 追加一条机器指令到当前机器基本块
 
     // -------- 栈帧管理 --------
-    void emitPrologue();        // （占位，实际由 updateStackFramePlaceholders 回填）
-    void emitEpilogue();        // （占位，实际由 updateStackFramePlaceholders 回填）
     void calculateStackFrame(); // 计算栈帧总大小（对齐到 16 字节）
-    void updateStackFramePlaceholders(); // 替换 prologue/epilogue 占位符为实际指令
+};
+
+// generateVectorKernel：按 VectorKernel 描述生成向量内核（--march=rv32imv）的 RVV 机器代码
+// （vector_codegen.cpp）；内核是不需要栈帧的叶函数，不经过寄存器分配、窥孔优化与调度
+mir::MachineFunction generateVectorKernel(const ir::Function &func, const RegInfo &regInfo);
+
+// RISC-V32 代码生成器：从结构化 IR（ir::Module）生成 RISC-V 汇编文本或 ELF 目标文件
+// 核心流程（每个函数独立完成 1-3，可并行）：
+//   1. RegisterAllocator    — 寄存器分配（线性扫描，或 --regalloc=graph 时图着色）
+//   2. FunctionCodeGen      — 指令选择，构建 mir::MachineFunction（栈帧以伪指令占位）
+//   3. shrinkWrap           — 把 prologue 移到真正需要栈帧的块（早返回不建立栈帧）；
+//      expandFramePseudos   — 栈帧大小确定后展开 prologue/epilogue；
+//      runPeephole          — 随后重排块以增加落空，删除冗余的跳转、访存与拷贝
+//      scheduleBlocks       — 按延迟模型在块内重排指令，减少顺序流水线的停顿（启用时）
+//   4. AsmPrinter           — 一趟格式化为汇编文本，按函数原始顺序流式输出
+//      ELFObjectWriter      — 或直接编码为机器码，输出可重定位目标文件
+class RISCVCodeGen {
+  public:
+    // numThreads：并行处理函数的线程数（<= 1 时在调用线程上串行执行）
+    explicit RISCVCodeGen(unsigned numThreads = 1);
+    // pool：使用外部线程池并行处理函数（如批量编译驱动中，与其他翻译单元共享工作线程）
+    explicit RISCVCodeGen(ThreadPool &pool);
+    // setCache：启用增量编译缓存（命中的函数跳过寄存器分配与指令选择；为空时关闭）
+    void setCache(CodeGenCache *cache) { cache_ = cache; }
+    // setRegAlloc：选择寄存器分配算法（默认线性扫描）
+    void setRegAlloc(RegAllocKind kind) { regAlloc_ = kind; }
+    // setProfileGenerate：插入块执行计数器并随函数输出剖析记录（--profile-generate，仅汇编输出）
+    void setProfileGenerate(bool enable) { profileGenerate_ = enable; }
+    // setSchedule：按延迟模型调度每个块的指令（-fschedule-insns / -mtune；为空时不调度）
+    void setSchedule(std::optional<mir::LatencyModel> model) { schedModel_ = std::move(model); }
+    // setCompressed：以 RV32IMC 为目标（--march=rv32imc）：寄存器分配优先 x8-x15，
+    // 汇编与目标文件输出 16 位压缩指令
+    void setCompressed(bool enable) {
+        compressed_ = enable;
+        regInfo_ = &RegInfo::shared(compressed_, omitFramePointer_);
+    }
+    // setOmitFramePointer：不使用帧指针（-fomit-frame-pointer）：局部变量与栈传入参数按 sp 寻址，
+    // s0 作为被调用者保存寄存器参与分配，prologue / epilogue 不再保存与设置 s0
+    void setOmitFramePointer(bool enable) {
+        omitFramePointer_ = enable;
+        regInfo_ = &RegInfo::shared(compressed_, omitFramePointer_);
+    }
+    // setIPRA：过程间寄存器分配（-fipra）：按调用图自底向上编译，调用点只保存被调函数实际改写的
+    // 寄存器，跨越调用的值可以留在被调函数不改写的调用者保存寄存器中（只作用于整模块入口，
+    // 逐函数加载的流水线入口看不到调用图，按 ABI 处理）
+    void setIPRA(bool enable) { ipra_ = enable; }
+    // 机器代码入口：逐函数构建 MachineFunction（栈帧已展开），按模块中的函数顺序交给 consumer
+    // 多线程模式下各函数在线程池中并行分配寄存器与选择指令，consumer 始终在调用线程上按序执行
+    // 调用线程等待期间会帮忙执行线程池中的任务，因此可以在线程池的任务内部调用
+    void generateMachineCode(ir::Module &module, const MachineFunctionConsumer &consumer);
+    // 流水线入口：第 i 个函数在编译它的任务中才由 load 加载，编译后立即释放（解析 → 分配 → 输出
+    // 逐函数进行，驻留内存与单个函数而非整个模块成正比）；其余行为与整模块版本相同
+    void generateMachineCode(size_t numFunctions, const FunctionLoader &load,
+                             const MachineFunctionConsumer &consumer);
+    // 主入口：生成整个模块的 RISC-V 汇编，逐函数写入输出流
+    void generate(ir::Module &module, std::ostream &os);
+    void generate(size_t numFunctions, const FunctionLoader &load, std::ostream &os);
+    // 便捷入口：生成整个模块的 RISC-V 汇编文本
+    std::string generate(ir::Module &module);
+    // 目标文件入口：生成 ELF32 可重定位目标文件写入 os（编码失败抛出 std::runtime_error）
+    void generateObject(ir::Module &module, std::ostream &os);
+    void generateObject(size_t numFunctions, const FunctionLoader &load, std::ostream &os);
+
+  private:
+    const RegInfo *regInfo_;        // 目标架构寄存器信息（RegInfo::shared()，只读，线程间共享）
+    unsigned numThreads_;           // 并行线程数
+    ThreadPool *pool_ = nullptr;    // 外部线程池（为空时按 numThreads_ 自建）
+    CodeGenCache *cache_ = nullptr; // 增量编译缓存（为空表示不使用）
+    RegAllocKind regAlloc_ = RegAllocKind::Linear; // 寄存器分配算法（--regalloc）
+    bool profileGenerate_ = false;                 // 块计数器插桩（--profile-generate）
+    std::optional<mir::LatencyModel> schedModel_;  // 指令调度的延迟模型（为空表示不调度）
+    bool compressed_ = false;                      // RV32C 压缩指令（--march=rv32imc）
+    bool ipra_ = false;                            // 过程间寄存器分配（-fipra）
+    bool omitFramePointer_ = false;                // 省略帧指针（-fomit-frame-pointer）
+
+    // compileFunction：对单个函数执行寄存器分配 + 指令选择（不访问共享可变状态；
+    // 启用缓存时先按函数内容查找，未命中才编译并写回缓存）
+    // usage 非空时按被调函数发布的寄存器掩码分配（-fipra）
+    mir::MachineFunction compileFunction(ir::Function &func,
+                                         const RegUsageInfo *usage = nullptr) const;
+
+    // generateBottomUp：-fipra 的整模块入口，按调用图分层编译并发布各函数的寄存器掩码
+    void generateBottomUp(ir::Module &module, const MachineFunctionConsumer &consumer);
+
+    // runPipeline：编译 n 个函数（串行或在线程池中并行），按下标顺序交给 consumer
+    void runPipeline(size_t n, const std::function<mir::MachineFunction(size_t)> &compile,
+                     const MachineFunctionConsumer &consumer);
 };
 
 // 便捷函数：从结构化 IR 模块直接生成 RISC-V 汇编字符串
-std::string generateRISCVAssembly(ir::Module &module);
+std::string generateRISCVAssembly(ir::Module &module, unsigned numThreads = 1,
+                                  CodeGenCache *cache = nullptr,
+                                  RegAllocKind regAlloc = RegAllocKind::Linear,
+                                  bool profileGenerate = false,
+                                  const mir::LatencyModel *schedModel = nullptr,
+                                  bool compressed = false, bool ipra = false,
+                                  bool omitFramePointer = false);
+// 便捷函数：从结构化 IR 模块生成 RISC-V 汇编并流式写入 os
+void generateRISCVAssembly(ir::Module &module, std::ostream &os, unsigned numThreads = 1,
+                           CodeGenCache *cache = nullptr,
+                           RegAllocKind regAlloc = RegAllocKind::Linear,
+                           bool profileGenerate = false,
+                           const mir::LatencyModel *schedModel = nullptr,
+                           bool compressed = false, bool ipra = false,
+                           bool omitFramePointer = false);
+// 便捷函数：从结构化 IR 模块生成 ELF32 可重定位目标文件并写入 os
+void generateRISCVObject(ir::Module &module, std::ostream &os, unsigned numThreads = 1,
+                         CodeGenCache *cache = nullptr,
+                         RegAllocKind regAlloc = RegAllocKind::Linear,
+                         const mir::LatencyModel *schedModel = nullptr,
+                         bool compressed = false, bool ipra = false,
+                         bool omitFramePointer = false);
+// 便捷函数：逐函数加载并生成 RISC-V 汇编（流水线版本）
+void generateRISCVAssembly(size_t numFunctions, const FunctionLoader &load, std::ostream &os,
+                           unsigned numThreads = 1, CodeGenCache *cache = nullptr,
+                           RegAllocKind regAlloc = RegAllocKind::Linear,
+                           bool profileGenerate = false,
+                           const mir::LatencyModel *schedModel = nullptr,
+                           bool compressed = false, bool omitFramePointer = false);
+// 便捷函数：逐函数加载并生成 ELF32 目标文件（流水线版本）
+void generateRISCVObject(size_t numFunctions, const FunctionLoader &load, std::ostream &os,
+                         unsigned numThreads = 1, CodeGenCache *cache = nullptr,
+                         RegAllocKind regAlloc = RegAllocKind::Linear,
+                         const mir::LatencyModel *schedModel = nullptr,
+                         bool compressed = false, bool omitFramePointer = false);
 
 } // namespace toyc
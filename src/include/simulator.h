@@ -0,0 +1,131 @@
+#pragma once
+#include "machine_ir.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace toyc::sim {
+
+// ======================== 目标文件与链接 ========================
+//
+// 模拟器的输入是 toyc 的两种产物：汇编文本（-S / 默认输出）与 ELF32 可重定位目标文件（-c）。
+// 两者先读成同一种 ObjectFile（节 + 符号 + 重定位），再由 link 按固定布局合成内存映像：
+// 汇编文本由内置的小型汇编器逐行编码（对符号的引用一律留作重定位），ELF 直接取节内容与 .rela 节。
+// 没有输入定义 _start 时链接内置启动代码（与 scripts/crt0.s 相同：call main 后以 a0 为退出码调用
+// exit），也可以把 crt0.s / profile_rt.s 作为输入一起链接
+
+// Section：可加载的节（代码 / 只读数据 / 数据 / bss）
+struct Section {
+    std::string name;
+    std::vector<uint8_t> data; // 内容（nobits 节为空）
+    uint32_t size = 0;         // 字节数（nobits 节只有大小）
+    uint32_t align = 1;
+    bool exec = false;   // 代码节
+    bool write = false;  // 可写
+    bool nobits = false; // .bss 之类不占文件空间的节
+};
+
+// Symbol：符号表项；section 为 -1 表示未定义，-2 表示绝对值
+struct Symbol {
+    enum class Binding : uint8_t { Local, Global, Weak };
+    std::string name;
+    int section = -1;
+    uint32_t value = 0; // 节内偏移（绝对符号为值本身）
+    Binding binding = Binding::Local;
+};
+
+// Relocation：对 sections[section] 中 offset 处的修正（type 为 R_RISCV_*，symbol 为符号下标）
+struct Relocation {
+    int section;
+    uint32_t offset;
+    uint32_t type;
+    int symbol;
+    int32_t addend;
+};
+
+struct ObjectFile {
+    std::string name; // 输入文件名（用于报错）
+    std::vector<Section> sections;
+    std::vector<Symbol> symbols;
+    std::vector<Relocation> relocs;
+};
+
+// assemble：汇编 RV32IMC 与 toyc 使用的 RVV 子集（含常用伪指令与数据伪指令），
+// 语法错误或不支持的指令抛出 std::runtime_error（"文件名:行号: 原因"）
+ObjectFile assemble(std::string_view text, const std::string &name);
+
+// readELF：读取 ELF32 RISC-V 可重定位目标文件，格式错误时抛出 std::runtime_error
+ObjectFile readELF(std::string_view bytes, const std::string &name);
+
+// loadObject：按内容识别输入（ELF 魔数或汇编文本）并读入
+ObjectFile loadObject(std::string_view contents, const std::string &name);
+
+// Image：链接后的内存映像（代码从 kTextBase 开始，数据按页对齐紧随其后）
+struct Image {
+    static constexpr uint32_t kTextBase = 0x10000;
+    std::vector<uint8_t> bytes;     // [kTextBase, kTextBase + bytes.size()) 的内容
+    uint32_t textEnd = kTextBase;   // 代码段结束地址（之后为数据）
+    uint32_t entry = kTextBase;     // _start 的地址
+    std::unordered_map<std::string, uint32_t> symbols; // 全局符号 → 地址
+
+    uint32_t end() const { return kTextBase + static_cast<uint32_t>(bytes.size()); }
+};
+
+// link：合并各目标文件（同类节首尾相接，名字为 C 标识符的节另外定义 __start_<名> /
+// __stop_<名>），解析符号并应用重定位；重复定义、未定义的非弱符号或超出编码范围时抛出
+// std::runtime_error
+Image link(std::vector<ObjectFile> objects);
+
+// ======================== 解释执行 ========================
+
+// Stats：动态计数与周期估计
+struct Stats {
+    uint64_t instructions = 0; // 执行的指令数
+    uint64_t compressed = 0;   // 其中的 16 位指令
+    uint64_t loads = 0;
+    uint64_t stores = 0;
+    uint64_t stackLoads = 0;  // 地址落在栈区的 load（溢出重载、被调用者保存寄存器恢复等）
+    uint64_t stackStores = 0; // 地址落在栈区的 store
+    uint64_t branches = 0;    // 条件分支
+    uint64_t branchesTaken = 0;
+    uint64_t jumps = 0; // jal / jalr（含调用与返回）
+    uint64_t calls = 0; // 写 ra 的 jal / jalr
+    uint64_t mulDiv = 0;
+    uint64_t vector = 0; // RVV 指令
+    uint64_t stallCycles = 0;
+    uint64_t cycles = 0; // 估计周期数
+
+    // report / reportJson：与 --stats / --stats-json 相同风格的计数表与 JSON 对象
+    void report(std::ostream &os) const;
+    void reportJson(std::ostream &os) const;
+};
+
+// Options：模拟参数
+struct Options {
+    uint64_t maxSteps = 1000000000; // 指令数上限（超出时停止，防止死循环）
+    uint32_t stackSize = 8u << 20;  // 栈区大小（位于映像之后，sp 初值为其顶端）
+    // 周期模型：单发射顺序流水线，每条指令 1 周期；读取尚未就绪的结果时停顿到其就绪，
+    // 结果延迟取自 LatencyModel（与 -mtune 相同）；每次发生跳转（分支成立、jal / jalr）
+    // 另加 takenPenalty 周期的取指重定向开销
+    mir::LatencyModel model;
+    int takenPenalty = 2;
+    bool fileIO = true; // 允许 openat / close 在当前目录读写文件（profile_rt.s 写出 toyc.profraw）
+};
+
+// Result：运行结果
+struct Result {
+    enum class Status : uint8_t { Exited, StepLimit, Fault };
+    Status status = Status::Exited;
+    int exitCode = 0;    // exit 的参数（Exited 时有效）
+    std::string output;  // 写到 fd 1 / 2 的内容
+    std::string error;   // Fault / StepLimit 的原因（含出错的 pc）
+    Stats stats;
+};
+
+// run：从 image.entry 开始解释执行，直到 exit 系统调用、出错或达到指令数上限
+Result run(const Image &image, const Options &options = {});
+
+} // namespace toyc::sim
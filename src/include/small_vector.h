@@ -0,0 +1,131 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+#include <vector>
+
+namespace toyc {
+
+// SmallVector：带内联存储的小型动态数组，仅用于可平凡拷贝的元素（Operand、int 等）
+// 元素个数不超过 N 时完全存放在对象内部，不产生堆分配；超过 N 时退化为普通堆数组。
+// IR 指令绝大多数只有 0~3 个操作数，用它代替 std::vector 可以省掉每条指令的一次堆分配
+template <typename T, unsigned N> class SmallVector {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "SmallVector only holds trivially copyable types");
+
+  public:
+    using value_type = T;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    SmallVector() = default;
+    SmallVector(std::initializer_list<T> il) { assign(il.begin(), il.end()); }
+    SmallVector(const std::vector<T> &v) { assign(v.data(), v.data() + v.size()); }
+    SmallVector(const SmallVector &o) { assign(o.begin(), o.end()); }
+    SmallVector(SmallVector &&o) noexcept { moveFrom(o); }
+    ~SmallVector() { release(); }
+
+    SmallVector &operator=(const SmallVector &o) {
+        if (this != &o)
+            assign(o.begin(), o.end());
+        return *this;
+    }
+    SmallVector &operator=(SmallVector &&o) noexcept {
+        if (this != &o) {
+            release();
+            moveFrom(o);
+        }
+        return *this;
+    }
+    SmallVector &operator=(std::initializer_list<T> il) {
+        assign(il.begin(), il.end());
+        return *this;
+    }
+    SmallVector &operator=(const std::vector<T> &v) {
+        assign(v.data(), v.data() + v.size());
+        return *this;
+    }
+
+    // -------- 访问 --------
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    T &operator[](size_t i) { return data()[i]; }
+    const T &operator[](size_t i) const { return data()[i]; }
+    T &front() { return data()[0]; }
+    const T &front() const { return data()[0]; }
+    T &back() { return data()[size_ - 1]; }
+    const T &back() const { return data()[size_ - 1]; }
+    T *data() { return heap_ ? heap_ : reinterpret_cast<T *>(inline_); }
+    const T *data() const { return heap_ ? heap_ : reinterpret_cast<const T *>(inline_); }
+    iterator begin() { return data(); }
+    iterator end() { return data() + size_; }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + size_; }
+
+    // -------- 修改 --------
+    void clear() { size_ = 0; }
+    void reserve(size_t n) {
+        if (n <= cap_)
+            return;
+        T *p = new T[n];
+        std::memcpy(static_cast<void *>(p), data(), size_ * sizeof(T));
+        delete[] heap_;
+        heap_ = p;
+        cap_ = static_cast<uint32_t>(n);
+    }
+    void push_back(const T &v) {
+        if (size_ == cap_)
+            reserve(cap_ * 2);
+        data()[size_++] = v;
+    }
+    void pop_back() { --size_; }
+    void resize(size_t n, const T &v = T()) {
+        reserve(n);
+        for (size_t i = size_; i < n; ++i)
+            data()[i] = v;
+        size_ = static_cast<uint32_t>(n);
+    }
+    iterator erase(iterator first, iterator last) {
+        std::copy(last, end(), first);
+        size_ -= static_cast<uint32_t>(last - first);
+        return first;
+    }
+    iterator insert(iterator pos, const T &v) {
+        size_t idx = pos - begin();
+        push_back(v);
+        std::rotate(begin() + idx, end() - 1, end());
+        return begin() + idx;
+    }
+
+  private:
+    alignas(T) unsigned char inline_[N * sizeof(T)]; // 内联存储
+    T *heap_ = nullptr;                               // 溢出到堆时的存储（否则为空）
+    uint32_t size_ = 0;
+    uint32_t cap_ = N;
+
+    void assign(const T *first, const T *last) {
+        size_ = 0;
+        reserve(static_cast<size_t>(last - first));
+        std::copy(first, last, data());
+        size_ = static_cast<uint32_t>(last - first);
+    }
+    void moveFrom(SmallVector &o) {
+        size_ = o.size_;
+        cap_ = o.cap_;
+        heap_ = o.heap_;
+        if (!heap_)
+            std::memcpy(inline_, o.inline_, size_ * sizeof(T));
+        o.heap_ = nullptr;
+        o.size_ = 0;
+        o.cap_ = N;
+    }
+    void release() {
+        delete[] heap_;
+        heap_ = nullptr;
+        cap_ = N;
+    }
+};
+
+} // namespace toyc
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace toyc {
+
+// SourceBuffer：只读的源文件内容
+// POSIX 平台上把普通文件 mmap 为只读私有映射，Lexer / Token 直接以 string_view 引用映射内容，
+// 整个前端不再复制源码；空文件、管道等无法映射的输入以及非 POSIX 平台退化为一次性读入自有字符串。
+// 缓冲区只可移动，且必须比引用它的 Lexer / Parser / Token 活得更久
+class SourceBuffer {
+  public:
+    // open：映射（或读入）path；无法打开时抛出 std::runtime_error("cannot open file")
+    static SourceBuffer open(const std::string &path);
+
+    // fromString：持有一段内存中的源码（测试与非文件输入）
+    static SourceBuffer fromString(std::string text);
+
+    SourceBuffer() = default;
+    SourceBuffer(SourceBuffer &&other) noexcept;
+    SourceBuffer &operator=(SourceBuffer &&other) noexcept;
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+    ~SourceBuffer();
+
+    // text：全部源码（映射时指向映射区，否则指向自有字符串）
+    std::string_view text() const {
+        return mapped_ ? std::string_view(data_, size_) : std::string_view(owned_);
+    }
+    size_t size() const { return text().size(); }
+    bool empty() const { return size() == 0; }
+    // isMapped：内容是否来自 mmap（否则为自有副本）
+    bool isMapped() const { return mapped_; }
+
+  private:
+    const char *data_ = nullptr; // 映射区起始地址（仅 mapped_ 时有效）
+    size_t size_ = 0;            // 映射长度（仅 mapped_ 时有效）
+    bool mapped_ = false;
+    std::string owned_; // 未映射时的自有内容
+
+    void release();
+};
+
+} // namespace toyc
@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace toyc {
+namespace stats {
+
+// ======================== 阶段计时与计数器 ========================
+//
+// 轻量级的编译统计：各阶段用 ScopedTimer 累计耗时，用 add 累加计数器，最后由 report* 输出。
+// 默认关闭；关闭时 ScopedTimer 的构造 / 析构与 add 都只做一次 relaxed 原子读和一次分支，
+// 不读时钟、不写共享数据，因此可以常驻在发布版本中。
+// 所有数据都是原子量，并行代码生成的各线程可以同时写入：阶段耗时是各线程耗时之和
+// （-j N 时可能超过墙钟总时间），峰值内存为该阶段结束时进程 RSS 的高水位
+
+// Phase：计时的编译阶段
+enum class Phase : uint8_t {
+    Parse,      // 词法 + 语法分析（Lexer 由 Parser 按需驱动，两者不拆分）
+    IRBuild,    // AST → IR（IRBuilder::buildModule）
+    IRLoad,     // .ll 解析 / .bir 解码（逐函数）
+    Optimize,   // IR 优化流水线（-O1 起）
+    Liveness,   // 活跃性分析
+    Intervals,  // 活跃区间构建
+    LinearScan, // 线性扫描分配
+    GraphColor, // 图着色分配（--regalloc=graph：建图 + 迭代合并 + 着色）
+    InstSelect, // 指令选择与栈帧展开（FunctionCodeGen::run）
+    Emit,       // 汇编打印 / 机器码编码与 ELF 输出
+    Count,
+};
+
+// Counter：计数器
+enum class Counter : uint8_t {
+    Functions,        // 进入代码生成的函数数
+    IRInstructions,   // 这些函数的 IR 指令数
+    VRegs,            // 虚拟寄存器数（maxVregId + 1 之和）
+    Intervals,        // 活跃区间数
+    Spills,           // 溢出到栈的虚拟寄存器数
+    MachineInsts,     // 生成的机器指令数（栈帧展开与窥孔优化之后）
+    CacheHits,        // 增量编译缓存命中
+    CacheMisses,      // 增量编译缓存未命中
+    Promoted,         // mem2reg 提升为 SSA 值的 alloca 数
+    SpillCost,        // 被溢出区间的权重之和（def/use 次数 × 10^循环深度）
+    SplitPieces,      // 活跃区间分裂产生的片段数
+    CallSaveRestores, // 调用点保存 / 恢复调用者保存寄存器的 sw / lw 条数
+    CoalescedMoves,   // 图着色分配合并掉的拷贝数
+    PropagatedCopies, // 拷贝传播删除的拷贝数
+    FoldedConstants,  // SCCP 折叠的指令与条件分支数
+    GVNEliminated,    // GVN 删除的冗余指令数
+    DeadInsts,        // DCE / DSE 删除的指令数
+    RemovedBlocks,    // CFG 化简删除的基本块数
+    HoistedInsts,     // LICM 外提到前置块的指令数
+    ReducedMuls,      // 强度削减替换为加法递推的乘法数
+    InlinedCalls,     // 被内联的调用点数
+    TailRecursions,   // 改写为循环的自递归调用数
+    TailCalls,        // 撤销栈帧后跳转的尾调用数
+    PeepholeRemoved,  // 窥孔优化与块布局删除的机器指令数
+    FusedCompares,    // 融合进条件分支、不再落到寄存器的比较数
+    StallsRemoved,    // 指令调度按延迟模型消除的流水线停顿周期数
+    CompressedInsts,  // 以 16 位压缩形式输出的指令数（--march=rv32imc）
+    TextBytes,        // 目标文件 .text 字节数（-c）
+    FramelessLeaves,  // 没有栈帧的叶函数数（不调整 sp、不保存 ra）
+    ShrinkWrapped,    // prologue 移出入口块（或整个省去）的函数数
+    StackSlotsShared, // 栈槽着色省下的栈槽数（溢出槽与 alloca）
+    Rematerialized,   // 改为重物化（use 处 li 常量）、不再占用栈槽的溢出值数
+    VectorizedLoops,  // 交给 RVV 向量内核执行的循环数（--march=rv32imv）
+    Count,
+};
+
+namespace detail {
+extern std::atomic<bool> enabled;
+void recordPhase(Phase phase, std::chrono::steady_clock::duration elapsed);
+void addCounter(Counter counter, uint64_t n);
+} // namespace detail
+
+// enabled：是否正在收集统计
+inline bool enabled() { return detail::enabled.load(std::memory_order_relaxed); }
+
+// enable：开启收集并清零已有数据（应在启动工作线程之前调用），同时记下墙钟起点
+void enable();
+
+// add：累加计数器（关闭时为空操作）
+inline void add(Counter counter, uint64_t n = 1) {
+    if (enabled())
+        detail::addCounter(counter, n);
+}
+
+// ScopedTimer：把所在作用域的耗时累计到 phase（构造时未开启统计则整个对象不做任何事）
+class ScopedTimer {
+  public:
+    explicit ScopedTimer(Phase phase) : phase_(phase), active_(enabled()) {
+        if (active_)
+            start_ = std::chrono::steady_clock::now();
+    }
+    ~ScopedTimer() {
+        if (active_)
+            detail::recordPhase(phase_, std::chrono::steady_clock::now() - start_);
+    }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+  private:
+    Phase phase_;
+    bool active_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// counter：计数器当前值
+uint64_t counter(Counter c);
+
+// reportTimes：阶段耗时表（时间 / 占比 / 调用次数 / 峰值 RSS）
+void reportTimes(std::ostream &os);
+// reportCounters：计数器表
+void reportCounters(std::ostream &os);
+// reportJson：阶段与计数器的 JSON 对象
+void reportJson(std::ostream &os);
+
+} // namespace stats
+} // namespace toyc
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace toyc {
+
+// StringInterner：字符串驻留表，把重复出现的标签名/类型名/函数名映射为 32 位句柄
+// 句柄 0 固定表示空串；字符串存放在 deque 中，插入后地址不变，
+// 因此 str() 返回的引用在驻留表生命周期内始终有效。
+// 读写均加锁（读为共享锁），可被多个编译线程同时使用
+class StringInterner {
+  public:
+    StringInterner() {
+        strings_.emplace_back();
+        index_.emplace(std::string_view(strings_.front()), 0);
+    }
+    StringInterner(const StringInterner &) = delete;
+    StringInterner &operator=(const StringInterner &) = delete;
+
+    // intern：返回字符串对应的句柄，首次出现时插入
+    uint32_t intern(std::string_view s) {
+        {
+            std::shared_lock lock(mu_);
+            auto it = index_.find(s);
+            if (it != index_.end())
+                return it->second;
+        }
+        std::unique_lock lock(mu_);
+        auto it = index_.find(s); // 双重检查：加写锁期间可能已被其他线程插入
+        if (it != index_.end())
+            return it->second;
+        auto id = static_cast<uint32_t>(strings_.size());
+        strings_.emplace_back(s);
+        index_.emplace(std::string_view(strings_.back()), id);
+        return id;
+    }
+
+    // str：返回句柄对应的字符串
+    const std::string &str(uint32_t id) const {
+        std::shared_lock lock(mu_);
+        return strings_[id];
+    }
+
+    // size：已驻留的字符串个数（含空串）
+    size_t size() const {
+        std::shared_lock lock(mu_);
+        return strings_.size();
+    }
+
+    // global：进程级驻留表，保证不同模块/线程得到的句柄可以直接比较
+    static StringInterner &global() {
+        static StringInterner instance;
+        return instance;
+    }
+
+  private:
+    mutable std::shared_mutex mu_;
+    std::deque<std::string> strings_;                       // 句柄 → 字符串（地址稳定）
+    std::unordered_map<std::string_view, uint32_t> index_; // 字符串 → 句柄（视图指向 strings_）
+};
+
+} // namespace toyc
@@ -0,0 +1,102 @@
+#pragma once
+#include "ir.h"
+#include <cstdint>
+#include <vector>
+
+namespace toyc {
+
+// ScopedSymbolTable：IRBuilder 的块作用域符号表
+// 变量以 Parser 驻留标识符时分配的编号（AST 中的 sym）为下标：heads_[sym] 是该名字当前可见的
+// 绑定，每个绑定记下被它隐藏的上一个同名绑定，构成逐符号的隐藏链，查找只是一次数组访问。
+// 绑定按声明顺序压栈，作用域只记录进入时的栈高；退出时弹出本层绑定并沿隐藏链恢复外层绑定，
+// 代价与本层声明的变量数成正比，与外层变量数和嵌套深度无关。
+// 每个绑定还缓存最近一次 load 的结果寄存器；"全部失效"只递增纪元号，不逐个清除
+class ScopedSymbolTable {
+  public:
+    static constexpr int kNone = -1; // 名字未声明
+
+    // reset：清空全部绑定与作用域（每个函数开始时调用，保留已分配的容量）
+    void reset() {
+        heads_.clear();
+        bindings_.clear();
+        scopes_.clear();
+        loadLog_.clear();
+        ++epoch_;
+    }
+
+    // -------- 作用域 --------
+
+    void enterScope() { scopes_.push_back(bindings_.size()); }
+    void exitScope() {
+        if (scopes_.empty())
+            return;
+        for (size_t mark = scopes_.back(); bindings_.size() > mark; bindings_.pop_back())
+            heads_[bindings_.back().sym] = bindings_.back().shadowed;
+        scopes_.pop_back();
+    }
+    size_t depth() const { return scopes_.size(); }
+
+    // declare：在当前作用域声明 sym（变量地址为 slot），返回新绑定的编号
+    // 同一作用域内重复声明时新绑定同样隐藏旧绑定，退出作用域时一并弹出
+    int declare(uint32_t sym, ir::Operand slot) {
+        if (sym >= heads_.size())
+            heads_.resize(sym + 1, kNone);
+        int binding = static_cast<int>(bindings_.size());
+        bindings_.push_back({slot, ir::Operand::none(), heads_[sym], sym, 0});
+        heads_[sym] = binding;
+        return binding;
+    }
+
+    // lookup：sym 当前可见的绑定编号（未声明时为 kNone）
+    int lookup(uint32_t sym) const { return sym < heads_.size() ? heads_[sym] : kNone; }
+    // slot：绑定的变量地址（alloca 结果寄存器）
+    ir::Operand slot(int binding) const { return bindings_[binding].slot; }
+
+    // -------- 已加载值缓存 --------
+
+    // loaded：绑定在当前纪元内缓存的 load 结果（没有时为 none）
+    ir::Operand loaded(int binding) const {
+        const Binding &b = bindings_[binding];
+        return b.epoch == epoch_ ? b.loaded : ir::Operand::none();
+    }
+    void setLoaded(int binding, ir::Operand value) {
+        Binding &b = bindings_[binding];
+        b.loaded = value;
+        b.epoch = epoch_;
+        loadLog_.push_back(binding);
+    }
+    // forgetLoaded：变量被赋值后使其缓存失效
+    void forgetLoaded(int binding) { bindings_[binding].loaded = ir::Operand::none(); }
+    // forgetAllLoaded：进入分支或循环前使全部缓存失效（O(1)）
+    void forgetAllLoaded() {
+        ++epoch_;
+        loadLog_.clear();
+    }
+
+    // loadMark / rollbackLoads：撤销 mark 之后新建立的缓存
+    // 用于短路求值：rhs 块中的 load 不支配汇合块，而表达式不写变量、不声明变量，
+    // 进入 rhs 之前的缓存在汇合块仍然有效
+    size_t loadMark() const { return loadLog_.size(); }
+    void rollbackLoads(size_t mark) {
+        for (size_t i = mark; i < loadLog_.size(); ++i)
+            bindings_[loadLog_[i]].loaded = ir::Operand::none();
+        loadLog_.resize(mark);
+    }
+
+  private:
+    struct Binding {
+        ir::Operand slot;   // 变量地址
+        ir::Operand loaded; // 缓存的 load 结果（epoch 不是当前纪元时无效）
+        int shadowed;       // 被本绑定隐藏的同名绑定（没有时为 kNone）
+        uint32_t sym;       // 变量名的驻留编号
+        uint32_t epoch;     // loaded 写入时的纪元号
+    };
+
+    std::vector<int> heads_;        // 驻留编号 → 当前可见的绑定
+    std::vector<Binding> bindings_; // 按声明顺序的绑定栈
+    std::vector<size_t> scopes_;    // 每层作用域进入时的绑定栈高度
+    std::vector<int> loadLog_;      // 本纪元内依次建立缓存的绑定（供 rollbackLoads 撤销）
+    uint32_t epoch_ = 1;
+};
+
+} // namespace toyc
@@ -0,0 +1,17 @@
+#pragma once
+#include <memory_resource>
+
+namespace toyc {
+
+// threadArena：当前线程专属的内存池（不加锁）
+// 用作函数级临时结构（如 LiveIntervalTable 的单调内存池）的上游资源：
+// 临时结构析构后归还的内存块留在本线程池中，供同一线程处理下一个函数/翻译单元时直接复用，
+// 批量编译时各工作线程互不争用全局堆。
+// 从其中分配的对象必须在同一线程上释放，且不能比线程活得更久
+inline std::pmr::memory_resource *threadArena() {
+    thread_local std::pmr::unsynchronized_pool_resource pool(
+        std::pmr::pool_options{0, 1u << 20});
+    return &pool;
+}
+
+} // namespace toyc
@@ -0,0 +1,140 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace toyc {
+
+// ThreadPool：固定大小的工作窃取（work-stealing）线程池
+// 每个工作线程拥有一个双端队列：工作线程内提交的任务压入自己队列的尾部并从尾部取出（LIFO，
+// 子任务紧跟父任务执行、缓存友好），空闲线程从其他队列的头部窃取最早的任务；
+// 外部线程提交的任务轮流分配到各队列。任务本身负责捕获异常。
+// 等待子任务的任务应在等待期间调用 tryRunPendingTask 帮忙执行，避免所有线程同时阻塞。
+// 析构时先执行完所有队列中剩余的任务，再回收所有线程
+class ThreadPool {
+  public:
+    explicit ThreadPool(unsigned numThreads) : numThreads_(std::max(1u, numThreads)) {
+        for (unsigned i = 0; i < numThreads_; ++i)
+            queues_.push_back(std::make_unique<WorkQueue>());
+        workers_.reserve(numThreads_);
+        for (unsigned i = 0; i < numThreads_; ++i)
+            workers_.emplace_back([this, i] { workerLoop(i); });
+    }
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock(sleepMu_);
+            stopping_ = true;
+        }
+        sleepCv_.notify_all();
+        for (auto &t : workers_)
+            t.join();
+    }
+
+    // submit：提交一个任务（工作线程内提交 → 本线程队列尾部；外部提交 → 轮流分配）
+    void submit(std::function<void()> task) {
+        unsigned q = currentPool_ == this
+                         ? currentIndex_
+                         : nextQueue_.fetch_add(1, std::memory_order_relaxed) % size();
+        pending_.fetch_add(1, std::memory_order_release); // 先计数再入队，计数不会被减成负数
+        {
+            std::lock_guard lock(queues_[q]->mu);
+            queues_[q]->tasks.push_back(std::move(task));
+        }
+        { std::lock_guard lock(sleepMu_); } // 与 workerLoop 的等待谓词同步，防止丢失唤醒
+        sleepCv_.notify_one();
+    }
+
+    // tryRunPendingTask：在调用线程上取出并执行一个待执行任务；没有任务时返回 false
+    bool tryRunPendingTask() {
+        std::function<void()> task;
+        if (!popTask(currentPool_ == this ? currentIndex_ : size(), task))
+            return false;
+        task();
+        return true;
+    }
+
+    // size：工作线程数
+    unsigned size() const { return numThreads_; }
+
+    // hardwareThreads：可用硬件线程数（无法探测时返回 1）
+    static unsigned hardwareThreads() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+  private:
+    // WorkQueue：单个工作线程的任务双端队列
+    struct WorkQueue {
+        std::mutex mu;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    const unsigned numThreads_;                      // 工作线程数（构造后不变）
+    std::vector<std::unique_ptr<WorkQueue>> queues_; // 下标与工作线程一致
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> pending_{0};     // 已提交但尚未被取出的任务数
+    std::atomic<unsigned> nextQueue_{0}; // 外部提交的轮转下标
+    std::mutex sleepMu_;
+    std::condition_variable sleepCv_;
+    bool stopping_ = false;
+
+    // 当前线程所属的线程池与工作线程下标（外部线程为 nullptr）
+    static inline thread_local ThreadPool *currentPool_ = nullptr;
+    static inline thread_local unsigned currentIndex_ = 0;
+
+    // popTask：先从自己队列尾部取任务，否则依次从其他队列头部窃取（self == size() 表示外部线程）
+    bool popTask(unsigned self, std::function<void()> &task) {
+        const unsigned n = size();
+        if (self < n) {
+            auto &own = *queues_[self];
+            std::lock_guard lock(own.mu);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        for (unsigned k = 1; k <= n; ++k) {
+            unsigned victim = (self + k) % n;
+            if (victim == self)
+                continue;
+            auto &q = *queues_[victim];
+            std::lock_guard lock(q.mu);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // workerLoop：循环取任务执行；无任务时休眠，直到收到停止信号且所有队列为空
+    void workerLoop(unsigned index) {
+        currentPool_ = this;
+        currentIndex_ = index;
+        for (;;) {
+            std::function<void()> task;
+            if (popTask(index, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock lock(sleepMu_);
+            sleepCv_.wait(lock, [this] {
+                return stopping_ || pending_.load(std::memory_order_acquire) > 0;
+            });
+            if (stopping_ && pending_.load(std::memory_order_acquire) == 0)
+                return;
+        }
+    }
+};
+
+} // namespace toyc
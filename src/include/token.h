@@ -1,5 +1,5 @@
 #pragma once
-#include <string>
+#include <string_view>
 
 // TokenType 枚举：表示词法分析器输出的各种符号类型
 enum class TokenType {
@@ -54,8 +54,9 @@ enum class TokenType {
 };
 
 // Token 结构体：表示词法单元
+// lexeme 直接引用源码缓冲区（不拥有内存），源码须比 Token 活得更久
 struct Token {
-    TokenType type;     // Token 类型
-    std::string lexeme; // 原始文本内容
-    int line;           // 所在行号，用于错误定位
+    TokenType type;          // Token 类型
+    std::string_view lexeme; // 原始文本内容（指向源码的切片，END 为空）
+    int line;                // 所在行号，用于错误定位
 };
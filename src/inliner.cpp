@@ -0,0 +1,319 @@
+#include "ir_analysis.h"
+#include "ir_passes.h"
+#include "statistics.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+namespace {
+
+// 一次调用省下的指令数（近似）：call 本身、返回值的搬运、被调者栈帧的建立与撤销；
+// 每个实参另外省下一次参数寄存器的搬运
+constexpr int kCallOverhead = 4;
+// 循环深度每加一层，调用点的内联阈值翻倍，最多按 2 层计算
+constexpr int kMaxFrequencyShift = 2;
+// 调用者内联后的指令数上限，防止链式内联使单个函数无限膨胀
+constexpr size_t kMaxCallerSize = 4000;
+
+// profileShift：有剖析数据时调用点的阈值倍数（2 的幂次）：调用点每次调用者执行时平均执行
+// ratio = 调用点计数 / 调用者入口计数 次，ratio 每多一个数量级加一（与静态估计中
+// "每层循环约 10 次迭代"一致），最多 kMaxFrequencyShift
+int profileShift(int64_t siteCount, int64_t entryCount) {
+    int shift = 0;
+    for (int64_t bound = entryCount * 10; siteCount >= bound && shift < kMaxFrequencyShift;
+         bound *= 10)
+        ++shift;
+    return shift;
+}
+
+// functionSize：函数的指令条数（内联代价的度量）
+size_t functionSize(const Function &F) {
+    size_t n = 0;
+    for (auto &bb : F.blocks)
+        n += bb->insts.size();
+    return n;
+}
+
+// isInlinable：被调函数的每个块都以终结指令结束，且至少有一条 ret（不返回的函数不内联）
+bool isInlinable(const Function &F) {
+    bool returns = false;
+    for (auto &bb : F.blocks) {
+        if (bb->insts.empty() || !bb->insts.back()->isTerminator())
+            return false;
+        Opcode op = bb->insts.back()->opcode;
+        returns |= op == Opcode::Ret || op == Opcode::RetVoid;
+    }
+    return returns;
+}
+
+// Inliner：把单个调用者中合算的调用点替换为被调函数体
+class Inliner {
+  public:
+    Inliner(Function &caller, const CallGraph &CG, int limit)
+        : F_(caller), CG_(CG), limit_(limit) {}
+
+    int run();
+
+  private:
+    Function &F_;
+    const CallGraph &CG_;
+    int limit_;
+    int serial_ = 0;                           // 本函数中已内联的调用点数（用于生成块名）
+    std::unordered_map<int, Operand> replace_; // 调用结果 vreg → 返回值（最后统一替换）
+    std::vector<Instruction *> allocas_;       // 被内联函数的 alloca（最后统一移到入口块）
+    std::vector<std::vector<int>> placeAfter_; // 块 id → 紧随其后放置的新块 id
+
+    void inlineCall(Instruction *call, const Function &callee, int64_t siteCount);
+    void finish();
+    std::string uniqueName(std::string name) const {
+        while (F_.blockMap.count(name))
+            name += "_";
+        return name;
+    }
+    BasicBlock *appendBlock(const std::string &name, int after);
+};
+
+/**
+ * @brief 按代价模型内联调用点
+ * @details 候选：被调函数在模块中有定义、不与调用者在同一个强连通分量中、自身不递归。
+ *   代价 = 被调函数的指令数 − (实参个数 + kCallOverhead)，即内联后净增的指令数；
+ *   调用点所在的循环越深执行得越频繁，阈值 limit 按循环深度翻倍（最多 4 倍）。
+ *   代价不超过阈值、且调用者不超过 kMaxCallerSize 时内联。
+ *   调用者有剖析数据（入口块的 profileCount > 0，见 ProfileData）时以实测频率代替循环深度：
+ *   所在块从未执行的调用点是冷的，不内联（只增加代码）；计数已知的调用点按 profileShift 放大阈值，
+ *   计数未知时退回循环深度。入口计数为 0 的函数不据此判断——插桩构建里它可能已被内联到
+ *   各调用者中，独立的函数体从未执行并不说明它的调用点是冷的
+ *   循环深度在改写之前一次算好（内联只增加新块，不改变原有块的循环嵌套）
+ */
+int Inliner::run() {
+    F_.buildCFG();
+    const int64_t entryCount = F_.entryBlock()->profileCount;
+    const LoopInfo &LI = F_.analyses().loops();
+    struct Site {
+        Instruction *call;
+        int depth;     // 循环深度
+        int64_t count; // 所在块的执行次数（-1 表示未知）
+    };
+    std::vector<Site> sites;
+    for (auto &bb : F_.blocks)
+        for (Instruction *I : bb->insts)
+            if (I->opcode == Opcode::Call)
+                sites.push_back({I, LI.loopDepth(bb.get()), bb->profileCount});
+
+    placeAfter_.assign(F_.blocks.size(), {});
+    size_t callerSize = functionSize(F_);
+    int inlined = 0;
+    for (const Site &site : sites) {
+        Instruction *call = site.call;
+        const Function *callee = CG_.function(call->callee);
+        if (!callee || CG_.sameSCC(&F_, callee) || CG_.isRecursive(callee) ||
+            callee->params.size() != call->ops.size() || !isInlinable(*callee))
+            continue;
+        if (entryCount > 0 && site.count == 0)
+            continue;
+        const size_t size = functionSize(*callee);
+        const long cost =
+            static_cast<long>(size) - static_cast<long>(call->ops.size()) - kCallOverhead;
+        const int shift = entryCount > 0 && site.count > 0
+                              ? profileShift(site.count, entryCount)
+                              : std::min(site.depth, kMaxFrequencyShift);
+        const long threshold = static_cast<long>(limit_) << shift;
+        if (cost > threshold || callerSize + size > kMaxCallerSize)
+            continue;
+        inlineCall(call, *callee, site.count);
+        callerSize += size;
+        ++inlined;
+    }
+    if (inlined > 0)
+        finish();
+    return inlined;
+}
+
+// appendBlock：在 F.blocks 末尾追加新块（id 即下标），最终位置记为紧随块 after 之后
+BasicBlock *Inliner::appendBlock(const std::string &name, int after) {
+    auto bb = std::make_unique<BasicBlock>();
+    bb->name = uniqueName(name);
+    bb->id = static_cast<int>(F_.blocks.size());
+    F_.blockMap[bb->name] = bb.get();
+    placeAfter_[after].push_back(bb->id);
+    placeAfter_.emplace_back();
+    F_.blocks.push_back(std::move(bb));
+    return F_.blocks.back().get();
+}
+
+/**
+ * @brief 把一次调用替换为被调函数体
+ * @details 1. 调用所在块 B 在调用处一分为二：调用之后的指令移到新块 <callee>_<n>_cont，
+ *      cont 的后继中来自 B 的 phi 入口改记为 cont。B 顺序落入后继（或落出函数末尾）时先补上
+ *      显式的终结指令：B 只在未被拆分过时没有终结指令，此时它的 CFG 后继仍是 run 开始时建立的
+ *   2. 被调函数的块复制为 <callee>_<n>_<label>：vreg 整体平移到调用者的编号之后，
+ *      形参直接替换为实参，alloca 留待移到调用者的入口块
+ *   3. ret 改为 br cont；只有一个返回值时调用结果记入替换表，多个时在 cont 块首用 phi 合并
+ *   4. B 以 br 跳到复制的入口块
+ *   新块先追加在 F.blocks 末尾，调用结果的替换、块的排列与 CFG 的重建由 finish 一次完成，
+ *   每次内联的开销只与被调函数和被拆分的块成正比。
+ *   剖析计数：复制块取被调块的计数按 调用点计数 / 被调函数入口计数 缩放，cont 与 B 相同
+ */
+void Inliner::inlineCall(Instruction *call, const Function &callee, int64_t siteCount) {
+    BasicBlock *B = F_.blocks[call->blockId].get();
+    const std::string prefix = callee.name + "_" + std::to_string(serial_++) + "_";
+
+    const int base = F_.maxVregId + 1;
+    F_.maxVregId += callee.maxVregId + 1;
+    std::unordered_map<int, Operand> args; // 形参 vreg → 实参
+    for (size_t k = 0; k < callee.paramVregs.size(); ++k)
+        args.emplace(callee.paramVregs[k], call->ops[k]);
+    std::unordered_map<uint32_t, Symbol> labels; // 被调函数的块名（句柄）→ 复制块名
+    std::vector<BasicBlock *> created;
+    const int64_t calleeCount = callee.entryBlock()->profileCount;
+    for (auto &cb : callee.blocks) {
+        BasicBlock *bb = appendBlock(prefix + cb->name, B->id);
+        labels.emplace(Symbol(cb->name).id(), Symbol(bb->name));
+        if (siteCount >= 0 && calleeCount > 0 && cb->profileCount >= 0)
+            bb->profileCount = static_cast<int64_t>(static_cast<double>(cb->profileCount) *
+                                                    siteCount / calleeCount);
+        created.push_back(bb);
+    }
+    BasicBlock *cont = appendBlock(prefix + "cont", B->id);
+    cont->profileCount = B->profileCount;
+    const Symbol contName(cont->name);
+
+    auto remap = [&](Operand op) {
+        if (op.isVReg()) {
+            auto it = args.find(op.regId());
+            return it != args.end() ? it->second : Operand::vreg(op.regId() + base);
+        }
+        if (op.isLabel())
+            return Operand::label(labels.at(op.labelSym().id()));
+        return op;
+    };
+    std::vector<std::pair<Operand, Symbol>> returns; // (返回值, 所在的复制块)
+    for (size_t i = 0; i < callee.blocks.size(); ++i) {
+        BasicBlock *bb = created[i];
+        for (const Instruction *I : callee.blocks[i]->insts) {
+            Instruction *clone;
+            if (I->opcode == Opcode::Ret || I->opcode == Opcode::RetVoid) {
+                if (I->opcode == Opcode::Ret)
+                    returns.emplace_back(remap(I->ops[0]), Symbol(bb->name));
+                clone = F_.newInst(Instruction::makeBr(Operand::label(contName)));
+            } else {
+                Instruction copy = *I;
+                if (copy.def.isVReg())
+                    copy.def = Operand::vreg(copy.def.regId() + base);
+                for (Operand &op : copy.ops)
+                    op = remap(op);
+                clone = F_.newInst(std::move(copy));
+            }
+            clone->blockId = bb->id;
+            (I->opcode == Opcode::Alloca ? allocas_ : bb->insts).push_back(clone);
+        }
+    }
+
+    // 拆分调用所在块：调用之后的指令（含终结指令）移到 cont。B 没有终结指令时先补上：
+    // 顺序落入的后继改为显式 br，落出函数末尾的改为与 IRBuilder 默认返回相同的 ret
+    if (!B->insts.back()->isTerminator()) {
+        Instruction term = !B->succs.empty()
+                               ? Instruction::makeBr(Operand::label(Symbol(B->succs[0]->name)))
+                           : F_.returnType == "void" ? Instruction::makeRetVoid()
+                                                     : Instruction::makeRet("i32", Operand::imm(0));
+        Instruction *explicitTerm = F_.newInst(std::move(term));
+        explicitTerm->blockId = B->id;
+        B->insts.push_back(explicitTerm);
+    }
+    auto pos = std::find(B->insts.begin(), B->insts.end(), call);
+    cont->insts.assign(pos + 1, B->insts.end());
+    B->insts.erase(pos, B->insts.end());
+    for (Instruction *I : cont->insts)
+        I->blockId = cont->id;
+    const Symbol calleeEntry = labels.at(Symbol(callee.entryBlock()->name).id());
+    Instruction *br = F_.newInst(Instruction::makeBr(Operand::label(calleeEntry)));
+    br->blockId = B->id;
+    B->insts.push_back(br);
+    const Symbol bName(B->name);
+    for (const Operand &target : cont->insts.back()->ops) {
+        if (!target.isLabel())
+            continue;
+        for (Instruction *I : F_.blockMap.at(target.labelSym())->insts) {
+            if (I->opcode != Opcode::Phi)
+                break;
+            for (size_t k = 0; k < I->numIncoming(); ++k)
+                if (I->incomingBlock(k) == bName)
+                    I->ops[2 * k + 1] = Operand::label(contName);
+        }
+    }
+
+    // 调用结果
+    if (int d = call->defReg(); d >= 0) {
+        if (returns.size() == 1) {
+            replace_[d] = returns[0].first;
+        } else {
+            Instruction phi = Instruction::makePhi(Operand::vreg(d), call->type);
+            for (const auto &[value, from] : returns)
+                phi.addIncoming(value, from);
+            Instruction *merged = F_.newInst(std::move(phi));
+            merged->blockId = cont->id;
+            cont->insts.insert(cont->insts.begin(), merged);
+        }
+    }
+}
+
+/**
+ * @brief 收尾：替换调用结果，alloca 移到入口块，新块排到各自的调用点之后，重新编号并重建 CFG
+ * @details 替换沿链解析（实参可能是前一次内联的调用结果）；
+ *   块按原顺序输出，每个块之后依次输出紧随其后的新块（新块自身也可能被再次拆分，按同样规则展开）
+ */
+void Inliner::finish() {
+    for (auto &bb : F_.blocks)
+        for (Instruction *I : bb->insts)
+            for (Operand &op : I->ops)
+                while (op.isVReg()) {
+                    auto it = replace_.find(op.regId());
+                    if (it == replace_.end())
+                        break;
+                    op = it->second;
+                }
+    BasicBlock *entry = F_.entryBlock();
+    entry->insts.insert(entry->insts.begin(), allocas_.begin(), allocas_.end());
+
+    std::vector<std::unique_ptr<BasicBlock>> old = std::move(F_.blocks);
+    F_.blocks.clear();
+    std::vector<int> stack;
+    for (size_t root = 0; root < old.size(); ++root) {
+        if (!old[root])
+            continue; // 新块已随其调用点输出
+        stack.push_back(static_cast<int>(root));
+        while (!stack.empty()) {
+            int id = stack.back();
+            stack.pop_back();
+            F_.blocks.push_back(std::move(old[id]));
+            const std::vector<int> &next = placeAfter_[id];
+            stack.insert(stack.end(), next.rbegin(), next.rend());
+        }
+    }
+    for (size_t i = 0; i < F_.blocks.size(); ++i) {
+        BasicBlock *bb = F_.blocks[i].get();
+        bb->id = static_cast<int>(i);
+        for (Instruction *I : bb->insts)
+            I->blockId = bb->id;
+    }
+    F_.buildCFG();
+}
+
+} // namespace
+
+// inlineCalls：对单个调用者执行内联
+int inlineCalls(Function &F, const CallGraph &CG, int limit) {
+    if (limit <= 0 || F.blocks.empty())
+        return 0;
+    stats::ScopedTimer timer(stats::Phase::Optimize);
+    int inlined = Inliner(F, CG, limit).run();
+    stats::add(stats::Counter::InlinedCalls, static_cast<uint64_t>(inlined));
+    return inlined;
+}
+
+} // namespace opt
+} // namespace toyc
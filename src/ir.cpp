@@ -40,6 +40,10 @@ std::string opcodeToString(Opcode op) {
         return "ret";
     case Opcode::Call:
         return "call";
+    case Opcode::Phi:
+        return "phi";
+    case Opcode::Copy:
+        return "copy";
     }
     return "unknown";
 }
@@ -108,7 +112,7 @@ std::string Operand::toString() const {
     case Kind::Imm:
         return std::to_string(value_);
     case Kind::Label:
-        return "%" + label_;
+        return "%" + labelName();
     case Kind::BoolLit:
         return value_ ? "true" : "false";
     }
@@ -217,66 +221,34 @@ Instruction Instruction::makeCall(Operand def, const std::string &retType,
     return i;
 }
 
+// makePhi：创建没有入口的 phi 指令 %def = phi type（入口由 addIncoming 追加）
+Instruction Instruction::makePhi(Operand def, const std::string &type) {
+    Instruction i;
+    i.opcode = Opcode::Phi;
+    i.def = def;
+    i.type = type;
+    return i;
+}
+
+// makeCopy：创建寄存器拷贝指令 %def = copy type value
+Instruction Instruction::makeCopy(Operand def, const std::string &type, Operand value) {
+    Instruction i;
+    i.opcode = Opcode::Copy;
+    i.def = def;
+    i.type = type;
+    i.ops = {value};
+    return i;
+}
+
 // ======================== Instruction 查询方法 ========================
 
 // defReg：返回指令定义（写入）的虚拟寄存器 ID，若无定义返回 -1
 int Instruction::defReg() const { return def.isVReg() ? def.regId() : -1; }
 
-// useRegs：返回指令使用（读取）的所有虚拟寄存器 ID 列表
-// 不同 opcode 的使用寄存器位置不同，需逐类型处理
-std::vector<int> Instruction::useRegs() const {
-    std::vector<int> result;
-    switch (opcode) {
-    case Opcode::Alloca:
-        // alloca 无 use
-        break;
-    case Opcode::Load:
-        // ops[0] = ptr (VReg)
-        if (ops.size() > 0 && ops[0].isVReg())
-            result.push_back(ops[0].regId());
-        break;
-    case Opcode::Store:
-        // ops[0] = value, ops[1] = ptr，两个操作数都可能是寄存器
-        for (auto &op : ops)
-            if (op.isVReg())
-                result.push_back(op.regId());
-        break;
-    case Opcode::Add:
-    case Opcode::Sub:
-    case Opcode::Mul:
-    case Opcode::SDiv:
-    case Opcode::SRem:
-        // 算术运算：ops[0] = lhs, ops[1] = rhs
-        for (auto &op : ops)
-            if (op.isVReg())
-                result.push_back(op.regId());
-        break;
-    case Opcode::ICmp:
-        for (auto &op : ops)
-            if (op.isVReg())
-                result.push_back(op.regId());
-        break;
-    case Opcode::CondBr:
-        // 条件分支：ops[0] = 条件寄存器，ops[1,2] = 目标标签
-        if (ops.size() > 0 && ops[0].isVReg())
-            result.push_back(ops[0].regId());
-        break;
-    case Opcode::Br:
-        // 无条件跳转无寄存器使用
-        break;
-    case Opcode::Ret:
-        if (ops.size() > 0 && ops[0].isVReg())
-            result.push_back(ops[0].regId());
-        break;
-    case Opcode::RetVoid:
-        break;
-    case Opcode::Call:
-        // 函数调用：ops 中所有操作数为实参
-        for (auto &op : ops)
-            if (op.isVReg())
-                result.push_back(op.regId());
-        break;
-    }
+// useRegs：返回指令使用（读取）的所有虚拟寄存器 ID 列表（逐类型的操作数位置见 forEachUse）
+RegList Instruction::useRegs() const {
+    RegList result;
+    forEachUse([&](int u) { result.push_back(u); });
     return result;
 }
 
@@ -322,15 +294,15 @@ std::string Instruction::toString() const {
     std::string s;
     switch (opcode) {
     case Opcode::Alloca:
-        s = def.toString() + " = alloca " + type + ", align " + std::to_string(align);
+        s = def.toString() + " = alloca " + type.str() + ", align " + std::to_string(align);
         break;
     case Opcode::Load:
-        s = def.toString() + " = load " + type + ", ptr " + ops[0].toString() + ", align " +
+        s = def.toString() + " = load " + type.str() + ", ptr " + ops[0].toString() + ", align " +
             std::to_string(align);
         break;
     case Opcode::Store: {
         std::string valStr = ops[0].toString();
-        s = "store " + type + " " + valStr + ", ptr " + ops[1].toString() + ", align " +
+        s = "store " + type.str() + " " + valStr + ", ptr " + ops[1].toString() + ", align " +
             std::to_string(align);
         break;
     }
@@ -339,11 +311,11 @@ std::string Instruction::toString() const {
     case Opcode::Mul:
     case Opcode::SDiv:
     case Opcode::SRem:
-        s = def.toString() + " = " + opcodeToString(opcode) + (nsw ? " nsw" : "") + " " + type +
-            " " + ops[0].toString() + ", " + ops[1].toString();
+        s = def.toString() + " = " + opcodeToString(opcode) + (nsw ? " nsw" : "") + " " +
+            type.str() + " " + ops[0].toString() + ", " + ops[1].toString();
         break;
     case Opcode::ICmp:
-        s = def.toString() + " = icmp " + cmpPredToString(cmpPred) + " " + type + " " +
+        s = def.toString() + " = icmp " + cmpPredToString(cmpPred) + " " + type.str() + " " +
             ops[0].toString() + ", " + ops[1].toString();
         break;
     case Opcode::Br:
@@ -354,13 +326,14 @@ std::string Instruction::toString() const {
             ops[2].toString();
         break;
     case Opcode::Ret:
-        s = "ret " + type + " " + ops[0].toString();
+        s = "ret " + type.str() + " " + ops[0].toString();
         break;
     case Opcode::RetVoid:
         s = "ret void";
         break;
     case Opcode::Call: {
-        s = def.toString() + " = call " + type + " @" + callee + "(";
+        s = def.toString() + (tail ? " = tail call " : " = call ") + type.str() + " @" +
+            callee.str() + "(";
         for (size_t j = 0; j < ops.size(); ++j) {
             if (j > 0)
                 s += ", ";
@@ -369,10 +342,46 @@ std::string Instruction::toString() const {
         s += ")";
         break;
     }
+    case Opcode::Phi:
+        s = def.toString() + " = phi " + type.str() + " ";
+        for (size_t k = 0; k < numIncoming(); ++k) {
+            if (k > 0)
+                s += ", ";
+            s += "[ " + incomingValue(k).toString() + ", " + ops[2 * k + 1].toString() + " ]";
+        }
+        break;
+    case Opcode::Copy:
+        s = def.toString() + " = copy " + type.str() + " " + ops[0].toString();
+        break;
     }
     return s;
 }
 
+// ======================== InstructionPool ========================
+
+// 析构函数：析构池中所有指令并释放 slab
+InstructionPool::~InstructionPool() {
+    size_t remaining = count_;
+    for (Instruction *slab : slabs_) {
+        size_t n = std::min(remaining, kSlabSize);
+        std::destroy_n(slab, n);
+        remaining -= n;
+        std::allocator<Instruction>().deallocate(slab, kSlabSize);
+    }
+}
+
+// create：在当前 slab 中构造指令，slab 用尽时申请新的 slab
+Instruction *InstructionPool::create(Instruction &&inst) {
+    if (used_ == kSlabSize) {
+        slabs_.push_back(std::allocator<Instruction>().allocate(kSlabSize));
+        used_ = 0;
+    }
+    Instruction *p = std::construct_at(slabs_.back() + used_, std::move(inst));
+    ++used_;
+    ++count_;
+    return p;
+}
+
 // ======================== BasicBlock ========================
 
 // firstPos：返回块内第一条指令的定义位置（用于活跃区间计算）
@@ -386,35 +395,87 @@ int BasicBlock::lastPos() const { return insts.empty() ? -1 : insts.back()->posU
 // entryBlock：返回函数入口基本块（即第一个基本块）
 BasicBlock *Function::entryBlock() const { return blocks.empty() ? nullptr : blocks[0].get(); }
 
-// buildCFG：根据分支指令构建控制流图（计算每个基本块的 succs 和 preds）
+// fillPreds：每条边 (b, s) 按 b 的顺序落入 s 的前驱区间，与逐边追加得到的顺序相同
+void CFG::fillPreds(size_t size) {
+    predBegin.assign(size + 1, 0);
+    for (uint32_t s : succ)
+        ++predBegin[s + 1];
+    for (size_t b = 0; b < size; ++b)
+        predBegin[b + 1] += predBegin[b];
+    pred.resize(succ.size());
+    std::vector<uint32_t> fill(predBegin.begin(), predBegin.end() - 1);
+    for (size_t b = 0; b < size; ++b)
+        for (uint32_t s : succs(b))
+            pred[fill[s]++] = static_cast<uint32_t>(b);
+}
+
+// buildCFG：根据分支指令构建控制流图
+// 终结指令的标签操作数各查一次 blockMap 解析为块号，无终结指令的块 fall-through 到下一个块；
+// 先写出 cfg 的 CSR 数组，再据此填充每个块的 succs / preds（供就地修改 CFG 的变换使用）。
+// 递增 cfgVersion，使 analyses() 中缓存的支配树 / 循环信息在下次请求时重新计算
 void Function::buildCFG() {
-    for (auto &block : blocks) {
-        block->succs.clear();
-        block->preds.clear();
-    }
-    for (auto &block : blocks) {
+    ++cfgVersion;
+    const size_t n = blocks.size();
+    cfg.succBegin.resize(n + 1);
+    cfg.succ.clear();
+    for (size_t b = 0; b < n; ++b) {
+        cfg.succBegin[b] = static_cast<uint32_t>(cfg.succ.size());
+        const BasicBlock *block = blocks[b].get();
         if (block->insts.empty())
             continue;
-        auto &lastInst = block->insts.back();
-        if (lastInst->isTerminator()) {
-            for (const auto &target : lastInst->branchTargets()) {
-                auto it = blockMap.find(target);
-                if (it != blockMap.end()) {
-                    block->succs.push_back(it->second);
-                    it->second->preds.push_back(block.get());
-                }
-            }
-        } else {
-            // 无终结指令时，fall-through 到下一个基本块
-            for (size_t idx = 0; idx < blocks.size(); ++idx) {
-                if (blocks[idx].get() == block.get() && idx + 1 < blocks.size()) {
-                    block->succs.push_back(blocks[idx + 1].get());
-                    blocks[idx + 1]->preds.push_back(block.get());
-                    break;
-                }
+        const Instruction *last = block->insts.back();
+        if (last->isTerminator()) {
+            // Br 的目标在 ops[0]，CondBr 的两个目标在 ops[1] / ops[2]（与 branchTargets 相同）
+            size_t first = last->opcode == Opcode::CondBr ? 1 : 0;
+            size_t end = last->opcode == Opcode::Br ? 1 : last->opcode == Opcode::CondBr ? 3 : 0;
+            for (size_t k = first; k < end && k < last->ops.size(); ++k) {
+                if (!last->ops[k].isLabel())
+                    continue;
+                auto it = blockMap.find(last->ops[k].labelName());
+                if (it != blockMap.end())
+                    cfg.succ.push_back(static_cast<uint32_t>(it->second->id));
             }
+        } else if (b + 1 < n) {
+            cfg.succ.push_back(static_cast<uint32_t>(b + 1)); // fall-through 到下一个基本块
         }
     }
+    cfg.succBegin[n] = static_cast<uint32_t>(cfg.succ.size());
+    cfg.fillPreds(n);
+
+    for (size_t b = 0; b < n; ++b) {
+        BasicBlock *block = blocks[b].get();
+        block->succs.clear();
+        block->preds.clear();
+        for (uint32_t s : cfg.succs(b))
+            block->succs.push_back(blocks[s].get());
+        for (uint32_t p : cfg.preds(b))
+            block->preds.push_back(blocks[p].get());
+    }
+}
+
+// clone：逐块复制指令（块 ID 与名称不变），随后按新块重建 blockMap 与 CFG
+std::unique_ptr<Function> Function::clone() const {
+    auto F = std::make_unique<Function>();
+    F->name = name;
+    F->returnType = returnType;
+    F->params = params;
+    F->paramVregs = paramVregs;
+    F->maxVregId = maxVregId;
+    F->vectorKernel = vectorKernel;
+    F->blocks.reserve(blocks.size());
+    for (const auto &bb : blocks) {
+        auto copy = std::make_unique<BasicBlock>();
+        copy->id = bb->id;
+        copy->name = bb->name;
+        copy->profileCount = bb->profileCount;
+        copy->insts.reserve(bb->insts.size());
+        for (const Instruction *inst : bb->insts)
+            copy->insts.push_back(F->newInst(Instruction(*inst)));
+        F->blockMap[copy->name] = copy.get();
+        F->blocks.push_back(std::move(copy));
+    }
+    F->buildCFG();
+    return F;
 }
 
 // toString：将函数序列化为 LLVM IR 文本（含函数签名、基本块、指令）
@@ -0,0 +1,467 @@
+#include "ir_analysis.h"
+#include <algorithm>
+#include <utility>
+
+namespace toyc {
+
+using namespace ir;
+
+// ======================== DominatorTree ========================
+
+DominatorTree::DominatorTree(const Function &F, bool reverse) {
+    const size_t n = F.blocks.size();
+    rpoIndex_.assign(n, -1);
+    idom_.assign(n, nullptr);
+    children_.resize(n);
+    frontier_.resize(n);
+    preNum_.assign(n, -1);
+    postNum_.assign(n, -1);
+    if (n == 0)
+        return;
+    if (reverse)
+        solve(F, reverseGraph(F), static_cast<int>(n));
+    else
+        solve(F, F.cfg, F.entryBlock()->id);
+}
+
+// reverseGraph：翻转紧凑 CFG，所有没有后继的块再挂到虚拟出口 n 下
+CFG DominatorTree::reverseGraph(const Function &F) {
+    const CFG &cfg = F.cfg;
+    const size_t n = cfg.size();
+    CFG G;
+    G.succBegin.reserve(n + 2);
+    G.succ.reserve(cfg.pred.size() + n);
+    for (size_t b = 0; b < n; ++b) {
+        G.succBegin.push_back(static_cast<uint32_t>(G.succ.size()));
+        G.succ.insert(G.succ.end(), cfg.preds(b).begin(), cfg.preds(b).end());
+    }
+    G.succBegin.push_back(static_cast<uint32_t>(G.succ.size()));
+    for (size_t b = 0; b < n; ++b)
+        if (cfg.succs(b).empty())
+            G.succ.push_back(static_cast<uint32_t>(b));
+    G.succBegin.push_back(static_cast<uint32_t>(G.succ.size()));
+    G.fillPreds(n + 1);
+    return G;
+}
+
+/**
+ * @brief 在整数图上求解支配树并转换回基本块
+ * @details 1. 显式栈 DFS 求逆后序
+ *   2. Cooper-Harvey-Kennedy：按逆后序反复取所有已处理前驱的 idom 链交点，直到不再变化；
+ *      逆后序下标越小越靠近根，intersect 沿 idom 链把较深的一方上移。对可归约 CFG 通常两轮即收敛
+ *   3. 支配树先序 / 后序编号（a 支配 b ⇔ b 的区间落在 a 的区间内）
+ *   4. 支配边界：从每个结点的各前驱沿 idom 链上行到该结点的 idom 为止，途经结点的 DF 都包含它
+ *   虚拟出口只参与求解，不出现在任何对外的结果中
+ */
+void DominatorTree::solve(const Function &F, const CFG &G, int root) {
+    const int n = static_cast<int>(F.blocks.size());
+    const size_t N = G.size();
+    auto blockOf = [&](int v) { return v < n ? F.blocks[v].get() : nullptr; };
+
+    // 1. 逆后序
+    std::vector<int> order, index(N, -1);
+    {
+        std::vector<char> visited(N, 0);
+        std::vector<std::pair<int, size_t>> stack; // (结点, 下一个待访问的后继下标)
+        visited[root] = 1;
+        stack.push_back({root, 0});
+        while (!stack.empty()) {
+            auto &[v, next] = stack.back();
+            if (next < G.succs(v).size()) {
+                int succ = static_cast<int>(G.succs(v)[next++]);
+                if (!visited[succ]) {
+                    visited[succ] = 1;
+                    stack.push_back({succ, 0});
+                }
+                continue;
+            }
+            order.push_back(v);
+            stack.pop_back();
+        }
+        std::reverse(order.begin(), order.end());
+        for (size_t i = 0; i < order.size(); ++i)
+            index[order[i]] = static_cast<int>(i);
+    }
+
+    // 2. 直接支配者（迭代期间根以自身为 idom）
+    std::vector<int> idom(N, -1);
+    idom[root] = root;
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (index[a] > index[b])
+                a = idom[a];
+            while (index[b] > index[a])
+                b = idom[b];
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < order.size(); ++i) {
+            int v = order[i];
+            int newIdom = -1;
+            for (int p : G.preds(v)) {
+                if (index[p] < 0 || idom[p] < 0)
+                    continue; // 不在树中或尚未处理
+                newIdom = newIdom < 0 ? p : intersect(p, newIdom);
+            }
+            if (newIdom >= 0 && idom[v] != newIdom) {
+                idom[v] = newIdom;
+                changed = true;
+            }
+        }
+    }
+    idom[root] = -1;
+
+    std::vector<std::vector<int>> kids(N);
+    for (size_t i = 1; i < order.size(); ++i)
+        kids[idom[order[i]]].push_back(order[i]);
+    for (int v : order) {
+        if (v >= n)
+            continue;
+        rpoIndex_[v] = static_cast<int>(rpo_.size());
+        rpo_.push_back(blockOf(v));
+        if (idom[v] >= 0 && idom[v] < n) {
+            idom_[v] = blockOf(idom[v]);
+            children_[idom[v]].push_back(blockOf(v));
+        }
+    }
+
+    // 3. 支配树编号
+    {
+        int pre = 0, post = 0;
+        std::vector<std::pair<int, size_t>> stack;
+        stack.push_back({root, 0});
+        if (root < n)
+            preNum_[root] = pre++;
+        while (!stack.empty()) {
+            auto &[v, next] = stack.back();
+            if (next < kids[v].size()) {
+                int child = kids[v][next++];
+                preNum_[child] = pre++;
+                stack.push_back({child, 0});
+                continue;
+            }
+            if (v < n)
+                postNum_[v] = post++;
+            stack.pop_back();
+        }
+    }
+
+    // 4. 支配边界
+    for (int v : order) {
+        if (v >= n)
+            continue;
+        for (int p : G.preds(v)) {
+            if (index[p] < 0)
+                continue;
+            for (int runner = p; runner >= 0 && runner != idom[v]; runner = idom[runner]) {
+                auto &df = frontier_[runner];
+                if (df.empty() || df.back() != blockOf(v))
+                    df.push_back(blockOf(v));
+            }
+        }
+    }
+}
+
+// dominates：先序 / 后序区间包含检查
+bool DominatorTree::dominates(const BasicBlock *a, const BasicBlock *b) const {
+    if (preNum_[a->id] < 0 || preNum_[b->id] < 0)
+        return false;
+    return preNum_[a->id] <= preNum_[b->id] && postNum_[b->id] <= postNum_[a->id];
+}
+
+// ======================== LoopInfo ========================
+
+// contains：other 是否为本循环或其（间接）内层循环
+bool Loop::contains(const Loop *other) const {
+    for (; other; other = other->parent)
+        if (other == this)
+            return true;
+    return false;
+}
+
+/**
+ * @brief 构建自然循环森林
+ * @details 按逆后序的逆序处理候选头结点：外层头结点支配内层头结点、在逆后序中更靠前，
+ *   因此内层循环总是先被发现。对头结点 h，回边源块入工作表，沿前驱反向扩展：
+ *   - 尚未归属任何循环的块归入当前循环（h 自身不再向前扩展）
+ *   - 已归属某个循环的块，取其最外层循环 S；S 尚无外层时把它挂到当前循环下，
+ *     并从 S 的头结点的（S 之外的）前驱继续扩展，S 内部的块不再重复访问
+ *   最后按逆后序为每个块登记所属的各层循环，并计算嵌套深度
+ */
+LoopInfo::LoopInfo(const Function &F, const DominatorTree &DT) {
+    innermost_.assign(F.blocks.size(), nullptr);
+    const auto &rpo = DT.rpo();
+    std::vector<BasicBlock *> work;
+    for (auto hi = rpo.rbegin(); hi != rpo.rend(); ++hi) {
+        BasicBlock *header = *hi;
+        for (BasicBlock *pred : header->preds)
+            if (DT.dominates(header, pred))
+                work.push_back(pred);
+        if (work.empty())
+            continue;
+
+        auto loop = std::make_unique<Loop>();
+        Loop *L = loop.get();
+        L->header = header;
+        for (BasicBlock *latch : work)
+            if (std::find(L->latches.begin(), L->latches.end(), latch) == L->latches.end())
+                L->latches.push_back(latch);
+        loops_.push_back(std::move(loop));
+
+        while (!work.empty()) {
+            BasicBlock *bb = work.back();
+            work.pop_back();
+            Loop *sub = innermost_[bb->id];
+            if (!sub) {
+                innermost_[bb->id] = L;
+                if (bb == header)
+                    continue;
+                for (BasicBlock *pred : bb->preds)
+                    if (DT.isReachable(pred))
+                        work.push_back(pred);
+                continue;
+            }
+            while (sub->parent)
+                sub = sub->parent;
+            if (sub == L)
+                continue;
+            sub->parent = L;
+            for (BasicBlock *pred : sub->header->preds)
+                if (DT.isReachable(pred) && innermost_[pred->id] != sub)
+                    work.push_back(pred);
+        }
+    }
+
+    // loops_ 按发现顺序（内层在前）；逆序遍历时外层总先于内层，深度可以直接累加
+    for (auto it = loops_.rbegin(); it != loops_.rend(); ++it) {
+        Loop *L = it->get();
+        if (L->parent) {
+            L->depth = L->parent->depth + 1;
+            L->parent->subLoops.push_back(L);
+        } else {
+            topLevel_.push_back(L);
+        }
+    }
+    for (BasicBlock *bb : rpo)
+        for (Loop *L = innermost_[bb->id]; L; L = L->parent)
+            L->blocks.push_back(bb);
+}
+
+uint64_t blockFrequency(const Function &F, const LoopInfo &loops, const BasicBlock *bb) {
+    uint64_t w = 1;
+    for (int d = std::min(loops.loopDepth(bb), 9); d > 0; --d)
+        w *= 10;
+    const int64_t entry = F.blocks.empty() ? -1 : F.blocks.front()->profileCount;
+    if (entry <= 0)
+        return w;
+    if (bb->profileCount < 0)
+        return w * kProfileFrequencyScale;
+    return std::max<uint64_t>(
+        1, static_cast<uint64_t>(bb->profileCount) * kProfileFrequencyScale /
+               static_cast<uint64_t>(entry));
+}
+
+// ======================== DefUseChains ========================
+
+/**
+ * @brief 建立 def-use 链
+ * @details 第一遍统计每个 vreg 的定义数与使用数（同时确定编号上界），前缀和得到各区间起点；
+ *   第二遍按同样的顺序把指令指针写入区间。两遍都用 forEachUse 遍历操作数，不构造临时列表
+ */
+DefUseChains::DefUseChains(const Function &F) {
+    size_t n = static_cast<size_t>(std::max(F.maxVregId, -1) + 1);
+    std::vector<uint32_t> defCount(n, 0), useCount(n, 0);
+    auto bump = [&](std::vector<uint32_t> &count, int vreg) {
+        if (static_cast<size_t>(vreg) >= n) {
+            n = static_cast<size_t>(vreg) + 1;
+            defCount.resize(n, 0);
+            useCount.resize(n, 0);
+        }
+        ++count[vreg];
+    };
+    for (const auto &bb : F.blocks)
+        for (const Instruction *I : bb->insts) {
+            I->forEachUse([&](int u) { bump(useCount, u); });
+            if (int d = I->defReg(); d >= 0)
+                bump(defCount, d);
+        }
+
+    auto prefix = [&](const std::vector<uint32_t> &count, std::vector<uint32_t> &begin) {
+        begin.assign(n + 1, 0);
+        for (size_t v = 0; v < n; ++v)
+            begin[v + 1] = begin[v] + count[v];
+    };
+    prefix(defCount, defBegin_);
+    prefix(useCount, useBegin_);
+    defs_.resize(defBegin_[n]);
+    uses_.resize(useBegin_[n]);
+
+    std::vector<uint32_t> defFill(defBegin_.begin(), defBegin_.end() - 1);
+    std::vector<uint32_t> useFill(useBegin_.begin(), useBegin_.end() - 1);
+    for (const auto &bb : F.blocks)
+        for (Instruction *I : bb->insts) {
+            I->forEachUse([&](int u) { uses_[useFill[u]++] = I; });
+            if (int d = I->defReg(); d >= 0)
+                defs_[defFill[d]++] = I;
+        }
+}
+
+// ======================== CallGraph ========================
+
+/**
+ * @brief 构建调用图并求自底向上的强连通分量
+ * @details Tarjan 算法：显式栈保存 (函数, 下一个待访问的被调者下标)。
+ *   一个函数的 low 值回到自身的 index 时，栈顶到它为止的函数组成一个分量；
+ *   分量按完成顺序登记，被调者所在的分量总是先完成
+ */
+CallGraph::CallGraph(const Module &M) {
+    for (auto &F : M.functions) {
+        index_[F.get()] = static_cast<int>(functions_.size());
+        byName_.emplace(F->name, static_cast<int>(functions_.size()));
+        functions_.push_back(F.get());
+    }
+    const size_t n = functions_.size();
+    callees_.resize(n);
+    recursive_.assign(n, 0);
+    for (size_t i = 0; i < n; ++i)
+        for (auto &bb : functions_[i]->blocks)
+            for (const Instruction *I : bb->insts) {
+                if (I->opcode != Opcode::Call)
+                    continue;
+                Function *callee = function(I->callee);
+                if (!callee)
+                    continue;
+                if (callee == functions_[i])
+                    recursive_[i] = 1;
+                auto &list = callees_[i];
+                if (std::find(list.begin(), list.end(), callee) == list.end())
+                    list.push_back(callee);
+            }
+
+    std::vector<int> order(n, -1), low(n, 0);
+    std::vector<char> onStack(n, 0);
+    std::vector<int> stack;
+    std::vector<std::pair<int, size_t>> frames; // (函数下标, 下一个被调者)
+    sccOf_.assign(n, -1);
+    int counter = 0;
+    for (size_t root = 0; root < n; ++root) {
+        if (order[root] >= 0)
+            continue;
+        frames.emplace_back(static_cast<int>(root), 0);
+        order[root] = low[root] = counter++;
+        stack.push_back(static_cast<int>(root));
+        onStack[root] = 1;
+        while (!frames.empty()) {
+            auto &[v, next] = frames.back();
+            if (next < callees_[v].size()) {
+                int w = indexOf(callees_[v][next++]);
+                if (order[w] < 0) {
+                    order[w] = low[w] = counter++;
+                    stack.push_back(w);
+                    onStack[w] = 1;
+                    frames.emplace_back(w, 0);
+                } else if (onStack[w]) {
+                    low[v] = std::min(low[v], order[w]);
+                }
+                continue;
+            }
+            const int done = v;
+            frames.pop_back();
+            if (!frames.empty())
+                low[frames.back().first] = std::min(low[frames.back().first], low[done]);
+            if (low[done] != order[done])
+                continue;
+            std::vector<Function *> scc;
+            int w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                onStack[w] = 0;
+                sccOf_[w] = static_cast<int>(sccs_.size());
+                scc.push_back(functions_[w]);
+            } while (w != done);
+            if (scc.size() > 1)
+                for (Function *F : scc)
+                    recursive_[indexOf(F)] = 1;
+            std::reverse(scc.begin(), scc.end());
+            sccs_.push_back(std::move(scc));
+        }
+    }
+}
+
+// refreshSelfRecursion：只有单独成分量的函数可以通过扫描自身的调用判断
+void CallGraph::refreshSelfRecursion(const Function *F) {
+    const int i = indexOf(F);
+    if (sccs_[sccOf_[i]].size() > 1)
+        return;
+    bool self = false;
+    for (auto &bb : F->blocks)
+        for (const Instruction *I : bb->insts)
+            self |= I->opcode == Opcode::Call && I->callee.str() == F->name;
+    recursive_[i] = self;
+}
+
+// function：按名字查找模块中定义的函数
+Function *CallGraph::function(const std::string &name) const {
+    auto it = byName_.find(name);
+    return it == byName_.end() ? nullptr : functions_[it->second];
+}
+
+// ======================== AnalysisManager ========================
+
+// sync：尚未构建 CFG 时先构建；CFG 版本变化时丢弃缓存
+void AnalysisManager::sync() {
+    if (F_.cfgVersion == 0)
+        F_.buildCFG();
+    if (version_ != F_.cfgVersion) {
+        invalidate();
+        version_ = F_.cfgVersion;
+    }
+}
+
+const DominatorTree &AnalysisManager::domTree() {
+    sync();
+    if (!dom_)
+        dom_ = std::make_unique<DominatorTree>(F_);
+    return *dom_;
+}
+
+const PostDominatorTree &AnalysisManager::postDomTree() {
+    sync();
+    if (!postDom_)
+        postDom_ = std::make_unique<PostDominatorTree>(F_);
+    return *postDom_;
+}
+
+const LoopInfo &AnalysisManager::loops() {
+    const DominatorTree &DT = domTree();
+    if (!loops_)
+        loops_ = std::make_unique<LoopInfo>(F_, DT);
+    return *loops_;
+}
+
+void AnalysisManager::invalidate() {
+    loops_.reset();
+    postDom_.reset();
+    dom_.reset();
+}
+
+namespace ir {
+
+// Function 的构造 / 析构放在这里：AnalysisManager 在 ir.h 中只有前向声明
+Function::Function() = default;
+Function::~Function() = default;
+
+// analyses：按需创建本函数的分析缓存
+AnalysisManager &Function::analyses() {
+    if (!analyses_)
+        analyses_ = std::make_unique<AnalysisManager>(*this);
+    return *analyses_;
+}
+
+} // namespace ir
+
+} // namespace toyc
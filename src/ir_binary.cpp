@@ -0,0 +1,431 @@
+#include "ir_binary.h"
+#include "statistics.h"
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace toyc {
+
+using namespace ir;
+
+namespace {
+
+constexpr char kMagic[4] = {'T', 'B', 'I', 'R'};
+constexpr uint64_t kVersion = 1;
+
+// 指令头字节的高 4 位：标记随后写出的可选字段（低 4 位为 Opcode）
+constexpr uint8_t kOpcodeMask = 0x0f;
+constexpr uint8_t kFlagNsw = 1u << 4;    // 算术运算 nsw = true / call 的 tail = true
+constexpr uint8_t kFlagAlign = 1u << 5;  // align != 4，随后写出 align
+constexpr uint8_t kFlagPred = 1u << 6;   // cmpPred != EQ，随后写出谓词
+constexpr uint8_t kFlagCallee = 1u << 7; // callee 非空，随后写出被调函数名
+static_assert(static_cast<int>(Opcode::Copy) <= kOpcodeMask, "Opcode must fit in 4 bits");
+
+// ======================== 变长整数 ========================
+
+// putVarint：LEB128 编码（每字节 7 位，最高位表示后面还有字节）
+void putVarint(std::string &out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+// zigzag / unzigzag：有符号数与无符号数互转，使绝对值小的负数也编码为短字节串
+uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+void putSigned(std::string &out, int64_t v) { putVarint(out, zigzag(v)); }
+
+// ======================== 写入端 ========================
+
+// StringTable：写入时的模块级字符串表（下标 0 为空串）
+class StringTable {
+  public:
+    StringTable() { strings_.emplace_back(); }
+
+    uint32_t intern(std::string_view s) {
+        if (s.empty())
+            return 0;
+        auto [it, inserted] = index_.try_emplace(s, static_cast<uint32_t>(strings_.size()));
+        if (inserted)
+            strings_.push_back(s);
+        return it->second;
+    }
+    const std::vector<std::string_view> &strings() const { return strings_; }
+
+  private:
+    std::vector<std::string_view> strings_; // 视图指向模块或全局驻留表中的字符串，写出前保持有效
+    std::unordered_map<std::string_view, uint32_t> index_;
+};
+
+// Encoder：把函数体编码到连续的字节缓冲区
+class Encoder {
+  public:
+    explicit Encoder(StringTable &strs) : strs_(strs) {}
+
+    void encodeFunction(std::string &out, const Function &F) {
+        putVarint(out, strs_.intern(F.returnType));
+        putVarint(out, F.params.size());
+        for (const auto &p : F.params) {
+            putVarint(out, strs_.intern(p.name));
+            putVarint(out, strs_.intern(p.type));
+        }
+        putVarint(out, F.paramVregs.size());
+        for (int v : F.paramVregs)
+            putSigned(out, v);
+        putSigned(out, F.maxVregId);
+
+        putVarint(out, F.blocks.size());
+        for (const auto &bb : F.blocks) {
+            putVarint(out, strs_.intern(bb->name));
+            putVarint(out, bb->insts.size());
+            for (const Instruction *inst : bb->insts)
+                encodeInstruction(out, *inst);
+        }
+    }
+
+  private:
+    StringTable &strs_;
+
+    void encodeOperand(std::string &out, const Operand &op) {
+        out.push_back(static_cast<char>(op.kind()));
+        switch (op.kind()) {
+        case Operand::Kind::None:
+            break;
+        case Operand::Kind::VReg:
+        case Operand::Kind::Imm:
+            putSigned(out, op.immValue());
+            break;
+        case Operand::Kind::Label:
+            putVarint(out, strs_.intern(op.labelName()));
+            break;
+        case Operand::Kind::BoolLit:
+            out.push_back(op.boolValue() ? 1 : 0);
+            break;
+        }
+    }
+
+    void encodeInstruction(std::string &out, const Instruction &inst) {
+        uint8_t head = static_cast<uint8_t>(inst.opcode);
+        if (inst.nsw || inst.tail)
+            head |= kFlagNsw;
+        if (inst.align != 4)
+            head |= kFlagAlign;
+        if (inst.cmpPred != CmpPred::EQ)
+            head |= kFlagPred;
+        if (!inst.callee.empty())
+            head |= kFlagCallee;
+        out.push_back(static_cast<char>(head));
+
+        putVarint(out, strs_.intern(inst.type.str()));
+        encodeOperand(out, inst.def);
+        putVarint(out, inst.ops.size());
+        for (const Operand &op : inst.ops)
+            encodeOperand(out, op);
+        if (head & kFlagAlign)
+            putSigned(out, inst.align);
+        if (head & kFlagPred)
+            out.push_back(static_cast<char>(inst.cmpPred));
+        if (head & kFlagCallee)
+            putVarint(out, strs_.intern(inst.callee.str()));
+    }
+};
+
+// ======================== 读取端 ========================
+
+// ByteReader：带边界检查的顺序读取（越界即视为数据损坏）
+class ByteReader {
+  public:
+    explicit ByteReader(std::string_view data) : p_(data.data()), end_(data.data() + data.size()) {}
+
+    size_t remaining() const { return static_cast<size_t>(end_ - p_); }
+    bool atEnd() const { return p_ == end_; }
+
+    uint8_t byte() {
+        if (p_ == end_)
+            fail("truncated data");
+        return static_cast<uint8_t>(*p_++);
+    }
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        fail("malformed varint");
+    }
+
+    // int32：读取 zigzag 编码的有符号数，须落在 int32 范围内
+    int32_t int32() {
+        int64_t v = unzigzag(varint());
+        if (v < std::numeric_limits<int32_t>::min() || v > std::numeric_limits<int32_t>::max())
+            fail("integer out of range");
+        return static_cast<int32_t>(v);
+    }
+
+    // count：读取元素个数（每个元素至少占 1 字节，超出剩余长度即为损坏）
+    size_t count() {
+        uint64_t n = varint();
+        if (n > remaining())
+            fail("element count exceeds data size");
+        return static_cast<size_t>(n);
+    }
+
+    std::string_view bytes(size_t n) {
+        if (n > remaining())
+            fail("truncated data");
+        std::string_view s(p_, n);
+        p_ += n;
+        return s;
+    }
+
+    [[noreturn]] static void fail(const char *what) {
+        throw std::runtime_error(std::string("invalid binary IR: ") + what);
+    }
+
+  private:
+    const char *p_;
+    const char *end_;
+};
+
+// Decoder：按字符串表解码函数体
+class Decoder {
+  public:
+    Decoder(std::string_view body, const std::vector<Symbol> &symbols)
+        : in_(body), symbols_(symbols) {}
+
+    std::unique_ptr<Function> decodeFunction(Symbol name) {
+        auto func = std::make_unique<Function>();
+        func->name = name.str();
+        func->returnType = symbol().str();
+        size_t numParams = in_.count();
+        func->params.reserve(numParams);
+        for (size_t i = 0; i < numParams; ++i) {
+            FuncParam p;
+            p.name = symbol().str();
+            p.type = symbol().str();
+            func->params.push_back(std::move(p));
+        }
+        size_t numParamVregs = in_.count();
+        func->paramVregs.reserve(numParamVregs);
+        for (size_t i = 0; i < numParamVregs; ++i)
+            func->paramVregs.push_back(in_.int32());
+        func->maxVregId = in_.int32();
+
+        size_t numBlocks = in_.count();
+        func->blocks.reserve(numBlocks);
+        for (size_t b = 0; b < numBlocks; ++b) {
+            auto bb = std::make_unique<BasicBlock>();
+            bb->id = static_cast<int>(b);
+            bb->name = symbol().str();
+            size_t numInsts = in_.count();
+            bb->insts.reserve(numInsts);
+            for (size_t i = 0; i < numInsts; ++i) {
+                Instruction inst = decodeInstruction();
+                inst.blockId = bb->id;
+                bb->insts.push_back(func->newInst(std::move(inst)));
+            }
+            func->blockMap[bb->name] = bb.get();
+            func->blocks.push_back(std::move(bb));
+        }
+        if (!in_.atEnd())
+            ByteReader::fail("trailing bytes after function body");
+        return func;
+    }
+
+  private:
+    ByteReader in_;
+    const std::vector<Symbol> &symbols_;
+
+    Symbol symbol() {
+        uint64_t id = in_.varint();
+        if (id >= symbols_.size())
+            ByteReader::fail("string index out of range");
+        return symbols_[id];
+    }
+
+    Operand decodeOperand() {
+        switch (static_cast<Operand::Kind>(in_.byte())) {
+        case Operand::Kind::None:
+            return Operand::none();
+        case Operand::Kind::VReg:
+            return Operand::vreg(in_.int32());
+        case Operand::Kind::Imm:
+            return Operand::imm(in_.int32());
+        case Operand::Kind::Label:
+            return Operand::label(symbol());
+        case Operand::Kind::BoolLit:
+            return Operand::boolLit(in_.byte() != 0);
+        }
+        ByteReader::fail("unknown operand kind");
+    }
+
+    Instruction decodeInstruction() {
+        uint8_t head = in_.byte();
+        if ((head & kOpcodeMask) > static_cast<uint8_t>(Opcode::Copy))
+            ByteReader::fail("unknown opcode");
+        Instruction inst;
+        inst.opcode = static_cast<Opcode>(head & kOpcodeMask);
+        (inst.opcode == Opcode::Call ? inst.tail : inst.nsw) = (head & kFlagNsw) != 0;
+        inst.type = symbol();
+        inst.def = decodeOperand();
+        size_t numOps = in_.count();
+        for (size_t i = 0; i < numOps; ++i)
+            inst.ops.push_back(decodeOperand());
+        if (head & kFlagAlign)
+            inst.align = in_.int32();
+        if (head & kFlagPred) {
+            uint8_t pred = in_.byte();
+            if (pred > static_cast<uint8_t>(CmpPred::SGE))
+                ByteReader::fail("unknown compare predicate");
+            inst.cmpPred = static_cast<CmpPred>(pred);
+        }
+        if (head & kFlagCallee)
+            inst.callee = symbol();
+        return inst;
+    }
+};
+
+} // namespace
+
+// ======================== writeBinaryIR ========================
+
+/**
+ * @brief 把模块序列化为 .bir
+ * @details 先把所有函数体编码到同一个缓冲区（同时收集字符串表并记录每个函数体的偏移），
+ *   再依次写出文件头、字符串表、模块头、函数索引和函数体区
+ */
+void writeBinaryIR(const Module &mod, std::ostream &os) {
+    StringTable strs;
+    uint32_t moduleName = strs.intern(mod.name);
+    uint32_t sourceFile = strs.intern(mod.sourceFile);
+    uint32_t targetTriple = strs.intern(mod.targetTriple);
+
+    Encoder encoder(strs);
+    std::string bodies;
+    std::string index;
+    putVarint(index, mod.functions.size());
+    for (const auto &F : mod.functions) {
+        size_t start = bodies.size();
+        encoder.encodeFunction(bodies, *F);
+        putVarint(index, strs.intern(F->name));
+        putVarint(index, start);
+        putVarint(index, bodies.size() - start);
+    }
+
+    std::string head(kMagic, sizeof(kMagic));
+    putVarint(head, kVersion);
+    putVarint(head, strs.strings().size());
+    for (size_t i = 1; i < strs.strings().size(); ++i) {
+        std::string_view s = strs.strings()[i];
+        putVarint(head, s.size());
+        head.append(s);
+    }
+    putVarint(head, moduleName);
+    putVarint(head, sourceFile);
+    putVarint(head, targetTriple);
+
+    os.write(head.data(), static_cast<std::streamsize>(head.size()));
+    os.write(index.data(), static_cast<std::streamsize>(index.size()));
+    os.write(bodies.data(), static_cast<std::streamsize>(bodies.size()));
+}
+
+// isBinaryIR：按魔数识别 .bir 数据
+bool isBinaryIR(std::string_view data) {
+    return data.size() >= sizeof(kMagic) && std::memcmp(data.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+// ======================== BinaryIRReader ========================
+
+/**
+ * @brief 解析 .bir 的文件头、字符串表与函数索引
+ * @details 字符串表中的字符串在此一次性驻留为 Symbol，解码函数体时标签/类型/被调函数名
+ *   只需按下标取用；索引中的每个函数体范围都会先校验是否落在数据之内
+ */
+BinaryIRReader::BinaryIRReader(std::string_view data) : data_(data) {
+    if (!isBinaryIR(data))
+        ByteReader::fail("bad magic");
+    ByteReader in(data.substr(sizeof(kMagic)));
+    if (in.varint() != kVersion)
+        ByteReader::fail("unsupported version");
+
+    size_t numStrings = in.count();
+    if (numStrings == 0)
+        ByteReader::fail("empty string table");
+    symbols_.reserve(numStrings);
+    symbols_.emplace_back();
+    for (size_t i = 1; i < numStrings; ++i)
+        symbols_.emplace_back(in.bytes(in.count()));
+
+    auto stringIndex = [&] {
+        uint64_t id = in.varint();
+        if (id >= symbols_.size())
+            ByteReader::fail("string index out of range");
+        return static_cast<uint32_t>(id);
+    };
+    moduleName_ = stringIndex();
+    sourceFile_ = stringIndex();
+    targetTriple_ = stringIndex();
+
+    size_t numFuncs = in.count();
+    index_.reserve(numFuncs);
+    for (size_t i = 0; i < numFuncs; ++i) {
+        FunctionEntry e;
+        e.name = stringIndex();
+        e.offset = in.varint();
+        e.size = in.varint();
+        index_.push_back(e);
+    }
+
+    bodyBase_ = data.size() - in.remaining();
+    size_t avail = in.remaining();
+    for (const auto &e : index_) {
+        if (e.offset > avail || e.size > avail - e.offset)
+            ByteReader::fail("function body out of range");
+    }
+}
+
+// findFunction：按名字线性查找函数索引
+int BinaryIRReader::findFunction(std::string_view name) const {
+    for (size_t i = 0; i < index_.size(); ++i) {
+        if (symbols_[index_[i].name].str() == name)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// readFunction：按索引定位并解码单个函数体
+std::unique_ptr<Function> BinaryIRReader::readFunction(size_t i) const {
+    stats::ScopedTimer timer(stats::Phase::IRLoad);
+    const auto &e = index_.at(i);
+    Decoder decoder(data_.substr(bodyBase_ + e.offset, e.size), symbols_);
+    return decoder.decodeFunction(symbols_[e.name]);
+}
+
+// readModule：解码模块头与全部函数
+std::unique_ptr<Module> BinaryIRReader::readModule() const {
+    std::vector<size_t> all(index_.size());
+    for (size_t i = 0; i < all.size(); ++i)
+        all[i] = i;
+    return readModule(all);
+}
+
+// readModule：解码模块头与选中的函数（其余函数体不被访问）
+std::unique_ptr<Module> BinaryIRReader::readModule(const std::vector<size_t> &functions) const {
+    auto mod = std::make_unique<Module>();
+    mod->name = symbols_[moduleName_].str();
+    mod->sourceFile = symbols_[sourceFile_].str();
+    mod->targetTriple = symbols_[targetTriple_].str();
+    mod->functions.reserve(functions.size());
+    for (size_t i : functions)
+        mod->functions.push_back(readFunction(i));
+    return mod;
+}
+
+} // namespace toyc
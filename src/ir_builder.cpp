@@ -1,14 +1,12 @@
 #include "ir_builder.h"
+#include "statistics.h"
 #include <algorithm>
-
+#include <charconv>
 
 namespace toyc {
 
 using namespace ir;
 
-// 构造函数：初始化并进入第一层作用域
-IRBuilder::IRBuilder() { enterScope(); }
-
 // ======================== 辅助方法 ========================
 
 // newVReg：分配并返回一个新的虚拟寄存器操作数
@@ -35,46 +33,17 @@ void IRBuilder::setInsertBlock(BasicBlock *bb) { currentBB_ = bb; }
 
 // emit：将一条指令发射到当前基本块末尾
 void IRBuilder::emit(Instruction inst) {
-    auto p = std::make_unique<Instruction>(std::move(inst));
-    p->blockId = currentBB_->id;
-    currentBB_->insts.push_back(std::move(p));
-}
-
-// ======================== 作用域管理 ========================
-
-// enterScope：进入新作用域（压入新的变量映射表）
-void IRBuilder::enterScope() { scopeStack_.emplace_back(); }
-
-// exitScope：退出当前作用域（弹出栈顶变量映射表）
-void IRBuilder::exitScope() {
-    if (!scopeStack_.empty())
-        scopeStack_.pop_back();
-}
-
-// addVariable：在当前作用域添加变量（变量名 → alloca 寄存器）
-void IRBuilder::addVariable(const std::string &name, const Operand &allocaReg) {
-    if (!scopeStack_.empty())
-        scopeStack_.back()[name] = allocaReg;
-}
-
-// findVariable：从当前作用域开始向外层查找变量，实现变量隐藏语义
-Operand IRBuilder::findVariable(const std::string &name) {
-    for (int i = static_cast<int>(scopeStack_.size()) - 1; i >= 0; --i) {
-        auto it = scopeStack_[i].find(name);
-        if (it != scopeStack_[i].end())
-            return it->second;
-    }
-    return Operand::none();
+    inst.blockId = currentBB_->id;
+    currentBB_->insts.push_back(currentFunc_->newInst(std::move(inst)));
 }
 
 // ======================== 模块/函数 ========================
 
 // buildModule：生成完整的 IR 模块，遍历所有函数定义并逐个生成
-std::unique_ptr<Module> IRBuilder::buildModule(const std::vector<std::shared_ptr<FuncDef>> &funcs) {
+std::unique_ptr<Module> IRBuilder::buildModule(const CompUnit &unit) {
     auto mod = std::make_unique<Module>();
-    module_ = mod.get();
-    for (auto &f : funcs)
-        buildFunction(f);
+    for (const FuncDef *f : unit.funcs)
+        mod->functions.push_back(buildFunction(*f));
     return mod;
 }
 
@@ -84,34 +53,25 @@ std::unique_ptr<Module> IRBuilder::buildModule(const std::vector<std::shared_ptr
 // 3. 处理参数的 alloca + store
 // 4. 遍历函数体生成指令
 // 5. 添加默认返回（若未显式 return）
-void IRBuilder::buildFunction(const std::shared_ptr<FuncDef> &funcDef) {
+std::unique_ptr<Function> IRBuilder::buildFunction(const FuncDef &funcDef) {
     // 重置状态
     labelCounter_ = 0;
-    vregCounter_ = static_cast<int>(funcDef->params.size());
-    scopeStack_.clear();
-    enterScope();
-    loadedValues_.clear();
+    vregCounter_ = static_cast<int>(funcDef.params.size());
+    symbols_.reset();
     breakLabels_.clear();
     continueLabels_.clear();
-    currentFuncName_ = funcDef->name;
+    currentFuncName_ = funcDef.name;
     hasReturn_ = false;
-    isMainFunction_ = (funcDef->name == "main");
+    isMainFunction_ = (funcDef.name == "main");
 
     auto func = std::make_unique<Function>();
-    func->name = funcDef->name;
-    func->returnType = funcDef->retType;
+    func->name = funcDef.name;
+    func->returnType = funcDef.retType;
     currentFunc_ = func.get();
 
-    // 保存原始参数名，将 AST 参数名改为索引
-    std::vector<std::string> origNames;
-    for (auto &p : funcDef->params)
-        origNames.push_back(p.name);
-    for (size_t i = 0; i < funcDef->params.size(); ++i)
-        funcDef->params[i].name = std::to_string(i);
-
-    // 设置函数参数信息
-    for (size_t i = 0; i < funcDef->params.size(); ++i) {
-        func->params.push_back({funcDef->params[i].name, "i32"});
+    // 设置函数参数信息（IR 中的参数名为其下标，AST 保持原名不变）
+    for (size_t i = 0; i < funcDef.params.size(); ++i) {
+        func->params.push_back({std::to_string(i), "i32"});
         func->paramVregs.push_back(static_cast<int>(i));
     }
 
@@ -122,119 +82,114 @@ void IRBuilder::buildFunction(const std::shared_ptr<FuncDef> &funcDef) {
     // main 函数的返回值 alloca
     if (isMainFunction_) {
         Operand retVar = newVReg();
-        addVariable(funcDef->name + "_ret", retVar);
         emit(Instruction::makeAlloca(retVar, "i32"));
         emit(Instruction::makeStore("i32", Operand::imm(0), retVar));
     }
 
-    // 参数 alloca + store
-    for (size_t i = 0; i < funcDef->params.size(); ++i) {
-        std::string irName = funcDef->params[i].name;
-        std::string orig = origNames[i];
+    // 参数 alloca + store（参数属于函数最外层作用域，函数体块在其内层）
+    symbols_.enterScope();
+    for (size_t i = 0; i < funcDef.params.size(); ++i) {
         Operand slot = newVReg();
         emit(Instruction::makeAlloca(slot, "i32"));
         emit(Instruction::makeStore("i32", Operand::vreg(static_cast<int>(i)), slot));
-        addVariable(irName, slot);
-        addVariable(orig, slot);
+        symbols_.declare(funcDef.params[i].sym, slot);
     }
 
     // 生成函数体
-    buildBlock(funcDef->body);
+    buildBlock(*funcDef.body);
 
     // 添加默认返回
     if (!hasReturn_) {
-        if (funcDef->retType == "int")
+        if (funcDef.retType == "int")
             emit(Instruction::makeRet("i32", Operand::imm(0)));
         else
             emit(Instruction::makeRetVoid());
     }
 
     func->maxVregId = vregCounter_;
-    module_->functions.push_back(std::move(func));
+    currentFunc_ = nullptr;
+    currentBB_ = nullptr;
+    return func;
 }
 
 // ======================== 语句 ========================
 
 // buildBlock：生成语句块 IR，进入新作用域后遍历所有语句
-void IRBuilder::buildBlock(const std::shared_ptr<BlockStmt> &block) {
-    enterScope();
-    for (auto &stmt : block->stmts)
+void IRBuilder::buildBlock(const BlockStmt &block) {
+    symbols_.enterScope();
+    for (const ASTNode *stmt : block.stmts)
         buildStmt(stmt);
-    exitScope();
+    symbols_.exitScope();
 }
 
-// buildStmt：根据语句的实际类型 dispatch 到对应的生成方法
-void IRBuilder::buildStmt(const ASTPtr &stmt) {
+// buildStmt：按节点种类标签 dispatch 到对应的生成方法
+void IRBuilder::buildStmt(const ASTNode *stmt) {
     if (!stmt)
         return;
-    if (auto s = std::dynamic_pointer_cast<AssignStmt>(stmt)) {
-        buildAssign(s);
+    switch (stmt->kind) {
+    case NodeKind::Assign:
+        buildAssign(cast<AssignStmt>(*stmt));
         return;
-    }
-    if (auto s = std::dynamic_pointer_cast<DeclStmt>(stmt)) {
-        buildDecl(s);
+    case NodeKind::Decl:
+        buildDecl(cast<DeclStmt>(*stmt));
         return;
-    }
-    if (auto s = std::dynamic_pointer_cast<IfStmt>(stmt)) {
-        buildIf(s);
+    case NodeKind::If:
+        buildIf(cast<IfStmt>(*stmt));
         return;
-    }
-    if (auto s = std::dynamic_pointer_cast<WhileStmt>(stmt)) {
-        buildWhile(s);
+    case NodeKind::While:
+        buildWhile(cast<WhileStmt>(*stmt));
         return;
-    }
-    if (auto s = std::dynamic_pointer_cast<ReturnStmt>(stmt)) {
-        buildReturn(s);
+    case NodeKind::Return:
+        buildReturn(cast<ReturnStmt>(*stmt));
         return;
-    }
-    if (auto s = std::dynamic_pointer_cast<BreakStmt>(stmt)) {
+    case NodeKind::Break:
         buildBreak();
         return;
-    }
-    if (auto s = std::dynamic_pointer_cast<ContinueStmt>(stmt)) {
+    case NodeKind::Continue:
         buildContinue();
         return;
-    }
-    if (auto s = std::dynamic_pointer_cast<BlockStmt>(stmt)) {
-        buildBlock(s);
+    case NodeKind::Block:
+        buildBlock(cast<BlockStmt>(*stmt));
         return;
-    }
     // 表达式语句（含函数调用语句）
-    if (auto s = std::dynamic_pointer_cast<CallExpr>(stmt)) {
-        buildCall(s);
+    case NodeKind::Call:
+        buildCall(cast<CallExpr>(*stmt));
         return;
-    }
-    if (auto s = std::dynamic_pointer_cast<Expr>(stmt)) {
-        buildExpr(s);
+    case NodeKind::Number:
+    case NodeKind::Identifier:
+    case NodeKind::Binary:
+    case NodeKind::Unary:
+        buildExpr(stmt);
+        return;
+    case NodeKind::FuncDef:
         return;
     }
 }
 
 // buildAssign：生成赋值语句 IR（计算右值并 store 到变量地址）
-void IRBuilder::buildAssign(const std::shared_ptr<AssignStmt> &assign) {
-    Operand value = buildExpr(assign->expr);
-    Operand varOp = findVariable(assign->name);
-    if (!varOp.isNone()) {
-        emit(Instruction::makeStore("i32", value, varOp));
-        loadedValues_.erase(assign->name);
+void IRBuilder::buildAssign(const AssignStmt &assign) {
+    Operand value = buildExpr(assign.expr);
+    int var = symbols_.lookup(assign.sym);
+    if (var != ScopedSymbolTable::kNone) {
+        emit(Instruction::makeStore("i32", value, symbols_.slot(var)));
+        symbols_.forgetLoaded(var);
     }
 }
 
 // buildDecl：生成声明语句 IR（alloca + store，并将变量注册到当前作用域）
-void IRBuilder::buildDecl(const std::shared_ptr<DeclStmt> &decl) {
-    Operand val = buildExpr(decl->expr);
+void IRBuilder::buildDecl(const DeclStmt &decl) {
+    Operand val = buildExpr(decl.expr);
     Operand slot = newVReg();
     emit(Instruction::makeAlloca(slot, "i32"));
-    addVariable(decl->name, slot);
+    symbols_.declare(decl.sym, slot);
     emit(Instruction::makeStore("i32", val, slot));
-    loadedValues_.erase(decl->name);
 }
 
 // buildIf：生成 if 语句 IR
 // 创建 then/else/endif 三个基本块，通过条件分支连接
-void IRBuilder::buildIf(const std::shared_ptr<IfStmt> &ifStmt) {
-    loadedValues_.clear(); // 进入分支前清除缓存
-    Operand cond = buildExpr(ifStmt->cond);
+void IRBuilder::buildIf(const IfStmt &ifStmt) {
+    symbols_.forgetAllLoaded(); // 进入分支前清除缓存
+    Operand cond = buildExpr(ifStmt.cond);
 
     std::string thenName = newLabel("then");
     std::string elseName = newLabel("else");
@@ -246,26 +201,26 @@ void IRBuilder::buildIf(const std::shared_ptr<IfStmt> &ifStmt) {
     // Then 块
     auto *thenBB = createBlock(thenName);
     setInsertBlock(thenBB);
-    loadedValues_.clear();
-    buildStmt(ifStmt->thenStmt);
+    symbols_.forgetAllLoaded();
+    buildStmt(ifStmt.thenStmt);
     emit(Instruction::makeBr(Operand::label(endName)));
 
     // Else 块
     auto *elseBB = createBlock(elseName);
     setInsertBlock(elseBB);
-    loadedValues_.clear();
-    buildStmt(ifStmt->elseStmt);
+    symbols_.forgetAllLoaded();
+    buildStmt(ifStmt.elseStmt);
     emit(Instruction::makeBr(Operand::label(endName)));
 
     // Merge 块 —— 来自不同分支，缓存的 load 值无效
     auto *endBB = createBlock(endName);
     setInsertBlock(endBB);
-    loadedValues_.clear();
+    symbols_.forgetAllLoaded();
 }
 
 // buildWhile：生成 while 循环 IR
 // 创建 cond/body/end 三个基本块，循环体末尾跳回 cond 块
-void IRBuilder::buildWhile(const std::shared_ptr<WhileStmt> &whileStmt) {
+void IRBuilder::buildWhile(const WhileStmt &whileStmt) {
     std::string condName = newLabel("while_cond");
     std::string bodyName = newLabel("while_body");
     std::string endName = newLabel("while_end");
@@ -279,29 +234,30 @@ void IRBuilder::buildWhile(const std::shared_ptr<WhileStmt> &whileStmt) {
     // 条件块
     auto *condBB = createBlock(condName);
     setInsertBlock(condBB);
-    loadedValues_.clear();
-    Operand cond = buildExpr(whileStmt->cond);
+    symbols_.forgetAllLoaded();
+    Operand cond = buildExpr(whileStmt.cond);
     emit(Instruction::makeCondBr(cond, Operand::label(bodyName), Operand::label(endName)));
 
     // 循环体
     auto *bodyBB = createBlock(bodyName);
     setInsertBlock(bodyBB);
-    loadedValues_.clear();
-    buildStmt(whileStmt->body);
+    symbols_.forgetAllLoaded();
+    buildStmt(whileStmt.body);
     emit(Instruction::makeBr(Operand::label(condName)));
 
-    // 循环出口
+    // 循环出口 —— 可由条件块或任意 break 到达，缓存的 load 值无效
     auto *endBB = createBlock(endName);
     setInsertBlock(endBB);
+    symbols_.forgetAllLoaded();
 
     breakLabels_.pop_back();
     continueLabels_.pop_back();
 }
 
 // buildReturn：生成返回语句 IR，根据是否有返回值选择 ret/retvoid
-void IRBuilder::buildReturn(const std::shared_ptr<ReturnStmt> &retStmt) {
-    if (retStmt->expr) {
-        Operand value = buildExpr(retStmt->expr);
+void IRBuilder::buildReturn(const ReturnStmt &retStmt) {
+    if (retStmt.expr) {
+        Operand value = buildExpr(retStmt.expr);
         emit(Instruction::makeRet("i32", value));
     } else {
         emit(Instruction::makeRetVoid());
@@ -324,65 +280,87 @@ void IRBuilder::buildContinue() {
 // ======================== 表达式 ========================
 
 // buildExpr：生成表达式 IR，返回结果操作数
-// 根据表达式类型 dispatch：数字返回立即数，标识符先查缓存再 load，二元/一元/调用递归处理
-Operand IRBuilder::buildExpr(const ASTPtr &expr) {
-    if (auto e = std::dynamic_pointer_cast<NumberExpr>(expr))
-        return Operand::imm(e->value);
-
-    if (auto e = std::dynamic_pointer_cast<IdentifierExpr>(expr)) {
-        Operand varOp = findVariable(e->name);
-        if (!varOp.isNone()) {
-            auto it = loadedValues_.find(e->name);
-            if (it != loadedValues_.end())
-                return it->second;
-            Operand temp = newVReg();
-            emit(Instruction::makeLoad(temp, "i32", varOp));
-            loadedValues_[e->name] = temp;
-            return temp;
-        }
-        // 仅当名字是纯数字时 (函数参数索引) 才用 stoi
-        bool isNumeric = !e->name.empty() && std::all_of(e->name.begin(), e->name.end(), ::isdigit);
-        if (isNumeric)
-            return Operand::vreg(std::stoi(e->name)); // 直接引用参数寄存器
-        std::cerr << "Error: undefined variable '" << e->name << "'\n";
+// 按节点种类 dispatch：数字返回立即数，标识符先查缓存再 load，二元/一元/调用递归处理
+Operand IRBuilder::buildExpr(const ASTNode *expr) {
+    if (!expr)
         return Operand::imm(0);
+    switch (expr->kind) {
+    case NodeKind::Number:
+        return Operand::imm(cast<NumberExpr>(*expr).value);
+    case NodeKind::Identifier:
+        return buildIdentifier(cast<IdentifierExpr>(*expr));
+    case NodeKind::Binary: {
+        const auto &e = cast<BinaryExpr>(*expr);
+        return buildBinaryOp(e.op, e.lhs, e.rhs);
     }
+    case NodeKind::Unary: {
+        const auto &e = cast<UnaryExpr>(*expr);
+        return buildUnaryOp(e.op, e.expr);
+    }
+    case NodeKind::Call:
+        return buildCall(cast<CallExpr>(*expr));
+    default:
+        return Operand::imm(0);
+    }
+}
 
-    if (auto e = std::dynamic_pointer_cast<BinaryExpr>(expr))
-        return buildBinaryOp(e->op, e->lhs, e->rhs);
-
-    if (auto e = std::dynamic_pointer_cast<UnaryExpr>(expr))
-        return buildUnaryOp(e->op, e->expr);
-
-    if (auto e = std::dynamic_pointer_cast<CallExpr>(expr))
-        return buildCall(e);
-
+// buildIdentifier：生成变量读取 IR（已加载值缓存命中时直接复用 load 结果寄存器）
+Operand IRBuilder::buildIdentifier(const IdentifierExpr &e) {
+    int var = symbols_.lookup(e.sym);
+    if (var != ScopedSymbolTable::kNone) {
+        Operand cached = symbols_.loaded(var);
+        if (!cached.isNone())
+            return cached;
+        Operand temp = newVReg();
+        emit(Instruction::makeLoad(temp, "i32", symbols_.slot(var)));
+        symbols_.setLoaded(var, temp);
+        return temp;
+    }
+    // 仅当名字是纯数字时 (函数参数索引) 才按下标解析
+    int index = 0;
+    const char *last = e.name.data() + e.name.size();
+    auto [end, ec] = std::from_chars(e.name.data(), last, index);
+    if (!e.name.empty() && ec == std::errc() && end == last)
+        return Operand::vreg(index); // 直接引用参数寄存器
+    std::cerr << "Error: undefined variable '" << e.name << "'\n";
     return Operand::imm(0);
 }
 
 // buildBinaryOp：生成二元运算 IR
 // 逻辑运算和比较运算分别委托给专用方法，算术运算直接生成 binop 指令
-Operand IRBuilder::buildBinaryOp(const std::string &op, const ASTPtr &lhs, const ASTPtr &rhs) {
-    if (op == "&&" || op == "||")
+Operand IRBuilder::buildBinaryOp(BinaryOp op, const ASTNode *lhs, const ASTNode *rhs) {
+    Opcode opc;
+    switch (op) {
+    case BinaryOp::And:
+    case BinaryOp::Or:
         return buildLogicalOp(op, lhs, rhs);
-    if (op == "==" || op == "!=" || op == "<" || op == ">" || op == "<=" || op == ">=")
+    case BinaryOp::Eq:
+    case BinaryOp::Ne:
+    case BinaryOp::Lt:
+    case BinaryOp::Gt:
+    case BinaryOp::Le:
+    case BinaryOp::Ge:
         return buildComparison(op, lhs, rhs);
-
-    Operand lhsOp = buildExpr(lhs);
-    Operand rhsOp = buildExpr(rhs);
-    Operand result = newVReg();
-
-    Opcode opc;
-    if (op == "+")
+    case BinaryOp::Add:
         opc = Opcode::Add;
-    else if (op == "-")
+        break;
+    case BinaryOp::Sub:
         opc = Opcode::Sub;
-    else if (op == "*")
+        break;
+    case BinaryOp::Mul:
         opc = Opcode::Mul;
-    else if (op == "/")
+        break;
+    case BinaryOp::Div:
         opc = Opcode::SDiv;
-    else
+        break;
+    default:
         opc = Opcode::SRem;
+        break;
+    }
+
+    Operand lhsOp = buildExpr(lhs);
+    Operand rhsOp = buildExpr(rhs);
+    Operand result = newVReg();
 
     emit(Instruction::makeBinOp(opc, result, "i32", lhsOp, rhsOp));
     return result;
@@ -390,16 +368,16 @@ Operand IRBuilder::buildBinaryOp(const std::string &op, const ASTPtr &lhs, const
 
 // buildUnaryOp：生成一元运算 IR
 // '-' 生成 sub 0, x；'!' 生成 icmp eq x, 0；'+' 无操作
-Operand IRBuilder::buildUnaryOp(const std::string &op, const ASTPtr &expr) {
-    if (op == "-") {
-        if (auto num = std::dynamic_pointer_cast<NumberExpr>(expr))
+Operand IRBuilder::buildUnaryOp(UnaryOp op, const ASTNode *expr) {
+    if (op == UnaryOp::Minus) {
+        if (auto *num = dynCast<NumberExpr>(expr))
             return Operand::imm(-num->value);
         Operand inner = buildExpr(expr);
         Operand result = newVReg();
         emit(Instruction::makeBinOp(Opcode::Sub, result, "i32", Operand::imm(0), inner));
         return result;
     }
-    if (op == "!") {
+    if (op == UnaryOp::Not) {
         Operand inner = buildExpr(expr);
         Operand result = newVReg();
         emit(Instruction::makeICmp(CmpPred::EQ, result, "i32", inner, Operand::imm(0)));
@@ -410,24 +388,32 @@ Operand IRBuilder::buildUnaryOp(const std::string &op, const ASTPtr &expr) {
 }
 
 // buildComparison：生成比较运算 IR，输出 icmp 指令
-Operand IRBuilder::buildComparison(const std::string &op, const ASTPtr &lhs, const ASTPtr &rhs) {
+Operand IRBuilder::buildComparison(BinaryOp op, const ASTNode *lhs, const ASTNode *rhs) {
     Operand lhsOp = buildExpr(lhs);
     Operand rhsOp = buildExpr(rhs);
     Operand result = newVReg();
 
     CmpPred pred;
-    if (op == "==")
+    switch (op) {
+    case BinaryOp::Eq:
         pred = CmpPred::EQ;
-    else if (op == "!=")
+        break;
+    case BinaryOp::Ne:
         pred = CmpPred::NE;
-    else if (op == "<")
+        break;
+    case BinaryOp::Lt:
         pred = CmpPred::SLT;
-    else if (op == ">")
+        break;
+    case BinaryOp::Gt:
         pred = CmpPred::SGT;
-    else if (op == "<=")
+        break;
+    case BinaryOp::Le:
         pred = CmpPred::SLE;
-    else
+        break;
+    default:
         pred = CmpPred::SGE;
+        break;
+    }
 
     emit(Instruction::makeICmp(pred, result, "i32", lhsOp, rhsOp));
     return result;
@@ -438,14 +424,16 @@ Operand IRBuilder::buildComparison(const std::string &op, const ASTPtr &lhs, con
 //   && — lhs 为 false 则短路，结果为 false
 //   || — lhs 为 true 则短路，结果为 true
 // 结果通过 alloca i1 存储，最后 load 出来作为返回值
-Operand IRBuilder::buildLogicalOp(const std::string &op, const ASTPtr &lhs, const ASTPtr &rhs) {
+Operand IRBuilder::buildLogicalOp(BinaryOp op, const ASTNode *lhs, const ASTNode *rhs) {
     // 为短路逻辑分配结果变量
     Operand resultVar = newVReg();
     emit(Instruction::makeAlloca(resultVar, "i1", 1));
 
     Operand lhsOp = buildExpr(lhs);
+    // rhs 块中加载的值不支配 end 块；表达式不写变量，进入 rhs 前的缓存在 end 块仍然有效
+    size_t lhsLoaded = symbols_.loadMark();
 
-    if (op == "&&") {
+    if (op == BinaryOp::And) {
         std::string rhsName = newLabel("land_rhs");
         std::string falseName = newLabel("land_false");
         std::string endName = newLabel("land_end");
@@ -469,6 +457,7 @@ Operand IRBuilder::buildLogicalOp(const std::string &op, const ASTPtr &lhs, cons
         // end 块
         auto *endBB = createBlock(endName);
         setInsertBlock(endBB);
+        symbols_.rollbackLoads(lhsLoaded);
     } else { // "||"
         std::string trueName = newLabel("lor_true");
         std::string rhsName = newLabel("lor_rhs");
@@ -493,6 +482,7 @@ Operand IRBuilder::buildLogicalOp(const std::string &op, const ASTPtr &lhs, cons
         // end 块
         auto *endBB = createBlock(endName);
         setInsertBlock(endBB);
+        symbols_.rollbackLoads(lhsLoaded);
     }
 
     Operand result = newVReg();
@@ -501,22 +491,52 @@ Operand IRBuilder::buildLogicalOp(const std::string &op, const ASTPtr &lhs, cons
 }
 
 // buildCall：生成函数调用 IR，先生成所有实参的表达式，再发射 call 指令
-Operand IRBuilder::buildCall(const std::shared_ptr<CallExpr> &call) {
+Operand IRBuilder::buildCall(const CallExpr &call) {
     std::vector<Operand> args;
-    for (auto &arg : call->args)
+    for (const ASTNode *arg : call.args)
         args.push_back(buildExpr(arg));
     Operand result = newVReg();
-    emit(Instruction::makeCall(result, "i32", call->callee, std::move(args)));
+    emit(Instruction::makeCall(result, "i32", std::string(call.callee), std::move(args)));
     return result;
 }
 
 // ======================== 便捷函数 ========================
 
 // generateLLVMIR：一步完成 AST → IR 生成，返回 LLVM IR 文本
-std::string generateLLVMIR(const std::vector<std::shared_ptr<FuncDef>> &funcs) {
+std::string generateLLVMIR(const CompUnit &unit) {
     IRBuilder builder;
-    auto mod = builder.buildModule(funcs);
+    auto mod = builder.buildModule(unit);
     return mod->toString();
 }
 
+// ======================== 按需解析的源码模块 ========================
+
+LazySourceModule::LazySourceModule(std::string_view source)
+    : funcs_(Parser::indexFunctions(source)) {}
+
+// find：按名字查找函数下标（同名时取第一个），不存在时返回 -1
+int LazySourceModule::find(std::string_view name) const {
+    for (size_t i = 0; i < funcs_.size(); ++i)
+        if (funcs_[i].name == name)
+            return static_cast<int>(i);
+    return -1;
+}
+
+// take：片段只含一个函数定义，解析结果的 arena 在生成 IR 后随 CompUnit 一起释放
+std::unique_ptr<Function> LazySourceModule::take(size_t i) const {
+    CompUnit unit;
+    {
+        stats::ScopedTimer timer(stats::Phase::Parse);
+        Parser parser(funcs_[i].text, funcs_[i].line);
+        unit = parser.parseCompUnit();
+    }
+    if (unit.funcs.empty())
+        throw ParseError("Expected function definition at line " +
+                             std::to_string(funcs_[i].line),
+                         funcs_[i].line);
+    stats::ScopedTimer timer(stats::Phase::IRBuild);
+    IRBuilder builder;
+    return builder.buildFunction(*unit.funcs.front());
+}
+
 } // namespace toyc
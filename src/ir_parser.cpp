@@ -1,113 +1,328 @@
 #include "ir_parser.h"
+#include "statistics.h"
+#include "thread_pool.h"
 #include <algorithm>
-#include <regex>
-#include <sstream>
-#include <stdexcept>
-
+#include <charconv>
+#include <exception>
+#include <optional>
 
 namespace toyc {
 
 using namespace ir;
 
+namespace {
+
 // ======================== 辅助函数 ========================
 
-// trim：去除字符串前后的空白字符
-static std::string trim(const std::string &s) {
+// isSpace / isDigit / isWordChar：对应正则中的 \s、\d、\w
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+bool isWordChar(char c) {
+    return isDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+// trim：去除首尾的空白字符（返回原文本的子视图）
+std::string_view trim(std::string_view s) {
     size_t start = s.find_first_not_of(" \t\r\n");
-    if (start == std::string::npos)
-        return "";
+    if (start == std::string_view::npos)
+        return {};
     size_t end = s.find_last_not_of(" \t\r\n");
     return s.substr(start, end - start + 1);
 }
 
-// startsWith：判断字符串是否以指定前缀开头
-static bool startsWith(const std::string &s, const std::string &prefix) {
-    return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+// parseInt：把十进制数字串转为 int（溢出时返回 std::nullopt）
+std::optional<int> parseInt(std::string_view digits) {
+    int v = 0;
+    auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), v);
+    if (ec != std::errc() || end != digits.data() + digits.size())
+        return std::nullopt;
+    return v;
 }
 
-// ======================== parseModule ========================
+// forEachLine：逐行遍历文本（按 '\n' 切分，最后一行可以没有换行符）
+template <typename Fn> void forEachLine(std::string_view text, Fn &&fn) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t nl = text.find('\n', pos);
+        size_t end = nl == std::string_view::npos ? text.size() : nl;
+        fn(text.substr(pos, end - pos), pos);
+        pos = end + 1;
+    }
+}
 
-// parseModule：解析完整的 LLVM IR 文本为 Module
-// 遍历每一行，匹配 "define" 开头的函数定义，收集函数体直到 "}"
-std::unique_ptr<Module> IRParser::parseModule(const std::string &irText) {
-    auto mod = std::make_unique<Module>();
-    std::istringstream iss(irText);
-    std::string line;
+// ======================== 游标 ========================
+
+// Cursor：单行指令文本上的游标，逐段匹配关键字、单词与操作数（全部返回原文本的视图）
+class Cursor {
+  public:
+    explicit Cursor(std::string_view s) : s_(s) {}
+
+    bool atEnd() const { return pos_ == s_.size(); }
+    std::string_view rest() const { return s_.substr(pos_); }
+
+    // spaces：跳过空白，返回是否至少跳过了一个（\s+ 为真，\s* 忽略返回值）
+    bool spaces() {
+        size_t start = pos_;
+        while (pos_ < s_.size() && isSpace(s_[pos_]))
+            ++pos_;
+        return pos_ > start;
+    }
+
+    // literal：匹配字面量
+    bool literal(std::string_view lit) {
+        if (s_.substr(pos_).substr(0, lit.size()) != lit)
+            return false;
+        pos_ += lit.size();
+        return true;
+    }
+
+    // keyword：匹配字面量并至少跟一个空白（如 "ptr "、"label "）
+    bool keyword(std::string_view kw) {
+        size_t save = pos_;
+        if (literal(kw) && spaces())
+            return true;
+        pos_ = save;
+        return false;
+    }
+
+    // word：\w+，不匹配时返回空视图
+    std::string_view word() { return run(isWordChar); }
+
+    // digits：\d+，不匹配时返回空视图
+    std::string_view digits() { return run(isDigit); }
+
+    // vreg：%\d+
+    bool vreg(Operand &out) {
+        size_t save = pos_;
+        if (literal("%")) {
+            std::string_view d = digits();
+            if (!d.empty()) {
+                auto v = parseInt(d);
+                out = v ? Operand::vreg(*v) : Operand::none();
+                return true;
+            }
+        }
+        pos_ = save;
+        return false;
+    }
+
+    // integer：-?\d+（超出 int 范围时得到空操作数）
+    bool integer(Operand &out) {
+        size_t save = pos_;
+        literal("-");
+        if (digits().empty()) {
+            pos_ = save;
+            return false;
+        }
+        auto v = parseInt(s_.substr(save, pos_ - save)); // from_chars 直接处理负号
+        out = v ? Operand::imm(*v) : Operand::none();
+        return true;
+    }
 
-    // 收集函数文本
-    std::vector<std::pair<std::string, std::string>> funcTexts; // (defLine, body)
+    // boolLit：true | false
+    bool boolLit(Operand &out) {
+        if (literal("true")) {
+            out = Operand::boolLit(true);
+            return true;
+        }
+        if (literal("false")) {
+            out = Operand::boolLit(false);
+            return true;
+        }
+        return false;
+    }
+
+    // value：%\d+ | -?\d+
+    bool value(Operand &out) { return vreg(out) || integer(out); }
+
+    // label：%name（name 为不含空白、逗号与 "]" 的一段字符）
+    bool label(std::string_view &name) {
+        if (!literal("%"))
+            return false;
+        size_t start = pos_;
+        while (pos_ < s_.size() && !isSpace(s_[pos_]) && s_[pos_] != ',' && s_[pos_] != ']')
+            ++pos_;
+        name = s_.substr(start, pos_ - start);
+        return !name.empty();
+    }
+
+    // align：可选的 ", align N" 后缀（N 超出 int 范围时匹配失败）
+    bool alignSuffix(int &align) {
+        size_t save = pos_;
+        if (literal(",")) {
+            spaces();
+            if (keyword("align")) {
+                if (auto v = parseInt(digits())) {
+                    align = *v;
+                    return true;
+                }
+            }
+            pos_ = save;
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    std::string_view s_;
+    size_t pos_ = 0;
+
+    template <typename Pred> std::string_view run(Pred pred) {
+        size_t start = pos_;
+        while (pos_ < s_.size() && pred(s_[pos_]))
+            ++pos_;
+        return s_.substr(start, pos_ - start);
+    }
+};
+
+// parseCallArgs：在参数文本中依次查找 "i32 [noundef] <value>"，与实参一一对应
+std::vector<Operand> parseCallArgs(std::string_view args) {
+    std::vector<Operand> result;
+    size_t pos = 0;
+    while ((pos = args.find("i32", pos)) != std::string_view::npos) {
+        Cursor c(args.substr(pos + 3));
+        Operand op;
+        if (c.spaces()) {
+            Cursor save = c;
+            if (!(c.keyword("noundef") && c.value(op))) {
+                c = save;
+                if (!c.value(op)) {
+                    ++pos;
+                    continue;
+                }
+            }
+            result.push_back(op);
+            pos = args.size() - c.rest().size();
+            continue;
+        }
+        ++pos;
+    }
+    return result;
+}
+
+} // namespace
+
+// ======================== indexFunctions ========================
+
+/**
+ * @brief 扫描出所有函数的定义行与函数体区间
+ * @details 逐行查看去除空白后的内容：以 "define " 开头的行开始一个函数（未闭合的前一个函数被丢弃），
+ *   函数内遇到 "}" 行即闭合；函数之外的行（声明、元数据、属性等）全部忽略。
+ *   只记录视图，不复制任何文本
+ */
+std::vector<IRParser::FunctionText> IRParser::indexFunctions(std::string_view irText) {
+    std::vector<FunctionText> funcs;
     bool inFunc = false;
-    std::string defLine;
-    std::string body;
+    FunctionText cur;
+    size_t bodyStart = 0;
 
-    while (std::getline(iss, line)) {
-        std::string trimmed = trim(line);
-        if (startsWith(trimmed, "define ")) {
+    forEachLine(irText, [&](std::string_view line, size_t offset) {
+        std::string_view t = trim(line);
+        if (t.substr(0, 7) == "define ") {
             inFunc = true;
-            defLine = trimmed;
-            body.clear();
-            continue;
+            cur.defLine = t;
+            bodyStart = std::min(offset + line.size() + 1, irText.size());
+            return;
         }
-        if (inFunc) {
-            if (trimmed == "}") {
-                funcTexts.push_back({defLine, body});
-                inFunc = false;
-            } else {
-                body += line + "\n";
-            }
+        if (inFunc && t == "}") {
+            cur.body = irText.substr(bodyStart, offset - bodyStart);
+            funcs.push_back(cur);
+            inFunc = false;
         }
+    });
+    return funcs;
+}
+
+// functionName：定义行中第一个 "@" 后的标识符
+std::string_view IRParser::functionName(std::string_view defLine) {
+    size_t at = 0;
+    while ((at = defLine.find('@', at)) != std::string_view::npos) {
+        Cursor c(defLine.substr(at + 1));
+        std::string_view name = c.word();
+        if (!name.empty())
+            return name;
+        ++at;
     }
+    return {};
+}
+
+// ======================== parseModule ========================
 
-    for (auto &[def, funcBody] : funcTexts) {
-        auto func = parseFunctionFromDefAndBody(def, funcBody);
-        if (func)
-            mod->functions.push_back(std::move(func));
+/**
+ * @brief 解析完整的 LLVM IR 文本为 Module
+ * @details 先用 indexFunctions 定位所有函数，再逐个解析。jobs > 1 时每个函数作为一个任务
+ *   提交到线程池（函数之间只共享线程安全的全局字符串驻留表），结果按下标放回，
+ *   因此函数顺序与串行解析相同；任一任务抛出的异常在所有任务结束后按函数顺序重新抛出
+ */
+std::unique_ptr<Module> IRParser::parseModule(std::string_view irText, unsigned jobs) const {
+    auto mod = std::make_unique<Module>();
+    std::vector<FunctionText> texts = indexFunctions(irText);
+    const size_t n = texts.size();
+    mod->functions.resize(n);
+
+    if (jobs <= 1 || n <= 1) {
+        for (size_t i = 0; i < n; ++i)
+            mod->functions[i] = parseFunction(texts[i]);
+        return mod;
     }
 
+    std::vector<std::exception_ptr> errors(n);
+    {
+        // 线程池析构时执行完所有剩余任务再回收线程，离开作用域即全部解析完成
+        ThreadPool pool(static_cast<unsigned>(std::min<size_t>(jobs, n)));
+        for (size_t i = 0; i < n; ++i) {
+            pool.submit([&, i] {
+                try {
+                    mod->functions[i] = parseFunction(texts[i]);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+    }
+    for (auto &e : errors) {
+        if (e)
+            std::rethrow_exception(e);
+    }
     return mod;
 }
 
 // ======================== parseFunction ========================
 
-// parseFunction：解析指定名称的函数，若 funcName 为空则返回第一个函数
-std::unique_ptr<Function> IRParser::parseFunction(const std::string &irText,
-                                                  const std::string &funcName) {
-    auto mod = parseModule(irText);
-    if (mod->functions.empty())
-        return nullptr;
-    if (funcName.empty())
-        return std::move(mod->functions[0]);
-    for (auto &f : mod->functions) {
-        if (f->name == funcName)
-            return std::move(f);
+// parseFunction：定位指定名称的函数并只解析它，若 funcName 为空则解析第一个函数
+std::unique_ptr<Function> IRParser::parseFunction(std::string_view irText,
+                                                  std::string_view funcName) const {
+    for (const auto &text : indexFunctions(irText)) {
+        if (funcName.empty() || functionName(text.defLine) == funcName)
+            return parseFunction(text);
     }
     return nullptr;
 }
 
-// ======================== 内部辅助：从定义行和函数体构建 Function ========================
-
-// parseFunctionFromDefAndBody：从函数定义行和函数体文本构建 Function 对象
-// 1. 用正则解析函数名、返回类型、参数列表
-// 2. 创建入口基本块，逐行解析标签和指令
-// 3. 跟踪最大虚拟寄存器 ID
-std::unique_ptr<Function> IRParser::parseFunctionFromDefAndBody(const std::string &defLine,
-                                                                const std::string &body) {
-
+/**
+ * @brief 从函数定义行和函数体文本构建 Function 对象
+ * @details 1. 从定义行取出函数名、返回类型、参数列表
+ *   2. 创建入口基本块，逐行解析标签和指令（行尾 ";" 注释被忽略，如 clang 的 "; preds = ..."）
+ *   3. 跟踪最大虚拟寄存器 ID
+ */
+std::unique_ptr<Function> IRParser::parseFunction(const FunctionText &text) const {
+    stats::ScopedTimer timer(stats::Phase::IRLoad);
     auto func = std::make_unique<Function>();
+    const std::string_view defLine = text.defLine;
 
-    // 解析函数名
-    std::regex nameRe("@(\\w+)");
-    std::smatch m;
-    if (std::regex_search(defLine, m, nameRe))
-        func->name = m[1].str();
+    // 函数名
+    func->name = functionName(defLine);
 
-    // 解析返回类型
-    if (defLine.find("void") != std::string::npos && defLine.find("void") < defLine.find("@"))
+    // 返回类型（"void" 出现在函数名之前）
+    size_t voidPos = defLine.find("void");
+    if (voidPos != std::string_view::npos && voidPos < defLine.find('@'))
         func->returnType = "void";
     else
         func->returnType = "int";
 
-    // 解析参数
+    // 参数
     func->paramVregs = parseParameters(defLine);
     for (size_t i = 0; i < func->paramVregs.size(); ++i)
         func->params.push_back({std::to_string(func->paramVregs[i]), "i32"});
@@ -121,195 +336,296 @@ std::unique_ptr<Function> IRParser::parseFunctionFromDefAndBody(const std::strin
     BasicBlock *currentBB = entryBB.get();
     func->blocks.push_back(std::move(entryBB));
 
-    // 逐行解析
-    std::istringstream iss(body);
-    std::string line;
     int maxVreg = -1;
-
-    // 先更新 maxVreg 用参数
     for (auto v : func->paramVregs)
-        if (v > maxVreg)
-            maxVreg = v;
+        maxVreg = std::max(maxVreg, v);
 
-    while (std::getline(iss, line)) {
-        std::string trimmed = trim(line);
-        if (trimmed.empty() || startsWith(trimmed, ";"))
-            continue;
+    forEachLine(text.body, [&](std::string_view line, size_t) {
+        std::string_view t = trim(line);
+        size_t comment = t.find(';');
+        if (comment != std::string_view::npos)
+            t = trim(t.substr(0, comment));
+        if (t.empty())
+            return;
 
         // 标签行
-        if (trimmed.back() == ':') {
-            std::string label = trimmed.substr(0, trimmed.size() - 1);
-            label = trim(label);
-
+        if (t.back() == ':') {
+            std::string label(trim(t.substr(0, t.size() - 1)));
             auto bb = std::make_unique<BasicBlock>();
             bb->id = static_cast<int>(func->blocks.size());
             bb->name = label;
             func->blockMap[label] = bb.get();
             currentBB = bb.get();
             func->blocks.push_back(std::move(bb));
-            continue;
+            return;
         }
 
         // 指令行
-        Instruction inst = parseInstruction(trimmed);
-        int dr = inst.defReg();
-        if (dr > maxVreg)
-            maxVreg = dr;
+        Instruction inst = parseInstruction(t);
+        maxVreg = std::max(maxVreg, inst.defReg());
         for (int u : inst.useRegs())
-            if (u > maxVreg)
-                maxVreg = u;
+            maxVreg = std::max(maxVreg, u);
 
         inst.blockId = currentBB->id;
-        currentBB->insts.push_back(std::make_unique<Instruction>(std::move(inst)));
-    }
+        currentBB->insts.push_back(func->newInst(std::move(inst)));
+    });
 
     func->maxVregId = maxVreg;
     return func;
 }
 
+// ======================== LazyIRModule ========================
+
+// LazyIRModule：只建立函数索引，不解析任何函数体
+LazyIRModule::LazyIRModule(std::string_view irText)
+    : texts_(IRParser::indexFunctions(irText)), loaded_(texts_.size()) {}
+
+// find：按名字查找函数下标（同名时取第一个），不存在时返回 -1
+int LazyIRModule::find(std::string_view name) const {
+    for (size_t i = 0; i < texts_.size(); ++i) {
+        if (this->name(i) == name)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// function：首次访问时解析第 i 个函数并缓存
+Function &LazyIRModule::function(size_t i) {
+    if (!loaded_[i])
+        loaded_[i] = parser_.parseFunction(texts_[i]);
+    return *loaded_[i];
+}
+
+// take：交出第 i 个函数（已缓存则移出缓存，否则直接解析）
+std::unique_ptr<Function> LazyIRModule::take(size_t i) {
+    if (loaded_[i])
+        return std::move(loaded_[i]);
+    return parser_.parseFunction(texts_[i]);
+}
+
 // ======================== parseParameters ========================
 
-// parseParameters：从函数定义行提取参数虚拟寄存器 ID
-// 匹配括号内的 %数字 模式
-std::vector<int> IRParser::parseParameters(const std::string &defLine) {
+// parseParameters：从定义行第一对括号内依次提取 %数字 形式的参数寄存器
+std::vector<int> IRParser::parseParameters(std::string_view defLine) const {
     std::vector<int> paramVregs;
-    // 找到 ( ... ) 部分
     auto lp = defLine.find('(');
     auto rp = defLine.find(')');
-    if (lp == std::string::npos || rp == std::string::npos)
+    if (lp == std::string_view::npos || rp == std::string_view::npos)
         return paramVregs;
 
-    std::string paramStr = defLine.substr(lp + 1, rp - lp - 1);
-    // 匹配 %数字
-    std::regex paramRe("%(\\d+)");
-    auto begin = std::sregex_iterator(paramStr.begin(), paramStr.end(), paramRe);
-    auto end = std::sregex_iterator();
-    for (auto it = begin; it != end; ++it) {
-        paramVregs.push_back(std::stoi((*it)[1].str()));
+    std::string_view params = defLine.substr(lp + 1, rp > lp ? rp - lp - 1 : std::string_view::npos);
+    size_t pos = 0;
+    while ((pos = params.find('%', pos)) != std::string_view::npos) {
+        Cursor c(params.substr(pos + 1));
+        std::string_view d = c.digits();
+        if (auto v = parseInt(d); !d.empty() && v)
+            paramVregs.push_back(*v);
+        pos += 1 + d.size();
     }
     return paramVregs;
 }
 
 // ======================== parseInstruction ========================
 
-// parseInstruction：解析单行 LLVM IR 指令为结构化 Instruction
-// 按优先级尝试匹配：ret → br → store → %def = ... （alloca/load/call/icmp/算术）
-Instruction IRParser::parseInstruction(const std::string &line) {
-    std::string s = trim(line);
+/**
+ * @brief 解析单行 LLVM IR 指令为结构化 Instruction
+ * @details 由游标按固定格式逐段匹配，按顺序尝试：ret → br → store → %def = ...
+ *   （alloca / load / icmp / phi / copy / 算术 / call）→ call（无返回值）。任何一段不匹配即换下一种格式，
+ *   全部失败时返回 ret void 占位
+ */
+Instruction IRParser::parseInstruction(std::string_view line) const {
+    const std::string_view s = trim(line);
 
     // ret void
     if (s == "ret void")
         return Instruction::makeRetVoid();
 
-    // ret i32 %X / ret i32 N
-    if (startsWith(s, "ret ")) {
-        // ret type value
-        std::regex retRe(R"(ret\s+(\w+)\s+(.+))");
-        std::smatch m;
-        if (std::regex_match(s, m, retRe)) {
-            return Instruction::makeRet(m[1].str(), parseOperand(trim(m[2].str())));
-        }
+    // ret type value
+    if (s.substr(0, 4) == "ret ") {
+        Cursor c(s);
+        c.keyword("ret");
+        std::string_view type = c.word();
+        if (!type.empty() && c.spaces() && !c.atEnd())
+            return Instruction::makeRet(std::string(type), parseOperand(c.rest()));
         return Instruction::makeRetVoid();
     }
 
     // br label %target
-    if (startsWith(s, "br label ")) {
-        std::regex brRe(R"(br\s+label\s+%(\S+))");
-        std::smatch m;
-        if (std::regex_match(s, m, brRe))
-            return Instruction::makeBr(Operand::label(m[1].str()));
+    if (s.substr(0, 9) == "br label ") {
+        Cursor c(s);
+        std::string_view target;
+        if (c.keyword("br") && c.keyword("label") && c.label(target) && c.atEnd())
+            return Instruction::makeBr(Operand::label(target));
     }
 
-    // br i1 %cond, label %true, label %false
-    if (startsWith(s, "br i1 ")) {
-        std::regex condBrRe(R"(br\s+i1\s+(%\d+|true|false),\s*label\s+%(\S+),\s*label\s+%(\S+))");
-        std::smatch m;
-        if (std::regex_match(s, m, condBrRe)) {
-            return Instruction::makeCondBr(parseOperand(m[1].str()), Operand::label(m[2].str()),
-                                           Operand::label(m[3].str()));
+    // br i1 %cond, label %true, label %false（条件也可以是常量：mem2reg 会把已知值直接代入）
+    if (s.substr(0, 6) == "br i1 ") {
+        Cursor c(s);
+        Operand cond;
+        std::string_view t, f;
+        if (c.keyword("br") && c.keyword("i1") && (c.value(cond) || c.boolLit(cond)) &&
+            c.literal(",")) {
+            c.spaces();
+            if (c.keyword("label") && c.label(t) && c.literal(",")) {
+                c.spaces();
+                if (c.keyword("label") && c.label(f) && c.atEnd())
+                    return Instruction::makeCondBr(cond, Operand::label(t), Operand::label(f));
+            }
         }
     }
 
     // store type value, ptr %ptr, align N
-    if (startsWith(s, "store ")) {
-        std::regex storeRe(
-            R"(store\s+(\w+)\s+(%\d+|\-?\d+|true|false),\s*ptr\s+(%\d+)(?:,\s*align\s+(\d+))?)");
-        std::smatch m;
-        if (std::regex_match(s, m, storeRe)) {
-            int align = m[4].matched ? std::stoi(m[4].str()) : 4;
-            return Instruction::makeStore(m[1].str(), parseOperand(m[2].str()),
-                                          parseOperand(m[3].str()), align);
+    if (s.substr(0, 6) == "store ") {
+        Cursor c(s);
+        c.keyword("store");
+        std::string_view type = c.word();
+        Operand value, ptr;
+        int align = 4;
+        if (!type.empty() && c.spaces() && (c.value(value) || c.boolLit(value)) &&
+            c.literal(",")) {
+            c.spaces();
+            if (c.keyword("ptr") && c.vreg(ptr) && c.alignSuffix(align) && c.atEnd())
+                return Instruction::makeStore(std::string(type), value, ptr, align);
         }
     }
 
     // %def = ...
-    std::regex defRe(R"((%\d+)\s*=\s*(.*))");
-    std::smatch dm;
-    if (std::regex_match(s, dm, defRe)) {
-        Operand defOp = parseOperand(dm[1].str());
-        std::string rhs = trim(dm[2].str());
+    Operand defOp;
+    std::string_view rhs = s;
+    bool hasDef = false;
+    {
+        Cursor c(s);
+        if (c.vreg(defOp)) {
+            c.spaces();
+            if (!c.literal("="))
+                return Instruction::makeRetVoid(); // "%N" 开头却不是定义
+            c.spaces();
+            rhs = c.rest();
+            hasDef = true;
+        }
+    }
 
+    if (hasDef) {
         // alloca type, align N
-        if (startsWith(rhs, "alloca ")) {
-            std::regex allocaRe(R"(alloca\s+(\w+)(?:,\s*align\s+(\d+))?)");
-            std::smatch m;
-            if (std::regex_match(rhs, m, allocaRe)) {
-                int align = m[2].matched ? std::stoi(m[2].str()) : 4;
-                return Instruction::makeAlloca(defOp, m[1].str(), align);
-            }
+        if (rhs.substr(0, 7) == "alloca ") {
+            Cursor c(rhs);
+            c.keyword("alloca");
+            std::string_view type = c.word();
+            int align = 4;
+            if (!type.empty() && c.alignSuffix(align) && c.atEnd())
+                return Instruction::makeAlloca(defOp, std::string(type), align);
         }
 
         // load type, ptr %ptr, align N
-        if (startsWith(rhs, "load ")) {
-            std::regex loadRe(R"(load\s+(\w+),\s*ptr\s+(%\d+)(?:,\s*align\s+(\d+))?)");
-            std::smatch m;
-            if (std::regex_match(rhs, m, loadRe)) {
-                int align = m[3].matched ? std::stoi(m[3].str()) : 4;
-                return Instruction::makeLoad(defOp, m[1].str(), parseOperand(m[2].str()), align);
+        if (rhs.substr(0, 5) == "load ") {
+            Cursor c(rhs);
+            c.keyword("load");
+            std::string_view type = c.word();
+            Operand ptr;
+            int align = 4;
+            if (!type.empty() && c.literal(",")) {
+                c.spaces();
+                if (c.keyword("ptr") && c.vreg(ptr) && c.alignSuffix(align) && c.atEnd())
+                    return Instruction::makeLoad(defOp, std::string(type), ptr, align);
             }
         }
 
-        // call type @func(args...)
-        if (startsWith(rhs, "call ")) {
-            std::regex callRe(R"(call\s+(\w+)\s+@(\w+)\((.*)\))");
-            std::smatch m;
-            if (std::regex_match(rhs, m, callRe)) {
-                std::string retType = m[1].str();
-                std::string callee = m[2].str();
-                std::string argStr = m[3].str();
-                std::vector<Operand> args;
-                if (!argStr.empty()) {
-                    // 逐个拆分参数 "i32 noundef %X"
-                    std::regex argRe(R"((?:i32\s+(?:noundef\s+)?)(%\d+|\-?\d+))");
-                    auto begin = std::sregex_iterator(argStr.begin(), argStr.end(), argRe);
-                    auto end = std::sregex_iterator();
-                    for (auto it = begin; it != end; ++it) {
-                        args.push_back(parseOperand((*it)[1].str()));
-                    }
+        // icmp pred type lhs, rhs
+        if (rhs.substr(0, 5) == "icmp ") {
+            Cursor c(rhs);
+            c.keyword("icmp");
+            std::string_view pred = c.word();
+            Operand a, b;
+            if (!pred.empty() && c.spaces()) {
+                std::string_view type = c.word();
+                if (!type.empty() && c.spaces() && c.value(a) && c.literal(",")) {
+                    c.spaces();
+                    if (c.value(b) && c.atEnd())
+                        return Instruction::makeICmp(stringToCmpPred(std::string(pred)), defOp,
+                                                     std::string(type), a, b);
                 }
-                return Instruction::makeCall(defOp, retType, callee, std::move(args));
             }
         }
 
-        // icmp pred type lhs, rhs
-        if (startsWith(rhs, "icmp ")) {
-            std::regex icmpRe(R"(icmp\s+(\w+)\s+(\w+)\s+(%\d+|\-?\d+),\s*(%\d+|\-?\d+))");
-            std::smatch m;
-            if (std::regex_match(rhs, m, icmpRe)) {
-                CmpPred pred = stringToCmpPred(m[1].str());
-                return Instruction::makeICmp(pred, defOp, m[2].str(), parseOperand(m[3].str()),
-                                             parseOperand(m[4].str()));
+        // phi type [ value, %pred ], ...
+        if (rhs.substr(0, 4) == "phi ") {
+            Cursor c(rhs);
+            c.keyword("phi");
+            std::string_view type = c.word();
+            Instruction phi = Instruction::makePhi(defOp, std::string(type));
+            bool ok = !type.empty() && c.spaces();
+            while (ok) {
+                Operand value;
+                std::string_view pred;
+                ok = c.literal("[");
+                c.spaces();
+                ok = ok && (c.value(value) || c.boolLit(value)) && c.literal(",");
+                c.spaces();
+                ok = ok && c.label(pred);
+                c.spaces();
+                ok = ok && c.literal("]");
+                if (!ok)
+                    break;
+                phi.addIncoming(value, pred);
+                c.spaces();
+                if (c.atEnd())
+                    return phi;
+                ok = c.literal(",");
+                c.spaces();
             }
         }
 
-        // 算术运算: add/sub/mul/sdiv/srem [nsw] type lhs, rhs
-        std::regex arithRe(
-            R"((add|sub|mul|sdiv|srem)\s+(?:nsw\s+)?(\w+)\s+(%\d+|\-?\d+),\s*(%\d+|\-?\d+))");
-        std::smatch am;
-        if (std::regex_match(rhs, am, arithRe)) {
-            Opcode opc = stringToArithOpcode(am[1].str());
-            return Instruction::makeBinOp(opc, defOp, am[2].str(), parseOperand(am[3].str()),
-                                          parseOperand(am[4].str()));
+        // copy type value
+        if (rhs.substr(0, 5) == "copy ") {
+            Cursor c(rhs);
+            c.keyword("copy");
+            std::string_view type = c.word();
+            Operand value;
+            if (!type.empty() && c.spaces() && (c.value(value) || c.boolLit(value)) && c.atEnd())
+                return Instruction::makeCopy(defOp, std::string(type), value);
+        }
+
+        // 算术运算：add/sub/mul/sdiv/srem [nsw] type lhs, rhs
+        {
+            Cursor c(rhs);
+            std::string_view op = c.word();
+            if ((op == "add" || op == "sub" || op == "mul" || op == "sdiv" || op == "srem") &&
+                c.spaces()) {
+                bool nsw = c.keyword("nsw");
+                std::string_view type = c.word();
+                Operand a, b; // SCCP 折叠 || / && 后可能留下 true / false 操作数
+                if (!type.empty() && c.spaces() && (c.value(a) || c.boolLit(a)) &&
+                    c.literal(",")) {
+                    c.spaces();
+                    if ((c.value(b) || c.boolLit(b)) && c.atEnd()) {
+                        Instruction inst = Instruction::makeBinOp(
+                            stringToArithOpcode(std::string(op)), defOp, std::string(type), a, b);
+                        inst.nsw = nsw;
+                        return inst;
+                    }
+                }
+            }
+        }
+    }
+
+    // [tail] call type @func(args...)（无 %def 时为无返回值的调用语句，如 clang 输出的 call void @f(...)）
+    const bool tail = rhs.substr(0, 5) == "tail ";
+    if (tail)
+        rhs.remove_prefix(5);
+    if (rhs.substr(0, 5) == "call " && rhs.back() == ')') {
+        Cursor c(rhs);
+        c.keyword("call");
+        std::string_view retType = c.word();
+        if (!retType.empty() && c.spaces() && c.literal("@")) {
+            std::string_view callee = c.word();
+            if (!callee.empty() && c.literal("(")) {
+                std::string_view args = c.rest();
+                args.remove_suffix(1);
+                Instruction inst = Instruction::makeCall(
+                    defOp, std::string(retType), std::string(callee), parseCallArgs(args));
+                inst.tail = tail;
+                return inst;
+            }
         }
     }
 
@@ -319,10 +635,10 @@ Instruction IRParser::parseInstruction(const std::string &line) {
 
 // ======================== parseOperand ========================
 
-// parseOperand：解析操作数字符串
-// "%N" → VReg，"%name" → Label，数字 → Imm，"true"/"false" → BoolLit
-Operand IRParser::parseOperand(const std::string &text) {
-    std::string s = trim(text);
+// parseOperand：解析操作数文本
+// "%N" → VReg，"%name" → Label，数字（允许前导符号与尾随内容）→ Imm，"true"/"false" → BoolLit
+Operand IRParser::parseOperand(std::string_view text) const {
+    std::string_view s = trim(text);
     if (s.empty())
         return Operand::none();
 
@@ -332,22 +648,24 @@ Operand IRParser::parseOperand(const std::string &text) {
         return Operand::boolLit(false);
 
     if (s[0] == '%') {
-        std::string numStr = s.substr(1);
+        std::string_view name = s.substr(1);
         // 如果全是数字，就是虚拟寄存器
-        bool allDigit = !numStr.empty() && std::all_of(numStr.begin(), numStr.end(), ::isdigit);
-        if (allDigit)
-            return Operand::vreg(std::stoi(numStr));
+        if (!name.empty() && std::all_of(name.begin(), name.end(), isDigit)) {
+            auto v = parseInt(name);
+            return v ? Operand::vreg(*v) : Operand::none();
+        }
         // 否则是标签
-        return Operand::label(numStr);
-    }
-
-    // 尝试解析为整型常量
-    try {
-        return Operand::imm(std::stoi(s));
-    } catch (...) {
+        return Operand::label(name);
     }
 
-    return Operand::none();
+    // 整型常量：可选的 +/- 号后跟数字，忽略其后的内容
+    if (s[0] == '+')
+        s.remove_prefix(1);
+    size_t end = s[0] == '-' ? 1 : 0;
+    while (end < s.size() && isDigit(s[end]))
+        ++end;
+    auto v = parseInt(s.substr(0, end));
+    return v ? Operand::imm(*v) : Operand::none();
 }
 
 } // namespace toyc
@@ -0,0 +1,60 @@
+#include "ir_passes.h"
+#include "ir_analysis.h"
+#include "statistics.h"
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+// ======================== 优化流水线 ========================
+
+// optimizeFunction：-O1 / -O2 目前都执行 mem2reg → 自递归消除 → SCCP → CFG 化简 → GVN → 循环优化
+// → DCE → CFG 化简 → 尾调用标记（SCCP 依赖 mem2reg 产生的 SSA 值；自递归改写出的循环随后参与常量传播与
+//  循环优化；第一次 CFG 化简穿透 && / || 的布尔 phi，比较直接跳到目标后支配关系变得更紧，
+//  GVN 才能看到跨越原汇合点的冗余；GVN 放在常量折叠之后，相同的常量运算已不存在；
+//  LICM 在 GVN 之后，循环内只剩下各不相同的不变量；DCE 清理前面留下的无用定义，
+//  CFG 化简合并它们留下的空块与直线块；尾调用标记看的是最终的指令顺序）
+void optimizeFunction(Function &F, int level) {
+    if (level <= 0)
+        return;
+    stats::ScopedTimer timer(stats::Phase::Optimize);
+    int promoted = promoteMemoryToRegisters(F);
+    stats::add(stats::Counter::Promoted, static_cast<uint64_t>(promoted));
+    eliminateTailRecursion(F);
+    propagateConstants(F);
+    simplifyCFG(F);
+    eliminateCommonSubexpressions(F);
+    optimizeLoops(F);
+    eliminateDeadCode(F);
+    simplifyCFG(F);
+    markTailCalls(F);
+}
+
+/**
+ * @brief 优化整个模块
+ * @details 按调用图的强连通分量自底向上处理：轮到一个函数时，它调用的（不在同一分量中的）函数
+ *   都已经优化完毕，内联的是优化后的函数体，代价也按优化后的大小估计。
+ *   内联之后再执行一遍函数级流水线：常量实参传播进被内联的函数体，跨越原调用边界的冗余得以删除。
+ *   自递归被改写为循环的函数随即不再视为递归，它的调用者可以内联它
+ */
+void optimizeModule(Module &mod, int level, int inlineLimit) {
+    if (level <= 0)
+        return;
+    if (inlineLimit <= 0) {
+        for (auto &F : mod.functions)
+            optimizeFunction(*F, level);
+        return;
+    }
+    CallGraph CG(mod);
+    for (const auto &scc : CG.bottomUpSCCs())
+        for (Function *F : scc) {
+            optimizeFunction(*F, level);
+            CG.refreshSelfRecursion(F);
+            if (inlineCalls(*F, CG, inlineLimit) > 0)
+                optimizeFunction(*F, level);
+        }
+}
+
+} // namespace opt
+} // namespace toyc
@@ -1,14 +1,219 @@
 #include "lexer.h"
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 
-// 关键字映射表：将标识符字符串映射到对应的 TokenType
-static const std::unordered_map<std::string, TokenType> keywords = {
-    {"int", TokenType::INT},     {"void", TokenType::VOID},        {"if", TokenType::IF},
-    {"else", TokenType::ELSE},   {"while", TokenType::WHILE},      {"return", TokenType::RETURN},
-    {"break", TokenType::BREAK}, {"continue", TokenType::CONTINUE}};
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TOYC_LEXER_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TOYC_LEXER_NEON 1
+#endif
+
+#pragma region 字符分类表
+
+namespace {
+
+// 字符类别位：一次查表即可判断空白 / 标识符首字符 / 数字
+enum CharClass : uint8_t {
+    CC_SPACE = 1 << 0,    // isspace：' ' \t \n \v \f \r
+    CC_ID_START = 1 << 1, // 字母或 '_'
+    CC_DIGIT = 1 << 2,    // '0'..'9'
+    CC_ID_CONT = CC_ID_START | CC_DIGIT,
+};
+
+// buildCharClassTable：编译期生成 256 项字符类别表（非 ASCII 字节不属于任何类别）
+constexpr std::array<uint8_t, 256> buildCharClassTable() {
+    std::array<uint8_t, 256> t{};
+    for (int c : {' ', '\t', '\n', '\v', '\f', '\r'})
+        t[c] = CC_SPACE;
+    for (int c = 'a'; c <= 'z'; ++c)
+        t[c] = t[c - 'a' + 'A'] = CC_ID_START;
+    t['_'] = CC_ID_START;
+    for (int c = '0'; c <= '9'; ++c)
+        t[c] = CC_DIGIT;
+    return t;
+}
+
+constexpr std::array<uint8_t, 256> kCharClass = buildCharClassTable();
+
+inline bool hasClass(char c, uint8_t cls) { return kCharClass[static_cast<unsigned char>(c)] & cls; }
+
+} // namespace
+
+#pragma endregion
+
+#pragma region SIMD 扫描
+
+namespace {
+
+// 16 字节块比较：每个字节得到一个掩码位（SSE2 每字节 1 位，NEON 每字节 4 位）
+#if defined(TOYC_LEXER_SSE2)
+using Vec = __m128i;
+using Mask = uint32_t;
+constexpr int kBitsPerByte = 1;
+constexpr Mask kFullMask = 0xFFFF;
+
+inline Vec load16(const char *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+inline Mask toMask(Vec v) { return static_cast<Mask>(_mm_movemask_epi8(v)); }
+inline Vec eqByte(Vec v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+inline Vec orVec(Vec a, Vec b) { return _mm_or_si128(a, b); }
+// inRange：无符号比较 lo <= v <= hi（v - lo 在 [0, hi - lo] 内 ⇔ min(v - lo, hi - lo) == v - lo）
+inline Vec inRange(Vec v, char lo, char hi) {
+    Vec d = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(static_cast<char>(hi - lo))), d);
+}
+inline Vec lowerAscii(Vec v) { return _mm_or_si128(v, _mm_set1_epi8(0x20)); }
+#elif defined(TOYC_LEXER_NEON)
+using Vec = uint8x16_t;
+using Mask = uint64_t;
+constexpr int kBitsPerByte = 4;
+constexpr Mask kFullMask = ~Mask(0);
+
+inline Vec load16(const char *p) { return vld1q_u8(reinterpret_cast<const uint8_t *>(p)); }
+// toMask：shrn 把每个 0x00/0xFF 字节压成 4 位，得到 64 位掩码
+inline Mask toMask(Vec v) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+}
+inline Vec eqByte(Vec v, char c) { return vceqq_u8(v, vdupq_n_u8(static_cast<uint8_t>(c))); }
+inline Vec orVec(Vec a, Vec b) { return vorrq_u8(a, b); }
+inline Vec inRange(Vec v, char lo, char hi) {
+    return vcleq_u8(vsubq_u8(v, vdupq_n_u8(static_cast<uint8_t>(lo))),
+                    vdupq_n_u8(static_cast<uint8_t>(hi - lo)));
+}
+inline Vec lowerAscii(Vec v) { return vorrq_u8(v, vdupq_n_u8(0x20)); }
+#endif
+
+#if defined(TOYC_LEXER_SSE2) || defined(TOYC_LEXER_NEON)
+#define TOYC_LEXER_SIMD 1
+
+inline Mask spaceMask(Vec v) { return toMask(orVec(eqByte(v, ' '), inRange(v, '\t', '\r'))); }
+inline Mask digitMask(Vec v) { return toMask(inRange(v, '0', '9')); }
+inline Mask identMask(Vec v) {
+    return toMask(orVec(orVec(inRange(lowerAscii(v), 'a', 'z'), inRange(v, '0', '9')),
+                        eqByte(v, '_')));
+}
+#endif
+
+// scanSpaces：跳过 [p, end) 开头的空白，返回第一个非空白位置，并累加其中的换行数
+const char *scanSpaces(const char *p, const char *end, int &newlines) {
+    // 词法单元之间多为单个空格：先逐字节试探两次，较长的缩进 / 空行段再交给 SIMD
+    for (int i = 0; i < 2; ++i, ++p) {
+        if (p == end || !hasClass(*p, CC_SPACE))
+            return p;
+        newlines += *p == '\n';
+    }
+#ifdef TOYC_LEXER_SIMD
+    while (end - p >= 16) {
+        Vec v = load16(p);
+        Mask rest = ~spaceMask(v) & kFullMask; // 非空白字节
+        Mask nl = toMask(eqByte(v, '\n'));
+        if (rest == 0) {
+            newlines += std::popcount(nl) / kBitsPerByte;
+            p += 16;
+            continue;
+        }
+        int bit = std::countr_zero(rest);
+        newlines += std::popcount(nl & ((Mask(1) << bit) - 1)) / kBitsPerByte;
+        return p + bit / kBitsPerByte;
+    }
+#endif
+    for (; p < end && hasClass(*p, CC_SPACE); ++p)
+        newlines += *p == '\n';
+    return p;
+}
+
+// scanWhile：返回 [p, end) 中第一个不属于 cls 的位置（cls 为 CC_DIGIT 或 CC_ID_CONT）
+template <uint8_t Cls> const char *scanWhile(const char *p, const char *end) {
+    // 单字符的变量名 / 数字最常见：先试探一个字节
+    if (p == end || !hasClass(*p, Cls))
+        return p;
+    ++p;
+#ifdef TOYC_LEXER_SIMD
+    while (end - p >= 16) {
+        Vec v = load16(p);
+        Mask in = Cls == CC_DIGIT ? digitMask(v) : identMask(v);
+        Mask rest = ~in & kFullMask;
+        if (rest != 0)
+            return p + std::countr_zero(rest) / kBitsPerByte;
+        p += 16;
+    }
+#endif
+    while (p < end && hasClass(*p, Cls))
+        ++p;
+    return p;
+}
+
+// findByte：[p, end) 中第一个 c 的位置，找不到返回 end（memchr 在常见 libc 中已向量化）
+inline const char *findByte(const char *p, const char *end, char c) {
+    auto *q = static_cast<const char *>(std::memchr(p, c, static_cast<size_t>(end - p)));
+    return q ? q : end;
+}
+
+} // namespace
+
+#pragma endregion
+
+#pragma region 关键字完美哈希
+
+namespace {
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+// keywordHash：对 8 个关键字无冲突的完美哈希（首字符 + 3×末字符 + 2×长度，取低 4 位）
+constexpr unsigned keywordHash(std::string_view s) {
+    return (static_cast<unsigned char>(s.front()) + 3u * static_cast<unsigned char>(s.back()) +
+            2u * static_cast<unsigned>(s.size())) &
+           15u;
+}
+
+// buildKeywordTable：按哈希值放置关键字，空槽 text 为空
+constexpr std::array<Keyword, 16> buildKeywordTable() {
+    constexpr Keyword kws[] = {
+        {"int", TokenType::INT},     {"void", TokenType::VOID},        {"if", TokenType::IF},
+        {"else", TokenType::ELSE},   {"while", TokenType::WHILE},      {"return", TokenType::RETURN},
+        {"break", TokenType::BREAK}, {"continue", TokenType::CONTINUE}};
+    std::array<Keyword, 16> t{};
+    for (auto &kw : kws)
+        t[keywordHash(kw.text)] = kw;
+    return t;
+}
+
+constexpr std::array<Keyword, 16> kKeywords = buildKeywordTable();
+
+// 编译期校验哈希确实无冲突：每个关键字都落在自己的槽位
+static_assert(kKeywords[keywordHash("int")].type == TokenType::INT &&
+                  kKeywords[keywordHash("void")].type == TokenType::VOID &&
+                  kKeywords[keywordHash("if")].type == TokenType::IF &&
+                  kKeywords[keywordHash("else")].type == TokenType::ELSE &&
+                  kKeywords[keywordHash("while")].type == TokenType::WHILE &&
+                  kKeywords[keywordHash("return")].type == TokenType::RETURN &&
+                  kKeywords[keywordHash("break")].type == TokenType::BREAK &&
+                  kKeywords[keywordHash("continue")].type == TokenType::CONTINUE,
+              "keyword hash collision");
+
+// lookupKeyword：一次哈希 + 一次比较区分关键字与普通标识符
+inline TokenType lookupKeyword(std::string_view s) {
+    if (s.size() < 2 || s.size() > 8)
+        return TokenType::ID;
+    const Keyword &kw = kKeywords[keywordHash(s)];
+    return kw.text == s ? kw.type : TokenType::ID;
+}
+
+} // namespace
+
+#pragma endregion
+
+#pragma region Lexer
 
 // 构造函数：初始化源代码和行号
-Lexer::Lexer(const std::string &source) : src(source), pos(0), line(1) {}
+Lexer::Lexer(std::string_view source, int firstLine) : src(source), pos(0), line(firstLine) {}
 
 // peek：返回当前字符但不推进位置；若到达末尾，返回 '\0'
 char Lexer::peek() const { return (pos >= src.size()) ? '\0' : src[pos]; }
@@ -20,67 +225,73 @@ char Lexer::advance() {
     return c;
 }
 
-// skipWhitespace：跳过空白字符（空格、制表符、换行）并更新行号
+// skipWhitespace：跳过空白字符（空格、制表符、换行）并更新行号（16 字节一块扫描）
 void Lexer::skipWhitespace() {
-    while (isspace(peek())) {
-        if (peek() == '\n')
-            ++line; // 行号递增
-        advance();  // 消费空白
-    }
+    if (pos >= src.size())
+        return;
+    const char *base = src.data();
+    pos = scanSpaces(base + pos, base + src.size(), line) - base;
 }
 
-// makeToken：基于最近消费的单字符生成 Token，lexeme 为该字符
-Token Lexer::makeToken(TokenType type) { return {type, std::string(1, src[pos - 1]), line}; }
+// skipLineComment：跳过 "//" 注释到行尾（不消费换行）或 '\0' / 文件末尾
+void Lexer::skipLineComment() {
+    const char *base = src.data(), *end = base + src.size();
+    const char *stop = findByte(base + pos + 2, end, '\n');
+    stop = findByte(base + pos + 2, stop, '\0'); // 与逐字符扫描一致：内嵌 '\0' 视为结束
+    pos = stop - base;
+}
+
+// skipBlockComment：跳过 "/* ... */" 并统计其中的换行；未闭合时停在 '\0' / 文件末尾
+void Lexer::skipBlockComment() {
+    const char *base = src.data(), *end = base + src.size();
+    const char *p = base + pos + 2;
+    const char *close = p;
+    for (;;) {
+        close = findByte(close, end, '*');
+        if (close == end || (close + 1 < end && close[1] == '/'))
+            break;
+        ++close;
+    }
+    const char *stop = findByte(p, close, '\0');
+    line += static_cast<int>(std::count(p, stop, '\n'));
+    pos = (stop == close && close != end) ? (close + 2) - base : stop - base;
+}
 
 // identifier：解析标识符或关键字，支持字母、数字和下划线
 Token Lexer::identifier() {
     size_t start = pos - 1; // 回退一位，因为 nextToken() 中已经 advance() 了一次
-    while (isalnum(peek()) || peek() == '_')
-        advance();
-    std::string lex = src.substr(start, pos - start);
-    auto it = keywords.find(lex);
-    // 如果找到关键字，则返回关键字类型，否则返回标识符类型(ID)
-    TokenType type = (it != keywords.end()) ? it->second : TokenType::ID;
-    return {type, lex, line};
+    const char *base = src.data();
+    pos = scanWhile<CC_ID_CONT>(base + pos, base + src.size()) - base;
+    std::string_view lex = src.substr(start, pos - start);
+    // 如果是关键字，则返回关键字类型，否则返回标识符类型(ID)
+    return {lookupKeyword(lex), lex, line};
 }
 
 // number：解析数字字面量，连续读取数字字符
 Token Lexer::number() {
     size_t start = pos - 1; // 回退一位，因为 nextToken() 中已经 advance() 了一次
-    while (isdigit(peek()))
-        advance();
+    const char *base = src.data();
+    pos = scanWhile<CC_DIGIT>(base + pos, base + src.size()) - base;
     return {TokenType::NUMBER, src.substr(start, pos - start), line};
 }
 
+// makeToken：基于最近消费的单字符生成 Token，lexeme 为该字符在源码中的切片
+Token Lexer::makeToken(TokenType type) { return {type, src.substr(pos - 1, 1), line}; }
+
 // nextToken：主入口，跳过空白和注释，识别并返回下一个 Token
 Token Lexer::nextToken() {
     // 循环跳过所有空白和注释
     for (;;) {
         skipWhitespace(); // 跳过空白字符
-        // 单行注释：遇到 "//" 则跳过至行尾
-        if (peek() == '/' && pos + 1 < src.size() && src[pos + 1] == '/') {
-            advance(); // 消费 '/'
-            advance(); // 消费第二个 '/'
-            while (peek() != '\n' && peek() != '\0')
-                advance(); // 跳至行尾或文件末尾
-            continue;
-        }
-        // 多行注释：遇到 "/*" 则跳过至 "*/"
-        if (peek() == '/' && pos + 1 < src.size() && src[pos + 1] == '*') {
-            advance(); // 消费 '/'
-            advance(); // 消费 '*'
-            while (!(peek() == '*' && pos + 1 < src.size() && src[pos + 1] == '/')) {
-                if (peek() == '\n')
-                    ++line; // 多行注释中也需要更新行号
-                if (peek() == '\0')
-                    break; // 文件结束则退出（未闭合注释）
-                advance();
+        if (peek() == '/' && pos + 1 < src.size()) {
+            if (src[pos + 1] == '/') { // 单行注释
+                skipLineComment();
+                continue;
             }
-            if (peek() != '\0') {
-                advance(); // 消费 '*'
-                advance(); // 消费 '/'
+            if (src[pos + 1] == '*') { // 多行注释
+                skipBlockComment();
+                continue;
             }
-            continue;
         }
         break; // 既不是空白也不是注释，退出循环
     }
@@ -88,7 +299,7 @@ Token Lexer::nextToken() {
     char c = advance(); // 消费第一个有效字符
     switch (c) {
     case '\0':
-        return {TokenType::END, "", line}; // 文件结束
+        return {TokenType::END, {}, line}; // 文件结束
 
     // 单字符算术运算符
     case '+':
@@ -106,25 +317,25 @@ Token Lexer::nextToken() {
     case '=':
         if (peek() == '=') {
             advance();
-            return {TokenType::EQ, "==", line};
+            return {TokenType::EQ, src.substr(pos - 2, 2), line};
         }
         return makeToken(TokenType::ASSIGN);
     case '<':
         if (peek() == '=') {
             advance();
-            return {TokenType::LE, "<=", line};
+            return {TokenType::LE, src.substr(pos - 2, 2), line};
         }
         return makeToken(TokenType::LT);
     case '>':
         if (peek() == '=') {
             advance();
-            return {TokenType::GE, ">=", line};
+            return {TokenType::GE, src.substr(pos - 2, 2), line};
         }
         return makeToken(TokenType::GT);
     case '!':
         if (peek() == '=') {
             advance();
-            return {TokenType::NE, "!=", line};
+            return {TokenType::NE, src.substr(pos - 2, 2), line};
         }
         return makeToken(TokenType::NOT);
 
@@ -132,13 +343,13 @@ Token Lexer::nextToken() {
     case '&':
         if (peek() == '&') {
             advance();
-            return {TokenType::AND, "&&", line};
+            return {TokenType::AND, src.substr(pos - 2, 2), line};
         }
         break;
     case '|':
         if (peek() == '|') {
             advance();
-            return {TokenType::OR, "||", line};
+            return {TokenType::OR, src.substr(pos - 2, 2), line};
         }
         break;
 
@@ -157,12 +368,14 @@ Token Lexer::nextToken() {
         return makeToken(TokenType::COMMA);
 
     default:
-        if (isalpha(c) || c == '_')
+        if (hasClass(c, CC_ID_START))
             return identifier(); // 以字母或下划线开头，解析为标识符/关键字
-        if (isdigit(c))
+        if (hasClass(c, CC_DIGIT))
             return number(); // 以数字开头，解析为数字字面量
         break;
     }
     // 其他未识别字符
-    return {TokenType::UNKNOWN, std::string(1, c), line};
+    return {TokenType::UNKNOWN, src.substr(pos - 1, 1), line};
 }
+
+#pragma endregion
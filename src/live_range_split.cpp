@@ -0,0 +1,298 @@
+#include "ir_analysis.h"
+#include "reg_alloc.h"
+#include <algorithm>
+
+namespace toyc {
+
+using namespace ir;
+
+namespace {
+
+// renameUses / renameDef：把指令中对 from 的读取 / 写入改为 to
+void renameUses(Instruction &inst, int from, int to) {
+    for (auto &op : inst.ops)
+        if (op.isVReg() && op.regId() == from)
+            op = Operand::vreg(to);
+}
+void renameDef(Instruction &inst, int from, int to) {
+    if (inst.defReg() == from)
+        inst.def = Operand::vreg(to);
+}
+
+// insertBeforeTerminator：插入位置为终结指令之前（没有终结指令时为块尾）
+size_t insertBeforeTerminator(const BasicBlock &bb) {
+    return !bb.insts.empty() && bb.insts.back()->isTerminator() ? bb.insts.size() - 1
+                                                               : bb.insts.size();
+}
+
+} // namespace
+
+/**
+ * @brief 构造分裂器
+ * @param F          目标函数（活跃性分析已完成）
+ * @param candidates 本轮将要分裂的 vreg
+ * @details 一次扫描全部指令，记下每个候选 vreg 出现过的基本块（按块序、不重复）
+ */
+LiveRangeSplitter::LiveRangeSplitter(Function &F, const std::vector<int> &candidates) : F_(F) {
+    std::vector<char> isCandidate(static_cast<size_t>(F.maxVregId + 1), 0);
+    for (int v : candidates) {
+        isCandidate[v] = 1;
+        refBlocks_[v];
+    }
+    auto note = [&](int v, BasicBlock *bb) {
+        if (v < 0 || !isCandidate[v])
+            return;
+        auto &blocks = refBlocks_[v];
+        if (blocks.empty() || blocks.back() != bb)
+            blocks.push_back(bb);
+    };
+    for (auto &bb : F.blocks)
+        for (auto *inst : bb->insts) {
+            inst->forEachUse([&](int u) { note(u, bb.get()); });
+            note(inst->defReg(), bb.get());
+        }
+}
+
+// newPiece：新建一个片段 vreg
+int LiveRangeSplitter::newPiece(int parent, bool isLoop) {
+    int vreg = ++F_.maxVregId;
+    pieces_.push_back({vreg, parent, isLoop});
+    return vreg;
+}
+
+// makeCopy：在指令池中创建 dst = copy src（类型对代码生成无影响，统一为 i32）
+Instruction *LiveRangeSplitter::makeCopy(int dst, int src) {
+    return F_.newInst(Instruction::makeCopy(Operand::vreg(dst), "i32", Operand::vreg(src)));
+}
+
+/**
+ * @brief 按最外层循环与循环外的基本块分裂 vreg
+ * @details 每个含引用的最外层循环得到一个循环片段：循环内的引用全部改写为片段，
+ *   vreg 在循环头入口处活跃时，在每条从循环外进入循环头的边上放置 片段 = copy vreg；
+ *   循环内有定义时，在每条离开循环、且 vreg 在目标块入口活跃的边上放置 vreg = copy 片段。
+ *   不在任何循环内的引用块按块分裂
+ */
+void LiveRangeSplitter::splitAcrossLoops(int vreg) {
+    const LoopInfo &LI = F_.analyses().loops();
+    const auto &blocks = refBlocks_[vreg];
+    std::vector<BasicBlock *> outside;
+    std::vector<const Loop *> loops; // 含引用的最外层循环（按首次出现的块序）
+    for (BasicBlock *bb : blocks) {
+        const Loop *L = LI.loopFor(bb);
+        if (!L) {
+            outside.push_back(bb);
+            continue;
+        }
+        while (L->parent)
+            L = L->parent;
+        if (std::find(loops.begin(), loops.end(), L) == loops.end())
+            loops.push_back(L);
+    }
+
+    for (const Loop *L : loops) {
+        auto inLoop = [&](const BasicBlock *bb) { return L->contains(LI.loopFor(bb)); };
+        int piece = newPiece(vreg, true);
+        bool defined = false;
+        for (BasicBlock *bb : blocks) {
+            if (!inLoop(bb))
+                continue;
+            for (auto *inst : bb->insts) {
+                renameUses(*inst, vreg, piece);
+                if (inst->defReg() == vreg) {
+                    renameDef(*inst, vreg, piece);
+                    defined = true;
+                }
+            }
+        }
+        if (L->header->liveIn.test(vreg))
+            for (BasicBlock *pred : std::vector<BasicBlock *>(L->header->preds))
+                if (!inLoop(pred))
+                    insertOnEdge(pred, L->header, makeCopy(piece, vreg));
+        if (!defined)
+            continue;
+        for (BasicBlock *bb : L->blocks)
+            for (BasicBlock *succ : std::vector<BasicBlock *>(bb->succs))
+                if (!inLoop(succ) && succ->liveIn.test(vreg))
+                    insertOnEdge(bb, succ, makeCopy(vreg, piece));
+    }
+
+    for (BasicBlock *bb : outside)
+        splitBlock(vreg, bb);
+}
+
+// splitIntoBlocks：每个引用块独立分裂
+void LiveRangeSplitter::splitIntoBlocks(int vreg) {
+    for (BasicBlock *bb : refBlocks_[vreg])
+        splitBlock(vreg, bb);
+}
+
+/**
+ * @brief 把 vreg 在块 bb 内的引用改写为块片段
+ * @details 正向扫描块内指令，当前片段为空时遇到引用即新建片段（引用是读取时先插入
+ *   片段 = copy vreg）；片段之外的拷贝指令保持原样，由代码生成直接读写栈槽。
+ *   调用指令读完实参后结束当前片段，调用的结果（若写入 vreg）开始新片段。
+ *   片段结束时若有定义、且 vreg 的值在结束点之后仍被需要（块内之后先读后写，或在块出口活跃），
+ *   在片段最后一次定义之后插入 vreg = copy 片段
+ */
+void LiveRangeSplitter::splitBlock(int vreg, BasicBlock *bb) {
+    auto &insts = bb->insts;
+    const size_t n = insts.size();
+
+    // 只在本块内活跃、且中间没有调用的 vreg 分裂后仍是同一段区间，不做无用功
+    if (refBlocks_[vreg].size() == 1 && !bb->liveIn.test(vreg) && !bb->liveOut.test(vreg)) {
+        size_t first = n, last = 0;
+        bool hasCall = false;
+        for (size_t i = 0; i < n; ++i)
+            if (insts[i]->readsReg(vreg) || insts[i]->defReg() == vreg) {
+                first = std::min(first, i);
+                last = i;
+            }
+        for (size_t i = first; i < last; ++i)
+            hasCall |= insts[i]->isCallInst();
+        if (!hasCall)
+            return;
+    }
+
+    // liveAfter[i]：第 i 条指令执行之后 vreg 的值是否还会被读取
+    std::vector<char> liveAfter(n);
+    bool live = bb->liveOut.test(vreg);
+    for (size_t i = n; i-- > 0;) {
+        liveAfter[i] = live;
+        if (insts[i]->defReg() == vreg)
+            live = false;
+        if (insts[i]->readsReg(vreg))
+            live = true;
+    }
+
+    std::vector<Instruction *> out;
+    out.reserve(n + 4);
+    int piece = -1;
+    long lastDef = -1; // 当前片段最后一次定义在 out 中的下标（-1：片段内没有定义）
+    auto close = [&](bool needed) {
+        if (piece >= 0 && lastDef >= 0 && needed)
+            out.insert(out.begin() + lastDef + 1, makeCopy(vreg, piece));
+        piece = -1;
+        lastDef = -1;
+    };
+
+    for (size_t i = 0; i < n; ++i) {
+        Instruction *inst = insts[i];
+        bool defines = inst->defReg() == vreg;
+        if (piece < 0 && inst->opcode == Opcode::Copy) {
+            out.push_back(inst); // 拷贝本身就能直接读写栈槽，不必为它单开片段
+            continue;
+        }
+        if (inst->readsReg(vreg)) {
+            if (piece < 0) {
+                piece = newPiece(vreg, false);
+                out.push_back(makeCopy(piece, vreg));
+            }
+            renameUses(*inst, vreg, piece);
+        }
+        if (inst->isCallInst() && piece >= 0)
+            close(!defines && liveAfter[i]); // 片段不跨越调用
+        if (defines) {
+            if (piece < 0)
+                piece = newPiece(vreg, false);
+            renameDef(*inst, vreg, piece);
+            lastDef = static_cast<long>(out.size());
+        }
+        out.push_back(inst);
+    }
+    close(bb->liveOut.test(vreg));
+    insts = std::move(out);
+}
+
+/**
+ * @brief 在边 from → to 上放置拷贝
+ * @details 同一条边上的拷贝总是落在同一个位置，并按创建顺序排列（先处理的循环的写回
+ *   位于后处理的循环的 reload 之前）
+ */
+void LiveRangeSplitter::insertOnEdge(BasicBlock *from, BasicBlock *to, Instruction *copy) {
+    BasicBlock *at = from;
+    bool start = false;
+    if (from->succs.size() != 1) {
+        if (to->preds.size() == 1) {
+            at = to;
+            start = true;
+        } else {
+            at = splitEdge(from, to);
+        }
+    }
+    auto &pending = start ? atStart_ : atEnd_;
+    auto &order = start ? startOrder_ : endOrder_;
+    auto [slot, inserted] = pending.try_emplace(at);
+    if (inserted)
+        order.push_back(at);
+    slot->second.push_back(copy);
+}
+
+/**
+ * @brief 拆分关键边 from → to
+ * @details 新块只含 br to，追加到函数末尾；from 的终结指令中指向 to 的标签改为新块。
+ *   新块不在本轮活跃性分析中，只用于放置拷贝
+ */
+BasicBlock *LiveRangeSplitter::splitEdge(BasicBlock *from, BasicBlock *to) {
+    auto key = std::make_pair(from->id, to->id);
+    if (auto it = edgeBlocks_.find(key); it != edgeBlocks_.end())
+        return it->second;
+
+    std::string name;
+    do
+        name = "split_edge_" + std::to_string(numEdgeBlocks_++);
+    while (F_.blockMap.count(name));
+
+    auto block = std::make_unique<BasicBlock>();
+    block->id = static_cast<int>(F_.blocks.size());
+    block->name = name;
+    Instruction *br = F_.newInst(Instruction::makeBr(Operand::label(to->name)));
+    br->blockId = block->id;
+    block->insts.push_back(br);
+
+    Instruction *term = from->insts.back();
+    Symbol toLabel(to->name);
+    for (auto &op : term->ops)
+        if (op.isLabel() && op.labelSym() == toLabel)
+            op = Operand::label(name);
+
+    BasicBlock *raw = block.get();
+    F_.blockMap[name] = raw;
+    F_.blocks.push_back(std::move(block));
+    edgeBlocks_.emplace(key, raw);
+    return raw;
+}
+
+// commit：把边上的拷贝插入各块（块尾在终结指令前，块首在最前），随后重建 CFG
+void LiveRangeSplitter::commit() {
+    for (BasicBlock *bb : endOrder_) {
+        const auto &copies = atEnd_[bb];
+        size_t pos = insertBeforeTerminator(*bb);
+        bb->insts.insert(bb->insts.begin() + static_cast<std::ptrdiff_t>(pos), copies.begin(),
+                         copies.end());
+    }
+    for (BasicBlock *bb : startOrder_) {
+        const auto &copies = atStart_[bb];
+        bb->insts.insert(bb->insts.begin(), copies.begin(), copies.end());
+    }
+    F_.buildCFG();
+}
+
+// removeCopies：删除 片段 = copy 父 vreg 与 父 vreg = copy 片段（片段与父 vreg 共用栈槽）
+void LiveRangeSplitter::removeCopies(Function &F,
+                                     const std::unordered_map<int, int> &pieceToParent) {
+    auto isSplitCopy = [&](const Instruction *inst) {
+        if (inst->opcode != Opcode::Copy || !inst->ops[0].isVReg())
+            return false;
+        int dst = inst->defReg(), src = inst->ops[0].regId();
+        auto it = pieceToParent.find(dst);
+        if (it != pieceToParent.end() && it->second == src)
+            return true;
+        it = pieceToParent.find(src);
+        return it != pieceToParent.end() && it->second == dst;
+    };
+    for (auto &bb : F.blocks)
+        bb->insts.erase(std::remove_if(bb->insts.begin(), bb->insts.end(), isSplitCopy),
+                        bb->insts.end());
+}
+
+} // namespace toyc
@@ -0,0 +1,406 @@
+#include "ir_analysis.h"
+#include "ir_passes.h"
+#include "statistics.h"
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+namespace {
+
+// isHoistable：可以提到循环外的纯运算（RISC-V 的除法除数为 0 时不陷入，提前执行不改变行为）
+bool isHoistable(const Instruction *I) {
+    switch (I->opcode) {
+    case Opcode::Add:
+    case Opcode::Sub:
+    case Opcode::Mul:
+    case Opcode::SDiv:
+    case Opcode::SRem:
+    case Opcode::ICmp:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// InductionVariable：基本归纳变量 %i = phi [init, 前置块], [%next, 回边块]...，
+// 每条回边上的 %next 都是 %i ± 同一个常数 step（continue 产生多条回边）
+struct InductionVariable {
+    Instruction *phi;
+    Operand init;
+    std::vector<std::pair<Symbol, Instruction *>> increments; // 回边块 → %next 的定义
+    int32_t step;
+};
+
+// LoopOptimizer：单个函数上的循环不变量外提与归纳变量强度削减
+class LoopOptimizer {
+  public:
+    explicit LoopOptimizer(Function &F) : F_(F) {}
+
+    void run();
+
+    int hoisted = 0; // 外提的指令数
+    int reduced = 0; // 被加法递推替代的乘法数
+
+  private:
+    Function &F_;
+
+    bool insertPreheaders();
+    BasicBlock *preheaderOf(const Loop *L) const;
+    void optimizeLoop(Loop *L);
+    std::unordered_set<int> loopDefs(const Loop *L) const;
+    void hoistInvariants(const Loop *L, BasicBlock *preheader, std::unordered_set<int> &defs);
+    void reduceStrength(const Loop *L, BasicBlock *preheader, const std::unordered_set<int> &defs);
+
+    Operand newVreg() { return Operand::vreg(++F_.maxVregId); }
+    Instruction *emitBefore(BasicBlock *bb, size_t pos, Instruction inst) {
+        Instruction *I = F_.newInst(std::move(inst));
+        I->blockId = bb->id;
+        bb->insts.insert(bb->insts.begin() + static_cast<std::ptrdiff_t>(pos), I);
+        return I;
+    }
+    // emitInPreheader：在前置块的终结指令之前追加一条指令
+    Instruction *emitInPreheader(BasicBlock *preheader, Instruction inst) {
+        return emitBefore(preheader, preheader->insts.size() - 1, std::move(inst));
+    }
+};
+
+// ======================== 前置块 ========================
+
+/**
+ * @brief 为每个循环准备前置块（唯一的循环外前驱，且只有这一个后继）
+ * @details 已满足条件的循环不变；否则在头结点之前新建 <header>_ph 块，循环外前驱的分支改为跳到它。
+ *   头结点 phi 来自循环外的入口改为来自前置块（多个入口先在前置块中用一个新 phi 合并）。
+ *   循环外前驱没有终结指令（fall-through）时不处理该循环。返回是否新建了块
+ */
+bool LoopOptimizer::insertPreheaders() {
+    const LoopInfo &LI = F_.analyses().loops();
+    std::vector<std::pair<BasicBlock *, std::unique_ptr<BasicBlock>>> created; // 头结点 → 前置块
+    for (auto &block : F_.blocks) {
+        BasicBlock *header = block.get();
+        if (!LI.isLoopHeader(header))
+            continue;
+        const Loop *L = LI.loopFor(header);
+        std::vector<BasicBlock *> outside;
+        for (BasicBlock *p : header->preds)
+            if (!L->contains(LI.loopFor(p)) &&
+                std::find(outside.begin(), outside.end(), p) == outside.end())
+                outside.push_back(p);
+        if (outside.empty() || (outside.size() == 1 && outside[0]->succs.size() == 1))
+            continue;
+        if (std::any_of(outside.begin(), outside.end(), [](const BasicBlock *p) {
+                return p->insts.empty() || !p->insts.back()->isTerminator();
+            }))
+            continue;
+
+        auto pre = std::make_unique<BasicBlock>();
+        pre->name = header->name + "_ph";
+        while (F_.blockMap.count(pre->name))
+            pre->name += "_";
+        F_.blockMap[pre->name] = pre.get();
+        const Symbol headerName(header->name), preName(pre->name);
+        std::unordered_set<std::string_view> outsideNames;
+        for (const BasicBlock *p : outside)
+            outsideNames.insert(p->name);
+
+        for (Instruction *phi : header->insts) {
+            if (phi->opcode != Opcode::Phi)
+                break;
+            Instruction merged = Instruction::makePhi(newVreg(), phi->type);
+            OperandList kept;
+            for (size_t k = 0; k < phi->numIncoming(); ++k) {
+                if (outsideNames.count(static_cast<const std::string &>(phi->incomingBlock(k)))) {
+                    merged.addIncoming(phi->incomingValue(k), phi->incomingBlock(k));
+                } else {
+                    kept.push_back(phi->incomingValue(k));
+                    kept.push_back(phi->ops[2 * k + 1]);
+                }
+            }
+            phi->ops = kept;
+            if (merged.numIncoming() == 1) {
+                phi->addIncoming(merged.incomingValue(0), preName);
+                --F_.maxVregId; // 新 vreg 没有用上
+            } else {
+                phi->addIncoming(merged.def, preName);
+                pre->insts.push_back(F_.newInst(std::move(merged)));
+            }
+        }
+        pre->insts.push_back(F_.newInst(Instruction::makeBr(Operand::label(headerName))));
+        for (BasicBlock *p : outside)
+            for (Operand &op : p->insts.back()->ops)
+                if (op.isLabel() && op.labelSym() == headerName)
+                    op = Operand::label(preName);
+        created.emplace_back(header, std::move(pre));
+    }
+    if (created.empty())
+        return false;
+
+    // 前置块放在各自的头结点之前，随后重新编号并重建 CFG
+    std::vector<std::unique_ptr<BasicBlock>> blocks;
+    blocks.reserve(F_.blocks.size() + created.size());
+    for (auto &bb : F_.blocks) {
+        for (auto &[header, pre] : created)
+            if (header == bb.get())
+                blocks.push_back(std::move(pre));
+        blocks.push_back(std::move(bb));
+    }
+    F_.blocks = std::move(blocks);
+    for (size_t i = 0; i < F_.blocks.size(); ++i) {
+        BasicBlock *bb = F_.blocks[i].get();
+        bb->id = static_cast<int>(i);
+        for (Instruction *I : bb->insts)
+            I->blockId = bb->id;
+    }
+    F_.buildCFG();
+    return true;
+}
+
+// preheaderOf：循环的前置块（唯一的循环外前驱且只有一个后继），不存在时返回 nullptr
+BasicBlock *LoopOptimizer::preheaderOf(const Loop *L) const {
+    const LoopInfo &LI = F_.analyses().loops();
+    BasicBlock *pre = nullptr;
+    for (BasicBlock *p : L->header->preds) {
+        if (L->contains(LI.loopFor(p)))
+            continue;
+        if (pre && pre != p)
+            return nullptr;
+        pre = p;
+    }
+    return pre && pre->succs.size() == 1 && !pre->insts.empty() &&
+                   pre->insts.back()->opcode == Opcode::Br
+               ? pre
+               : nullptr;
+}
+
+// ======================== 循环不变量外提 ========================
+
+// loopDefs：循环内（含内层循环）定义的 vreg
+std::unordered_set<int> LoopOptimizer::loopDefs(const Loop *L) const {
+    std::unordered_set<int> defs;
+    for (const BasicBlock *bb : L->blocks)
+        for (const Instruction *I : bb->insts)
+            if (int d = I->defReg(); d >= 0)
+                defs.insert(d);
+    return defs;
+}
+
+/**
+ * @brief 把操作数都在循环外定义（或是常量）的纯运算移到前置块末尾
+ * @details 按逆后序扫描循环块，外提的指令从 defs 中移除，依赖它的运算随后也可外提；
+ *   重复到没有变化。被外提的运算在循环的每次迭代中结果相同，提前计算一次即可
+ */
+void LoopOptimizer::hoistInvariants(const Loop *L, BasicBlock *preheader,
+                                    std::unordered_set<int> &defs) {
+    auto invariant = [&](const Instruction *I) {
+        return std::none_of(I->ops.begin(), I->ops.end(), [&](const Operand &op) {
+            return op.isVReg() && defs.count(op.regId());
+        });
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (BasicBlock *bb : L->blocks)
+            std::erase_if(bb->insts, [&](Instruction *I) {
+                if (!isHoistable(I) || !invariant(I))
+                    return false;
+                I->blockId = preheader->id;
+                preheader->insts.insert(preheader->insts.end() - 1, I);
+                defs.erase(I->defReg());
+                ++hoisted;
+                changed = true;
+                return true;
+            });
+    }
+}
+
+// ======================== 强度削减 ========================
+
+/**
+ * @brief 把循环内的 %m = mul %i, k（%i 为基本归纳变量，k 为循环不变量）改写为加法递推
+ * @details 对每个 (%i, k) 新建 %j = phi [init*k, 前置块], [%jn, 回边块]...，每条 %i 的递增之后
+ *   紧跟 %jn = add %j, step*k；%m 的 use 改读 %j。32 位回绕下 (i + step)*k = i*k + step*k
+ *   恒成立，所以 %j 在每次迭代中都等于 %i*k。init*k 与 step*k 能折叠时直接用立即数，
+ *   否则在前置块中计算
+ */
+void LoopOptimizer::reduceStrength(const Loop *L, BasicBlock *preheader,
+                                   const std::unordered_set<int> &defs) {
+    BasicBlock *header = L->header;
+    const Symbol preName(preheader->name);
+
+    // 基本归纳变量
+    std::unordered_map<int, Instruction *> defInst;
+    for (BasicBlock *bb : L->blocks)
+        for (Instruction *I : bb->insts)
+            if (int d = I->defReg(); d >= 0)
+                defInst[d] = I;
+    // stepOf：%next 的定义是 %i ± 常数时返回步长
+    auto stepOf = [&](const Operand &next, int self) -> std::optional<int32_t> {
+        auto it = next.isVReg() ? defInst.find(next.regId()) : defInst.end();
+        if (it == defInst.end())
+            return std::nullopt;
+        const Instruction *inc = it->second;
+        auto isSelf = [&](const Operand &op) { return op.isVReg() && op.regId() == self; };
+        if (inc->opcode == Opcode::Add && isSelf(inc->ops[0]) && inc->ops[1].isImm())
+            return inc->ops[1].immValue();
+        if (inc->opcode == Opcode::Add && inc->ops[0].isImm() && isSelf(inc->ops[1]))
+            return inc->ops[0].immValue();
+        if (inc->opcode == Opcode::Sub && isSelf(inc->ops[0]) && inc->ops[1].isImm())
+            return static_cast<int32_t>(0u - static_cast<uint32_t>(inc->ops[1].immValue()));
+        return std::nullopt;
+    };
+    std::unordered_map<int, InductionVariable> ivs;
+    for (Instruction *phi : header->insts) {
+        if (phi->opcode != Opcode::Phi)
+            break;
+        if (phi->type != "i32")
+            continue;
+        InductionVariable iv{phi, Operand::none(), {}, 0};
+        bool valid = true;
+        for (size_t k = 0; k < phi->numIncoming() && valid; ++k) {
+            if (phi->incomingBlock(k) == preName) {
+                iv.init = phi->incomingValue(k);
+                continue;
+            }
+            auto step = stepOf(phi->incomingValue(k), phi->defReg());
+            valid = step && (iv.increments.empty() || *step == iv.step);
+            if (valid) {
+                iv.step = *step;
+                iv.increments.emplace_back(phi->incomingBlock(k),
+                                           defInst.at(phi->incomingValue(k).regId()));
+            }
+        }
+        if (valid && !iv.increments.empty() && (iv.init.isVReg() || iv.init.isImm()))
+            ivs.emplace(phi->defReg(), std::move(iv));
+    }
+    if (ivs.empty())
+        return;
+
+    auto mulConst = [](int32_t a, int32_t b) {
+        return static_cast<int32_t>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b));
+    };
+    // product：在前置块中得到 a*b（两者都是立即数、或一侧为 0 / 1 时直接折叠）
+    auto product = [&](const Operand &a, const Operand &b) {
+        if (a.isImm() && b.isImm())
+            return Operand::imm(mulConst(a.immValue(), b.immValue()));
+        for (const auto &[x, y] : {std::pair(a, b), std::pair(b, a)})
+            if (x.isImm() && (x.immValue() == 0 || x.immValue() == 1))
+                return x.immValue() == 0 ? x : y;
+        Operand d = newVreg();
+        emitInPreheader(preheader, Instruction::makeBinOp(Opcode::Mul, d, "i32", a, b));
+        return d;
+    };
+
+    // 先摘下可削减的乘法（遍历块时不能往块里插入指令），再为每个 (%i, k) 建立递推
+    struct Candidate {
+        int def;
+        const InductionVariable *iv;
+        Operand factor;
+    };
+    std::vector<Candidate> candidates;
+    for (BasicBlock *bb : L->blocks)
+        std::erase_if(bb->insts, [&](Instruction *I) {
+            if (I->opcode != Opcode::Mul)
+                return false;
+            for (size_t side = 0; side < 2; ++side) {
+                const Operand &iv = I->ops[side], &k = I->ops[1 - side];
+                auto it = iv.isVReg() ? ivs.find(iv.regId()) : ivs.end();
+                if (it == ivs.end() || !(k.isImm() || (k.isVReg() && !defs.count(k.regId()))))
+                    continue;
+                candidates.push_back(Candidate{I->defReg(), &it->second, k});
+                return true;
+            }
+            return false;
+        });
+    if (candidates.empty())
+        return;
+
+    std::map<std::pair<int, uint64_t>, Operand> reducedOf; // (%i, k) → %j
+    std::unordered_map<int, Operand> replace;
+    for (const Candidate &c : candidates) {
+        const InductionVariable &IV = *c.iv;
+        auto key = std::make_pair(IV.phi->defReg(), static_cast<uint64_t>(c.factor.kind()) << 32 |
+                                                        static_cast<uint32_t>(c.factor.regId()));
+        auto found = reducedOf.find(key);
+        if (found == reducedOf.end()) {
+            Operand j = newVreg();
+            Operand stepK = product(Operand::imm(IV.step), c.factor);
+            Instruction phi = Instruction::makePhi(j, "i32");
+            phi.addIncoming(product(IV.init, c.factor), preName);
+            std::unordered_map<const Instruction *, Operand> nextOf; // %i 的递增 → %jn
+            for (const auto &[latch, inc] : IV.increments) {
+                auto [it, inserted] = nextOf.try_emplace(inc, Operand::none());
+                if (inserted) {
+                    it->second = newVreg();
+                    Instruction add =
+                        Instruction::makeBinOp(Opcode::Add, it->second, "i32", j, stepK);
+                    add.nsw = false; // 最后一次递推可能回绕，其结果不再被使用
+                    BasicBlock *bb = F_.blocks[inc->blockId].get();
+                    auto pos = std::find(bb->insts.begin(), bb->insts.end(), inc);
+                    emitBefore(bb, static_cast<size_t>(pos - bb->insts.begin()) + 1,
+                               std::move(add));
+                }
+                phi.addIncoming(it->second, latch);
+            }
+            emitBefore(header, 0, std::move(phi));
+            found = reducedOf.emplace(key, j).first;
+        }
+        replace[c.def] = found->second;
+        ++reduced;
+    }
+    if (replace.empty())
+        return;
+    for (auto &bb : F_.blocks)
+        for (Instruction *I : bb->insts)
+            for (Operand &op : I->ops)
+                if (op.isVReg())
+                    if (auto it = replace.find(op.regId()); it != replace.end())
+                        op = it->second;
+}
+
+// optimizeLoop：先处理内层循环（外提到内层前置块的运算可能继续提到外层），再处理本层
+void LoopOptimizer::optimizeLoop(Loop *L) {
+    for (Loop *sub : L->subLoops)
+        optimizeLoop(sub);
+    BasicBlock *preheader = preheaderOf(L);
+    if (!preheader)
+        return;
+    std::unordered_set<int> defs = loopDefs(L);
+    hoistInvariants(L, preheader, defs);
+    reduceStrength(L, preheader, defs);
+}
+
+/**
+ * @brief 执行循环优化
+ * @details 先补齐前置块（CFG 变化后循环森林重新计算），再自内向外处理每个循环。
+ *   外提与强度削减只移动 / 新增指令，不改变 CFG，循环森林在整个过程中保持有效
+ */
+void LoopOptimizer::run() {
+    if (F_.blocks.empty())
+        return;
+    F_.buildCFG();
+    if (F_.analyses().loops().size() == 0)
+        return;
+    insertPreheaders();
+    for (Loop *L : F_.analyses().loops().topLevelLoops())
+        optimizeLoop(L);
+}
+
+} // namespace
+
+// optimizeLoops：对单个函数执行 LICM 与强度削减
+int optimizeLoops(Function &F) {
+    LoopOptimizer opt(F);
+    opt.run();
+    stats::add(stats::Counter::HoistedInsts, static_cast<uint64_t>(opt.hoisted));
+    stats::add(stats::Counter::ReducedMuls, static_cast<uint64_t>(opt.reduced));
+    return opt.hoisted + opt.reduced;
+}
+
+} // namespace opt
+} // namespace toyc
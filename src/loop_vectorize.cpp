@@ -0,0 +1,616 @@
+#include "ir_analysis.h"
+#include "ir_passes.h"
+#include "statistics.h"
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+namespace {
+
+constexpr int kMaxKernelParams = 7;  // a1-a7 传入（a0 为迭代次数）
+constexpr int kMaxKernelValues = 28; // 广播与运算结果各占一个向量寄存器（v4-v31）
+
+// isVectorizable：有逐元素向量指令对应的运算
+bool isVectorizable(const Instruction *I) {
+    switch (I->opcode) {
+    case Opcode::Add:
+    case Opcode::Sub:
+    case Opcode::Mul:
+    case Opcode::SDiv:
+    case Opcode::SRem:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// isScalarOperand：内核能表示的操作数（立即数、布尔字面量按 0 / 1，或 vreg）
+bool isScalarOperand(const Operand &op) { return op.isImm() || op.isBoolLit() || op.isVReg(); }
+
+// swapPred：交换比较的两个操作数后的谓词（a < b 即 b > a）
+CmpPred swapPred(CmpPred pred) {
+    switch (pred) {
+    case CmpPred::SLT:
+        return CmpPred::SGT;
+    case CmpPred::SGT:
+        return CmpPred::SLT;
+    case CmpPred::SLE:
+        return CmpPred::SGE;
+    case CmpPred::SGE:
+        return CmpPred::SLE;
+    default:
+        return pred;
+    }
+}
+
+// invertPred：取反后的谓词（循环在比较为假时继续）
+CmpPred invertPred(CmpPred pred) {
+    switch (pred) {
+    case CmpPred::EQ:
+        return CmpPred::NE;
+    case CmpPred::NE:
+        return CmpPred::EQ;
+    case CmpPred::SLT:
+        return CmpPred::SGE;
+    case CmpPred::SGE:
+        return CmpPred::SLT;
+    case CmpPred::SGT:
+        return CmpPred::SLE;
+    case CmpPred::SLE:
+        return CmpPred::SGT;
+    }
+    return pred;
+}
+
+// LoopIV：归纳变量 %i = phi [init, 前置块], [%i ± step, 循环体]（step 为常数或循环不变量）
+struct LoopIV {
+    Instruction *phi;
+    Operand init;
+    Operand step;
+    bool negated; // 递推为 %i - step
+};
+
+// VectorLoop：可以向量化的循环 —— 头结点只有 phi、比较与 br i1，循环体是一个直线块
+struct VectorLoop {
+    BasicBlock *preheader, *header, *body;
+    std::vector<LoopIV> ivs;
+    Instruction *reduction; // 唯一的加法归约 phi
+    Operand counterInit;    // 与上界比较的归纳变量（步长 +1）的初值
+    Operand bound;          // 循环不变的上界
+    bool inclusive;         // i <= n（迭代次数多一次）
+};
+
+// LoopVectorizer：单个函数上的循环向量化，内核函数追加到模块末尾
+class LoopVectorizer {
+  public:
+    LoopVectorizer(Module &mod, Function &F) : mod_(mod), F_(F) {}
+
+    int run();
+
+  private:
+    Module &mod_;
+    Function &F_;
+
+    BasicBlock *preheaderOf(const Loop *L) const;
+    std::optional<VectorLoop> analyze(const Loop *L) const;
+    bool vectorize(const VectorLoop &VL);
+    std::string kernelName() const;
+
+    Operand newVreg() { return Operand::vreg(++F_.maxVregId); }
+};
+
+// preheaderOf：循环的前置块（唯一的循环外前驱且以 br 跳到头结点），不存在时返回 nullptr
+BasicBlock *LoopVectorizer::preheaderOf(const Loop *L) const {
+    const LoopInfo &LI = F_.analyses().loops();
+    BasicBlock *pre = nullptr;
+    for (BasicBlock *p : L->header->preds) {
+        if (L->contains(LI.loopFor(p)))
+            continue;
+        if (pre && pre != p)
+            return nullptr;
+        pre = p;
+    }
+    return pre && pre->succs.size() == 1 && !pre->insts.empty() &&
+                   pre->insts.back()->opcode == Opcode::Br
+               ? pre
+               : nullptr;
+}
+
+/**
+ * @brief 判断循环能否向量化
+ * @details 要求（任何一条不满足都保持标量）：
+ *   1. 两个块：头结点 H 只含 phi、一条 icmp 与 br i1，循环体 B 只含 add/sub/mul/sdiv/srem 并跳回 H，
+ *      操作数都是立即数、布尔字面量（按 0 / 1）或 vreg
+ *   2. H 的 phi 都有前置块与 B 两个入口，且是归纳变量（%i ± 常数 / 循环不变量）或唯一的加法归约：
+ *      %r 沿 add（任一侧）/ sub（左侧）链到达回边值，链上每个值只被下一环读取一次，%r 不被其它
+ *      指令读取。于是每次迭代把 %r 加上一个只依赖迭代序号的量，迭代之间没有其它依赖
+ *   3. 循环条件为 i < n / i <= n（或交换、取反的等价形式），i 步长为 +1，n 为循环不变量
+ *   循环体里没有访存与调用，sdiv / srem 的除数为 0 时向量指令与标量指令的结果相同（不陷入）
+ */
+std::optional<VectorLoop> LoopVectorizer::analyze(const Loop *L) const {
+    if (!L->subLoops.empty() || L->blocks.size() != 2 || L->latches.size() != 1)
+        return std::nullopt;
+    BasicBlock *H = L->header, *B = L->latches[0];
+    if (B == H || B->preds.size() != 1 || B->succs.size() != 1 || B->insts.empty() ||
+        B->insts.back()->opcode != Opcode::Br)
+        return std::nullopt;
+    BasicBlock *P = preheaderOf(L);
+    if (!P || H->insts.size() < 2)
+        return std::nullopt;
+
+    // 头结点：phi..., icmp, br i1 icmp
+    const Instruction *br = H->insts.back(), *cmp = H->insts[H->insts.size() - 2];
+    if (br->opcode != Opcode::CondBr || cmp->opcode != Opcode::ICmp ||
+        br->branchCondReg() != cmp->defReg())
+        return std::nullopt;
+    for (size_t i = 0; i + 2 < H->insts.size(); ++i)
+        if (H->insts[i]->opcode != Opcode::Phi)
+            return std::nullopt;
+    for (size_t i = 0; i + 1 < B->insts.size(); ++i)
+        if (!isVectorizable(B->insts[i]) ||
+            !std::all_of(B->insts[i]->ops.begin(), B->insts[i]->ops.end(), isScalarOperand))
+            return std::nullopt;
+
+    std::unordered_map<int, Instruction *> bodyDefs;
+    for (Instruction *I : B->insts)
+        if (int d = I->defReg(); d >= 0)
+            bodyDefs[d] = I;
+    std::unordered_set<int> loopDefs;
+    for (const BasicBlock *bb : {H, B})
+        for (const Instruction *I : bb->insts)
+            if (int d = I->defReg(); d >= 0)
+                loopDefs.insert(d);
+    auto invariant = [&](const Operand &op) {
+        return op.isImm() || op.isBoolLit() || (op.isVReg() && !loopDefs.count(op.regId()));
+    };
+    // uses：循环内读取各 vreg 的指令（同一指令读取两次记两次）
+    std::unordered_map<int, std::vector<const Instruction *>> uses;
+    for (const BasicBlock *bb : {H, B})
+        for (const Instruction *I : bb->insts)
+            for (int r : I->useRegs())
+                uses[r].push_back(I);
+    auto usesOf = [&](int vreg) -> const std::vector<const Instruction *> & {
+        static const std::vector<const Instruction *> none;
+        auto it = uses.find(vreg);
+        return it == uses.end() ? none : it->second;
+    };
+
+    VectorLoop VL{P, H, B, {}, nullptr, Operand::none(), Operand::none(), false};
+    const Symbol preName(P->name), bodyName(B->name);
+    for (size_t i = 0; i + 2 < H->insts.size(); ++i) {
+        Instruction *phi = H->insts[i];
+        if (phi->type != "i32" || phi->numIncoming() != 2)
+            return std::nullopt;
+        Operand init = Operand::none(), next = Operand::none();
+        for (size_t k = 0; k < 2; ++k) {
+            if (phi->incomingBlock(k) == preName)
+                init = phi->incomingValue(k);
+            else if (phi->incomingBlock(k) == bodyName)
+                next = phi->incomingValue(k);
+        }
+        if (!isScalarOperand(init) || !next.isVReg() || !bodyDefs.count(next.regId()))
+            return std::nullopt;
+        const int self = phi->defReg();
+        auto isSelf = [&](const Operand &op) { return op.isVReg() && op.regId() == self; };
+
+        // 归纳变量
+        const Instruction *inc = bodyDefs.at(next.regId());
+        if (inc->opcode == Opcode::Add && isSelf(inc->ops[0]) && invariant(inc->ops[1])) {
+            VL.ivs.push_back({phi, init, inc->ops[1], false});
+            continue;
+        }
+        if (inc->opcode == Opcode::Add && invariant(inc->ops[0]) && isSelf(inc->ops[1])) {
+            VL.ivs.push_back({phi, init, inc->ops[0], false});
+            continue;
+        }
+        if (inc->opcode == Opcode::Sub && isSelf(inc->ops[0]) && invariant(inc->ops[1])) {
+            VL.ivs.push_back({phi, init, inc->ops[1], true});
+            continue;
+        }
+
+        // 加法归约：%r → ... → next，每一环只被下一环读取一次
+        if (VL.reduction)
+            return std::nullopt;
+        int cur = self;
+        for (size_t steps = 0; cur != next.regId(); ++steps) {
+            const auto &users = usesOf(cur);
+            if (steps > B->insts.size() || users.size() != 1)
+                return std::nullopt;
+            const Instruction *user = users[0];
+            const bool chained =
+                (user->opcode == Opcode::Add ||
+                 (user->opcode == Opcode::Sub && user->ops[0].isVReg() &&
+                  user->ops[0].regId() == cur)) &&
+                bodyDefs.count(user->defReg()) && bodyDefs.at(user->defReg()) == user;
+            if (!chained)
+                return std::nullopt;
+            cur = user->defReg();
+        }
+        const auto &nextUsers = usesOf(next.regId());
+        if (nextUsers.size() != 1 || nextUsers[0] != phi)
+            return std::nullopt;
+        VL.reduction = phi;
+    }
+    if (!VL.reduction)
+        return std::nullopt;
+
+    // 循环条件：在 true 分支继续时直接取谓词，否则取反；再归一化为 i <op> n
+    CmpPred pred = br->ops[1].labelSym() == bodyName ? cmp->cmpPred : invertPred(cmp->cmpPred);
+    Operand iv = cmp->ops[0], bound = cmp->ops[1];
+    if (pred == CmpPred::SGT || pred == CmpPred::SGE) {
+        std::swap(iv, bound);
+        pred = swapPred(pred);
+    }
+    if ((pred != CmpPred::SLT && pred != CmpPred::SLE) || !iv.isVReg() || !invariant(bound))
+        return std::nullopt;
+    auto counter = std::find_if(VL.ivs.begin(), VL.ivs.end(), [&](const LoopIV &v) {
+        return v.phi->defReg() == iv.regId() && v.step.isImm() &&
+               v.step.immValue() == (v.negated ? -1 : 1);
+    });
+    if (counter == VL.ivs.end())
+        return std::nullopt;
+    VL.counterInit = counter->init;
+    VL.bound = bound;
+    VL.inclusive = pred == CmpPred::SLE;
+    return VL;
+}
+
+// kernelName：__vec_<函数名>_<序号>（与模块中已有的函数不重名）
+std::string LoopVectorizer::kernelName() const {
+    for (int n = 0;; ++n) {
+        std::string name = "__vec_" + F_.name + "_" + std::to_string(n);
+        if (std::none_of(mod_.functions.begin(), mod_.functions.end(),
+                         [&](const auto &f) { return f->name == name; }))
+            return name;
+    }
+}
+
+// KernelBuilder：同时构建内核的向量化描述与等价的标量函数体
+class KernelBuilder {
+  public:
+    VectorKernel kernel;
+    std::vector<Operand> args; // 调用处传给形参 1..m 的值（形参 0 为迭代次数）
+
+    explicit KernelBuilder(Function &K) : K_(K) {}
+
+    // param / constant：广播调用者的循环不变量 / 常量（相同的值只广播一次）
+    int param(int vreg) {
+        auto [it, inserted] = params_.try_emplace(vreg, 0);
+        if (inserted) {
+            args.push_back(Operand::vreg(vreg));
+            it->second = add({VectorKernel::Value::Kind::Param, Opcode::Add, -1, -1,
+                              static_cast<int32_t>(args.size())},
+                             Operand::vreg(static_cast<int>(args.size())));
+        }
+        return it->second;
+    }
+    int constant(int32_t value) {
+        auto [it, inserted] = consts_.try_emplace(value, 0);
+        if (inserted)
+            it->second = add({VectorKernel::Value::Kind::Const, Opcode::Add, -1, -1, value},
+                             Operand::imm(value));
+        return it->second;
+    }
+    int index() {
+        if (index_ < 0)
+            index_ = add({VectorKernel::Value::Kind::Index}, Operand::vreg(indexVreg()));
+        return index_;
+    }
+    int acc() {
+        if (acc_ < 0)
+            acc_ = add({VectorKernel::Value::Kind::Acc}, Operand::vreg(accVreg()));
+        return acc_;
+    }
+    // op：values[lhs] <opcode> values[rhs]，标量函数体中对应一条新的运算
+    int op(Opcode opcode, int lhs, int rhs) {
+        Operand def = Operand::vreg(++K_.maxVregId);
+        Instruction inst = Instruction::makeBinOp(opcode, def, "i32", scalar_[lhs], scalar_[rhs]);
+        inst.nsw = false;
+        bodyInsts_.push_back(std::move(inst));
+        return add({VectorKernel::Value::Kind::Op, opcode, lhs, rhs, 0}, def);
+    }
+    // operand：调用者的操作数在内核中的值（立即数、布尔字面量或循环外定义的 vreg，
+    // 其它种类已由 analyze 排除）
+    int operand(const Operand &op) {
+        if (op.isBoolLit())
+            return constant(op.boolValue() ? 1 : 0);
+        return op.isImm() ? constant(op.immValue()) : param(op.regId());
+    }
+
+    // registers：占用向量寄存器的值（广播与运算）个数
+    int registers() const {
+        return static_cast<int>(std::count_if(
+            kernel.values.begin(), kernel.values.end(), [](const VectorKernel::Value &v) {
+                return v.kind != VectorKernel::Value::Kind::Index &&
+                       v.kind != VectorKernel::Value::Kind::Acc;
+            }));
+    }
+
+    void finish(const std::string &name, int result);
+
+  private:
+    Function &K_;
+    std::vector<Operand> scalar_; // values 下标 → 标量函数体中的操作数
+    std::vector<Instruction> bodyInsts_;
+    std::unordered_map<int, int> params_;     // 调用者 vreg → values 下标
+    std::unordered_map<int32_t, int> consts_; // 常量 → values 下标
+    int index_ = -1, acc_ = -1;
+
+    // 形参 %0..%m 之后：%m+1 为迭代序号 k，%m+2 为累加器（形参在 finish 之前已全部确定）
+    int indexVreg() const { return kMaxKernelParams + 1; }
+    int accVreg() const { return kMaxKernelParams + 2; }
+
+    int add(VectorKernel::Value value, Operand scalar) {
+        kernel.values.push_back(value);
+        scalar_.push_back(scalar);
+        return static_cast<int>(kernel.values.size() - 1);
+    }
+};
+
+/**
+ * @brief 生成内核的标量函数体
+ * @details entry → vec_loop（k != cnt 时进入 vec_body；cnt 按无符号数计）→ vec_body（各运算，k + 1）→ vec_loop，
+ *   vec_exit 返回累加器。序号与累加器固定使用 %8 / %9（形参最多 %0..%7），运算从 %10 起
+ */
+void KernelBuilder::finish(const std::string &name, int result) {
+    K_.name = name;
+    K_.returnType = "i32";
+    for (size_t i = 0; i <= args.size(); ++i) {
+        K_.params.push_back({std::to_string(i), "i32"});
+        K_.paramVregs.push_back(static_cast<int>(i));
+    }
+    const Operand k = Operand::vreg(indexVreg()), acc = Operand::vreg(accVreg());
+    const Operand next = Operand::vreg(++K_.maxVregId), cond = Operand::vreg(++K_.maxVregId);
+    kernel.result = result;
+
+    auto block = [&](const char *label) {
+        auto bb = std::make_unique<BasicBlock>();
+        bb->id = static_cast<int>(K_.blocks.size());
+        bb->name = label;
+        K_.blockMap[bb->name] = bb.get();
+        K_.blocks.push_back(std::move(bb));
+        return K_.blocks.back().get();
+    };
+    auto append = [&](BasicBlock *bb, Instruction inst) {
+        Instruction *I = K_.newInst(std::move(inst));
+        I->blockId = bb->id;
+        bb->insts.push_back(I);
+    };
+    BasicBlock *entry = block("entry"), *loop = block("vec_loop"), *body = block("vec_body"),
+               *exit = block("vec_exit");
+    append(entry, Instruction::makeBr(Operand::label(loop->name)));
+
+    Instruction kPhi = Instruction::makePhi(k, "i32");
+    kPhi.addIncoming(Operand::imm(0), entry->name);
+    kPhi.addIncoming(next, body->name);
+    Instruction accPhi = Instruction::makePhi(acc, "i32");
+    accPhi.addIncoming(Operand::imm(0), entry->name);
+    accPhi.addIncoming(scalar_[result], body->name);
+    append(loop, std::move(kPhi));
+    append(loop, std::move(accPhi));
+    append(loop, Instruction::makeICmp(CmpPred::NE, cond, "i32", k, Operand::vreg(0)));
+    append(loop, Instruction::makeCondBr(cond, Operand::label(body->name),
+                                         Operand::label(exit->name)));
+
+    for (Instruction &inst : bodyInsts_)
+        append(body, std::move(inst));
+    Instruction step = Instruction::makeBinOp(Opcode::Add, next, "i32", k, Operand::imm(1));
+    step.nsw = false;
+    append(body, std::move(step));
+    append(body, Instruction::makeBr(Operand::label(loop->name)));
+    append(exit, Instruction::makeRet("i32", acc));
+    K_.buildCFG();
+}
+
+/**
+ * @brief 把循环的全部迭代交给向量内核
+ * @details 前置块按循环自己的入口条件（i0 < n / i0 <= n）分支，成立时进入新块 V：
+ *   %sum = call @内核(cnt, 循环不变量...)，cnt = n - i0（i <= n 时再加 1）按无符号数计为迭代次数；
+ *   归约值加上 %sum、各归纳变量前进 cnt 步后跳回头结点，头结点的比较随即为假、直接退出。
+ *   不成立时走原来的标量循环（不执行）。迭代次数为常数时直接跳到 V
+ */
+bool LoopVectorizer::vectorize(const VectorLoop &VL) {
+    // 迭代次数为常数时，循环体不执行（或 i <= INT_MAX 从 INT_MIN 起，次数回绕为 0）就没有向量化的必要
+    std::optional<int32_t> constCount;
+    if (VL.bound.isImm() && VL.counterInit.isImm()) {
+        const int32_t init = VL.counterInit.immValue(), bound = VL.bound.immValue();
+        const uint32_t count = static_cast<uint32_t>(bound) - static_cast<uint32_t>(init) +
+                               (VL.inclusive ? 1 : 0);
+        if (!(VL.inclusive ? init <= bound : init < bound) || count == 0)
+            return false;
+        constCount = static_cast<int32_t>(count);
+    }
+
+    auto K = std::make_unique<Function>();
+    K->maxVregId = kMaxKernelParams + 2;
+    KernelBuilder KB(*K);
+    std::unordered_map<int, int> valueOf; // 调用者的 vreg → values 下标
+    valueOf[VL.reduction->defReg()] = KB.acc();
+    for (const LoopIV &iv : VL.ivs) {
+        // i0 ± step * j
+        int lanes = KB.index();
+        if (!(iv.step.isImm() && iv.step.immValue() == 1))
+            lanes = KB.op(Opcode::Mul, lanes, KB.operand(iv.step));
+        if (iv.negated)
+            valueOf[iv.phi->defReg()] = KB.op(Opcode::Sub, KB.operand(iv.init), lanes);
+        else if (iv.init.isImm() && iv.init.immValue() == 0)
+            valueOf[iv.phi->defReg()] = lanes;
+        else
+            valueOf[iv.phi->defReg()] = KB.op(Opcode::Add, KB.operand(iv.init), lanes);
+    }
+
+    // 只翻译归约链依赖的运算（其余只供归纳变量递推）
+    Operand next = Operand::none();
+    for (size_t k = 0; k < VL.reduction->numIncoming(); ++k)
+        if (VL.reduction->incomingBlock(k) == Symbol(VL.body->name))
+            next = VL.reduction->incomingValue(k);
+    std::unordered_set<int> needed = {next.regId()};
+    for (auto it = VL.body->insts.rbegin(); it != VL.body->insts.rend(); ++it)
+        if (needed.count((*it)->defReg()))
+            for (int r : (*it)->useRegs())
+                needed.insert(r);
+    for (Instruction *I : VL.body->insts) {
+        if (!needed.count(I->defReg()))
+            continue;
+        int lhs = 0, rhs = 0;
+        for (int side = 0; side < 2; ++side) {
+            const Operand &op = I->ops[side];
+            auto it = op.isVReg() ? valueOf.find(op.regId()) : valueOf.end();
+            (side == 0 ? lhs : rhs) = it != valueOf.end() ? it->second : KB.operand(op);
+        }
+        valueOf[I->defReg()] = KB.op(I->opcode, lhs, rhs);
+    }
+    // 头结点的 i1 比较结果不会出现在运算中（isVectorizable 之外的类型）；形参或寄存器超出上限时放弃
+    if (static_cast<int>(KB.args.size()) > kMaxKernelParams || KB.registers() > kMaxKernelValues)
+        return false;
+    const std::string name = kernelName();
+    KB.finish(name, valueOf.at(next.regId()));
+    K->vectorKernel = std::make_shared<const VectorKernel>(std::move(KB.kernel));
+
+    // 调用者：前置块计算 cnt 并分支，V 调用内核并更新头结点 phi 的入口
+    BasicBlock *P = VL.preheader, *H = VL.header;
+    auto vec = std::make_unique<BasicBlock>();
+    vec->name = H->name + "_vec";
+    while (F_.blockMap.count(vec->name))
+        vec->name += "_";
+    F_.blockMap[vec->name] = vec.get();
+    const Symbol vecName(vec->name), preName(P->name), headerName(H->name);
+    // append：追加到块末尾（已有终结指令时插在它之前）
+    auto append = [&](BasicBlock *bb, Instruction inst) {
+        auto pos = bb->insts.end();
+        if (!bb->insts.empty() && bb->insts.back()->isTerminator())
+            --pos;
+        Instruction *I = F_.newInst(std::move(inst));
+        bb->insts.insert(pos, I);
+        return I->def;
+    };
+    // arith：a <op> b（常量与 0 / 1 的运算直接折叠；不带 nsw，归约值与 cnt 的乘积都可能回绕）
+    auto arith = [&](BasicBlock *bb, Opcode op, Operand a, Operand b) {
+        auto isConst = [](const Operand &x, int value) {
+            return x.isImm() && x.immValue() == value;
+        };
+        if (a.isImm() && b.isImm()) {
+            const uint32_t x = static_cast<uint32_t>(a.immValue()),
+                           y = static_cast<uint32_t>(b.immValue());
+            return Operand::imm(static_cast<int32_t>(op == Opcode::Add   ? x + y
+                                                     : op == Opcode::Sub ? x - y
+                                                                         : x * y));
+        }
+        if ((op == Opcode::Add || op == Opcode::Sub) && isConst(b, 0))
+            return a;
+        if (op == Opcode::Add && isConst(a, 0))
+            return b;
+        if (op == Opcode::Mul && (isConst(a, 1) || isConst(b, 1)))
+            return isConst(a, 1) ? b : a;
+        Instruction inst = Instruction::makeBinOp(op, newVreg(), "i32", a, b);
+        inst.nsw = false;
+        return append(bb, std::move(inst));
+    };
+
+    Operand cnt = Operand::none();
+    if (constCount) {
+        cnt = Operand::imm(*constCount);
+        P->insts.back()->ops[0] = Operand::label(vecName);
+    } else {
+        cnt = arith(P, Opcode::Sub, VL.bound, VL.counterInit);
+        if (VL.inclusive)
+            cnt = arith(P, Opcode::Add, cnt, Operand::imm(1));
+        Operand ok = append(P, Instruction::makeICmp(VL.inclusive ? CmpPred::SLE : CmpPred::SLT,
+                                                     newVreg(), "i32", VL.counterInit, VL.bound));
+        P->insts.back() = F_.newInst(
+            Instruction::makeCondBr(ok, Operand::label(vecName), Operand::label(headerName)));
+    }
+
+    std::vector<Operand> callArgs = {cnt};
+    callArgs.insert(callArgs.end(), KB.args.begin(), KB.args.end());
+    BasicBlock *V = vec.get();
+    const Operand sum =
+        append(V, Instruction::makeCall(newVreg(), "i32", name, std::move(callArgs)));
+    // after：头结点 phi 在 cnt 次迭代之后的值（归约值加上 %sum，归纳变量前进 cnt 步）
+    std::unordered_map<Instruction *, Operand> after;
+    for (size_t k = 0; k < VL.reduction->numIncoming(); ++k)
+        if (VL.reduction->incomingBlock(k) == preName)
+            after[VL.reduction] = arith(V, Opcode::Add, VL.reduction->incomingValue(k), sum);
+    for (const LoopIV &iv : VL.ivs)
+        after[iv.phi] = arith(V, iv.negated ? Opcode::Sub : Opcode::Add, iv.init,
+                              arith(V, Opcode::Mul, cnt, iv.step));
+    append(V, Instruction::makeBr(Operand::label(headerName)));
+
+    for (auto &[I, value] : after) {
+        if (constCount) {
+            for (size_t k = 0; k < I->numIncoming(); ++k)
+                if (I->incomingBlock(k) == preName) {
+                    I->incomingValue(k) = value;
+                    I->ops[2 * k + 1] = Operand::label(vecName);
+                }
+        } else {
+            I->addIncoming(value, vecName);
+        }
+    }
+
+    // V 放在头结点之前，随后重新编号并重建 CFG
+    auto pos = std::find_if(F_.blocks.begin(), F_.blocks.end(),
+                            [&](const auto &bb) { return bb.get() == H; });
+    F_.blocks.insert(pos, std::move(vec));
+    for (size_t i = 0; i < F_.blocks.size(); ++i) {
+        BasicBlock *bb = F_.blocks[i].get();
+        bb->id = static_cast<int>(i);
+        for (Instruction *I : bb->insts)
+            I->blockId = bb->id;
+    }
+    F_.buildCFG();
+    mod_.functions.push_back(std::move(K));
+    return true;
+}
+
+/**
+ * @brief 向量化函数中所有符合条件的最内层循环
+ * @details 每次改写后 CFG 变化，循环森林重新计算；已处理过的头结点（留作标量回退的原循环）跳过
+ */
+int LoopVectorizer::run() {
+    if (F_.blocks.empty() || F_.vectorKernel)
+        return 0;
+    F_.buildCFG();
+    std::unordered_set<std::string> visited;
+    int count = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        std::vector<const Loop *> work;
+        for (const Loop *L : F_.analyses().loops().topLevelLoops())
+            work.push_back(L);
+        while (!work.empty() && !changed) {
+            const Loop *L = work.back();
+            work.pop_back();
+            work.insert(work.end(), L->subLoops.begin(), L->subLoops.end());
+            if (!visited.insert(L->header->name).second)
+                continue;
+            if (auto VL = analyze(L); VL && vectorize(*VL)) {
+                ++count;
+                changed = true;
+            }
+        }
+    }
+    return count;
+}
+
+} // namespace
+
+// vectorizeLoops：对模块中的每个函数执行循环向量化（新生成的内核函数不再处理）
+int vectorizeLoops(Module &mod) {
+    stats::ScopedTimer timer(stats::Phase::Optimize);
+    int count = 0;
+    const size_t n = mod.functions.size();
+    for (size_t i = 0; i < n; ++i)
+        count += LoopVectorizer(mod, *mod.functions[i]).run();
+    stats::add(stats::Counter::VectorizedLoops, static_cast<uint64_t>(count));
+    return count;
+}
+
+} // namespace opt
+} // namespace toyc
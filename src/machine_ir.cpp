@@ -0,0 +1,742 @@
+#include "machine_ir.h"
+#include "statistics.h"
+#include <charconv>
+
+namespace toyc {
+namespace mir {
+
+#pragma region 操作码与寄存器名
+
+// mopcodeName：操作码 → 汇编助记符
+const char *mopcodeName(MOpcode op) {
+    switch (op) {
+    case MOpcode::LI:
+        return "li";
+    case MOpcode::MV:
+        return "mv";
+    case MOpcode::ADD:
+        return "add";
+    case MOpcode::SUB:
+        return "sub";
+    case MOpcode::MUL:
+        return "mul";
+    case MOpcode::MULH:
+        return "mulh";
+    case MOpcode::DIV:
+        return "div";
+    case MOpcode::REM:
+        return "rem";
+    case MOpcode::SLT:
+        return "slt";
+    case MOpcode::ADDI:
+        return "addi";
+    case MOpcode::XORI:
+        return "xori";
+    case MOpcode::ANDI:
+        return "andi";
+    case MOpcode::SLLI:
+        return "slli";
+    case MOpcode::SRLI:
+        return "srli";
+    case MOpcode::SRAI:
+        return "srai";
+    case MOpcode::SEQZ:
+        return "seqz";
+    case MOpcode::SNEZ:
+        return "snez";
+    case MOpcode::LW:
+        return "lw";
+    case MOpcode::LB:
+        return "lb";
+    case MOpcode::SW:
+        return "sw";
+    case MOpcode::SB:
+        return "sb";
+    case MOpcode::BEQ:
+        return "beq";
+    case MOpcode::BNE:
+        return "bne";
+    case MOpcode::BLT:
+        return "blt";
+    case MOpcode::BGE:
+        return "bge";
+    case MOpcode::BGT:
+        return "bgt";
+    case MOpcode::BLE:
+        return "ble";
+    case MOpcode::BNEZ:
+        return "bnez";
+    case MOpcode::J:
+        return "j";
+    case MOpcode::CALL:
+        return "call";
+    case MOpcode::TAIL:
+        return "tail";
+    case MOpcode::RET:
+        return "ret";
+    case MOpcode::VSETVLI:
+        return "vsetvli";
+    case MOpcode::VADD_VV:
+        return "vadd.vv";
+    case MOpcode::VSUB_VV:
+        return "vsub.vv";
+    case MOpcode::VMUL_VV:
+        return "vmul.vv";
+    case MOpcode::VDIV_VV:
+        return "vdiv.vv";
+    case MOpcode::VREM_VV:
+        return "vrem.vv";
+    case MOpcode::VADD_VX:
+        return "vadd.vx";
+    case MOpcode::VMV_V_X:
+        return "vmv.v.x";
+    case MOpcode::VID_V:
+        return "vid.v";
+    case MOpcode::VREDSUM_VS:
+        return "vredsum.vs";
+    case MOpcode::VMV_S_X:
+        return "vmv.s.x";
+    case MOpcode::VMV_X_S:
+        return "vmv.x.s";
+    case MOpcode::FrameSetup:
+    case MOpcode::FrameDestroy:
+    case MOpcode::ProfCount:
+        return "";
+    }
+    return "";
+}
+
+// regName：x0-x31 的 ABI 名称
+const char *regName(int reg) {
+    static const char *const names[32] = {
+        "zero", "ra", "sp", "gp", "tp",  "t0",  "t1", "t2", "s0", "s1", "a0",
+        "a1",   "a2", "a3", "a4", "a5",  "a6",  "a7", "s2", "s3", "s4", "s5",
+        "s6",   "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"};
+    return (reg >= 0 && reg < 32) ? names[reg] : "?";
+}
+
+// vectorRegName：v0-v31
+const char *vectorRegName(int reg) {
+    static const char *const names[32] = {
+        "v0",  "v1",  "v2",  "v3",  "v4",  "v5",  "v6",  "v7",  "v8",  "v9",  "v10",
+        "v11", "v12", "v13", "v14", "v15", "v16", "v17", "v18", "v19", "v20", "v21",
+        "v22", "v23", "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31"};
+    return (reg >= 0 && reg < 32) ? names[reg] : "?";
+}
+
+#pragma endregion
+
+#pragma region 机器指令工厂方法
+
+MachineInstr MachineInstr::li(int rd, int imm) {
+    MachineInstr mi;
+    mi.opcode = MOpcode::LI;
+    mi.rd = static_cast<int8_t>(rd);
+    mi.imm = imm;
+    return mi;
+}
+
+MachineInstr MachineInstr::mv(int rd, int rs) {
+    MachineInstr mi;
+    mi.opcode = MOpcode::MV;
+    mi.rd = static_cast<int8_t>(rd);
+    mi.rs1 = static_cast<int8_t>(rs);
+    return mi;
+}
+
+MachineInstr MachineInstr::rrr(MOpcode op, int rd, int rs1, int rs2) {
+    MachineInstr mi;
+    mi.opcode = op;
+    mi.rd = static_cast<int8_t>(rd);
+    mi.rs1 = static_cast<int8_t>(rs1);
+    mi.rs2 = static_cast<int8_t>(rs2);
+    return mi;
+}
+
+MachineInstr MachineInstr::rri(MOpcode op, int rd, int rs1, int imm) {
+    MachineInstr mi;
+    mi.opcode = op;
+    mi.rd = static_cast<int8_t>(rd);
+    mi.rs1 = static_cast<int8_t>(rs1);
+    mi.imm = imm;
+    return mi;
+}
+
+MachineInstr MachineInstr::rr(MOpcode op, int rd, int rs1) {
+    MachineInstr mi;
+    mi.opcode = op;
+    mi.rd = static_cast<int8_t>(rd);
+    mi.rs1 = static_cast<int8_t>(rs1);
+    return mi;
+}
+
+MachineInstr MachineInstr::load(MOpcode op, int rd, int base, int offset) {
+    MachineInstr mi;
+    mi.opcode = op;
+    mi.rd = static_cast<int8_t>(rd);
+    mi.rs1 = static_cast<int8_t>(base);
+    mi.imm = offset;
+    return mi;
+}
+
+MachineInstr MachineInstr::store(MOpcode op, int rs, int base, int offset) {
+    MachineInstr mi;
+    mi.opcode = op;
+    mi.rs2 = static_cast<int8_t>(rs);
+    mi.rs1 = static_cast<int8_t>(base);
+    mi.imm = offset;
+    return mi;
+}
+
+MachineInstr MachineInstr::branch(MOpcode op, int rs1, int rs2, int target) {
+    MachineInstr mi;
+    mi.opcode = op;
+    mi.rs1 = static_cast<int8_t>(rs1);
+    mi.rs2 = static_cast<int8_t>(rs2);
+    mi.target = target;
+    return mi;
+}
+
+MachineInstr MachineInstr::bnez(int rs, int target) {
+    MachineInstr mi;
+    mi.opcode = MOpcode::BNEZ;
+    mi.rs1 = static_cast<int8_t>(rs);
+    mi.target = target;
+    return mi;
+}
+
+MachineInstr MachineInstr::jump(int target) {
+    MachineInstr mi;
+    mi.opcode = MOpcode::J;
+    mi.target = target;
+    return mi;
+}
+
+MachineInstr MachineInstr::call(ir::Symbol callee) {
+    MachineInstr mi;
+    mi.opcode = MOpcode::CALL;
+    mi.sym = callee;
+    return mi;
+}
+
+MachineInstr MachineInstr::tail(ir::Symbol callee) {
+    MachineInstr mi;
+    mi.opcode = MOpcode::TAIL;
+    mi.sym = callee;
+    return mi;
+}
+
+MachineInstr MachineInstr::ret() {
+    MachineInstr mi;
+    mi.opcode = MOpcode::RET;
+    return mi;
+}
+
+MachineInstr MachineInstr::pseudo(MOpcode op) {
+    MachineInstr mi;
+    mi.opcode = op;
+    return mi;
+}
+
+MachineInstr MachineInstr::profCount(ir::Symbol counters, int index) {
+    MachineInstr mi;
+    mi.opcode = MOpcode::ProfCount;
+    mi.sym = counters;
+    mi.imm = index * 4;
+    return mi;
+}
+
+MachineInstr MachineInstr::vsetvli(int rd, int avl, int vtype) {
+    MachineInstr mi;
+    mi.opcode = MOpcode::VSETVLI;
+    mi.rd = rd;
+    mi.rs1 = avl;
+    mi.imm = vtype;
+    return mi;
+}
+
+// profileCounterLabel：.Lprof_ 前缀的局部标签不进入目标文件的符号表
+std::string profileCounterLabel(std::string_view function) {
+    return std::string(".Lprof_").append(function);
+}
+
+// isBranch：是否为条件分支
+bool MachineInstr::isBranch() const {
+    switch (opcode) {
+    case MOpcode::BEQ:
+    case MOpcode::BNE:
+    case MOpcode::BLT:
+    case MOpcode::BGE:
+    case MOpcode::BGT:
+    case MOpcode::BLE:
+    case MOpcode::BNEZ:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// isVector：是否为 RVV 向量指令（操作码在 VSETVLI 到 VMV_X_S 之间连续排列）
+bool MachineInstr::isVector() const {
+    return opcode >= MOpcode::VSETVLI && opcode <= MOpcode::VMV_X_S;
+}
+
+#pragma endregion
+
+#pragma region 栈帧伪指令展开
+
+/**
+ * @brief 展开 FrameSetup / FrameDestroy 伪指令
+ * @param MF 目标机器函数（frameSize 与 calleeSavedRegs 已确定）
+ * @details 栈帧布局（高地址 → 低地址）：ra | s0 | callee-saved ... | 局部变量 | 溢出 | 调用区
+ *   prologue: addi sp, sp, -N → sw ra → sw s0 → addi s0, sp, N → sw callee-saved
+ *   epilogue: lw callee-saved → lw ra → lw s0 → addi sp, sp, N
+ *   省略帧指针时没有 s0 一项：ra | callee-saved ... | ...，其余指令不变；叶函数同样没有 ra 一项。
+ *   frameSize 为 0（叶函数没有任何栈上数据）时 prologue / epilogue 都为空
+ */
+void expandFramePseudos(MachineFunction &MF) {
+    constexpr int RA = 1, SP = 2, S0 = 8;
+    const int N = MF.frameSize;
+
+    std::vector<MachineInstr> prologue, epilogue;
+    if (N > 0) {
+        prologue.push_back(MachineInstr::rri(MOpcode::ADDI, SP, SP, -N));
+        int offset = N - 4;
+        const int raOffset = offset, s0Offset = MF.savesReturnAddress ? offset - 4 : offset;
+        if (MF.savesReturnAddress) {
+            prologue.push_back(MachineInstr::store(MOpcode::SW, RA, SP, raOffset));
+            offset -= 4;
+        }
+        if (MF.framePointer) {
+            prologue.push_back(MachineInstr::store(MOpcode::SW, S0, SP, s0Offset));
+            prologue.push_back(MachineInstr::rri(MOpcode::ADDI, S0, SP, N));
+            offset -= 4;
+        }
+        for (int reg : MF.calleeSavedRegs) {
+            prologue.push_back(MachineInstr::store(MOpcode::SW, reg, SP, offset));
+            epilogue.push_back(MachineInstr::load(MOpcode::LW, reg, SP, offset));
+            offset -= 4;
+        }
+        if (MF.savesReturnAddress)
+            epilogue.push_back(MachineInstr::load(MOpcode::LW, RA, SP, raOffset));
+        if (MF.framePointer)
+            epilogue.push_back(MachineInstr::load(MOpcode::LW, S0, SP, s0Offset));
+        epilogue.push_back(MachineInstr::rri(MOpcode::ADDI, SP, SP, N));
+    }
+
+    for (auto &MBB : MF.blocks) {
+        std::vector<MachineInstr> expanded;
+        expanded.reserve(MBB.insts.size());
+        bool changed = false;
+        for (auto &MI : MBB.insts) {
+            if (MI.opcode == MOpcode::FrameSetup) {
+                expanded.insert(expanded.end(), prologue.begin(), prologue.end());
+                changed = true;
+            } else if (MI.opcode == MOpcode::FrameDestroy) {
+                expanded.insert(expanded.end(), epilogue.begin(), epilogue.end());
+                changed = true;
+            } else {
+                expanded.push_back(MI);
+            }
+        }
+        if (changed)
+            MBB.insts = std::move(expanded);
+    }
+}
+
+#pragma endregion
+
+#pragma region RV32C 压缩形式
+
+namespace {
+
+constexpr int kSP = 2;
+
+bool fitsImm6(int v) { return v >= -32 && v <= 31; }
+
+// fitsScaledUimm：v 是 scale 的倍数且落在 [0, limit]
+bool fitsScaledUimm(int v, int scale, int limit) { return v >= 0 && v <= limit && v % scale == 0; }
+
+} // namespace
+
+/**
+ * @brief 选出指令的 16 位压缩形式
+ * @details 只识别 RV32C 中与本编译器输出对应的形式；x0 作为目标、立即数为 0 的 c.addi / 移位
+ *   在规范中是 HINT 或保留编码，不使用。寄存器-寄存器形式要求 rd 与第一个源操作数相同
+ *   （add 可交换，rd 与任一源相同即可）
+ */
+CForm compressedForm(const MachineInstr &MI) {
+    const bool rdC = isCompressibleReg(MI.rd), rs1C = isCompressibleReg(MI.rs1),
+               rs2C = isCompressibleReg(MI.rs2);
+    switch (MI.opcode) {
+    case MOpcode::LI:
+        return MI.rd > 0 && fitsImm6(MI.imm) ? CForm::Li : CForm::None;
+    case MOpcode::MV:
+        return MI.rd > 0 && MI.rs1 > 0 ? CForm::Mv : CForm::None;
+    case MOpcode::ADD:
+        if (MI.rd <= 0 || MI.rs1 <= 0 || MI.rs2 <= 0)
+            return CForm::None;
+        return MI.rd == MI.rs1 || MI.rd == MI.rs2 ? CForm::Add : CForm::None;
+    case MOpcode::SUB:
+        return rdC && MI.rd == MI.rs1 && rs2C ? CForm::Sub : CForm::None;
+    case MOpcode::ADDI:
+        if (MI.rd == kSP && MI.rs1 == kSP && MI.imm != 0 && MI.imm % 16 == 0 && MI.imm >= -512 &&
+            MI.imm <= 496)
+            return CForm::Addi16sp;
+        if (rdC && MI.rs1 == kSP && MI.imm != 0 && fitsScaledUimm(MI.imm, 4, 1020))
+            return CForm::Addi4spn;
+        if (MI.imm == 0 && MI.rd > 0 && MI.rs1 > 0)
+            return CForm::Mv; // addi rd, rs, 0 与 mv 相同
+        return MI.rd > 0 && MI.rd == MI.rs1 && MI.imm != 0 && fitsImm6(MI.imm) ? CForm::Addi
+                                                                              : CForm::None;
+    case MOpcode::ANDI:
+        return rdC && MI.rd == MI.rs1 && fitsImm6(MI.imm) ? CForm::Andi : CForm::None;
+    case MOpcode::SLLI:
+        return MI.rd > 0 && MI.rd == MI.rs1 && MI.imm != 0 ? CForm::Slli : CForm::None;
+    case MOpcode::SRLI:
+        return rdC && MI.rd == MI.rs1 && MI.imm != 0 ? CForm::Srli : CForm::None;
+    case MOpcode::SRAI:
+        return rdC && MI.rd == MI.rs1 && MI.imm != 0 ? CForm::Srai : CForm::None;
+    case MOpcode::LW:
+        if (MI.rs1 == kSP && MI.rd > 0 && fitsScaledUimm(MI.imm, 4, 252))
+            return CForm::Lwsp;
+        return rdC && rs1C && fitsScaledUimm(MI.imm, 4, 124) ? CForm::Lw : CForm::None;
+    case MOpcode::SW:
+        if (MI.rs1 == kSP && fitsScaledUimm(MI.imm, 4, 252))
+            return CForm::Swsp;
+        return rs2C && rs1C && fitsScaledUimm(MI.imm, 4, 124) ? CForm::Sw : CForm::None;
+    case MOpcode::RET:
+        return CForm::Jr;
+    default:
+        return CForm::None;
+    }
+}
+
+#pragma endregion
+
+#pragma region 汇编打印
+
+// appendReg：追加寄存器 ABI 名称
+void AsmPrinter::appendReg(int reg) { line_.append(regName(reg)); }
+
+// appendVReg：追加向量寄存器名称
+void AsmPrinter::appendVReg(int reg) { line_.append(vectorRegName(reg)); }
+
+// appendImm：追加十进制整数（std::to_chars，无临时字符串）
+void AsmPrinter::appendImm(int value) {
+    char buf[16];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    line_.append(buf, res.ptr);
+}
+
+/**
+ * @brief 输出一个机器函数
+ * @details .globl → 函数标签 → 各基本块（非入口块输出标签）→ .size。含 RVV 指令的函数前后
+ *   用 .option push / arch, +v / pop 临时启用 v 扩展，其余函数仍按 -march 汇编
+ */
+void AsmPrinter::printFunction(const MachineFunction &MF) {
+    stats::ScopedTimer timer(stats::Phase::Emit);
+    out_.beginFunction();
+    if (MF.usesVector) {
+        out_.instr(".option push");
+        out_.instr(".option arch, +v");
+    }
+    line_.assign(".globl ").append(MF.name);
+    out_.instr(line_);
+    out_.label(MF.name);
+
+    for (size_t bi = 0; bi < MF.blocks.size(); ++bi) {
+        const auto &MBB = MF.blocks[bi];
+        if (bi > 0)
+            out_.label(MBB.label);
+        for (const auto &MI : MBB.insts)
+            printInst(MF, MI);
+    }
+
+    line_.assign(".size ").append(MF.name).append(", .-").append(MF.name);
+    out_.instr(line_);
+    if (MF.usesVector)
+        out_.instr(".option pop");
+    if (!MF.profileBlocks.empty())
+        printProfileRecord(MF);
+    out_.raw("\n");
+    out_.finishFunction();
+}
+
+/**
+ * @brief 输出插桩函数的剖析记录（toyc_prof 段）
+ * @details 记录格式（小端，4 字节对齐）：
+ *   .word 计数器个数 n | .word 名字表字节数 | 名字表 "函数名\n块名\n..."（补齐到 4 字节）| n 个计数器
+ *   链接器把所有目标文件的 toyc_prof 段首尾相接并定义 __start_toyc_prof / __stop_toyc_prof，
+ *   运行时（scripts/profile_rt.s）在程序退出前把整段原样写入 toyc.profraw，由 ProfileData 解析
+ */
+void AsmPrinter::printProfileRecord(const MachineFunction &MF) {
+    std::string names = MF.name + "\n";
+    for (const std::string &block : MF.profileBlocks)
+        names.append(block).push_back('\n');
+    out_.instr(".section toyc_prof,\"aw\",@progbits");
+    out_.instr(".p2align 2");
+    line_.assign(".word ");
+    appendImm(static_cast<int>(MF.profileBlocks.size()));
+    out_.instr(line_);
+    line_.assign(".word ");
+    appendImm(static_cast<int>(names.size()));
+    out_.instr(line_);
+    line_.assign(".ascii \"");
+    for (char c : names) {
+        if (c == '\n')
+            line_.append("\\n");
+        else
+            line_.push_back(c);
+    }
+    line_.push_back('"');
+    out_.instr(line_);
+    out_.instr(".p2align 2");
+    out_.label(profileCounterLabel(MF.name));
+    line_.assign(".zero ");
+    appendImm(static_cast<int>(MF.profileBlocks.size() * 4));
+    out_.instr(line_);
+    out_.instr(".text");
+}
+
+// printProfCount：counters[k]++（lui t0, %hi(L+off); lw t1, %lo(L+off)(t0); addi; sw）
+void AsmPrinter::printProfCount(const MachineInstr &MI) {
+    std::string addr = MI.sym.str();
+    addr.push_back('+');
+    char buf[16];
+    addr.append(buf, std::to_chars(buf, buf + sizeof(buf), MI.imm).ptr);
+    line_.assign("lui t0, %hi(").append(addr).push_back(')');
+    out_.instr(line_);
+    line_.assign("lw t1, %lo(").append(addr).append(")(t0)");
+    out_.instr(line_);
+    out_.instr("addi t1, t1, 1");
+    line_.assign("sw t1, %lo(").append(addr).append(")(t0)");
+    out_.instr(line_);
+}
+
+/**
+ * @brief 输出压缩形式的指令
+ * @details 操作数按 c.* 的汇编语法：两地址形式省略与 rd 相同的源操作数，c.add 的另一个源操作数
+ *   取 rs1 / rs2 中与 rd 不同的那个
+ */
+void AsmPrinter::printCompressed(const MachineInstr &MI, CForm form) {
+    stats::add(stats::Counter::CompressedInsts);
+    auto regImm = [&](const char *op, int reg, int imm) {
+        line_.assign(op);
+        appendReg(reg);
+        line_.append(", ");
+        appendImm(imm);
+    };
+    auto regMem = [&](const char *op, int reg) {
+        regImm(op, reg, MI.imm);
+        line_.push_back('(');
+        appendReg(MI.rs1);
+        line_.push_back(')');
+    };
+    auto regReg = [&](const char *op, int rd, int rs) {
+        line_.assign(op);
+        appendReg(rd);
+        line_.append(", ");
+        appendReg(rs);
+    };
+    switch (form) {
+    case CForm::Li:
+        regImm("c.li ", MI.rd, MI.imm);
+        break;
+    case CForm::Mv:
+        regReg("c.mv ", MI.rd, MI.rs1);
+        break;
+    case CForm::Add:
+        regReg("c.add ", MI.rd, MI.rd == MI.rs1 ? MI.rs2 : MI.rs1);
+        break;
+    case CForm::Sub:
+        regReg("c.sub ", MI.rd, MI.rs2);
+        break;
+    case CForm::Addi:
+        regImm("c.addi ", MI.rd, MI.imm);
+        break;
+    case CForm::Addi16sp:
+        regImm("c.addi16sp ", MI.rd, MI.imm);
+        break;
+    case CForm::Addi4spn:
+        regReg("c.addi4spn ", MI.rd, MI.rs1);
+        line_.append(", ");
+        appendImm(MI.imm);
+        break;
+    case CForm::Andi:
+        regImm("c.andi ", MI.rd, MI.imm);
+        break;
+    case CForm::Slli:
+        regImm("c.slli ", MI.rd, MI.imm);
+        break;
+    case CForm::Srli:
+        regImm("c.srli ", MI.rd, MI.imm);
+        break;
+    case CForm::Srai:
+        regImm("c.srai ", MI.rd, MI.imm);
+        break;
+    case CForm::Lw:
+        regMem("c.lw ", MI.rd);
+        break;
+    case CForm::Lwsp:
+        regMem("c.lwsp ", MI.rd);
+        break;
+    case CForm::Sw:
+        regMem("c.sw ", MI.rs2);
+        break;
+    case CForm::Swsp:
+        regMem("c.swsp ", MI.rs2);
+        break;
+    case CForm::Jr:
+        line_.assign("c.jr ra");
+        break;
+    case CForm::None:
+        return;
+    }
+    out_.instr(line_);
+}
+
+// printInst：按指令格式输出一行汇编
+void AsmPrinter::printInst(const MachineFunction &MF, const MachineInstr &MI) {
+    if (compressed_) {
+        if (CForm form = compressedForm(MI); form != CForm::None)
+            return printCompressed(MI, form);
+    }
+    line_.assign(mopcodeName(MI.opcode));
+    line_.push_back(' ');
+    switch (MI.opcode) {
+    case MOpcode::LI:
+        appendReg(MI.rd);
+        line_.append(", ");
+        appendImm(MI.imm);
+        break;
+    case MOpcode::MV:
+    case MOpcode::SEQZ:
+    case MOpcode::SNEZ:
+        appendReg(MI.rd);
+        line_.append(", ");
+        appendReg(MI.rs1);
+        break;
+    case MOpcode::ADD:
+    case MOpcode::SUB:
+    case MOpcode::MUL:
+    case MOpcode::MULH:
+    case MOpcode::DIV:
+    case MOpcode::REM:
+    case MOpcode::SLT:
+        appendReg(MI.rd);
+        line_.append(", ");
+        appendReg(MI.rs1);
+        line_.append(", ");
+        appendReg(MI.rs2);
+        break;
+    case MOpcode::ADDI:
+    case MOpcode::XORI:
+    case MOpcode::ANDI:
+    case MOpcode::SLLI:
+    case MOpcode::SRLI:
+    case MOpcode::SRAI:
+        appendReg(MI.rd);
+        line_.append(", ");
+        appendReg(MI.rs1);
+        line_.append(", ");
+        appendImm(MI.imm);
+        break;
+    case MOpcode::LW:
+    case MOpcode::LB:
+        appendReg(MI.rd);
+        line_.append(", ");
+        appendImm(MI.imm);
+        line_.push_back('(');
+        appendReg(MI.rs1);
+        line_.push_back(')');
+        break;
+    case MOpcode::SW:
+    case MOpcode::SB:
+        appendReg(MI.rs2);
+        line_.append(", ");
+        appendImm(MI.imm);
+        line_.push_back('(');
+        appendReg(MI.rs1);
+        line_.push_back(')');
+        break;
+    case MOpcode::BEQ:
+    case MOpcode::BNE:
+    case MOpcode::BLT:
+    case MOpcode::BGE:
+    case MOpcode::BGT:
+    case MOpcode::BLE:
+        appendReg(MI.rs1);
+        line_.append(", ");
+        appendReg(MI.rs2);
+        line_.append(", ");
+        line_.append(MF.blocks[MI.target].label);
+        break;
+    case MOpcode::BNEZ:
+        appendReg(MI.rs1);
+        line_.append(", ");
+        line_.append(MF.blocks[MI.target].label);
+        break;
+    case MOpcode::J:
+        line_.append(MF.blocks[MI.target].label);
+        break;
+    case MOpcode::CALL:
+    case MOpcode::TAIL:
+        line_.append(MI.sym.str());
+        break;
+    case MOpcode::RET:
+        line_.pop_back(); // ret 无操作数
+        break;
+    case MOpcode::VSETVLI:
+        appendReg(MI.rd);
+        line_.append(", ");
+        appendReg(MI.rs1);
+        line_.append(", e32, m1, ").append(MI.imm & 0x40 ? "ta" : "tu").append(", ma");
+        break;
+    case MOpcode::VADD_VV:
+    case MOpcode::VSUB_VV:
+    case MOpcode::VMUL_VV:
+    case MOpcode::VDIV_VV:
+    case MOpcode::VREM_VV:
+    case MOpcode::VREDSUM_VS:
+        appendVReg(MI.rd);
+        line_.append(", ");
+        appendVReg(MI.rs1);
+        line_.append(", ");
+        appendVReg(MI.rs2);
+        break;
+    case MOpcode::VADD_VX:
+        appendVReg(MI.rd);
+        line_.append(", ");
+        appendVReg(MI.rs1);
+        line_.append(", ");
+        appendReg(MI.rs2);
+        break;
+    case MOpcode::VMV_V_X:
+    case MOpcode::VMV_S_X:
+        appendVReg(MI.rd);
+        line_.append(", ");
+        appendReg(MI.rs1);
+        break;
+    case MOpcode::VID_V:
+        appendVReg(MI.rd);
+        break;
+    case MOpcode::VMV_X_S:
+        appendReg(MI.rd);
+        line_.append(", ");
+        appendVReg(MI.rs1);
+        break;
+    case MOpcode::FrameSetup:
+    case MOpcode::FrameDestroy:
+        return; // 伪指令应已被 expandFramePseudos 展开
+    case MOpcode::ProfCount:
+        printProfCount(MI);
+        return;
+    }
+    out_.instr(line_);
+}
+
+#pragma endregion
+
+} // namespace mir
+} // namespace toyc
@@ -1,39 +1,488 @@
 // ToyC 编译器主入口
-// 支持两种输入：.c/.tc（ToyC 源码）和 .ll（LLVM IR 文本）
-// 输出模式：--ast / --ir / --asm / --all（默认输出汇编）
+// 支持三种输入：.c/.tc（ToyC 源码）、.ll（LLVM IR 文本）和 .bir（二进制 IR）
+// 输出模式：--ast / --ir / --asm / --all（默认输出汇编），-c 直接输出 ELF 目标文件，
+// --emit-bir 输出二进制 IR（供后续阶段跳过前端直接读取），--function 只编译选中的函数，
+// -O1 / -O2 在代码生成前执行 IR 优化（mem2reg + SCCP + GVN + LICM / 强度削减 + DCE + CFG 化简 + 内联），--regalloc=linear|graph 选择寄存器分配算法
+// -fschedule-insns / -mtune=<model> 按延迟模型在块内调度指令（-O1 起默认开启），--march=rv32imc 输出压缩指令
+// --march=rv32imv 把归约 / 归纳变量循环交给按 vsetvli 分段的 RVV 内核（-O1 起）
+// -fipra 过程间寄存器分配：被调函数先编译，调用点只保存它实际改写的寄存器（-O2 默认开启）
+// -fomit-frame-pointer 局部变量按 sp 寻址，s0 作为被调用者保存寄存器参与分配
+// --profile-generate 输出插桩汇编（块计数器），--profile-use=<file> 按实测计数指导内联、溢出权重与块布局
+// 批量模式：--batch 在一个进程内编译多个输入（目录 / 文件 / @list）
+// 服务模式：--server 常驻进程，通过 stdin / stdout 或 Unix 域套接字逐个处理编译请求
 
 #include "ast.h"
+#include "batch_driver.h"
+#include "codegen_cache.h"
+#include "compile_server.h"
 #include "ir.h"
+#include "ir_binary.h"
 #include "ir_builder.h"
 #include "ir_parser.h"
+#include "ir_passes.h"
 #include "parser.h"
+#include "profile.h"
 #include "riscv_codegen.h"
+#include "source_buffer.h"
+#include "statistics.h"
+#include "thread_pool.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
-// readFile：读取文件全部内容为字符串
-static std::string readFile(const std::string &path) {
-    std::ifstream ifs(path);
-    if (!ifs.is_open()) {
+// readFile：映射输入文件（词法分析直接在映射区上进行，不复制源码）
+static toyc::SourceBuffer readFile(const std::string &path) {
+    try {
+        return toyc::SourceBuffer::open(path);
+    } catch (const std::runtime_error &) {
         std::cerr << "Error: Cannot open file '" << path << "'\n";
         exit(1);
     }
-    return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+// TeeBuf：把写入同时转发到两个输出流（用于同时输出汇编到 stdout 和 -o 文件）
+class TeeBuf : public std::streambuf {
+  public:
+    TeeBuf(std::streambuf *a, std::streambuf *b) : a_(a), b_(b) {}
+
+  protected:
+    int overflow(int c) override {
+        if (c == traits_type::eof())
+            return traits_type::not_eof(c);
+        if (a_->sputc(static_cast<char>(c)) == traits_type::eof() ||
+            b_->sputc(static_cast<char>(c)) == traits_type::eof())
+            return traits_type::eof();
+        return c;
+    }
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        std::streamsize na = a_->sputn(s, n);
+        std::streamsize nb = b_->sputn(s, n);
+        return std::min(na, nb);
+    }
+    int sync() override { return (a_->pubsync() == 0 && b_->pubsync() == 0) ? 0 : -1; }
+
+  private:
+    std::streambuf *a_, *b_;
+};
+
+// CodeGenFn：把汇编或目标文件写入给定输出流（整个模块或逐函数加载两种来源共用输出逻辑）
+using CodeGenFn = std::function<void(std::ostream &)>;
+
+// writeAssembly：生成汇编并流式写入 stdout 和/或输出文件（不在内存中保留整份汇编）
+static void writeAssembly(const CodeGenFn &gen, bool toStdout, const std::string &outputFile) {
+    if (outputFile.empty()) {
+        if (toStdout)
+            gen(std::cout);
+        return;
+    }
+    std::ofstream ofs(outputFile);
+    if (!ofs.is_open()) {
+        std::cerr << "Error: Cannot open output file '" << outputFile << "'\n";
+        exit(1);
+    }
+    try {
+        if (toStdout) {
+            TeeBuf tee(std::cout.rdbuf(), ofs.rdbuf());
+            std::ostream both(&tee);
+            gen(both);
+            both.flush();
+        } else {
+            gen(ofs);
+        }
+    } catch (...) {
+        // 流水线中途失败（如 .bir 的某个函数体损坏）时不留下不完整的汇编文件
+        ofs.close();
+        std::remove(outputFile.c_str());
+        throw;
+    }
+}
+
+// writeObject：直接生成 ELF32 可重定位目标文件（不经过汇编文本）
+static void writeObject(const CodeGenFn &gen, const std::string &outputFile) {
+    std::ofstream ofs(outputFile, std::ios::binary);
+    if (!ofs.is_open()) {
+        std::cerr << "Error: Cannot open output file '" << outputFile << "'\n";
+        exit(1);
+    }
+    try {
+        gen(ofs);
+    } catch (const std::runtime_error &e) {
+        // 流式编译源码时语法错误在生成途中才出现，与一次解析整个文件时的报告格式相同
+        if (dynamic_cast<const ParseError *>(&e))
+            std::cerr << e.what() << "\n";
+        else
+            std::cerr << "Error: " << e.what() << "\n";
+        ofs.close();
+        std::remove(outputFile.c_str());
+        exit(1);
+    }
+}
+
+// moduleAsm / moduleObject：以整个模块为来源的代码生成
+static CodeGenFn moduleAsm(toyc::ir::Module &mod, unsigned jobs, toyc::CodeGenCache *cache,
+                           toyc::RegAllocKind regAlloc, bool profileGenerate,
+                           const toyc::mir::LatencyModel *sched, bool compressed, bool ipra,
+                           bool omitFP) {
+    return [&mod, jobs, cache, regAlloc, profileGenerate, sched, compressed, ipra,
+            omitFP](std::ostream &os) {
+        toyc::generateRISCVAssembly(mod, os, jobs, cache, regAlloc, profileGenerate, sched,
+                                    compressed, ipra, omitFP);
+    };
+}
+static CodeGenFn moduleObject(toyc::ir::Module &mod, unsigned jobs, toyc::CodeGenCache *cache,
+                              toyc::RegAllocKind regAlloc, const toyc::mir::LatencyModel *sched,
+                              bool compressed, bool ipra, bool omitFP) {
+    return [&mod, jobs, cache, regAlloc, sched, compressed, ipra, omitFP](std::ostream &os) {
+        toyc::generateRISCVObject(mod, os, jobs, cache, regAlloc, sched, compressed, ipra,
+                                  omitFP);
+    };
+}
+
+// writeBinaryIRFile：输出 .bir 二进制 IR
+static void writeBinaryIRFile(const toyc::ir::Module &mod, const std::string &outputFile) {
+    std::ofstream ofs(outputFile, std::ios::binary);
+    if (!ofs.is_open()) {
+        std::cerr << "Error: Cannot open output file '" << outputFile << "'\n";
+        exit(1);
+    }
+    toyc::writeBinaryIR(mod, ofs);
+}
+
+// defaultOutputName：-c / --emit-bir 未指定 -o 时的默认输出文件名（去掉目录与扩展名，追加 ext）
+static std::string defaultOutputName(const std::string &inputFile, const char *ext) {
+    std::string base = inputFile.substr(inputFile.find_last_of('/') + 1);
+    auto dot = base.find_last_of('.');
+    if (dot != std::string::npos && dot > 0)
+        base.resize(dot);
+    return base + ext;
+}
+
+// StatsOptions：--time-passes / --stats / --stats-json 选择的统计输出
+struct StatsOptions {
+    bool timePasses = false; // 阶段耗时表
+    bool counters = false;   // 计数器表
+    bool json = false;       // JSON（包含阶段与计数器）
+
+    bool any() const { return timePasses || counters || json; }
+
+    // parse：识别统计选项，是则返回 true
+    bool parse(const char *arg) {
+        if (std::strcmp(arg, "--time-passes") == 0)
+            timePasses = true;
+        else if (std::strcmp(arg, "--stats") == 0)
+            counters = true;
+        else if (std::strcmp(arg, "--stats-json") == 0)
+            json = true;
+        else
+            return false;
+        return true;
+    }
+};
+
+// StatsReport：作用域结束时把统计写到 stderr（开启统计须在任何编译工作之前）
+class StatsReport {
+  public:
+    explicit StatsReport(const StatsOptions &opts) : opts_(opts) {
+        if (opts_.any())
+            toyc::stats::enable();
+    }
+    ~StatsReport() {
+        if (opts_.any())
+            std::cout.flush(); // 统计在所有常规输出之后出现
+        if (opts_.timePasses)
+            toyc::stats::reportTimes(std::cerr);
+        if (opts_.counters)
+            toyc::stats::reportCounters(std::cerr);
+        if (opts_.json)
+            toyc::stats::reportJson(std::cerr);
+    }
+
+  private:
+    StatsOptions opts_;
+};
+
+// parseJobs：解析 -j 参数（0 表示使用全部硬件线程）
+static unsigned parseJobs(const char *arg) {
+    char *end = nullptr;
+    long n = std::strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || n < 0) {
+        std::cerr << "Error: Invalid job count '" << arg << "'\n";
+        exit(1);
+    }
+    return n == 0 ? toyc::ThreadPool::hardwareThreads() : static_cast<unsigned>(n);
+}
+
+// parseOptLevel：解析 -O0 / -O1 / -O2
+static int parseOptLevel(const char *arg) {
+    if (arg[2] >= '0' && arg[2] <= '2' && arg[3] == '\0')
+        return arg[2] - '0';
+    std::cerr << "Error: Unsupported optimization level '" << arg << "' (use -O0, -O1 or -O2)\n";
+    exit(1);
+}
+
+// parseInlineLimit：解析 -finline-limit=N（非负整数，0 表示不内联）
+static int parseInlineLimit(const char *arg) {
+    const char *value = arg + std::strlen("-finline-limit=");
+    char *end = nullptr;
+    long n = std::strtol(value, &end, 10);
+    if (end == value || *end != '\0' || n < 0 || n > 1000000) {
+        std::cerr << "Error: Invalid inline limit '" << value << "'\n";
+        exit(1);
+    }
+    return static_cast<int>(n);
+}
+
+// parseRegAlloc：解析 --regalloc=linear|graph
+static toyc::RegAllocKind parseRegAlloc(const char *arg) {
+    const char *name = arg + std::strlen("--regalloc=");
+    toyc::RegAllocKind kind;
+    if (toyc::parseRegAllocKind(name, kind))
+        return kind;
+    std::cerr << "Error: Unknown register allocator '" << name << "' (use linear or graph)\n";
+    exit(1);
+}
+
+// parseIPRA：识别 -fipra / -fno-ipra，是则写入 ipra 并返回 true（-1 表示随优化级别）
+static bool parseIPRA(const char *arg, int &ipra) {
+    if (std::strcmp(arg, "-fipra") == 0)
+        ipra = 1;
+    else if (std::strcmp(arg, "-fno-ipra") == 0)
+        ipra = 0;
+    else
+        return false;
+    return true;
+}
+
+// resolveIPRA：过程间寄存器分配默认在 -O2 开启
+static bool resolveIPRA(int ipra, int optLevel) { return ipra < 0 ? optLevel >= 2 : ipra != 0; }
+
+// parseOmitFramePointer：识别 -fomit-frame-pointer / -fno-omit-frame-pointer，是则写入 omitFP
+static bool parseOmitFramePointer(const char *arg, bool &omitFP) {
+    if (std::strcmp(arg, "-fomit-frame-pointer") == 0)
+        omitFP = true;
+    else if (std::strcmp(arg, "-fno-omit-frame-pointer") == 0)
+        omitFP = false;
+    else
+        return false;
+    return true;
+}
+
+// parseMarch：解析 --march=rv32im|rv32imc|rv32imv|rv32imcv，c 为压缩指令，v 为向量扩展
+// （循环向量化）
+static void parseMarch(const char *arg, bool &compressed, bool &vector) {
+    const std::string_view name = arg + std::strlen("--march=");
+    if (name == "rv32im" || name == "rv32imc" || name == "rv32imv" || name == "rv32imcv") {
+        compressed = name.size() > 6 && name[6] == 'c';
+        vector = name.back() == 'v';
+        return;
+    }
+    std::cerr << "Error: Unknown --march '" << name
+              << "' (use rv32im, rv32imc, rv32imv or rv32imcv)\n";
+    exit(1);
+}
+
+// ScheduleOptions：-fschedule-insns / -fno-schedule-insns / -mtune 选择的指令调度
+struct ScheduleOptions {
+    int enabled = -1;              // -1 表示随优化级别（-O1 起调度）
+    toyc::mir::LatencyModel model; // -mtune 选择的延迟模型（默认 generic）
+
+    // parse：识别调度选项，是则返回 true（-mtune 格式错误时报错退出）
+    bool parse(const char *arg) {
+        if (std::strcmp(arg, "-fschedule-insns") == 0) {
+            enabled = 1;
+        } else if (std::strcmp(arg, "-fno-schedule-insns") == 0) {
+            enabled = 0;
+        } else if (std::strncmp(arg, "-mtune=", 7) == 0) {
+            auto parsed = toyc::mir::parseLatencyModel(arg + 7);
+            if (!parsed) {
+                std::cerr << "Error: Invalid -mtune '" << arg + 7 << "' (models: "
+                          << toyc::mir::latencyModelNames()
+                          << "; overrides: alu|load|mul|div=<1-64>)\n";
+                exit(1);
+            }
+            model = *parsed;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // resolve：本次编译使用的延迟模型（不调度时为 std::nullopt）
+    std::optional<toyc::mir::LatencyModel> resolve(int optLevel) const {
+        if (enabled == 0 || (enabled < 0 && optLevel == 0))
+            return std::nullopt;
+        return model;
+    }
+};
+
+// cacheOptions：影响代码生成结果、需要写入缓存配置的选项（不同分配器生成的代码互不命中；
+// 剖析计数记在每个函数的键里）
+static std::string cacheOptions(toyc::RegAllocKind regAlloc, bool profileGenerate,
+                                const toyc::mir::LatencyModel *sched, bool compressed, bool ipra,
+                                bool omitFP) {
+    std::string options = std::string("regalloc=") + toyc::regAllocKindName(regAlloc);
+    if (compressed)
+        options += " march=rv32imc";
+    if (ipra)
+        options += " ipra";
+    if (omitFP)
+        options += " omit-frame-pointer";
+    if (profileGenerate)
+        options += " profile-generate";
+    if (sched)
+        options += " sched=" + sched->toString();
+    return options;
+}
+
+// loadProfile：读取 --profile-use 指定的剖析数据（失败时报错退出）
+static toyc::ProfileData loadProfile(const std::string &path) {
+    try {
+        return toyc::ProfileData::load(path);
+    } catch (const std::runtime_error &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        exit(1);
+    }
 }
 
 // printUsage：输出命令行帮助信息
 static void printUsage(const char *prog) {
-    std::cerr << "Usage: " << prog << " <input.[c|tc|ll]> [options]\n"
+    std::cerr << "Usage: " << prog << " <input.[c|tc|ll|bir]> [options]\n"
+              << "       " << prog << " --batch <dir|file|@list>... [-o <dir>] [-c] [-j <N>]\n"
+              << "       " << prog << " --server [--socket <path>] [-j <N>] [--cache-dir <dir>]\n"
               << "Options:\n"
               << "  --ast         Print AST\n"
               << "  --ir          Print LLVM IR\n"
               << "  --asm         Print RISC-V assembly\n"
               << "  --all         Print AST + IR + ASM\n"
-              << "  -o <file>     Write assembly to file\n";
+              << "  -o <file>     Write assembly (or object with -c) to file\n"
+              << "  -c            Emit an ELF32 relocatable object instead of assembly\n"
+              << "  --emit-bir    Emit binary IR (.bir) instead of assembly\n"
+              << "  -j <N>        Generate code for N functions in parallel (0 = all cores)\n"
+              << "  -O<level>     IR optimization: -O0 none (default), -O1/-O2 mem2reg, SCCP, GVN, LICM, DCE, CFG simplification, inlining\n"
+              << "  -finline-limit=<N>  Inline calls whose net size growth is at most N instructions\n"
+              << "                (scaled up inside loops; default "
+              << toyc::opt::kDefaultInlineLimit << ", 0 disables inlining)\n"
+              << "  --regalloc=<linear|graph>  Register allocator: linear scan (default) or\n"
+              << "                graph coloring with iterated coalescing\n"
+              << "  -fschedule-insns / -fno-schedule-insns  Schedule instructions within each\n"
+              << "                block to avoid pipeline stalls (default on from -O1)\n"
+              << "  -mtune=<model>[,alu|load|mul|div=<N>]  Latency model for scheduling\n"
+              << "                (models: " << toyc::mir::latencyModelNames() << "; default generic)\n"
+              << "  --march=<rv32im|rv32imc|rv32imv|rv32imcv>  Target ISA; c emits 16-bit\n"
+              << "                compressed instructions and favours x8-x15 in register\n"
+              << "                allocation, v vectorizes reduction loops with RVV (from -O1)\n"
+              << "  -fipra / -fno-ipra  Interprocedural register allocation: compile callees\n"
+              << "                first, save only registers the callee clobbers (default on at -O2)\n"
+              << "  -fomit-frame-pointer  Address the frame from sp and allocate s0 as a\n"
+              << "                callee-saved register (default off)\n"
+              << "  --function <name>  Only compile function <name> (repeatable)\n"
+              << "  --cache-dir <dir>  Reuse code generated for unchanged functions from <dir>\n"
+              << "  --profile-generate  Instrument every basic block with an execution counter;\n"
+              << "                link with scripts/profile_rt.s, running writes toyc.profraw\n"
+              << "  --profile-use=<file>  Use block counts from <file> for inlining, spill\n"
+              << "                weights and block layout\n"
+              << "  --time-passes Print per-phase wall time and peak RSS to stderr\n"
+              << "  --stats       Print instruction / vreg / interval / spill counters to stderr\n"
+              << "  --stats-json  Print phase timings and counters as JSON to stderr\n"
+              << "Batch options:\n"
+              << "  -o <dir>      Output directory (default: next to each input)\n"
+              << "  --suffix <s>  Append <s> to each output base name (e.g. _toyc)\n"
+              << "  -c / -j <N>   Emit objects / compile N translation units in parallel\n"
+              << "  -O<level>     IR optimization level for every input\n"
+              << "  -finline-limit=<N>  Inlining threshold for every input\n"
+              << "  --regalloc=<linear|graph>  Register allocator for every input\n"
+              << "  -fschedule-insns / -fno-schedule-insns / -mtune=<model>  Scheduling for every input\n"
+              << "  --march=<rv32im|rv32imc|rv32imv|rv32imcv>  Target ISA for every input\n"
+              << "  -fipra / -fno-ipra  Interprocedural register allocation for every input\n"
+              << "  -fomit-frame-pointer  Frame pointer elimination for every input\n"
+              << "  --cache-dir <dir>  Share one function-level code cache across all inputs\n"
+              << "  --time-passes / --stats / --stats-json  Report totals over all inputs\n"
+              << "Server options:\n"
+              << "  --socket <path>  Listen on a Unix domain socket (default: stdin/stdout)\n"
+              << "  -j <N>        Worker threads kept alive across requests\n"
+              << "  --cache-dir <dir>  Function-level code cache shared by all requests\n"
+              << "  Requests: 'compile <bytes> [options]' + source, 'ping', 'quit', 'shutdown'\n";
+}
+
+// runBatchMode：toyc --batch <dir|file|@list>... [-o dir] [--suffix s] [-c] [-j N]
+static int runBatchMode(int argc, char *argv[]) {
+    toyc::BatchOptions opts;
+    StatsOptions statsOpts;
+    ScheduleOptions schedOpts;
+    int ipra = -1;
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; ++i) {
+        if (statsOpts.parse(argv[i]) || schedOpts.parse(argv[i]) || parseIPRA(argv[i], ipra) ||
+            parseOmitFramePointer(argv[i], opts.omitFramePointer))
+            continue;
+        if (std::strcmp(argv[i], "-c") == 0)
+            opts.emitObject = true;
+        else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            opts.outputDir = argv[++i];
+        else if (std::strcmp(argv[i], "--suffix") == 0 && i + 1 < argc)
+            opts.suffix = argv[++i];
+        else if (std::strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc)
+            opts.cacheDir = argv[++i];
+        else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            opts.jobs = parseJobs(argv[++i]);
+        else if (std::strncmp(argv[i], "-j", 2) == 0 && argv[i][2] != '\0')
+            opts.jobs = parseJobs(argv[i] + 2);
+        else if (std::strncmp(argv[i], "-O", 2) == 0)
+            opts.optLevel = parseOptLevel(argv[i]);
+        else if (std::strncmp(argv[i], "-finline-limit=", 15) == 0)
+            opts.inlineLimit = parseInlineLimit(argv[i]);
+        else if (std::strncmp(argv[i], "--regalloc=", 11) == 0)
+            opts.regAlloc = parseRegAlloc(argv[i]);
+        else if (std::strncmp(argv[i], "--march=", 8) == 0)
+            parseMarch(argv[i], opts.compressed, opts.vectorize);
+        else
+            args.push_back(argv[i]);
+    }
+    opts.schedule = schedOpts.resolve(opts.optLevel);
+    opts.ipra = resolveIPRA(ipra, opts.optLevel);
+    try {
+        opts.inputs = toyc::collectBatchInputs(args);
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    if (opts.inputs.empty()) {
+        std::cerr << "Error: --batch given no input files\n";
+        return 1;
+    }
+    StatsReport report(statsOpts);
+    return toyc::runBatch(opts, std::cout) == 0 ? 0 : 1;
+}
+
+// runServerMode：toyc --server [--socket <path>] [-j N] [--cache-dir <dir>]
+static int runServerMode(int argc, char *argv[]) {
+    toyc::ServerOptions opts;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+            opts.socketPath = argv[++i];
+        else if (std::strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc)
+            opts.cacheDir = argv[++i];
+        else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            opts.jobs = parseJobs(argv[++i]);
+        else if (std::strncmp(argv[i], "-j", 2) == 0 && argv[i][2] != '\0')
+            opts.jobs = parseJobs(argv[i] + 2);
+        else {
+            std::cerr << "Error: Unknown --server option '" << argv[i] << "'\n";
+            return 1;
+        }
+    }
+    return toyc::runServer(opts);
 }
 
 int main(int argc, char *argv[]) {
@@ -41,13 +490,35 @@ int main(int argc, char *argv[]) {
         printUsage(argv[0]);
         return 1;
     }
+    if (std::strcmp(argv[1], "--batch") == 0)
+        return runBatchMode(argc, argv);
+    if (std::strcmp(argv[1], "--server") == 0)
+        return runServerMode(argc, argv);
 
     // 解析命令行参数
     std::string inputFile = argv[1];
-    bool printAst = false, printIr = false, printAsm = false;
+    bool printAst = false, printIr = false, printAsm = false, emitObject = false;
+    bool emitBir = false;
     std::string outputFile;
+    unsigned jobs = 1;
+    int optLevel = 0;                       // -O 优化级别
+    int inlineLimit = toyc::opt::kDefaultInlineLimit; // -finline-limit 内联阈值
+    toyc::RegAllocKind regAlloc = toyc::RegAllocKind::Linear; // --regalloc 寄存器分配算法
+    bool compressed = false;                // --march=rv32imc 压缩指令
+    bool vectorize = false;                 // --march=rv32imv 循环向量化
+    int ipra = -1;                          // -fipra / -fno-ipra（-1 表示随优化级别）
+    bool omitFP = false;                    // -fomit-frame-pointer 省略帧指针
+    std::vector<std::string> functionNames; // --function 选中的函数（为空表示全部）
+    std::string cacheDir;                   // --cache-dir 增量编译缓存目录（为空表示不使用）
+    bool profileGenerate = false;           // --profile-generate 块计数器插桩
+    std::string profileFile;                // --profile-use 剖析数据文件（为空表示不使用）
+    StatsOptions statsOpts;
+    ScheduleOptions schedOpts;
 
     for (int i = 2; i < argc; ++i) {
+        if (statsOpts.parse(argv[i]) || schedOpts.parse(argv[i]) || parseIPRA(argv[i], ipra) ||
+            parseOmitFramePointer(argv[i], omitFP))
+            continue;
         if (std::strcmp(argv[i], "--ast") == 0)
             printAst = true;
         else if (std::strcmp(argv[i], "--ir") == 0)
@@ -56,45 +527,274 @@ int main(int argc, char *argv[]) {
             printAsm = true;
         else if (std::strcmp(argv[i], "--all") == 0) {
             printAst = printIr = printAsm = true;
-        } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        } else if (std::strcmp(argv[i], "-c") == 0)
+            emitObject = true;
+        else if (std::strcmp(argv[i], "--emit-bir") == 0)
+            emitBir = true;
+        else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
             outputFile = argv[++i];
+        else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            jobs = parseJobs(argv[++i]);
+        else if (std::strncmp(argv[i], "-j", 2) == 0 && argv[i][2] != '\0')
+            jobs = parseJobs(argv[i] + 2);
+        else if (std::strncmp(argv[i], "-O", 2) == 0)
+            optLevel = parseOptLevel(argv[i]);
+        else if (std::strncmp(argv[i], "-finline-limit=", 15) == 0)
+            inlineLimit = parseInlineLimit(argv[i]);
+        else if (std::strncmp(argv[i], "--regalloc=", 11) == 0)
+            regAlloc = parseRegAlloc(argv[i]);
+        else if (std::strncmp(argv[i], "--march=", 8) == 0)
+            parseMarch(argv[i], compressed, vectorize);
+        else if (std::strcmp(argv[i], "--function") == 0 && i + 1 < argc)
+            functionNames.push_back(argv[++i]);
+        else if (std::strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc)
+            cacheDir = argv[++i];
+        else if (std::strcmp(argv[i], "--profile-generate") == 0)
+            profileGenerate = true;
+        else if (std::strncmp(argv[i], "--profile-use=", 14) == 0)
+            profileFile = argv[i] + 14;
     }
 
+    if (emitObject && emitBir) {
+        std::cerr << "Error: -c and --emit-bir cannot be used together\n";
+        return 1;
+    }
+    // 计数器数组与剖析记录位于单独的数据段，只有汇编输出携带它们
+    if (emitObject && profileGenerate) {
+        std::cerr << "Error: --profile-generate requires assembly output (not -c)\n";
+        return 1;
+    }
+
+    // -c / --emit-bir：输出目标文件或二进制 IR，不再默认打印汇编
+    if (emitObject && outputFile.empty())
+        outputFile = defaultOutputName(inputFile, ".o");
+    if (emitBir && outputFile.empty())
+        outputFile = defaultOutputName(inputFile, ".bir");
+
     // 默认输出汇编
-    if (!printAst && !printIr && !printAsm)
+    if (!printAst && !printIr && !printAsm && !emitObject && !emitBir)
         printAsm = true;
 
+    // 指令调度：-O1 起默认开启，-fschedule-insns / -fno-schedule-insns 显式开关
+    const std::optional<toyc::mir::LatencyModel> schedule = schedOpts.resolve(optLevel);
+    const toyc::mir::LatencyModel *sched = schedule ? &*schedule : nullptr;
+    // 过程间寄存器分配：-O2 默认开启，-fipra / -fno-ipra 显式开关
+    const bool useIPRA = resolveIPRA(ipra, optLevel);
+
+    // 统计：在 main 返回时输出（先于缓存与输入构造，覆盖全部阶段）
+    StatsReport report(statsOpts);
+
+    // 增量编译缓存：未改动的函数直接复用上次的代码生成结果
+    std::optional<toyc::CodeGenCache> cacheStore;
+    if (!cacheDir.empty())
+        cacheStore.emplace(cacheDir,
+                           cacheOptions(regAlloc, profileGenerate, sched, compressed, useIPRA,
+                                        omitFP));
+    toyc::CodeGenCache *cache = cacheStore ? &*cacheStore : nullptr;
+
+    // 剖析数据：优化前写入一次（供内联使用），优化后再写入一次（优化中合并、新建的块
+    // 在插桩构建里有同名块时取实测值），之后由寄存器分配与块布局读取
+    std::optional<toyc::ProfileData> profile;
+    if (!profileFile.empty())
+        profile = loadProfile(profileFile);
+    auto annotate = [&](auto &unit) {
+        if (profile)
+            profile->annotate(unit);
+    };
+
     // 读取输入文件
-    std::string source = readFile(inputFile);
-    // 判断是否为 .ll（LLVM IR）输入
+    toyc::SourceBuffer source = readFile(inputFile);
+    // 判断是否为 .ll（LLVM IR）或 .bir（二进制 IR，按魔数识别）输入
     bool isLLFile = (inputFile.size() >= 3 && inputFile.substr(inputFile.size() - 3) == ".ll");
+    bool isBirFile = toyc::isBinaryIR(source.text());
 
-    if (isLLFile) {
-        // .ll 输入 → 解析为结构化 IR → 代码生成
-        toyc::IRParser parser;
-        auto mod = parser.parseModule(source);
-        if (!mod || mod->functions.empty()) {
+    if (isLLFile || isBirFile) {
+        // .ll / .bir 输入：先只建立函数索引（.ll 扫描 define 边界，.bir 读取文件中的索引），
+        // 函数体在真正用到时才解析 / 解码
+        std::optional<toyc::BinaryIRReader> bir;
+        std::optional<toyc::LazyIRModule> lazy;
+        try {
+            if (isBirFile)
+                bir.emplace(source.text());
+            else
+                lazy.emplace(source.text());
+        } catch (const std::runtime_error &e) {
+            std::cerr << "Error: " << e.what() << " in '" << inputFile << "'\n";
+            return 1;
+        }
+        const size_t numFuncs = bir ? bir->numFunctions() : lazy->size();
+        if (numFuncs == 0) {
             std::cerr << "Error: Failed to parse LLVM IR from '" << inputFile << "'\n";
             return 1;
         }
-        if (printIr)
-            std::cout << mod->toString();
 
-        std::string asmOutput = toyc::generateRISCVAssembly(*mod);
-        if (printAsm)
-            std::cout << asmOutput;
-        if (!outputFile.empty()) {
-            std::ofstream ofs(outputFile);
-            ofs << asmOutput;
+        // --function：只编译选中的函数（保持其在输入中的顺序），其余函数体从不被解析
+        std::vector<size_t> picks;
+        if (functionNames.empty()) {
+            for (size_t i = 0; i < numFuncs; ++i)
+                picks.push_back(i);
+        } else {
+            for (const std::string &name : functionNames) {
+                int idx = bir ? bir->findFunction(name) : lazy->find(name);
+                if (idx < 0) {
+                    std::cerr << "Error: Function '" << name << "' not found in '" << inputFile
+                              << "'\n";
+                    return 1;
+                }
+                picks.push_back(static_cast<size_t>(idx));
+            }
+            std::sort(picks.begin(), picks.end());
+            picks.erase(std::unique(picks.begin(), picks.end()), picks.end());
+        }
+
+        try {
+            // 只生成一种代码输出时走流水线：逐函数 解析 → 优化 → 分配 → 输出，函数编译完立即释放。
+            // 内联需要看到被调函数的函数体、过程间寄存器分配需要调用图、向量化要向模块添加内核函数，
+            // 开启时同样加载完整模块
+            const bool inlining = optLevel > 0 && inlineLimit > 0;
+            if (!printIr && !emitBir && !(emitObject && printAsm) && !inlining && !useIPRA &&
+                !vectorize) {
+                toyc::FunctionLoader load = [&](size_t k) {
+                    auto func = bir ? bir->readFunction(picks[k]) : lazy->take(picks[k]);
+                    annotate(*func);
+                    toyc::opt::optimizeFunction(*func, optLevel);
+                    annotate(*func);
+                    return func;
+                };
+                if (emitObject)
+                    writeObject(
+                        [&](std::ostream &os) {
+                            toyc::generateRISCVObject(picks.size(), load, os, jobs, cache,
+                                                      regAlloc, sched, compressed, omitFP);
+                        },
+                        outputFile);
+                else
+                    writeAssembly(
+                        [&](std::ostream &os) {
+                            toyc::generateRISCVAssembly(picks.size(), load, os, jobs, cache,
+                                                        regAlloc, profileGenerate, sched,
+                                                        compressed, omitFP);
+                        },
+                        printAsm, outputFile);
+                return 0;
+            }
+
+            // 需要完整模块（打印 IR / 输出 .bir / 同时输出汇编与目标文件）时才全部加载
+            std::unique_ptr<toyc::ir::Module> mod;
+            if (bir) {
+                mod = bir->readModule(picks);
+            } else if (functionNames.empty()) {
+                toyc::IRParser parser;
+                mod = parser.parseModule(source.text(), jobs);
+            } else {
+                mod = std::make_unique<toyc::ir::Module>();
+                for (size_t i : picks)
+                    mod->functions.push_back(lazy->take(i));
+            }
+            annotate(*mod);
+            toyc::opt::optimizeModule(*mod, optLevel, inlineLimit);
+            if (vectorize)
+                toyc::opt::vectorizeLoops(*mod);
+            annotate(*mod);
+            if (printIr)
+                std::cout << mod->toString();
+
+            if (emitBir) {
+                if (printAsm)
+                    toyc::generateRISCVAssembly(*mod, std::cout, jobs, cache, regAlloc,
+                                                profileGenerate, sched, compressed, useIPRA,
+                                                omitFP);
+                writeBinaryIRFile(*mod, outputFile);
+            } else if (emitObject) {
+                if (printAsm)
+                    toyc::generateRISCVAssembly(*mod, std::cout, jobs, cache, regAlloc,
+                                                profileGenerate, sched, compressed, useIPRA,
+                                                omitFP);
+                writeObject(
+                    moduleObject(*mod, jobs, cache, regAlloc, sched, compressed, useIPRA, omitFP),
+                    outputFile);
+            } else {
+                writeAssembly(
+                    moduleAsm(*mod, jobs, cache, regAlloc, profileGenerate, sched, compressed,
+                              useIPRA, omitFP),
+                    printAsm, outputFile);
+            }
+        } catch (const std::runtime_error &e) {
+            std::cerr << "Error: " << e.what() << " in '" << inputFile << "'\n";
+            return 1;
         }
     } else {
+        // 只生成一种代码输出、且不需要整个模块（与 .ll 输入的条件相同）时逐函数流式编译：
+        // 先做一遍词法扫描找出函数边界，之后每个函数 解析 → 生成 IR → 优化 → 分配 → 输出，
+        // AST 与 IR 随即释放，峰值内存与最大的单个函数成正比
+        const bool inlining = optLevel > 0 && inlineLimit > 0;
+        if (!printAst && !printIr && !emitBir && !(emitObject && printAsm) && !inlining &&
+            !useIPRA && !vectorize) {
+            toyc::LazySourceModule lazy(source.text());
+            std::vector<size_t> picks;
+            if (functionNames.empty()) {
+                for (size_t i = 0; i < lazy.size(); ++i)
+                    picks.push_back(i);
+            } else {
+                for (const std::string &name : functionNames) {
+                    int idx = lazy.find(name);
+                    if (idx < 0) {
+                        std::cerr << "Error: Function '" << name << "' not found in '"
+                                  << inputFile << "'\n";
+                        return 1;
+                    }
+                    picks.push_back(static_cast<size_t>(idx));
+                }
+                std::sort(picks.begin(), picks.end());
+                picks.erase(std::unique(picks.begin(), picks.end()), picks.end());
+            }
+            toyc::FunctionLoader load = [&](size_t k) {
+                auto func = lazy.take(picks[k]);
+                annotate(*func);
+                toyc::opt::optimizeFunction(*func, optLevel);
+                annotate(*func);
+                return func;
+            };
+            try {
+                if (emitObject) {
+                    writeObject(
+                        [&](std::ostream &os) {
+                            toyc::generateRISCVObject(picks.size(), load, os, jobs, cache,
+                                                      regAlloc, sched, compressed, omitFP);
+                        },
+                        outputFile);
+                } else {
+                    if (printAsm)
+                        std::cout << "=== RISC-V Assembly ===\n";
+                    writeAssembly(
+                        [&](std::ostream &os) {
+                            toyc::generateRISCVAssembly(picks.size(), load, os, jobs, cache,
+                                                        regAlloc, profileGenerate, sched,
+                                                        compressed, omitFP);
+                        },
+                        printAsm, outputFile);
+                }
+            } catch (const ParseError &e) {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+            return 0;
+        }
+
         // .c / .tc 输入 → 词法分析 → 语法分析 → AST → IR → 代码生成
-        Parser parser(source);
-        auto funcs = parser.parseCompUnit();
+        CompUnit unit;
+        try {
+            toyc::stats::ScopedTimer timer(toyc::stats::Phase::Parse);
+            Parser parser(source.text());
+            unit = parser.parseCompUnit();
+        } catch (const ParseError &e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
 
         if (printAst) {
             std::cout << "=== AST ===\n";
-            for (auto &f : funcs)
+            for (const FuncDef *f : unit.funcs)
                 f->print(0, std::cout);
             std::cout << "\n";
         }
@@ -104,8 +804,35 @@ int main(int argc, char *argv[]) {
             return 0;
 
         // AST → 结构化 IR
-        toyc::IRBuilder builder;
-        auto mod = builder.buildModule(funcs);
+        std::unique_ptr<toyc::ir::Module> mod;
+        {
+            toyc::stats::ScopedTimer timer(toyc::stats::Phase::IRBuild);
+            toyc::IRBuilder builder;
+            mod = builder.buildModule(unit);
+        }
+
+        // --function：只保留选中的函数
+        if (!functionNames.empty()) {
+            for (const std::string &name : functionNames) {
+                if (std::none_of(mod->functions.begin(), mod->functions.end(),
+                                 [&](const auto &f) { return f->name == name; })) {
+                    std::cerr << "Error: Function '" << name << "' not found in '" << inputFile
+                              << "'\n";
+                    return 1;
+                }
+            }
+            std::erase_if(mod->functions, [&](const auto &f) {
+                return std::find(functionNames.begin(), functionNames.end(), f->name) ==
+                       functionNames.end();
+            });
+        }
+
+        // IR 优化（--ir 输出、.bir 与代码生成都使用优化后的 IR）
+        annotate(*mod);
+        toyc::opt::optimizeModule(*mod, optLevel, inlineLimit);
+        if (vectorize)
+            toyc::opt::vectorizeLoops(*mod);
+        annotate(*mod);
 
         if (printIr) {
             std::cout << "=== LLVM IR ===\n";
@@ -113,16 +840,29 @@ int main(int argc, char *argv[]) {
             std::cout << "\n";
         }
 
-        if (printAsm || !outputFile.empty()) {
-            std::string asmOutput = toyc::generateRISCVAssembly(*mod);
+        if (emitBir) {
             if (printAsm) {
                 std::cout << "=== RISC-V Assembly ===\n";
-                std::cout << asmOutput;
+                toyc::generateRISCVAssembly(*mod, std::cout, jobs, cache, regAlloc,
+                                            profileGenerate, sched, compressed, useIPRA, omitFP);
             }
-            if (!outputFile.empty()) {
-                std::ofstream ofs(outputFile);
-                ofs << asmOutput;
+            writeBinaryIRFile(*mod, outputFile);
+        } else if (emitObject) {
+            if (printAsm) {
+                std::cout << "=== RISC-V Assembly ===\n";
+                toyc::generateRISCVAssembly(*mod, std::cout, jobs, cache, regAlloc,
+                                            profileGenerate, sched, compressed, useIPRA, omitFP);
             }
+            writeObject(
+                moduleObject(*mod, jobs, cache, regAlloc, sched, compressed, useIPRA, omitFP),
+                outputFile);
+        } else if (printAsm || !outputFile.empty()) {
+            if (printAsm)
+                std::cout << "=== RISC-V Assembly ===\n";
+            writeAssembly(
+                moduleAsm(*mod, jobs, cache, regAlloc, profileGenerate, sched, compressed,
+                          useIPRA, omitFP),
+                printAsm, outputFile);
         }
     }
 
@@ -0,0 +1,457 @@
+#include "ir_analysis.h"
+#include "ir_passes.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+namespace {
+
+// ======================== CFG 预处理 ========================
+
+// truncateAfterTerminators：删除每个块中第一条终结指令之后的指令
+// IRBuilder 在 return / break 之后继续向同一块追加指令，它们永远不会执行；
+// 其中的 alloca 先移到入口块开头（后面可达块中的 load / store 仍可能引用它）
+void truncateAfterTerminators(Function &F) {
+    std::vector<Instruction *> hoisted;
+    for (auto &bb : F.blocks) {
+        auto term = std::find_if(bb->insts.begin(), bb->insts.end(),
+                                 [](const Instruction *I) { return I->isTerminator(); });
+        if (term == bb->insts.end())
+            continue;
+        for (auto it = term + 1; it != bb->insts.end(); ++it)
+            if ((*it)->opcode == Opcode::Alloca)
+                hoisted.push_back(*it);
+        bb->insts.erase(term + 1, bb->insts.end());
+    }
+    BasicBlock *entry = F.entryBlock();
+    for (Instruction *I : hoisted)
+        I->blockId = entry->id;
+    entry->insts.insert(entry->insts.begin(), hoisted.begin(), hoisted.end());
+}
+
+} // namespace
+
+// removeUnreachableBlocks：删除从入口不可达的块并重新编号（保持其余块的相对顺序，
+// fall-through 关系不变），返回是否删除了块；调用后 CFG 已重建
+bool removeUnreachableBlocks(Function &F) {
+    F.buildCFG();
+    const DominatorTree &DT = F.analyses().domTree();
+    if (DT.rpo().size() == F.blocks.size())
+        return false;
+
+    // 不可达块中的 alloca 同样移到入口块（与 truncateAfterTerminators 的理由相同）
+    BasicBlock *entry = F.entryBlock();
+    std::vector<Instruction *> hoisted;
+    std::vector<std::unique_ptr<BasicBlock>> kept;
+    for (auto &bb : F.blocks) {
+        if (DT.isReachable(bb.get())) {
+            kept.push_back(std::move(bb));
+            continue;
+        }
+        for (Instruction *I : bb->insts)
+            if (I->opcode == Opcode::Alloca)
+                hoisted.push_back(I);
+    }
+    entry->insts.insert(entry->insts.begin(), hoisted.begin(), hoisted.end());
+
+    F.blocks = std::move(kept);
+    F.blockMap.clear();
+    for (size_t i = 0; i < F.blocks.size(); ++i) {
+        BasicBlock *bb = F.blocks[i].get();
+        bb->id = static_cast<int>(i);
+        F.blockMap[bb->name] = bb;
+        for (Instruction *I : bb->insts)
+            I->blockId = bb->id;
+    }
+    F.buildCFG();
+    return true;
+}
+
+namespace {
+
+// ======================== 提升 ========================
+
+// PromotedSlot：一个可提升的 alloca
+struct PromotedSlot {
+    Instruction *alloca = nullptr;
+    Symbol type;                     // 槽的类型（i32 / i1）
+    std::vector<BasicBlock *> defs;  // 含 store 的块（去重）
+    std::vector<Operand> stack;      // 重命名时的到达值栈
+};
+
+// Mem2Reg：单个函数上的提升过程
+class Mem2Reg {
+  public:
+    explicit Mem2Reg(Function &F) : F_(F), nextVreg_(F.maxVregId + 1) {}
+
+    int run();
+
+  private:
+    Function &F_;
+    int nextVreg_;
+    std::vector<PromotedSlot> slots_;
+    std::unordered_map<int, int> slotOf_;         // alloca vreg → slots_ 下标
+    std::unordered_map<Instruction *, int> phiSlot_; // 放置的 phi → slots_ 下标
+    std::unordered_map<int, Operand> replace_;    // 被删除的 load / phi 的 def → 替代值
+    std::vector<char> isBool_;                    // vreg → 是否已知为 0/1（icmp / i1 phi）
+
+    void collectSlots();
+    void placePhis(const DominatorTree &DT);
+    void rename(const DominatorTree &DT);
+    void renameBlock(BasicBlock *bb, std::vector<int> &pushed);
+    void removeRedundantPhis();
+    void rewriteOperands();
+
+    Operand resolve(Operand op);
+    Operand undefValue(const PromotedSlot &slot) const {
+        return slot.type == "i1" ? Operand::boolLit(false) : Operand::imm(0);
+    }
+    bool knownBool(const Operand &op) const {
+        return op.isBoolLit() || (op.isVReg() && static_cast<size_t>(op.regId()) < isBool_.size() &&
+                                  isBool_[op.regId()]);
+    }
+    void markBool(int vreg) {
+        if (vreg >= static_cast<int>(isBool_.size()))
+            isBool_.resize(vreg + 1, 0);
+        isBool_[vreg] = 1;
+    }
+    int slotOf(const Operand &ptr) const {
+        if (!ptr.isVReg())
+            return -1;
+        auto it = slotOf_.find(ptr.regId());
+        return it == slotOf_.end() ? -1 : it->second;
+    }
+};
+
+/**
+ * @brief 执行 mem2reg
+ * @details 1. 截断死代码、删除不可达块（此后每个块都在支配树中）
+ *   2. 收集可提升的 alloca：其结果只作为 load 的地址或 store 的地址（ops[1]）出现
+ *   3. 在各槽定义块的迭代支配边界放置 phi，沿支配树重命名
+ *   4. 删除平凡 phi 与无用 phi，把所有操作数替换为最终值，删除已提升的 alloca
+ */
+int Mem2Reg::run() {
+    if (F_.blocks.empty())
+        return 0;
+    truncateAfterTerminators(F_);
+    removeUnreachableBlocks(F_);
+
+    collectSlots();
+    if (slots_.empty())
+        return 0;
+
+    const DominatorTree &DT = F_.analyses().domTree(); // 提升不改变 CFG，结果留给后续变换
+    placePhis(DT);
+    rename(DT);
+    removeRedundantPhis();
+    rewriteOperands();
+
+    for (auto &bb : F_.blocks)
+        std::erase_if(bb->insts, [&](Instruction *I) {
+            return I->opcode == Opcode::Alloca && slotOf_.count(I->defReg());
+        });
+    F_.maxVregId = nextVreg_ - 1;
+    return static_cast<int>(slots_.size());
+}
+
+// collectSlots：找出可提升的 alloca，并记录每个槽的定义块
+void Mem2Reg::collectSlots() {
+    for (auto &bb : F_.blocks)
+        for (Instruction *I : bb->insts)
+            if (I->opcode == Opcode::Alloca && I->def.isVReg()) {
+                slotOf_[I->defReg()] = static_cast<int>(slots_.size());
+                slots_.push_back({I, I->type, {}, {}});
+            }
+
+    // 以任何其他方式使用 alloca 结果（作为 store 的值、运算或调用的操作数）都阻止提升
+    std::vector<char> escaped(slots_.size(), 0);
+    for (auto &bb : F_.blocks) {
+        for (Instruction *I : bb->insts) {
+            for (size_t k = 0; k < I->ops.size(); ++k) {
+                int s = slotOf(I->ops[k]);
+                if (s < 0)
+                    continue;
+                bool isAddress = (I->opcode == Opcode::Load && k == 0) ||
+                                 (I->opcode == Opcode::Store && k == 1);
+                if (!isAddress)
+                    escaped[s] = 1;
+            }
+            if (I->opcode == Opcode::Store) {
+                int s = slotOf(I->ops[1]);
+                if (s >= 0 && (slots_[s].defs.empty() || slots_[s].defs.back() != bb.get()))
+                    slots_[s].defs.push_back(bb.get());
+            }
+        }
+    }
+
+    std::vector<PromotedSlot> kept;
+    std::unordered_map<int, int> keptIndex;
+    for (size_t s = 0; s < slots_.size(); ++s) {
+        if (escaped[s])
+            continue;
+        keptIndex[slots_[s].alloca->defReg()] = static_cast<int>(kept.size());
+        kept.push_back(std::move(slots_[s]));
+    }
+    slots_ = std::move(kept);
+    slotOf_ = std::move(keptIndex);
+}
+
+// placePhis：对每个槽，在其定义块集合的迭代支配边界的每个块入口放置一个 phi
+void Mem2Reg::placePhis(const DominatorTree &DT) {
+    std::vector<int> hasPhi(F_.blocks.size(), -1); // 块 id → 最近放置 phi 的槽
+    std::vector<int> queued(F_.blocks.size(), -1); // 块 id → 最近入队的槽
+    std::vector<std::vector<Instruction *>> newPhis(F_.blocks.size());
+    for (size_t s = 0; s < slots_.size(); ++s) {
+        std::vector<BasicBlock *> work = slots_[s].defs;
+        for (BasicBlock *bb : work)
+            queued[bb->id] = static_cast<int>(s);
+        while (!work.empty()) {
+            BasicBlock *bb = work.back();
+            work.pop_back();
+            for (BasicBlock *df : DT.frontier(bb)) {
+                if (hasPhi[df->id] == static_cast<int>(s))
+                    continue;
+                hasPhi[df->id] = static_cast<int>(s);
+                Instruction *phi = F_.newInst(Instruction::makePhi(
+                    Operand::vreg(nextVreg_++), slots_[s].type.str()));
+                phi->blockId = df->id;
+                if (slots_[s].type == "i1")
+                    markBool(phi->defReg());
+                phiSlot_[phi] = static_cast<int>(s);
+                newPhis[df->id].push_back(phi);
+                if (queued[df->id] != static_cast<int>(s)) {
+                    queued[df->id] = static_cast<int>(s);
+                    work.push_back(df);
+                }
+            }
+        }
+    }
+    for (auto &bb : F_.blocks) {
+        auto &phis = newPhis[bb->id];
+        bb->insts.insert(bb->insts.begin(), phis.begin(), phis.end());
+    }
+}
+
+// resolve：沿替代链取得操作数的最终值（路径压缩）
+Operand Mem2Reg::resolve(Operand op) {
+    if (!op.isVReg())
+        return op;
+    auto it = replace_.find(op.regId());
+    if (it == replace_.end())
+        return op;
+    Operand target = resolve(it->second);
+    it = replace_.find(op.regId()); // 递归可能导致 rehash
+    it->second = target;
+    return target;
+}
+
+/**
+ * @brief 沿支配树重命名
+ * @details 显式栈的支配树深度优先遍历：进入块时处理其指令，并把到达值填入各后继的 phi；
+ *   离开块时弹出它压入的全部到达值（pushed 记录压栈的槽，按块分段）
+ */
+void Mem2Reg::rename(const DominatorTree &DT) {
+    for (auto &bb : F_.blocks)
+        for (Instruction *I : bb->insts)
+            if (I->opcode == Opcode::ICmp)
+                markBool(I->defReg());
+
+    struct Frame {
+        BasicBlock *bb;
+        size_t nextChild;
+        size_t pushedMark; // 进入本块前 pushed 的长度
+    };
+    std::vector<int> pushed;
+    std::vector<Frame> stack;
+    BasicBlock *entry = F_.entryBlock();
+    stack.push_back({entry, 0, 0});
+    renameBlock(entry, pushed);
+    while (!stack.empty()) {
+        Frame &top = stack.back();
+        const auto &kids = DT.children(top.bb);
+        if (top.nextChild < kids.size()) {
+            BasicBlock *child = kids[top.nextChild++];
+            size_t mark = pushed.size();
+            stack.push_back({child, 0, mark});
+            renameBlock(child, pushed);
+            continue;
+        }
+        for (size_t i = top.pushedMark; i < pushed.size(); ++i)
+            slots_[pushed[i]].stack.pop_back();
+        pushed.resize(top.pushedMark);
+        stack.pop_back();
+    }
+}
+
+// renameBlock：处理一个块 —— phi 定义新值，load 替换为到达值，store 更新到达值后删除；
+// 最后为每个（去重的）后继中本槽的 phi 追加来自本块的入口
+void Mem2Reg::renameBlock(BasicBlock *bb, std::vector<int> &pushed) {
+    auto current = [&](int s) {
+        return slots_[s].stack.empty() ? undefValue(slots_[s]) : slots_[s].stack.back();
+    };
+
+    std::vector<Instruction *> out;
+    out.reserve(bb->insts.size());
+    for (Instruction *I : bb->insts) {
+        if (I->opcode == Opcode::Phi) {
+            auto it = phiSlot_.find(I);
+            if (it != phiSlot_.end()) {
+                slots_[it->second].stack.push_back(I->def);
+                pushed.push_back(it->second);
+            }
+            out.push_back(I);
+            continue;
+        }
+        if (I->opcode == Opcode::Load) {
+            int s = slotOf(I->ops[0]);
+            if (s >= 0) {
+                replace_[I->defReg()] = current(s);
+                continue;
+            }
+        }
+        if (I->opcode == Opcode::Store) {
+            int s = slotOf(I->ops[1]);
+            if (s >= 0) {
+                Operand value = resolve(I->ops[0]);
+                if (slots_[s].type == "i1" && !knownBool(value)) {
+                    if (value.isImm()) {
+                        value = Operand::boolLit(value.immValue() != 0);
+                    } else {
+                        // 非布尔值存入 i1 槽：按 C 语义规范化为 value != 0
+                        Operand def = Operand::vreg(nextVreg_++);
+                        Instruction *cmp = F_.newInst(
+                            Instruction::makeICmp(CmpPred::NE, def, "i32", value, Operand::imm(0)));
+                        cmp->blockId = bb->id;
+                        markBool(def.regId());
+                        out.push_back(cmp);
+                        value = def;
+                    }
+                }
+                slots_[s].stack.push_back(value);
+                pushed.push_back(s);
+                continue;
+            }
+        }
+        out.push_back(I);
+    }
+    bb->insts = std::move(out);
+
+    for (size_t i = 0; i < bb->succs.size(); ++i) {
+        BasicBlock *succ = bb->succs[i];
+        if (std::find(bb->succs.begin(), bb->succs.begin() + i, succ) != bb->succs.begin() + i)
+            continue; // br i1 %c, label %x, label %x 只算一条入边
+        for (Instruction *I : succ->insts) {
+            if (I->opcode != Opcode::Phi)
+                break;
+            auto it = phiSlot_.find(I);
+            if (it != phiSlot_.end())
+                I->addIncoming(resolve(current(it->second)), bb->name);
+        }
+    }
+}
+
+/**
+ * @brief 删除冗余 phi
+ * @details 1. 平凡 phi：除自身外所有入口值都相同（或只有自引用），用该值替代，迭代到不动点
+ *   2. 无用 phi：从非 phi 指令的使用出发，沿 phi 的入口值标记活跃，未被标记的 phi 删除
+ */
+void Mem2Reg::removeRedundantPhis() {
+    std::vector<Instruction *> phis;
+    for (auto &bb : F_.blocks)
+        for (Instruction *I : bb->insts)
+            if (phiSlot_.count(I))
+                phis.push_back(I);
+
+    std::vector<char> removed(phis.size(), 0);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t p = 0; p < phis.size(); ++p) {
+            if (removed[p])
+                continue;
+            Instruction *phi = phis[p];
+            Operand same = Operand::none();
+            bool trivial = true;
+            for (size_t k = 0; k < phi->numIncoming(); ++k) {
+                Operand v = resolve(phi->incomingValue(k));
+                if (v.isVReg() && v.regId() == phi->defReg())
+                    continue;
+                if (!same.isNone() && (v.kind() != same.kind() || v.regId() != same.regId())) {
+                    trivial = false;
+                    break;
+                }
+                same = v;
+            }
+            if (!trivial)
+                continue;
+            if (same.isNone())
+                same = undefValue(slots_[phiSlot_[phi]]);
+            replace_[phi->defReg()] = same;
+            removed[p] = 1;
+            changed = true;
+        }
+    }
+
+    // 活跃标记：以 phi 的定义寄存器为键
+    std::unordered_map<int, size_t> phiOfDef;
+    for (size_t p = 0; p < phis.size(); ++p)
+        if (!removed[p])
+            phiOfDef[phis[p]->defReg()] = p;
+    std::vector<char> live(phis.size(), 0);
+    std::vector<size_t> work;
+    auto markUse = [&](Operand op) {
+        op = resolve(op);
+        if (!op.isVReg())
+            return;
+        auto it = phiOfDef.find(op.regId());
+        if (it != phiOfDef.end() && !live[it->second]) {
+            live[it->second] = 1;
+            work.push_back(it->second);
+        }
+    };
+    for (auto &bb : F_.blocks)
+        for (Instruction *I : bb->insts)
+            if (I->opcode != Opcode::Phi)
+                for (const Operand &op : I->ops)
+                    markUse(op);
+            else if (!phiSlot_.count(I))
+                for (const Operand &op : I->ops)
+                    markUse(op); // 输入中原有的 phi 视为始终活跃
+    while (!work.empty()) {
+        Instruction *phi = phis[work.back()];
+        work.pop_back();
+        for (size_t k = 0; k < phi->numIncoming(); ++k)
+            markUse(phi->incomingValue(k));
+    }
+
+    std::unordered_map<Instruction *, char> dead;
+    for (size_t p = 0; p < phis.size(); ++p)
+        if (removed[p] || !live[p])
+            dead[phis[p]] = 1;
+    if (dead.empty())
+        return;
+    for (auto &bb : F_.blocks)
+        std::erase_if(bb->insts, [&](Instruction *I) { return dead.count(I) != 0; });
+}
+
+// rewriteOperands：把所有指令的操作数替换为最终值
+void Mem2Reg::rewriteOperands() {
+    if (replace_.empty())
+        return;
+    for (auto &bb : F_.blocks)
+        for (Instruction *I : bb->insts)
+            for (auto &op : I->ops)
+                op = resolve(op);
+}
+
+} // namespace
+
+// promoteMemoryToRegisters：对单个函数执行 mem2reg
+int promoteMemoryToRegisters(Function &F) { return Mem2Reg(F).run(); }
+
+} // namespace opt
+} // namespace toyc
@@ -1,7 +1,41 @@
 #include "parser.h"
+#include <algorithm>
+#include <charconv>
+
+// binaryOpFor：二元运算符 Token → BinaryOp（调用方保证 t 是二元运算符）
+static BinaryOp binaryOpFor(TokenType t) {
+    switch (t) {
+    case TokenType::PLUS:
+        return BinaryOp::Add;
+    case TokenType::MINUS:
+        return BinaryOp::Sub;
+    case TokenType::TIMES:
+        return BinaryOp::Mul;
+    case TokenType::DIV:
+        return BinaryOp::Div;
+    case TokenType::MOD:
+        return BinaryOp::Mod;
+    case TokenType::LT:
+        return BinaryOp::Lt;
+    case TokenType::GT:
+        return BinaryOp::Gt;
+    case TokenType::LE:
+        return BinaryOp::Le;
+    case TokenType::GE:
+        return BinaryOp::Ge;
+    case TokenType::EQ:
+        return BinaryOp::Eq;
+    case TokenType::NE:
+        return BinaryOp::Ne;
+    case TokenType::AND:
+        return BinaryOp::And;
+    default:
+        return BinaryOp::Or;
+    }
+}
 
 // 构造函数：初始化词法分析器并预读两个 Token 到 cur 和 nxt
-Parser::Parser(const std::string &source) : lex(source) {
+Parser::Parser(std::string_view source, int firstLine) : lex(source, firstLine) {
     cur = lex.nextToken(); // 读取第一个 Token
     nxt = lex.nextToken(); // 读取第二个 Token，实现预读
 }
@@ -21,79 +55,140 @@ bool Parser::match(TokenType t) {
     return false;
 }
 
-// expect：断言 cur 类型为期望值，否则打印错误并退出
+// expect：断言 cur 类型为期望值，否则抛出 ParseError
 void Parser::expect(TokenType t) {
-    if (!match(t)) {
-        std::cerr << "Unexpected token '" << cur.lexeme << "' at line " << cur.line << "\n";
-        exit(1);
-    }
+    if (!match(t))
+        fail("Unexpected token '" + std::string(cur.lexeme) + "' at line " +
+             std::to_string(cur.line));
 }
 
+// fail：以给定信息抛出语法错误（由调用方决定打印或退出）
+void Parser::fail(const std::string &message) { throw ParseError(message, cur.line); }
+
 // parseCompUnit：解析编译单元 CompUnit → FuncDef+，返回所有函数定义
-std::vector<std::shared_ptr<FuncDef>> Parser::parseCompUnit() {
-    std::vector<std::shared_ptr<FuncDef>> funcs;
+CompUnit Parser::parseCompUnit() {
+    CompUnit unit;
+    unit.arena = std::make_unique<ASTArena>();
+    arena = unit.arena.get();
     // 只要下一个是 int 或 void，就不断解析函数定义
     while (cur.type == TokenType::INT || cur.type == TokenType::VOID)
-        funcs.push_back(parseFuncDef());
+        unit.funcs.push_back(parseFuncDef());
+    arena = nullptr;
+    return unit;
+}
+
+/**
+ * @brief 找出顶层函数定义的边界
+ * @details 只运行词法分析：圆括号与花括号深度为 0 时，函数体的 '}' 之后应是下一个定义的
+ *   int / void（或文件结束），每个片段从它的 int / void 开始、到下一个片段开始为止。
+ *   不以 int / void 开头的顶层 Token 结束扫描（parseCompUnit 也在此处停止）；
+ *   片段内部的语法错误留给解析该片段时报告
+ */
+std::vector<SourceFunction> Parser::indexFunctions(std::string_view source) {
+    std::vector<SourceFunction> funcs;
+    Lexer lex(source);
+    int depth = 0;           // 圆括号 + 花括号嵌套深度
+    bool expectDef = true;   // 顶层：正在等待下一个函数定义
+    bool expectName = false; // 刚读到定义开头的 int / void
+    for (Token t = lex.nextToken(); t.type != TokenType::END; t = lex.nextToken()) {
+        if (expectName && t.type == TokenType::ID)
+            funcs.back().name = t.lexeme;
+        expectName = false;
+        if (depth == 0 && expectDef) {
+            if (t.type != TokenType::INT && t.type != TokenType::VOID)
+                break;
+            // 片段暂时延伸到源码末尾，下一个定义开始时再截断
+            const char *start = t.lexeme.data();
+            if (!funcs.empty())
+                funcs.back().text = funcs.back().text.substr(
+                    0, static_cast<size_t>(start - funcs.back().text.data()));
+            funcs.push_back({source.substr(static_cast<size_t>(start - source.data())), {},
+                             t.line});
+            expectDef = false;
+            expectName = true;
+            continue;
+        }
+        switch (t.type) {
+        case TokenType::LPAREN:
+        case TokenType::LBRACE:
+            ++depth;
+            break;
+        case TokenType::RPAREN:
+            depth = std::max(depth - 1, 0);
+            break;
+        case TokenType::RBRACE:
+            depth = std::max(depth - 1, 0);
+            expectDef = depth == 0;
+            break;
+        default:
+            break;
+        }
+    }
     return funcs;
 }
 
+// takeList：把 listStack[mark..] 复制为 arena 中的定长数组，并把 listStack 恢复到 mark
+std::span<ASTPtr> Parser::takeList(size_t mark) {
+    auto items = arena->copyList(std::span<const ASTPtr>(listStack).subspan(mark));
+    listStack.resize(mark);
+    return items;
+}
+
 // parseFuncDef：解析函数定义 FuncDef → ("int" ∣ "void") ID "(" Params? ")" Block
-std::shared_ptr<FuncDef> Parser::parseFuncDef() {
-    std::string retType = cur.lexeme; // 保存返回类型
-    advance();                        // 消费 int/void
+FuncDef *Parser::parseFuncDef() {
+    std::string_view retType = name(); // 保存返回类型
+    advance();                         // 消费 int/void
 
     // 函数名必须为标识符
     if (cur.type != TokenType::ID) {
-        std::cerr << "Expected function name, got '" << cur.lexeme << "' at line " << cur.line
-                  << "\n";
-        exit(1);
+        fail("Expected function name, got '" + std::string(cur.lexeme) +
+             "' at line " + std::to_string(cur.line));
     }
-    std::string name = cur.lexeme; // 保存函数名
-    advance();                     // 消费函数名
+    std::string_view funcName = name(); // 保存函数名
+    advance();                          // 消费函数名
 
     expect(TokenType::LPAREN);   // 消费 '('
     auto params = parseParams(); // 解析参数列表
     expect(TokenType::RPAREN);   // 消费 ')'
 
-    auto body = parseBlock(); // 解析函数体 Block
+    auto *body = parseBlock(); // 解析函数体 Block
 
     // 构造 FuncDef 节点并返回
-    auto f = std::make_shared<FuncDef>();
+    auto *f = arena->make<FuncDef>();
     f->retType = retType;
-    f->name = name;
+    f->name = funcName;
     f->params = params;
     f->body = body;
     return f;
 }
 
 // parseParams：解析参数列表 Param → "int" ID ("," "int" ID)*
-std::vector<Param> Parser::parseParams() {
+std::span<Param> Parser::parseParams() {
     std::vector<Param> ps;
     // 如果当前是 int，则至少有一个参数
     if (cur.type == TokenType::INT) {
         while (true) {
             advance(); // 消费 'int'
             if (cur.type != TokenType::ID) {
-                std::cerr << "Expected parameter name after 'int', got '" << cur.lexeme
-                          << "' at line " << cur.line << "\n";
-                exit(1);
+                fail("Expected parameter name after 'int', got '" + std::string(cur.lexeme) +
+                     "' at line " + std::to_string(cur.line));
             }
-            ps.push_back({cur.lexeme});
+            Ident param = ident();
+            ps.push_back({param.text, param.id});
             advance();                    // 消费参数名
             if (!match(TokenType::COMMA)) // 若无逗号则退出
                 break;
         }
     }
-    return ps;
+    return arena->copyList(std::span<const Param>(ps));
 }
 
 // parseBlock：解析语句块 Block → "{" Stmt∗ "}"
 // 注意：在 block 层级直接处理 int 声明，避免多声明 (int a=1, b=2;) 被包装成
 // 额外的 BlockStmt 而引入多余的作用域，导致变量在退出后丢失
-std::shared_ptr<BlockStmt> Parser::parseBlock() {
+BlockStmt *Parser::parseBlock() {
     expect(TokenType::LBRACE); // 消费 '{'
-    auto block = std::make_shared<BlockStmt>();
+    size_t mark = listStack.size();
     // 循环解析直到 '}'
     while (!match(TokenType::RBRACE)) {
         // 直接在 block 层级处理声明语句
@@ -101,22 +196,22 @@ std::shared_ptr<BlockStmt> Parser::parseBlock() {
             advance(); // 消费 'int'
             do {
                 if (cur.type != TokenType::ID) {
-                    std::cerr << "Expected identifier after 'int', got '" << cur.lexeme
-                              << "' at line " << cur.line << "\n";
-                    exit(1);
+                    fail("Expected identifier after 'int', got '" + std::string(cur.lexeme) +
+                         "' at line " + std::to_string(cur.line));
                 }
-                std::string name = cur.lexeme;
+                Ident var = ident();
                 advance();                 // 消费变量名
                 expect(TokenType::ASSIGN); // 消费 '='
                 auto e = parseExpr();      // 解析初始化表达式
-                block->stmts.push_back(std::make_shared<DeclStmt>(name, e));
+                listStack.push_back(arena->make<DeclStmt>(var, e));
             } while (match(TokenType::COMMA)); // 支持逗号分隔的多变量声明
             expect(TokenType::SEMI);           // 消费 ';'
         } else {
-            block->stmts.push_back(parseStmt());
+            ASTPtr stmt = parseStmt();
+            listStack.push_back(stmt);
         }
     }
-    return block;
+    return arena->make<BlockStmt>(takeList(mark));
 }
 
 // parseStmt：解析单条语句，支持多种语句形式
@@ -139,7 +234,7 @@ ASTPtr Parser::parseStmt() {
         ASTPtr elseS = nullptr;
         if (match(TokenType::ELSE))
             elseS = parseStmt(); // 解析 else 分支（可选）
-        return std::make_shared<IfStmt>(cond, thenS, elseS);
+        return arena->make<IfStmt>(cond, thenS, elseS);
     }
 
     // while 循环语句
@@ -149,7 +244,7 @@ ASTPtr Parser::parseStmt() {
         auto cond = parseExpr(); // 解析循环条件
         expect(TokenType::RPAREN);
         auto body = parseStmt(); // 解析循环体
-        return std::make_shared<WhileStmt>(cond, body);
+        return arena->make<WhileStmt>(cond, body);
     }
 
     // return 语句
@@ -158,69 +253,70 @@ ASTPtr Parser::parseStmt() {
         if (cur.type != TokenType::SEMI)
             e = parseExpr(); // 解析返回值表达式（可选）
         expect(TokenType::SEMI);
-        return std::make_shared<ReturnStmt>(e);
+        return arena->make<ReturnStmt>(e);
     }
 
     // break 语句
     if (match(TokenType::BREAK)) {
         expect(TokenType::SEMI);
-        return std::make_shared<BreakStmt>();
+        return arena->make<BreakStmt>();
     }
 
     // continue 语句
     if (match(TokenType::CONTINUE)) {
         expect(TokenType::SEMI);
-        return std::make_shared<ContinueStmt>();
+        return arena->make<ContinueStmt>();
     }
 
     // 变量声明语句：int x = expr, ...;
     if (cur.type == TokenType::INT) {
         advance(); // 消费 'int'
-        std::vector<ASTPtr> decls;
+        size_t mark = listStack.size();
         do {
             if (cur.type != TokenType::ID) {
-                std::cerr << "Expected identifier after 'int', got '" << cur.lexeme << "' at line "
-                          << cur.line << "\n";
-                exit(1);
+                fail("Expected identifier after 'int', got '" + std::string(cur.lexeme) +
+                     "' at line " + std::to_string(cur.line));
             }
-            std::string name = cur.lexeme;
+            Ident var = ident();
             advance();                 // 消费变量名
             expect(TokenType::ASSIGN); // 消费 '='
             auto e = parseExpr();      // 解析初始化表达式
-            decls.push_back(std::make_shared<DeclStmt>(name, e));
+            listStack.push_back(arena->make<DeclStmt>(var, e));
         } while (match(TokenType::COMMA)); // 支持逗号分隔的多变量声明
         expect(TokenType::SEMI);
         // 单个声明直接返回，否则包装成 BlockStmt
-        if (decls.size() == 1)
-            return decls[0];
-        auto blk = std::make_shared<BlockStmt>();
-        blk->stmts = decls;
-        return blk;
+        if (listStack.size() - mark == 1) {
+            ASTPtr decl = listStack.back();
+            listStack.pop_back();
+            return decl;
+        }
+        return arena->make<BlockStmt>(takeList(mark));
     }
 
     // 区分函数调用和赋值语句（通过预读 nxt 判断）
     if (cur.type == TokenType::ID) {
-        std::string name = cur.lexeme;
+        Ident id = ident();
         if (nxt.type == TokenType::LPAREN) {
             // 函数调用语句
             advance(); // 消费函数名
             advance(); // 消费 '('
-            auto call = std::make_shared<CallExpr>(name);
+            size_t mark = listStack.size();
             if (cur.type != TokenType::RPAREN) {
                 do {
-                    call->args.push_back(parseExpr()); // 解析实参
+                    ASTPtr arg = parseExpr(); // 解析实参
+                    listStack.push_back(arg);
                 } while (match(TokenType::COMMA));
             }
             expect(TokenType::RPAREN);
             expect(TokenType::SEMI);
-            return call;
+            return arena->make<CallExpr>(id.text, takeList(mark));
         } else if (nxt.type == TokenType::ASSIGN) {
             // 赋值语句
             advance(); // 消费变量名
             advance(); // 消费 '='
             auto e = parseExpr();
             expect(TokenType::SEMI);
-            return std::make_shared<AssignStmt>(name, e);
+            return arena->make<AssignStmt>(id, e);
         }
     }
 
@@ -240,7 +336,7 @@ ASTPtr Parser::parseLOr() {
     auto left = parseLAnd();
     while (match(TokenType::OR)) {
         auto right = parseLAnd();
-        left = std::make_shared<BinaryExpr>("||", left, right);
+        left = arena->make<BinaryExpr>(BinaryOp::Or, left, right);
     }
     return left;
 }
@@ -250,7 +346,7 @@ ASTPtr Parser::parseLAnd() {
     auto left = parseRel();
     while (match(TokenType::AND)) {
         auto right = parseRel();
-        left = std::make_shared<BinaryExpr>("&&", left, right);
+        left = arena->make<BinaryExpr>(BinaryOp::And, left, right);
     }
     return left;
 }
@@ -260,10 +356,10 @@ ASTPtr Parser::parseRel() {
     auto left = parseAdd();
     while (cur.type == TokenType::LT || cur.type == TokenType::GT || cur.type == TokenType::LE ||
            cur.type == TokenType::GE || cur.type == TokenType::EQ || cur.type == TokenType::NE) {
-        std::string op = cur.lexeme;
+        BinaryOp op = binaryOpFor(cur.type);
         advance();
         auto right = parseAdd();
-        left = std::make_shared<BinaryExpr>(op, left, right);
+        left = arena->make<BinaryExpr>(op, left, right);
     }
     return left;
 }
@@ -272,10 +368,10 @@ ASTPtr Parser::parseRel() {
 ASTPtr Parser::parseAdd() {
     auto left = parseMul();
     while (cur.type == TokenType::PLUS || cur.type == TokenType::MINUS) {
-        std::string op = cur.lexeme;
+        BinaryOp op = binaryOpFor(cur.type);
         advance();
         auto right = parseMul();
-        left = std::make_shared<BinaryExpr>(op, left, right);
+        left = arena->make<BinaryExpr>(op, left, right);
     }
     return left;
 }
@@ -285,10 +381,10 @@ ASTPtr Parser::parseMul() {
     auto left = parseUnary();
     while (cur.type == TokenType::TIMES || cur.type == TokenType::DIV ||
            cur.type == TokenType::MOD) {
-        std::string op = cur.lexeme;
+        BinaryOp op = binaryOpFor(cur.type);
         advance();
         auto right = parseUnary();
-        left = std::make_shared<BinaryExpr>(op, left, right);
+        left = arena->make<BinaryExpr>(op, left, right);
     }
     return left;
 }
@@ -296,10 +392,12 @@ ASTPtr Parser::parseMul() {
 // parseUnary：解析一元运算 UnaryExpr → PrimaryExpr ∣ ("+" ∣ "-" ∣ "!") UnaryExpr
 ASTPtr Parser::parseUnary() {
     if (cur.type == TokenType::PLUS || cur.type == TokenType::MINUS || cur.type == TokenType::NOT) {
-        std::string op = cur.lexeme;
+        UnaryOp op = cur.type == TokenType::PLUS    ? UnaryOp::Plus
+                     : cur.type == TokenType::MINUS ? UnaryOp::Minus
+                                                    : UnaryOp::Not;
         advance();
         auto e = parseUnary(); // 递归解析，支持连续一元运算（如 --x, !!x）
-        return std::make_shared<UnaryExpr>(op, e);
+        return arena->make<UnaryExpr>(op, e);
     }
     return parsePrimary();
 }
@@ -308,27 +406,34 @@ ASTPtr Parser::parseUnary() {
 ASTPtr Parser::parsePrimary() {
     // 标识符：可能是变量引用或函数调用
     if (cur.type == TokenType::ID) {
-        std::string name = cur.lexeme;
+        Ident id = ident();
         advance();
         if (match(TokenType::LPAREN)) {
             // 函数调用 ID "(" args ")"
-            auto call = std::make_shared<CallExpr>(name);
+            size_t mark = listStack.size();
             // 解析参数列表，直到遇到右括号
             while (cur.type != TokenType::RPAREN) {
-                call->args.push_back(parseExpr());
+                ASTPtr arg = parseExpr();
+                listStack.push_back(arg);
                 match(TokenType::COMMA);
             }
             expect(TokenType::RPAREN);
-            return call;
+            return arena->make<CallExpr>(id.text, takeList(mark));
         }
         // 变量引用
-        return std::make_shared<IdentifierExpr>(name);
+        return arena->make<IdentifierExpr>(id);
     }
     // 数字字面量
     if (cur.type == TokenType::NUMBER) {
-        int v = stoi(cur.lexeme);
+        // from_chars 直接解析源码切片，不构造临时字符串
+        const char *first = cur.lexeme.data(), *last = first + cur.lexeme.size();
+        int v = 0;
+        auto [end, ec] = std::from_chars(first, last, v);
+        if (ec != std::errc() || end != last)
+            fail("Integer literal out of range: " + std::string(cur.lexeme) + " at line " +
+                 std::to_string(cur.line));
         advance();
-        return std::make_shared<NumberExpr>(v);
+        return arena->make<NumberExpr>(v);
     }
     // 括号表达式 "(" Expr ")"
     if (match(TokenType::LPAREN)) {
@@ -337,6 +442,6 @@ ASTPtr Parser::parsePrimary() {
         return e;
     }
     // 非预期 Token，报错
-    std::cerr << "Unexpected primary: " << cur.lexeme << " at line " << cur.line << "\n";
-    exit(1);
+    fail("Unexpected primary: " + std::string(cur.lexeme) + " at line " +
+         std::to_string(cur.line));
 }
@@ -0,0 +1,727 @@
+#include "machine_ir.h"
+#include "statistics.h"
+#include <algorithm>
+
+namespace toyc {
+namespace mir {
+
+namespace {
+
+#pragma region 寄存器读写
+
+// definedReg：指令写入的寄存器（没有或不是普通的单寄存器写入时返回 -1）
+int definedReg(const MachineInstr &MI) {
+    switch (MI.opcode) {
+    case MOpcode::LI:
+    case MOpcode::MV:
+    case MOpcode::ADD:
+    case MOpcode::SUB:
+    case MOpcode::MUL:
+    case MOpcode::MULH:
+    case MOpcode::DIV:
+    case MOpcode::REM:
+    case MOpcode::SLT:
+    case MOpcode::ADDI:
+    case MOpcode::XORI:
+    case MOpcode::ANDI:
+    case MOpcode::SLLI:
+    case MOpcode::SRLI:
+    case MOpcode::SRAI:
+    case MOpcode::SEQZ:
+    case MOpcode::SNEZ:
+    case MOpcode::LW:
+    case MOpcode::LB:
+        return MI.rd;
+    default:
+        return -1;
+    }
+}
+
+// readsReg：指令是否读取 reg（只用于 definedReg >= 0 的指令，rs1 / rs2 即全部来源）
+bool readsReg(const MachineInstr &MI, int reg) { return MI.rs1 == reg || MI.rs2 == reg; }
+
+// sameSlot：两条访存指令是否访问同一个字（同一基址寄存器、同一偏移）
+bool sameSlot(const MachineInstr &a, const MachineInstr &b) {
+    return a.rs1 == b.rs1 && a.imm == b.imm;
+}
+
+#pragma endregion
+
+#pragma region 窥孔规则
+
+// 每条规则在 insts[i]（与 insts[i + 1]）处匹配，匹配成功时就地改写并返回 true
+
+// mv r, r / addi r, r, 0 → 删除
+bool eraseSelfMove(std::vector<MachineInstr> &insts, size_t i) {
+    const MachineInstr &MI = insts[i];
+    if ((MI.opcode == MOpcode::MV || (MI.opcode == MOpcode::ADDI && MI.imm == 0)) &&
+        MI.rd == MI.rs1) {
+        insts.erase(insts.begin() + i);
+        return true;
+    }
+    return false;
+}
+
+// sw r, o(b); lw d, o(b) → sw r, o(b); mv d, r（d == r 时删除 lw）
+bool forwardStoreToLoad(std::vector<MachineInstr> &insts, size_t i) {
+    if (i + 1 >= insts.size() || insts[i].opcode != MOpcode::SW ||
+        insts[i + 1].opcode != MOpcode::LW || !sameSlot(insts[i], insts[i + 1]))
+        return false;
+    const int value = insts[i].rs2, dst = insts[i + 1].rd;
+    if (dst == value)
+        insts.erase(insts.begin() + i + 1);
+    else
+        insts[i + 1] = MachineInstr::mv(dst, value);
+    return true;
+}
+
+// lw r, o(b); sw r, o(b) → lw r, o(b)（写回刚读出的值；r 不能是基址）
+bool eraseStoreBack(std::vector<MachineInstr> &insts, size_t i) {
+    if (i + 1 >= insts.size() || insts[i].opcode != MOpcode::LW ||
+        insts[i + 1].opcode != MOpcode::SW || !sameSlot(insts[i], insts[i + 1]) ||
+        insts[i].rd == insts[i].rs1 || insts[i + 1].rs2 != insts[i].rd)
+        return false;
+    insts.erase(insts.begin() + i + 1);
+    return true;
+}
+
+// lw r, o(b); lw d, o(b) → lw r, o(b); mv d, r（r 不能是基址；d == r 时删除第二条）
+bool reuseLoad(std::vector<MachineInstr> &insts, size_t i) {
+    if (i + 1 >= insts.size() || insts[i].opcode != MOpcode::LW ||
+        insts[i + 1].opcode != MOpcode::LW || !sameSlot(insts[i], insts[i + 1]) ||
+        insts[i].rd == insts[i].rs1)
+        return false;
+    const int value = insts[i].rd, dst = insts[i + 1].rd;
+    if (dst == value)
+        insts.erase(insts.begin() + i + 1);
+    else
+        insts[i + 1] = MachineInstr::mv(dst, value);
+    return true;
+}
+
+// mv a, b; mv b, a → mv a, b
+bool eraseMoveBack(std::vector<MachineInstr> &insts, size_t i) {
+    if (i + 1 >= insts.size() || insts[i].opcode != MOpcode::MV ||
+        insts[i + 1].opcode != MOpcode::MV || insts[i + 1].rd != insts[i].rs1 ||
+        insts[i + 1].rs1 != insts[i].rd)
+        return false;
+    insts.erase(insts.begin() + i + 1);
+    return true;
+}
+
+// 无副作用的 def 紧接着被另一条不读取它的指令覆盖 → 删除前者
+bool eraseOverwrittenDef(std::vector<MachineInstr> &insts, size_t i) {
+    if (i + 1 >= insts.size())
+        return false;
+    const int reg = definedReg(insts[i]);
+    if (reg < 0 || definedReg(insts[i + 1]) != reg || readsReg(insts[i + 1], reg))
+        return false;
+    insts.erase(insts.begin() + i);
+    return true;
+}
+
+// PeepholePattern：窥孔规则表的一项
+struct PeepholePattern {
+    const char *name;
+    bool (*apply)(std::vector<MachineInstr> &insts, size_t i);
+};
+
+const PeepholePattern kPatterns[] = {
+    {"self-move", eraseSelfMove},
+    {"store-to-load", forwardStoreToLoad},
+    {"store-back", eraseStoreBack},
+    {"reload", reuseLoad},
+    {"move-back", eraseMoveBack},
+    {"overwritten-def", eraseOverwrittenDef},
+};
+
+/**
+ * @brief 在一个块内反复套用规则表直到没有匹配
+ * @details 某处改写后回退一条指令重新匹配（删除可能让前一条指令与新的后继构成新的模式）
+ */
+void applyPatterns(std::vector<MachineInstr> &insts) {
+    size_t i = 0;
+    while (i < insts.size()) {
+        bool changed = false;
+        for (const PeepholePattern &pattern : kPatterns)
+            if (pattern.apply(insts, i)) {
+                changed = true;
+                break;
+            }
+        if (!changed)
+            ++i;
+        else if (i > 0)
+            --i;
+    }
+}
+
+#pragma endregion
+
+#pragma region 分支与块布局
+
+// invertBranch：条件取反（bnez r ↔ beq r, zero）
+MachineInstr invertBranch(const MachineInstr &MI, int target) {
+    MachineInstr inv = MI;
+    inv.target = target;
+    switch (MI.opcode) {
+    case MOpcode::BEQ:
+        if (MI.rs2 == 0)
+            return MachineInstr::bnez(MI.rs1, target);
+        inv.opcode = MOpcode::BNE;
+        break;
+    case MOpcode::BNE:
+        inv.opcode = MOpcode::BEQ;
+        break;
+    case MOpcode::BLT:
+        inv.opcode = MOpcode::BGE;
+        break;
+    case MOpcode::BGE:
+        inv.opcode = MOpcode::BLT;
+        break;
+    case MOpcode::BGT:
+        inv.opcode = MOpcode::BLE;
+        break;
+    case MOpcode::BLE:
+        inv.opcode = MOpcode::BGT;
+        break;
+    case MOpcode::BNEZ:
+        return MachineInstr::branch(MOpcode::BEQ, MI.rs1, 0, target);
+    default:
+        break;
+    }
+    return inv;
+}
+
+// isTransfer：无条件转移（j / ret / tail），其后的指令不会执行
+bool isTransfer(const MachineInstr &MI) {
+    return MI.opcode == MOpcode::J || MI.opcode == MOpcode::RET || MI.opcode == MOpcode::TAIL;
+}
+
+// endsWithTransfer：块是否以无条件转移结束
+bool endsWithTransfer(const MachineBasicBlock &MBB) {
+    return !MBB.insts.empty() && isTransfer(MBB.insts.back());
+}
+
+/**
+ * @brief 落空改为显式跳转，并穿透只含 j 的块
+ * @details 先删除无条件转移之后的死指令（-O0 下 return 之后 IRBuilder 留下的 br），
+ *   之后块的顺序可以任意调整；跳向 "j Z" 块的分支 / 跳转直接改跳 Z（沿链，步数有界以防环）
+ */
+void threadJumps(MachineFunction &MF) {
+    const int n = static_cast<int>(MF.blocks.size());
+    for (auto &MBB : MF.blocks) {
+        auto transfer = std::find_if(MBB.insts.begin(), MBB.insts.end(), isTransfer);
+        if (transfer != MBB.insts.end())
+            MBB.insts.erase(transfer + 1, MBB.insts.end());
+    }
+    for (int bi = 0; bi + 1 < n; ++bi)
+        if (!endsWithTransfer(MF.blocks[bi]))
+            MF.blocks[bi].insts.push_back(MachineInstr::jump(bi + 1));
+    for (auto &MBB : MF.blocks)
+        for (auto &MI : MBB.insts) {
+            if (MI.opcode != MOpcode::J && !MI.isBranch())
+                continue;
+            for (int hops = 0; hops < n; ++hops) {
+                const auto &insts = MF.blocks[MI.target].insts;
+                if (insts.empty() || insts[0].opcode != MOpcode::J || insts[0].target == MI.target)
+                    break;
+                MI.target = insts[0].target;
+            }
+        }
+}
+
+// successors：块的全部转移目标（threadJumps 之后落空都已是显式 j）
+std::vector<int> successors(const MachineBasicBlock &MBB) {
+    std::vector<int> succs;
+    for (const auto &MI : MBB.insts)
+        if (MI.opcode == MOpcode::J || MI.isBranch())
+            succs.push_back(MI.target);
+    return succs;
+}
+
+// MachineLoop：机器 CFG 上的一个自然循环
+struct MachineLoop {
+    int header = -1;        // 循环头
+    int test = -1;          // 循环条件块：支配全部回边源块的第一个出口块（没有时为 -1）
+    std::vector<char> body; // 循环内的块（含头结点）
+    int size = 0;           // 循环内的块数
+};
+
+// BranchProfile：机器 CFG 上的静态分支预测结果
+struct BranchProfile {
+    std::vector<std::vector<int>> succs;   // 每块的转移目标
+    std::vector<std::vector<int>> latches; // latches[h]：回边 t → h 的源块
+    std::vector<char> reachable;           // 从入口可达
+    std::vector<int> depth;                // 循环嵌套深度（不在循环中为 0）
+    std::vector<MachineLoop> loops;        // 按循环体从小到大排列（内层循环在前）
+    std::vector<char> cold;                // 预测几乎不执行的块
+    std::vector<std::vector<int64_t>> edgeCounts; // 有剖析数据时与 succs 对应的边执行次数（否则为空）
+    std::vector<int64_t> counts;                  // 有剖析数据时各块的执行次数（-1 表示未知）
+
+    bool isBackEdge(int from, int to) const {
+        return std::find(latches[to].begin(), latches[to].end(), from) != latches[to].end();
+    }
+    bool measured() const { return !edgeCounts.empty(); }
+    // edgeCount：边 from → to 的执行次数（同一目标出现多次时相加）
+    int64_t edgeCount(int from, int to) const {
+        int64_t sum = 0;
+        for (size_t k = 0; k < succs[from].size(); ++k)
+            if (succs[from][k] == to)
+                sum += edgeCounts[from][k];
+        return sum;
+    }
+};
+
+/**
+ * @brief 静态分支预测
+ * @details 自然循环由 DFS 回边 t → h（h 仍在 DFS 栈上）找出，循环体从 t 沿前驱反向收集到 h 为止，
+ *   同一头结点的回边合并为一个循环。每次迭代都经过的出口块（支配全部回边源块，取最靠近头结点的一个）
+ *   是循环条件，回边预测为走（循环继续）；从其它块跳出循环的边（循环中途的 return / break）预测为不走，
+ *   从入口出发不经过这类边到达不了的块为冷块
+ */
+BranchProfile predictBranches(const MachineFunction &MF) {
+    const int n = static_cast<int>(MF.blocks.size());
+    BranchProfile P;
+    P.reachable.assign(n, 0);
+    P.depth.assign(n, 0);
+    P.cold.assign(n, 0);
+    P.succs.resize(n);
+    P.latches.resize(n);
+    const auto &succs = P.succs;
+    auto &latches = P.latches;
+    std::vector<std::vector<int>> preds(n);
+    for (int bi = 0; bi < n; ++bi) {
+        P.succs[bi] = successors(MF.blocks[bi]);
+        for (int s : succs[bi])
+            preds[s].push_back(bi);
+    }
+
+    // 迭代 DFS：state 1 = 在栈上，2 = 已完成；指向栈上块的边是回边
+    std::vector<char> state(n, 0);
+    std::vector<std::pair<int, size_t>> stack = {{0, 0}};
+    std::vector<int> postorder;
+    state[0] = 1;
+    while (!stack.empty()) {
+        auto &[bi, next] = stack.back();
+        if (next == succs[bi].size()) {
+            state[bi] = 2;
+            postorder.push_back(bi);
+            stack.pop_back();
+            continue;
+        }
+        const int s = succs[bi][next++];
+        if (state[s] == 1)
+            latches[s].push_back(bi);
+        else if (state[s] == 0) {
+            state[s] = 1;
+            stack.push_back({s, 0});
+        }
+    }
+    for (int bi = 0; bi < n; ++bi)
+        P.reachable[bi] = state[bi] != 0;
+
+    // 支配树（Cooper-Harvey-Kennedy 迭代算法，按逆后序处理）
+    std::vector<int> rpoIndex(n, -1), idom(n, -1);
+    for (size_t k = 0; k < postorder.size(); ++k)
+        rpoIndex[postorder[k]] = static_cast<int>(postorder.size() - 1 - k);
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (rpoIndex[a] > rpoIndex[b])
+                a = idom[a];
+            while (rpoIndex[b] > rpoIndex[a])
+                b = idom[b];
+        }
+        return a;
+    };
+    idom[0] = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+            const int bi = *it;
+            if (bi == 0)
+                continue;
+            int dom = -1;
+            for (int p : preds[bi])
+                if (idom[p] >= 0)
+                    dom = dom < 0 ? p : intersect(p, dom);
+            if (dom != idom[bi]) {
+                idom[bi] = dom;
+                changed = true;
+            }
+        }
+    }
+    auto dominates = [&](int a, int b) {
+        while (b != a && b != 0)
+            b = idom[b];
+        return b == a;
+    };
+
+    for (int h = 0; h < n; ++h) {
+        if (latches[h].empty())
+            continue;
+        MachineLoop L;
+        L.header = h;
+        L.body.assign(n, 0);
+        L.body[h] = 1;
+        std::vector<int> work;
+        for (int t : latches[h])
+            if (!L.body[t]) {
+                L.body[t] = 1;
+                work.push_back(t);
+            }
+        while (!work.empty()) {
+            int bi = work.back();
+            work.pop_back();
+            for (int p : preds[bi])
+                if (P.reachable[p] && !L.body[p]) {
+                    L.body[p] = 1;
+                    work.push_back(p);
+                }
+        }
+        for (int bi = 0; bi < n; ++bi) {
+            L.size += L.body[bi];
+            P.depth[bi] += L.body[bi];
+        }
+        for (int bi = 0; bi < n; ++bi) {
+            if (!L.body[bi] || (L.test >= 0 && rpoIndex[bi] >= rpoIndex[L.test]))
+                continue;
+            bool exits = false, domAll = true;
+            for (int s : succs[bi])
+                exits = exits || !L.body[s];
+            for (int t : latches[h])
+                domAll = domAll && dominates(bi, t);
+            if (exits && domAll)
+                L.test = bi;
+        }
+        P.loops.push_back(std::move(L));
+    }
+    std::stable_sort(P.loops.begin(), P.loops.end(),
+                     [](const MachineLoop &a, const MachineLoop &b) { return a.size < b.size; });
+
+    auto earlyExit = [&](int from, int to) {
+        for (const MachineLoop &L : P.loops)
+            if (L.body[from] && !L.body[to] && L.test != from)
+                return true;
+        return false;
+    };
+    std::vector<char> hot(n, 0);
+    std::vector<int> work = {0};
+    hot[0] = 1;
+    while (!work.empty()) {
+        int bi = work.back();
+        work.pop_back();
+        for (int s : succs[bi])
+            if (!hot[s] && !earlyExit(bi, s)) {
+                hot[s] = 1;
+                work.push_back(s);
+            }
+    }
+    for (int bi = 0; bi < n; ++bi)
+        P.cold[bi] = P.reachable[bi] && !hot[bi];
+    return P;
+}
+
+/**
+ * @brief 用剖析数据代替静态预测
+ * @param MF 机器函数（blockCounts 与块同下标）
+ * @param P  静态预测结果；入口计数 > 0 时改写 cold 并填入 edgeCounts
+ * @details 插桩只统计块的执行次数，边的次数由流量守恒推出：块的次数等于流入边之和（入口块除外）、
+ *   也等于流出边之和（以 ret / tail 结束的块除外）。反复寻找只剩一条未知边的块，由块次数减去其余边
+ *   得出这条边；两侧边都已知的未知块（插桩构建里没有的块）由边之和得出块次数。
+ *   仍然解不出的边取两端块次数的较小者。执行次数为 0 的块是冷块，直接代替静态预测的冷路径
+ */
+void applyProfile(const MachineFunction &MF, BranchProfile &P) {
+    const int n = static_cast<int>(MF.blocks.size());
+    if (static_cast<int>(MF.blockCounts.size()) != n || MF.blockCounts[0] <= 0)
+        return;
+    std::vector<int64_t> count = MF.blockCounts;
+    struct Edge {
+        int from, to;
+        int64_t value = -1;
+    };
+    std::vector<Edge> edges;
+    std::vector<std::vector<int>> in(n), out(n);
+    for (int bi = 0; bi < n; ++bi) {
+        if (!P.reachable[bi])
+            continue;
+        for (int s : P.succs[bi]) {
+            out[bi].push_back(static_cast<int>(edges.size()));
+            in[s].push_back(static_cast<int>(edges.size()));
+            edges.push_back({bi, s});
+        }
+    }
+    // solve：块次数已知、恰有一条未知边时求出该边；所有边已知时求出未知的块次数
+    auto solve = [&](int bi, const std::vector<int> &list) {
+        int64_t known = 0;
+        int unknown = -1, numUnknown = 0;
+        for (int e : list) {
+            if (edges[e].value < 0) {
+                unknown = e;
+                ++numUnknown;
+            } else {
+                known += edges[e].value;
+            }
+        }
+        if (count[bi] >= 0 && numUnknown == 1) {
+            edges[unknown].value = std::max<int64_t>(0, count[bi] - known);
+            return true;
+        }
+        if (count[bi] < 0 && numUnknown == 0 && !list.empty()) {
+            count[bi] = known;
+            return true;
+        }
+        return false;
+    };
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int bi = 0; bi < n; ++bi) {
+            if (!P.reachable[bi])
+                continue;
+            changed |= solve(bi, out[bi]);
+            if (bi != 0)
+                changed |= solve(bi, in[bi]);
+        }
+    }
+
+    P.edgeCounts.assign(n, {});
+    for (int bi = 0; bi < n; ++bi)
+        for (int e : out[bi]) {
+            Edge &edge = edges[e];
+            if (edge.value < 0)
+                edge.value = std::max<int64_t>(
+                    0, std::min(count[edge.from] < 0 ? count[edge.to] : count[edge.from],
+                                count[edge.to] < 0 ? count[edge.from] : count[edge.to]));
+            P.edgeCounts[bi].push_back(edge.value);
+        }
+    for (int bi = 0; bi < n; ++bi)
+        P.cold[bi] = P.reachable[bi] && count[bi] == 0;
+    P.counts = std::move(count);
+}
+
+/**
+ * @brief 循环旋转：把循环条件之前的部分移到以 "j 头" 结束的回边块之后
+ * @details 布局为 [H ... C, B ... L: j H, E]（整段都在循环内，条件块 C 以 "bcc; j" 在 B 与出口 E
+ *   之间选择）时改为 [B ... L, H ... C, E]：L 落空进入 H，C 的条件反转后跳回 B、落空到 E，
+ *   每次迭代少执行一条 j（进入循环时多一条跳向 H 的 j）。内层循环先处理。
+ *   有多个回边块时取最后一个（有剖析数据时取最热的一个）作 L，排在它之后的循环内的块先移到函数末尾
+ *   （它们都以显式转移结束，位置不影响正确性）
+ */
+void rotateLoops(const MachineFunction &MF, const BranchProfile &P, std::vector<int> &order) {
+    const int m = static_cast<int>(order.size());
+    for (const MachineLoop &L : P.loops) {
+        if (L.test < 0)
+            continue;
+        const int p = static_cast<int>(std::find(order.begin(), order.end(), L.header) - order.begin());
+        if (p == 0 || p == m)
+            continue;
+        int q = p;
+        while (q + 1 < m && L.body[order[q + 1]])
+            ++q;
+        const int c = static_cast<int>(std::find(order.begin() + p, order.begin() + q + 1, L.test) -
+                                       order.begin());
+        // 旋转后落空进入头结点的回边块：最后一个 "j 头" 块，有剖析数据时取执行次数最多的一个；
+        // 它之后仍在循环内的块（少见的分支与回边，都以显式转移结束）移到函数末尾
+        auto jumpsToHeader = [&](int bi) {
+            const auto &insts = MF.blocks[bi].insts;
+            return !insts.empty() && insts.back().opcode == MOpcode::J &&
+                   insts.back().target == L.header;
+        };
+        int l = -1;
+        for (int k = q; k > c; --k)
+            if (jumpsToHeader(order[k]) &&
+                (l < 0 || (P.measured() && P.edgeCount(order[k], L.header) >
+                                               P.edgeCount(order[l], L.header))))
+                l = k;
+        if (l > c && l < q) {
+            std::rotate(order.begin() + l + 1, order.begin() + q + 1, order.end());
+            q = l;
+        }
+        if (c >= q || q + 1 == m)
+            continue;
+        const auto &latch = MF.blocks[order[q]].insts;
+        const auto &cond = MF.blocks[L.test].insts;
+        if (latch.empty() || latch.back().opcode != MOpcode::J || latch.back().target != L.header ||
+            cond.size() < 2 || cond.back().opcode != MOpcode::J || !cond[cond.size() - 2].isBranch())
+            continue;
+        const int a = cond.back().target, b = cond[cond.size() - 2].target;
+        const int inside = order[c + 1], exit = order[q + 1];
+        if ((a == inside && b == exit) || (a == exit && b == inside))
+            std::rotate(order.begin() + p, order.begin() + c + 1, order.begin() + q + 1);
+    }
+}
+
+/**
+ * @brief 按静态分支预测的贪心链式布局
+ * @details 从入口出发，每个块之后放它的一个未放置后继：循环嵌套更深的优先（留在循环内），
+ *   同深度时原本就紧随其后的块优先（保持源码顺序），其次是 j 的目标、最后是条件分支的目标；
+ *   热的前向前驱（回边与冷块之外）都已放置的后继才接在链上，if / else 的汇合块排在两个分支之后；
+ *   链断开时从最近放置、有这样的后继的块继续（循环结束后紧接着放出口块），都没有时退而取任意未放置后继。
+ *   冷块（循环中提前 return / break 的路径）不接在热块之后，全部热块放完后放到函数末尾；
+ *   不可达的块（被穿透的 j 块、-O0 下 return 之后的块）不再输出。最后旋转循环，按新下标改写跳转目标。
+ *   有剖析数据（MF.blockCounts）时冷块取实测从未执行的块，后继按边的执行次数（而不是循环深度）优先，
+ *   占后继执行次数一半以上的边不必等其余前驱放置（热路径连成一条落空链，少见的分支另行跳回）；
+ *   blockCounts 随块一起重排
+ */
+void layoutBlocks(MachineFunction &MF) {
+    const int n = static_cast<int>(MF.blocks.size());
+    BranchProfile P = predictBranches(MF);
+    applyProfile(MF, P);
+
+    std::vector<char> placed(n, 0);
+    std::vector<int> order;
+    bool allowCold = false;
+    auto eligible = [&](int bi) {
+        return bi >= 0 && !placed[bi] && P.reachable[bi] && (allowCold || !P.cold[bi]);
+    };
+    std::vector<int> waiting(n, 0); // 尚未放置的热前向前驱数
+    auto forwardEdges = [&](int bi, int delta) {
+        if (P.reachable[bi] && !P.cold[bi])
+            for (int s : P.succs[bi])
+                if (!P.isBackEdge(bi, s))
+                    waiting[s] += delta;
+    };
+    for (int bi = 0; bi < n; ++bi)
+        forwardEdges(bi, 1);
+    auto ready = [&](int bi) { return eligible(bi) && waiting[bi] <= 0; };
+    // dominantEdge：有剖析数据时，bi → s 占 s 执行次数的一半以上，s 不必等其余前驱
+    auto dominantEdge = [&](int bi, int s) {
+        return P.measured() && s >= 0 && 2 * P.edgeCount(bi, s) > P.counts[s];
+    };
+    auto preferredNext = [&](int bi) {
+        const auto &insts = MF.blocks[bi].insts;
+        int jumpTarget = -1, branchTarget = -1;
+        if (!insts.empty() && insts.back().opcode == MOpcode::J) {
+            jumpTarget = insts.back().target;
+            if (insts.size() >= 2 && insts[insts.size() - 2].isBranch())
+                branchTarget = insts[insts.size() - 2].target;
+        }
+        const int fallthrough =
+            bi + 1 < n && (jumpTarget == bi + 1 || branchTarget == bi + 1) ? bi + 1 : -1;
+        int best = -1;
+        for (int s : {fallthrough, jumpTarget, branchTarget}) {
+            if (!(ready(s) || (eligible(s) && dominantEdge(bi, s))) || s == best)
+                continue;
+            if (best < 0 || (P.measured() ? P.edgeCount(bi, s) > P.edgeCount(bi, best)
+                                          : P.depth[s] > P.depth[best]))
+                best = s;
+        }
+        return best;
+    };
+    std::vector<int> pending; // 已放置的块（栈顶最近），后继都已放置的出栈
+    auto nextChainStart = [&]() {
+        auto exhausted = [&](int bi) {
+            return std::none_of(P.succs[bi].begin(), P.succs[bi].end(), eligible);
+        };
+        while (!pending.empty() && exhausted(pending.back()))
+            pending.pop_back();
+        for (auto it = pending.rbegin(); it != pending.rend(); ++it)
+            for (int s : P.succs[*it])
+                if (ready(s))
+                    return s;
+        if (!pending.empty())
+            for (int s : P.succs[pending.back()])
+                if (eligible(s))
+                    return s;
+        for (int bi = 0; bi < n; ++bi)
+            if (eligible(bi))
+                return bi;
+        return -1;
+    };
+    for (int cur = 0; cur >= 0;) {
+        placed[cur] = 1;
+        order.push_back(cur);
+        pending.push_back(cur);
+        forwardEdges(cur, -1);
+        cur = preferredNext(cur);
+        if (cur < 0)
+            cur = nextChainStart();
+        if (cur < 0 && !allowCold) {
+            allowCold = true;
+            cur = nextChainStart();
+        }
+    }
+    rotateLoops(MF, P, order);
+
+    std::vector<int> newIndex(n, -1);
+    for (size_t k = 0; k < order.size(); ++k)
+        newIndex[order[k]] = static_cast<int>(k);
+    std::vector<MachineBasicBlock> blocks;
+    blocks.reserve(order.size());
+    for (int bi : order) {
+        blocks.push_back(std::move(MF.blocks[bi]));
+        for (auto &MI : blocks.back().insts)
+            if (MI.opcode == MOpcode::J || MI.isBranch())
+                MI.target = newIndex[MI.target];
+    }
+    MF.blocks = std::move(blocks);
+    if (static_cast<int>(MF.blockCounts.size()) == n) {
+        std::vector<int64_t> counts;
+        counts.reserve(order.size());
+        for (int bi : order)
+            counts.push_back(MF.blockCounts[bi]);
+        MF.blockCounts = std::move(counts);
+    }
+}
+
+/**
+ * @brief 删除跳向下一块的转移
+ * @details j next → 删除；bcc next; j Y → b!cc Y；末尾跳向 next 的条件分支两条路径相同 → 删除
+ */
+void removeFallthroughJumps(MachineFunction &MF) {
+    const int n = static_cast<int>(MF.blocks.size());
+    for (int bi = 0; bi < n; ++bi) {
+        auto &insts = MF.blocks[bi].insts;
+        const int next = bi + 1 < n ? bi + 1 : -1;
+        if (insts.empty() || insts.back().opcode != MOpcode::J)
+            continue;
+        if (insts.back().target == next) {
+            insts.pop_back();
+        } else if (insts.size() >= 2 && insts[insts.size() - 2].isBranch() &&
+                   insts[insts.size() - 2].target == next) {
+            insts[insts.size() - 2] = invertBranch(insts[insts.size() - 2], insts.back().target);
+            insts.pop_back();
+        }
+        while (!insts.empty() && insts.back().isBranch() && insts.back().target == next)
+            insts.pop_back();
+    }
+}
+
+#pragma endregion
+
+// countInsts：函数的机器指令条数
+size_t countInsts(const MachineFunction &MF) {
+    size_t n = 0;
+    for (const auto &MBB : MF.blocks)
+        n += MBB.insts.size();
+    return n;
+}
+
+} // namespace
+
+/**
+ * @brief 机器级窥孔优化与块布局
+ * @details 1. threadJumps       落空改为显式 j，穿透只含 j 的块
+ *   2. layoutBlocks      按静态分支预测（有剖析数据时按实测计数）链式布局：冷块移到末尾、循环旋转，
+ *                        丢弃不可达块
+ *   3. removeFallthroughJumps  删除 / 反转跳向下一块的转移
+ *   4. applyPatterns     逐块套用规则表（store → load 转发、自拷贝、覆盖写等）
+ *   只改写栈帧已展开的指令，不引入新的寄存器；返回删除的指令条数
+ */
+int runPeephole(MachineFunction &MF) {
+    if (MF.blocks.empty())
+        return 0;
+    const size_t before = countInsts(MF);
+    threadJumps(MF);
+    layoutBlocks(MF);
+    removeFallthroughJumps(MF);
+    for (auto &MBB : MF.blocks)
+        applyPatterns(MBB.insts);
+    // threadJumps 补上的显式 j 也可能留存（下一块被放到别处），按净减少计数
+    const size_t after = countInsts(MF);
+    const int removed = after < before ? static_cast<int>(before - after) : 0;
+    stats::add(stats::Counter::PeepholeRemoved, static_cast<uint64_t>(removed));
+    return removed;
+}
+
+} // namespace mir
+} // namespace toyc
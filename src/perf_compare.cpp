@@ -0,0 +1,461 @@
+// ToyC 生成代码性能回归检查
+// 在内置模拟器上运行同一组测试程序的 ToyC 产物与参考编译器（Clang -O2）产物，记录每个程序的
+// 动态指令数、估计周期、栈区访存（溢出重载 / 被调用者保存寄存器的保存与恢复）与代码字节数，
+// 逐个测试输出与参考编译器的比值。--json 写出结果文件（即检入的基线格式），
+// --compare 与基线逐项比较 ToyC 的指标，变差超过阈值或运行结果改变时返回 1
+//
+// 输入目录由 scripts/perf_check.sh 准备：<名><toyc 后缀>.o / .s 为 ToyC 的产物，
+// 同名的 <名><参考后缀>.o / .s 为参考编译器的产物（缺少时从基线取参考数据）
+
+#include "simulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+#pragma region 测量
+
+namespace {
+
+// Metrics：一个程序在模拟器上的指标（valid 为假表示没有该编译器的产物）
+struct Metrics {
+    bool valid = false;
+    int exitCode = 0;
+    uint64_t insts = 0;
+    uint64_t cycles = 0;
+    uint64_t stackLoads = 0;
+    uint64_t stackStores = 0;
+    uint64_t textBytes = 0; // 程序自身代码节的字节数（不含启动代码）
+
+    uint64_t spills() const { return stackLoads + stackStores; }
+};
+
+// TestResult：一个测试程序的 ToyC 与参考编译器指标
+struct TestResult {
+    std::string test;
+    Metrics toyc, ref;
+    std::string error; // 加载、链接或运行失败的原因（为空表示成功）
+};
+
+std::string readFile(const fs::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("cannot open '" + path.string() + "'");
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+/**
+ * @brief 链接并运行一个汇编 / 目标文件，取出指标
+ * @details 代码字节数在链接前按输入的可执行节统计，不含链接器附加的 crt0；
+ *   程序没有正常退出（非法指令、越界访存、达到指令数上限）时抛出 std::runtime_error
+ */
+Metrics measure(const fs::path &path, const toyc::sim::Options &options) {
+    toyc::sim::ObjectFile obj = toyc::sim::loadObject(readFile(path), path.filename().string());
+    Metrics m;
+    for (const toyc::sim::Section &s : obj.sections) {
+        if (s.exec)
+            m.textBytes += s.size;
+    }
+    std::vector<toyc::sim::ObjectFile> objects;
+    objects.push_back(std::move(obj));
+    toyc::sim::Result r = toyc::sim::run(toyc::sim::link(std::move(objects)), options);
+    if (r.status != toyc::sim::Result::Status::Exited)
+        throw std::runtime_error(path.filename().string() + ": " + r.error);
+    m.valid = true;
+    m.exitCode = r.exitCode;
+    m.insts = r.stats.instructions;
+    m.cycles = r.stats.cycles;
+    m.stackLoads = r.stats.stackLoads;
+    m.stackStores = r.stats.stackStores;
+    return m;
+}
+
+// findOutput：<dir>/<base><suffix>.o，没有时取 .s（都没有时返回空路径）
+fs::path findOutput(const fs::path &dir, const std::string &base, const std::string &suffix) {
+    for (const char *ext : {".o", ".s"}) {
+        fs::path p = dir / (base + suffix + ext);
+        if (fs::is_regular_file(p))
+            return p;
+    }
+    return {};
+}
+
+/**
+ * @brief 测量目录中的全部测试
+ * @details 以 ToyC 产物（<名><toycSuffix>.o / .s）枚举测试，按名字排序；
+ *   参考产物缺少时 ref.valid 为假，测量失败的测试记录 error 后继续
+ */
+std::vector<TestResult> measureAll(const fs::path &dir, const std::string &toycSuffix,
+                                   const std::string &refSuffix,
+                                   const toyc::sim::Options &options) {
+    std::vector<std::string> bases;
+    for (const auto &entry : fs::directory_iterator(dir)) {
+        const std::string stem = entry.path().stem().string();
+        const std::string ext = entry.path().extension().string();
+        if ((ext == ".o" || ext == ".s") && stem.size() > toycSuffix.size() &&
+            stem.compare(stem.size() - toycSuffix.size(), toycSuffix.size(), toycSuffix) == 0)
+            bases.push_back(stem.substr(0, stem.size() - toycSuffix.size()));
+    }
+    std::sort(bases.begin(), bases.end());
+    bases.erase(std::unique(bases.begin(), bases.end()), bases.end());
+
+    std::vector<TestResult> results;
+    for (const std::string &base : bases) {
+        TestResult t{base, Metrics(), Metrics(), std::string()};
+        try {
+            t.toyc = measure(findOutput(dir, base, toycSuffix), options);
+            if (fs::path ref = findOutput(dir, base, refSuffix); !ref.empty())
+                t.ref = measure(ref, options);
+        } catch (const std::exception &e) {
+            t.error = e.what();
+        }
+        results.push_back(std::move(t));
+    }
+    return results;
+}
+
+} // namespace
+
+#pragma endregion
+
+#pragma region 结果输出与基线比较
+
+namespace {
+
+// Baseline：基线文件的内容（测试名 → 指标）
+struct Baseline {
+    std::string reference;
+    std::map<std::string, TestResult> tests;
+};
+
+// writeJson：每个测试占一行，键顺序固定，便于 diff 与 readBaseline 读取（测量失败的测试不写出）
+void writeJson(std::ostream &os, const std::vector<TestResult> &results,
+               const std::string &reference) {
+    char line[512];
+    os << "{\n  \"schema\": 1,\n  \"reference\": \"" << reference << "\",\n  \"results\": [";
+    const char *sep = "\n";
+    for (const TestResult &t : results) {
+        if (!t.error.empty())
+            continue;
+        const Metrics &m = t.toyc;
+        int n = std::snprintf(line, sizeof(line),
+                              "    {\"test\": \"%s\", \"exit\": %d, \"insts\": %llu, "
+                              "\"cycles\": %llu, \"stack_loads\": %llu, \"stack_stores\": %llu, "
+                              "\"text_bytes\": %llu",
+                              t.test.c_str(), m.exitCode, static_cast<unsigned long long>(m.insts),
+                              static_cast<unsigned long long>(m.cycles),
+                              static_cast<unsigned long long>(m.stackLoads),
+                              static_cast<unsigned long long>(m.stackStores),
+                              static_cast<unsigned long long>(m.textBytes));
+        if (t.ref.valid) {
+            const Metrics &r = t.ref;
+            std::snprintf(line + n, sizeof(line) - n,
+                          ", \"ref_exit\": %d, \"ref_insts\": %llu, \"ref_cycles\": %llu, "
+                          "\"ref_stack_loads\": %llu, \"ref_stack_stores\": %llu, "
+                          "\"ref_text_bytes\": %llu",
+                          r.exitCode, static_cast<unsigned long long>(r.insts),
+                          static_cast<unsigned long long>(r.cycles),
+                          static_cast<unsigned long long>(r.stackLoads),
+                          static_cast<unsigned long long>(r.stackStores),
+                          static_cast<unsigned long long>(r.textBytes));
+        }
+        os << sep << line << "}";
+        sep = ",\n";
+    }
+    os << "\n  ]\n}\n";
+}
+
+// jsonField：从 writeJson 写出的一行中取出字段的原始文本（找不到时返回空串）
+std::string jsonField(const std::string &line, const std::string &key) {
+    std::string pat = "\"" + key + "\": ";
+    size_t p = line.find(pat);
+    if (p == std::string::npos)
+        return {};
+    p += pat.size();
+    if (line[p] == '"') {
+        size_t e = line.find('"', p + 1);
+        return e == std::string::npos ? std::string{} : line.substr(p + 1, e - p - 1);
+    }
+    size_t e = line.find_first_of(",}", p);
+    return line.substr(p, e - p);
+}
+
+// readMetrics：读取一行中带前缀 prefix（"" 或 "ref_"）的一组指标，缺少时 valid 为假
+Metrics readMetrics(const std::string &line, const std::string &prefix) {
+    Metrics m;
+    std::string insts = jsonField(line, prefix + "insts");
+    if (insts.empty())
+        return m;
+    auto num = [&](const char *key) {
+        return std::strtoull(jsonField(line, prefix + key).c_str(), nullptr, 10);
+    };
+    m.valid = true;
+    m.exitCode = std::atoi(jsonField(line, prefix + "exit").c_str());
+    m.insts = std::strtoull(insts.c_str(), nullptr, 10);
+    m.cycles = num("cycles");
+    m.stackLoads = num("stack_loads");
+    m.stackStores = num("stack_stores");
+    m.textBytes = num("text_bytes");
+    return m;
+}
+
+// readBaseline：读取 writeJson 格式的基线文件
+Baseline readBaseline(const std::string &path) {
+    std::ifstream ifs(path);
+    if (!ifs.is_open())
+        throw std::runtime_error("cannot open baseline '" + path + "'");
+    Baseline base;
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (std::string ref = jsonField(line, "reference"); !ref.empty())
+            base.reference = ref;
+        std::string test = jsonField(line, "test");
+        if (test.empty())
+            continue;
+        TestResult &t = base.tests[test];
+        t.test = test;
+        t.toyc = readMetrics(line, "");
+        t.ref = readMetrics(line, "ref_");
+    }
+    return base;
+}
+
+// formatRatio：toyc / ref（参考值为 0 时无意义，输出 "-"）
+std::string formatRatio(uint64_t toyc, uint64_t ref) {
+    if (ref == 0)
+        return "-";
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.2fx", static_cast<double>(toyc) / ref);
+    return buf;
+}
+
+/**
+ * @brief 与基线比较一个测试的 ToyC 指标
+ * @return 空串表示没有回归，否则为回归说明（如 "insts +4.1%, bytes +2.5%"）
+ * @details 指令数、栈区访存次数、代码字节数分别比较，增加超过 threshold 比例即为回归
+ *   （模拟器的计数是确定的，不需要噪声下限）
+ */
+std::string regressionOf(const Metrics &now, const Metrics &base, double threshold) {
+    std::string out;
+    auto check = [&](const char *name, uint64_t v, uint64_t b) {
+        if (static_cast<double>(v) <= static_cast<double>(b) * (1.0 + threshold))
+            return;
+        char buf[64];
+        if (b == 0)
+            std::snprintf(buf, sizeof(buf), "%s 0 -> %llu", name,
+                          static_cast<unsigned long long>(v));
+        else
+            std::snprintf(buf, sizeof(buf), "%s +%.1f%%", name,
+                          (static_cast<double>(v) / b - 1.0) * 100.0);
+        out += out.empty() ? buf : std::string(", ") + buf;
+    };
+    check("insts", now.insts, base.insts);
+    check("spills", now.spills(), base.spills());
+    check("bytes", now.textBytes, base.textBytes);
+    return out;
+}
+
+// GeoMean：比值的几何平均（跳过任一侧为 0 的项）
+struct GeoMean {
+    double logSum = 0;
+    int count = 0;
+
+    void add(uint64_t toyc, uint64_t ref) {
+        if (toyc == 0 || ref == 0)
+            return;
+        logSum += std::log(static_cast<double>(toyc) / ref);
+        ++count;
+    }
+    std::string str() const {
+        if (count == 0)
+            return "-";
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.2fx", std::exp(logSum / count));
+        return buf;
+    }
+};
+
+/**
+ * @brief 输出逐个测试的报告，并在给出基线时比较
+ * @param base 基线（为空指针时只输出与参考编译器的比值）
+ * @return 失败项个数：测量失败、ToyC 与参考编译器运行结果不同、运行结果或指标相对基线改变 / 回归、
+ *   基线中的测试缺失
+ * @details 当前目录中没有参考产物的测试，比值改用基线中记录的参考数据
+ */
+int report(const std::vector<TestResult> &results, const Baseline *base, double threshold,
+           const std::string &reference) {
+    char line[256];
+    int failures = 0;
+    GeoMean gInsts, gSpills, gBytes;
+    std::cout << "=== ToyC vs " << reference << " (toyc_sim dynamic counts) ===\n";
+    std::snprintf(line, sizeof(line), "%-28s %10s %8s %8s %8s %7s %8s  %s\n", "test", "insts",
+                  "ratio", "spills", "ratio", "bytes", "ratio", base ? "baseline" : "");
+    std::cout << line;
+    for (const TestResult &t : results) {
+        const TestResult *old = nullptr;
+        if (base) {
+            auto it = base->tests.find(t.test);
+            old = it == base->tests.end() ? nullptr : &it->second;
+        }
+        const Metrics &ref = t.ref.valid ? t.ref : old ? old->ref : t.ref;
+        std::string status;
+        if (!t.error.empty()) {
+            status = "FAILED (" + t.error + ")";
+            ++failures;
+        } else if (t.ref.valid && t.ref.exitCode != t.toyc.exitCode) {
+            status = "MISMATCH (exit " + std::to_string(t.toyc.exitCode) + ", " + reference +
+                     " " + std::to_string(t.ref.exitCode) + ")";
+            ++failures;
+        } else if (base && !old) {
+            status = "new";
+        } else if (old && old->toyc.exitCode != t.toyc.exitCode) {
+            status = "WRONG RESULT (exit " + std::to_string(old->toyc.exitCode) + " -> " +
+                     std::to_string(t.toyc.exitCode) + ")";
+            ++failures;
+        } else if (old) {
+            std::string reg = regressionOf(t.toyc, old->toyc, threshold);
+            status = reg.empty() ? "ok" : "REGRESSION (" + reg + ")";
+            failures += !reg.empty();
+        }
+        if (ref.valid) {
+            gInsts.add(t.toyc.insts, ref.insts);
+            gSpills.add(t.toyc.spills(), ref.spills());
+            gBytes.add(t.toyc.textBytes, ref.textBytes);
+        }
+        auto ratio = [&](uint64_t v, uint64_t r) { return ref.valid ? formatRatio(v, r) : "-"; };
+        std::snprintf(line, sizeof(line), "%-28s %10llu %8s %8llu %8s %7llu %8s  %s\n",
+                      t.test.c_str(), static_cast<unsigned long long>(t.toyc.insts),
+                      ratio(t.toyc.insts, ref.insts).c_str(),
+                      static_cast<unsigned long long>(t.toyc.spills()),
+                      ratio(t.toyc.spills(), ref.spills()).c_str(),
+                      static_cast<unsigned long long>(t.toyc.textBytes),
+                      ratio(t.toyc.textBytes, ref.textBytes).c_str(), status.c_str());
+        std::cout << line;
+    }
+    if (base) {
+        for (const auto &[name, old] : base->tests) {
+            bool present = std::any_of(results.begin(), results.end(),
+                                       [&](const TestResult &t) { return t.test == name; });
+            if (!present) {
+                std::snprintf(line, sizeof(line), "%-28s %10s %8s %8s %8s %7s %8s  %s\n",
+                              name.c_str(), "-", "", "-", "", "-", "", "MISSING");
+                std::cout << line;
+                ++failures;
+            }
+        }
+    }
+    std::snprintf(line, sizeof(line), "%-28s %10s %8s %8s %8s %7s %8s\n", "geomean", "",
+                  gInsts.str().c_str(), "", gSpills.str().c_str(), "", gBytes.str().c_str());
+    std::cout << line;
+    return failures;
+}
+
+// printUsage：输出命令行帮助
+void printUsage(const char *prog) {
+    std::cerr << "Usage: " << prog << " [options] <dir>\n"
+              << "Options:\n"
+              << "  --json <file>         Write results as JSON (the baseline format)\n"
+              << "  --compare <file>      Compare ToyC metrics with baseline JSON, exit 1 on "
+                 "regression\n"
+              << "  --threshold <r>       Allowed increase ratio for --compare (default 0.02)\n"
+              << "  --toyc-suffix <s>     ToyC outputs are <name><s>.o / .s (default _toyc)\n"
+              << "  --ref-suffix <s>      Reference outputs are <name><s>.o / .s (default "
+                 "_clang)\n"
+              << "  --reference <label>   Reference compiler label (default \"clang -O2\")\n"
+              << "  --mtune=<model>       Latency model for the cycle estimate ("
+              << toyc::mir::latencyModelNames() << ")\n";
+}
+
+} // namespace
+
+#pragma endregion
+
+int main(int argc, char *argv[]) {
+    double threshold = 0.02;
+    std::string jsonPath, comparePath, dir;
+    std::string toycSuffix = "_toyc", refSuffix = "_clang", reference = "clang -O2";
+    toyc::sim::Options options;
+    options.fileIO = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--json" && hasValue)
+            jsonPath = argv[++i];
+        else if (arg == "--compare" && hasValue)
+            comparePath = argv[++i];
+        else if (arg == "--threshold" && hasValue)
+            threshold = std::strtod(argv[++i], nullptr);
+        else if (arg == "--toyc-suffix" && hasValue)
+            toycSuffix = argv[++i];
+        else if (arg == "--ref-suffix" && hasValue)
+            refSuffix = argv[++i];
+        else if (arg == "--reference" && hasValue)
+            reference = argv[++i];
+        else if (arg.rfind("--mtune=", 0) == 0) {
+            auto model = toyc::mir::parseLatencyModel(arg.substr(8));
+            if (!model) {
+                std::cerr << "Error: unknown latency model '" << arg.substr(8) << "'\n";
+                return 1;
+            }
+            options.model = *model;
+        } else if (arg[0] != '-' && dir.empty()) {
+            dir = arg;
+        } else {
+            printUsage(argv[0]);
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+    if (dir.empty() || !fs::is_directory(dir)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        std::vector<TestResult> results = measureAll(dir, toycSuffix, refSuffix, options);
+        if (results.empty()) {
+            std::cerr << "Error: no '*" << toycSuffix << ".o' / '.s' files in " << dir << "\n";
+            return 1;
+        }
+        Baseline base;
+        if (!comparePath.empty())
+            base = readBaseline(comparePath);
+        // 没有参考产物时比值全部来自基线，标签也以基线记录的为准
+        bool anyRef = std::any_of(results.begin(), results.end(),
+                                  [](const TestResult &t) { return t.ref.valid; });
+        if (!anyRef && !base.reference.empty())
+            reference = base.reference;
+        int failures = report(results, comparePath.empty() ? nullptr : &base, threshold,
+                              reference);
+
+        if (!jsonPath.empty()) {
+            std::ofstream ofs(jsonPath);
+            if (!ofs.is_open()) {
+                std::cerr << "Error: Cannot open output file '" << jsonPath << "'\n";
+                return 1;
+            }
+            writeJson(ofs, results, reference);
+        }
+        std::cout << "\n=== " << failures << " failure(s)";
+        if (!comparePath.empty())
+            std::cout << ", regression threshold " << threshold * 100 << "%";
+        std::cout << " ===\n";
+        return failures == 0 ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,88 @@
+#include "ir_passes.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+// hasPhis：逐块检查开头的指令（phi 总在块首）
+bool hasPhis(const Function &F) {
+    for (const auto &bb : F.blocks)
+        if (!bb->insts.empty() && bb->insts.front()->opcode == Opcode::Phi)
+            return true;
+    return false;
+}
+
+namespace {
+
+// copyInsertPos：在前驱块中插入拷贝的位置
+// 默认在终结指令之前（没有终结指令时为块尾）；若块以 "%c = icmp ...; br i1 %c" 结尾且没有拷贝读取 %c，
+// 则插在 icmp 之前，使比较与分支保持相邻
+size_t copyInsertPos(const BasicBlock &bb, const std::vector<Instruction *> &copies) {
+    const auto &insts = bb.insts;
+    if (insts.empty() || !insts.back()->isTerminator())
+        return insts.size();
+    size_t pos = insts.size() - 1;
+    const Instruction *term = insts.back();
+    int cond = term->branchCondReg();
+    if (cond < 0 || pos == 0)
+        return pos;
+    const Instruction *cmp = insts[pos - 1];
+    if (cmp->opcode != Opcode::ICmp || cmp->defReg() != cond)
+        return pos;
+    for (const Instruction *copy : copies)
+        if (copy->ops[0].isVReg() && copy->ops[0].regId() == cond)
+            return pos;
+    return pos - 1;
+}
+
+} // namespace
+
+/**
+ * @brief phi 消除
+ * @details 对每个 phi %d：分配临时寄存器 %t，在每个入口前驱中追加 %t = copy v，
+ *   并把 phi 替换为 %d = copy %t。同一前驱的全部拷贝先收集起来，最后一次性插入。
+ *   各拷贝只写互不相同的新寄存器、只读前驱出口处的值，彼此之间没有顺序依赖
+ */
+void eliminatePhis(Function &F) {
+    int nextVreg = F.maxVregId + 1;
+    std::unordered_map<BasicBlock *, std::vector<Instruction *>> predCopies;
+    std::vector<BasicBlock *> predOrder; // 按首次出现的顺序插入，结果与哈希表遍历顺序无关
+
+    for (auto &bb : F.blocks) {
+        for (Instruction *&I : bb->insts) {
+            if (I->opcode != Opcode::Phi)
+                break;
+            Operand temp = Operand::vreg(nextVreg++);
+            for (size_t k = 0; k < I->numIncoming(); ++k) {
+                auto it = F.blockMap.find(I->incomingBlock(k));
+                if (it == F.blockMap.end())
+                    continue; // 入口来自不存在的块：该边不会被执行
+                BasicBlock *pred = it->second;
+                Instruction *copy =
+                    F.newInst(Instruction::makeCopy(temp, I->type.str(), I->incomingValue(k)));
+                copy->blockId = pred->id;
+                auto [slot, inserted] = predCopies.try_emplace(pred);
+                if (inserted)
+                    predOrder.push_back(pred);
+                slot->second.push_back(copy);
+            }
+            Instruction *copy = F.newInst(Instruction::makeCopy(I->def, I->type.str(), temp));
+            copy->blockId = bb->id;
+            I = copy;
+        }
+    }
+
+    for (BasicBlock *pred : predOrder) {
+        const auto &copies = predCopies[pred];
+        size_t pos = copyInsertPos(*pred, copies);
+        pred->insts.insert(pred->insts.begin() + static_cast<std::ptrdiff_t>(pos), copies.begin(),
+                           copies.end());
+    }
+    F.maxVregId = nextVreg - 1;
+}
+
+} // namespace opt
+} // namespace toyc
@@ -0,0 +1,99 @@
+#include "profile.h"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace toyc {
+
+namespace {
+
+// readWord：读取 raw[pos] 处的小端 32 位无符号数
+uint32_t readWord(std::string_view raw, size_t pos) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i)
+        v |= static_cast<uint32_t>(static_cast<unsigned char>(raw[pos + i])) << (8 * i);
+    return v;
+}
+
+// align4：向上取整到 4 字节
+size_t align4(size_t n) { return (n + 3) & ~static_cast<size_t>(3); }
+
+} // namespace
+
+/**
+ * @brief 解析 .profraw
+ * @details 逐条读取记录：名字表按 '\n' 切分，第一项是函数名，其余依次对应各计数器。
+ *   长度越界、名字个数与计数器个数不符都视为损坏（不接受半条记录）
+ */
+ProfileData ProfileData::parse(std::string_view raw) {
+    ProfileData data;
+    size_t pos = 0;
+    while (pos < raw.size()) {
+        if (raw.size() - pos < 8)
+            throw std::runtime_error("truncated profile record header");
+        const uint32_t n = readWord(raw, pos);
+        const uint32_t namesLen = readWord(raw, pos + 4);
+        pos += 8;
+        if (align4(namesLen) > raw.size() - pos ||
+            n > (raw.size() - pos - align4(namesLen)) / 4)
+            throw std::runtime_error("truncated profile record");
+        std::string_view names = raw.substr(pos, namesLen);
+        pos += align4(namesLen);
+
+        std::vector<std::string_view> fields;
+        for (size_t start = 0; start < names.size();) {
+            size_t end = names.find('\n', start);
+            if (end == std::string_view::npos)
+                throw std::runtime_error("malformed profile name table");
+            fields.push_back(names.substr(start, end - start));
+            start = end + 1;
+        }
+        if (fields.empty() || fields.size() != static_cast<size_t>(n) + 1)
+            throw std::runtime_error("profile record has " + std::to_string(n) +
+                                     " counters but " + std::to_string(fields.size()) +
+                                     " names");
+        auto &blocks = data.functions_[std::string(fields[0])];
+        for (uint32_t k = 0; k < n; ++k)
+            blocks[std::string(fields[k + 1])] += readWord(raw, pos + 4 * k);
+        pos += 4 * static_cast<size_t>(n);
+    }
+    return data;
+}
+
+// load：整个文件读入内存后解析
+ProfileData ProfileData::load(const std::string &path) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.is_open())
+        throw std::runtime_error("cannot open profile '" + path + "'");
+    std::string raw((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    try {
+        return parse(raw);
+    } catch (const std::runtime_error &e) {
+        throw std::runtime_error(std::string(e.what()) + " in '" + path + "'");
+    }
+}
+
+int64_t ProfileData::count(std::string_view function, std::string_view block) const {
+    auto f = functions_.find(std::string(function));
+    if (f == functions_.end())
+        return -1;
+    auto b = f->second.find(std::string(block));
+    return b == f->second.end() ? -1 : b->second;
+}
+
+bool ProfileData::annotate(ir::Function &F) const {
+    auto f = functions_.find(F.name);
+    if (f == functions_.end())
+        return false;
+    for (auto &bb : F.blocks)
+        if (auto b = f->second.find(bb->name); b != f->second.end())
+            bb->profileCount = b->second;
+    return true;
+}
+
+void ProfileData::annotate(ir::Module &M) const {
+    for (auto &F : M.functions)
+        annotate(*F);
+}
+
+} // namespace toyc
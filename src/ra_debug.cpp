@@ -1,23 +1,44 @@
 // ToyC 寄存器分配调试工具
 // 在死循环中读取 LLVM IR 文本，输出完整的寄存器分配调试信息：
-//   IR 解析 → 基本块分析 → 活跃性分析 → 活跃区间 → 线性扫描分配结果
-// 用法：ra_debug [-o output.txt]
+//   IR 解析 → 基本块分析 → 活跃性分析 → 活跃区间 → 分配结果
+// 用法：ra_debug [-o output.txt] [--regalloc=linear|graph] [--compare]
+//       ra_debug --batch [-O0|-O1|-O2] [-o output.jsonl] [--regalloc=linear|graph] <输入>...
 //   交互式输入 IR 文本，以单独一行 "END" 结束一次输入
+//   --compare：不输出详细信息，对同一段 IR 分别运行两种分配器，逐函数对比溢出与拷贝数
+//   --batch：不交互，分析全部输入（.ll 或 ToyC 源码，展开规则同 toyc --batch），每个函数输出一行
+//     JSON：区间长度、逐指令的寄存器压力、溢出决定及其原因、调用点保存的寄存器数
 
+#include "batch_driver.h"
 #include "ir.h"
+#include "ir_analysis.h"
+#include "ir_builder.h"
 #include "ir_parser.h"
+#include "parser.h"
 #include "reg_alloc.h"
+#include "source_buffer.h"
 
+#include <climits>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <map>
+#include <set>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 using namespace toyc;
 using namespace toyc::ir;
 
 static std::ostream *g_out = &std::cout;
+static RegAllocKind g_regAlloc = RegAllocKind::Linear; // --regalloc 选择的分配器
+static bool g_compare = false;                         // --compare 对比模式
+static bool g_batch = false;                           // --batch 批量模式
+static int g_optLevel = 0;                             // 批量模式的 IR 优化级别（-O0 / -O1 / -O2）
 
 // ======================== 格式化输出辅助 ========================
 
@@ -85,44 +106,29 @@ static void dumpFunctionInfo(const Function &func) {
     }
 }
 
+/// 以 {%a, %b, ...} 形式输出一个寄存器集合（位向量经 toSet 导出为有序集合）
+static void printRegSet(const char *title, const BitVector &bits) {
+    std::set<int> regs = bits.toSet();
+    *g_out << "  " << title << ": {";
+    for (auto it = regs.begin(); it != regs.end(); ++it) {
+        if (it != regs.begin())
+            *g_out << ", ";
+        *g_out << "%" << *it;
+    }
+    *g_out << "}\n";
+}
+
 /// 输出活跃性分析结果（defSet, useSet, liveIn, liveOut）
 static void dumpLivenessInfo(const Function &func) {
     printHeader("活跃性分析结果");
 
     for (const auto &block : func.blocks) {
         *g_out << "基本块 " << block->name << " (ID: " << block->id << "):\n";
-
-        *g_out << "  defSet: {";
-        for (auto it = block->defSet.begin(); it != block->defSet.end(); ++it) {
-            if (it != block->defSet.begin())
-                *g_out << ", ";
-            *g_out << "%" << *it;
-        }
-        *g_out << "}\n";
-
-        *g_out << "  useSet: {";
-        for (auto it = block->useSet.begin(); it != block->useSet.end(); ++it) {
-            if (it != block->useSet.begin())
-                *g_out << ", ";
-            *g_out << "%" << *it;
-        }
-        *g_out << "}\n";
-
-        *g_out << "  liveIn: {";
-        for (auto it = block->liveIn.begin(); it != block->liveIn.end(); ++it) {
-            if (it != block->liveIn.begin())
-                *g_out << ", ";
-            *g_out << "%" << *it;
-        }
-        *g_out << "}\n";
-
-        *g_out << "  liveOut: {";
-        for (auto it = block->liveOut.begin(); it != block->liveOut.end(); ++it) {
-            if (it != block->liveOut.begin())
-                *g_out << ", ";
-            *g_out << "%" << *it;
-        }
-        *g_out << "}\n\n";
+        printRegSet("defSet", block->defSet);
+        printRegSet("useSet", block->useSet);
+        printRegSet("liveIn", block->liveIn);
+        printRegSet("liveOut", block->liveOut);
+        *g_out << "\n";
     }
 }
 
@@ -140,6 +146,8 @@ static void dumpAllocationResult(const AllocationResult &result, const RegInfo &
     *g_out << "寄存器映射数: " << result.vregToPhys.size() << "\n";
     *g_out << "  分配到物理寄存器: " << physCount << "\n";
     *g_out << "  溢出到栈: " << spillCount << "\n";
+    *g_out << "  重物化常量: " << result.rematValues.size() << "\n";
+    *g_out << "  溢出代价: " << result.spillCost << "\n";
 
     // 物理寄存器映射
     *g_out << "\n--- vreg → 物理寄存器 ---\n";
@@ -165,6 +173,14 @@ static void dumpAllocationResult(const AllocationResult &result, const RegInfo &
         }
     }
 
+    // 重物化的常量
+    if (!result.rematValues.empty()) {
+        *g_out << "\n--- vreg → 重物化常量 ---\n";
+        std::map<int, int> sortedRemat(result.rematValues.begin(), result.rematValues.end());
+        for (const auto &[vreg, value] : sortedRemat)
+            *g_out << "  %" << vreg << " → li " << value << "\n";
+    }
+
     // 参数位置
     if (!result.paramVregToLocation.empty()) {
         *g_out << "\n--- 参数位置 ---\n";
@@ -192,10 +208,134 @@ static void dumpAllocationResult(const AllocationResult &result, const RegInfo &
             *g_out << regInfo.getRegName(r) << " ";
         *g_out << "\n";
     }
+
+    // 调用点需保存的 caller-saved（按 call 指令位置排序）
+    std::map<int, const ir::Instruction *> calls;
+    for (const auto &[call, regs] : result.callSaves)
+        if (!regs.empty())
+            calls.emplace(call->index, call);
+    if (!calls.empty()) {
+        *g_out << "\n--- 调用点保存的 caller-saved 寄存器 ---\n";
+        for (const auto &[index, call] : calls) {
+            *g_out << "  #" << index << " call @" << call->callee << ": ";
+            for (int r : result.callSaves.at(call))
+                *g_out << regInfo.getRegName(r) << " ";
+            *g_out << "\n";
+        }
+    }
+}
+
+/// 按 RPO 为指令重新编号（与线性扫描的位置编号相同，图着色分配器不编号，供输出使用）
+static void numberInstructions(Function &func) {
+    int pos = 0;
+    for (auto *block : func.rpoOrder)
+        for (auto *inst : block->insts)
+            inst->index = pos++;
+}
+
+/// AllocSummary：一次分配的对比指标
+struct AllocSummary {
+    size_t spills = 0;          // 溢出到栈的 vreg 数（不含栈传入参数）
+    uint64_t spillCost = 0;     // 按循环深度加权的溢出代价
+    size_t moves = 0;           // 两端位置不同、需要生成 mv / lw / sw 的 copy 条数（目标重物化的除外）
+    uint64_t weightedMoves = 0; // 同上，按 10^循环深度 加权（动态拷贝数估计）
+    size_t calleeSaved = 0;     // 序言 / 尾声保存的 callee-saved 寄存器数
+    size_t callSaves = 0;       // 各调用点保存的 caller-saved 寄存器数之和
+};
+
+/// summarize：统计分配结果（func 为分配使用的函数，活跃性分析与循环信息已就绪）
+static AllocSummary summarize(Function &func, const AllocationResult &result) {
+    AllocSummary sum;
+    for (const auto &[vreg, slot] : result.vregToStack)
+        sum.spills += slot < 0;
+    sum.spillCost = result.spillCost;
+    sum.calleeSaved = result.calleeSavedRegs.size();
+    for (const auto &[call, regs] : result.callSaves)
+        sum.callSaves += regs.size();
+
+    // location：vreg 的位置（寄存器为非负编号，栈槽为 -1000 + 偏移，未分配为 INT_MIN）
+    auto location = [&](int vreg) {
+        if (auto it = result.vregToPhys.find(vreg); it != result.vregToPhys.end())
+            return it->second;
+        if (auto it = result.vregToStack.find(vreg); it != result.vregToStack.end())
+            return -1000 + it->second;
+        return INT_MIN;
+    };
+    const LoopInfo &loops = func.analyses().loops();
+    for (auto *block : func.rpoOrder) {
+        uint64_t w = 1;
+        for (int d = std::min(loops.loopDepth(block), 9); d > 0; --d)
+            w *= 10;
+        for (auto *inst : block->insts)
+            if (inst->opcode == Opcode::Copy && inst->ops[0].isVReg() &&
+                !result.rematValues.count(inst->defReg()) &&
+                location(inst->ops[0].regId()) != location(inst->defReg())) {
+                ++sum.moves;
+                sum.weightedMoves += w;
+            }
+    }
+    return sum;
+}
+
+/// compareAllocators：对同一段 IR 分别运行线性扫描与图着色，逐函数输出对比表
+/// 每种分配器使用各自解析的模块（分配会消除 phi、改写指令编号）
+static void compareAllocators(const std::string &irText) {
+    const RegAllocKind kinds[] = {RegAllocKind::Linear, RegAllocKind::Graph};
+    std::unique_ptr<Module> mods[2];
+    for (int k = 0; k < 2; ++k) {
+        IRParser parser;
+        mods[k] = parser.parseModule(irText);
+        if (!mods[k] || mods[k]->functions.empty()) {
+            *g_out << "[错误] 无法解析 LLVM IR，请检查输入格式。\n";
+            return;
+        }
+    }
+
+    printHeader("分配器对比 (linear vs graph)");
+    *g_out << std::left << std::setw(20) << "function" << std::setw(8) << "alloc" << std::right
+           << std::setw(8) << "spills" << std::setw(12) << "spill-cost" << std::setw(8)
+           << "moves" << std::setw(12) << "w-moves" << std::setw(8) << "callee" << std::setw(12)
+           << "call-saves" << "\n";
+    RegInfo regInfo;
+    AllocSummary total[2];
+    for (size_t f = 0; f < mods[0]->functions.size(); ++f) {
+        for (int k = 0; k < 2; ++k) {
+            Function &func = *mods[k]->functions[f];
+            auto allocator = createRegisterAllocator(kinds[k], regInfo);
+            AllocationResult result = allocator->allocate(func);
+            Function &allocated =
+                allocator->splitFunction() ? *allocator->splitFunction() : func;
+            AllocSummary sum = summarize(allocated, result);
+            *g_out << std::left << std::setw(20) << (k == 0 ? func.name : "") << std::setw(8)
+                   << regAllocKindName(kinds[k]) << std::right << std::setw(8) << sum.spills
+                   << std::setw(12) << sum.spillCost << std::setw(8) << sum.moves
+                   << std::setw(12) << sum.weightedMoves << std::setw(8) << sum.calleeSaved
+                   << std::setw(12) << sum.callSaves << "\n";
+            total[k].spills += sum.spills;
+            total[k].spillCost += sum.spillCost;
+            total[k].moves += sum.moves;
+            total[k].weightedMoves += sum.weightedMoves;
+            total[k].calleeSaved += sum.calleeSaved;
+            total[k].callSaves += sum.callSaves;
+        }
+    }
+    printSeparator('-', 60);
+    for (int k = 0; k < 2; ++k)
+        *g_out << std::left << std::setw(20) << (k == 0 ? "total" : "") << std::setw(8)
+               << regAllocKindName(kinds[k]) << std::right << std::setw(8) << total[k].spills
+               << std::setw(12) << total[k].spillCost << std::setw(8) << total[k].moves
+               << std::setw(12) << total[k].weightedMoves << std::setw(8)
+               << total[k].calleeSaved << std::setw(12) << total[k].callSaves << "\n";
 }
 
 /// 处理一段 LLVM IR 文本：解析 → 分析 → 分配 → 输出
 static void processIR(const std::string &irText) {
+    if (g_compare) {
+        *g_out << "\n输入的 LLVM IR:\n" << irText << "\n";
+        compareAllocators(irText);
+        return;
+    }
+
     // 1. 解析 IR
     IRParser parser;
     auto mod = parser.parseModule(irText);
@@ -209,18 +349,29 @@ static void processIR(const std::string &irText) {
     RegInfo regInfo;
 
     for (auto &func : mod->functions) {
-        // 2. 创建分配器并运行（debugMode 开启会输出活跃区间）
-        LinearScanAllocator allocator(regInfo);
-        allocator.setDebugMode(true);
-        allocator.setDebugOutput(g_out);
+        // 2. 创建分配器并运行（线性扫描的 debugMode 输出活跃区间，图着色输出冲突图规模）
+        std::unique_ptr<RegisterAllocator> allocator;
+        if (g_regAlloc == RegAllocKind::Linear) {
+            auto linear = std::make_unique<LinearScanAllocator>(regInfo);
+            linear->setDebugMode(true);
+            linear->setDebugOutput(g_out);
+            allocator = std::move(linear);
+        } else {
+            auto graph = std::make_unique<GraphColoringAllocator>(regInfo);
+            graph->setDebugOutput(g_out);
+            allocator = std::move(graph);
+        }
 
-        auto result = allocator.allocate(*func);
+        auto result = allocator->allocate(*func);
+        // 发生区间分裂时，分配结果对应插入了分裂拷贝的函数副本
+        Function &allocated = allocator->splitFunction() ? *allocator->splitFunction() : *func;
+        numberInstructions(allocated);
 
         // 3. 输出函数结构（在 allocate 之后，指令编号已赋值）
-        dumpFunctionInfo(*func);
+        dumpFunctionInfo(allocated);
 
         // 4. 输出活跃性分析结果（allocate 已经填充了 liveIn/liveOut）
-        dumpLivenessInfo(*func);
+        dumpLivenessInfo(allocated);
 
         // 5. 输出分配结果
         dumpAllocationResult(result, regInfo);
@@ -230,10 +381,174 @@ static void processIR(const std::string &irText) {
     *g_out << "分析完成\n";
 }
 
+// ======================== 批量模式 ========================
+
+/// jsonString：JSON 字符串字面量（转义引号、反斜杠与控制字符）
+static std::string jsonString(const std::string &text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned char>(c));
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+/**
+ * @brief 输出一个函数的分配质量报告（一行 JSON）
+ * @param func   传给 allocate 的函数（phi 已消除；线性扫描的区间分裂只改写它的副本）
+ * @param spills 分配器记录的溢出决定（按做出的先后顺序）
+ * @details 在 func 上重新做活跃性分析、按 RPO 编号并构建活跃区间（与第一轮分配看到的相同），
+ *   压力因此是程序本身的需求，不含分裂片段与它们的 reload / 写回拷贝：
+ *   - intervals：每个 vreg 的区间长度（覆盖的位置数，每条指令两个位置）、范围段数与最终位置
+ *     （物理寄存器名 / stack / remat；被分裂的 vreg 固定在栈上，记为 stack）
+ *   - pressure：第 i 条指令（RPO 编号）处同时活跃的 vreg 数，取其 def 位置与 use 位置的较大者；
+ *     max_pressure 给出最大值所在的指令与块，regs 为可分配寄存器数，超过它的位置必然溢出
+ *   - spills：溢出原因、轮次、做出决定的位置与权重，被换出时记下取得寄存器的 vreg；
+ *     pos 为该轮函数中的位置（第 1 轮与 pressure 的编号一致，之后的轮次在分裂后的副本上）。
+ *     之后改为常量重物化的溢出 remat 为 true（不产生访存）
+ *   - calls / call_saves：调用点数与各调用点保存的调用者保存寄存器数之和
+ */
+static void writeFunctionJson(const std::string &file, Function &func,
+                              const AllocationResult &result,
+                              const std::vector<SpillDecision> &spills, const RegInfo &regInfo) {
+    LivenessAnalysis LA;
+    LA.run(func);
+    numberInstructions(func);
+    LiveIntervalTable intervals = LiveIntervalBuilder(func, LA).build();
+
+    size_t numInsts = 0;
+    for (auto *block : func.rpoOrder)
+        numInsts += block->insts.size();
+
+    auto location = [&](int vreg) -> std::string {
+        if (result.rematValues.count(vreg))
+            return "remat";
+        if (result.vregToStack.count(vreg))
+            return "stack";
+        auto phys = result.vregToPhys.find(vreg);
+        return phys != result.vregToPhys.end() && phys->second >= 0
+                   ? regInfo.getRegName(phys->second)
+                   : "none";
+    };
+
+    // 区间长度，同时在差分数组上累计每个位置的活跃区间数
+    std::vector<int> delta(2 * numInsts + 1, 0);
+    std::ostringstream ivs;
+    const char *sep = "";
+    intervals.forEach([&](const LiveInterval &iv) {
+        int length = 0;
+        for (const LiveRange &r : iv.ranges) {
+            length += r.end - r.start + 1;
+            if (r.start >= 0 && static_cast<size_t>(r.end) < 2 * numInsts) {
+                ++delta[r.start];
+                --delta[r.end + 1];
+            }
+        }
+        ivs << sep << "{\"vreg\": " << iv.vreg << ", \"length\": " << length
+            << ", \"ranges\": " << iv.ranges.size() << ", \"location\": \"" << location(iv.vreg)
+            << "\"}";
+        sep = ", ";
+    });
+
+    std::vector<int> pressure(numInsts, 0);
+    for (int pos = 0, live = 0; static_cast<size_t>(pos) < 2 * numInsts; ++pos) {
+        live += delta[pos];
+        pressure[pos / 2] = std::max(pressure[pos / 2], live);
+    }
+    size_t peak = 0;
+    for (size_t i = 1; i < numInsts; ++i)
+        if (pressure[i] > pressure[peak])
+            peak = i;
+    std::string peakBlock;
+    for (auto *block : func.rpoOrder)
+        if (!block->insts.empty() && static_cast<size_t>(block->insts.front()->index) <= peak &&
+            peak <= static_cast<size_t>(block->insts.back()->index))
+            peakBlock = block->name;
+
+    size_t calls = 0, callSaves = 0;
+    for (const auto &[call, regs] : result.callSaves) {
+        ++calls;
+        callSaves += regs.size();
+    }
+
+    *g_out << "{\"file\": " << jsonString(file) << ", \"function\": " << jsonString(func.name)
+           << ", \"regalloc\": \"" << regAllocKindName(g_regAlloc) << "\", \"insts\": " << numInsts
+           << ", \"regs\": " << regInfo.allocatableRegs.size() << ", \"intervals\": [" << ivs.str()
+           << "], \"pressure\": [";
+    for (size_t i = 0; i < numInsts; ++i)
+        *g_out << (i ? ", " : "") << pressure[i];
+    *g_out << "], \"max_pressure\": " << (numInsts ? pressure[peak] : 0)
+           << ", \"max_pressure_inst\": " << (numInsts ? static_cast<long>(peak) : -1)
+           << ", \"max_pressure_block\": " << jsonString(peakBlock) << ", \"spills\": [";
+    sep = "";
+    for (const SpillDecision &d : spills) {
+        *g_out << sep << "{\"vreg\": " << d.vreg << ", \"reason\": \""
+               << spillReasonName(d.reason) << "\", \"round\": " << d.round
+               << ", \"pos\": " << d.pos << ", \"weight\": " << d.weight
+               << ", \"evicted_by\": " << d.evictedBy
+               << ", \"remat\": " << (result.rematValues.count(d.vreg) ? "true" : "false") << "}";
+        sep = ", ";
+    }
+    *g_out << "], \"spill_cost\": " << result.spillCost << ", \"calls\": " << calls
+           << ", \"call_saves\": " << callSaves
+           << ", \"callee_saved\": " << result.calleeSavedRegs.size() << "}\n";
+}
+
+/// analyzeFile：解析一个输入（.ll 直接读入，其余按 ToyC 源码经前端生成 IR），按 g_optLevel 优化后
+/// 逐函数分配并输出报告；失败时输出 {"file", "error"} 一行并返回 false
+static bool analyzeFile(const std::string &path) {
+    try {
+        SourceBuffer source = SourceBuffer::open(path);
+        std::unique_ptr<Module> mod;
+        if (std::filesystem::path(path).extension() == ".ll") {
+            IRParser parser;
+            mod = parser.parseModule(source.text());
+            if (!mod || mod->functions.empty())
+                throw std::runtime_error("failed to parse LLVM IR");
+        } else {
+            Parser parser(source.text());
+            CompUnit unit = parser.parseCompUnit();
+            mod = IRBuilder().buildModule(unit);
+        }
+        opt::optimizeModule(*mod, g_optLevel);
+
+        RegInfo regInfo;
+        for (auto &func : mod->functions) {
+            std::vector<SpillDecision> spills;
+            auto allocator = createRegisterAllocator(g_regAlloc, regInfo);
+            allocator->setSpillLog(&spills);
+            AllocationResult result = allocator->allocate(*func);
+            writeFunctionJson(path, *func, result, spills, regInfo);
+        }
+        return true;
+    } catch (const std::exception &e) {
+        *g_out << "{\"file\": " << jsonString(path) << ", \"error\": " << jsonString(e.what())
+               << "}\n";
+        return false;
+    }
+}
+
+/// runBatch：逐个分析展开后的输入，返回失败的文件数
+static int runBatch(const std::vector<std::string> &args) {
+    int failed = 0;
+    for (const std::string &path : collectBatchInputs(args))
+        failed += !analyzeFile(path);
+    return failed;
+}
+
 // ======================== 主程序 ========================
 
 int main(int argc, char *argv[]) {
     std::ofstream outputFile;
+    std::vector<std::string> inputs; // 批量模式的输入
 
     // 解析 -o 输出重定向
     for (int i = 1; i < argc; ++i) {
@@ -244,11 +559,44 @@ int main(int argc, char *argv[]) {
                 g_out = &outputFile;
             else
                 std::cerr << "警告: 无法打开输出文件，使用 stdout\n";
+        } else if (arg.rfind("--regalloc=", 0) == 0) {
+            if (!parseRegAllocKind(arg.substr(11), g_regAlloc)) {
+                std::cerr << "错误: 未知的寄存器分配器 '" << arg.substr(11)
+                          << "'（可选 linear / graph）\n";
+                return 1;
+            }
+        } else if (arg == "--compare") {
+            g_compare = true;
+        } else if (arg == "--batch") {
+            g_batch = true;
+        } else if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+            g_optLevel = arg[2] - '0';
         } else if (arg == "-h" || arg == "--help") {
-            std::cout << "用法: ra_debug [-o output.txt]\n"
+            std::cout << "用法: ra_debug [-o output.txt] [--regalloc=linear|graph] [--compare]\n"
+                      << "      ra_debug --batch [-O0|-O1|-O2] [-o output.jsonl] "
+                         "[--regalloc=linear|graph] <文件 / 目录 / @list>...\n"
                       << "交互式输入 LLVM IR 文本，以单独一行 \"END\" 结束一次输入。\n"
+                      << "--regalloc 选择分配器（默认 linear）；--compare 对同一段 IR 运行两种\n"
+                      << "分配器，逐函数输出溢出数、溢出代价、拷贝数与保存的寄存器数。\n"
+                      << "--batch 不交互，分析全部 .ll / ToyC 输入（ToyC 源码按 -O 级别优化），\n"
+                      << "每个函数输出一行 JSON（区间长度、寄存器压力、溢出原因、调用点保存数）。\n"
                       << "输入 \"quit\" 或 \"exit\" 退出。\n";
             return 0;
+        } else if (arg[0] != '-') {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (g_batch) {
+        if (inputs.empty()) {
+            std::cerr << "错误: --batch 需要至少一个输入文件或目录\n";
+            return 1;
+        }
+        try {
+            return runBatch(inputs) ? 1 : 0;
+        } catch (const std::exception &e) {
+            std::cerr << "错误: " << e.what() << "\n";
+            return 1;
         }
     }
 
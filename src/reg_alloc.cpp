@@ -1,8 +1,10 @@
 #include "reg_alloc.h"
+#include "ir_analysis.h"
+#include "ir_passes.h"
+#include "statistics.h"
+#include "thread_arena.h"
 #include <algorithm>
 #include <climits>
-#include <stack>
-#include <unordered_set>
 
 
 namespace toyc {
@@ -23,13 +25,17 @@ bool PhysRegComparator::operator()(int a, int b) const {
 /**
  * @brief 构造 RV32I 寄存器信息
  * @details 初始化 x0-x31 共 32 个物理寄存器的属性描述：
- *   - x0(zero), x1(ra), x2(sp), x3(gp), x4(tp), x8(s0/fp) 为保留寄存器
+ *   - x0(zero), x1(ra), x2(sp), x3(gp), x4(tp) 为保留寄存器；x8(s0/fp) 作为帧指针时保留，
+ *     省略帧指针（-fomit-frame-pointer）时是排在最后的被调用者保存寄存器
  *   - x5(t0), x6(t1) 保留作为溢出临时寄存器
  *   - x10-x17(a0-a7) 为参数/返回值寄存器，调用者保存，优先分配
  *   - x9(s1), x18-x27(s2-s11) 为被调用者保存寄存器
  *   - x7(t2), x28-x31(t3-t6) 为临时寄存器，调用者保存
+ *   - 向量寄存器 v0 保留作掩码寄存器，v1-v31 都是调用者保存（RVV 调用约定中没有被调用者保存的
+ *     向量寄存器）
  */
-RegInfo::RegInfo() : allocatableRegs(PhysRegComparator(&physRegs)) {
+RegInfo::RegInfo(bool compressed, bool omitFramePointer)
+    : allocatableRegs(PhysRegComparator(&physRegs)) {
     physRegs.resize(32);
 
     // id, name, callerSaved, calleeSaved, reserved, priority
@@ -41,8 +47,11 @@ RegInfo::RegInfo() : allocatableRegs(PhysRegComparator(&physRegs)) {
     physRegs[5] = PhysReg(5, "t0", true, false, true, 999);    // x5  溢出临时寄存器，保留
     physRegs[6] = PhysReg(6, "t1", true, false, true, 999);    // x6  溢出临时寄存器，保留
     physRegs[7] = PhysReg(7, "t2", true, false, false, 20); // x7  临时寄存器，调用者保存
-    physRegs[8] = PhysReg(8, "s0", false, false, true, 999); // x8  帧指针 (s0/fp)，保留
-    physRegs[9] = PhysReg(9, "s1", false, true, false, 50);  // x9  被调用者保存
+    // x8  帧指针 (s0/fp)，保留；省略帧指针时被调用者保存（压缩模式下与 s1 一样排在 s2-s11 之前）
+    physRegs[8] = omitFramePointer ? PhysReg(8, "s0", false, true, false, compressed ? 38 : 51)
+                                   : PhysReg(8, "s0", false, false, true, 999);
+    // x9  被调用者保存；压缩模式下是唯一可进入 3 位寄存器字段的被调用者保存寄存器，排在 s2-s11 之前
+    physRegs[9] = PhysReg(9, "s1", false, true, false, compressed ? 39 : 50);
     physRegs[10] = PhysReg(10, "a0", true, false, false, 0); // x10 参数/返回值，优先级最高
     physRegs[11] = PhysReg(11, "a1", true, false, false, 1); // x11 参数寄存器
     physRegs[12] = PhysReg(12, "a2", true, false, false, 2);
@@ -66,9 +75,26 @@ RegInfo::RegInfo() : allocatableRegs(PhysRegComparator(&physRegs)) {
     physRegs[30] = PhysReg(30, "t5", true, false, false, 23);
     physRegs[31] = PhysReg(31, "t6", true, false, false, 24);
 
-    for (int i = 0; i < 32; ++i)
+    for (int i = 0; i < 32; ++i) {
         if (!physRegs[i].reserved)
             allocatableRegs.insert(i);
+        if (physRegs[i].callerSaved)
+            callerSavedMask_ |= regBit(i);
+    }
+
+    vectorRegs.resize(32);
+    vectorRegs[0] = PhysReg(0, "v0", true, false, true, 999); // v0 掩码寄存器，保留
+    for (int i = 1; i < 32; ++i) {
+        vectorRegs[i] = PhysReg(i, "v" + std::to_string(i), true, false, false, i);
+        allocatableVectorRegs.push_back(i);
+    }
+}
+
+// shared：函数级静态对象，C++11 起初始化是线程安全的
+const RegInfo &RegInfo::shared(bool compressed, bool omitFramePointer) {
+    static const RegInfo instances[2][2] = {{RegInfo(false, false), RegInfo(false, true)},
+                                            {RegInfo(true, false), RegInfo(true, true)}};
+    return instances[compressed][omitFramePointer];
 }
 
 bool RegInfo::isReserved(int id) const { return physRegs[id].reserved; }
@@ -78,44 +104,65 @@ std::string RegInfo::getRegName(int id) const { return physRegs[id].name; }
 
 #pragma endregion
 
+#pragma region 过程间寄存器使用信息
+
+void RegUsageInfo::publish(ir::Symbol function, RegMask clobbers) {
+    std::lock_guard lock(mu_);
+    masks_[function.id()] = clobbers & abiMask_;
+}
+
+RegMask RegUsageInfo::clobbers(ir::Symbol function) const {
+    std::lock_guard lock(mu_);
+    auto it = masks_.find(function.id());
+    return it != masks_.end() ? it->second : abiMask_;
+}
+
+/**
+ * @brief 调用点破坏的寄存器
+ * @details 除被调函数自身改写的寄存器外，调用者在调用点写入前 8 个实参所在的 a0-a7，
+ *   有结果时从 a0 取回结果；这些寄存器中的值同样不能跨越本次调用
+ */
+RegMask RegUsageInfo::callClobbers(const ir::Instruction &call) const {
+    RegMask mask = clobbers(call.callee);
+    for (size_t i = 0; i < call.ops.size() && i < 8; ++i)
+        mask |= regBit(10 + static_cast<int>(i));
+    if (call.defReg() >= 0)
+        mask |= regBit(10);
+    return mask;
+}
+
+#pragma endregion
+
 #pragma region 活跃区间类实现
 
 /**
- * @brief 添加活跃范围并自动合并重叠/相邻区间
+ * @brief 添加活跃范围并就地合并重叠/相邻区间
  * @param s 范围起始位置
  * @param e 范围结束位置
- * @details 插入新范围后，与已有范围进行重叠和相邻检测，
- *          合并所有可合并的范围，保持 ranges 有序且无重叠
+ * @details ranges 始终有序且两两既不重叠也不相邻，因此起点与终点都单调递增：
+ *   - 新范围位于末尾之后时直接追加（区间构建按位置递增，绝大多数调用走此路径）
+ *   - 否则二分找出与 [s, e] 重叠或相邻的连续一段 [first, last)，
+ *     将其就地合并为一个范围；没有可合并的范围时在 first 处插入
  */
 void LiveInterval::addRange(int s, int e) {
-    LiveRange nr(s, e);
-    std::vector<LiveRange> merged;
-    bool placed = false;
-
-    for (auto &r : ranges) {
-        if (nr.overlaps(r) || nr.adjacent(r)) {
-            nr = LiveRange(std::min(nr.start, r.start), std::max(nr.end, r.end));
-        } else if (!placed && nr.start < r.start) {
-            merged.push_back(nr);
-            merged.push_back(r);
-            placed = true;
-        } else {
-            merged.push_back(r);
-        }
+    if (ranges.empty() || s > ranges.back().end + 1) {
+        ranges.emplace_back(s, e);
+        return;
     }
-    if (!placed)
-        merged.push_back(nr);
-
-    // 最终检查合并后仍可能有相邻
-    ranges.clear();
-    for (auto &r : merged) {
-        if (!ranges.empty() && (ranges.back().overlaps(r) || ranges.back().adjacent(r))) {
-            ranges.back() = LiveRange(std::min(ranges.back().start, r.start),
-                                      std::max(ranges.back().end, r.end));
-        } else {
-            ranges.push_back(r);
-        }
+
+    // first：第一个满足 end + 1 >= s 的范围
+    auto first = std::lower_bound(ranges.begin(), ranges.end(), s,
+                                  [](const LiveRange &r, int v) { return r.end + 1 < v; });
+    // last：第一个满足 start > e + 1 的范围
+    auto last = std::upper_bound(first, ranges.end(), e,
+                                 [](int v, const LiveRange &r) { return v + 1 < r.start; });
+    if (first == last) {
+        ranges.insert(first, LiveRange(s, e));
+        return;
     }
+    first->start = std::min(first->start, s);
+    first->end = std::max(std::prev(last)->end, e);
+    ranges.erase(std::next(first), last);
 }
 
 /**
@@ -124,10 +171,9 @@ void LiveInterval::addRange(int s, int e) {
  * @return true 表示该位置被某个 LiveRange 覆盖
  */
 bool LiveInterval::contains(int pos) const {
-    for (auto &r : ranges)
-        if (pos >= r.start && pos <= r.end)
-            return true;
-    return false;
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), pos,
+                               [](int v, const LiveRange &r) { return v < r.start; });
+    return it != ranges.begin() && pos <= std::prev(it)->end;
 }
 
 // 返回最早活跃起始位置（空区间返回 INT_MAX）
@@ -135,6 +181,30 @@ int LiveInterval::start() const { return ranges.empty() ? INT_MAX : ranges.front
 // 返回最晚活跃结束位置（空区间返回 -1）
 int LiveInterval::end() const { return ranges.empty() ? -1 : ranges.back().end; }
 
+// 构造函数：为 numVregs 个 vreg 预留槽位，并创建函数级内存池（内存块取自当前线程的内存池，
+// 析构后留在线程池中供下一个函数复用）
+LiveIntervalTable::LiveIntervalTable(int numVregs)
+    : arena_(std::make_unique<std::pmr::monotonic_buffer_resource>(threadArena())),
+      byVreg_(static_cast<size_t>(std::max(numVregs, 0)), nullptr) {}
+
+// 析构函数：逐个析构区间对象，内存随内存池一并释放
+LiveIntervalTable::~LiveIntervalTable() {
+    for (LiveInterval *iv : byVreg_)
+        if (iv)
+            std::destroy_at(iv);
+}
+
+// getOrCreate：取出 vreg 对应的区间，不存在时在内存池中创建
+LiveInterval &LiveIntervalTable::getOrCreate(int vreg) {
+    if (static_cast<size_t>(vreg) >= byVreg_.size())
+        byVreg_.resize(vreg + 1, nullptr);
+    if (!byVreg_[vreg]) {
+        std::pmr::polymorphic_allocator<> alloc(arena_.get());
+        byVreg_[vreg] = alloc.new_object<LiveInterval>(vreg, arena_.get());
+    }
+    return *byVreg_[vreg];
+}
+
 #pragma endregion
 
 #pragma region 活跃性分析实现
@@ -144,14 +214,14 @@ int LiveInterval::end() const { return ranges.empty() ? -1 : ranges.back().end;
  * @param F 目标函数
  * @details 流程：
  *   1. 构建控制流图（前驱/后继关系）
- *   2. 扫描指令，计算每个基本块的 useSet 和 defSet
+ *   2. 扫描指令，计算每个基本块的 useSet 和 defSet（位向量）
  *   3. 构建 RPO（逆后序）遍历序列
- *   4. 反向迭代求解 liveIn/liveOut 直到收敛
+ *   4. 基于工作表求解 liveIn/liveOut 直到收敛
  */
 void LivenessAnalysis::run(ir::Function &F) {
     F.buildCFG();
     computeUseDefSets(F);
-    F.rpoOrder = buildRPO(F.entryBlock());
+    F.rpoOrder = buildRPO(F);
     computeLivenessIteratively(F);
 }
 
@@ -159,94 +229,117 @@ void LivenessAnalysis::run(ir::Function &F) {
  * @brief 计算每个基本块的 useSet 和 defSet
  * @details useSet: 在本块中先使用后定义的寄存器（use-before-def）
  *          defSet: 在本块中被定义的寄存器
+ *          所有集合均为宽度 maxVregId + 1 的位向量；
+ *          若指令中出现超过 maxVregId 的编号，会先修正 maxVregId
  */
 void LivenessAnalysis::computeUseDefSets(ir::Function &F) {
+    int maxVreg = F.maxVregId;
+    for (auto &block : F.blocks)
+        for (auto &inst : block->insts) {
+            maxVreg = std::max(maxVreg, inst->defReg());
+            inst->forEachUse([&](int u) { maxVreg = std::max(maxVreg, u); });
+        }
+    F.maxVregId = maxVreg;
+    size_t nbits = static_cast<size_t>(maxVreg + 1);
+
     for (auto &block : F.blocks) {
-        block->useSet.clear();
-        block->defSet.clear();
-        block->liveIn.clear();
-        block->liveOut.clear();
+        block->useSet.resize(nbits);
+        block->defSet.resize(nbits);
+        block->liveIn.resize(nbits);
+        block->liveOut.resize(nbits);
 
-        std::set<int> localDef;
         for (auto &inst : block->insts) {
-            // 先处理 use（use-before-def 语义）
-            for (int u : inst->useRegs()) {
-                if (localDef.find(u) == localDef.end())
-                    block->useSet.insert(u);
-            }
+            // 先处理 use（use-before-def 语义：块内尚未定义的才计入 useSet）
+            inst->forEachUse([&](int u) {
+                if (!block->defSet.test(u))
+                    block->useSet.set(u);
+            });
             // 再处理 def
             int d = inst->defReg();
-            if (d != -1) {
-                block->defSet.insert(d);
-                localDef.insert(d);
-            }
+            if (d != -1)
+                block->defSet.set(d);
         }
     }
 }
 
 /**
  * @brief 构建逆后序（Reverse Post-Order）遍历序列
- * @param entry 函数入口基本块
+ * @param F 已调用 buildCFG 的函数
  * @return RPO 排序的基本块指针列表
- * @details 使用非递归 DFS + 后序收集，最后反转得到 RPO
+ * @details 在紧凑 CFG 的后继数组上做显式栈 DFS（结点 + 下一个待访问的后继下标），
+ *   访问标记为按块号下标的数组；后继按原顺序访问，得到与递归 DFS 相同的后序，最后反转为 RPO
  */
-std::vector<ir::BasicBlock *> LivenessAnalysis::buildRPO(ir::BasicBlock *entry) {
+std::vector<ir::BasicBlock *> LivenessAnalysis::buildRPO(const ir::Function &F) {
     std::vector<ir::BasicBlock *> order;
-    if (!entry)
+    const ir::CFG &cfg = F.cfg;
+    if (F.blocks.empty() || cfg.size() != F.blocks.size())
         return order;
 
-    std::unordered_set<ir::BasicBlock *> visited;
-    std::stack<std::pair<ir::BasicBlock *, bool>> stk;
-    stk.push({entry, false});
-
-    while (!stk.empty()) {
-        auto [bb, processed] = stk.top();
-        stk.pop();
-        if (processed) {
-            order.push_back(bb);
+    std::vector<char> visited(cfg.size(), 0);
+    std::vector<std::pair<uint32_t, uint32_t>> stack; // (块号, 下一个待访问的后继下标)
+    visited[0] = 1;
+    stack.push_back({0, cfg.succBegin[0]});
+    while (!stack.empty()) {
+        auto &[b, next] = stack.back();
+        if (next < cfg.succBegin[b + 1]) {
+            uint32_t succ = cfg.succ[next++];
+            if (!visited[succ]) {
+                visited[succ] = 1;
+                stack.push_back({succ, cfg.succBegin[succ]});
+            }
             continue;
         }
-        if (!visited.insert(bb).second)
-            continue;
-        stk.push({bb, true});
-        for (auto it = bb->succs.rbegin(); it != bb->succs.rend(); ++it)
-            if (visited.find(*it) == visited.end())
-                stk.push({*it, false});
+        order.push_back(F.blocks[b].get());
+        stack.pop_back();
     }
     std::reverse(order.begin(), order.end());
     return order;
 }
 
 /**
- * @brief 迭代求解 liveIn/liveOut 数据流方程
+ * @brief 基于工作表求解 liveIn/liveOut 数据流方程
  * @details 数据流方程：
  *   liveOut(B) = ∪ liveIn(S)，S ∈ succ(B)
  *   liveIn(B)  = useSet(B) ∪ (liveOut(B) - defSet(B))
- * 反复迭代直到所有基本块的 liveIn/liveOut 不再变化
+ * 初始工作表为 RPO 的逆序（即后序，后继先于前驱处理）；
+ * 某块的 liveIn 发生变化时，仅将其（可达的）前驱重新加入工作表，
+ * 避免每轮重算所有基本块。集合运算全部为按字并行的位向量运算。
  */
 void LivenessAnalysis::computeLivenessIteratively(ir::Function &F) {
-    bool changed = true;
-    while (changed) {
-        changed = false;
-        // 反向遍历 RPO 序列
-        for (int i = static_cast<int>(F.rpoOrder.size()) - 1; i >= 0; --i) {
-            auto *bb = F.rpoOrder[i];
-
-            // liveOut = 所有后继的 liveIn 的并集
-            std::set<int> newLiveOut;
-            for (auto *succ : bb->succs)
-                newLiveOut.insert(succ->liveIn.begin(), succ->liveIn.end());
-
-            // liveIn = useSet ∪ (liveOut - defSet)
-            std::set<int> newLiveIn = bb->useSet;
-            for (int v : newLiveOut)
-                if (bb->defSet.find(v) == bb->defSet.end())
-                    newLiveIn.insert(v);
-
-            if (newLiveIn != bb->liveIn || newLiveOut != bb->liveOut) {
-                bb->liveIn = newLiveIn;
-                bb->liveOut = newLiveOut;
-                changed = true;
+    const int n = static_cast<int>(F.rpoOrder.size());
+    if (n == 0)
+        return;
+
+    // 块 ID → RPO 下标（不可达块为 -1，不参与求解）
+    std::vector<int> rpoIndex(F.blocks.size(), -1);
+    for (int i = 0; i < n; ++i)
+        rpoIndex[F.rpoOrder[i]->id] = i;
+
+    std::vector<int> worklist;
+    std::vector<bool> inWorklist(n, true);
+    worklist.reserve(n);
+    for (int i = 0; i < n; ++i)
+        worklist.push_back(i); // 栈顶为 RPO 末尾，先处理靠近出口的块
+
+    while (!worklist.empty()) {
+        int idx = worklist.back();
+        worklist.pop_back();
+        inWorklist[idx] = false;
+        auto *bb = F.rpoOrder[idx];
+
+        // liveOut = 所有后继的 liveIn 的并集
+        bb->liveOut.clear();
+        for (uint32_t succ : F.cfg.succs(bb->id))
+            bb->liveOut.unionWith(F.blocks[succ]->liveIn);
+
+        // liveIn = useSet ∪ (liveOut - defSet)；变化时唤醒前驱
+        if (bb->liveIn.assignUnionDiff(bb->useSet, bb->liveOut, bb->defSet)) {
+            for (uint32_t pred : F.cfg.preds(bb->id)) {
+                int pi = rpoIndex[pred];
+                if (pi >= 0 && !inWorklist[pi]) {
+                    inWorklist[pi] = true;
+                    worklist.push_back(pi);
+                }
             }
         }
     }
@@ -258,110 +351,209 @@ void LivenessAnalysis::computeLivenessIteratively(ir::Function &F) {
 
 /**
  * @brief 构造活跃区间构建器
- * @param F         目标函数 IR
- * @param LA        已完成的活跃性分析
- * @param splitting 是否使用简化区间模式
+ * @param F          目标函数 IR
+ * @param LA         已完成的活跃性分析
+ * @param simplified 是否使用简化区间模式
  */
 LiveIntervalBuilder::LiveIntervalBuilder(ir::Function &F, const LivenessAnalysis &LA,
-                                         bool splitting)
-    : F_(F), LA_(LA), splitting_(splitting) {}
+                                         bool simplified)
+    : F_(F), LA_(LA), simplified_(simplified) {}
 
 /**
  * @brief 构建所有虚拟寄存器的活跃区间
- * @return vreg → LiveInterval 的映射（仅包含非空区间）
+ * @return 以 vreg 为下标的区间表（未出现的 vreg 没有区间）
+ * @details 所有区间在一次遍历中同时构建（每个基本块一次反向扫描），
+ *          复杂度与函数规模线性相关，而不是 vreg 数 × 指令数。
+ *          alloca 的结果是帧内偏移（load / store 直接按 s0 寻址），从不进入寄存器，
+ *          其区间清空，不占用物理寄存器
  */
-std::unordered_map<int, std::unique_ptr<LiveInterval>> LiveIntervalBuilder::build() {
-    std::unordered_map<int, std::unique_ptr<LiveInterval>> intervals;
-    for (int vreg = 0; vreg <= F_.maxVregId; ++vreg) {
-        auto interval = std::make_unique<LiveInterval>(vreg);
-        if (splitting_)
-            buildSimplifiedIntervalForVreg(vreg, interval);
-        else
-            buildIntervalForVreg(vreg, interval);
-        if (!interval->empty())
-            intervals[vreg] = std::move(interval);
-    }
-    return intervals;
+LiveIntervalTable LiveIntervalBuilder::build() {
+    LiveIntervalTable table(F_.maxVregId + 1);
+    if (simplified_)
+        buildSimplifiedIntervals(table);
+    else
+        buildPreciseIntervals(table);
+    for (auto &bb : F_.blocks)
+        for (auto *inst : bb->insts)
+            if (inst->opcode == ir::Opcode::Alloca)
+                if (LiveInterval *iv = table.get(inst->defReg()))
+                    iv->ranges.clear();
+    return table;
 }
 
 /**
- * @brief 为单个虚拟寄存器构建精确的活跃区间
- * @param vreg     虚拟寄存器 ID
- * @param interval 输出的活跃区间对象
- * @details 遍历 RPO 顺序的每个基本块，结合 liveIn/liveOut 和块内 def/use 信息，
- *          精确计算活跃范围并添加到 interval 中
+ * @brief 一次性构建所有虚拟寄存器的精确活跃区间
+ * @param table 以 vreg 为下标的区间表（输出）
+ * @details 经典的 "liveOut 播种 + 块内反向扫描" 算法。按 RPO 顺序处理每个基本块：
+ *   1. liveOut 中的 vreg 以块末位置 lastPos 作为区间终点
+ *   2. 反向遍历指令：每次出现（def 取 posDef，use 取 posUse）都刷新起点，
+ *      首次遇到（即正序的最后一次出现）时记录终点
+ *   3. liveIn 中的 vreg 起点扩展到块首 firstPos
+ *   每个块为每个涉及的 vreg 产生一段 [start, end]，块按位置递增处理，
+ *   因此 addRange 总是追加到区间末尾
  */
-void LiveIntervalBuilder::buildIntervalForVreg(int vreg, std::unique_ptr<LiveInterval> &interval) {
+void LiveIntervalBuilder::buildPreciseIntervals(LiveIntervalTable &table) {
+    const int nv = F_.maxVregId + 1;
+    std::vector<int> startPos(nv, -1), endPos(nv, -1);
+    std::vector<int> seenEpoch(nv, -1); // 本块是否已遇到该 vreg（以块序号为标记）
+    std::vector<int> touched;
+
+    int epoch = 0;
     for (auto *bb : F_.rpoOrder) {
-        bool liveAtStart = bb->liveIn.count(vreg) > 0;
-        bool liveAtEnd = bb->liveOut.count(vreg) > 0;
-
-        // 检查块内是否有 def/use
-        bool hasDefUse = false;
-        if (!liveAtStart && !liveAtEnd) {
-            for (auto &inst : bb->insts) {
-                if (inst->defReg() == vreg) {
-                    hasDefUse = true;
-                    break;
-                }
-                for (int u : inst->useRegs())
-                    if (u == vreg) {
-                        hasDefUse = true;
-                        break;
-                    }
-                if (hasDefUse)
-                    break;
+        ++epoch;
+        if (bb->insts.empty())
+            continue;
+        touched.clear();
+        auto touch = [&](int v) {
+            if (seenEpoch[v] != epoch) {
+                seenEpoch[v] = epoch;
+                startPos[v] = -1;
+                endPos[v] = -1;
+                touched.push_back(v);
             }
-            if (!hasDefUse)
-                continue;
+        };
+        // 出现在位置 p：反向扫描中首次出现时定终点，每次出现都前移起点
+        auto occur = [&](int v, int p) {
+            touch(v);
+            if (endPos[v] == -1)
+                endPos[v] = p;
+            startPos[v] = p;
+        };
+
+        bb->liveOut.forEach([&](int v) {
+            touch(v);
+            endPos[v] = bb->lastPos();
+        });
+
+        for (auto it = bb->insts.rbegin(); it != bb->insts.rend(); ++it) {
+            auto &inst = *it;
+            inst->forEachUse([&](int u) { occur(u, inst->posUse()); });
+            int d = inst->defReg();
+            if (d != -1)
+                occur(d, inst->posDef());
         }
 
-        int rangeStart = liveAtStart ? bb->firstPos() : -1;
-        int rangeEnd = liveAtEnd ? bb->lastPos() : -1;
-
-        for (auto &inst : bb->insts) {
-            // def
-            if (inst->defReg() == vreg) {
-                if (rangeStart == -1)
-                    rangeStart = inst->posDef();
-                rangeEnd = liveAtEnd ? bb->lastPos() : inst->posDef();
-            }
-            // use
-            for (int u : inst->useRegs()) {
-                if (u == vreg) {
-                    if (rangeStart == -1)
-                        rangeStart = liveAtStart ? bb->firstPos() : inst->posUse();
-                    rangeEnd = std::max(rangeEnd, inst->posUse());
-                    break;
-                }
-            }
+        for (int v : touched) {
+            int start = bb->liveIn.test(v) ? bb->firstPos() : startPos[v];
+            if (start != -1 && endPos[v] != -1)
+                table.getOrCreate(v).addRange(start, endPos[v]);
         }
-
-        if (rangeStart != -1 && rangeEnd != -1)
-            interval->addRange(rangeStart, rangeEnd);
     }
 }
 
 /**
- * @brief 为单个虚拟寄存器构建简化的活跃区间
- * @param vreg     虚拟寄存器 ID
- * @param interval 输出的活跃区间对象
+ * @brief 一次性构建所有虚拟寄存器的简化区间
+ * @param table 以 vreg 为下标的区间表（输出）
  * @details 仅在每个 def/use 点处添加点区间 [pos, pos]，由 addRange 自动合并
  */
-void LiveIntervalBuilder::buildSimplifiedIntervalForVreg(int vreg,
-                                                         std::unique_ptr<LiveInterval> &interval) {
+void LiveIntervalBuilder::buildSimplifiedIntervals(LiveIntervalTable &table) {
     for (auto *bb : F_.rpoOrder) {
         for (auto &inst : bb->insts) {
-            if (inst->defReg() == vreg)
-                interval->addRange(inst->posDef(), inst->posDef());
-            for (int u : inst->useRegs()) {
-                if (u == vreg) {
-                    interval->addRange(inst->posUse(), inst->posUse());
-                    break;
-                }
+            int d = inst->defReg();
+            if (d != -1)
+                table.getOrCreate(d).addRange(inst->posDef(), inst->posDef());
+            inst->forEachUse(
+                [&](int u) { table.getOrCreate(u).addRange(inst->posUse(), inst->posUse()); });
+        }
+    }
+}
+
+#pragma endregion
+
+#pragma region 寄存器偏好实现
+
+/**
+ * @brief 收集调用约定决定的寄存器偏好
+ * @details 每处 ret / call 为相关 vreg 的 (寄存器, 权重) 累加所在块的执行频率（blockFrequency）；
+ *   一个 vreg 的偏好通常只有一两个，逐项线性查找即可
+ */
+std::vector<RegHint> computeRegHints(ir::Function &F) {
+    std::vector<std::vector<RegHint>> votes(static_cast<size_t>(F.maxVregId + 1));
+    auto vote = [&](const ir::Operand &op, int reg, uint64_t w) {
+        if (!op.isVReg() || op.regId() < 0 || static_cast<size_t>(op.regId()) >= votes.size())
+            return;
+        auto &list = votes[op.regId()];
+        auto it = std::find_if(list.begin(), list.end(),
+                               [&](const RegHint &h) { return h.reg == reg; });
+        if (it == list.end())
+            list.push_back(RegHint{reg, w});
+        else
+            it->weight += w;
+    };
+
+    constexpr int a0 = 10; // a0=x10 .. a7=x17
+    const LoopInfo &loops = F.analyses().loops();
+    for (auto *block : F.rpoOrder) {
+        const uint64_t w = blockFrequency(F, loops, block);
+        for (auto *inst : block->insts) {
+            if (inst->opcode == ir::Opcode::Ret && !inst->ops.empty())
+                vote(inst->ops[0], a0, w);
+            else if (inst->isCallInst()) {
+                for (size_t i = 0; i < inst->ops.size() && i < 8; ++i)
+                    vote(inst->ops[i], a0 + static_cast<int>(i), w);
+                vote(inst->def, a0, w);
             }
         }
     }
+
+    std::vector<RegHint> hints(votes.size());
+    for (size_t v = 0; v < votes.size(); ++v)
+        for (const RegHint &h : votes[v])
+            if (h.weight > hints[v].weight || (h.weight == hints[v].weight && h.reg < hints[v].reg))
+                hints[v] = h;
+    return hints;
+}
+
+#pragma endregion
+
+#pragma region 分配器接口实现
+
+// parseRegAllocKind：--regalloc= 的取值
+bool parseRegAllocKind(const std::string &name, RegAllocKind &kind) {
+    if (name == "linear")
+        kind = RegAllocKind::Linear;
+    else if (name == "graph")
+        kind = RegAllocKind::Graph;
+    else
+        return false;
+    return true;
+}
+
+// regAllocKindName：与 parseRegAllocKind 互逆（写入缓存配置、调试输出）
+const char *regAllocKindName(RegAllocKind kind) {
+    return kind == RegAllocKind::Graph ? "graph" : "linear";
+}
+
+// spillReasonName：溢出原因的名字（ra_debug --batch 的 JSON 输出）
+const char *spillReasonName(SpillReason reason) {
+    switch (reason) {
+    case SpillReason::NoFreeReg:
+        return "no-free-reg";
+    case SpillReason::Evicted:
+        return "evicted";
+    case SpillReason::Uncolorable:
+        return "uncolorable";
+    }
+    return "unknown";
+}
+
+// createRegisterAllocator：每个函数创建一个新的分配器（分配器持有该函数的分配结果）
+std::unique_ptr<RegisterAllocator> createRegisterAllocator(RegAllocKind kind,
+                                                           const RegInfo &regInfo) {
+    if (kind == RegAllocKind::Graph)
+        return std::make_unique<GraphColoringAllocator>(regInfo);
+    return std::make_unique<LinearScanAllocator>(regInfo);
+}
+
+// allocateSpillTempReg：交替返回 t0/t1 作为溢出临时寄存器
+int RegisterAllocator::allocateSpillTempReg() {
+    spillTempCounter_ = !spillTempCounter_;
+    return spillTempCounter_ ? spillTempReg1_ : spillTempReg2_;
+}
+
+// isSpillTempReg：判断是否为溢出临时寄存器
+bool RegisterAllocator::isSpillTempReg(int regId) const {
+    return regId == spillTempReg1_ || regId == spillTempReg2_;
 }
 
 #pragma endregion
@@ -370,7 +562,7 @@ void LiveIntervalBuilder::buildSimplifiedIntervalForVreg(int vreg,
 
 // 构造函数：初始化寄存器信息、使用标记数组和空闲寄存器池
 LinearScanAllocator::LinearScanAllocator(const RegInfo &regInfo)
-    : regInfo_(regInfo), freePhysRegs_(PhysRegComparator(&regInfo_.physRegs)) {
+    : RegisterAllocator(regInfo), freePhysRegs_(PhysRegComparator(&regInfo_.physRegs)) {
     isPhysRegUsed_.resize(32, false);
     initializeFreeRegs();
 }
@@ -387,59 +579,206 @@ void LinearScanAllocator::initializeFreeRegs() {
  * @param F 目标函数 IR
  * @return 分配结果
  * @details 流程：
- *   1. 处理函数参数（绑定 a0-a7 或栈）
- *   2. 执行活跃性分析
- *   3. 为指令分配线性位置编号
- *   4. 构建活跃区间
- *   5. 执行线性扫描分配
- *   6. 收集使用信息
+ *   0. 若函数含 phi（-O1 起 mem2reg 的产物），先消除为拷贝并做拷贝传播
+ *   1. 一轮线性扫描（allocateRound）
+ *   2. 有溢出且开启分裂时，分裂溢出的 vreg 并回到 1（至多 kMaxRounds 轮）：
+ *      第一次分裂时复制一份函数，之后的轮次都在副本上进行，原函数保持不变
+ *   3. 常量重物化（rematerializeConstants）与栈槽着色（colorStackSlots），收集使用信息
  */
 AllocationResult LinearScanAllocator::allocate(ir::Function &F) {
+    nextSpillSlot_ = 0;
+    splitFunc_.reset();
+    splitParent_.clear();
+    loopPieces_.clear();
+    homeSlots_.clear();
+
+    // 0. phi 消除（分配器与代码生成只认识普通指令），随后传播块首的 phi 拷贝
+    if (opt::hasPhis(F)) {
+        opt::eliminatePhis(F);
+        opt::propagateCopies(F);
+    }
+
+    for (int round = 1;; ++round) {
+        round_ = round;
+        allocateRound(splitFunc_ ? *splitFunc_ : F);
+        if (!splitting_ || round == kMaxRounds || !splitSpilled(F))
+            break;
+    }
+    ir::Function &target = splitFunc_ ? *splitFunc_ : F;
+    rematerializeConstants(target, result_);
+    colorStackSlots(target, result_);
+
+    // 收集使用信息
+    result_.usedPhysRegs = getUsedPhysRegs();
+    result_.calleeSavedRegs = getCalleeSavedRegs();
+
+    stats::add(stats::Counter::VRegs, static_cast<uint64_t>(target.maxVregId + 1));
+    stats::add(stats::Counter::Spills, result_.vregToStack.size());
+    stats::add(stats::Counter::SpillCost, result_.spillCost);
+    stats::add(stats::Counter::SplitPieces, splitParent_.size());
+    return result_;
+}
+
+/**
+ * @brief 一轮完整的线性扫描
+ * @param F 目标函数（原函数或分裂后的副本）
+ * @details 流程：
+ *   1. 执行活跃性分析
+ *   2. 为指令分配线性位置编号
+ *   3. 构建活跃区间，按循环深度计算溢出权重，标记跨越调用的区间，收集寄存器偏好与拷贝来源
+ *   4. 处理函数参数（绑定 a0-a7 或栈），已分裂的 vreg 预先绑定到它的栈槽
+ *   5. 执行线性扫描分配，记录每个调用点需要保存的调用者保存寄存器
+ */
+void LinearScanAllocator::allocateRound(ir::Function &F) {
     result_ = AllocationResult{};
     active_.clear();
-    nextSpillSlot_ = 0;
     allocatedVregs_.clear();
+    std::fill(isPhysRegUsed_.begin(), isPhysRegUsed_.end(), false);
     initializeFreeRegs();
 
-    // 1. 处理函数参数
-    processParameters(F.paramVregs);
-
-    // 2. 活跃性分析
+    // 1. 活跃性分析
     LivenessAnalysis LA;
-    LA.run(F);
+    {
+        stats::ScopedTimer timer(stats::Phase::Liveness);
+        LA.run(F);
+    }
 
-    // 3. 指令线性化编号
+    // 2. 指令线性化编号
     assignInstrPositions(F);
 
-    // 4. 构建活跃区间
+    // 3. 构建活跃区间
     LiveIntervalBuilder builder(F, LA);
-    auto intervals = builder.build();
+    auto intervals = [&] {
+        stats::ScopedTimer timer(stats::Phase::Intervals);
+        return builder.build();
+    }();
+    computeSpillWeights(F, intervals);
+    markCallCrossings(F, intervals);
+    hints_ = computeRegHints(F);
+    collectCopySources(F);
+
+    // 4. 绑定已分裂的 vreg 与函数参数
+    for (auto [vreg, slot] : homeSlots_) {
+        result_.vregToStack[vreg] = slot;
+        allocatedVregs_.insert(vreg);
+    }
+    processParameters(F.paramVregs, intervals);
 
     if (debugMode_)
         dumpIntervals(intervals);
 
     // 5. 执行线性扫描
-    result_ = runLinearScan(intervals);
+    {
+        stats::ScopedTimer timer(stats::Phase::LinearScan);
+        result_ = runLinearScan(intervals);
+    }
+    collectCallSaves(intervals);
+}
 
-    // 6. 收集使用信息
-    result_.usedPhysRegs = getUsedPhysRegs();
-    result_.calleeSavedRegs = getCalleeSavedRegs();
+/**
+ * @brief 分裂本轮溢出的 vreg
+ * @param original 传给 allocate 的原函数（首次分裂时复制它）
+ * @return 是否产生了新的片段（为 false 时分配结束）
+ * @details 本轮溢出的 vreg 按类别处理（栈传入的参数本来就在调用者的栈帧中，不算溢出）：
+ *   - 普通 vreg：固定到它的栈槽，按循环 / 基本块分裂
+ *   - 循环片段：与父 vreg 之间的拷贝删除（共用栈槽），固定在栈上，再按基本块分裂
+ *   - 块片段：与父 vreg 之间的拷贝删除，固定在栈上，不再分裂
+ *   之后下一轮 allocateRound 为新片段重新分配寄存器。
+ *   副本只在确实产生了片段时保留：本轮在原函数上进行时 callSaves 以原函数的指令为键，
+ *   此时留下未改动的副本会让代码生成在副本上查不到调用点需要保存的寄存器
+ */
+bool LinearScanAllocator::splitSpilled(ir::Function &original) {
+    std::vector<int> spilled;
+    for (auto [vreg, slot] : result_.vregToStack)
+        if (slot < 0 && !homeSlots_.count(vreg))
+            spilled.push_back(vreg);
+    if (spilled.empty())
+        return false;
+    std::sort(spilled.begin(), spilled.end()); // 分裂顺序决定新 vreg 编号，须与哈希表顺序无关
+
+    const bool firstSplit = !splitFunc_;
+    if (firstSplit) {
+        splitFunc_ = original.clone();
+        LivenessAnalysis().run(*splitFunc_);
+    }
+    ir::Function &F = *splitFunc_;
+
+    std::unordered_map<int, int> spilledPieces; // 再次溢出的片段 → 父 vreg
+    std::vector<int> toLoops, toBlocks;
+    for (int vreg : spilled) {
+        homeSlots_[vreg] = result_.vregToStack[vreg];
+        auto parent = splitParent_.find(vreg);
+        if (parent == splitParent_.end())
+            toLoops.push_back(vreg);
+        else {
+            spilledPieces.emplace(vreg, parent->second);
+            if (loopPieces_.count(vreg))
+                toBlocks.push_back(vreg);
+        }
+    }
+    if (!spilledPieces.empty())
+        LiveRangeSplitter::removeCopies(F, spilledPieces);
+    if (toLoops.empty() && toBlocks.empty())
+        return true; // 只有块片段再次溢出：删去拷贝后再分配一轮
+
+    std::vector<int> candidates(toLoops);
+    candidates.insert(candidates.end(), toBlocks.begin(), toBlocks.end());
+    LiveRangeSplitter splitter(F, candidates);
+    for (int vreg : toLoops)
+        splitter.splitAcrossLoops(vreg);
+    for (int vreg : toBlocks)
+        splitter.splitIntoBlocks(vreg);
+    if (splitter.pieces().empty() && spilledPieces.empty()) {
+        if (firstSplit)
+            splitFunc_.reset(); // 本轮在原函数上进行，结果对应原函数
+        return false;           // 没有可分裂的区间：本轮结果即最终结果
+    }
+    splitter.commit();
+    for (const auto &piece : splitter.pieces()) {
+        splitParent_[piece.vreg] = piece.parent;
+        if (piece.isLoop)
+            loopPieces_.insert(piece.vreg);
+    }
+    return true;
+}
 
-    return result_;
+// splitRoot：沿片段链找到最初被分裂的 vreg
+int LinearScanAllocator::splitRoot(int vreg) const {
+    for (auto it = splitParent_.find(vreg); it != splitParent_.end();
+         it = splitParent_.find(vreg))
+        vreg = it->second;
+    return vreg;
+}
+
+// spillSlotFor：片段溢出时与根 vreg 共用栈槽（同一个值），其余区间分配新栈槽
+int LinearScanAllocator::spillSlotFor(const LiveInterval &interval) {
+    auto home = homeSlots_.find(splitRoot(interval.vreg));
+    return home != homeSlots_.end() ? home->second : allocateSpillSlot();
 }
 
 /**
  * @brief 处理函数参数的寄存器绑定
  * @param paramVregs 参数对应的虚拟寄存器列表
- * @details 前 8 个参数绑定到 a0-a7（x10-x17），超出部分分配到栈
+ * @param intervals  本轮的区间表（判断参数是否跨越调用）
+ * @details 前 8 个参数到达 a0-a7（x10-x17），超出部分位于栈上。
+ *   不跨越调用的寄存器参数直接绑定到到达寄存器；跨越调用的参数只记录到达位置，
+ *   与普通区间一起分配（通常得到 s1-s11），由代码生成在入口处搬移。
+ *   已固定在栈槽的（被分裂的）参数同样只记录到达位置
  */
-void LinearScanAllocator::processParameters(const std::vector<int> &paramVregs) {
+void LinearScanAllocator::processParameters(const std::vector<int> &paramVregs,
+                                            const LiveIntervalTable &intervals) {
     for (size_t i = 0; i < paramVregs.size(); ++i) {
         int vreg = paramVregs[i];
         if (i < 8) {
             int argReg = 10 + static_cast<int>(i); // a0=x10 .. a7=x17
-            result_.vregToPhys[vreg] = argReg;
             result_.paramVregToLocation[vreg] = argReg;
+            const LiveInterval *iv = intervals.get(vreg);
+            if (homeSlots_.count(vreg) ||
+                (iv && iv->crossesCall && !preservedAcross(argReg, iv->callClobbers)))
+                continue;
+            result_.vregToPhys[vreg] = argReg;
+            if (!iv || iv->empty())
+                continue; // 未使用的参数：到达寄存器可以直接分配给其他值
             isPhysRegUsed_[argReg] = true;
             freePhysRegs_.erase(argReg);
             allocatedVregs_.insert(vreg);
@@ -452,6 +791,75 @@ void LinearScanAllocator::processParameters(const std::vector<int> &paramVregs)
     }
 }
 
+/**
+ * @brief 枚举区间跨越的调用（按位置升序），fn(调用下标) 返回 false 时停止
+ * @details 每个范围二分定位第一个 use 位置不早于范围起点的调用
+ */
+template <typename Fn> void LinearScanAllocator::forEachCrossedCall(const LiveInterval &iv, Fn &&fn) {
+    for (const LiveRange &r : iv.ranges) {
+        auto it = std::lower_bound(
+            calls_.begin(), calls_.end(), r.start,
+            [](const ir::Instruction *call, int pos) { return call->posUse() < pos; });
+        for (; it != calls_.end() && (*it)->posUse() + 1 <= r.end; ++it)
+            if ((*it)->defReg() != iv.vreg && !fn(static_cast<size_t>(it - calls_.begin())))
+                return;
+    }
+}
+
+/**
+ * @brief 收集 call 指令并标记跨越调用的区间
+ * @details 区间同时包含 call 的 use 位置与其后一个位置（下一条指令的 def 位置），即在调用之后
+ *   仍活跃（call 自身的结果除外），它的值必须在调用前后保持不变。
+ *   同一基本块内的位置连续，相邻范围已合并，因此只需检查单个范围
+ */
+void LinearScanAllocator::markCallCrossings(ir::Function &F, const LiveIntervalTable &intervals) {
+    calls_.clear();
+    callMasks_.clear();
+    for (auto *block : F.rpoOrder)
+        for (auto *inst : block->insts)
+            if (inst->isCallInst()) {
+                calls_.push_back(inst);
+                callMasks_.push_back(callClobbers(*inst));
+            }
+    if (calls_.empty())
+        return;
+    // 破坏全部调用者保存寄存器的调用（ABI）之后不必再看更多的调用
+    const RegMask all = regInfo_.callerSavedMask();
+    intervals.forEach([&](LiveInterval &iv) {
+        forEachCrossedCall(iv, [&](size_t call) {
+            iv.crossesCall = true;
+            iv.callClobbers |= callMasks_[call];
+            return iv.callClobbers != all;
+        });
+    });
+}
+
+/**
+ * @brief 为每个 call 记录跨越它、位于被该调用破坏的寄存器中的物理寄存器
+ * @details 预绑定的参数区间 physReg 为 -1，寄存器以 vregToPhys 为准。
+ *   按 ABI 时即全部调用者保存寄存器；过程间分配时被调函数不改写的寄存器不必保存
+ */
+void LinearScanAllocator::collectCallSaves(const LiveIntervalTable &intervals) {
+    std::vector<std::vector<int>> saves(calls_.size());
+    intervals.forEach([&](const LiveInterval &iv) {
+        if (!iv.crossesCall)
+            return;
+        auto phys = result_.vregToPhys.find(iv.vreg);
+        if (phys == result_.vregToPhys.end() || phys->second < 0 ||
+            !regInfo_.isCallerSaved(phys->second))
+            return;
+        forEachCrossedCall(iv, [&](size_t call) {
+            if (callMasks_[call] & regBit(phys->second))
+                saves[call].push_back(phys->second);
+            return true;
+        });
+    });
+    for (size_t i = 0; i < calls_.size(); ++i) {
+        std::sort(saves[i].begin(), saves[i].end());
+        result_.callSaves[calls_[i]] = std::move(saves[i]);
+    }
+}
+
 // assignInstrPositions：按 RPO 顺序为每条指令分配连续编号
 void LinearScanAllocator::assignInstrPositions(ir::Function &F) {
     int pos = 0;
@@ -463,22 +871,57 @@ void LinearScanAllocator::assignInstrPositions(ir::Function &F) {
     }
 }
 
+// collectCopySources：按指令编号记录 vreg 到 vreg 拷贝的来源（编号由 assignInstrPositions 分配）
+void LinearScanAllocator::collectCopySources(ir::Function &F) {
+    copySource_.clear();
+    for (auto *block : F.rpoOrder)
+        for (auto *inst : block->insts) {
+            int src = inst->opcode == ir::Opcode::Copy && inst->ops[0].isVReg()
+                          ? inst->ops[0].regId()
+                          : -1;
+            copySource_.push_back(src != inst->defReg() ? src : -1);
+        }
+}
+
+/**
+ * @brief 计算每个区间的溢出权重
+ * @param F         目标函数（活跃性分析已构建 CFG）
+ * @param intervals 以 vreg 为下标的区间表
+ * @details 溢出一个 vreg 后，它的每次 def 变成一条 sw、每次 use 变成一条 lw，
+ *   权重估计这些访存的动态执行次数：块内每次出现计块的执行频率（blockFrequency：
+ *   10^循环深度，有剖析数据时按实测计数）。
+ *   循环信息取自 Function::analyses()，LivenessAnalysis 刚重建过 CFG，这里会重新计算
+ */
+void LinearScanAllocator::computeSpillWeights(ir::Function &F,
+                                              const LiveIntervalTable &intervals) {
+    const LoopInfo &loops = F.analyses().loops();
+    for (auto *block : F.rpoOrder) {
+        const uint64_t w = blockFrequency(F, loops, block);
+        for (auto &inst : block->insts) {
+            if (LiveInterval *iv = intervals.get(inst->defReg()))
+                iv->weight += w;
+            inst->forEachUse([&](int u) {
+                if (LiveInterval *iv = intervals.get(u))
+                    iv->weight += w;
+            });
+        }
+    }
+}
+
 /**
  * @brief 线性扫描分配核心算法
- * @param intervals vreg → LiveInterval 映射
+ * @param intervals 以 vreg 为下标的区间表
  * @return 分配结果
  * @details 按起始位置排序所有区间，依次处理：
  *   1. 过期回收已结束的活跃区间
  *   2. 已预分配（参数）的区间直接插入 active
- *   3. 有空闲寄存器则分配，否则溢出
+ *   3. 能接过在此结束的拷贝来源 / 偏好寄存器则接过，否则有空闲寄存器则分配，再否则溢出
  */
-AllocationResult LinearScanAllocator::runLinearScan(
-    const std::unordered_map<int, std::unique_ptr<LiveInterval>> &intervals) {
-
+AllocationResult LinearScanAllocator::runLinearScan(const LiveIntervalTable &intervals) {
     std::vector<LiveInterval *> sorted;
-    for (auto &[vreg, iv] : intervals)
-        sorted.push_back(iv.get());
+    intervals.forEach([&](LiveInterval &iv) { sorted.push_back(&iv); });
     sortIntervalsByStart(sorted);
+    stats::add(stats::Counter::Intervals, sorted.size());
 
     for (auto *interval : sorted) {
         expireOldIntervals(interval->start());
@@ -490,7 +933,9 @@ AllocationResult LinearScanAllocator::runLinearScan(
             continue;
         }
 
-        if (freePhysRegs_.empty()) {
+        if (takeDyingReg(*interval)) {
+            allocatedVregs_.insert(interval->vreg);
+        } else if (freePhysRegs_.empty()) {
             spillAtInterval(*interval);
         } else {
             allocatePhysicalReg(*interval);
@@ -501,11 +946,16 @@ AllocationResult LinearScanAllocator::runLinearScan(
 }
 
 // expireOldIntervals：释放在 curStart 之前已经结束的活跃区间占用的物理寄存器
+// （预绑定的参数区间 physReg 为 -1，它的到达寄存器以 vregToPhys 为准，同样归还空闲池）
 void LinearScanAllocator::expireOldIntervals(int curStart) {
     auto it = active_.begin();
     while (it != active_.end()) {
         if ((*it)->end() < curStart) {
-            freePhysReg((*it)->physReg);
+            int reg = (*it)->physReg;
+            auto phys = result_.vregToPhys.find((*it)->vreg);
+            if (reg < 0 && phys != result_.vregToPhys.end())
+                reg = phys->second;
+            freePhysReg(reg);
             it = active_.erase(it);
         } else {
             break;
@@ -514,33 +964,87 @@ void LinearScanAllocator::expireOldIntervals(int curStart) {
 }
 
 // allocatePhysicalReg：从空闲池中取出一个寄存器并插入 active 列表
+// 调用约定偏好都是调用者保存寄存器，跨越调用的区间只在偏好能原样跨越这些调用时使用它
 void LinearScanAllocator::allocatePhysicalReg(LiveInterval &interval) {
-    int physReg = allocatePhysReg();
+    int hint = hints_[interval.vreg].reg;
+    if (interval.crossesCall && hint >= 0 && !preservedAcross(hint, interval.callClobbers))
+        hint = -1;
+    int physReg = allocatePhysReg(interval.callClobbers, hint);
     interval.physReg = physReg;
     result_.vregToPhys[interval.vreg] = physReg;
     insertActiveInterval(&interval);
 }
 
 /**
- * @brief 溢出处理：将当前区间或 active 中结束最晚的区间溢出到栈
+ * @brief 区间接过在它的定义处结束的区间的寄存器
+ * @details 区间始于指令 I 的 def 位置、另一区间恰好结束于 I 的 use 位置时，两者只在 I 上重叠
+ *   （I 先读操作数再写结果，代码生成对 def 与操作数同寄存器的情况都是安全的），可以共用寄存器。
+ *   只在这样能省掉 mv 时这样做：I 是 %d = copy %s 时取 %s 的寄存器（拷贝成为 mv r, r，不输出），
+ *   否则取调用约定偏好（如 call 的结果接过在调用处结束的 a0 参数）。
+ *   被接过的区间提前移出 active；预绑定的参数区间（physReg 为 -1）以 vregToPhys 为准。
+ *   跨越调用的区间只接过能原样跨越这些调用的寄存器，与 allocatePhysReg 的偏好一致
+ */
+bool LinearScanAllocator::takeDyingReg(LiveInterval &interval) {
+    auto regOf = [&](int vreg) {
+        auto phys = result_.vregToPhys.find(vreg);
+        return phys != result_.vregToPhys.end() ? phys->second : -1;
+    };
+    int start = interval.start();
+    if (start % 2 != 0 || static_cast<size_t>(start / 2) >= copySource_.size())
+        return false;
+    int src = copySource_[start / 2];
+    int reg = src >= 0 ? regOf(src) : hints_[interval.vreg].reg;
+    if (reg < 0 || (interval.crossesCall && !preservedAcross(reg, interval.callClobbers)))
+        return false;
+    auto it = std::find_if(active_.begin(), active_.end(), [&](const LiveInterval *iv) {
+        return iv->end() == start + 1 && (iv->physReg >= 0 ? iv->physReg : regOf(iv->vreg)) == reg;
+    });
+    if (it == active_.end())
+        return false;
+    active_.erase(it);
+
+    interval.physReg = reg;
+    result_.vregToPhys[interval.vreg] = reg;
+    insertActiveInterval(&interval);
+    return true;
+}
+
+/**
+ * @brief 溢出处理：将当前区间或 active 中最适合溢出的区间溢出到栈
  * @param interval 当前要分配的区间
- * @details 如果 active 中有结束位置比当前区间更晚的，则溢出该区间，
- *          将其物理寄存器转给当前区间；否则直接溢出当前区间
+ * @details 溢出代价为区间权重，收益为释放的寄存器在当前位置之后还要被占用的长度，
+ *   因此按 权重 / 剩余跨度 比较（相同时取结束最晚的；没有循环时即经典的"溢出结束最晚者"）。
+ *   active 中比值最小的区间若比当前区间更适合溢出，则溢出它并把物理寄存器转给当前区间；
+ *   否则直接溢出当前区间。被溢出区间的权重计入 spillCost。
+ *   预绑定的参数区间不参与换出（-O1 起参数不再先存入栈槽，可能活跃到函数末尾）
  */
 void LinearScanAllocator::spillAtInterval(LiveInterval &interval) {
-    if (!active_.empty()) {
-        auto spillIt =
-            std::max_element(active_.begin(), active_.end(),
-                             [](LiveInterval *a, LiveInterval *b) { return a->end() < b->end(); });
+    // cheaper：a 是否比 b 更适合溢出
+    const int cur = interval.start();
+    auto cheaper = [cur](const LiveInterval *a, const LiveInterval *b) {
+        // 比较 weight / 剩余跨度（交叉相乘，避免浮点）
+        uint64_t lhs = a->weight * static_cast<uint64_t>(b->end() - cur + 1);
+        uint64_t rhs = b->weight * static_cast<uint64_t>(a->end() - cur + 1);
+        return lhs != rhs ? lhs < rhs : a->end() > b->end();
+    };
+    // 预绑定到 a0-a7 的参数区间（physReg 为 -1，值只在参数寄存器中）不能被换出
+    auto spillIt = active_.end();
+    for (auto it = active_.begin(); it != active_.end(); ++it)
+        if ((*it)->physReg >= 0 && (spillIt == active_.end() || cheaper(*it, *spillIt)))
+            spillIt = it;
+    if (spillIt != active_.end()) {
         LiveInterval *spill = *spillIt;
 
-        if (spill->end() > interval.end()) {
+        if (cheaper(spill, &interval)) {
             int physReg = spill->physReg;
 
             spill->physReg = -1;
-            spill->spillSlot = allocateSpillSlot();
+            spill->spillSlot = spillSlotFor(*spill);
             result_.vregToPhys.erase(spill->vreg);
             result_.vregToStack[spill->vreg] = spill->spillSlot;
+            result_.spillCost += spill->weight;
+            logSpill(
+                {spill->vreg, SpillReason::Evicted, round_, cur, spill->weight, interval.vreg});
 
             active_.erase(spillIt);
 
@@ -551,19 +1055,33 @@ void LinearScanAllocator::spillAtInterval(LiveInterval &interval) {
         }
     }
     // 直接溢出当前 interval
-    interval.spillSlot = allocateSpillSlot();
+    interval.spillSlot = spillSlotFor(interval);
     result_.vregToStack[interval.vreg] = interval.spillSlot;
+    result_.spillCost += interval.weight;
+    logSpill({interval.vreg, SpillReason::NoFreeReg, round_, cur, interval.weight, -1});
 }
 
 // allocateSpillSlot：分配一个新的溢出栈槽（每次 -4 字节）
 int LinearScanAllocator::allocateSpillSlot() { return -(++nextSpillSlot_) * 4; }
 
-// allocatePhysReg：从空闲池中取出优先级最高的寄存器
-int LinearScanAllocator::allocatePhysReg() {
+// allocatePhysReg：hint 空闲时取 hint，否则从空闲池中取出优先级最高的寄存器；
+// clobbers 非零（区间跨越调用）时先找能原样跨越这些调用的寄存器——按 ABI 即 s1-s11，
+// 跨越调用的值放在其中只需在序言 / 尾声各保存恢复一次，而不是在每个调用点；
+// 过程间分配时被调函数不改写的调用者保存寄存器优先级更高，连序言中的保存也省掉
+int LinearScanAllocator::allocatePhysReg(RegMask clobbers, int hint) {
     if (freePhysRegs_.empty())
         return -1;
-    int reg = *freePhysRegs_.begin();
-    freePhysRegs_.erase(freePhysRegs_.begin());
+    auto it = hint >= 0 ? freePhysRegs_.find(hint) : freePhysRegs_.end();
+    if (it == freePhysRegs_.end())
+        it = freePhysRegs_.begin();
+    if (clobbers && !preservedAcross(*it, clobbers)) {
+        auto kept = std::find_if(freePhysRegs_.begin(), freePhysRegs_.end(),
+                                 [&](int r) { return preservedAcross(r, clobbers); });
+        if (kept != freePhysRegs_.end())
+            it = kept;
+    }
+    int reg = *it;
+    freePhysRegs_.erase(it);
     isPhysRegUsed_[reg] = true;
     return reg;
 }
@@ -574,10 +1092,13 @@ void LinearScanAllocator::freePhysReg(int physId) {
         freePhysRegs_.insert(physId);
 }
 
-// sortIntervalsByStart：按起始位置升序排序区间列表
+// sortIntervalsByStart：按起始位置升序排序区间列表（起点相同时按 vreg，保证结果确定）
 void LinearScanAllocator::sortIntervalsByStart(std::vector<LiveInterval *> &intervals) {
-    std::sort(intervals.begin(), intervals.end(),
-              [](LiveInterval *a, LiveInterval *b) { return a->start() < b->start(); });
+    std::sort(intervals.begin(), intervals.end(), [](LiveInterval *a, LiveInterval *b) {
+        if (a->start() != b->start())
+            return a->start() < b->start();
+        return a->vreg < b->vreg;
+    });
 }
 
 // insertActiveInterval：按结束位置有序插入 active_ 列表
@@ -588,17 +1109,6 @@ void LinearScanAllocator::insertActiveInterval(LiveInterval *interval) {
     active_.insert(it, interval);
 }
 
-// allocateSpillTempReg：交替返回 t0/t1 作为溢出临时寄存器
-int LinearScanAllocator::allocateSpillTempReg() {
-    spillTempCounter_ = !spillTempCounter_;
-    return spillTempCounter_ ? spillTempReg1_ : spillTempReg2_;
-}
-
-// isSpillTempReg：判断是否为溢出临时寄存器
-bool LinearScanAllocator::isSpillTempReg(int regId) const {
-    return regId == spillTempReg1_ || regId == spillTempReg2_;
-}
-
 // getUsedPhysRegs：收集实际使用过的物理寄存器集合
 std::set<int> LinearScanAllocator::getUsedPhysRegs() const {
     std::set<int> used;
@@ -617,21 +1127,15 @@ std::set<int> LinearScanAllocator::getCalleeSavedRegs() const {
     return callee;
 }
 
-// dumpIntervals：调试输出所有活跃区间信息
-void LinearScanAllocator::dumpIntervals(
-    const std::unordered_map<int, std::unique_ptr<LiveInterval>> &intervals) {
+// dumpIntervals：调试输出所有活跃区间信息（按 vreg 升序）
+void LinearScanAllocator::dumpIntervals(const LiveIntervalTable &intervals) {
     *debugOutput_ << "=== Live Intervals ===\n";
-    std::vector<int> vregs;
-    for (auto &[v, _] : intervals)
-        vregs.push_back(v);
-    std::sort(vregs.begin(), vregs.end());
-    for (int v : vregs) {
-        auto &iv = intervals.at(v);
-        *debugOutput_ << "  %vreg" << v << ": ";
-        for (auto &r : iv->ranges)
+    intervals.forEach([&](const LiveInterval &iv) {
+        *debugOutput_ << "  %vreg" << iv.vreg << ": ";
+        for (auto &r : iv.ranges)
             *debugOutput_ << "[" << r.start << ", " << r.end << ") ";
         *debugOutput_ << "\n";
-    }
+    });
 }
 
 #pragma endregion
@@ -0,0 +1,109 @@
+#include "reg_alloc.h"
+#include "statistics.h"
+#include <algorithm>
+#include <map>
+#include <optional>
+
+namespace toyc {
+
+using namespace ir;
+
+namespace {
+
+// ConstLattice：vreg 的常量格值（未定 → 常量 → 非常量）
+struct ConstLattice {
+    enum State : uint8_t { Unknown, Constant, Varying } state = Unknown;
+    int value = 0;
+
+    // meet：并入一个 def 的格值，返回是否变化
+    bool meet(const ConstLattice &other) {
+        if (other.state == Unknown || state == Varying)
+            return false;
+        if (state == Constant && other.state == Constant && other.value == value)
+            return false;
+        if (state == Unknown && other.state == Constant) {
+            state = Constant;
+            value = other.value;
+        } else {
+            state = Varying;
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief 求只持有一个常量的 vreg
+ * @details 乐观迭代：def 为常量的 copy 时取该常量，为 vreg 的 copy 时取来源的格值，其余 def 与参数
+ *   （入口处隐式定义）为非常量。区间分裂把 %x = copy 0 的活跃区间拆成多个片段，片段之间互相拷贝，
+ *   它们同样只持有这个常量
+ */
+std::unordered_map<int, ConstLattice> constantVregs(const Function &F) {
+    std::unordered_map<int, ConstLattice> lattice;
+    for (int vreg : F.paramVregs)
+        lattice[vreg].state = ConstLattice::Varying;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const auto &bb : F.blocks)
+            for (const Instruction *inst : bb->insts) {
+                const int def = inst->defReg();
+                if (def < 0)
+                    continue;
+                ConstLattice in;
+                const Operand *src = inst->opcode == Opcode::Copy ? &inst->ops[0] : nullptr;
+                if (src && (src->isImm() || src->isBoolLit())) {
+                    in.state = ConstLattice::Constant;
+                    in.value = src->isImm() ? src->immValue() : src->boolValue() ? 1 : 0;
+                } else if (src && src->isVReg()) {
+                    auto it = lattice.find(src->regId());
+                    if (it != lattice.end())
+                        in = it->second;
+                } else {
+                    in.state = ConstLattice::Varying;
+                }
+                changed |= lattice[def].meet(in);
+            }
+    }
+    return lattice;
+}
+
+} // namespace
+
+/**
+ * @brief 常量重物化
+ * @details 溢出栈槽按槽分组（分裂片段与其根 vreg、图着色合并的 vreg 共用一个槽）：组内每个 vreg
+ *   都只持有同一个常量（-O1 起 phi 消除产生的 %x = copy 0 及其分裂片段之类）时，整组改为重物化——
+ *   从 vregToStack 移到 rematValues。代码生成在每个 use 处用 li 把常量装入溢出临时寄存器，def 处
+ *   不再写回栈槽，栈槽本身也随之消失
+ */
+int rematerializeConstants(const Function &F, AllocationResult &result) {
+    std::map<int, std::vector<int>> bySlot; // 栈槽 → 使用它的 vreg
+    for (auto [vreg, slot] : result.vregToStack)
+        if (slot < 0)
+            bySlot[slot].push_back(vreg);
+    if (bySlot.empty())
+        return 0;
+
+    const auto lattice = constantVregs(F);
+    int count = 0;
+    for (const auto &[slot, vregs] : bySlot) {
+        auto valueOf = [&](int vreg) {
+            auto it = lattice.find(vreg);
+            return it != lattice.end() && it->second.state == ConstLattice::Constant
+                       ? std::optional<int>(it->second.value)
+                       : std::nullopt;
+        };
+        const std::optional<int> value = valueOf(vregs.front());
+        if (!value || !std::all_of(vregs.begin(), vregs.end(),
+                                   [&](int vreg) { return valueOf(vreg) == value; }))
+            continue;
+        for (int vreg : vregs) {
+            result.vregToStack.erase(vreg);
+            result.rematValues[vreg] = *value;
+        }
+        ++count;
+    }
+    stats::add(stats::Counter::Rematerialized, static_cast<uint64_t>(count));
+    return count;
+}
+
+} // namespace toyc
@@ -1,103 +1,493 @@
 #include "riscv_codegen.h"
+#include "codegen_cache.h"
+#include "elf_writer.h"
+#include "ir_analysis.h"
+#include "statistics.h"
+#include "thread_pool.h"
 #include <algorithm>
+#include <condition_variable>
+#include <exception>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <set>
 #include <sstream>
+#include <stdexcept>
 
 
 namespace toyc {
 
 using namespace ir;
+using mir::MachineInstr;
+using mir::MOpcode;
+
+// 常用物理寄存器编号
+static constexpr int REG_ZERO = 0, REG_SP = 2, REG_T0 = 5, REG_T1 = 6, REG_S0 = 8, REG_A0 = 10;
 
 #pragma region 构造与便捷函数
 
-RISCVCodeGen::RISCVCodeGen() {}
+RISCVCodeGen::RISCVCodeGen(unsigned numThreads)
+    : regInfo_(&RegInfo::shared()), numThreads_(std::max(1u, numThreads)) {}
+
+RISCVCodeGen::RISCVCodeGen(ThreadPool &pool)
+    : regInfo_(&RegInfo::shared()), numThreads_(pool.size()), pool_(&pool) {}
 
 // generateRISCVAssembly：便捷入口，封装 RISCVCodeGen 对象的创建和调用
-std::string generateRISCVAssembly(Module &module) {
-    RISCVCodeGen gen;
+std::string generateRISCVAssembly(Module &module, unsigned numThreads, CodeGenCache *cache,
+                                  RegAllocKind regAlloc, bool profileGenerate,
+                                  const mir::LatencyModel *schedModel, bool compressed,
+                                  bool ipra, bool omitFramePointer) {
+    RISCVCodeGen gen(numThreads);
+    gen.setCache(cache);
+    gen.setRegAlloc(regAlloc);
+    if (schedModel)
+        gen.setSchedule(*schedModel);
+    gen.setCompressed(compressed);
+    gen.setOmitFramePointer(omitFramePointer);
+    gen.setIPRA(ipra);
+    gen.setProfileGenerate(profileGenerate);
     return gen.generate(module);
 }
 
+// generateRISCVAssembly：便捷入口（流式版本）
+void generateRISCVAssembly(Module &module, std::ostream &os, unsigned numThreads,
+                           CodeGenCache *cache, RegAllocKind regAlloc, bool profileGenerate,
+                           const mir::LatencyModel *schedModel, bool compressed, bool ipra,
+                           bool omitFramePointer) {
+    RISCVCodeGen gen(numThreads);
+    gen.setCache(cache);
+    gen.setRegAlloc(regAlloc);
+    if (schedModel)
+        gen.setSchedule(*schedModel);
+    gen.setCompressed(compressed);
+    gen.setOmitFramePointer(omitFramePointer);
+    gen.setIPRA(ipra);
+    gen.setProfileGenerate(profileGenerate);
+    gen.generate(module, os);
+}
+
+// generateRISCVObject：便捷入口，生成 ELF32 可重定位目标文件
+void generateRISCVObject(Module &module, std::ostream &os, unsigned numThreads,
+                         CodeGenCache *cache, RegAllocKind regAlloc,
+                         const mir::LatencyModel *schedModel, bool compressed, bool ipra,
+                         bool omitFramePointer) {
+    RISCVCodeGen gen(numThreads);
+    gen.setCache(cache);
+    gen.setRegAlloc(regAlloc);
+    if (schedModel)
+        gen.setSchedule(*schedModel);
+    gen.setCompressed(compressed);
+    gen.setOmitFramePointer(omitFramePointer);
+    gen.setIPRA(ipra);
+    gen.generateObject(module, os);
+}
+
+// generateRISCVAssembly：便捷入口（逐函数加载的流水线版本）
+void generateRISCVAssembly(size_t numFunctions, const FunctionLoader &load, std::ostream &os,
+                           unsigned numThreads, CodeGenCache *cache, RegAllocKind regAlloc,
+                           bool profileGenerate, const mir::LatencyModel *schedModel,
+                           bool compressed, bool omitFramePointer) {
+    RISCVCodeGen gen(numThreads);
+    gen.setCache(cache);
+    gen.setRegAlloc(regAlloc);
+    if (schedModel)
+        gen.setSchedule(*schedModel);
+    gen.setCompressed(compressed);
+    gen.setOmitFramePointer(omitFramePointer);
+    gen.setProfileGenerate(profileGenerate);
+    gen.generate(numFunctions, load, os);
+}
+
+// generateRISCVObject：便捷入口（逐函数加载的流水线版本）
+void generateRISCVObject(size_t numFunctions, const FunctionLoader &load, std::ostream &os,
+                         unsigned numThreads, CodeGenCache *cache, RegAllocKind regAlloc,
+                         const mir::LatencyModel *schedModel, bool compressed,
+                         bool omitFramePointer) {
+    RISCVCodeGen gen(numThreads);
+    gen.setCache(cache);
+    gen.setRegAlloc(regAlloc);
+    if (schedModel)
+        gen.setSchedule(*schedModel);
+    gen.setCompressed(compressed);
+    gen.setOmitFramePointer(omitFramePointer);
+    gen.generateObject(numFunctions, load, os);
+}
+
 #pragma endregion
 
-#pragma region 主入口与函数级生成
+#pragma region 过程间寄存器分配
 
 /**
- * @brief 生成整个 IR 模块的 RISC-V 汇编
- * @param module IR 模块
- * @return 完整的汇编文本
- * @details 流程：预计算寄存器分配 → 逐函数生成汇编
+ * @brief 机器函数可能改写的调用者保存寄存器
+ * @details 函数体内写入的寄存器，加上 call / tail 目标发布的掩码（未发布时按 ABI）与剖析计数器
+ *   使用的 t0 / t1；对调用者而言，这就是调用这个函数会破坏的寄存器
  */
-std::string RISCVCodeGen::generate(Module &module) {
-    output_.clear();
-    output_ += "    .text\n";
+static RegMask clobberedRegs(const mir::MachineFunction &MF, const RegUsageInfo &usage) {
+    RegMask mask = 0;
+    for (const auto &MBB : MF.blocks) {
+        for (const MachineInstr &MI : MBB.insts) {
+            if (MI.rd >= 0 && !MI.definesVectorReg())
+                mask |= regBit(MI.rd);
+            if (MI.opcode == MOpcode::CALL || MI.opcode == MOpcode::TAIL)
+                mask |= usage.clobbers(MI.sym);
+            else if (MI.opcode == MOpcode::ProfCount)
+                mask |= regBit(REG_T0) | regBit(REG_T1);
+        }
+    }
+    return mask & usage.abiMask();
+}
 
-    precomputeAllocations(module);
+// calleeMasks：函数调用的各个被调函数及其当前掩码（按首次出现的顺序），写入缓存键
+static std::string calleeMasks(const Function &func, const RegUsageInfo &usage) {
+    std::string text;
+    std::set<uint32_t> seen;
+    for (const auto &bb : func.blocks)
+        for (const Instruction *inst : bb->insts)
+            if (inst->isCallInst() && seen.insert(inst->callee.id()).second)
+                text += inst->callee.str() + "=" + std::to_string(usage.clobbers(inst->callee)) +
+                        " ";
+    return text;
+}
 
-    for (auto &func : module.functions)
-        generateFunction(*func);
+#pragma endregion
 
-    return output_;
+#pragma region 主入口
+
+/**
+ * @brief 生成整个 IR 模块的机器代码
+ * @param module   IR 模块
+ * @param consumer 每个函数的 MachineFunction 完成（栈帧已展开）后按模块中的顺序回调
+ */
+void RISCVCodeGen::generateMachineCode(Module &module, const MachineFunctionConsumer &consumer) {
+    if (ipra_) {
+        generateBottomUp(module, consumer);
+        return;
+    }
+    runPipeline(
+        module.functions.size(),
+        [&](size_t i) { return compileFunction(*module.functions[i]); }, consumer);
 }
 
-// precomputeAllocations：对每个函数进行线性扫描寄存器分配，结果缓存到 funcAllocators_
-void RISCVCodeGen::precomputeAllocations(Module &module) {
-    funcAllocators_.clear();
-    for (auto &func : module.functions) {
-        auto allocator = std::make_unique<LinearScanAllocator>(regInfo_);
-        allocator->allocate(*func);
-        funcAllocators_[func->name] = std::move(allocator);
+/**
+ * @brief 过程间寄存器分配（-fipra）：按调用图自底向上分层编译，再按模块顺序交给 consumer
+ * @details 叶函数所在的强连通分量为第 0 层，其余分量的层号 = 1 + 它调用的其他分量的最大层号。
+ *   同一层的函数互不调用（同一递归分量内部的调用按 ABI 处理），可以并行编译；一层全部完成后
+ *   才发布这一层的寄存器掩码，因此结果与线程数无关。编译完的机器函数先暂存，
+ *   全部完成后按模块中的函数顺序交给 consumer
+ */
+void RISCVCodeGen::generateBottomUp(Module &module, const MachineFunctionConsumer &consumer) {
+    const size_t n = module.functions.size();
+    std::vector<std::vector<size_t>> levels; // 层 → 函数下标（升序）
+    {
+        CallGraph graph(module);
+        const auto &sccs = graph.bottomUpSCCs();
+        std::unordered_map<const Function *, size_t> index, sccOf;
+        for (size_t i = 0; i < n; ++i)
+            index[module.functions[i].get()] = i;
+        std::vector<size_t> sccLevel(sccs.size(), 0);
+        for (size_t c = 0; c < sccs.size(); ++c) {
+            for (const Function *F : sccs[c])
+                sccOf[F] = c;
+            for (const Function *F : sccs[c])
+                for (const Function *callee : graph.callees(F))
+                    if (sccOf[callee] != c)
+                        sccLevel[c] = std::max(sccLevel[c], sccLevel[sccOf[callee]] + 1);
+            if (levels.size() <= sccLevel[c])
+                levels.resize(sccLevel[c] + 1);
+            for (const Function *F : sccs[c])
+                levels[sccLevel[c]].push_back(index.at(F));
+        }
+        for (auto &level : levels)
+            std::sort(level.begin(), level.end());
+    }
+
+    RegUsageInfo usage(*regInfo_);
+    std::vector<std::optional<mir::MachineFunction>> results(n);
+    for (const std::vector<size_t> &level : levels) {
+        size_t next = 0;
+        runPipeline(
+            level.size(),
+            [&](size_t k) { return compileFunction(*module.functions[level[k]], &usage); },
+            [&](const mir::MachineFunction &MF) { results[level[next++]] = MF; });
+        for (size_t i : level)
+            usage.publish(Symbol(results[i]->name), clobberedRegs(*results[i], usage));
     }
+    for (const auto &MF : results)
+        consumer(*MF);
 }
 
-// resetFunctionState：重置每个函数的运行时状态
-void RISCVCodeGen::resetFunctionState() {
-    allocaOffsets_.clear();
-    cmpMap_.clear();
-    stackOffset_ = 0;
-    totalStackSize_ = 0;
-    frameOverhead_ = 0;
-    callSaveSize_ = 0;
-    callArgAreaSize_ = 0;
-    hasReturn_ = false;
+/**
+ * @brief 逐函数加载并生成机器代码（解析 → 分配 → 输出流水线）
+ * @param numFunctions 函数个数
+ * @param load         按下标加载第 i 个函数（可以在此时才解析 / 解码）
+ * @param consumer     同上
+ * @details 每个函数在编译它的任务中才被加载，编译完成后立即释放，
+ *   因此任何时刻驻留的 IR 函数不超过正在编译的函数个数
+ */
+void RISCVCodeGen::generateMachineCode(size_t numFunctions, const FunctionLoader &load,
+                                       const MachineFunctionConsumer &consumer) {
+    runPipeline(
+        numFunctions,
+        [&](size_t i) {
+            std::unique_ptr<Function> func = load(i);
+            return compileFunction(*func);
+        },
+        consumer);
 }
 
 /**
- * @brief 生成单个函数的完整汇编
- * @details 流程：
- *   1. .globl + 函数标签
- *   2. Prologue 占位符
- *   3. 遍历所有基本块，生成标签和指令
- *   4. 计算栈帧大小，替换 prologue/epilogue 占位符
- *   5. 输出 .size 指令
+ * @brief 按下标编译 n 个函数，并按下标顺序交给 consumer
+ * @param n        函数个数
+ * @param compile  编译第 i 个函数（不访问共享可变状态）
+ * @param consumer 同上
+ * @details 串行模式：逐函数 compile → consumer。
+ *   并行模式：函数作为任务提交到线程池（外部传入或自建），调用线程按原始顺序等待第 i 个
+ *   函数完成后交给 consumer，因此输出与串行模式逐字节相同；等待期间调用线程从线程池中取任务
+ *   帮忙执行，只有当所有队列都为空（第 i 个函数正在其他线程上运行）时才阻塞。
+ *   已提交但尚未交给 consumer 的函数最多为线程数的两倍：既让工作线程不断粮，
+ *   又不会让先完成的 MachineFunction 在等待前面的函数时无限堆积。
+ *   各函数只读共享 regInfo_，其余状态均在各自的上下文中。
+ *   任一函数抛出异常时，在调用线程上按函数顺序重新抛出
+ */
+void RISCVCodeGen::runPipeline(size_t n,
+                               const std::function<mir::MachineFunction(size_t)> &compile,
+                               const MachineFunctionConsumer &consumer) {
+    if (numThreads_ <= 1 || n <= 1) {
+        for (size_t i = 0; i < n; ++i)
+            consumer(compile(i));
+        return;
+    }
+
+    struct Slot {
+        std::optional<mir::MachineFunction> result;
+        std::exception_ptr error;
+        bool done = false;
+    };
+    std::vector<Slot> slots(n);
+    std::mutex mu;
+    std::condition_variable cv;
+    size_t running = 0; // 已提交但尚未完成的任务数（受 mu 保护）
+
+    // 自建线程池最后构造、最先析构：离开作用域（含异常路径）时先等待所有任务结束
+    std::optional<ThreadPool> ownPool;
+    if (!pool_)
+        ownPool.emplace(static_cast<unsigned>(std::min<size_t>(numThreads_, n)));
+    ThreadPool &pool = pool_ ? *pool_ : *ownPool;
+    const size_t window = 2 * std::max(1u, pool.size()); // 在途（已提交未消费）函数上限
+    size_t submitted = 0;
+
+    auto submitNext = [&] {
+        const size_t i = submitted++;
+        {
+            std::lock_guard lock(mu);
+            ++running;
+        }
+        pool.submit([&, i] {
+            Slot local;
+            try {
+                local.result = compile(i);
+            } catch (...) {
+                local.error = std::current_exception();
+            }
+            // 持锁通知：等待方一旦看到 running == 0 就可能返回并销毁 cv
+            std::lock_guard lock(mu);
+            slots[i].result = std::move(local.result);
+            slots[i].error = local.error;
+            slots[i].done = true;
+            --running;
+            cv.notify_all();
+        });
+    };
+
+    // helpUntil：等待 ready()（在 mu 下求值）成立，期间帮忙执行线程池任务；
+    // 所有队列为空时剩余任务都已在其他线程上运行，此时才阻塞等待
+    auto helpUntil = [&](auto ready) {
+        for (;;) {
+            {
+                std::lock_guard lock(mu);
+                if (ready())
+                    return;
+            }
+            if (!pool.tryRunPendingTask()) {
+                std::unique_lock lock(mu);
+                cv.wait(lock, ready);
+                return;
+            }
+        }
+    };
+
+    // 任务引用本栈帧上的 slots：无论正常结束还是异常退出，都要等所有任务结束后才能返回
+    struct DrainGuard {
+        std::function<void()> drain;
+        ~DrainGuard() { drain(); }
+    } guard{[&] { helpUntil([&] { return running == 0; }); }};
+
+    for (size_t i = 0; i < n; ++i) {
+        while (submitted < n && submitted < i + window)
+            submitNext();
+        helpUntil([&] { return slots[i].done; });
+        std::optional<mir::MachineFunction> MF;
+        {
+            std::lock_guard lock(mu);
+            if (slots[i].error)
+                std::rethrow_exception(slots[i].error);
+            MF = std::move(slots[i].result);
+            slots[i].result.reset();
+        }
+        consumer(*MF);
+    }
+}
+
+/**
+ * @brief 生成整个 IR 模块的 RISC-V 汇编
+ * @param module IR 模块
+ * @param os     输出流（每个函数完成后立即写入）
  */
-void RISCVCodeGen::generateFunction(Function &func) {
-    resetFunctionState();
-    currentFunction_ = func.name;
-    isMainFunction_ = (func.name == "main");
+void RISCVCodeGen::generate(Module &module, std::ostream &os) {
+    AsmEmitter emitter(os);
+    emitter.directive(".text");
+    if (compressed_)
+        emitter.directive(".option rvc");
+    mir::AsmPrinter printer(emitter, compressed_);
+    generateMachineCode(module,
+                        [&](const mir::MachineFunction &MF) { printer.printFunction(MF); });
+}
 
-    // 预计算帧开销（ra + s0 + callee-saved），供 alloca 偏移使用
-    auto &alloc = funcAllocators_[currentFunction_]->getAllocationResult();
-    int calleeSavedCount = static_cast<int>(alloc.calleeSavedRegs.size());
-    frameOverhead_ = 8 + calleeSavedCount * 4;
+// generate：逐函数加载并生成汇编（流水线版本，输出与整模块版本相同）
+void RISCVCodeGen::generate(size_t numFunctions, const FunctionLoader &load, std::ostream &os) {
+    AsmEmitter emitter(os);
+    emitter.directive(".text");
+    if (compressed_)
+        emitter.directive(".option rvc");
+    mir::AsmPrinter printer(emitter, compressed_);
+    generateMachineCode(numFunctions, load,
+                        [&](const mir::MachineFunction &MF) { printer.printFunction(MF); });
+}
 
-    // 预计算函数调用时 caller-saved 保存区大小
-    {
-        std::set<int> csRegs;
-        for (auto &[vreg, physReg] : alloc.vregToPhys) {
-            if (regInfo_.isCallerSaved(physReg) &&
-                !funcAllocators_[currentFunction_]->isSpillTempReg(physReg))
-                csRegs.insert(physReg);
+// generate：生成整个模块的汇编文本（内部使用字符串流）
+std::string RISCVCodeGen::generate(Module &module) {
+    std::ostringstream oss;
+    generate(module, oss);
+    return oss.str();
+}
+
+/**
+ * @brief 生成整个 IR 模块的 ELF32 可重定位目标文件（不经过汇编文本）
+ * @param module IR 模块
+ * @param os     输出流（二进制）
+ * @details 各函数编码进同一个 .text，模块结束后一次性写出 ELF
+ *   立即数越界等无法编码的情况抛出 std::runtime_error
+ */
+void RISCVCodeGen::generateObject(Module &module, std::ostream &os) {
+    ELFObjectWriter writer(compressed_);
+    generateMachineCode(module,
+                        [&](const mir::MachineFunction &MF) { writer.addFunction(MF); });
+    writer.write(os);
+}
+
+// generateObject：逐函数加载并生成 ELF32 目标文件（流水线版本）
+void RISCVCodeGen::generateObject(size_t numFunctions, const FunctionLoader &load,
+                                  std::ostream &os) {
+    ELFObjectWriter writer(compressed_);
+    generateMachineCode(numFunctions, load,
+                        [&](const mir::MachineFunction &MF) { writer.addFunction(MF); });
+    writer.write(os);
+}
+
+// compileFunction：寄存器分配（按 regAlloc_ 选择算法）+ 指令选择（分配器与上下文均为本函数私有）
+// 启用缓存时以函数内容（-fipra 时加上被调函数的寄存器掩码）为键查找，命中则直接返回缓存的
+// 机器函数（栈帧已展开）。带向量化描述的内核直接由 generateVectorKernel 生成
+mir::MachineFunction RISCVCodeGen::compileFunction(Function &func,
+                                                   const RegUsageInfo *usage) const {
+    if (stats::enabled()) {
+        size_t numInsts = 0;
+        for (const auto &bb : func.blocks)
+            numInsts += bb->insts.size();
+        stats::add(stats::Counter::Functions);
+        stats::add(stats::Counter::IRInstructions, numInsts);
+    }
+    if (func.vectorKernel)
+        return generateVectorKernel(func, *regInfo_);
+    std::optional<CodeGenCache::Key> key;
+    if (cache_) {
+        key = cache_->key(func, usage ? calleeMasks(func, *usage) : std::string());
+        if (auto cached = cache_->lookup(*key)) {
+            stats::add(stats::Counter::CacheHits);
+            return std::move(*cached);
         }
-        callSaveSize_ = static_cast<int>(csRegs.size()) * 4;
+        stats::add(stats::Counter::CacheMisses);
     }
+    std::unique_ptr<RegisterAllocator> allocator = createRegisterAllocator(regAlloc_, *regInfo_);
+    allocator->setRegUsage(usage);
+    allocator->allocate(func);
+    // 发生区间分裂时，分配结果对应的是插入了分裂拷贝的函数副本
+    const Function &allocated = allocator->splitFunction() ? *allocator->splitFunction() : func;
+    FunctionCodeGen fgen(*regInfo_, *allocator, allocated, profileGenerate_,
+                         schedModel_ ? &*schedModel_ : nullptr);
+    mir::MachineFunction MF = fgen.run();
+    if (cache_)
+        cache_->store(*key, MF);
+    return MF;
+}
+
+#pragma endregion
+
+#pragma region 函数级生成
+
+FunctionCodeGen::FunctionCodeGen(const RegInfo &regInfo, RegisterAllocator &allocator,
+                                 const Function &func, bool instrument,
+                                 const mir::LatencyModel *schedModel)
+    : regInfo_(regInfo), allocator_(allocator), alloc_(allocator.getAllocationResult()),
+      func_(func), isMainFunction_(func.name == "main"), instrument_(instrument),
+      schedModel_(schedModel) {}
+
+/**
+ * @brief 生成单个函数的机器代码
+ * @details 流程：
+ *   1. 判断叶函数，预计算帧开销 / caller-saved 保存区 / 出栈参数区大小，布局局部变量并确定栈帧大小
+ *   2. 为每个 IR 基本块创建对应的机器基本块，入口处放置 FrameSetup 伪指令；标记融合比较；
+ *      插桩时每个块以 ProfCount 开头（入口块放在 prologue 之前，计数器编号 = 块下标），
+ *      有剖析数据时把各块的计数带给块布局
+ *   3. 逐条指令选择（每个 ret 前放置 FrameDestroy 伪指令）；标记为 tail 且紧跟返回其结果的
+ *      ret 的 call 与该 ret 一起生成为尾调用
+ *   4. 收缩包装（mir::shrinkWrap）后展开栈帧伪指令
+ *   5. 块布局与窥孔优化（mir::runPeephole），启用调度时再逐块调度（mir::scheduleBlocks）
+ *   6. 返回完整的机器函数（由调用方打印或编码）
+ */
+mir::MachineFunction FunctionCodeGen::run() {
+    stats::ScopedTimer timer(stats::Phase::InstSelect);
+    // 叶函数（除尾调用外没有 call）不改写 ra，不必保存；叶函数没有局部变量与栈传入参数时
+    // 也不需要帧指针（s0 仍保留不分配，不保存 / 设置即可）
+    bool leaf = true, hasStackData = false;
+    for (const auto &bb : func_.blocks)
+        for (size_t i = 0; i < bb->insts.size(); ++i) {
+            const Opcode op = bb->insts[i]->opcode;
+            if (op == Opcode::Call && !isTailCallSite(bb->insts, i))
+                leaf = false;
+            else if (op == Opcode::Alloca)
+                hasStackData = true;
+        }
+    for (const auto &[vreg, slot] : alloc_.vregToStack)
+        if (slot > 0)
+            hasStackData = true;
+    savesReturnAddress_ = !leaf;
+    usesFramePointer_ = regInfo_.hasFramePointer() && (!leaf || hasStackData);
+
+    // 预计算帧开销（ra + s0 + callee-saved，叶函数没有 ra，不用帧指针时没有 s0），供 alloca 偏移使用
+    int calleeSavedCount = static_cast<int>(alloc_.calleeSavedRegs.size());
+    frameOverhead_ =
+        (savesReturnAddress_ ? 4 : 0) + (usesFramePointer_ ? 4 : 0) + calleeSavedCount * 4;
+
+    // 预计算函数调用时 caller-saved 保存区大小（各调用点共用，取最大值）
+    callSaveSize_ = 0;
+    for (const auto &[call, regs] : alloc_.callSaves)
+        callSaveSize_ = std::max(callSaveSize_, static_cast<int>(regs.size()) * 4);
 
     // 预计算出栈参数区大小（超过 8 个参数的调用需要栈传参）
     {
         int maxStackArgs = 0;
-        for (auto &bb : func.blocks) {
-            for (auto &inst : bb->insts) {
+        for (auto &bb : func_.blocks) {
+            for (auto *inst : bb->insts) {
                 if (inst->opcode == ir::Opcode::Call) {
                     int extraArgs = std::max(0, static_cast<int>(inst->ops.size()) - 8);
                     maxStackArgs = std::max(maxStackArgs, extraArgs);
@@ -107,42 +497,161 @@ void RISCVCodeGen::generateFunction(Function &func) {
         callArgAreaSize_ = maxStackArgs * 4;
     }
 
-    output_ += "    .globl " + func.name + "\n";
-    output_ += func.name + ":\n";
+    // 局部变量不生成指令，先统一布局：指令选择开始前栈帧大小就已确定，
+    // 省略帧指针时局部变量与栈传入参数才能直接按 sp 寻址。栈槽着色为同一颜色的 alloca 共用
+    // 第一个的偏移
+    std::unordered_map<int, int> colorOffsets; // alloca 颜色 → 栈偏移
+    for (const auto &bb : func_.blocks)
+        for (const Instruction *inst : bb->insts) {
+            if (inst->opcode != Opcode::Alloca)
+                continue;
+            auto color = alloc_.allocaColors.find(inst->defReg());
+            if (color != alloc_.allocaColors.end()) {
+                auto shared = colorOffsets.find(color->second);
+                if (shared != colorOffsets.end()) {
+                    allocaOffsets_[inst->defReg()] = shared->second;
+                    continue;
+                }
+            }
+            genAlloca(*inst);
+            if (color != alloc_.allocaColors.end())
+                colorOffsets[color->second] = allocaOffsets_[inst->defReg()];
+        }
+    calculateStackFrame();
 
-    // Prologue 占位符
-    std::string prologuePlaceholder = "__PROLOGUE_PLACEHOLDER_" + func.name + "__";
-    output_ += prologuePlaceholder + "\n";
+    collectFusedCompares();
+
+    // 机器基本块与 IR 基本块一一对应（下标 = 块 ID）
+    mir::MachineFunction MF;
+    MF.name = func_.name;
+    MF.blocks.resize(func_.blocks.size());
+    for (size_t bi = 0; bi < func_.blocks.size(); ++bi)
+        MF.blocks[bi].label = "." + func_.name + "_" + func_.blocks[bi]->name;
+    if (std::any_of(func_.blocks.begin(), func_.blocks.end(),
+                    [](const auto &bb) { return bb->profileCount >= 0; }))
+        for (const auto &bb : func_.blocks)
+            MF.blockCounts.push_back(bb->profileCount);
+    Symbol counters;
+    if (instrument_)
+        counters = Symbol(mir::profileCounterLabel(func_.name));
+
+    for (size_t bi = 0; bi < func_.blocks.size(); ++bi) {
+        currentMBB_ = &MF.blocks[bi];
+        if (instrument_) {
+            emit(MachineInstr::profCount(counters, static_cast<int>(bi)));
+            MF.profileBlocks.push_back(func_.blocks[bi]->name);
+        }
+        if (bi == 0) {
+            emit(MachineInstr::pseudo(MOpcode::FrameSetup));
+            genParamMoves();
+        }
+        const auto &insts = func_.blocks[bi]->insts;
+        for (size_t i = 0; i < insts.size(); ++i) {
+            const Instruction &inst = *insts[i];
+            if (inst.opcode == Opcode::Call && isTailCallSite(insts, i)) {
+                genTailCall(inst);
+                ++i; // ret 由被调函数完成
+                continue;
+            }
+            generateInst(inst);
+        }
+    }
+    currentMBB_ = nullptr;
+
+    // 展开 prologue/epilogue 伪指令
+    MF.frameSize = totalStackSize_;
+    MF.calleeSavedRegs.assign(alloc_.calleeSavedRegs.begin(), alloc_.calleeSavedRegs.end());
+    MF.framePointer = usesFramePointer_;
+    MF.savesReturnAddress = savesReturnAddress_;
+    if (totalStackSize_ == 0)
+        stats::add(stats::Counter::FramelessLeaves);
+    mir::shrinkWrap(MF);
+    mir::expandFramePseudos(MF);
+    mir::runPeephole(MF);
+    if (schedModel_)
+        mir::scheduleBlocks(MF, *schedModel_);
+    if (stats::enabled()) {
+        size_t numInsts = 0;
+        for (const auto &MBB : MF.blocks)
+            numInsts += MBB.insts.size();
+        stats::add(stats::Counter::MachineInsts, numInsts);
+    }
+    return MF;
+}
 
-    // 遍历所有基本块
-    for (size_t bi = 0; bi < func.blocks.size(); ++bi) {
-        auto &bb = func.blocks[bi];
-        if (bi > 0) {
-            output_ += "." + func.name + "_" + bb->name + ":\n";
+/**
+ * @brief 标记融合比较
+ * @details icmp 的结果在整个函数中只被紧随其后的 br i1 读取时，比较值不必落到寄存器里：
+ *   genICmp 跳过它，genCondBr 在分支处解析两个操作数直接生成 blt/bge/beq 等。
+ *   该 icmp 是 icmp eq|ne %c, 0、而 %c 又是紧挨在前、只被它读取的 icmp 时（! 作用在比较上），
+ *   两条都跳过，分支按 %c 的谓词（eq 时取反）比较 %c 的操作数。
+ *   被跳过的指令之间没有任何写寄存器的指令，操作数在分支处仍在原来的位置；
+ *   在 IR 上判定，分配器插入的拷贝或区间分裂打断相邻关系时自然退回普通比较
+ */
+void FunctionCodeGen::collectFusedCompares() {
+    const DefUseChains chains(func_);
+    for (const auto &bb : func_.blocks) {
+        const auto &insts = bb->insts;
+        const size_t n = insts.size();
+        if (n < 2)
+            continue;
+        const Instruction *cmp = insts[n - 2];
+        int cond = insts.back()->branchCondReg();
+        if (cond < 0 || cmp->opcode != Opcode::ICmp || cmp->defReg() != cond ||
+            chains.numUses(cond) != 1)
+            continue;
+        fusedCmps_.insert(cmp);
+        FusedBranch fused{cmp, false};
+        const Operand &lhs = cmp->ops[0], &rhs = cmp->ops[1];
+        if (n >= 3 && (cmp->cmpPred == CmpPred::EQ || cmp->cmpPred == CmpPred::NE) &&
+            lhs.isVReg() && rhs.isImm() && rhs.immValue() == 0) {
+            const Instruction *inner = insts[n - 3];
+            if (inner->opcode == Opcode::ICmp && inner->defReg() == lhs.regId() &&
+                chains.numUses(lhs.regId()) == 1) {
+                fusedCmps_.insert(inner);
+                fused = FusedBranch{inner, cmp->cmpPred == CmpPred::EQ};
+            }
         }
-        for (auto &inst : bb->insts)
-            generateInst(*inst);
+        fusedBranches_.emplace(cond, fused);
     }
+    stats::add(stats::Counter::FusedCompares, fusedCmps_.size());
+}
 
-    // 计算栈帧并替换占位符
-    calculateStackFrame();
-    updateStackFramePlaceholders();
+// isTailCallSite：insts[i] 是标记为 tail、参数全在寄存器中、不需跨调用保存寄存器，且紧跟
+// 返回其结果（或 ret void）的 call —— 这样的调用点与 ret 一起生成为尾调用
+bool FunctionCodeGen::isTailCallSite(const std::vector<Instruction *> &insts, size_t i) const {
+    const Instruction &inst = *insts[i];
+    return inst.tail && inst.ops.size() <= 8 && i + 1 < insts.size() && !savesAcrossCall(inst) &&
+           (insts[i + 1]->opcode == Opcode::RetVoid ||
+            (insts[i + 1]->opcode == Opcode::Ret && inst.def.isVReg() &&
+             insts[i + 1]->ops[0].isVReg() && insts[i + 1]->ops[0].regId() == inst.defReg()));
+}
 
-    output_ += "    .size " + func.name + ", .-" + func.name + "\n\n";
+// savesAcrossCall：调用点是否有跨越调用、需要保存的调用者保存寄存器
+bool FunctionCodeGen::savesAcrossCall(const Instruction &inst) const {
+    auto it = alloc_.callSaves.find(&inst);
+    return it != alloc_.callSaves.end() && !it->second.empty();
 }
 
-// emit：输出一条带 4 空格缩进的汇编指令
-void RISCVCodeGen::emit(const std::string &line) { output_ += "    " + line + "\n"; }
+// emit：追加一条机器指令到当前机器基本块
+void FunctionCodeGen::emit(const MachineInstr &mi) { currentMBB_->insts.push_back(mi); }
+
+// blockIndex：标签操作数 → 机器基本块下标（与 IR 块 ID 相同）
+int FunctionCodeGen::blockIndex(const Operand &label) const {
+    return func_.blockMap.at(label.labelName())->id;
+}
 
 #pragma endregion
 
 #pragma region 指令级生成
 
 // generateInst：根据 opcode 分派到对应的生成函数
-void RISCVCodeGen::generateInst(const Instruction &inst) {
+void FunctionCodeGen::generateInst(const Instruction &inst) {
+    // 比较结果缓存的寄存器可能被中间的指令改写，只允许 icmp 与紧随其后的 br i1 融合
+    if (inst.opcode != Opcode::CondBr)
+        cmpMap_.clear();
     switch (inst.opcode) {
-    case Opcode::Alloca:
-        genAlloca(inst);
+    case Opcode::Alloca: // 已在 run() 中布局
         break;
     case Opcode::Store:
         genStore(inst);
@@ -175,11 +684,17 @@ void RISCVCodeGen::generateInst(const Instruction &inst) {
     case Opcode::Call:
         genCall(inst);
         break;
+    case Opcode::Copy:
+        genCopy(inst);
+        break;
+    case Opcode::Phi:
+        throw std::runtime_error("phi in function '" + func_.name +
+                                 "' must be eliminated before code generation");
     }
 }
 
-// genAlloca：分配局部变量栈空间，记录 vreg → 栈偏移
-void RISCVCodeGen::genAlloca(const Instruction &inst) {
+// genAlloca：分配局部变量栈空间，记录 vreg → 栈偏移（指令选择之前由 run() 统一调用）
+void FunctionCodeGen::genAlloca(const Instruction &inst) {
     int vreg = inst.defReg();
     int size = (inst.type == "i1") ? 1 : 4;
     stackOffset_ += size;
@@ -190,340 +705,635 @@ void RISCVCodeGen::genAlloca(const Instruction &inst) {
 }
 
 // genStore：store 指令 → sw/sb（根据类型选择字节宽度）
-void RISCVCodeGen::genStore(const Instruction &inst) {
+void FunctionCodeGen::genStore(const Instruction &inst) {
     // ops[0] = value, ops[1] = ptr (alloca vreg)
-    std::string valReg = resolveUse(inst.ops[0]);
+    int valReg = resolveUse(inst.ops[0]);
     int ptrVreg = inst.ops[1].regId();
-    int offset = getAllocaOffset(ptrVreg);
+    auto [base, offset] = frameAddress(getAllocaOffset(ptrVreg));
 
-    if (inst.type == "i1") {
-        emit("sb " + valReg + ", -" + std::to_string(offset) + "(s0)");
-    } else {
-        emit("sw " + valReg + ", -" + std::to_string(offset) + "(s0)");
-    }
+    MOpcode op = (inst.type == "i1") ? MOpcode::SB : MOpcode::SW;
+    emit(MachineInstr::store(op, valReg, base, offset));
 }
 
 // genLoad：load 指令 → lw/lb（含溢出写回）
-void RISCVCodeGen::genLoad(const Instruction &inst) {
+void FunctionCodeGen::genLoad(const Instruction &inst) {
     // ops[0] = ptr (alloca vreg)
-    std::string defReg = resolveDef(inst.def);
+    int defReg = resolveDef(inst.def);
     int ptrVreg = inst.ops[0].regId();
-    int offset = getAllocaOffset(ptrVreg);
+    auto [base, offset] = frameAddress(getAllocaOffset(ptrVreg));
 
-    if (inst.type == "i1") {
-        emit("lb " + defReg + ", -" + std::to_string(offset) + "(s0)");
-    } else {
-        emit("lw " + defReg + ", -" + std::to_string(offset) + "(s0)");
-    }
+    MOpcode op = (inst.type == "i1") ? MOpcode::LB : MOpcode::LW;
+    emit(MachineInstr::load(op, defReg, base, offset));
 
     // 如果 def 被溢出，需要写回栈
     spillDefIfNeeded(inst);
 }
 
+// SignedMagic：有符号除以常量 d 的魔数（q = mulh(x, multiplier) 修正后算术右移 shift 位）
+struct SignedMagic {
+    int32_t multiplier;
+    int shift;
+};
+
+/**
+ * @brief 计算有符号除法的魔数（Hacker's Delight 10-1）
+ * @param d 除数，|d| >= 2 且不是 2 的幂
+ */
+static SignedMagic signedMagic(int32_t d) {
+    const uint32_t two31 = 0x80000000u;
+    const uint32_t ad = d < 0 ? 0u - static_cast<uint32_t>(d) : static_cast<uint32_t>(d);
+    const uint32_t t = two31 + (static_cast<uint32_t>(d) >> 31);
+    const uint32_t anc = t - 1 - t % ad; // |nc|：使 nc mod d = d - 1 的最大被除数
+    int p = 31;
+    uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc; // 2^p / |nc| 的商与余数
+    uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;   // 2^p / |d| 的商与余数
+    uint32_t delta;
+    do {
+        ++p;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            ++q1;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            ++q2;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    const uint32_t m = q2 + 1;
+    return {static_cast<int32_t>(d < 0 ? 0u - m : m), p - 32};
+}
+
+// log2Exact：v 为 2 的幂时返回指数，否则返回 -1
+static int log2Exact(uint32_t v) {
+    if (v == 0 || (v & (v - 1)) != 0)
+        return -1;
+    int k = 0;
+    while ((v >> k) != 1)
+        ++k;
+    return k;
+}
+
+/**
+ * @brief 常量乘数 / 除数的 mul / sdiv / srem 改写为移位、加减与 mulh 序列
+ * @details 被乘数 / 被除数所在的寄存器 x 全程不被改写，中间结果放在 t0 / t1 与目标寄存器中
+ *   不是 x 的那几个（两个操作数都溢出时只剩一个，需要两个临时寄存器的序列退回普通指令）。
+ *   mul c：0 / ±1 / ±2^k 为一条指令（负数再取反），2^a ± 2^b 为移位 + 加减；
+ *   sdiv ±2^k：x 为负时先加 2^k - 1 再算术右移（向零取整）；srem ±2^k：x - ((x + 偏置) & -2^k)；
+ *   其他除数：q = mulh(x, M)，按 M 与 d 的符号加减 x，算术右移 s 位后加上 q 的符号位，
+ *   srem 再算 x - q * d。除数为 0 与 INT_MIN 返回 false，由调用方生成原指令（运行时行为不变）
+ */
+bool FunctionCodeGen::genConstantMulDiv(const Instruction &inst, int defReg) {
+    // 两个操作数都是立即数（-O0 下的常量表达式）时，第一个经 li 装入寄存器
+    const bool commuted = inst.opcode == Opcode::Mul && inst.ops[0].isImm() && !inst.ops[1].isImm();
+    const Operand &constOp = inst.ops[commuted ? 0 : 1];
+    if (!constOp.isImm())
+        return false;
+    const int32_t c = constOp.immValue();
+    const uint32_t absC = c < 0 ? 0u - static_cast<uint32_t>(c) : static_cast<uint32_t>(c);
+    if (inst.opcode != Opcode::Mul && (c == 0 || c == INT32_MIN))
+        return false;
+
+    // 先选定临时寄存器再加载 x：x 溢出时 resolveUse 会占用 t0 / t1 中的一个
+    const int x = resolveUse(inst.ops[commuted ? 1 : 0]);
+    std::vector<int> scratch;
+    for (int reg : {defReg, REG_T0, REG_T1})
+        if (reg != x && std::find(scratch.begin(), scratch.end(), reg) == scratch.end())
+            scratch.push_back(reg);
+    auto rri = [&](MOpcode op, int rd, int rs, int imm) { emit(MachineInstr::rri(op, rd, rs, imm)); };
+    auto rrr = [&](MOpcode op, int rd, int rs1, int rs2) {
+        emit(MachineInstr::rrr(op, rd, rs1, rs2));
+    };
+    // 没有合适序列（或临时寄存器不够）时：常量装入临时寄存器，生成原指令
+    auto plain = [&] {
+        static const std::map<Opcode, MOpcode> kOps = {
+            {Opcode::Mul, MOpcode::MUL}, {Opcode::SDiv, MOpcode::DIV}, {Opcode::SRem, MOpcode::REM}};
+        emit(MachineInstr::li(scratch[0], c));
+        rrr(kOps.at(inst.opcode), defReg, x, scratch[0]);
+        return true;
+    };
+    const int k = log2Exact(absC);
+
+    if (inst.opcode == Opcode::Mul) {
+        if (c == 0) {
+            emit(MachineInstr::li(defReg, 0));
+        } else if (k >= 0) {
+            if (k == 0 && c > 0)
+                emit(MachineInstr::mv(defReg, x));
+            else if (k == 0)
+                rrr(MOpcode::SUB, defReg, REG_ZERO, x);
+            else
+                rri(MOpcode::SLLI, defReg, x, k);
+            if (k > 0 && c < 0)
+                rrr(MOpcode::SUB, defReg, REG_ZERO, defReg);
+        } else {
+            // c = 2^a ± 2^b（a > b）：最低位为 2^b，剩余部分（c - 2^b 或 c + 2^b）是 2 的幂
+            if (c < 0)
+                return plain();
+            const uint32_t low = absC & (0u - absC);
+            const int b = log2Exact(low);
+            int a = log2Exact(absC - low);
+            MOpcode combine = MOpcode::ADD;
+            if (a < 0) {
+                a = log2Exact(absC + low);
+                combine = MOpcode::SUB;
+            }
+            if (a < 0 || scratch.size() < (b == 0 ? 1u : 2u))
+                return plain();
+            rri(MOpcode::SLLI, scratch[0], x, a);
+            if (b == 0) {
+                rrr(combine, defReg, scratch[0], x);
+            } else {
+                rri(MOpcode::SLLI, scratch[1], x, b);
+                rrr(combine, defReg, scratch[0], scratch[1]);
+            }
+        }
+        return true;
+    }
+
+    const bool isRem = inst.opcode == Opcode::SRem;
+    if (absC == 1) {
+        if (isRem)
+            emit(MachineInstr::li(defReg, 0));
+        else if (c > 0)
+            emit(MachineInstr::mv(defReg, x));
+        else
+            rrr(MOpcode::SUB, defReg, REG_ZERO, x); // INT_MIN / -1 与 div 一样回绕为 INT_MIN
+        return true;
+    }
+    if (k > 0) {
+        // 偏置：x 为负时为 2^k - 1，否则为 0
+        const int t = scratch[0];
+        if (k == 1) {
+            rri(MOpcode::SRLI, t, x, 31);
+        } else {
+            rri(MOpcode::SRAI, t, x, 31);
+            rri(MOpcode::SRLI, t, t, 32 - k);
+        }
+        rrr(MOpcode::ADD, t, x, t);
+        if (!isRem) {
+            rri(MOpcode::SRAI, defReg, t, k);
+            if (c < 0)
+                rrr(MOpcode::SUB, defReg, REG_ZERO, defReg);
+            return true;
+        }
+        // 余数的符号随被除数，与除数的符号无关
+        if (k <= 11) {
+            rri(MOpcode::ANDI, t, t, -(1 << k));
+        } else {
+            rri(MOpcode::SRAI, t, t, k);
+            rri(MOpcode::SLLI, t, t, k);
+        }
+        rrr(MOpcode::SUB, defReg, x, t);
+        return true;
+    }
+
+    if (scratch.size() < 2)
+        return plain();
+    const SignedMagic magic = signedMagic(c);
+    const int q = scratch[0], t = scratch[1];
+    emit(MachineInstr::li(q, magic.multiplier));
+    rrr(MOpcode::MULH, q, x, q);
+    if (c > 0 && magic.multiplier < 0)
+        rrr(MOpcode::ADD, q, q, x);
+    else if (c < 0 && magic.multiplier > 0)
+        rrr(MOpcode::SUB, q, q, x);
+    if (magic.shift > 0)
+        rri(MOpcode::SRAI, q, q, magic.shift);
+    rri(MOpcode::SRLI, t, q, 31);
+    if (!isRem) {
+        rrr(MOpcode::ADD, defReg, q, t);
+        return true;
+    }
+    rrr(MOpcode::ADD, q, q, t);
+    emit(MachineInstr::li(t, c));
+    rrr(MOpcode::MUL, q, q, t);
+    rrr(MOpcode::SUB, defReg, x, q);
+    return true;
+}
+
 /**
  * @brief 算术运算指令生成
  * @details 支持 addi 优化：当 add/sub 的一个操作数为立即数时，
- *          直接生成 addi 而非先 li 再 add
+ *          直接生成 addi 而非先 li 再 add；常量乘数 / 除数交给 genConstantMulDiv
  */
-void RISCVCodeGen::genBinOp(const Instruction &inst) {
-    std::string defReg = resolveDef(inst.def);
+void FunctionCodeGen::genBinOp(const Instruction &inst) {
+    int defReg = resolveDef(inst.def);
 
     // addi 优化：add/sub 且立即数在 12 位有符号范围 [-2048, 2047] 内
     auto inAddiRange = [](int v) { return v >= -2048 && v <= 2047; };
 
     if (inst.opcode == Opcode::Add && inst.ops[1].isImm() && inAddiRange(inst.ops[1].immValue())) {
-        std::string lhsReg = resolveUse(inst.ops[0]);
-        emit("addi " + defReg + ", " + lhsReg + ", " + std::to_string(inst.ops[1].immValue()));
+        int lhsReg = resolveUse(inst.ops[0]);
+        emit(MachineInstr::rri(MOpcode::ADDI, defReg, lhsReg, inst.ops[1].immValue()));
         spillDefIfNeeded(inst);
         return;
     }
     if (inst.opcode == Opcode::Add && inst.ops[0].isImm() && inAddiRange(inst.ops[0].immValue())) {
-        std::string rhsReg = resolveUse(inst.ops[1]);
-        emit("addi " + defReg + ", " + rhsReg + ", " + std::to_string(inst.ops[0].immValue()));
+        int rhsReg = resolveUse(inst.ops[1]);
+        emit(MachineInstr::rri(MOpcode::ADDI, defReg, rhsReg, inst.ops[0].immValue()));
         spillDefIfNeeded(inst);
         return;
     }
     if (inst.opcode == Opcode::Sub && inst.ops[1].isImm() && inAddiRange(-inst.ops[1].immValue())) {
-        std::string lhsReg = resolveUse(inst.ops[0]);
-        emit("addi " + defReg + ", " + lhsReg + ", " + std::to_string(-inst.ops[1].immValue()));
+        int lhsReg = resolveUse(inst.ops[0]);
+        emit(MachineInstr::rri(MOpcode::ADDI, defReg, lhsReg, -inst.ops[1].immValue()));
+        spillDefIfNeeded(inst);
+        return;
+    }
+
+    if (inst.opcode != Opcode::Add && inst.opcode != Opcode::Sub &&
+        genConstantMulDiv(inst, defReg)) {
         spillDefIfNeeded(inst);
         return;
     }
 
-    std::string lhsReg = resolveUse(inst.ops[0]);
-    std::string rhsReg = resolveUse(inst.ops[1]);
+    int lhsReg = resolveUse(inst.ops[0]);
+    int rhsReg = resolveUse(inst.ops[1]);
 
-    std::string op;
+    MOpcode op;
     switch (inst.opcode) {
     case Opcode::Add:
-        op = "add";
+        op = MOpcode::ADD;
         break;
     case Opcode::Sub:
-        op = "sub";
+        op = MOpcode::SUB;
         break;
     case Opcode::Mul:
-        op = "mul";
+        op = MOpcode::MUL;
         break;
     case Opcode::SDiv:
-        op = "div";
+        op = MOpcode::DIV;
         break;
     case Opcode::SRem:
-        op = "rem";
+        op = MOpcode::REM;
         break;
     default:
         return;
     }
 
-    emit(op + " " + defReg + ", " + lhsReg + ", " + rhsReg);
+    emit(MachineInstr::rrr(op, defReg, lhsReg, rhsReg));
     spillDefIfNeeded(inst);
 }
 
 /**
  * @brief 比较指令生成
- * @details 生成兆底指令（slt/sub+seqz 等），同时将比较信息缓存到 cmpMap_，
+ * @details 融合比较（见 collectFusedCompares）不生成任何指令，留给紧随其后的 genCondBr；
+ *          其余生成兜底指令（slt/sub+seqz 等），同时将比较信息缓存到 cmpMap_，
  *          供后续 genCondBr 进行 branch fusion
  */
-void RISCVCodeGen::genICmp(const Instruction &inst) {
-    std::string lhsReg = resolveUse(inst.ops[0]);
-    std::string rhsReg = resolveUse(inst.ops[1]);
-    std::string defReg = resolveDef(inst.def);
+void FunctionCodeGen::genICmp(const Instruction &inst) {
+    if (fusedCmps_.count(&inst))
+        return;
+    int lhsReg = resolveUse(inst.ops[0]);
+    int rhsReg = resolveUse(inst.ops[1]);
+    int defReg = resolveDef(inst.def);
 
-    // 缓存比较信息供 branch fusion
-    cmpMap_[inst.defReg()] = CmpInfo{inst.cmpPred, lhsReg, rhsReg};
+    // 缓存比较信息供 branch fusion（结果寄存器与操作数寄存器相同时，兜底指令会改写操作数，不缓存）
+    if (defReg != lhsReg && defReg != rhsReg)
+        cmpMap_[inst.defReg()] = CmpInfo{inst.cmpPred, lhsReg, rhsReg};
 
     // 同时生成兜底指令（供值使用场景）
     switch (inst.cmpPred) {
     case CmpPred::EQ:
-        emit("sub " + defReg + ", " + lhsReg + ", " + rhsReg);
-        emit("seqz " + defReg + ", " + defReg);
+        emit(MachineInstr::rrr(MOpcode::SUB, defReg, lhsReg, rhsReg));
+        emit(MachineInstr::rr(MOpcode::SEQZ, defReg, defReg));
         break;
     case CmpPred::NE:
-        emit("sub " + defReg + ", " + lhsReg + ", " + rhsReg);
-        emit("snez " + defReg + ", " + defReg);
+        emit(MachineInstr::rrr(MOpcode::SUB, defReg, lhsReg, rhsReg));
+        emit(MachineInstr::rr(MOpcode::SNEZ, defReg, defReg));
         break;
     case CmpPred::SLT:
-        emit("slt " + defReg + ", " + lhsReg + ", " + rhsReg);
+        emit(MachineInstr::rrr(MOpcode::SLT, defReg, lhsReg, rhsReg));
         break;
     case CmpPred::SGT:
-        emit("slt " + defReg + ", " + rhsReg + ", " + lhsReg);
+        emit(MachineInstr::rrr(MOpcode::SLT, defReg, rhsReg, lhsReg));
         break;
     case CmpPred::SLE:
-        emit("slt " + defReg + ", " + rhsReg + ", " + lhsReg);
-        emit("xori " + defReg + ", " + defReg + ", 1");
+        emit(MachineInstr::rrr(MOpcode::SLT, defReg, rhsReg, lhsReg));
+        emit(MachineInstr::rri(MOpcode::XORI, defReg, defReg, 1));
         break;
     case CmpPred::SGE:
-        emit("slt " + defReg + ", " + lhsReg + ", " + rhsReg);
-        emit("xori " + defReg + ", " + defReg + ", 1");
+        emit(MachineInstr::rrr(MOpcode::SLT, defReg, lhsReg, rhsReg));
+        emit(MachineInstr::rri(MOpcode::XORI, defReg, defReg, 1));
         break;
     }
     spillDefIfNeeded(inst);
 }
 
+// invertPred：比较谓词取反
+static CmpPred invertPred(CmpPred pred) {
+    switch (pred) {
+    case CmpPred::EQ:
+        return CmpPred::NE;
+    case CmpPred::NE:
+        return CmpPred::EQ;
+    case CmpPred::SLT:
+        return CmpPred::SGE;
+    case CmpPred::SGT:
+        return CmpPred::SLE;
+    case CmpPred::SLE:
+        return CmpPred::SGT;
+    case CmpPred::SGE:
+        return CmpPred::SLT;
+    }
+    return pred;
+}
+
+// branchOpcode：比较谓词 → 对应的条件分支
+static MOpcode branchOpcode(CmpPred pred) {
+    switch (pred) {
+    case CmpPred::EQ:
+        return MOpcode::BEQ;
+    case CmpPred::NE:
+        return MOpcode::BNE;
+    case CmpPred::SLT:
+        return MOpcode::BLT;
+    case CmpPred::SGT:
+        return MOpcode::BGT;
+    case CmpPred::SLE:
+        return MOpcode::BLE;
+    case CmpPred::SGE:
+        return MOpcode::BGE;
+    }
+    return MOpcode::BEQ;
+}
+
 /**
  * @brief 条件分支指令生成
- * @details 尝试 branch fusion：如果条件 vreg 在 cmpMap_ 中有缓存，
- *          直接生成 beq/bne/blt/bgt/ble/bge；否则回退到 bnez + j
+ * @details 条件来自融合比较时在这里解析 icmp 的操作数（常量 0 直接用 zero 寄存器）；
+ *          否则尝试 branch fusion：如果条件 vreg 在 cmpMap_ 中有缓存，
+ *          直接生成 beq/bne/blt/bgt/ble/bge；都不满足时回退到 bnez + j
  */
-void RISCVCodeGen::genCondBr(const Instruction &inst) {
+void FunctionCodeGen::genCondBr(const Instruction &inst) {
     // ops[0] = cond, ops[1] = true label, ops[2] = false label
-    std::string trueLabel = "." + currentFunction_ + "_" + inst.ops[1].labelName();
-    std::string falseLabel = "." + currentFunction_ + "_" + inst.ops[2].labelName();
+    int trueTarget = blockIndex(inst.ops[1]);
+    int falseTarget = blockIndex(inst.ops[2]);
 
     int condVreg = inst.ops[0].isVReg() ? inst.ops[0].regId() : -1;
     auto cmpIt = cmpMap_.find(condVreg);
 
-    if (cmpIt != cmpMap_.end()) {
+    if (auto fusedIt = fusedBranches_.find(condVreg); fusedIt != fusedBranches_.end()) {
+        const auto [cmp, negated] = fusedIt->second;
+        auto operandReg = [&](const Operand &op) {
+            return op.isImm() && op.immValue() == 0 ? REG_ZERO : resolveUse(op);
+        };
+        int lhsReg = operandReg(cmp->ops[0]);
+        int rhsReg = operandReg(cmp->ops[1]);
+        CmpPred pred = negated ? invertPred(cmp->cmpPred) : cmp->cmpPred;
+        emit(MachineInstr::branch(branchOpcode(pred), lhsReg, rhsReg, trueTarget));
+        emit(MachineInstr::jump(falseTarget));
+    } else if (cmpIt != cmpMap_.end()) {
         // Branch fusion
         auto &cmp = cmpIt->second;
-        std::string brOp;
-        switch (cmp.pred) {
-        case CmpPred::EQ:
-            brOp = "beq";
-            break;
-        case CmpPred::NE:
-            brOp = "bne";
-            break;
-        case CmpPred::SLT:
-            brOp = "blt";
-            break;
-        case CmpPred::SGT:
-            brOp = "bgt";
-            break;
-        case CmpPred::SLE:
-            brOp = "ble";
-            break;
-        case CmpPred::SGE:
-            brOp = "bge";
-            break;
-        }
-        emit(brOp + " " + cmp.lhsReg + ", " + cmp.rhsReg + ", " + trueLabel);
-        emit("j " + falseLabel);
+        emit(MachineInstr::branch(branchOpcode(cmp.pred), cmp.lhsReg, cmp.rhsReg, trueTarget));
+        emit(MachineInstr::jump(falseTarget));
         cmpMap_.erase(cmpIt);
     } else {
-        std::string condReg = resolveUse(inst.ops[0]);
-        emit("bnez " + condReg + ", " + trueLabel);
-        emit("j " + falseLabel);
+        int condReg = resolveUse(inst.ops[0]);
+        emit(MachineInstr::bnez(condReg, trueTarget));
+        emit(MachineInstr::jump(falseTarget));
     }
 }
 
 // genBr：无条件跳转 → j
-void RISCVCodeGen::genBr(const Instruction &inst) {
-    std::string target = "." + currentFunction_ + "_" + inst.ops[0].labelName();
-    emit("j " + target);
+void FunctionCodeGen::genBr(const Instruction &inst) {
+    emit(MachineInstr::jump(blockIndex(inst.ops[0])));
 }
 
-// genRet：返回指令 → mv a0 + epilogue 占位符 + ret
-void RISCVCodeGen::genRet(const Instruction &inst) {
+// genRet：返回指令 → 返回值送入 a0 + FrameDestroy 伪指令 + ret
+// 常量、重物化与栈上的返回值直接 li / lw 到 a0；寄存器中的返回值不在 a0 时才需要 mv
+// （分配器按调用约定偏好让返回值尽量直接分配在 a0）
+void FunctionCodeGen::genRet(const Instruction &inst) {
     hasReturn_ = true;
 
     if (inst.opcode == Opcode::Ret && !inst.ops.empty()) {
-        std::string valReg = resolveUse(inst.ops[0]);
-        if (valReg != "a0")
-            emit("mv a0, " + valReg);
+        const Operand &val = inst.ops[0];
+        if (val.isImm()) {
+            emit(MachineInstr::li(REG_A0, val.immValue()));
+        } else if (val.isBoolLit()) {
+            emit(MachineInstr::li(REG_A0, val.boolValue() ? 1 : 0));
+        } else if (val.isVReg() && !alloc_.vregToPhys.count(val.regId()) &&
+                   (alloc_.rematValues.count(val.regId()) ||
+                    alloc_.vregToStack.count(val.regId()))) {
+            loadSpilled(REG_A0, val.regId());
+        } else {
+            int valReg = resolveUse(val);
+            if (valReg != REG_A0)
+                emit(MachineInstr::mv(REG_A0, valReg));
+        }
     }
 
-    // Epilogue 占位符
-    std::string epiloguePlaceholder = "__EPILOGUE_PLACEHOLDER_" + currentFunction_ + "__";
-    output_ += epiloguePlaceholder + "\n";
-    emit("ret");
+    // Epilogue 伪指令（栈帧确定后展开）
+    emit(MachineInstr::pseudo(MOpcode::FrameDestroy));
+    emit(MachineInstr::ret());
 }
 
 /**
- * @brief 函数调用指令生成
- * @details 流程：
- *   1. 保存调用者保存寄存器到栈
- *   2. 移动参数到 a0-a7
- *   3. 发出 call 指令
- *   4. 恢复调用者保存寄存器
- *   5. 将返回值从 a0 移到目标寄存器
+ * @brief call 指令 → 保存跨越调用的调用者保存寄存器 + 传参 + call + 恢复
+ * @details 只保存 / 恢复分配器为这个调用点记录的寄存器（调用之后仍活跃、位于调用者保存
+ *   寄存器中的值），保存区位于出栈参数区之上
  */
-void RISCVCodeGen::genCall(const Instruction &inst) {
-    auto &alloc = funcAllocators_[currentFunction_]->getAllocationResult();
-
-    // 确定 def 对应的物理寄存器（用于跳过保存/恢复）
-    int defPhysReg = -1;
-    if (inst.def.isVReg()) {
-        auto physIt = alloc.vregToPhys.find(inst.def.regId());
-        if (physIt != alloc.vregToPhys.end())
-            defPhysReg = physIt->second;
-    }
-
-    // 收集需要保存的调用者保存寄存器（排除溢出临时寄存器和 def 寄存器）
-    std::vector<int> savedRegs;
-    for (auto &[vreg, physReg] : alloc.vregToPhys) {
-        if (regInfo_.isCallerSaved(physReg) &&
-            !funcAllocators_[currentFunction_]->isSpillTempReg(physReg) && physReg != defPhysReg) {
-            if (std::find(savedRegs.begin(), savedRegs.end(), physReg) == savedRegs.end())
-                savedRegs.push_back(physReg);
-        }
-    }
-    std::sort(savedRegs.begin(), savedRegs.end());
+void FunctionCodeGen::genCall(const Instruction &inst) {
+    static const std::vector<int> kNoSaves;
+    auto savesIt = alloc_.callSaves.find(&inst);
+    const std::vector<int> &savedRegs = savesIt != alloc_.callSaves.end() ? savesIt->second
+                                                                          : kNoSaves;
 
     // 保存到栈（使用 sp 相对偏移，位于出栈参数区之上）
-    std::map<int, int> regToSaveOffset; // 物理寄存器 → 保存偏移
     int saveOffset = callArgAreaSize_;
     for (int reg : savedRegs) {
-        emit("sw " + regInfo_.getRegName(reg) + ", " + std::to_string(saveOffset) + "(sp)");
-        regToSaveOffset[reg] = saveOffset;
+        emit(MachineInstr::store(MOpcode::SW, reg, REG_SP, saveOffset));
+        saveOffset += 4;
+    }
+    stats::add(stats::Counter::CallSaveRestores, savedRegs.size() * 2);
+
+    genCallArgs(inst);
+
+    // 调用
+    emit(MachineInstr::call(inst.callee));
+
+    // 结果从 a0 移到目标寄存器（目标不会是被保存的寄存器：结果不跨越本次调用）
+    int defReg = resolveDef(inst.def);
+    if (defReg != REG_A0)
+        emit(MachineInstr::mv(defReg, REG_A0));
+
+    // 恢复 caller-saved 寄存器
+    saveOffset = callArgAreaSize_;
+    for (int reg : savedRegs) {
+        emit(MachineInstr::load(MOpcode::LW, reg, REG_SP, saveOffset));
         saveOffset += 4;
     }
 
+    spillDefIfNeeded(inst);
+}
+
+/**
+ * @brief 尾调用：call 与紧随其后返回其结果的 ret → 传参 + FrameDestroy 伪指令 + tail
+ * @details 实参在撤销栈帧之前就位（栈上的实参仍按 s0 / sp 寻址），epilogue 只恢复被调用者保存
+ *   寄存器、ra 与 sp，不触及 a0-a7。被调函数返回时直接回到本函数的调用者，结果已在 a0。
+ *   只处理实参不超过 8 个的调用（出栈参数区属于本函数的栈帧）
+ */
+void FunctionCodeGen::genTailCall(const Instruction &inst) {
+    hasReturn_ = true;
+    cmpMap_.clear();
+    genCallArgs(inst);
+    emit(MachineInstr::pseudo(MOpcode::FrameDestroy));
+    emit(MachineInstr::tail(inst.callee));
+    stats::add(stats::Counter::TailCalls);
+}
+
+/**
+ * @brief 实参送入 a0-a7 与出栈参数区
+ * @details 1. 第 9 个起的参数写入出栈参数区（此时各寄存器仍是原值）
+ *   2. 寄存器来源的参数按并行移动搬入 a0-a7
+ *   3. 栈来源与常量参数直接加载到目标寄存器（不读任何寄存器，放在最后）
+ */
+void FunctionCodeGen::genCallArgs(const Instruction &inst) {
     // 将超过 8 个的参数存放到出栈参数区 sp+0, sp+4, ...
     for (size_t i = 8; i < inst.ops.size(); ++i) {
         int argOffset = static_cast<int>(i - 8) * 4;
         const auto &op = inst.ops[i];
         if (op.isImm()) {
-            auto &allocator = funcAllocators_[currentFunction_];
-            int tmpReg = allocator->allocateSpillTempReg();
-            std::string tmpName = regInfo_.getRegName(tmpReg);
-            emit("li " + tmpName + ", " + std::to_string(op.immValue()));
-            emit("sw " + tmpName + ", " + std::to_string(argOffset) + "(sp)");
+            int tmpReg = allocator_.allocateSpillTempReg();
+            emit(MachineInstr::li(tmpReg, op.immValue()));
+            emit(MachineInstr::store(MOpcode::SW, tmpReg, REG_SP, argOffset));
         } else if (op.isVReg()) {
             int vreg = op.regId();
-            auto physIt = alloc.vregToPhys.find(vreg);
-            if (physIt != alloc.vregToPhys.end()) {
-                int physReg = physIt->second;
-                auto saveIt = regToSaveOffset.find(physReg);
-                if (saveIt != regToSaveOffset.end()) {
-                    auto &allocator = funcAllocators_[currentFunction_];
-                    int tmpReg = allocator->allocateSpillTempReg();
-                    std::string tmpName = regInfo_.getRegName(tmpReg);
-                    emit("lw " + tmpName + ", " + std::to_string(saveIt->second) + "(sp)");
-                    emit("sw " + tmpName + ", " + std::to_string(argOffset) + "(sp)");
-                } else {
-                    std::string srcReg = regInfo_.getRegName(physReg);
-                    emit("sw " + srcReg + ", " + std::to_string(argOffset) + "(sp)");
-                }
+            auto physIt = alloc_.vregToPhys.find(vreg);
+            if (physIt != alloc_.vregToPhys.end()) {
+                emit(MachineInstr::store(MOpcode::SW, physIt->second, REG_SP, argOffset));
             } else {
-                auto stackIt = alloc.vregToStack.find(vreg);
-                if (stackIt != alloc.vregToStack.end()) {
-                    auto &allocator = funcAllocators_[currentFunction_];
-                    int tmpReg = allocator->allocateSpillTempReg();
-                    std::string tmpName = regInfo_.getRegName(tmpReg);
-                    if (stackIt->second > 0) {
-                        emit("lw " + tmpName + ", " + std::to_string(stackIt->second - 4) + "(s0)");
-                    } else {
-                        int spOffset = spillSlotToSpOffset(stackIt->second);
-                        emit("lw " + tmpName + ", " + std::to_string(spOffset) + "(sp)");
-                    }
-                    emit("sw " + tmpName + ", " + std::to_string(argOffset) + "(sp)");
-                }
+                int tmpReg = allocator_.allocateSpillTempReg();
+                if (loadSpilled(tmpReg, vreg))
+                    emit(MachineInstr::store(MOpcode::SW, tmpReg, REG_SP, argOffset));
             }
         }
     }
 
-    // 移动参数到 a0-a7
-    // 直接从已保存的栈位置/溢出槽加载到目标寄存器，彻底避免并行移动冲突
+    // 移动参数到 a0-a7：先做寄存器之间的并行移动，再加载栈上的值与常量
+    std::vector<std::pair<int, int>> moves; // (目标, 来源)
     for (size_t i = 0; i < inst.ops.size() && i < 8; ++i) {
-        std::string target = "a" + std::to_string(i);
         const auto &op = inst.ops[i];
-
+        if (!op.isVReg())
+            continue;
+        auto physIt = alloc_.vregToPhys.find(op.regId());
+        if (physIt != alloc_.vregToPhys.end())
+            moves.emplace_back(REG_A0 + static_cast<int>(i), physIt->second);
+    }
+    emitParallelMoves(moves);
+    for (size_t i = 0; i < inst.ops.size() && i < 8; ++i) {
+        int target = REG_A0 + static_cast<int>(i);
+        const auto &op = inst.ops[i];
         if (op.isImm()) {
-            emit("li " + target + ", " + std::to_string(op.immValue()));
+            emit(MachineInstr::li(target, op.immValue()));
         } else if (op.isBoolLit()) {
-            emit("li " + target + ", " + std::to_string(op.boolValue() ? 1 : 0));
-        } else if (op.isVReg()) {
-            int vreg = op.regId();
-            // 分配到物理寄存器的 vreg
-            auto physIt = alloc.vregToPhys.find(vreg);
-            if (physIt != alloc.vregToPhys.end()) {
-                int physReg = physIt->second;
-                auto saveIt = regToSaveOffset.find(physReg);
-                if (saveIt != regToSaveOffset.end()) {
-                    // caller-saved：从已保存的栈位置加载（避免并行移动冲突）
-                    emit("lw " + target + ", " + std::to_string(saveIt->second) + "(sp)");
-                } else {
-                    // callee-saved：不会被覆盖，直接 mv
-                    std::string srcReg = regInfo_.getRegName(physReg);
-                    if (srcReg != target)
-                        emit("mv " + target + ", " + srcReg);
-                }
-            } else {
-                // 溢出到栈的 vreg：从溢出槽直接加载
-                auto stackIt = alloc.vregToStack.find(vreg);
-                if (stackIt != alloc.vregToStack.end()) {
-                    int spOffset = spillSlotToSpOffset(stackIt->second);
-                    emit("lw " + target + ", " + std::to_string(spOffset) + "(sp)");
-                }
-            }
+            emit(MachineInstr::li(target, op.boolValue() ? 1 : 0));
+        } else if (op.isVReg() && !alloc_.vregToPhys.count(op.regId())) {
+            // 溢出的 vreg：重物化的常量直接 li，其余从溢出槽直接加载（正偏移为栈传入参数，位于 s0 之上）
+            loadSpilled(target, op.regId());
         }
     }
+}
 
-    // 调用
-    emit("call " + inst.callee);
+/**
+ * @brief 函数入口：把没有绑定在到达寄存器上的参数搬到分配的位置
+ * @details 跨越调用的参数由分配器另行分配（通常是 s1-s11）或溢出到栈槽。
+ *   先把溢出的参数写入栈槽，再按并行移动搬运其余参数（到达寄存器之间可能互相覆盖）
+ */
+void FunctionCodeGen::genParamMoves() {
+    std::vector<std::pair<int, int>> moves; // (目标, 来源)
+    for (int vreg : func_.paramVregs) {
+        auto arrival = alloc_.paramVregToLocation.find(vreg);
+        if (arrival == alloc_.paramVregToLocation.end() || arrival->second <= 0)
+            continue; // 栈传入的参数：位置不变
+        auto physIt = alloc_.vregToPhys.find(vreg);
+        if (physIt != alloc_.vregToPhys.end()) {
+            moves.emplace_back(physIt->second, arrival->second);
+            continue;
+        }
+        auto stackIt = alloc_.vregToStack.find(vreg);
+        if (stackIt != alloc_.vregToStack.end() && stackIt->second < 0)
+            emit(MachineInstr::store(MOpcode::SW, arrival->second, REG_SP,
+                                     spillSlotToSpOffset(stackIt->second)));
+    }
+    emitParallelMoves(moves);
+}
 
-    // 结果从 a0 移到目标寄存器（在恢复 caller-saved 之前，防止 a0 被覆盖）
-    std::string defReg = resolveDef(inst.def);
-    if (defReg != "a0")
-        emit("mv " + defReg + ", a0");
+/**
+ * @brief 按并行语义执行一组寄存器移动（所有来源先读后写）
+ * @param moves (目标, 来源) 列表，目标互不相同
+ * @details 反复发出目标不再被其他移动读取的移动；只剩环时，把某个目标的旧值暂存到
+ *   溢出临时寄存器，并把读取它的移动改为读取临时寄存器，从而打开环
+ */
+void FunctionCodeGen::emitParallelMoves(std::vector<std::pair<int, int>> moves) {
+    moves.erase(std::remove_if(moves.begin(), moves.end(),
+                               [](const auto &m) { return m.first == m.second; }),
+                moves.end());
+    while (!moves.empty()) {
+        auto ready = std::find_if(moves.begin(), moves.end(), [&](const auto &m) {
+            return std::none_of(moves.begin(), moves.end(),
+                                [&](const auto &o) { return o.second == m.first; });
+        });
+        if (ready == moves.end()) {
+            int tmpReg = allocator_.allocateSpillTempReg();
+            int blocked = moves.front().first;
+            emit(MachineInstr::mv(tmpReg, blocked));
+            for (auto &m : moves)
+                if (m.second == blocked)
+                    m.second = tmpReg;
+            continue;
+        }
+        emit(MachineInstr::mv(ready->first, ready->second));
+        moves.erase(ready);
+    }
+}
 
-    // 恢复 caller-saved 寄存器
-    saveOffset = callArgAreaSize_;
-    for (int reg : savedRegs) {
-        emit("lw " + regInfo_.getRegName(reg) + ", " + std::to_string(saveOffset) + "(sp)");
-        saveOffset += 4;
+/**
+ * @brief copy 指令 → li（常量或重物化的来源）或 mv（来源与目标寄存器不同时），含溢出写回
+ * @details 栈与寄存器之间的拷贝（区间分裂的 reload / 写回、来源或目标溢出的 phi 拷贝）
+ *   直接生成一条 lw / sw，不经过溢出临时寄存器；同一栈槽之间的拷贝与目标重物化的拷贝不生成指令
+ */
+void FunctionCodeGen::genCopy(const Instruction &inst) {
+    const Operand &src = inst.ops[0];
+    if (alloc_.rematValues.count(inst.defReg()))
+        return; // 重物化的目标：值在每个 use 处重新生成
+    auto remat = src.isVReg() ? alloc_.rematValues.find(src.regId()) : alloc_.rematValues.end();
+    if (src.isVReg() && remat == alloc_.rematValues.end()) {
+        auto srcStack = alloc_.vregToStack.find(src.regId());
+        auto dstStack = alloc_.vregToStack.find(inst.defReg());
+        auto dstPhys = alloc_.vregToPhys.find(inst.defReg());
+        if (srcStack != alloc_.vregToStack.end()) {
+            if (dstStack != alloc_.vregToStack.end() && dstStack->second == srcStack->second)
+                return;
+            if (dstPhys != alloc_.vregToPhys.end()) {
+                loadStackSlot(dstPhys->second, srcStack->second);
+                return;
+            }
+        } else if (dstStack != alloc_.vregToStack.end() && dstStack->second < 0) {
+            auto srcPhys = alloc_.vregToPhys.find(src.regId());
+            if (srcPhys != alloc_.vregToPhys.end()) {
+                emit(MachineInstr::store(MOpcode::SW, srcPhys->second, REG_SP,
+                                         spillSlotToSpOffset(dstStack->second)));
+                return;
+            }
+        }
     }
 
+    int defReg = resolveDef(inst.def);
+    if (remat != alloc_.rematValues.end()) {
+        emit(MachineInstr::li(defReg, remat->second));
+    } else if (src.isImm() || src.isBoolLit()) {
+        emit(MachineInstr::li(defReg, src.isImm() ? src.immValue() : src.boolValue() ? 1 : 0));
+    } else {
+        int srcReg = resolveUse(src);
+        if (srcReg != defReg)
+            emit(MachineInstr::mv(defReg, srcReg));
+    }
     spillDefIfNeeded(inst);
 }
 
@@ -532,106 +1342,118 @@ void RISCVCodeGen::genCall(const Instruction &inst) {
 #pragma region 操作数解析
 
 /**
- * @brief 将 use 操作数解析为物理寄存器名
+ * @brief 将 use 操作数解析为物理寄存器
  * @details 立即数/布尔值 → li 加载到临时寄存器；
- *          虚拟寄存器 → 查找分配结果，溢出时从栈加载到临时寄存器
+ *          虚拟寄存器 → 查找分配结果，溢出时从栈加载（重物化的常量 li）到临时寄存器
  */
-std::string RISCVCodeGen::resolveUse(const Operand &op) {
+int FunctionCodeGen::resolveUse(const Operand &op) {
     if (op.isImm()) {
-        auto &allocator = funcAllocators_[currentFunction_];
-        int tmpReg = allocator->allocateSpillTempReg();
-        std::string tmpName = regInfo_.getRegName(tmpReg);
-        emit("li " + tmpName + ", " + std::to_string(op.immValue()));
-        return tmpName;
+        int tmpReg = allocator_.allocateSpillTempReg();
+        emit(MachineInstr::li(tmpReg, op.immValue()));
+        return tmpReg;
     }
     if (op.isBoolLit()) {
-        auto &allocator = funcAllocators_[currentFunction_];
-        int tmpReg = allocator->allocateSpillTempReg();
-        std::string tmpName = regInfo_.getRegName(tmpReg);
-        emit("li " + tmpName + ", " + std::to_string(op.boolValue() ? 1 : 0));
-        return tmpName;
+        int tmpReg = allocator_.allocateSpillTempReg();
+        emit(MachineInstr::li(tmpReg, op.boolValue() ? 1 : 0));
+        return tmpReg;
     }
     if (op.isVReg()) {
         int vreg = op.regId();
-        auto &alloc = funcAllocators_[currentFunction_]->getAllocationResult();
 
         // 物理寄存器
-        auto physIt = alloc.vregToPhys.find(vreg);
-        if (physIt != alloc.vregToPhys.end())
-            return regInfo_.getRegName(physIt->second);
-
-        // 溢出到栈或栈传入的参数
-        auto stackIt = alloc.vregToStack.find(vreg);
-        if (stackIt != alloc.vregToStack.end()) {
-            auto &allocator = funcAllocators_[currentFunction_];
-            int tmpReg = allocator->allocateSpillTempReg();
-            std::string tmpName = regInfo_.getRegName(tmpReg);
-            if (stackIt->second > 0) {
-                // 正偏移 = 栈传入参数：位于调用者帧底部，即 s0 + (slot-4)
-                int s0Offset = stackIt->second - 4;
-                emit("lw " + tmpName + ", " + std::to_string(s0Offset) + "(s0)");
-            } else {
-                // 负偏移 = 溢出槽
-                int spOffset = spillSlotToSpOffset(stackIt->second);
-                emit("lw " + tmpName + ", " + std::to_string(spOffset) + "(sp)");
-            }
-            return tmpName;
+        auto physIt = alloc_.vregToPhys.find(vreg);
+        if (physIt != alloc_.vregToPhys.end())
+            return physIt->second;
+
+        // 重物化的常量、溢出到栈或栈传入的参数
+        if (alloc_.rematValues.count(vreg) || alloc_.vregToStack.count(vreg)) {
+            int tmpReg = allocator_.allocateSpillTempReg();
+            loadSpilled(tmpReg, vreg);
+            return tmpReg;
         }
 
-        return "a0";
+        return REG_A0;
     }
-    return "zero";
+    return REG_ZERO;
 }
 
-// resolveDef：将 def 操作数解析为目标物理寄存器名（溢出时返回临时寄存器）
-std::string RISCVCodeGen::resolveDef(const Operand &op) {
+// resolveDef：将 def 操作数解析为目标物理寄存器（溢出时返回临时寄存器）
+int FunctionCodeGen::resolveDef(const Operand &op) {
     if (!op.isVReg()) {
-        lastDefRegName_ = "a0";
-        return lastDefRegName_;
+        lastDefReg_ = REG_A0;
+        return lastDefReg_;
     }
 
     int vreg = op.regId();
-    auto &alloc = funcAllocators_[currentFunction_]->getAllocationResult();
 
-    auto physIt = alloc.vregToPhys.find(vreg);
-    if (physIt != alloc.vregToPhys.end()) {
-        lastDefRegName_ = regInfo_.getRegName(physIt->second);
-        return lastDefRegName_;
+    auto physIt = alloc_.vregToPhys.find(vreg);
+    if (physIt != alloc_.vregToPhys.end()) {
+        lastDefReg_ = physIt->second;
+        return lastDefReg_;
     }
 
     // 溢出 — 返回临时寄存器
-    auto &allocator = funcAllocators_[currentFunction_];
-    int tmpReg = allocator->allocateSpillTempReg();
-    lastDefRegName_ = regInfo_.getRegName(tmpReg);
-    return lastDefRegName_;
+    lastDefReg_ = allocator_.allocateSpillTempReg();
+    return lastDefReg_;
 }
 
 // getAllocaOffset：查找 alloca vreg 对应的栈偏移（含 frameOverhead_ 以越过 ra/s0/callee-saved
 // 区域）
-int RISCVCodeGen::getAllocaOffset(int vreg) {
+int FunctionCodeGen::getAllocaOffset(int vreg) {
     auto it = allocaOffsets_.find(vreg);
     return (it != allocaOffsets_.end()) ? it->second + frameOverhead_ : 0;
 }
 
+// frameAddress：帧指针下方 offset 字节处（s0 - offset）的 (基址, 偏移)；
+// 不用帧指针时（省略帧指针或叶函数）s0 即进入函数时的 sp，换算为 sp + (frameSize - offset)
+std::pair<int, int> FunctionCodeGen::frameAddress(int offset) const {
+    if (usesFramePointer_)
+        return {REG_S0, -offset};
+    return {REG_SP, totalStackSize_ - offset};
+}
+
+// loadStackSlot：从栈位置加载到 reg（正偏移 = 栈传入参数，位于调用者帧底部，即 s0 + (slot-4)；
+// 负偏移 = 溢出槽，按 sp 寻址）
+void FunctionCodeGen::loadStackSlot(int reg, int slot) {
+    if (slot > 0) {
+        auto [base, offset] = frameAddress(4 - slot);
+        emit(MachineInstr::load(MOpcode::LW, reg, base, offset));
+    } else
+        emit(MachineInstr::load(MOpcode::LW, reg, REG_SP, spillSlotToSpOffset(slot)));
+}
+
+// loadSpilled：把不在寄存器中的 vreg 装入 reg —— 重物化的常量 li，溢出槽 / 栈传入参数 lw；
+// 两者都不是（未分配的 vreg）时不输出指令并返回 false
+bool FunctionCodeGen::loadSpilled(int reg, int vreg) {
+    if (auto remat = alloc_.rematValues.find(vreg); remat != alloc_.rematValues.end()) {
+        emit(MachineInstr::li(reg, remat->second));
+        return true;
+    }
+    auto stackIt = alloc_.vregToStack.find(vreg);
+    if (stackIt == alloc_.vregToStack.end())
+        return false;
+    loadStackSlot(reg, stackIt->second);
+    return true;
+}
+
 // spillSlotToSpOffset：将分配器的溢出槽偏移（负值，如 -4, -8）转换为 sp 正偏移
 // 帧底部布局：[0, argArea) = 出栈参数 | [argArea, argArea+callSave) = caller-saved
 //             | [argArea+callSave, argArea+callSave+spillSize) = 溢出
-int RISCVCodeGen::spillSlotToSpOffset(int slot) {
+int FunctionCodeGen::spillSlotToSpOffset(int slot) {
     return callArgAreaSize_ + callSaveSize_ + ((-slot) - 4);
 }
 
 // spillDefIfNeeded：若 def 被溢出，将临时寄存器写回栈槽
-void RISCVCodeGen::spillDefIfNeeded(const Instruction &inst) {
+void FunctionCodeGen::spillDefIfNeeded(const Instruction &inst) {
     int dr = inst.defReg();
     if (dr < 0)
         return;
-    auto &alloc = funcAllocators_[currentFunction_]->getAllocationResult();
-    auto it = alloc.vregToStack.find(dr);
-    if (it != alloc.vregToStack.end() && it->second < 0 &&
+    auto it = alloc_.vregToStack.find(dr);
+    if (it != alloc_.vregToStack.end() && it->second < 0 &&
         allocaOffsets_.find(dr) == allocaOffsets_.end()) {
-        // 使用 resolveDef 保存的同一寄存器名（不依赖 counter 状态）
+        // 使用 resolveDef 保存的同一寄存器（不依赖 counter 状态）
         int spOffset = spillSlotToSpOffset(it->second);
-        emit("sw " + lastDefRegName_ + ", " + std::to_string(spOffset) + "(sp)");
+        emit(MachineInstr::store(MOpcode::SW, lastDefReg_, REG_SP, spOffset));
     }
 }
 
@@ -639,82 +1461,28 @@ void RISCVCodeGen::spillDefIfNeeded(const Instruction &inst) {
 
 #pragma region 栈帧管理
 
-void RISCVCodeGen::emitPrologue() {}
-void RISCVCodeGen::emitEpilogue() {}
-
 /**
  * @brief 计算函数栈帧总大小
  * @details 组成：局部变量空间 + ra/s0 保存空间 + callee-saved 寄存器 + 溢出栈槽
  * @note 最终对齐到 16 字节边界
  */
-void RISCVCodeGen::calculateStackFrame() {
-    auto &alloc = funcAllocators_[currentFunction_]->getAllocationResult();
+void FunctionCodeGen::calculateStackFrame() {
 
     int allocaSize = stackOffset_;
-    int calleeSavedCount = static_cast<int>(alloc.calleeSavedRegs.size());
     int spillSize = 0;
-    for (auto &[vreg, slot] : alloc.vregToStack) {
+    for (auto &[vreg, slot] : alloc_.vregToStack) {
         if (slot < 0) { // 仅计算溢出槽（负偏移），不计入传入栈参数（正偏移）
             int absSlot = -slot;
             spillSize = std::max(spillSize, absSlot);
         }
     }
 
-    // ra + s0 = 8 字节
-    int frameOverhead = 8 + calleeSavedCount * 4;
-    totalStackSize_ = allocaSize + frameOverhead + spillSize + callSaveSize_ + callArgAreaSize_;
+    totalStackSize_ = allocaSize + frameOverhead_ + spillSize + callSaveSize_ + callArgAreaSize_;
 
     // 对齐到 16
     totalStackSize_ = (totalStackSize_ + 15) & ~15;
 }
 
-/**
- * @brief 替换 prologue/epilogue 占位符为实际的栈帧指令
- * @details prologue: addi sp → sw ra/s0 → sw callee-saved → addi s0
- *          epilogue: lw callee-saved → lw ra/s0 → addi sp
- */
-void RISCVCodeGen::updateStackFramePlaceholders() {
-    auto &alloc = funcAllocators_[currentFunction_]->getAllocationResult();
-
-    // 生成 prologue
-    std::string prologue;
-    prologue += "    addi sp, sp, -" + std::to_string(totalStackSize_) + "\n";
-    prologue += "    sw ra, " + std::to_string(totalStackSize_ - 4) + "(sp)\n";
-    prologue += "    sw s0, " + std::to_string(totalStackSize_ - 8) + "(sp)\n";
-    prologue += "    addi s0, sp, " + std::to_string(totalStackSize_) + "\n";
-
-    int offset = totalStackSize_ - 12;
-    for (int reg : alloc.calleeSavedRegs) {
-        prologue += "    sw " + regInfo_.getRegName(reg) + ", " + std::to_string(offset) + "(sp)\n";
-        offset -= 4;
-    }
-
-    std::string prologuePlaceholder = "__PROLOGUE_PLACEHOLDER_" + currentFunction_ + "__";
-    size_t pos = output_.find(prologuePlaceholder);
-    if (pos != std::string::npos) {
-        output_.replace(pos, prologuePlaceholder.size() + 1, prologue);
-    }
-
-    // 生成 epilogue
-    std::string epilogue;
-    offset = totalStackSize_ - 12;
-    for (int reg : alloc.calleeSavedRegs) {
-        epilogue += "    lw " + regInfo_.getRegName(reg) + ", " + std::to_string(offset) + "(sp)\n";
-        offset -= 4;
-    }
-    epilogue += "    lw ra, " + std::to_string(totalStackSize_ - 4) + "(sp)\n";
-    epilogue += "    lw s0, " + std::to_string(totalStackSize_ - 8) + "(sp)\n";
-    epilogue += "    addi sp, sp, " + std::to_string(totalStackSize_) + "\n";
-
-    std::string epiloguePlaceholder = "__EPILOGUE_PLACEHOLDER_" + currentFunction_ + "__";
-    while (true) {
-        pos = output_.find(epiloguePlaceholder);
-        if (pos == std::string::npos)
-            break;
-        output_.replace(pos, epiloguePlaceholder.size() + 1, epilogue);
-    }
-}
-
 #pragma endregion
 
 } // namespace toyc
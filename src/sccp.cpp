@@ -0,0 +1,326 @@
+#include "ir_analysis.h"
+#include "ir_passes.h"
+#include "statistics.h"
+#include <climits>
+#include <optional>
+#include <unordered_set>
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+namespace {
+
+// ======================== 格 ========================
+
+// LatticeValue：SSA 值在常量格上的位置（Unknown ⊑ Const(c) ⊑ Overdefined）
+struct LatticeValue {
+    enum Kind { Unknown, Const, Overdefined } kind = Unknown;
+    int32_t value = 0;
+
+    static LatticeValue constant(int32_t v) { return {Const, v}; }
+    static LatticeValue overdefined() { return {Overdefined, 0}; }
+    bool operator==(const LatticeValue &o) const {
+        return kind == o.kind && (kind != Const || value == o.value);
+    }
+};
+
+// meet：两个格值的下确界（不同常量相遇为 Overdefined）
+LatticeValue meet(const LatticeValue &a, const LatticeValue &b) {
+    if (a.kind == LatticeValue::Unknown)
+        return b;
+    if (b.kind == LatticeValue::Unknown)
+        return a;
+    if (a.kind == LatticeValue::Const && b.kind == LatticeValue::Const && a.value == b.value)
+        return a;
+    return LatticeValue::overdefined();
+}
+
+// foldBinary：按 32 位补码回绕折叠二元运算；除数为 0 与 INT_MIN / -1 不折叠
+std::optional<int32_t> foldBinary(Opcode op, int32_t a, int32_t b) {
+    const uint32_t ua = static_cast<uint32_t>(a), ub = static_cast<uint32_t>(b);
+    switch (op) {
+    case Opcode::Add:
+        return static_cast<int32_t>(ua + ub);
+    case Opcode::Sub:
+        return static_cast<int32_t>(ua - ub);
+    case Opcode::Mul:
+        return static_cast<int32_t>(ua * ub);
+    case Opcode::SDiv:
+    case Opcode::SRem:
+        if (b == 0 || (a == INT32_MIN && b == -1))
+            return std::nullopt;
+        return op == Opcode::SDiv ? a / b : a % b;
+    default:
+        return std::nullopt;
+    }
+}
+
+// foldCompare：折叠有符号比较，结果为 0 / 1
+int32_t foldCompare(CmpPred pred, int32_t a, int32_t b) {
+    switch (pred) {
+    case CmpPred::EQ:
+        return a == b;
+    case CmpPred::NE:
+        return a != b;
+    case CmpPred::SLT:
+        return a < b;
+    case CmpPred::SGT:
+        return a > b;
+    case CmpPred::SLE:
+        return a <= b;
+    case CmpPred::SGE:
+        return a >= b;
+    }
+    return 0;
+}
+
+// ======================== 求解 ========================
+
+// SCCP：单个函数上的稀疏条件常量传播（Wegman–Zadeck）
+class SCCP {
+  public:
+    explicit SCCP(Function &F) : F_(F) {}
+
+    int run();
+
+  private:
+    Function &F_;
+    std::vector<LatticeValue> values_;      // vreg → 格值
+    std::optional<DefUseChains> chains_;    // vreg → 定义 / 读取它的指令
+    std::vector<char> blockExec_;           // 块 id → 是否可执行
+    std::unordered_set<uint64_t> edgeExec_; // 可执行的 CFG 边（from id << 32 | to id）
+    std::vector<BasicBlock *> blockWork_;
+    std::vector<Instruction *> instWork_;
+
+    void initialize();
+    void solve();
+    void visit(Instruction *I);
+    void markEdge(BasicBlock *from, BasicBlock *to);
+    void update(int vreg, const LatticeValue &v);
+    LatticeValue valueOf(const Operand &op) const;
+    bool edgeExecutable(const BasicBlock *from, const BasicBlock *to) const {
+        return edgeExec_.count(edgeKey(from, to)) != 0;
+    }
+    static uint64_t edgeKey(const BasicBlock *from, const BasicBlock *to) {
+        return static_cast<uint64_t>(from->id) << 32 | static_cast<uint32_t>(to->id);
+    }
+
+    int rewrite();
+};
+
+/**
+ * @brief 初始化格值与 use 表
+ * @details 参数、以及定义不止一处（非 SSA 输入）或没有定义的 vreg 一开始就是 Overdefined，
+ *   其余为 Unknown；入口块可执行
+ */
+void SCCP::initialize() {
+    const size_t n = static_cast<size_t>(F_.maxVregId + 1);
+    values_.assign(n, LatticeValue{});
+    chains_.emplace(F_);
+    blockExec_.assign(F_.blocks.size(), 0);
+
+    for (size_t v = 0; v < n; ++v)
+        if (chains_->numDefs(static_cast<int>(v)) != 1)
+            values_[v] = LatticeValue::overdefined();
+    for (int p : F_.paramVregs)
+        if (static_cast<size_t>(p) < n)
+            values_[p] = LatticeValue::overdefined();
+
+    BasicBlock *entry = F_.entryBlock();
+    blockExec_[entry->id] = 1;
+    blockWork_.push_back(entry);
+}
+
+// solve：交替处理块工作表与指令工作表直到不动点
+void SCCP::solve() {
+    while (!blockWork_.empty() || !instWork_.empty()) {
+        while (!instWork_.empty()) {
+            Instruction *I = instWork_.back();
+            instWork_.pop_back();
+            if (blockExec_[I->blockId])
+                visit(I);
+        }
+        if (!blockWork_.empty()) {
+            BasicBlock *bb = blockWork_.back();
+            blockWork_.pop_back();
+            for (Instruction *I : bb->insts) {
+                visit(I);
+                if (I->isTerminator())
+                    break;
+            }
+        }
+    }
+}
+
+// markEdge：标记 from → to 可执行；to 首次可执行时整块入表，否则只需重新求值它的 phi
+void SCCP::markEdge(BasicBlock *from, BasicBlock *to) {
+    if (!edgeExec_.insert(edgeKey(from, to)).second)
+        return;
+    if (!blockExec_[to->id]) {
+        blockExec_[to->id] = 1;
+        blockWork_.push_back(to);
+        return;
+    }
+    for (Instruction *I : to->insts) {
+        if (I->opcode != Opcode::Phi)
+            break;
+        instWork_.push_back(I);
+    }
+}
+
+// update：格值只会单调下降，变化时把读取者加入工作表
+void SCCP::update(int vreg, const LatticeValue &v) {
+    if (vreg < 0 || static_cast<size_t>(vreg) >= values_.size() || values_[vreg] == v)
+        return;
+    values_[vreg] = v;
+    auto users = chains_->uses(vreg);
+    instWork_.insert(instWork_.end(), users.begin(), users.end());
+}
+
+// valueOf：操作数的格值（立即数与布尔字面量是常量）
+LatticeValue SCCP::valueOf(const Operand &op) const {
+    if (op.isImm())
+        return LatticeValue::constant(op.immValue());
+    if (op.isBoolLit())
+        return LatticeValue::constant(op.boolValue() ? 1 : 0);
+    if (op.isVReg() && static_cast<size_t>(op.regId()) < values_.size())
+        return values_[op.regId()];
+    return LatticeValue::overdefined();
+}
+
+/**
+ * @brief 求值一条指令
+ * @details 二元运算 / 比较：任一操作数 Overdefined 则结果 Overdefined，仍有 Unknown 则暂不决定，
+ *   全为常量时折叠（不可折叠的除法为 Overdefined）。phi 只看可执行入边。
+ *   分支：条件为常量时只打通一侧，Overdefined 时两侧都打通，Unknown 时暂不处理
+ */
+void SCCP::visit(Instruction *I) {
+    BasicBlock *bb = F_.blocks[I->blockId].get();
+    int d = I->defReg();
+    if (d >= 0 && values_[d].kind == LatticeValue::Overdefined)
+        return; // 已到格底，不会再变化
+    switch (I->opcode) {
+    case Opcode::Add:
+    case Opcode::Sub:
+    case Opcode::Mul:
+    case Opcode::SDiv:
+    case Opcode::SRem:
+    case Opcode::ICmp: {
+        LatticeValue a = valueOf(I->ops[0]), b = valueOf(I->ops[1]);
+        if (a.kind == LatticeValue::Overdefined || b.kind == LatticeValue::Overdefined) {
+            update(d, LatticeValue::overdefined());
+        } else if (a.kind == LatticeValue::Const && b.kind == LatticeValue::Const) {
+            if (I->opcode == Opcode::ICmp) {
+                update(d, LatticeValue::constant(foldCompare(I->cmpPred, a.value, b.value)));
+            } else {
+                auto folded = foldBinary(I->opcode, a.value, b.value);
+                update(d, folded ? LatticeValue::constant(*folded) : LatticeValue::overdefined());
+            }
+        }
+        break;
+    }
+    case Opcode::Copy:
+        update(d, valueOf(I->ops[0]));
+        break;
+    case Opcode::Phi: {
+        LatticeValue merged;
+        for (size_t k = 0; k < I->numIncoming(); ++k) {
+            auto pred = F_.blockMap.find(I->incomingBlock(k));
+            if (pred != F_.blockMap.end() && edgeExecutable(pred->second, bb))
+                merged = meet(merged, valueOf(I->incomingValue(k)));
+        }
+        update(d, merged);
+        break;
+    }
+    case Opcode::Br:
+        markEdge(bb, F_.blockMap.at(I->ops[0].labelSym()));
+        break;
+    case Opcode::CondBr: {
+        LatticeValue c = valueOf(I->ops[0]);
+        if (c.kind == LatticeValue::Unknown)
+            break;
+        if (c.kind == LatticeValue::Overdefined || c.value != 0)
+            markEdge(bb, F_.blockMap.at(I->ops[1].labelSym()));
+        if (c.kind == LatticeValue::Overdefined || c.value == 0)
+            markEdge(bb, F_.blockMap.at(I->ops[2].labelSym()));
+        break;
+    }
+    default:
+        if (d >= 0)
+            update(d, LatticeValue::overdefined()); // alloca / load / call
+        break;
+    }
+}
+
+// ======================== 改写 ========================
+
+/**
+ * @brief 按求解结果改写函数
+ * @details 1. 常量 vreg 的 use 替换为字面量（br 条件与 i1 类型的 store / phi / copy / ret 用
+ *   true / false，其余用整数，与 IR 文本的语法一致），删除定义常量的指令
+ *   2. 常量条件的 br i1 改写为 br（不可执行的一侧随之不可达）
+ *   3. 删除不可达块，修剪 phi 的失效入口
+ */
+int SCCP::rewrite() {
+    int folded = 0;
+    for (auto &bb : F_.blocks) {
+        if (!blockExec_[bb->id])
+            continue;
+        std::erase_if(bb->insts, [&](const Instruction *I) {
+            int d = I->defReg();
+            bool dead = d >= 0 && I->opcode != Opcode::Call && I->opcode != Opcode::Load &&
+                        values_[d].kind == LatticeValue::Const;
+            folded += dead;
+            return dead;
+        });
+        for (Instruction *I : bb->insts) {
+            bool asBool = I->opcode == Opcode::CondBr ||
+                          (I->type == "i1" && I->opcode != Opcode::ICmp);
+            for (Operand &op : I->ops) {
+                if (!op.isVReg())
+                    continue;
+                const LatticeValue &v = values_[op.regId()];
+                if (v.kind == LatticeValue::Const)
+                    op = asBool ? Operand::boolLit(v.value != 0) : Operand::imm(v.value);
+            }
+            if (I->opcode == Opcode::CondBr && !I->ops[0].isVReg()) {
+                Operand target = I->ops[I->ops[0].boolValue() ? 1 : 2];
+                int blockId = I->blockId, index = I->index;
+                *I = Instruction::makeBr(target);
+                I->blockId = blockId;
+                I->index = index;
+                ++folded;
+            }
+        }
+    }
+    removeUnreachableBlocks(F_);
+    prunePhiIncomings(F_);
+    return folded;
+}
+
+/**
+ * @brief 执行 SCCP
+ * @details 求解前先重建 CFG（块 id 与 F.blocks 下标一致）；求解只读 IR，改写一次完成
+ */
+int SCCP::run() {
+    if (F_.blocks.empty())
+        return 0;
+    F_.buildCFG();
+    initialize();
+    solve();
+    return rewrite();
+}
+
+} // namespace
+
+// propagateConstants：对单个函数执行 SCCP
+int propagateConstants(Function &F) {
+    int folded = SCCP(F).run();
+    stats::add(stats::Counter::FoldedConstants, static_cast<uint64_t>(folded));
+    return folded;
+}
+
+} // namespace opt
+} // namespace toyc
@@ -0,0 +1,427 @@
+#include "machine_ir.h"
+#include "statistics.h"
+#include <algorithm>
+#include <charconv>
+
+namespace toyc {
+namespace mir {
+
+namespace {
+
+constexpr int kSP = 2, kS0 = 8;
+
+// kMaxRegion：一个调度区域最多的指令数。超长的直线代码（-O0 下的大表达式）每隔这么多条
+// 插入一道屏障，建图与选择的代价保持线性；相距更远的指令之间本就很少有可以填补的停顿
+constexpr size_t kMaxRegion = 64;
+
+// kPresets：预置延迟模型（-mtune=<name>）
+const LatencyModel kPresets[] = {
+    // 经典 5 级流水线（带前递）：load-use 停顿 1 个周期，3 级流水乘法器，逐位迭代除法器
+    {"generic", 1, 2, 3, 33},
+    // 访存与乘法级数更多的顺序核：load-use 停顿 2 个周期
+    {"deep", 1, 3, 5, 33},
+};
+
+#pragma region 依赖图
+
+// SchedNode：块内一条指令在依赖图中的结点
+struct SchedNode {
+    int def = -1;              // 写入的寄存器（-1 表示没有，x0 不计）
+    int uses[2] = {-1, -1};    // 读取的寄存器
+    bool barrier = false;      // 调度屏障（转移 / 调用 / 插桩 / 区域上限）：前后的指令都不越过它
+    bool readsAll = false;     // 屏障读取全部寄存器（call / tail / ret 的实参与返回值）
+    int mem = 0;               // 0：不访存，1：load，2：store
+    int size = 0;              // 访存字节数
+    int base = -1, offset = 0; // 访存地址 = base + offset
+    int spVersion = 0, s0Version = 0, baseVersion = 0; // 访存时 sp / s0 / base 在块内被写过的次数
+    int latency = 1;                                   // 结果的延迟
+    int numPreds = 0;
+    int height = 0; // 到块末的最长延迟路径（调度优先级）
+};
+
+// DepGraph：块的依赖图，后继边按起点连续存放（CSR）；跨块复用以保留容量
+struct DepGraph {
+    struct Edge {
+        int from, to, gap; // gap：最小发射间隔
+    };
+    std::vector<SchedNode> nodes;
+    std::vector<Edge> edges;   // 按起点排序后的边
+    std::vector<int> succBegin; // 结点 i 的后继边为 edges[succBegin[i], succBegin[i + 1])
+    std::vector<Edge> scratch; // 建图时按终点顺序收集的边
+
+    size_t size() const { return nodes.size(); }
+    const Edge *succBeginOf(int i) const { return edges.data() + succBegin[i]; }
+    const Edge *succEndOf(int i) const { return edges.data() + succBegin[i + 1]; }
+};
+
+// classify：按操作码填写结点的寄存器读写、访存与屏障信息
+void classify(const MachineInstr &MI, SchedNode &N) {
+    switch (MI.opcode) {
+    case MOpcode::LI:
+        N.def = MI.rd;
+        break;
+    case MOpcode::MV:
+    case MOpcode::ADDI:
+    case MOpcode::XORI:
+    case MOpcode::ANDI:
+    case MOpcode::SLLI:
+    case MOpcode::SRLI:
+    case MOpcode::SRAI:
+    case MOpcode::SEQZ:
+    case MOpcode::SNEZ:
+        N.def = MI.rd;
+        N.uses[0] = MI.rs1;
+        break;
+    case MOpcode::ADD:
+    case MOpcode::SUB:
+    case MOpcode::MUL:
+    case MOpcode::MULH:
+    case MOpcode::DIV:
+    case MOpcode::REM:
+    case MOpcode::SLT:
+        N.def = MI.rd;
+        N.uses[0] = MI.rs1;
+        N.uses[1] = MI.rs2;
+        break;
+    case MOpcode::LW:
+    case MOpcode::LB:
+        N.def = MI.rd;
+        N.uses[0] = MI.rs1;
+        N.mem = 1;
+        break;
+    case MOpcode::SW:
+    case MOpcode::SB:
+        N.uses[0] = MI.rs1;
+        N.uses[1] = MI.rs2;
+        N.mem = 2;
+        break;
+    case MOpcode::BEQ:
+    case MOpcode::BNE:
+    case MOpcode::BLT:
+    case MOpcode::BGE:
+    case MOpcode::BGT:
+    case MOpcode::BLE:
+    case MOpcode::BNEZ:
+        N.barrier = true;
+        N.uses[0] = MI.rs1;
+        N.uses[1] = MI.rs2;
+        break;
+    case MOpcode::CALL:
+    case MOpcode::TAIL:
+    case MOpcode::RET:
+        N.barrier = N.readsAll = true;
+        break;
+    default: // j / 栈帧伪指令 / 剖析计数器
+        N.barrier = true;
+        break;
+    }
+    if (N.def == 0)
+        N.def = -1;
+    if (N.mem) {
+        N.size = MI.opcode == MOpcode::LW || MI.opcode == MOpcode::SW ? 4 : 1;
+        N.base = MI.rs1;
+        N.offset = MI.imm;
+    }
+}
+
+// reads：结点是否读取 reg
+bool reads(const SchedNode &N, int reg) {
+    return reg > 0 && (N.readsAll || N.uses[0] == reg || N.uses[1] == reg);
+}
+
+/**
+ * @brief 两次访存是否可能重叠（a 在 b 之前）
+ * @details 基址都是 sp / s0 时按 s0 = sp + frameSize 换算成同一坐标比较区间，
+ *   要求两者之间 sp 与 s0 都没有被改写（prologue / epilogue 中两者的关系不成立）；
+ *   同一个基址寄存器且其间未被改写时直接比较偏移；其余情况（数组指针可能指向栈帧）都视为重叠
+ */
+bool mayAlias(const SchedNode &a, const SchedNode &b, int frameSize) {
+    auto isFrame = [](int base) { return base == kSP || base == kS0; };
+    int addrA = a.offset, addrB = b.offset;
+    if (isFrame(a.base) && isFrame(b.base)) {
+        if (a.spVersion != b.spVersion || a.s0Version != b.s0Version)
+            return true;
+        addrA += a.base == kS0 ? frameSize : 0;
+        addrB += b.base == kS0 ? frameSize : 0;
+    } else if (a.base != b.base || a.baseVersion != b.baseVersion) {
+        return true;
+    }
+    return addrA < addrB + b.size && addrB < addrA + a.size;
+}
+
+/**
+ * @brief 建立块的依赖图
+ * @details 边 i → j（i 在 j 之前）的最小发射间隔：写后读为 i 的延迟；读后写、写后写、
+ *   可能重叠的访存（至少一方是 store）与屏障只约束先后（间隔 0）。寄存器依赖只连向最近的
+ *   定值与其后的读者（更早的由写后写传递），访存两两比较。屏障把块分成若干区域，结点只与
+ *   本区域内的结点及开启区域的屏障相连，跨区域的先后由屏障传递；区域达到 kMaxRegion 条时
+ *   当前指令也作为屏障
+ */
+void buildGraph(const MachineBasicBlock &MBB, const MachineFunction &MF,
+                const LatencyModel &model, DepGraph &G) {
+    const size_t n = MBB.insts.size();
+    std::vector<SchedNode> &nodes = G.nodes;
+    nodes.assign(n, SchedNode{});
+    G.scratch.clear();
+    int version[32] = {};
+    int lastDef[32];                          // 本区域内最近写入各寄存器的结点（-1 表示没有）
+    std::vector<int> readers[32];             // 最近的定值之后读取各寄存器的结点
+    std::vector<int> memOps;                  // 本区域内的访存结点
+    int regionStart = -1;                     // 开启本区域的屏障（-1 表示块首）
+    auto startRegion = [&](int barrier) {
+        regionStart = barrier;
+        std::fill(std::begin(version), std::end(version), 0);
+        std::fill(std::begin(lastDef), std::end(lastDef), -1);
+        for (auto &r : readers)
+            r.clear();
+        memOps.clear();
+    };
+    startRegion(-1);
+    for (size_t jj = 0; jj < n; ++jj) {
+        const int j = static_cast<int>(jj);
+        SchedNode &J = nodes[j];
+        classify(MBB.insts[j], J);
+        J.latency = model.latency(MBB.insts[j]);
+        if (j - regionStart > static_cast<int>(kMaxRegion))
+            J.barrier = true;
+        auto addEdge = [&](int i, int gap) {
+            G.scratch.push_back({i, j, gap});
+            ++J.numPreds;
+        };
+
+        if (J.barrier) {
+            // 屏障：本区域内的每个结点都在它之前，写后读的仍带上延迟
+            for (int i = std::max(regionStart, 0); i < j; ++i)
+                addEdge(i, nodes[i].def >= 0 && reads(J, nodes[i].def) ? nodes[i].latency : 0);
+            startRegion(j);
+            continue;
+        }
+
+        if (regionStart >= 0)
+            addEdge(regionStart, 0);
+        for (int reg : J.uses)
+            if (reg > 0 && lastDef[reg] >= 0)
+                addEdge(lastDef[reg], nodes[lastDef[reg]].latency);
+        if (J.def >= 0) {
+            for (int r : readers[J.def])
+                if (r != j)
+                    addEdge(r, 0);
+            if (lastDef[J.def] >= 0)
+                addEdge(lastDef[J.def], 0);
+        }
+        if (J.mem) {
+            J.spVersion = version[kSP];
+            J.s0Version = version[kS0];
+            J.baseVersion = J.base >= 0 ? version[J.base] : 0;
+            for (int i : memOps)
+                if ((nodes[i].mem == 2 || J.mem == 2) && mayAlias(nodes[i], J, MF.frameSize))
+                    addEdge(i, 0);
+            memOps.push_back(j);
+        }
+
+        for (int reg : J.uses)
+            if (reg > 0)
+                readers[reg].push_back(j);
+        if (J.def >= 0) {
+            ++version[J.def];
+            lastDef[J.def] = j;
+            readers[J.def].clear();
+        }
+    }
+
+    // 按起点计数排序，得到 CSR 形式的后继表
+    G.succBegin.assign(n + 1, 0);
+    for (const auto &e : G.scratch)
+        ++G.succBegin[e.from + 1];
+    for (size_t i = 0; i < n; ++i)
+        G.succBegin[i + 1] += G.succBegin[i];
+    G.edges.resize(G.scratch.size());
+    std::vector<int> fill(G.succBegin.begin(), G.succBegin.end() - 1);
+    for (const auto &e : G.scratch)
+        G.edges[fill[e.from]++] = e;
+
+    for (size_t i = n; i-- > 0;)
+        for (const auto *e = G.succBeginOf(static_cast<int>(i)); e != G.succEndOf(static_cast<int>(i)); ++e)
+            nodes[i].height = std::max(nodes[i].height, e->gap + nodes[e->to].height);
+}
+
+#pragma endregion
+
+#pragma region 列表调度
+
+// issueCycles：单发射顺序流水线按 order 发射全部结点所需的周期数
+int issueCycles(const DepGraph &G, const std::vector<int> &order) {
+    std::vector<int> earliest(G.size(), 0);
+    int cycle = -1;
+    for (int i : order) {
+        cycle = std::max(cycle + 1, earliest[i]);
+        for (const auto *e = G.succBeginOf(i); e != G.succEndOf(i); ++e)
+            earliest[e->to] = std::max(earliest[e->to], cycle + e->gap);
+    }
+    return cycle + 1;
+}
+
+// stallFree：按原顺序发射时块内没有写后读停顿（不必建图）
+bool stallFree(const MachineBasicBlock &MBB, const LatencyModel &model) {
+    int ready[32] = {}, cycle = 0;
+    for (const auto &MI : MBB.insts) {
+        SchedNode N;
+        classify(MI, N);
+        ++cycle;
+        if (N.readsAll ? *std::max_element(std::begin(ready), std::end(ready)) > cycle
+                       : std::max(N.uses[0] > 0 ? ready[N.uses[0]] : 0,
+                                  N.uses[1] > 0 ? ready[N.uses[1]] : 0) > cycle)
+            return false;
+        if (N.def >= 0)
+            ready[N.def] = cycle + model.latency(MI);
+    }
+    return true;
+}
+
+/**
+ * @brief 周期驱动的列表调度
+ * @details 每个周期从就绪结点（前驱都已发射）中挑选操作数已就绪的一个：到块末的延迟路径
+ *   最长者优先，相同时取原顺序靠前者；没有可发射的结点时停顿到最早就绪的那个
+ */
+std::vector<int> listSchedule(const DepGraph &G) {
+    const std::vector<SchedNode> &nodes = G.nodes;
+    const int n = static_cast<int>(nodes.size());
+    std::vector<int> earliest(n, 0), preds(n), ready, order;
+    for (int i = 0; i < n; ++i)
+        if ((preds[i] = nodes[i].numPreds) == 0)
+            ready.push_back(i);
+    order.reserve(n);
+    int cycle = 0;
+    while (!ready.empty()) {
+        auto better = [&](int a, int b) {
+            const bool availA = earliest[a] <= cycle, availB = earliest[b] <= cycle;
+            if (availA != availB)
+                return availA;
+            if (!availA && earliest[a] != earliest[b])
+                return earliest[a] < earliest[b];
+            if (nodes[a].height != nodes[b].height)
+                return nodes[a].height > nodes[b].height;
+            return a < b;
+        };
+        auto it = std::min_element(ready.begin(), ready.end(), better);
+        const int pick = *it;
+        ready.erase(it);
+        cycle = std::max(cycle, earliest[pick]);
+        order.push_back(pick);
+        for (const auto *e = G.succBeginOf(pick); e != G.succEndOf(pick); ++e) {
+            earliest[e->to] = std::max(earliest[e->to], cycle + e->gap);
+            if (--preds[e->to] == 0)
+                ready.push_back(e->to);
+        }
+        ++cycle;
+    }
+    return order;
+}
+
+#pragma endregion
+
+} // namespace
+
+#pragma region 延迟模型
+
+int LatencyModel::latency(const MachineInstr &MI) const {
+    switch (MI.opcode) {
+    case MOpcode::LW:
+    case MOpcode::LB:
+        return load;
+    case MOpcode::MUL:
+    case MOpcode::MULH:
+        return mul;
+    case MOpcode::DIV:
+    case MOpcode::REM:
+        return div;
+    default:
+        return alu;
+    }
+}
+
+std::string LatencyModel::toString() const {
+    return name + ",alu=" + std::to_string(alu) + ",load=" + std::to_string(load) +
+           ",mul=" + std::to_string(mul) + ",div=" + std::to_string(div);
+}
+
+// parseLatencyModel：先取预置模型，再依次应用逗号分隔的 key=value 覆盖
+std::optional<LatencyModel> parseLatencyModel(std::string_view spec) {
+    size_t comma = spec.find(',');
+    const std::string_view name = spec.substr(0, comma);
+    auto preset = std::find_if(std::begin(kPresets), std::end(kPresets),
+                               [&](const LatencyModel &m) { return m.name == name; });
+    if (preset == std::end(kPresets))
+        return std::nullopt;
+    LatencyModel model = *preset;
+    while (comma != std::string_view::npos) {
+        spec.remove_prefix(comma + 1);
+        comma = spec.find(',');
+        const std::string_view field = spec.substr(0, comma);
+        const size_t eq = field.find('=');
+        if (eq == std::string_view::npos)
+            return std::nullopt;
+        const std::string_view key = field.substr(0, eq), value = field.substr(eq + 1);
+        int cycles = 0;
+        auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), cycles);
+        if (ec != std::errc() || ptr != value.data() + value.size() || cycles < 1 || cycles > 64)
+            return std::nullopt;
+        if (key == "alu")
+            model.alu = cycles;
+        else if (key == "load")
+            model.load = cycles;
+        else if (key == "mul")
+            model.mul = cycles;
+        else if (key == "div")
+            model.div = cycles;
+        else
+            return std::nullopt;
+    }
+    return model;
+}
+
+std::string latencyModelNames() {
+    std::string names;
+    for (const LatencyModel &m : kPresets)
+        names += (names.empty() ? "" : ", ") + m.name;
+    return names;
+}
+
+#pragma endregion
+
+#pragma region 调度入口
+
+/**
+ * @brief 逐块调度
+ * @details 原顺序没有停顿的块不建图；调度结果按模型估计的周期数少于原顺序时才采用，
+ *   消除的停顿周期数计入 --stats 的 sched-stalls-removed
+ */
+int scheduleBlocks(MachineFunction &MF, const LatencyModel &model) {
+    int removed = 0;
+    DepGraph G;
+    for (auto &MBB : MF.blocks) {
+        if (MBB.insts.size() < 2 || stallFree(MBB, model))
+            continue;
+        buildGraph(MBB, MF, model, G);
+        std::vector<int> original(G.size());
+        for (size_t i = 0; i < G.size(); ++i)
+            original[i] = static_cast<int>(i);
+        const std::vector<int> order = listSchedule(G);
+        const int saved = issueCycles(G, original) - issueCycles(G, order);
+        if (saved <= 0)
+            continue;
+        std::vector<MachineInstr> insts;
+        insts.reserve(order.size());
+        for (int i : order)
+            insts.push_back(MBB.insts[i]);
+        MBB.insts = std::move(insts);
+        removed += saved;
+    }
+    stats::add(stats::Counter::StallsRemoved, static_cast<uint64_t>(removed));
+    return removed;
+}
+
+#pragma endregion
+
+} // namespace mir
+} // namespace toyc
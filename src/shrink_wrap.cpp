@@ -0,0 +1,204 @@
+#include "machine_ir.h"
+#include "statistics.h"
+#include <algorithm>
+
+namespace toyc {
+namespace mir {
+
+namespace {
+
+constexpr int kSP = 2, kS0 = 8;
+
+// isFramePseudo：栈帧伪指令（移动 / 删除它们正是本趟的工作，不算对栈帧的使用）
+bool isFramePseudo(const MachineInstr &MI) {
+    return MI.opcode == MOpcode::FrameSetup || MI.opcode == MOpcode::FrameDestroy;
+}
+
+/**
+ * @brief 块是否使用栈帧
+ * @details 读写 sp、（使用帧指针时）s0 或任何需要保存的被调用者保存寄存器，以及 call
+ *   （改写 ra，ra 必须先保存）；ret / tail 本身不使用栈帧
+ */
+bool usesFrame(const MachineFunction &MF, const MachineBasicBlock &MBB) {
+    auto isFrameReg = [&](int reg) {
+        if (reg < 0)
+            return false;
+        if (reg == kSP || (MF.framePointer && reg == kS0))
+            return true;
+        return std::find(MF.calleeSavedRegs.begin(), MF.calleeSavedRegs.end(), reg) !=
+               MF.calleeSavedRegs.end();
+    };
+    return std::any_of(MBB.insts.begin(), MBB.insts.end(), [&](const MachineInstr &MI) {
+        return !isFramePseudo(MI) && (MI.opcode == MOpcode::CALL || isFrameReg(MI.rd) ||
+                                      isFrameReg(MI.rs1) || isFrameReg(MI.rs2));
+    });
+}
+
+// hasFrameDestroy：块是否含 epilogue（ret / tail 之前）
+bool hasFrameDestroy(const MachineBasicBlock &MBB) {
+    return std::any_of(MBB.insts.begin(), MBB.insts.end(),
+                       [](const MachineInstr &MI) { return MI.opcode == MOpcode::FrameDestroy; });
+}
+
+// MachineDomTree：机器 CFG 的后继、逆后序与支配树（入口为块 0，只含可达块）
+struct MachineDomTree {
+    std::vector<std::vector<int>> succs;
+    std::vector<int> rpoIndex; // 逆后序编号（不可达块为 -1）
+    std::vector<int> idom;     // 直接支配者（入口为自身，不可达块为 -1）
+
+    explicit MachineDomTree(const MachineFunction &MF) {
+        const int n = static_cast<int>(MF.blocks.size());
+        succs.resize(n);
+        std::vector<std::vector<int>> preds(n);
+        for (int bi = 0; bi < n; ++bi)
+            for (const MachineInstr &MI : MF.blocks[bi].insts)
+                if (MI.opcode == MOpcode::J || MI.isBranch()) {
+                    succs[bi].push_back(MI.target);
+                    preds[MI.target].push_back(bi);
+                }
+
+        std::vector<int> postorder;
+        std::vector<char> visited(n, 0);
+        std::vector<std::pair<int, size_t>> stack = {{0, 0}};
+        visited[0] = 1;
+        while (!stack.empty()) {
+            auto &[bi, next] = stack.back();
+            if (next == succs[bi].size()) {
+                postorder.push_back(bi);
+                stack.pop_back();
+                continue;
+            }
+            const int s = succs[bi][next++];
+            if (!visited[s]) {
+                visited[s] = 1;
+                stack.push_back({s, 0});
+            }
+        }
+        rpoIndex.assign(n, -1);
+        for (size_t k = 0; k < postorder.size(); ++k)
+            rpoIndex[postorder[k]] = static_cast<int>(postorder.size() - 1 - k);
+
+        // Cooper-Harvey-Kennedy 迭代算法
+        idom.assign(n, -1);
+        idom[0] = 0;
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+                if (*it == 0)
+                    continue;
+                int dom = -1;
+                for (int p : preds[*it])
+                    if (idom[p] >= 0)
+                        dom = dom < 0 ? p : commonDominator(p, dom);
+                if (dom != idom[*it]) {
+                    idom[*it] = dom;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    bool reachable(int bi) const { return rpoIndex[bi] >= 0; }
+
+    // commonDominator：a 与 b 的最近公共支配者
+    int commonDominator(int a, int b) const {
+        while (a != b) {
+            while (rpoIndex[a] > rpoIndex[b])
+                a = idom[a];
+            while (rpoIndex[b] > rpoIndex[a])
+                b = idom[b];
+        }
+        return a;
+    }
+
+    bool dominates(int a, int b) const { return commonDominator(a, b) == a; }
+
+    // reachableFrom：从 from 出发（至少走一条边）能到达的块
+    std::vector<char> reachableFrom(int from) const {
+        std::vector<char> seen(succs.size(), 0);
+        std::vector<int> work = succs[from];
+        while (!work.empty()) {
+            const int bi = work.back();
+            work.pop_back();
+            if (seen[bi])
+                continue;
+            seen[bi] = 1;
+            work.insert(work.end(), succs[bi].begin(), succs[bi].end());
+        }
+        return seen;
+    }
+};
+
+} // namespace
+
+/**
+ * @brief 收缩包装：把 prologue 从入口移到第一个真正需要栈帧的位置
+ * @details 保存点 S 取所有使用栈帧的块的最近公共支配者，再按两条规则上移（沿支配树），直到都满足：
+ *   1. S 不在环上（否则 prologue 每次迭代都会执行）
+ *   2. 从 S 可达的每个含 epilogue 的块都被 S 支配（不会有路径不经过 prologue 却执行 epilogue）
+ *   FrameSetup 移到 S 的开头；不被 S 支配的返回路径（早返回）删除 FrameDestroy，既不建立也不撤销
+ *   栈帧。没有块使用栈帧时两种伪指令全部删除
+ */
+bool shrinkWrap(MachineFunction &MF) {
+    if (MF.blocks.empty() || MF.frameSize == 0)
+        return false;
+    auto &entry = MF.blocks[0].insts;
+    auto setup = std::find_if(entry.begin(), entry.end(), [](const MachineInstr &MI) {
+        return MI.opcode == MOpcode::FrameSetup;
+    });
+    if (setup == entry.end())
+        return false;
+
+    const MachineDomTree DT(MF);
+    const int n = static_cast<int>(MF.blocks.size());
+    int save = -1;
+    for (int bi = 0; bi < n; ++bi)
+        if (DT.reachable(bi) && usesFrame(MF, MF.blocks[bi]))
+            save = save < 0 ? bi : DT.commonDominator(save, bi);
+    if (save == 0)
+        return false;
+
+    if (save > 0) {
+        for (bool changed = true; changed && save != 0;) {
+            changed = false;
+            std::vector<char> after = DT.reachableFrom(save);
+            if (after[save]) {
+                save = DT.idom[save];
+                changed = true;
+                continue;
+            }
+            for (int bi = 0; bi < n; ++bi)
+                if (after[bi] && hasFrameDestroy(MF.blocks[bi]) && !DT.dominates(save, bi)) {
+                    save = DT.commonDominator(save, bi);
+                    changed = true;
+                    break;
+                }
+        }
+        if (save == 0)
+            return false;
+    }
+
+    const MachineInstr setupMI = *setup;
+    entry.erase(setup);
+    for (int bi = 0; bi < n; ++bi) {
+        auto &insts = MF.blocks[bi].insts;
+        if (save < 0 || !DT.reachable(bi) || !DT.dominates(save, bi))
+            insts.erase(std::remove_if(insts.begin(), insts.end(),
+                                       [](const MachineInstr &MI) {
+                                           return MI.opcode == MOpcode::FrameDestroy;
+                                       }),
+                        insts.end());
+    }
+    if (save > 0) {
+        auto &insts = MF.blocks[save].insts;
+        auto pos = insts.begin();
+        while (pos != insts.end() && pos->opcode == MOpcode::ProfCount)
+            ++pos;
+        insts.insert(pos, setupMI);
+    }
+    stats::add(stats::Counter::ShrinkWrapped);
+    return true;
+}
+
+} // namespace mir
+} // namespace toyc
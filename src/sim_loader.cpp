@@ -0,0 +1,1563 @@
+#include "simulator.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <set>
+#include <stdexcept>
+
+namespace toyc::sim {
+
+#pragma region 编码辅助
+
+namespace {
+
+// RISC-V psABI 重定位类型
+constexpr uint32_t R_RISCV_32 = 1, R_RISCV_BRANCH = 16, R_RISCV_JAL = 17, R_RISCV_CALL = 18,
+                   R_RISCV_CALL_PLT = 19, R_RISCV_PCREL_HI20 = 23, R_RISCV_PCREL_LO12_I = 24,
+                   R_RISCV_PCREL_LO12_S = 25, R_RISCV_HI20 = 26, R_RISCV_LO12_I = 27,
+                   R_RISCV_LO12_S = 28, R_RISCV_ALIGN = 43, R_RISCV_RVC_BRANCH = 44,
+                   R_RISCV_RVC_JUMP = 45, R_RISCV_RELAX = 51;
+
+// 基本操作码（inst[6:0]）
+constexpr uint32_t OP = 0x33, OP_IMM = 0x13, LOAD = 0x03, STORE = 0x23, BRANCH = 0x63,
+                   JAL = 0x6f, JALR = 0x67, LUI = 0x37, AUIPC = 0x17, SYSTEM = 0x73,
+                   MISC_MEM = 0x0f, OP_V = 0x57;
+
+constexpr int X0 = 0, RA = 1, SP = 2, T1 = 6;
+
+int32_t signExtend(uint32_t v, int bits) {
+    return static_cast<int32_t>(v << (32 - bits)) >> (32 - bits);
+}
+
+// bits：取 v[hi:lo] 放到第 at 位起（压缩格式的立即数字段大多是打乱的位片段）
+uint32_t bits(uint32_t v, int hi, int lo, int at) {
+    return (v >> lo & ((1u << (hi - lo + 1)) - 1)) << at;
+}
+
+uint32_t encR(uint32_t funct7, int rs2, int rs1, uint32_t funct3, int rd, uint32_t opcode) {
+    return funct7 << 25 | uint32_t(rs2) << 20 | uint32_t(rs1) << 15 | funct3 << 12 |
+           uint32_t(rd) << 7 | opcode;
+}
+
+uint32_t encI(uint32_t opcode, int rd, uint32_t funct3, int rs1, int32_t imm) {
+    return (uint32_t(imm) & 0xfff) << 20 | uint32_t(rs1) << 15 | funct3 << 12 | uint32_t(rd) << 7 |
+           opcode;
+}
+
+// 立即数字段的写入：先清除原字段再写入（汇编器为符号引用预留 0，链接时改写）
+uint32_t setImmI(uint32_t inst, int32_t imm) { return (inst & 0x000fffff) | uint32_t(imm) << 20; }
+
+uint32_t setImmS(uint32_t inst, int32_t imm) {
+    uint32_t u = uint32_t(imm);
+    return (inst & 0x01fff07f) | bits(u, 11, 5, 25) | bits(u, 4, 0, 7);
+}
+
+uint32_t setImmB(uint32_t inst, int32_t off) {
+    uint32_t u = uint32_t(off);
+    return (inst & 0x01fff07f) | bits(u, 12, 12, 31) | bits(u, 10, 5, 25) | bits(u, 4, 1, 8) |
+           bits(u, 11, 11, 7);
+}
+
+uint32_t setImmU(uint32_t inst, uint32_t hi20) { return (inst & 0xfff) | (hi20 & 0xfffff) << 12; }
+
+uint32_t setImmJ(uint32_t inst, int32_t off) {
+    uint32_t u = uint32_t(off);
+    return (inst & 0xfff) | bits(u, 20, 20, 31) | bits(u, 10, 1, 21) | bits(u, 11, 11, 20) |
+           bits(u, 19, 12, 12);
+}
+
+// setImmCB / setImmCJ：c.beqz / c.bnez 与 c.j / c.jal 的偏移字段
+uint16_t setImmCB(uint16_t inst, int32_t off) {
+    uint32_t u = uint32_t(off);
+    return static_cast<uint16_t>((inst & 0xe383) | bits(u, 8, 8, 12) | bits(u, 4, 3, 10) |
+                                 bits(u, 7, 6, 5) | bits(u, 2, 1, 3) | bits(u, 5, 5, 2));
+}
+
+uint16_t setImmCJ(uint16_t inst, int32_t off) {
+    uint32_t u = uint32_t(off);
+    return static_cast<uint16_t>((inst & 0xe003) | bits(u, 11, 11, 12) | bits(u, 4, 4, 11) |
+                                 bits(u, 9, 8, 9) | bits(u, 10, 10, 8) | bits(u, 6, 6, 7) |
+                                 bits(u, 7, 7, 6) | bits(u, 3, 1, 3) | bits(u, 5, 5, 2));
+}
+
+// hi20 / lo12：32 位值拆为 lui / auipc 的高 20 位与符号扩展的低 12 位
+uint32_t hi20(uint32_t v) { return (v + 0x800) >> 12 & 0xfffff; }
+int32_t lo12(uint32_t v) { return signExtend(v & 0xfff, 12); }
+
+uint32_t read32(const std::vector<uint8_t> &b, size_t off) {
+    return uint32_t(b[off]) | uint32_t(b[off + 1]) << 8 | uint32_t(b[off + 2]) << 16 |
+           uint32_t(b[off + 3]) << 24;
+}
+
+void write32(std::vector<uint8_t> &b, size_t off, uint32_t v) {
+    for (int i = 0; i < 4; ++i)
+        b[off + i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+uint16_t read16(const std::vector<uint8_t> &b, size_t off) {
+    return static_cast<uint16_t>(b[off] | b[off + 1] << 8);
+}
+
+void write16(std::vector<uint8_t> &b, size_t off, uint16_t v) {
+    b[off] = static_cast<uint8_t>(v);
+    b[off + 1] = static_cast<uint8_t>(v >> 8);
+}
+
+} // namespace
+
+#pragma endregion
+
+#pragma region 汇编器
+
+namespace {
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t' || s.front() == '\r'))
+        s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+        s.remove_suffix(1);
+    return s;
+}
+
+bool isIdentChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '.' || c == '$';
+}
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// parseReg：ABI 名或 x0-x31，不是整数寄存器时返回 -1
+int parseReg(std::string_view s) {
+    static const char *const kNames[] = {"zero", "ra", "sp", "gp", "tp",  "t0",  "t1", "t2",
+                                         "s0",   "s1", "a0", "a1", "a2",  "a3",  "a4", "a5",
+                                         "a6",   "a7", "s2", "s3", "s4",  "s5",  "s6", "s7",
+                                         "s8",   "s9", "s10", "s11", "t3", "t4", "t5", "t6"};
+    for (int i = 0; i < 32; ++i)
+        if (s == kNames[i])
+            return i;
+    if (s == "fp")
+        return 8;
+    if (s.size() >= 2 && s.size() <= 3 && s[0] == 'x' && isDigit(s[1]) &&
+        (s.size() == 2 || isDigit(s[2]))) {
+        int n = std::stoi(std::string(s.substr(1)));
+        return n < 32 ? n : -1;
+    }
+    return -1;
+}
+
+// parseVReg：v0-v31，否则返回 -1
+int parseVReg(std::string_view s) {
+    if (s.size() < 2 || s.size() > 3 || s[0] != 'v' || !isDigit(s[1]) ||
+        (s.size() == 3 && !isDigit(s[2])))
+        return -1;
+    int n = std::stoi(std::string(s.substr(1)));
+    return n < 32 ? n : -1;
+}
+
+// parseNumber：十进制 / 0x 十六进制 / 0b 二进制 / 前导 0 的八进制（与 GNU as 相同）/ 'c' 字符
+std::optional<int64_t> parseNumber(std::string_view s) {
+    if (s.size() == 3 && s[0] == '\'' && s[2] == '\'')
+        return s[1];
+    if (s.empty() || !isDigit(s[0]))
+        return std::nullopt;
+    int base = 10;
+    size_t i = 0;
+    if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        i = 2;
+    } else if (s.size() > 2 && s[0] == '0' && (s[1] == 'b' || s[1] == 'B')) {
+        base = 2;
+        i = 2;
+    } else if (s.size() > 1 && s[0] == '0') {
+        base = 8;
+        i = 1;
+    }
+    int64_t v = 0;
+    for (; i < s.size(); ++i) {
+        char c = static_cast<char>(s[i] | 0x20);
+        int d = isDigit(s[i]) ? s[i] - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : 99;
+        if (d >= base)
+            return std::nullopt;
+        v = v * base + d;
+        if (v > 0xffffffffLL)
+            return std::nullopt;
+    }
+    return v;
+}
+
+// Expr：操作数表达式 [%修饰符(] [符号] [± 常数] [)]
+struct Expr {
+    enum class Mod : uint8_t { None, Hi, Lo, PcrelHi, PcrelLo };
+    Mod mod = Mod::None;
+    std::string symbol; // 空表示纯常数
+    int64_t value = 0;
+};
+
+// splitOperands：按顶层逗号切分操作数（括号与字符串内的逗号不算）
+std::vector<std::string_view> splitOperands(std::string_view s) {
+    std::vector<std::string_view> out;
+    s = trim(s);
+    if (s.empty())
+        return out;
+    int depth = 0;
+    bool quoted = false;
+    size_t start = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (quoted) {
+            if (c == '\\')
+                ++i;
+            else if (c == '"')
+                quoted = false;
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == '(') {
+            ++depth;
+        } else if (c == ')') {
+            --depth;
+        } else if (c == ',' && depth == 0) {
+            out.push_back(trim(s.substr(start, i - start)));
+            start = i + 1;
+        }
+    }
+    out.push_back(trim(s.substr(start)));
+    return out;
+}
+
+// kCrt0：内置启动代码（与 scripts/crt0.s 相同）
+constexpr const char *kCrt0 = R"(
+    .text
+    .globl _start
+    .weak __toyc_prof_dump
+_start:
+    call main
+    lui t0, %hi(__toyc_prof_dump)
+    addi t0, t0, %lo(__toyc_prof_dump)
+    beqz t0, 1f
+    mv s1, a0
+    jalr t0
+    mv a0, s1
+1:
+    li a7, 93
+    ecall
+)";
+
+/**
+ * @brief 单遍汇编器
+ * @details 逐行处理：标号、伪指令（节切换 / 符号属性 / 数据 / 对齐）与指令。对符号的引用（分支目标、
+ *   call、%hi / %lo、.word sym）一律记为重定位、在对应字段填 0，由 link 统一解析，因此向前引用不需要
+ *   第二遍。数字标号（1: / 1f / 1b）按出现次序改名为各自独立的局部符号
+ */
+class Assembler {
+  public:
+    // longBranches：需要放宽为 "反转分支 + jal" 的条件分支（按在文本中出现的序号）
+    Assembler(const std::string &name, const std::set<uint32_t> &longBranches)
+        : longBranches_(longBranches) {
+        obj_.name = name;
+    }
+
+    ObjectFile run(std::string_view text);
+    bool findLongBranches(const ObjectFile &obj, std::set<uint32_t> &longBranches) const;
+
+  private:
+    ObjectFile obj_;
+    int section_ = -1;                                 // 当前节
+    std::unordered_map<std::string, int> symIndex_;    // 符号名 → obj_.symbols 下标
+    std::unordered_map<std::string, int> numericDefs_; // 数字标号 → 已定义次数
+    int lineNo_ = 0;
+    int tempCount_ = 0;
+    const std::set<uint32_t> &longBranches_;
+    uint32_t branchCount_ = 0;                               // 已输出的条件分支数
+    std::vector<std::pair<uint32_t, size_t>> shortBranches_; // (分支序号, 重定位下标)
+
+    [[noreturn]] void error(const std::string &msg) const {
+        throw std::runtime_error(obj_.name + ":" + std::to_string(lineNo_) + ": " + msg);
+    }
+
+    Section &cur() {
+        if (section_ < 0)
+            switchSection(".text");
+        return obj_.sections[section_];
+    }
+    uint32_t here() { return cur().size; }
+
+    void switchSection(const std::string &name, const std::string *flags = nullptr);
+    int symbol(const std::string &name);
+    void defineLabel(const std::string &name);
+    std::string tempLabel();
+    std::string resolveNumericRef(std::string_view ref);
+
+    void line(std::string_view text);
+    void directive(std::string_view name, std::string_view args);
+    void instruction(std::string_view mnemonic, const std::vector<std::string_view> &ops);
+
+    // 数据输出
+    void emitByte(uint8_t b);
+    void emit16(uint16_t v);
+    void emit32(uint32_t v);
+    void alignTo(uint32_t align);
+    std::string parseString(std::string_view s);
+
+    // 操作数解析
+    Expr expr(std::string_view s);
+    int64_t constant(std::string_view s, int64_t lo, int64_t hi);
+    int reg(std::string_view s);
+    int vreg(std::string_view s);
+    void mem(std::string_view s, Expr &offset, int &base);
+    void reloc(uint32_t type, const Expr &e);
+
+    // 指令输出
+    void emitI(uint32_t funct3, uint32_t opcode, int rd, int rs1, std::string_view immText,
+               bool load);
+    void emitBranch(uint32_t funct3, int rs1, int rs2, std::string_view target);
+    void emitJal(int rd, std::string_view target);
+    void emitCall(int linkReg, std::string_view target);
+    void emitLi(int rd, int64_t value);
+    void emitCompressed(std::string_view m, const std::vector<std::string_view> &ops);
+};
+
+// switchSection：切换到（必要时新建）节；没有 flags 时按节名推断属性
+void Assembler::switchSection(const std::string &name, const std::string *flags) {
+    for (size_t i = 0; i < obj_.sections.size(); ++i)
+        if (obj_.sections[i].name == name) {
+            section_ = static_cast<int>(i);
+            return;
+        }
+    Section s;
+    s.name = name;
+    auto starts = [&](const char *prefix) { return name.rfind(prefix, 0) == 0; };
+    if (flags) {
+        s.exec = flags->find('x') != std::string::npos;
+        s.write = flags->find('w') != std::string::npos;
+    } else {
+        s.exec = starts(".text");
+        s.write = starts(".data") || starts(".sdata") || starts(".bss") || starts(".sbss");
+    }
+    s.nobits = starts(".bss") || starts(".sbss");
+    s.align = s.exec ? 2 : 1;
+    obj_.sections.push_back(std::move(s));
+    section_ = static_cast<int>(obj_.sections.size() - 1);
+}
+
+int Assembler::symbol(const std::string &name) {
+    auto [it, inserted] = symIndex_.emplace(name, static_cast<int>(obj_.symbols.size()));
+    if (inserted) {
+        Symbol sym;
+        sym.name = name;
+        obj_.symbols.push_back(std::move(sym));
+    }
+    return it->second;
+}
+
+void Assembler::defineLabel(const std::string &name) {
+    const uint32_t offset = here();
+    Symbol &sym = obj_.symbols[symbol(name)];
+    if (sym.section != -1)
+        error("symbol '" + name + "' is already defined");
+    sym.section = section_;
+    sym.value = offset;
+}
+
+std::string Assembler::tempLabel() {
+    std::string name = ".Ltmp$" + std::to_string(tempCount_++);
+    defineLabel(name);
+    return name;
+}
+
+// resolveNumericRef：1b → 最近一次定义的 1:，1f → 下一次定义的 1:
+std::string Assembler::resolveNumericRef(std::string_view ref) {
+    std::string num(ref.substr(0, ref.size() - 1));
+    int defs = numericDefs_[num];
+    if (ref.back() == 'b') {
+        if (defs == 0)
+            error("backward reference to undefined label '" + num + "'");
+        --defs;
+    }
+    return ".Lnum$" + num + "$" + std::to_string(defs);
+}
+
+ObjectFile Assembler::run(std::string_view text) {
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string_view::npos)
+            eol = text.size();
+        ++lineNo_;
+        line(text.substr(pos, eol - pos));
+        pos = eol + 1;
+    }
+    for (Symbol &sym : obj_.symbols)
+        if (sym.section == -1) {
+            if (sym.name.rfind(".L", 0) == 0)
+                throw std::runtime_error(obj_.name + ": undefined local label '" + sym.name + "'");
+            if (sym.binding == Symbol::Binding::Local)
+                sym.binding = Symbol::Binding::Global; // 外部符号
+        }
+    return std::move(obj_);
+}
+
+void Assembler::line(std::string_view text) {
+    // 去掉注释（字符串内的 # 保留）
+    bool quoted = false;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (quoted) {
+            if (text[i] == '\\')
+                ++i;
+            else if (text[i] == '"')
+                quoted = false;
+        } else if (text[i] == '"') {
+            quoted = true;
+        } else if (text[i] == '#') {
+            text = text.substr(0, i);
+            break;
+        }
+    }
+    text = trim(text);
+    // toyc 输出到 stdout 时的分段标题（=== RISC-V Assembly ===）
+    if (text.rfind("===", 0) == 0)
+        return;
+    // 行首的标号（可以有多个）
+    for (;;) {
+        size_t i = 0;
+        while (i < text.size() && isIdentChar(text[i]))
+            ++i;
+        if (i == 0 || i >= text.size() || text[i] != ':')
+            break;
+        std::string_view name = text.substr(0, i);
+        if (std::all_of(name.begin(), name.end(), isDigit)) {
+            std::string num(name);
+            defineLabel(".Lnum$" + num + "$" + std::to_string(numericDefs_[num]++));
+        } else {
+            defineLabel(std::string(name));
+        }
+        text = trim(text.substr(i + 1));
+    }
+    if (text.empty())
+        return;
+    size_t sp = text.find_first_of(" \t");
+    std::string_view head = text.substr(0, sp);
+    std::string_view rest = sp == std::string_view::npos ? std::string_view() : text.substr(sp);
+    if (head[0] == '.')
+        directive(head, trim(rest));
+    else
+        instruction(head, splitOperands(rest));
+}
+
+void Assembler::emitByte(uint8_t b) {
+    Section &s = cur();
+    if (s.nobits) {
+        if (b != 0)
+            error("non-zero data in nobits section '" + s.name + "'");
+    } else {
+        s.data.push_back(b);
+    }
+    ++s.size;
+}
+
+void Assembler::emit16(uint16_t v) {
+    emitByte(static_cast<uint8_t>(v));
+    emitByte(static_cast<uint8_t>(v >> 8));
+}
+
+void Assembler::emit32(uint32_t v) {
+    emit16(static_cast<uint16_t>(v));
+    emit16(static_cast<uint16_t>(v >> 16));
+}
+
+// alignTo：代码节用 nop / c.nop 填充，数据节用 0 填充
+void Assembler::alignTo(uint32_t align) {
+    Section &s = cur();
+    s.align = std::max(s.align, align);
+    while (s.size % align != 0) {
+        if (s.exec && s.size % 4 == 0 && align >= 4)
+            emit32(encI(OP_IMM, X0, 0, X0, 0));
+        else if (s.exec && s.size % 2 == 0)
+            emit16(0x0001);
+        else
+            emitByte(0);
+    }
+}
+
+std::string Assembler::parseString(std::string_view s) {
+    if (s.size() < 2 || s.front() != '"' || s.back() != '"')
+        error("expected string literal");
+    std::string out;
+    for (size_t i = 1; i + 1 < s.size(); ++i) {
+        char c = s[i];
+        if (c != '\\') {
+            out.push_back(c);
+            continue;
+        }
+        if (++i + 1 >= s.size())
+            error("bad escape in string literal");
+        if (s[i] >= '0' && s[i] <= '7') { // 最多 3 位八进制
+            int v = 0;
+            for (int k = 0; k < 3 && i + 1 < s.size() && s[i] >= '0' && s[i] <= '7'; ++k, ++i)
+                v = v * 8 + (s[i] - '0');
+            --i;
+            out.push_back(static_cast<char>(v));
+            continue;
+        }
+        switch (s[i]) {
+        case 'n':
+            out.push_back('\n');
+            break;
+        case 't':
+            out.push_back('\t');
+            break;
+        case 'r':
+            out.push_back('\r');
+            break;
+        default:
+            out.push_back(s[i]);
+        }
+    }
+    return out;
+}
+
+void Assembler::directive(std::string_view name, std::string_view args) {
+    const std::vector<std::string_view> ops = splitOperands(args);
+    auto need = [&](size_t n) {
+        if (ops.size() < n)
+            error("missing operand for '" + std::string(name) + "'");
+    };
+    if (name == ".text" || name == ".data" || name == ".bss" || name == ".rodata") {
+        switchSection(std::string(name));
+    } else if (name == ".section") {
+        need(1);
+        const std::string flags = ops.size() > 1 ? parseString(ops[1]) : std::string();
+        switchSection(std::string(ops[0]), ops.size() > 1 ? &flags : nullptr);
+        if (ops.size() > 2 && ops[2] == "@nobits")
+            cur().nobits = true;
+    } else if (name == ".globl" || name == ".global" || name == ".weak" || name == ".local") {
+        need(1);
+        for (std::string_view op : ops) {
+            Symbol &sym = obj_.symbols[symbol(std::string(op))];
+            sym.binding = name == ".weak"    ? Symbol::Binding::Weak
+                          : name == ".local" ? Symbol::Binding::Local
+                                             : Symbol::Binding::Global;
+        }
+    } else if (name == ".p2align" || name == ".align" || name == ".balign") {
+        need(1);
+        int64_t n = constant(ops[0], 0, name == ".balign" ? 4096 : 12);
+        alignTo(name == ".balign" ? static_cast<uint32_t>(std::max<int64_t>(n, 1)) : 1u << n);
+    } else if (name == ".word" || name == ".4byte" || name == ".long") {
+        need(1);
+        for (std::string_view op : ops) {
+            Expr e = expr(op);
+            if (!e.symbol.empty())
+                reloc(R_RISCV_32, e);
+            emit32(e.symbol.empty() ? static_cast<uint32_t>(e.value) : 0);
+        }
+    } else if (name == ".half" || name == ".2byte" || name == ".short") {
+        need(1);
+        for (std::string_view op : ops)
+            emit16(static_cast<uint16_t>(constant(op, -32768, 65535)));
+    } else if (name == ".byte") {
+        need(1);
+        for (std::string_view op : ops)
+            emitByte(static_cast<uint8_t>(constant(op, -128, 255)));
+    } else if (name == ".zero" || name == ".space" || name == ".skip") {
+        need(1);
+        int64_t n = constant(ops[0], 0, 1 << 24);
+        for (int64_t i = 0; i < n; ++i)
+            emitByte(0);
+    } else if (name == ".ascii" || name == ".asciz" || name == ".string") {
+        need(1);
+        for (std::string_view op : ops) {
+            for (char c : parseString(op))
+                emitByte(static_cast<uint8_t>(c));
+            if (name != ".ascii")
+                emitByte(0);
+        }
+    } else if (name == ".option" || name == ".file" || name == ".ident" || name == ".type" ||
+               name == ".size" || name == ".attribute" || name == ".addrsig" ||
+               name == ".addrsig_sym" || name == ".loc" || name.rfind(".cfi_", 0) == 0) {
+        // 不影响代码与数据的伪指令（.option rvc / arch 由指令本身的写法决定）
+    } else {
+        error("unsupported directive '" + std::string(name) + "'");
+    }
+}
+
+Expr Assembler::expr(std::string_view s) {
+    Expr e;
+    s = trim(s);
+    if (!s.empty() && s[0] == '%') {
+        size_t open = s.find('(');
+        if (open == std::string_view::npos || s.back() != ')')
+            error("malformed relocation operand '" + std::string(s) + "'");
+        std::string_view mod = s.substr(1, open - 1);
+        e.mod = mod == "hi"          ? Expr::Mod::Hi
+                : mod == "lo"        ? Expr::Mod::Lo
+                : mod == "pcrel_hi"  ? Expr::Mod::PcrelHi
+                : mod == "pcrel_lo"  ? Expr::Mod::PcrelLo
+                                     : (error("unknown modifier '%" + std::string(mod) + "'"),
+                                        Expr::Mod::None);
+        s = trim(s.substr(open + 1, s.size() - open - 2));
+    }
+    // 项：[符号 | 常数]，以 + / - 连接
+    size_t i = 0;
+    while (i < s.size()) {
+        int sign = 1;
+        while (i < s.size() && (s[i] == '+' || s[i] == '-' || s[i] == ' ')) {
+            if (s[i] == '-')
+                sign = -sign;
+            ++i;
+        }
+        size_t j = i;
+        if (j < s.size() && s[j] == '\'')
+            j = std::min(s.size(), j + 3);
+        else
+            while (j < s.size() && isIdentChar(s[j]))
+                ++j;
+        std::string_view term = s.substr(i, j - i);
+        if (term.empty())
+            error("malformed expression '" + std::string(s) + "'");
+        if (auto n = parseNumber(term)) {
+            e.value += sign * *n;
+        } else if (term.size() >= 2 && (term.back() == 'f' || term.back() == 'b') &&
+                   std::all_of(term.begin(), term.end() - 1, isDigit)) {
+            if (!e.symbol.empty() || sign < 0)
+                error("unsupported expression '" + std::string(s) + "'");
+            e.symbol = resolveNumericRef(term);
+        } else if (!isDigit(term[0])) {
+            if (!e.symbol.empty() || sign < 0)
+                error("unsupported expression '" + std::string(s) + "'");
+            e.symbol = term == "." ? tempLabel() : std::string(term);
+        } else {
+            error("bad number '" + std::string(term) + "'");
+        }
+        i = j;
+        while (i < s.size() && s[i] == ' ')
+            ++i;
+    }
+    return e;
+}
+
+int64_t Assembler::constant(std::string_view s, int64_t lo, int64_t hi) {
+    Expr e = expr(s);
+    if (!e.symbol.empty() || e.mod != Expr::Mod::None)
+        error("expected constant, got '" + std::string(s) + "'");
+    if (e.value < lo || e.value > hi)
+        error("immediate " + std::to_string(e.value) + " out of range [" + std::to_string(lo) +
+              ", " + std::to_string(hi) + "]");
+    return e.value;
+}
+
+int Assembler::reg(std::string_view s) {
+    int r = parseReg(s);
+    if (r < 0)
+        error("expected register, got '" + std::string(s) + "'");
+    return r;
+}
+
+int Assembler::vreg(std::string_view s) {
+    int r = parseVReg(s);
+    if (r < 0)
+        error("expected vector register, got '" + std::string(s) + "'");
+    return r;
+}
+
+// mem：解析 offset(base)，offset 可为空、常数或 %lo(sym)
+void Assembler::mem(std::string_view s, Expr &offset, int &base) {
+    s = trim(s);
+    if (s.empty() || s.back() != ')')
+        error("expected memory operand, got '" + std::string(s) + "'");
+    size_t open = s.rfind('(');
+    if (open == std::string_view::npos)
+        error("expected memory operand, got '" + std::string(s) + "'");
+    base = reg(trim(s.substr(open + 1, s.size() - open - 2)));
+    std::string_view off = trim(s.substr(0, open));
+    offset = off.empty() ? Expr() : expr(off);
+}
+
+void Assembler::reloc(uint32_t type, const Expr &e) {
+    const uint32_t offset = here();
+    obj_.relocs.push_back(
+        {section_, offset, type, symbol(e.symbol), static_cast<int32_t>(e.value)});
+}
+
+// emitI：I 型指令（算术立即数或 load），立即数可为常数或 %lo(sym) / %pcrel_lo(label)
+void Assembler::emitI(uint32_t funct3, uint32_t opcode, int rd, int rs1, std::string_view immText,
+                      bool load) {
+    Expr e;
+    if (load)
+        mem(immText, e, rs1);
+    else
+        e = expr(immText);
+    int32_t imm = 0;
+    if (e.mod == Expr::Mod::Lo || e.mod == Expr::Mod::PcrelLo) {
+        if (e.symbol.empty())
+            imm = lo12(static_cast<uint32_t>(e.value));
+        else
+            reloc(e.mod == Expr::Mod::Lo ? R_RISCV_LO12_I : R_RISCV_PCREL_LO12_I, e);
+    } else if (e.mod != Expr::Mod::None || !e.symbol.empty()) {
+        error("unexpected symbol operand '" + std::string(immText) + "'");
+    } else if (e.value < -2048 || e.value > 2047) {
+        error("immediate " + std::to_string(e.value) + " out of range [-2048, 2047]");
+    } else {
+        imm = static_cast<int32_t>(e.value);
+    }
+    emit32(encI(opcode, rd, funct3, rs1, imm));
+}
+
+// emitBranch：B 型条件分支；放宽的分支改为反转条件跳过紧随的 jal（与 ELFObjectWriter 相同）
+void Assembler::emitBranch(uint32_t funct3, int rs1, int rs2, std::string_view target) {
+    Expr e = expr(target);
+    if (e.symbol.empty())
+        error("branch target must be a label");
+    const uint32_t index = branchCount_++;
+    if (longBranches_.count(index)) {
+        emit32(setImmB(encR(0, rs2, rs1, funct3 ^ 1, 0, BRANCH), 8));
+        reloc(R_RISCV_JAL, e);
+        emit32(JAL);
+        return;
+    }
+    shortBranches_.emplace_back(index, obj_.relocs.size());
+    reloc(R_RISCV_BRANCH, e);
+    emit32(encR(0, rs2, rs1, funct3, 0, BRANCH));
+}
+
+void Assembler::emitJal(int rd, std::string_view target) {
+    Expr e = expr(target);
+    if (e.symbol.empty())
+        error("jump target must be a label");
+    reloc(R_RISCV_JAL, e);
+    emit32(uint32_t(rd) << 7 | JAL);
+}
+
+// emitCall：call / tail 展开为 auipc + jalr（R_RISCV_CALL_PLT）
+void Assembler::emitCall(int linkReg, std::string_view target) {
+    Expr e = expr(target);
+    if (e.symbol.empty() || e.mod != Expr::Mod::None)
+        error("call target must be a symbol");
+    const int scratch = linkReg == X0 ? T1 : RA;
+    reloc(R_RISCV_CALL_PLT, e);
+    emit32(uint32_t(scratch) << 7 | AUIPC);
+    emit32(encI(JALR, linkReg, 0, scratch, 0));
+}
+
+// emitLi：li 展开为 addi / lui / lui + addi（与 GNU as 相同的选择）
+void Assembler::emitLi(int rd, int64_t value) {
+    const uint32_t v = static_cast<uint32_t>(value);
+    const int32_t lo = lo12(v);
+    const uint32_t hi = hi20(v);
+    if (hi == 0) {
+        emit32(encI(OP_IMM, rd, 0, X0, lo));
+        return;
+    }
+    emit32(hi << 12 | uint32_t(rd) << 7 | LUI);
+    if (lo != 0)
+        emit32(encI(OP_IMM, rd, 0, rd, lo));
+}
+
+// emitCompressed：c.* 助记符（toyc 输出的压缩形式与常用的 c.j / c.beqz / c.bnez / c.nop）
+void Assembler::emitCompressed(std::string_view m, const std::vector<std::string_view> &ops) {
+    auto need = [&](size_t n) {
+        if (ops.size() != n)
+            error("wrong number of operands for '" + std::string(m) + "'");
+    };
+    auto creg = [&](std::string_view s) {
+        int r = reg(s);
+        if (r < 8 || r > 15)
+            error("register '" + std::string(s) + "' is not one of x8-x15");
+        return uint32_t(r - 8);
+    };
+    auto imm6 = [&](std::string_view s) {
+        return static_cast<uint32_t>(constant(s, -32, 31));
+    };
+    auto ci = [&](uint32_t funct3, uint32_t rd, uint32_t imm, uint32_t op) {
+        emit16(static_cast<uint16_t>(funct3 << 13 | bits(imm, 5, 5, 12) | rd << 7 |
+                                     bits(imm, 4, 0, 2) | op));
+    };
+    auto cr = [&](uint32_t funct4, uint32_t rd, uint32_t rs2) {
+        emit16(static_cast<uint16_t>(funct4 << 12 | rd << 7 | rs2 << 2 | 2));
+    };
+    auto memOff = [&](std::string_view s, int &base, int64_t max, int scale) {
+        Expr e;
+        mem(s, e, base);
+        if (!e.symbol.empty() || e.mod != Expr::Mod::None || e.value < 0 || e.value > max ||
+            e.value % scale != 0)
+            error("bad offset in '" + std::string(s) + "'");
+        return static_cast<uint32_t>(e.value);
+    };
+    if (m == "c.nop") {
+        need(0);
+        emit16(0x0001);
+    } else if (m == "c.ebreak") {
+        need(0);
+        emit16(0x9002);
+    } else if (m == "c.li") {
+        need(2);
+        ci(2, uint32_t(reg(ops[0])), imm6(ops[1]), 1);
+    } else if (m == "c.addi") {
+        need(2);
+        ci(0, uint32_t(reg(ops[0])), imm6(ops[1]), 1);
+    } else if (m == "c.lui") {
+        need(2);
+        int64_t v = constant(ops[1], 1, 0xfffff);
+        if (v > 31 && v < 0xfffe0)
+            error("immediate out of range for c.lui");
+        ci(3, uint32_t(reg(ops[0])), static_cast<uint32_t>(v), 1);
+    } else if (m == "c.slli") {
+        need(2);
+        ci(0, uint32_t(reg(ops[0])), static_cast<uint32_t>(constant(ops[1], 1, 31)), 2);
+    } else if (m == "c.srli" || m == "c.srai" || m == "c.andi") {
+        need(2);
+        uint32_t rd = creg(ops[0]);
+        uint32_t imm = m == "c.andi" ? imm6(ops[1]) : uint32_t(constant(ops[1], 1, 31));
+        uint32_t funct2 = m == "c.srli" ? 0 : m == "c.srai" ? 1 : 2;
+        emit16(static_cast<uint16_t>(4 << 13 | bits(imm, 5, 5, 12) | funct2 << 10 | rd << 7 |
+                                     bits(imm, 4, 0, 2) | 1));
+    } else if (m == "c.sub" || m == "c.xor" || m == "c.or" || m == "c.and") {
+        need(2);
+        uint32_t funct2 = m == "c.sub" ? 0 : m == "c.xor" ? 1 : m == "c.or" ? 2 : 3;
+        emit16(static_cast<uint16_t>(0x8c01 | creg(ops[0]) << 7 | funct2 << 5 | creg(ops[1]) << 2));
+    } else if (m == "c.mv" || m == "c.add") {
+        need(2);
+        int rs2 = reg(ops[1]);
+        if (rs2 == X0)
+            error("'" + std::string(m) + "' source cannot be zero");
+        cr(m == "c.mv" ? 8 : 9, uint32_t(reg(ops[0])), uint32_t(rs2));
+    } else if (m == "c.jr" || m == "c.jalr") {
+        need(1);
+        cr(m == "c.jr" ? 8 : 9, uint32_t(reg(ops[0])), 0);
+    } else if (m == "c.addi16sp") {
+        need(2);
+        int64_t v = constant(ops[1], -512, 496);
+        if (v == 0 || v % 16 != 0 || reg(ops[0]) != SP)
+            error("bad operands for c.addi16sp");
+        uint32_t u = static_cast<uint32_t>(v);
+        emit16(static_cast<uint16_t>(3 << 13 | bits(u, 9, 9, 12) | SP << 7 | bits(u, 4, 4, 6) |
+                                     bits(u, 6, 6, 5) | bits(u, 8, 7, 3) | bits(u, 5, 5, 2) | 1));
+    } else if (m == "c.addi4spn") {
+        need(3);
+        uint32_t rd = creg(ops[0]);
+        int64_t v = constant(ops[2], 4, 1020);
+        if (v % 4 != 0 || reg(ops[1]) != SP)
+            error("bad operands for c.addi4spn");
+        uint32_t u = static_cast<uint32_t>(v);
+        emit16(static_cast<uint16_t>(bits(u, 5, 4, 11) | bits(u, 9, 6, 7) | bits(u, 2, 2, 6) |
+                                     bits(u, 3, 3, 5) | rd << 2));
+    } else if (m == "c.lw" || m == "c.sw") {
+        need(2);
+        uint32_t r = creg(ops[0]);
+        int base;
+        uint32_t u = memOff(ops[1], base, 124, 4);
+        if (base < 8 || base > 15)
+            error("base register must be one of x8-x15");
+        emit16(static_cast<uint16_t>((m == "c.lw" ? 2 : 6) << 13 | bits(u, 5, 3, 10) |
+                                     uint32_t(base - 8) << 7 | bits(u, 2, 2, 6) |
+                                     bits(u, 6, 6, 5) | r << 2));
+    } else if (m == "c.lwsp") {
+        need(2);
+        int rd = reg(ops[0]), base;
+        uint32_t u = memOff(ops[1], base, 252, 4);
+        if (base != SP || rd == X0)
+            error("bad operands for c.lwsp");
+        emit16(static_cast<uint16_t>(2 << 13 | bits(u, 5, 5, 12) | uint32_t(rd) << 7 |
+                                     bits(u, 4, 2, 4) | bits(u, 7, 6, 2) | 2));
+    } else if (m == "c.swsp") {
+        need(2);
+        int rs2 = reg(ops[0]), base;
+        uint32_t u = memOff(ops[1], base, 252, 4);
+        if (base != SP)
+            error("bad operands for c.swsp");
+        emit16(static_cast<uint16_t>(6 << 13 | bits(u, 5, 2, 9) | bits(u, 7, 6, 7) |
+                                     uint32_t(rs2) << 2 | 2));
+    } else if (m == "c.j" || m == "c.jal") {
+        need(1);
+        Expr e = expr(ops[0]);
+        if (e.symbol.empty())
+            error("jump target must be a label");
+        reloc(R_RISCV_RVC_JUMP, e);
+        emit16(static_cast<uint16_t>((m == "c.j" ? 5 : 1) << 13 | 1));
+    } else if (m == "c.beqz" || m == "c.bnez") {
+        need(2);
+        uint32_t rs1 = creg(ops[0]);
+        Expr e = expr(ops[1]);
+        if (e.symbol.empty())
+            error("branch target must be a label");
+        reloc(R_RISCV_RVC_BRANCH, e);
+        emit16(static_cast<uint16_t>((m == "c.beqz" ? 6 : 7) << 13 | rs1 << 7 | 1));
+    } else {
+        error("unsupported instruction '" + std::string(m) + "'");
+    }
+}
+
+void Assembler::instruction(std::string_view m, const std::vector<std::string_view> &ops) {
+    if (!cur().exec)
+        error("instruction '" + std::string(m) + "' outside of a code section");
+    if (here() % 2 != 0)
+        error("misaligned instruction");
+    auto need = [&](size_t n) {
+        if (ops.size() != n)
+            error("wrong number of operands for '" + std::string(m) + "'");
+    };
+    if (m.rfind("c.", 0) == 0)
+        return emitCompressed(m, ops);
+
+    // R 型：add / sub / ... / mul / div / rem
+    struct RInfo {
+        const char *name;
+        uint32_t funct7, funct3;
+    };
+    static const RInfo kR[] = {
+        {"add", 0, 0},    {"sub", 0x20, 0},   {"sll", 0, 1},     {"slt", 0, 2},
+        {"sltu", 0, 3},   {"xor", 0, 4},      {"srl", 0, 5},     {"sra", 0x20, 5},
+        {"or", 0, 6},     {"and", 0, 7},      {"mul", 1, 0},     {"mulh", 1, 1},
+        {"mulhsu", 1, 2}, {"mulhu", 1, 3},    {"div", 1, 4},     {"divu", 1, 5},
+        {"rem", 1, 6},    {"remu", 1, 7},
+    };
+    for (const RInfo &r : kR)
+        if (m == r.name) {
+            need(3);
+            emit32(encR(r.funct7, reg(ops[2]), reg(ops[1]), r.funct3, reg(ops[0]), OP));
+            return;
+        }
+    // I 型算术立即数与移位
+    struct IInfo {
+        const char *name;
+        uint32_t funct3;
+    };
+    static const IInfo kI[] = {{"addi", 0}, {"slti", 2}, {"sltiu", 3},
+                               {"xori", 4}, {"ori", 6},  {"andi", 7}};
+    for (const IInfo &i : kI)
+        if (m == i.name) {
+            need(3);
+            emitI(i.funct3, OP_IMM, reg(ops[0]), reg(ops[1]), ops[2], false);
+            return;
+        }
+    if (m == "slli" || m == "srli" || m == "srai") {
+        need(3);
+        uint32_t shamt = static_cast<uint32_t>(constant(ops[2], 0, 31));
+        uint32_t funct7 = m == "srai" ? 0x20 : 0;
+        emit32(encR(funct7, static_cast<int>(shamt), reg(ops[1]), m == "slli" ? 1 : 5,
+                    reg(ops[0]), OP_IMM));
+        return;
+    }
+    // load / store
+    static const IInfo kLoad[] = {{"lb", 0}, {"lh", 1}, {"lw", 2}, {"lbu", 4}, {"lhu", 5}};
+    for (const IInfo &i : kLoad)
+        if (m == i.name) {
+            need(2);
+            emitI(i.funct3, LOAD, reg(ops[0]), 0, ops[1], true);
+            return;
+        }
+    static const IInfo kStore[] = {{"sb", 0}, {"sh", 1}, {"sw", 2}};
+    for (const IInfo &i : kStore)
+        if (m == i.name) {
+            need(2);
+            Expr e;
+            int base;
+            mem(ops[1], e, base);
+            int32_t imm = 0;
+            if (e.mod == Expr::Mod::Lo || e.mod == Expr::Mod::PcrelLo) {
+                if (e.symbol.empty())
+                    imm = lo12(static_cast<uint32_t>(e.value));
+                else
+                    reloc(e.mod == Expr::Mod::Lo ? R_RISCV_LO12_S : R_RISCV_PCREL_LO12_S, e);
+            } else if (!e.symbol.empty() || e.mod != Expr::Mod::None || e.value < -2048 ||
+                       e.value > 2047) {
+                error("bad store offset '" + std::string(ops[1]) + "'");
+            } else {
+                imm = static_cast<int32_t>(e.value);
+            }
+            emit32(setImmS(encR(0, reg(ops[0]), base, i.funct3, 0, STORE), imm));
+            return;
+        }
+    // 条件分支（含交换操作数的 bgt / ble / bgtu / bleu 与比较 x0 的 beqz 等）
+    static const IInfo kBranch[] = {{"beq", 0}, {"bne", 1},  {"blt", 4},
+                                    {"bge", 5}, {"bltu", 6}, {"bgeu", 7}};
+    for (const IInfo &i : kBranch)
+        if (m == i.name) {
+            need(3);
+            return emitBranch(i.funct3, reg(ops[0]), reg(ops[1]), ops[2]);
+        }
+    static const IInfo kSwapped[] = {{"bgt", 4}, {"ble", 5}, {"bgtu", 6}, {"bleu", 7}};
+    for (const IInfo &i : kSwapped)
+        if (m == i.name) {
+            need(3);
+            return emitBranch(i.funct3, reg(ops[1]), reg(ops[0]), ops[2]);
+        }
+    if (m == "beqz" || m == "bnez" || m == "bltz" || m == "bgez") {
+        need(2);
+        uint32_t funct3 = m == "beqz" ? 0 : m == "bnez" ? 1 : m == "bltz" ? 4 : 5;
+        return emitBranch(funct3, reg(ops[0]), X0, ops[1]);
+    }
+    if (m == "bgtz" || m == "blez") {
+        need(2);
+        return emitBranch(m == "bgtz" ? 4 : 5, X0, reg(ops[0]), ops[1]);
+    }
+    // 跳转与调用
+    if (m == "j") {
+        need(1);
+        return emitJal(X0, ops[0]);
+    }
+    if (m == "jal") {
+        if (ops.size() == 1)
+            return emitJal(RA, ops[0]);
+        need(2);
+        return emitJal(reg(ops[0]), ops[1]);
+    }
+    if (m == "jr" || (m == "jalr" && ops.size() == 1)) {
+        need(1);
+        emit32(encI(JALR, m == "jr" ? X0 : RA, 0, reg(ops[0]), 0));
+        return;
+    }
+    if (m == "jalr") {
+        if (ops.size() == 2 && ops[1].find('(') != std::string_view::npos)
+            return emitI(0, JALR, reg(ops[0]), 0, ops[1], true);
+        need(3);
+        return emitI(0, JALR, reg(ops[0]), reg(ops[1]), ops[2], false);
+    }
+    if (m == "ret") {
+        need(0);
+        emit32(encI(JALR, X0, 0, RA, 0));
+        return;
+    }
+    if (m == "call" || m == "tail") {
+        need(1);
+        return emitCall(m == "call" ? RA : X0, ops[0]);
+    }
+    // U 型与地址装入
+    if (m == "lui" || m == "auipc") {
+        need(2);
+        int rd = reg(ops[0]);
+        Expr e = expr(ops[1]);
+        uint32_t imm = 0;
+        if (e.mod == Expr::Mod::Hi || e.mod == Expr::Mod::PcrelHi) {
+            if (e.symbol.empty())
+                imm = hi20(static_cast<uint32_t>(e.value));
+            else
+                reloc(e.mod == Expr::Mod::Hi ? R_RISCV_HI20 : R_RISCV_PCREL_HI20, e);
+        } else if (e.mod != Expr::Mod::None || !e.symbol.empty() || e.value < 0 ||
+                   e.value > 0xfffff) {
+            error("bad operand for '" + std::string(m) + "'");
+        } else {
+            imm = static_cast<uint32_t>(e.value);
+        }
+        emit32(imm << 12 | uint32_t(rd) << 7 | (m == "lui" ? LUI : AUIPC));
+        return;
+    }
+    if (m == "la" || m == "lla") {
+        need(2);
+        int rd = reg(ops[0]);
+        Expr e = expr(ops[1]);
+        if (e.symbol.empty() || e.mod != Expr::Mod::None)
+            error("'" + std::string(m) + "' needs a symbol");
+        Expr lo;
+        lo.symbol = tempLabel();
+        reloc(R_RISCV_PCREL_HI20, e);
+        emit32(uint32_t(rd) << 7 | AUIPC);
+        reloc(R_RISCV_PCREL_LO12_I, lo);
+        emit32(encI(OP_IMM, rd, 0, rd, 0));
+        return;
+    }
+    // 其余伪指令
+    if (m == "nop") {
+        need(0);
+        emit32(encI(OP_IMM, X0, 0, X0, 0));
+    } else if (m == "li") {
+        need(2);
+        emitLi(reg(ops[0]), constant(ops[1], INT32_MIN, UINT32_MAX));
+    } else if (m == "mv") {
+        need(2);
+        emit32(encI(OP_IMM, reg(ops[0]), 0, reg(ops[1]), 0));
+    } else if (m == "not") {
+        need(2);
+        emit32(encI(OP_IMM, reg(ops[0]), 4, reg(ops[1]), -1));
+    } else if (m == "neg") {
+        need(2);
+        emit32(encR(0x20, reg(ops[1]), X0, 0, reg(ops[0]), OP));
+    } else if (m == "seqz") {
+        need(2);
+        emit32(encI(OP_IMM, reg(ops[0]), 3, reg(ops[1]), 1));
+    } else if (m == "snez") {
+        need(2);
+        emit32(encR(0, reg(ops[1]), X0, 3, reg(ops[0]), OP));
+    } else if (m == "sltz") {
+        need(2);
+        emit32(encR(0, X0, reg(ops[1]), 2, reg(ops[0]), OP));
+    } else if (m == "sgtz") {
+        need(2);
+        emit32(encR(0, reg(ops[1]), X0, 2, reg(ops[0]), OP));
+    } else if (m == "ecall" || m == "ebreak") {
+        need(0);
+        emit32(m == "ecall" ? SYSTEM : 0x00100000 | SYSTEM);
+    } else if (m == "fence") {
+        emit32(0x0ff00000 | MISC_MEM);
+    } else if (m == "vsetvli") {
+        // vsetvli rd, rs1, e<sew>, m<lmul>, t[au], m[au]
+        if (ops.size() < 4 || ops.size() > 6)
+            error("wrong number of operands for 'vsetvli'");
+        uint32_t vtype = 0;
+        for (size_t k = 2; k < ops.size(); ++k) {
+            std::string_view f = ops[k];
+            if (f == "e8" || f == "e16" || f == "e32" || f == "e64")
+                vtype |= (f == "e8" ? 0u : f == "e16" ? 1u : f == "e32" ? 2u : 3u) << 3;
+            else if (f == "m1" || f == "m2" || f == "m4" || f == "m8")
+                vtype |= f == "m1" ? 0u : f == "m2" ? 1u : f == "m4" ? 2u : 3u;
+            else if (f == "mf2" || f == "mf4" || f == "mf8")
+                vtype |= f == "mf8" ? 5u : f == "mf4" ? 6u : 7u;
+            else if (f == "ta" || f == "tu")
+                vtype |= f == "ta" ? 0x40u : 0u;
+            else if (f == "ma" || f == "mu")
+                vtype |= f == "ma" ? 0x80u : 0u;
+            else
+                error("bad vtype field '" + std::string(f) + "'");
+        }
+        emit32(encI(OP_V, reg(ops[0]), 7, reg(ops[1]), static_cast<int32_t>(vtype)));
+    } else {
+        // RVV 运算（只支持不带掩码的形式）
+        struct VInfo {
+            const char *name;
+            uint32_t funct6, funct3;
+            char form; // V：vd, vs2, vs1；X：vd, vs2, rs1；M：vd, rs1；I：vd；S：rd, vs2
+        };
+        static const VInfo kV[] = {
+            {"vadd.vv", 0x00, 0, 'V'},    {"vsub.vv", 0x02, 0, 'V'},  {"vmul.vv", 0x25, 2, 'V'},
+            {"vdiv.vv", 0x21, 2, 'V'},    {"vrem.vv", 0x23, 2, 'V'},  {"vadd.vx", 0x00, 4, 'X'},
+            {"vredsum.vs", 0x00, 2, 'V'}, {"vmv.v.x", 0x17, 4, 'M'},  {"vmv.s.x", 0x10, 6, 'M'},
+            {"vid.v", 0x14, 2, 'I'},      {"vmv.x.s", 0x10, 2, 'S'},
+        };
+        for (const VInfo &v : kV)
+            if (m == v.name) {
+                int rd = 0, vs2 = 0, rs1 = 0;
+                switch (v.form) {
+                case 'V':
+                    need(3);
+                    rd = vreg(ops[0]), vs2 = vreg(ops[1]), rs1 = vreg(ops[2]);
+                    break;
+                case 'X':
+                    need(3);
+                    rd = vreg(ops[0]), vs2 = vreg(ops[1]), rs1 = reg(ops[2]);
+                    break;
+                case 'M':
+                    need(2);
+                    rd = vreg(ops[0]), rs1 = reg(ops[1]);
+                    break;
+                case 'I':
+                    need(1);
+                    rd = vreg(ops[0]), rs1 = 0x11;
+                    break;
+                case 'S':
+                    need(2);
+                    rd = reg(ops[0]), vs2 = vreg(ops[1]);
+                    break;
+                }
+                emit32(v.funct6 << 26 | 1u << 25 | uint32_t(vs2) << 20 | uint32_t(rs1) << 15 |
+                       v.funct3 << 12 | uint32_t(rd) << 7 | OP_V);
+                return;
+            }
+        error("unsupported instruction '" + std::string(m) + "'");
+    }
+}
+
+/**
+ * @brief 找出本遍中目标超出 ±4 KiB 的条件分支
+ * @details 只检查目标与分支在同一节的分支（其余的偏移要到链接时才知道），新找到的加入 longBranches
+ * @return 是否有新增
+ */
+bool Assembler::findLongBranches(const ObjectFile &obj, std::set<uint32_t> &longBranches) const {
+    bool added = false;
+    for (auto [index, r] : shortBranches_) {
+        const Relocation &rel = obj.relocs[r];
+        const Symbol &sym = obj.symbols[rel.symbol];
+        if (sym.section != rel.section)
+            continue;
+        const int64_t off = int64_t(sym.value) + rel.addend - int64_t(rel.offset);
+        if (off < -4096 || off > 4094)
+            added |= longBranches.insert(index).second;
+    }
+    return added;
+}
+
+} // namespace
+
+/**
+ * @brief 汇编文本
+ * @details 分支放宽与 ELFObjectWriter 相同：先全部按 4 字节的 B 型分支汇编，目标超出 ±4 KiB 的
+ *   在下一遍改为反转分支 + jal（8 字节）。放宽只会让代码变长，已放宽的分支保持不变，
+ *   重复到没有新的越界分支为止；没有越界分支时只汇编一遍
+ */
+ObjectFile assemble(std::string_view text, const std::string &name) {
+    std::set<uint32_t> longBranches;
+    for (;;) {
+        Assembler as(name, longBranches);
+        ObjectFile obj = as.run(text);
+        if (!as.findLongBranches(obj, longBranches))
+            return obj;
+    }
+}
+
+#pragma endregion
+
+#pragma region ELF 读取
+
+namespace {
+
+constexpr uint16_t ET_REL = 1, EM_RISCV = 243;
+constexpr uint32_t SHT_PROGBITS = 1, SHT_SYMTAB = 2, SHT_RELA = 4, SHT_NOBITS = 8;
+constexpr uint32_t SHF_WRITE = 0x1, SHF_ALLOC = 0x2, SHF_EXECINSTR = 0x4;
+constexpr uint16_t SHN_UNDEF = 0, SHN_ABS = 0xfff1;
+
+// ElfReader：带边界检查的小端读取
+struct ElfReader {
+    std::string_view bytes;
+    const std::string &name;
+
+    [[noreturn]] void fail(const std::string &msg) const {
+        throw std::runtime_error(name + ": malformed ELF: " + msg);
+    }
+    void check(uint64_t off, uint64_t len) const {
+        if (off + len > bytes.size())
+            fail("offset out of range");
+    }
+    uint32_t u8(uint64_t off) const {
+        check(off, 1);
+        return static_cast<uint8_t>(bytes[off]);
+    }
+    uint32_t u16(uint64_t off) const { return u8(off) | u8(off + 1) << 8; }
+    uint32_t u32(uint64_t off) const { return u16(off) | u16(off + 2) << 16; }
+    std::string str(uint64_t tableOff, uint64_t tableSize, uint32_t index) const {
+        if (index >= tableSize)
+            fail("string index out of range");
+        check(tableOff, tableSize);
+        std::string_view table = bytes.substr(tableOff, tableSize);
+        size_t end = table.find('\0', index);
+        if (end == std::string_view::npos)
+            fail("unterminated string");
+        return std::string(table.substr(index, end - index));
+    }
+};
+
+} // namespace
+
+/**
+ * @brief 读取 ELF32 可重定位目标文件
+ * @details 保留带 SHF_ALLOC 的 PROGBITS / NOBITS 节；符号表整体保留（下标与 ELF 一致，便于重定位
+ *   直接引用），指向未保留节的符号视为未定义的局部符号；只读取 .rela 节（RISC-V 不使用 .rel）
+ */
+ObjectFile readELF(std::string_view bytes, const std::string &name) {
+    ElfReader r{bytes, name};
+    if (bytes.size() < 52 || bytes.substr(0, 4) != "\x7f"
+                                                    "ELF")
+        r.fail("bad header");
+    if (r.u8(4) != 1 || r.u8(5) != 1)
+        r.fail("not a little-endian ELF32 file");
+    if (r.u16(18) != EM_RISCV)
+        r.fail("not a RISC-V object");
+    if (r.u16(16) != ET_REL)
+        throw std::runtime_error(name + ": only relocatable objects (toyc -c) are supported");
+    const uint32_t shoff = r.u32(32), shentsize = r.u16(46), shnum = r.u16(48),
+                   shstrndx = r.u16(50);
+    if (shentsize != 40 || shstrndx >= shnum)
+        r.fail("bad section header table");
+    struct Shdr {
+        uint32_t name, type, flags, offset, size, link, info, align, entsize;
+    };
+    std::vector<Shdr> sh(shnum);
+    for (uint32_t i = 0; i < shnum; ++i) {
+        uint64_t base = shoff + uint64_t(i) * 40;
+        sh[i] = {r.u32(base),      r.u32(base + 4),  r.u32(base + 8),
+                 r.u32(base + 16), r.u32(base + 20), r.u32(base + 24),
+                 r.u32(base + 28), r.u32(base + 32), r.u32(base + 36)};
+    }
+    const Shdr &shstr = sh[shstrndx];
+
+    ObjectFile obj;
+    obj.name = name;
+    std::vector<int> mapped(shnum, -1); // ELF 节下标 → obj.sections 下标
+    for (uint32_t i = 0; i < shnum; ++i) {
+        const Shdr &s = sh[i];
+        if (!(s.flags & SHF_ALLOC) || (s.type != SHT_PROGBITS && s.type != SHT_NOBITS))
+            continue;
+        Section sec;
+        sec.name = r.str(shstr.offset, shstr.size, s.name);
+        sec.size = s.size;
+        sec.align = std::max<uint32_t>(s.align, 1);
+        sec.exec = s.flags & SHF_EXECINSTR;
+        sec.write = s.flags & SHF_WRITE;
+        sec.nobits = s.type == SHT_NOBITS;
+        if (!sec.nobits) {
+            r.check(s.offset, s.size);
+            sec.data.assign(bytes.begin() + s.offset, bytes.begin() + s.offset + s.size);
+        }
+        mapped[i] = static_cast<int>(obj.sections.size());
+        obj.sections.push_back(std::move(sec));
+    }
+
+    for (uint32_t i = 0; i < shnum; ++i) {
+        if (sh[i].type != SHT_SYMTAB)
+            continue;
+        if (!obj.symbols.empty() || sh[i].link >= shnum)
+            r.fail("bad symbol table");
+        const Shdr &strtab = sh[sh[i].link];
+        for (uint32_t k = 0; k < sh[i].size / 16; ++k) {
+            uint64_t base = sh[i].offset + uint64_t(k) * 16;
+            Symbol sym;
+            sym.name = r.str(strtab.offset, strtab.size, r.u32(base));
+            sym.value = r.u32(base + 4);
+            const uint32_t bind = r.u8(base + 12) >> 4, shndx = r.u16(base + 14);
+            sym.binding = bind == 1   ? Symbol::Binding::Global
+                          : bind == 2 ? Symbol::Binding::Weak
+                                      : Symbol::Binding::Local;
+            if (shndx == SHN_ABS)
+                sym.section = -2;
+            else if (shndx != SHN_UNDEF && shndx < shnum)
+                sym.section = mapped[shndx];
+            obj.symbols.push_back(std::move(sym));
+        }
+    }
+
+    for (uint32_t i = 0; i < shnum; ++i) {
+        if (sh[i].type != SHT_RELA || sh[i].info >= shnum || mapped[sh[i].info] < 0)
+            continue;
+        for (uint32_t k = 0; k < sh[i].size / 12; ++k) {
+            uint64_t base = sh[i].offset + uint64_t(k) * 12;
+            const uint32_t info = r.u32(base + 4);
+            if ((info >> 8) >= obj.symbols.size())
+                r.fail("relocation symbol out of range");
+            obj.relocs.push_back({mapped[sh[i].info], r.u32(base), info & 0xff,
+                                  static_cast<int>(info >> 8),
+                                  static_cast<int32_t>(r.u32(base + 8))});
+        }
+    }
+    return obj;
+}
+
+ObjectFile loadObject(std::string_view contents, const std::string &name) {
+    if (contents.size() >= 4 && contents.substr(0, 4) == "\x7f"
+                                                        "ELF")
+        return readELF(contents, name);
+    return assemble(contents, name);
+}
+
+#pragma endregion
+
+#pragma region 链接
+
+namespace {
+
+// outputName：输入节 → 输出节（.text.foo 并入 .text，.sdata 并入 .data，其余保持原名）
+std::string outputName(const Section &s) {
+    auto starts = [&](const char *prefix) { return s.name.rfind(prefix, 0) == 0; };
+    if (s.exec)
+        return ".text";
+    if (starts(".rodata") || starts(".srodata"))
+        return ".rodata";
+    if (starts(".data") || starts(".sdata"))
+        return ".data";
+    if (starts(".bss") || starts(".sbss"))
+        return ".bss";
+    return s.name;
+}
+
+// kind：输出节的排列次序（代码、只读数据、可写数据、bss）
+int kind(const Section &s) { return s.exec ? 0 : s.nobits ? 3 : s.write ? 2 : 1; }
+
+[[noreturn]] void relocError(const ObjectFile &obj, const Relocation &rel, const char *what) {
+    throw std::runtime_error(obj.name + ": " + what + " (relocation " + std::to_string(rel.type) +
+                             " against '" + obj.symbols[rel.symbol].name + "')");
+}
+
+bool isCIdentifier(const std::string &name) {
+    return !name.empty() && !isDigit(name[0]) &&
+           std::all_of(name.begin(), name.end(),
+                       [](char c) { return isIdentChar(c) && c != '.' && c != '$'; });
+}
+
+} // namespace
+
+/**
+ * @brief 链接
+ * @details 输出节按 代码 / 只读数据 / 数据 / bss 排列，同名输入节按输入顺序首尾相接；代码从
+ *   kTextBase 开始，数据从其后的下一页开始。全局符号表中强定义覆盖弱定义，未定义的弱符号取 0
+ *   （crt0 借此判断 __toyc_prof_dump 是否存在）
+ */
+Image link(std::vector<ObjectFile> objects) {
+    auto definesStart = [](const ObjectFile &obj) {
+        return std::any_of(obj.symbols.begin(), obj.symbols.end(), [](const Symbol &s) {
+            return s.name == "_start" && s.section != -1 && s.binding != Symbol::Binding::Local;
+        });
+    };
+    if (std::none_of(objects.begin(), objects.end(), definesStart))
+        objects.push_back(assemble(kCrt0, "<crt0>"));
+
+    // 布局：按 (kind, 输出节首次出现的次序) 排列输出节
+    std::vector<std::vector<uint32_t>> addr(objects.size());
+    std::vector<std::pair<int, std::string>> outputs;
+    for (const ObjectFile &obj : objects)
+        for (const Section &s : obj.sections) {
+            std::pair<int, std::string> key{kind(s), outputName(s)};
+            if (std::find(outputs.begin(), outputs.end(), key) == outputs.end())
+                outputs.push_back(key);
+        }
+    std::stable_sort(outputs.begin(), outputs.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    Image image;
+    std::unordered_map<std::string, uint32_t> bounds; // __start_ / __stop_ 符号
+    uint32_t pc = Image::kTextBase;
+    bool inData = false;
+    for (const auto &[k, out] : outputs) {
+        if (k > 0 && !inData) {
+            image.textEnd = pc;
+            pc = (pc + 0xfff) & ~0xfffu;
+            inData = true;
+        }
+        std::optional<uint32_t> begin; // 第一个输入节对齐后的地址
+        for (size_t o = 0; o < objects.size(); ++o) {
+            addr[o].resize(objects[o].sections.size());
+            for (size_t i = 0; i < objects[o].sections.size(); ++i) {
+                const Section &s = objects[o].sections[i];
+                if (kind(s) != k || outputName(s) != out)
+                    continue;
+                pc = (pc + s.align - 1) & ~(s.align - 1);
+                if (!begin)
+                    begin = pc;
+                addr[o][i] = pc;
+                pc += s.size;
+            }
+        }
+        if (isCIdentifier(out)) {
+            bounds["__start_" + out] = *begin;
+            bounds["__stop_" + out] = pc;
+        }
+    }
+    if (!inData)
+        image.textEnd = pc;
+    image.bytes.assign(pc - Image::kTextBase, 0);
+    for (size_t o = 0; o < objects.size(); ++o)
+        for (size_t i = 0; i < objects[o].sections.size(); ++i) {
+            const Section &s = objects[o].sections[i];
+            std::copy(s.data.begin(), s.data.end(),
+                      image.bytes.begin() + (addr[o][i] - Image::kTextBase));
+        }
+
+    // 全局符号
+    std::unordered_map<std::string, bool> weakDef;
+    for (size_t o = 0; o < objects.size(); ++o)
+        for (const Symbol &sym : objects[o].symbols) {
+            if (sym.binding == Symbol::Binding::Local || sym.section == -1)
+                continue;
+            const uint32_t value = sym.section == -2 ? sym.value : addr[o][sym.section] + sym.value;
+            const bool weak = sym.binding == Symbol::Binding::Weak;
+            auto it = image.symbols.find(sym.name);
+            if (it != image.symbols.end()) {
+                if (!weak && !weakDef[sym.name])
+                    throw std::runtime_error(objects[o].name + ": duplicate definition of '" +
+                                             sym.name + "'");
+                if (weak)
+                    continue;
+            }
+            image.symbols[sym.name] = value;
+            weakDef[sym.name] = weak;
+        }
+    for (const auto &[name, value] : bounds)
+        image.symbols.emplace(name, value);
+    image.entry = image.symbols.at("_start");
+
+    // 重定位
+    for (size_t o = 0; o < objects.size(); ++o) {
+        const ObjectFile &obj = objects[o];
+        auto symbolValue = [&](int index) -> uint32_t {
+            const Symbol &sym = obj.symbols[index];
+            if (sym.section >= 0)
+                return addr[o][sym.section] + sym.value;
+            if (sym.section == -2)
+                return sym.value;
+            auto it = image.symbols.find(sym.name);
+            if (it != image.symbols.end())
+                return it->second;
+            if (sym.binding == Symbol::Binding::Weak)
+                return 0;
+            throw std::runtime_error(obj.name + ": undefined reference to '" + sym.name + "'");
+        };
+        auto fail = [&](const Relocation &rel, const char *what) { relocError(obj, rel, what); };
+        // pcrelHi：%pcrel_lo(label) 对应的 auipc 处的 PC 相对偏移
+        auto pcrelHi = [&](const Relocation &lo) -> uint32_t {
+            const Symbol &label = obj.symbols[lo.symbol];
+            for (const Relocation &hi : obj.relocs)
+                if (hi.section == label.section && hi.offset == label.value &&
+                    hi.type == R_RISCV_PCREL_HI20)
+                    return symbolValue(hi.symbol) + uint32_t(hi.addend) -
+                           (addr[o][hi.section] + hi.offset);
+            relocError(obj, lo, "%pcrel_lo without matching %pcrel_hi");
+        };
+        for (const Relocation &rel : obj.relocs) {
+            if (rel.type == R_RISCV_RELAX || rel.type == R_RISCV_ALIGN)
+                continue;
+            const uint32_t P = addr[o][rel.section] + rel.offset;
+            const size_t at = P - Image::kTextBase;
+            const bool pcrelLo =
+                rel.type == R_RISCV_PCREL_LO12_I || rel.type == R_RISCV_PCREL_LO12_S;
+            const uint32_t S = pcrelLo ? 0 : symbolValue(rel.symbol);
+            const uint32_t value = S + uint32_t(rel.addend);
+            const int32_t off = static_cast<int32_t>(value - P);
+            std::vector<uint8_t> &b = image.bytes;
+            if (rel.offset + (rel.type == R_RISCV_RVC_BRANCH || rel.type == R_RISCV_RVC_JUMP
+                                  ? 2u
+                                  : 4u) >
+                objects[o].sections[rel.section].size)
+                fail(rel, "relocation offset out of range");
+            switch (rel.type) {
+            case R_RISCV_32:
+                write32(b, at, value);
+                break;
+            case R_RISCV_BRANCH:
+                if (off < -4096 || off > 4094 || off % 2 != 0)
+                    fail(rel, "branch target out of range");
+                write32(b, at, setImmB(read32(b, at), off));
+                break;
+            case R_RISCV_JAL:
+                if (off < -(1 << 20) || off >= (1 << 20) || off % 2 != 0)
+                    fail(rel, "jump target out of range");
+                write32(b, at, setImmJ(read32(b, at), off));
+                break;
+            case R_RISCV_CALL:
+            case R_RISCV_CALL_PLT:
+                write32(b, at, setImmU(read32(b, at), hi20(uint32_t(off))));
+                write32(b, at + 4, setImmI(read32(b, at + 4), lo12(uint32_t(off))));
+                break;
+            case R_RISCV_PCREL_HI20:
+                write32(b, at, setImmU(read32(b, at), hi20(uint32_t(off))));
+                break;
+            case R_RISCV_HI20:
+                write32(b, at, setImmU(read32(b, at), hi20(value)));
+                break;
+            case R_RISCV_LO12_I:
+                write32(b, at, setImmI(read32(b, at), lo12(value)));
+                break;
+            case R_RISCV_LO12_S:
+                write32(b, at, setImmS(read32(b, at), lo12(value)));
+                break;
+            case R_RISCV_PCREL_LO12_I:
+                write32(b, at, setImmI(read32(b, at), lo12(pcrelHi(rel))));
+                break;
+            case R_RISCV_PCREL_LO12_S:
+                write32(b, at, setImmS(read32(b, at), lo12(pcrelHi(rel))));
+                break;
+            case R_RISCV_RVC_BRANCH:
+                if (off < -256 || off > 254 || off % 2 != 0)
+                    fail(rel, "branch target out of range");
+                write16(b, at, setImmCB(read16(b, at), off));
+                break;
+            case R_RISCV_RVC_JUMP:
+                if (off < -2048 || off > 2046 || off % 2 != 0)
+                    fail(rel, "jump target out of range");
+                write16(b, at, setImmCJ(read16(b, at), off));
+                break;
+            default:
+                fail(rel, "unsupported relocation type");
+            }
+        }
+    }
+    return image;
+}
+
+#pragma endregion
+
+} // namespace toyc::sim
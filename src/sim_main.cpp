@@ -0,0 +1,129 @@
+// ToyC 内置模拟器
+// 加载 toyc 的产物（汇编文本，或 -c 输出的 ELF 目标文件；可以有多个，也可以连同 scripts/crt0.s、
+// scripts/profile_rt.s 一起），链接后由译码缓存解释器运行 RV32IMC（及 toyc 使用的 RVV 子集）。
+// 没有输入定义 _start 时使用内置的 crt0：main 的返回值即退出码，write 到 fd 1 / 2 的内容原样输出
+// 用法：toyc_sim [选项] <input>...（"-" 从标准输入读取汇编，例如 toyc a.c | toyc_sim -）
+//   --stats / --stats-json   运行结束后向 stderr 输出动态计数（指令、访存、分支、估计周期）
+//   --max-steps=N            指令数上限（默认 10^9）
+//   --mtune=<model>          周期估计的延迟模型（与 toyc -mtune 相同）
+//   --stack-size=N           栈区字节数（默认 8 MiB）
+//   --no-file-io             禁止程序在当前目录创建文件（profile_rt.s 写出 toyc.profraw）
+// 退出码为程序退出码的低 8 位；加载、链接或运行出错（非法指令、越界访存、达到指令数上限）时
+// 向 stderr 报告并返回 125
+
+#include "simulator.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kSimError = 125;
+
+void usage() {
+    std::cerr << "Usage: toyc_sim [--stats] [--stats-json] [--max-steps=N] [--mtune=<model>]\n"
+                 "                [--stack-size=N] [--no-file-io] <input.s|input.o|->...\n"
+                 "  latency models: "
+              << toyc::mir::latencyModelNames() << "\n";
+}
+
+// parseCount：解析正整数选项值，格式错误时返回 0
+uint64_t parseCount(const char *s) {
+    char *end = nullptr;
+    unsigned long long v = std::strtoull(s, &end, 0);
+    return end && *end == '\0' ? v : 0;
+}
+
+std::string readInput(const std::string &path) {
+    if (path == "-")
+        return std::string(std::istreambuf_iterator<char>(std::cin), {});
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("cannot open '" + path + "'");
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    toyc::sim::Options options;
+    bool stats = false, statsJson = false;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (std::strcmp(arg, "--stats") == 0) {
+            stats = true;
+        } else if (std::strcmp(arg, "--stats-json") == 0) {
+            statsJson = true;
+        } else if (std::strcmp(arg, "--no-file-io") == 0) {
+            options.fileIO = false;
+        } else if (std::strncmp(arg, "--max-steps=", 12) == 0) {
+            options.maxSteps = parseCount(arg + 12);
+            if (options.maxSteps == 0) {
+                std::cerr << "Error: invalid value in '" << arg << "'\n";
+                return kSimError;
+            }
+        } else if (std::strncmp(arg, "--stack-size=", 13) == 0) {
+            const uint64_t size = parseCount(arg + 13);
+            if (size < 4096 || size > (1u << 30)) {
+                std::cerr << "Error: invalid value in '" << arg << "'\n";
+                return kSimError;
+            }
+            options.stackSize = static_cast<uint32_t>(size);
+        } else if (std::strncmp(arg, "--mtune=", 8) == 0) {
+            auto model = toyc::mir::parseLatencyModel(arg + 8);
+            if (!model) {
+                std::cerr << "Error: unknown latency model '" << (arg + 8) << "'\n";
+                usage();
+                return kSimError;
+            }
+            options.model = *model;
+        } else if (std::strcmp(arg, "-h") == 0 || std::strcmp(arg, "--help") == 0) {
+            usage();
+            return 0;
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            std::cerr << "Error: unknown option '" << arg << "'\n";
+            usage();
+            return kSimError;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (inputs.empty()) {
+        usage();
+        return kSimError;
+    }
+
+    toyc::sim::Result result;
+    try {
+        std::vector<toyc::sim::ObjectFile> objects;
+        for (const std::string &path : inputs)
+            objects.push_back(
+                toyc::sim::loadObject(readInput(path), path == "-" ? "<stdin>" : path));
+        toyc::sim::Image image = toyc::sim::link(std::move(objects));
+        result = toyc::sim::run(image, options);
+    } catch (const std::runtime_error &e) {
+        std::cerr << "toyc_sim: error: " << e.what() << "\n";
+        return kSimError;
+    }
+
+    std::cout << result.output;
+    std::cout.flush();
+    if (stats)
+        result.stats.report(std::cerr);
+    if (statsJson)
+        result.stats.reportJson(std::cerr);
+    if (result.status != toyc::sim::Result::Status::Exited) {
+        std::cerr << "toyc_sim: error: " << result.error << "\n";
+        return kSimError;
+    }
+    return result.exitCode & 0xff;
+}
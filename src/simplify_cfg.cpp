@@ -0,0 +1,369 @@
+#include "ir_analysis.h"
+#include "ir_passes.h"
+#include "statistics.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+namespace {
+
+// resolveOperand：沿替换链找到最终值
+Operand resolveOperand(const std::unordered_map<int, Operand> &replace, Operand op) {
+    while (op.isVReg()) {
+        auto it = replace.find(op.regId());
+        if (it == replace.end())
+            break;
+        op = it->second;
+    }
+    return op;
+}
+
+// replaceAllUses：把所有指令中被替换 vreg 的 use 改为最终值
+void replaceAllUses(Function &F, const std::unordered_map<int, Operand> &replace) {
+    if (replace.empty())
+        return;
+    for (auto &bb : F.blocks)
+        for (Instruction *I : bb->insts)
+            for (Operand &op : I->ops)
+                if (op.isVReg())
+                    op = resolveOperand(replace, op);
+}
+
+// blockHasPhis：块首是否有 phi
+bool blockHasPhis(const BasicBlock *bb) {
+    return !bb->insts.empty() && bb->insts.front()->opcode == Opcode::Phi;
+}
+
+// branchesTo：块是否以标签指向 target 的 br / br i1 结束（顺序落入的块没有可改写的标签）
+bool branchesTo(const BasicBlock *bb, Symbol target) {
+    if (bb->insts.empty())
+        return false;
+    const Instruction *term = bb->insts.back();
+    if (term->opcode != Opcode::Br && term->opcode != Opcode::CondBr)
+        return false;
+    return std::any_of(term->ops.begin(), term->ops.end(), [&](const Operand &op) {
+        return op.isLabel() && op.labelSym() == target;
+    });
+}
+
+// replaceEdge：在 CFG 中把边 from → oldTo 改为 from → newTo（succs / preds 同步更新）
+void replaceEdge(BasicBlock *from, BasicBlock *oldTo, BasicBlock *newTo) {
+    std::replace(from->succs.begin(), from->succs.end(), oldTo, newTo);
+    std::erase(oldTo->preds, from);
+    if (std::find(newTo->preds.begin(), newTo->preds.end(), from) == newTo->preds.end())
+        newTo->preds.push_back(from);
+}
+
+// relabelIncomings：把 bb 中 phi 来自 oldPred 的入口改记为 newPred
+void relabelIncomings(BasicBlock *bb, const BasicBlock *oldPred, const BasicBlock *newPred) {
+    const Symbol oldName(oldPred->name), newName(newPred->name);
+    for (Instruction *I : bb->insts) {
+        if (I->opcode != Opcode::Phi)
+            break;
+        for (size_t k = 0; k < I->numIncoming(); ++k)
+            if (I->incomingBlock(k) == oldName)
+                I->ops[2 * k + 1] = Operand::label(newName);
+    }
+}
+
+/**
+ * @brief 两个目标相同的 br i1 改写为 br
+ * @details 目标块有 phi 时保持原样（同一前驱的两条边在 phi 中可能各有一个入口）
+ */
+bool foldSameTargetBranches(Function &F) {
+    bool changed = false;
+    for (auto &bb : F.blocks) {
+        if (bb->insts.empty())
+            continue;
+        Instruction *term = bb->insts.back();
+        if (term->opcode != Opcode::CondBr || term->ops[1].labelSym() != term->ops[2].labelSym())
+            continue;
+        if (blockHasPhis(F.blockMap.at(term->ops[1].labelSym())))
+            continue;
+        int blockId = term->blockId, index = term->index;
+        *term = Instruction::makeBr(term->ops[1]);
+        term->blockId = blockId;
+        term->index = index;
+        changed = true;
+    }
+    return changed;
+}
+
+/**
+ * @brief 穿透只含 br 的空块：P → B → T 改为 P → T
+ * @details 入口块不穿透。T 有 phi 时，B 的入口值 v 改为每个前驱 P 各一个入口（v 的定义支配 B，
+ *   而 B 中没有定义，所以也支配每个 P）；若某个 P 已经是 T 的前驱，两条边会在 phi 中冲突，
+ *   此时不穿透。T 有 phi 而 P 有多个后继时同样保留 B：B 是关键边 P → T 上放置 phi 拷贝的位置，
+ *   穿透后 phi 消除只能把拷贝放在 P 末尾，P 的每条出边都要执行。前驱的两个目标因此变得相同时由下一轮 foldSameTargetBranches 处理。
+ *   只有每个前驱都以指向 B 的分支结束时才穿透：顺序落入 B 的前驱没有可改写的标签，
+ *   只改 CFG 的话重建后边又回到 B，不动点迭代不会结束。
+ *   CFG 增量更新，被穿透的块失去全部前驱，随后作为不可达块删除
+ */
+bool threadEmptyBlocks(Function &F) {
+    bool changed = false;
+    BasicBlock *entry = F.entryBlock();
+    for (auto &block : F.blocks) {
+        BasicBlock *B = block.get();
+        if (B == entry || B->insts.size() != 1 || B->insts[0]->opcode != Opcode::Br ||
+            B->preds.empty())
+            continue;
+        BasicBlock *T = F.blockMap.at(B->insts[0]->ops[0].labelSym());
+        if (T == B)
+            continue;
+        std::vector<BasicBlock *> preds = B->preds;
+        std::sort(preds.begin(), preds.end());
+        preds.erase(std::unique(preds.begin(), preds.end()), preds.end());
+        const Symbol bName(B->name), tName(T->name);
+        if (!std::all_of(preds.begin(), preds.end(),
+                         [&](const BasicBlock *P) { return branchesTo(P, bName); }))
+            continue;
+        if (blockHasPhis(T)) {
+            bool conflict = std::any_of(preds.begin(), preds.end(), [&](const BasicBlock *P) {
+                return P->succs.size() > 1 ||
+                       std::find(T->preds.begin(), T->preds.end(), P) != T->preds.end();
+            });
+            if (conflict)
+                continue;
+            for (Instruction *I : T->insts) {
+                if (I->opcode != Opcode::Phi)
+                    break;
+                OperandList ops;
+                for (size_t k = 0; k < I->numIncoming(); ++k) {
+                    if (I->incomingBlock(k) != bName) {
+                        ops.push_back(I->incomingValue(k));
+                        ops.push_back(I->ops[2 * k + 1]);
+                        continue;
+                    }
+                    for (const BasicBlock *P : preds) {
+                        ops.push_back(I->incomingValue(k));
+                        ops.push_back(Operand::label(Symbol(P->name)));
+                    }
+                }
+                I->ops = ops;
+            }
+        }
+        for (BasicBlock *P : preds) {
+            for (Operand &op : P->insts.back()->ops)
+                if (op.isLabel() && op.labelSym() == bName)
+                    op = Operand::label(tName);
+            replaceEdge(P, B, T);
+        }
+        std::erase(T->preds, B);
+        B->preds.clear();
+        B->succs.clear();
+        changed = true;
+    }
+    return changed;
+}
+
+// addIncomingsFrom：把 S 中来自 oldPred 的 phi 入口复制一份，记为来自 newPred
+void addIncomingsFrom(BasicBlock *S, const BasicBlock *oldPred, const BasicBlock *newPred) {
+    const Symbol oldName(oldPred->name), newName(newPred->name);
+    for (Instruction *I : S->insts) {
+        if (I->opcode != Opcode::Phi)
+            break;
+        for (size_t k = 0; k < I->numIncoming(); ++k)
+            if (I->incomingBlock(k) == oldName) {
+                I->addIncoming(I->incomingValue(k), newName);
+                break;
+            }
+    }
+}
+
+/**
+ * @brief 穿透布尔 phi：B 只含 %p = phi i1 与以 %p 为条件的 br i1（%p 没有其他 use）时，前驱直接跳到目标
+ * @details && / || 的短路求值经 mem2reg 后形如 land_end: %p = phi i1 [false, %a], [%c, %b]; br i1 %p, …；
+ *   外面再套一层 ! 时中间多一条只被 br 读取的 icmp eq %p, 0，两个目标随之对调。
+ *   入口值为常量的前驱把跳向 B 的边改跳对应的目标（目标块有 phi 且已是该前驱的后继时跳过，
+ *   同一前驱的两条边会在 phi 中冲突）；入口值为 %c、且前驱以 br 无条件跳到 B 时，
+ *   前驱的 br 改为 br i1 %c, …（%c 通常是前驱末尾的 icmp，代码生成时与新分支融合）。
+ *   目标块的 phi 为新前驱复制来自 B 的入口值（该值支配 B，B 中又只有 %p，因此也支配前驱）。
+ *   B 失去全部前驱后作为不可达块删除，它的 phi 中失效的入口由 prunePhiIncomings 修剪
+ */
+bool threadBooleanPhis(Function &F) {
+    const DefUseChains chains(F);
+    bool changed = false;
+    BasicBlock *entry = F.entryBlock();
+    for (auto &block : F.blocks) {
+        BasicBlock *B = block.get();
+        if (B == entry || (B->insts.size() != 2 && B->insts.size() != 3))
+            continue;
+        Instruction *phi = B->insts.front(), *br = B->insts.back();
+        if (phi->opcode != Opcode::Phi || br->opcode != Opcode::CondBr ||
+            chains.numUses(phi->defReg()) != 1)
+            continue;
+        bool negated = false;
+        if (B->insts.size() == 3) {
+            const Instruction *cmp = B->insts[1];
+            const Operand &zero = cmp->ops[1];
+            if (cmp->opcode != Opcode::ICmp ||
+                (cmp->cmpPred != CmpPred::EQ && cmp->cmpPred != CmpPred::NE) ||
+                !cmp->ops[0].isVReg() || cmp->ops[0].regId() != phi->defReg() ||
+                !((zero.isImm() && zero.immValue() == 0) || (zero.isBoolLit() && !zero.boolValue())) ||
+                br->branchCondReg() != cmp->defReg() || chains.numUses(cmp->defReg()) != 1)
+                continue;
+            negated = cmp->cmpPred == CmpPred::EQ;
+        } else if (br->branchCondReg() != phi->defReg()) {
+            continue;
+        }
+        // T / E：%p 为真 / 假时的目标
+        const Operand onTrue = br->ops[negated ? 2 : 1], onFalse = br->ops[negated ? 1 : 2];
+        BasicBlock *T = F.blockMap.at(onTrue.labelSym());
+        BasicBlock *E = F.blockMap.at(onFalse.labelSym());
+        if (T == B || E == B || T == E)
+            continue;
+        const Symbol bName(B->name);
+        for (size_t k = 0; k < phi->numIncoming(); ++k) {
+            auto it = F.blockMap.find(phi->incomingBlock(k));
+            if (it == F.blockMap.end() || it->second->insts.empty())
+                continue;
+            BasicBlock *P = it->second;
+            Instruction *term = P->insts.back();
+            auto targets = [&](const BasicBlock *S) {
+                return std::any_of(term->ops.begin(), term->ops.end(), [&](const Operand &op) {
+                    return op.isLabel() && op.labelSym() == Symbol(S->name);
+                });
+            };
+            if ((term->opcode != Opcode::Br && term->opcode != Opcode::CondBr) || !targets(B))
+                continue;
+            const Operand value = phi->incomingValue(k);
+            if (value.isVReg()) {
+                if (term->opcode != Opcode::Br)
+                    continue;
+                int blockId = term->blockId, index = term->index;
+                *term = Instruction::makeCondBr(value, onTrue, onFalse);
+                term->blockId = blockId;
+                term->index = index;
+                addIncomingsFrom(T, B, P);
+                addIncomingsFrom(E, B, P);
+            } else {
+                bool taken = value.isBoolLit() ? value.boolValue() : value.immValue() != 0;
+                BasicBlock *S = taken ? T : E;
+                if (blockHasPhis(S) && targets(S))
+                    continue;
+                for (Operand &op : term->ops)
+                    if (op.isLabel() && op.labelSym() == bName)
+                        op = Operand::label(Symbol(S->name));
+                addIncomingsFrom(S, B, P);
+            }
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief 合并直线块：A 以 br 跳到 B，且 B 的唯一前驱是 A 时，把 B 接到 A 的末尾
+ * @details B 的 phi 只有来自 A 的一个入口，直接用该值替代；B 的后继中来自 B 的 phi 入口改记为 A。
+ *   被吸收的块清空后不可达，随后删除
+ */
+bool mergeStraightLineBlocks(Function &F) {
+    bool changed = false;
+    BasicBlock *entry = F.entryBlock();
+    std::unordered_map<int, Operand> replace;
+    for (auto &block : F.blocks) {
+        BasicBlock *A = block.get();
+        while (!A->insts.empty() && A->insts.back()->opcode == Opcode::Br) {
+            BasicBlock *B = F.blockMap.at(A->insts.back()->ops[0].labelSym());
+            if (B == A || B == entry || B->preds.size() != 1 || B->preds[0] != A)
+                break;
+            auto multiEntryPhi = [](const Instruction *I) {
+                return I->opcode == Opcode::Phi && I->numIncoming() != 1;
+            };
+            if (std::any_of(B->insts.begin(), B->insts.end(), multiEntryPhi))
+                break;
+            A->insts.pop_back();
+            if (A->profileCount < 0)
+                A->profileCount = B->profileCount; // A 与 B 的执行次数相同
+            for (Instruction *I : B->insts) {
+                if (I->opcode == Opcode::Phi) {
+                    replace[I->defReg()] = I->incomingValue(0);
+                    continue;
+                }
+                I->blockId = A->id;
+                A->insts.push_back(I);
+            }
+            B->insts.clear();
+            for (BasicBlock *S : B->succs) {
+                relabelIncomings(S, B, A);
+                std::replace(S->preds.begin(), S->preds.end(), B, A);
+            }
+            A->succs = std::move(B->succs);
+            B->succs.clear();
+            B->preds.clear();
+            changed = true;
+        }
+    }
+    replaceAllUses(F, replace);
+    return changed;
+}
+
+} // namespace
+
+/**
+ * @brief 删除 phi 中来自非前驱块的入口（前驱被删除，或其分支已被改写为只跳向别处）
+ * @details 只剩一个入口的 phi 用该入口的值替代（该值支配唯一的前驱，也就支配 phi 的全部 use）
+ */
+void prunePhiIncomings(Function &F) {
+    std::unordered_map<int, Operand> replace;
+    for (auto &bb : F.blocks) {
+        if (!blockHasPhis(bb.get()))
+            continue;
+        std::unordered_set<std::string_view> preds;
+        for (const BasicBlock *p : bb->preds)
+            preds.insert(p->name);
+        std::erase_if(bb->insts, [&](Instruction *I) {
+            if (I->opcode != Opcode::Phi)
+                return false;
+            OperandList kept;
+            for (size_t k = 0; k < I->numIncoming(); ++k)
+                if (preds.count(static_cast<const std::string &>(I->incomingBlock(k)))) {
+                    kept.push_back(I->incomingValue(k));
+                    kept.push_back(I->ops[2 * k + 1]);
+                }
+            I->ops = kept;
+            if (I->numIncoming() != 1)
+                return false;
+            replace[I->defReg()] = I->incomingValue(0);
+            return true;
+        });
+    }
+    replaceAllUses(F, replace);
+}
+
+/**
+ * @brief CFG 化简
+ * @details 删除不可达块后迭代到不动点：相同目标的 br i1 → br，穿透布尔 phi，穿透空块，合并直线块；
+ *   每轮结束删除因此不可达的块（重新编号、重建 CFG）并修剪 phi 入口
+ */
+int simplifyCFG(Function &F) {
+    if (F.blocks.empty())
+        return 0;
+    const size_t before = F.blocks.size();
+    removeUnreachableBlocks(F);
+    prunePhiIncomings(F);
+    bool changed = true;
+    while (changed) {
+        changed = foldSameTargetBranches(F);
+        changed |= threadBooleanPhis(F);
+        if (changed)
+            F.buildCFG();
+        changed |= threadEmptyBlocks(F);
+        changed |= mergeStraightLineBlocks(F);
+        if (changed) {
+            removeUnreachableBlocks(F);
+            prunePhiIncomings(F);
+        }
+    }
+    int removed = static_cast<int>(before - F.blocks.size());
+    stats::add(stats::Counter::RemovedBlocks, static_cast<uint64_t>(removed));
+    return removed;
+}
+
+} // namespace opt
+} // namespace toyc
@@ -0,0 +1,918 @@
+#include "simulator.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <iterator>
+#include <unistd.h>
+#include <unordered_set>
+
+namespace toyc::sim {
+
+#pragma region 译码
+
+namespace {
+
+// Op：译码后的操作（RV32C 指令译码为等价的 32 位操作，只有长度不同）；同类操作连续排列
+enum class Op : uint8_t {
+    Undecoded, // 译码缓存中尚未译码的位置
+    Illegal,
+
+    // 跳转与条件分支
+    LUI,
+    AUIPC,
+    JAL,
+    JALR,
+    BEQ,
+    BNE,
+    BLT,
+    BGE,
+    BLTU,
+    BGEU,
+
+    // 访存
+    LB,
+    LH,
+    LW,
+    LBU,
+    LHU,
+    SB,
+    SH,
+    SW,
+
+    // 寄存器-立即数
+    ADDI,
+    SLTI,
+    SLTIU,
+    XORI,
+    ORI,
+    ANDI,
+    SLLI,
+    SRLI,
+    SRAI,
+
+    // 寄存器-寄存器（含 M 扩展）
+    ADD,
+    SUB,
+    SLL,
+    SLT,
+    SLTU,
+    XOR,
+    SRL,
+    SRA,
+    OR,
+    AND,
+    MUL,
+    MULH,
+    MULHSU,
+    MULHU,
+    DIV,
+    DIVU,
+    REM,
+    REMU,
+
+    // 系统
+    FENCE,
+    ECALL,
+    EBREAK,
+
+    // RVV（e32 / m1、不带掩码）：rd 为 vd，rs1 为 vs2，rs2 为 vs1 或标量 rs1
+    VSETVLI,
+    VADD_VV,
+    VSUB_VV,
+    VMUL_VV,
+    VDIV_VV,
+    VREM_VV,
+    VADD_VX,
+    VMV_V_X,
+    VID_V,
+    VREDSUM_VS,
+    VMV_S_X,
+    VMV_X_S,
+};
+
+// Latency：结果延迟的类别（对应 LatencyModel 的各项）
+enum class Latency : uint8_t { Alu, Load, Mul, Div };
+
+// 周期模型中的寄存器编号：x0-x31 为 0-31，v0-v31 为 32-63；0（x0）同时表示 "无"
+constexpr uint8_t V = 32;
+
+// Decoded：译码缓存项
+struct Decoded {
+    Op op = Op::Undecoded;
+    uint8_t rd = 0, rs1 = 0, rs2 = 0;
+    uint8_t size = 4; // 指令字节数（2 或 4）
+    Latency latency = Latency::Alu;
+    uint8_t src0 = 0, src1 = 0, dst = 0; // 周期模型读写的寄存器
+    int32_t imm = 0;
+};
+
+int32_t signExtend(uint32_t v, int bits) {
+    return static_cast<int32_t>(v << (32 - bits)) >> (32 - bits);
+}
+
+bool inRange(Op op, Op first, Op last) { return op >= first && op <= last; }
+
+// finish：按操作填写周期模型的读写寄存器与延迟类别
+Decoded finish(Decoded d) {
+    auto set = [&](uint8_t src0, uint8_t src1, uint8_t dst) {
+        d.src0 = src0;
+        d.src1 = src1;
+        d.dst = dst;
+    };
+    const Op op = d.op;
+    if (op == Op::LUI || op == Op::AUIPC || op == Op::JAL)
+        set(0, 0, d.rd);
+    else if (inRange(op, Op::BEQ, Op::BGEU) || inRange(op, Op::SB, Op::SW))
+        set(d.rs1, d.rs2, 0);
+    else if (op == Op::JALR || op == Op::VSETVLI || inRange(op, Op::LB, Op::LHU) ||
+             inRange(op, Op::ADDI, Op::SRAI))
+        set(d.rs1, 0, d.rd);
+    else if (inRange(op, Op::ADD, Op::REMU))
+        set(d.rs1, d.rs2, d.rd);
+    else if (op == Op::ECALL)
+        set(17, 10, 10);
+    else if (inRange(op, Op::VADD_VV, Op::VREM_VV) || op == Op::VREDSUM_VS)
+        set(V + d.rs1, V + d.rs2, V + d.rd);
+    else if (op == Op::VADD_VX)
+        set(V + d.rs1, d.rs2, V + d.rd);
+    else if (op == Op::VMV_V_X || op == Op::VMV_S_X)
+        set(d.rs2, 0, V + d.rd);
+    else if (op == Op::VID_V)
+        set(0, 0, V + d.rd);
+    else if (op == Op::VMV_X_S)
+        set(V + d.rs1, 0, d.rd);
+
+    if (inRange(op, Op::LB, Op::LHU))
+        d.latency = Latency::Load;
+    else if (inRange(op, Op::MUL, Op::MULHU) || op == Op::VMUL_VV)
+        d.latency = Latency::Mul;
+    else if (inRange(op, Op::DIV, Op::REMU) || op == Op::VDIV_VV || op == Op::VREM_VV)
+        d.latency = Latency::Div;
+    return d;
+}
+
+Decoded make(Op op, int rd, int rs1, int rs2, int32_t imm, uint8_t size) {
+    Decoded d;
+    d.op = op;
+    d.rd = static_cast<uint8_t>(rd);
+    d.rs1 = static_cast<uint8_t>(rs1);
+    d.rs2 = static_cast<uint8_t>(rs2);
+    d.imm = imm;
+    d.size = size;
+    return finish(d);
+}
+
+// decodeV：OP-V 主操作码（vsetvli 与 toyc 使用的 RVV 子集）
+Decoded decodeV(uint32_t w) {
+    const int rd = w >> 7 & 31, f3 = w >> 12 & 7, rs1 = w >> 15 & 31, vs2 = w >> 20 & 31;
+    if (f3 == 7)
+        return w >> 31 ? make(Op::Illegal, 0, 0, 0, 0, 4)
+                       : make(Op::VSETVLI, rd, rs1, 0, static_cast<int32_t>(w >> 20 & 0x7ff), 4);
+    if (!(w >> 25 & 1)) // 带掩码的形式
+        return make(Op::Illegal, 0, 0, 0, 0, 4);
+    const uint32_t f6 = w >> 26;
+    Op op = Op::Illegal;
+    if (f3 == 0 && f6 == 0x00)
+        op = Op::VADD_VV;
+    else if (f3 == 0 && f6 == 0x02)
+        op = Op::VSUB_VV;
+    else if (f3 == 2 && f6 == 0x25)
+        op = Op::VMUL_VV;
+    else if (f3 == 2 && f6 == 0x21)
+        op = Op::VDIV_VV;
+    else if (f3 == 2 && f6 == 0x23)
+        op = Op::VREM_VV;
+    else if (f3 == 2 && f6 == 0x00)
+        op = Op::VREDSUM_VS;
+    else if (f3 == 4 && f6 == 0x00)
+        op = Op::VADD_VX;
+    else if (f3 == 4 && f6 == 0x17 && vs2 == 0)
+        op = Op::VMV_V_X;
+    else if (f3 == 6 && f6 == 0x10 && vs2 == 0)
+        op = Op::VMV_S_X;
+    else if (f3 == 2 && f6 == 0x14 && rs1 == 0x11 && vs2 == 0)
+        op = Op::VID_V;
+    else if (f3 == 2 && f6 == 0x10 && rs1 == 0)
+        op = Op::VMV_X_S;
+    return make(op, rd, vs2, rs1, 0, 4);
+}
+
+Decoded decode32(uint32_t w) {
+    const int rd = w >> 7 & 31, f3 = w >> 12 & 7, rs1 = w >> 15 & 31, rs2 = w >> 20 & 31;
+    const uint32_t f7 = w >> 25;
+    const int32_t immI = static_cast<int32_t>(w) >> 20;
+    const int32_t immS = static_cast<int32_t>(w & 0xfe000000) >> 20 | (w >> 7 & 31);
+    const int32_t immB = static_cast<int32_t>(w & 0x80000000) >> 19 | (w & 0x80) << 4 |
+                         (w >> 20 & 0x7e0) | (w >> 7 & 0x1e);
+    const int32_t immJ = static_cast<int32_t>(w & 0x80000000) >> 11 | (w & 0xff000) |
+                         (w >> 9 & 0x800) | (w >> 20 & 0x7fe);
+    auto d = [&](Op op, int32_t imm) { return make(op, rd, rs1, rs2, imm, 4); };
+    switch (w & 0x7f) {
+    case 0x37:
+        return d(Op::LUI, static_cast<int32_t>(w & 0xfffff000));
+    case 0x17:
+        return d(Op::AUIPC, static_cast<int32_t>(w & 0xfffff000));
+    case 0x6f:
+        return d(Op::JAL, immJ);
+    case 0x67:
+        return f3 == 0 ? d(Op::JALR, immI) : d(Op::Illegal, 0);
+    case 0x63: {
+        static const Op kOps[] = {Op::BEQ,     Op::BNE, Op::Illegal, Op::Illegal,
+                                  Op::BLT,     Op::BGE, Op::BLTU,    Op::BGEU};
+        return d(kOps[f3], immB);
+    }
+    case 0x03: {
+        static const Op kOps[] = {Op::LB,  Op::LH,  Op::LW,      Op::Illegal,
+                                  Op::LBU, Op::LHU, Op::Illegal, Op::Illegal};
+        return d(kOps[f3], immI);
+    }
+    case 0x23:
+        return d(f3 == 0 ? Op::SB : f3 == 1 ? Op::SH : f3 == 2 ? Op::SW : Op::Illegal, immS);
+    case 0x13: {
+        if (f3 == 1)
+            return d(f7 == 0 ? Op::SLLI : Op::Illegal, rs2);
+        if (f3 == 5)
+            return d(f7 == 0 ? Op::SRLI : f7 == 0x20 ? Op::SRAI : Op::Illegal, rs2);
+        static const Op kOps[] = {Op::ADDI, Op::Illegal, Op::SLTI, Op::SLTIU,
+                                  Op::XORI, Op::Illegal, Op::ORI,  Op::ANDI};
+        return d(kOps[f3], immI);
+    }
+    case 0x33: {
+        static const Op kBase[] = {Op::ADD, Op::SLL, Op::SLT, Op::SLTU,
+                                   Op::XOR, Op::SRL, Op::OR,  Op::AND};
+        static const Op kMul[] = {Op::MUL, Op::MULH, Op::MULHSU, Op::MULHU,
+                                  Op::DIV, Op::DIVU, Op::REM,    Op::REMU};
+        if (f7 == 0)
+            return d(kBase[f3], 0);
+        if (f7 == 1)
+            return d(kMul[f3], 0);
+        if (f7 == 0x20 && (f3 == 0 || f3 == 5))
+            return d(f3 == 0 ? Op::SUB : Op::SRA, 0);
+        return d(Op::Illegal, 0);
+    }
+    case 0x0f:
+        return d(Op::FENCE, 0);
+    case 0x73:
+        return d(w == 0x73 ? Op::ECALL : w == 0x00100073 ? Op::EBREAK : Op::Illegal, 0);
+    case 0x57:
+        return decodeV(w);
+    default:
+        return d(Op::Illegal, 0);
+    }
+}
+
+// decode16：RV32C（整数部分）译码为等价的基本指令
+Decoded decode16(uint16_t h) {
+    const uint32_t i = h;
+    const int rd = i >> 7 & 31, rs2 = i >> 2 & 31;
+    const int rdp = (i >> 2 & 7) + 8, rs1p = (i >> 7 & 7) + 8; // x8-x15 的 3 位寄存器字段
+    const int32_t imm6 = signExtend((i >> 7 & 0x20) | (i >> 2 & 0x1f), 6);
+    auto c = [](Op op, int rd, int rs1, int rs2, int32_t imm) {
+        return make(op, rd, rs1, rs2, imm, 2);
+    };
+    const Decoded illegal = c(Op::Illegal, 0, 0, 0, 0);
+    switch ((i & 3) << 3 | i >> 13) {
+    case 0 << 3 | 0: { // c.addi4spn
+        const int32_t imm =
+            static_cast<int32_t>((i >> 7 & 0x30) | (i >> 1 & 0x3c0) | (i >> 4 & 4) | (i >> 2 & 8));
+        return imm == 0 ? illegal : c(Op::ADDI, rdp, 2, 0, imm);
+    }
+    case 0 << 3 | 2: // c.lw
+        return c(Op::LW, rdp, rs1p, 0,
+                 static_cast<int32_t>((i >> 7 & 0x38) | (i >> 4 & 4) | (i << 1 & 0x40)));
+    case 0 << 3 | 6: // c.sw
+        return c(Op::SW, 0, rs1p, rdp,
+                 static_cast<int32_t>((i >> 7 & 0x38) | (i >> 4 & 4) | (i << 1 & 0x40)));
+    case 1 << 3 | 0: // c.addi / c.nop
+        return c(Op::ADDI, rd, rd, 0, imm6);
+    case 1 << 3 | 1:   // c.jal
+    case 1 << 3 | 5: { // c.j
+        const int32_t off = signExtend((i >> 1 & 0x800) | (i >> 7 & 0x10) | (i >> 1 & 0x300) |
+                                           (i << 2 & 0x400) | (i >> 1 & 0x40) | (i << 1 & 0x80) |
+                                           (i >> 2 & 0xe) | (i << 3 & 0x20),
+                                       12);
+        return c(Op::JAL, (i >> 13) == 1 ? 1 : 0, 0, 0, off);
+    }
+    case 1 << 3 | 2: // c.li
+        return c(Op::ADDI, rd, 0, 0, imm6);
+    case 1 << 3 | 3: // c.addi16sp / c.lui
+        if (rd == 2) {
+            const int32_t imm = signExtend((i >> 3 & 0x200) | (i >> 2 & 0x10) | (i << 1 & 0x40) |
+                                               (i << 4 & 0x180) | (i << 3 & 0x20),
+                                           10);
+            return imm == 0 ? illegal : c(Op::ADDI, 2, 2, 0, imm);
+        }
+        return imm6 == 0 ? illegal : c(Op::LUI, rd, 0, 0, static_cast<int32_t>(imm6 * 4096u));
+    case 1 << 3 | 4: { // c.srli / c.srai / c.andi / c.sub / c.xor / c.or / c.and
+        const int funct2 = i >> 10 & 3;
+        if (funct2 == 0 || funct2 == 1)
+            return (i >> 12 & 1) ? illegal
+                                 : c(funct2 == 0 ? Op::SRLI : Op::SRAI, rs1p, rs1p, 0, i >> 2 & 31);
+        if (funct2 == 2)
+            return c(Op::ANDI, rs1p, rs1p, 0, imm6);
+        if (i >> 12 & 1)
+            return illegal;
+        static const Op kOps[] = {Op::SUB, Op::XOR, Op::OR, Op::AND};
+        return c(kOps[i >> 5 & 3], rs1p, rs1p, rdp, 0);
+    }
+    case 1 << 3 | 6: // c.beqz
+    case 1 << 3 | 7: { // c.bnez
+        const int32_t off = signExtend((i >> 4 & 0x100) | (i >> 7 & 0x18) | (i << 1 & 0xc0) |
+                                           (i >> 2 & 6) | (i << 3 & 0x20),
+                                       9);
+        return c((i >> 13) == 6 ? Op::BEQ : Op::BNE, 0, rs1p, 0, off);
+    }
+    case 2 << 3 | 0: // c.slli
+        return (i >> 12 & 1) ? illegal : c(Op::SLLI, rd, rd, 0, rs2);
+    case 2 << 3 | 2: // c.lwsp
+        return rd == 0 ? illegal
+                       : c(Op::LW, rd, 2, 0,
+                           static_cast<int32_t>((i >> 7 & 0x20) | (i >> 2 & 0x1c) |
+                                                (i << 4 & 0xc0)));
+    case 2 << 3 | 4: // c.jr / c.mv / c.ebreak / c.jalr / c.add
+        if (!(i >> 12 & 1)) {
+            if (rs2 == 0)
+                return rd == 0 ? illegal : c(Op::JALR, 0, rd, 0, 0);
+            return c(Op::ADD, rd, 0, rs2, 0);
+        }
+        if (rs2 == 0)
+            return rd == 0 ? c(Op::EBREAK, 0, 0, 0, 0) : c(Op::JALR, 1, rd, 0, 0);
+        return c(Op::ADD, rd, rd, rs2, 0);
+    case 2 << 3 | 6: // c.swsp
+        return c(Op::SW, 0, 2, rs2, static_cast<int32_t>((i >> 7 & 0x3c) | (i >> 1 & 0xc0)));
+    default:
+        return illegal;
+    }
+}
+
+} // namespace
+
+#pragma endregion
+
+#pragma region 统计输出
+
+namespace {
+
+struct StatField {
+    const char *name;
+    uint64_t Stats::*member;
+};
+
+constexpr StatField kStatFields[] = {
+    {"instructions", &Stats::instructions},
+    {"compressed", &Stats::compressed},
+    {"loads", &Stats::loads},
+    {"stores", &Stats::stores},
+    {"stack_loads", &Stats::stackLoads},
+    {"stack_stores", &Stats::stackStores},
+    {"branches", &Stats::branches},
+    {"branches_taken", &Stats::branchesTaken},
+    {"jumps", &Stats::jumps},
+    {"calls", &Stats::calls},
+    {"mul_div", &Stats::mulDiv},
+    {"vector", &Stats::vector},
+    {"stall_cycles", &Stats::stallCycles},
+    {"cycles", &Stats::cycles},
+};
+
+} // namespace
+
+void Stats::report(std::ostream &os) const {
+    char line[96];
+    os << "===-------------------------------------------------------------===\n"
+       << "                      toyc_sim statistics\n"
+       << "===-------------------------------------------------------------===\n";
+    for (const StatField &f : kStatFields) {
+        std::snprintf(line, sizeof(line), "  %12llu  %s\n",
+                      static_cast<unsigned long long>(this->*f.member), f.name);
+        os << line;
+    }
+}
+
+void Stats::reportJson(std::ostream &os) const {
+    char line[96];
+    os << "{\n";
+    for (size_t i = 0; i < std::size(kStatFields); ++i) {
+        std::snprintf(line, sizeof(line), "  \"%s\": %llu%s\n", kStatFields[i].name,
+                      static_cast<unsigned long long>(this->*kStatFields[i].member),
+                      i + 1 < std::size(kStatFields) ? "," : "");
+        os << line;
+    }
+    os << "}\n";
+}
+
+#pragma endregion
+
+#pragma region 解释执行
+
+namespace {
+
+// Linux RISC-V 系统调用号（错误码、AT_FDCWD 与 open 标志沿用宿主 Linux 的通用值）
+constexpr uint32_t SYS_OPENAT = 56, SYS_CLOSE = 57, SYS_WRITE = 64, SYS_EXIT = 93,
+                   SYS_EXIT_GROUP = 94;
+
+// Machine：一次运行的全部状态
+class Machine {
+  public:
+    Machine(const Image &image, const Options &options);
+    ~Machine() {
+        for (int fd : hostFds_)
+            ::close(fd);
+    }
+
+    Result run();
+
+  private:
+    static constexpr uint32_t kVLMax = 4; // VLEN = 128，e32 / m1
+
+    const Image &image_;
+    const Options &opt_;
+    std::vector<uint8_t> mem_; // [0, memTop_)，低于 kTextBase 的部分不可访问
+    uint32_t memTop_, stackLow_;
+    std::vector<Decoded> cache_; // 代码段每 2 字节一项
+    std::array<uint32_t, 32> x_{};
+    std::array<std::array<uint32_t, kVLMax>, 32> v_{};
+    uint32_t vl_ = 0, vtype_ = 0x80000000; // 初始 vill
+    std::array<uint64_t, 64> ready_{};     // 周期模型：各寄存器结果就绪的周期
+    std::unordered_set<int> hostFds_;      // openat 打开的宿主文件
+    Result result_;
+
+    // check：访存地址合法时返回 true，否则记录错误
+    bool check(uint32_t addr, uint32_t size, bool store, uint32_t pc);
+    uint32_t load(uint32_t addr, uint32_t size) const {
+        uint32_t v = 0;
+        for (uint32_t i = 0; i < size; ++i)
+            v |= uint32_t(mem_[addr + i]) << (8 * i);
+        return v;
+    }
+    void store(uint32_t addr, uint32_t size, uint32_t v) {
+        for (uint32_t i = 0; i < size; ++i)
+            mem_[addr + i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+    bool fault(uint32_t pc, const std::string &msg);
+    bool syscall(uint32_t pc); // 返回 false 表示程序结束
+    const Decoded &fetch(uint32_t pc);
+};
+
+Machine::Machine(const Image &image, const Options &options) : image_(image), opt_(options) {
+    const uint32_t imageTop = (image.end() + 0xfff) & ~0xfffu;
+    memTop_ = imageTop + opt_.stackSize;
+    stackLow_ = imageTop;
+    mem_.assign(memTop_, 0);
+    std::copy(image.bytes.begin(), image.bytes.end(), mem_.begin() + Image::kTextBase);
+    cache_.resize((image.textEnd - Image::kTextBase) / 2);
+    x_[2] = memTop_ & ~15u; // sp
+}
+
+bool Machine::fault(uint32_t pc, const std::string &msg) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), " at pc 0x%08x", pc);
+    result_.status = Result::Status::Fault;
+    result_.error = msg + buf;
+    return false;
+}
+
+bool Machine::check(uint32_t addr, uint32_t size, bool store, uint32_t pc) {
+    char buf[64];
+    if (addr < Image::kTextBase || addr > memTop_ - size) {
+        std::snprintf(buf, sizeof(buf), "%s of %u bytes at invalid address 0x%08x",
+                      store ? "store" : "load", size, addr);
+        return fault(pc, buf);
+    }
+    if (store && addr < image_.textEnd) {
+        std::snprintf(buf, sizeof(buf), "store to code at 0x%08x", addr);
+        return fault(pc, buf);
+    }
+    return true;
+}
+
+const Decoded &Machine::fetch(uint32_t pc) {
+    Decoded &d = cache_[(pc - Image::kTextBase) / 2];
+    if (d.op == Op::Undecoded) {
+        const uint32_t off = pc - Image::kTextBase;
+        const uint16_t lo = static_cast<uint16_t>(load(pc, 2));
+        if ((lo & 3) != 3)
+            d = decode16(lo);
+        else if (off + 4 <= image_.textEnd - Image::kTextBase)
+            d = decode32(load(pc, 4));
+        else
+            d = make(Op::Illegal, 0, 0, 0, 0, 4);
+    }
+    return d;
+}
+
+/**
+ * @brief 系统调用
+ * @details 只实现 crt0.s / profile_rt.s 用到的几个：exit / exit_group 结束运行，write 对 fd 1 / 2
+ *   追加到 Result::output、对 openat 打开的文件写入宿主文件，openat 只接受 AT_FDCWD 下的相对路径
+ *   （Options::fileIO 关闭时返回 -EACCES），close 关闭这类文件；其余系统调用返回 -ENOSYS
+ */
+bool Machine::syscall(uint32_t pc) {
+    const uint32_t a0 = x_[10], a1 = x_[11], a2 = x_[12], a3 = x_[13];
+    int32_t ret = -ENOSYS;
+    switch (x_[17]) {
+    case SYS_EXIT:
+    case SYS_EXIT_GROUP:
+        result_.status = Result::Status::Exited;
+        result_.exitCode = static_cast<int32_t>(a0);
+        return false;
+    case SYS_WRITE: {
+        const int fd = static_cast<int32_t>(a0);
+        if (a2 > 0 && !check(a1, a2, false, pc))
+            return false;
+        const char *buf = reinterpret_cast<const char *>(mem_.data() + a1);
+        if (fd == 1 || fd == 2) {
+            result_.output.append(buf, a2);
+            ret = static_cast<int32_t>(a2);
+        } else if (hostFds_.count(fd)) {
+            ssize_t n = ::write(fd, buf, a2);
+            ret = n < 0 ? -errno : static_cast<int32_t>(n);
+        } else {
+            ret = -EBADF;
+        }
+        break;
+    }
+    case SYS_OPENAT: {
+        std::string path;
+        for (uint32_t p = a1; p < memTop_ && p >= Image::kTextBase && mem_[p]; ++p)
+            path.push_back(static_cast<char>(mem_[p]));
+        if (!opt_.fileIO || static_cast<int32_t>(a0) != AT_FDCWD || path.empty() ||
+            path[0] == '/') {
+            ret = -EACCES;
+            break;
+        }
+        const int flags = static_cast<int>(a2) & (O_ACCMODE | O_CREAT | O_TRUNC | O_APPEND);
+        int fd = ::open(path.c_str(), flags | O_CLOEXEC, static_cast<mode_t>(a3 & 0777));
+        if (fd >= 0)
+            hostFds_.insert(fd);
+        ret = fd < 0 ? -errno : fd;
+        break;
+    }
+    case SYS_CLOSE: {
+        const int fd = static_cast<int32_t>(a0);
+        if (hostFds_.erase(fd)) {
+            ret = ::close(fd) < 0 ? -errno : 0;
+        } else {
+            ret = fd >= 0 && fd <= 2 ? 0 : -EBADF;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    x_[10] = static_cast<uint32_t>(ret);
+    return true;
+}
+
+// 除法的边界情况按 RISC-V 规范：除以 0 得 -1（余数为被除数），INT_MIN / -1 溢出得 INT_MIN（余数 0）
+int32_t sdiv(int32_t a, int32_t b) {
+    return b == 0 ? -1 : (a == INT32_MIN && b == -1) ? a : a / b;
+}
+int32_t srem(int32_t a, int32_t b) {
+    return b == 0 ? a : (a == INT32_MIN && b == -1) ? 0 : a % b;
+}
+
+/**
+ * @brief 主循环
+ * @details 每条指令先查译码缓存（首次执行时译码），再按操作执行并更新计数；周期模型在执行前按
+ *   源寄存器的就绪时间计算停顿，执行后记下目的寄存器的就绪时间，发生跳转时另加重定向开销
+ */
+Result Machine::run() {
+    Stats &s = result_.stats;
+    const uint64_t lat[] = {uint64_t(opt_.model.alu), uint64_t(opt_.model.load),
+                            uint64_t(opt_.model.mul), uint64_t(opt_.model.div)};
+    const uint32_t textBase = Image::kTextBase, textEnd = image_.textEnd;
+    uint64_t t = 0; // 下一条指令最早的发射周期
+    uint32_t pc = image_.entry;
+    char buf[64];
+    for (bool stop = false; !stop;) {
+        if (s.instructions >= opt_.maxSteps) {
+            result_.status = Result::Status::StepLimit;
+            std::snprintf(buf, sizeof(buf), "step limit (%llu) reached at pc 0x%08x",
+                          static_cast<unsigned long long>(opt_.maxSteps), pc);
+            result_.error = buf;
+            break;
+        }
+        if (pc < textBase || pc >= textEnd || (pc & 1)) {
+            std::snprintf(buf, sizeof(buf), "jump to invalid address 0x%08x", pc);
+            fault(pc, buf);
+            break;
+        }
+        const Decoded &d = fetch(pc);
+        ++s.instructions;
+        if (d.size == 2)
+            ++s.compressed;
+        // 周期模型
+        const uint64_t issue = std::max({t, ready_[d.src0], ready_[d.src1]});
+        s.stallCycles += issue - t;
+        t = issue + 1;
+        if (d.dst != 0)
+            ready_[d.dst] = issue + lat[static_cast<int>(d.latency)];
+
+        uint32_t next = pc + d.size;
+        const uint32_t a = x_[d.rs1], b = x_[d.rs2];
+        const int32_t sa = static_cast<int32_t>(a), sb = static_cast<int32_t>(b);
+        uint32_t &rd = x_[d.rd];
+        auto branch = [&](bool taken) {
+            ++s.branches;
+            if (taken) {
+                ++s.branchesTaken;
+                next = pc + static_cast<uint32_t>(d.imm);
+                t += static_cast<uint64_t>(opt_.takenPenalty);
+            }
+        };
+        auto memAddr = [&](uint32_t size, bool isStore) {
+            const uint32_t addr = a + static_cast<uint32_t>(d.imm);
+            if (!check(addr, size, isStore, pc))
+                return false;
+            if (isStore) {
+                ++s.stores;
+                s.stackStores += addr >= stackLow_;
+            } else {
+                ++s.loads;
+                s.stackLoads += addr >= stackLow_;
+            }
+            return true;
+        };
+        auto vectorCheck = [&]() {
+            ++s.vector;
+            if (vtype_ != 0x10 && vtype_ != 0x50 && vtype_ != 0x90 && vtype_ != 0xd0) {
+                std::snprintf(buf, sizeof(buf), "unsupported vtype 0x%x (only e32, m1)", vtype_);
+                return fault(pc, buf);
+            }
+            return true;
+        };
+        switch (d.op) {
+        case Op::LUI:
+            rd = static_cast<uint32_t>(d.imm);
+            break;
+        case Op::AUIPC:
+            rd = pc + static_cast<uint32_t>(d.imm);
+            break;
+        case Op::JAL:
+        case Op::JALR:
+            ++s.jumps;
+            s.calls += d.rd == 1;
+            next = d.op == Op::JAL ? pc + static_cast<uint32_t>(d.imm)
+                                   : (a + static_cast<uint32_t>(d.imm)) & ~1u;
+            rd = pc + d.size;
+            t += static_cast<uint64_t>(opt_.takenPenalty);
+            break;
+        case Op::BEQ:
+            branch(a == b);
+            break;
+        case Op::BNE:
+            branch(a != b);
+            break;
+        case Op::BLT:
+            branch(sa < sb);
+            break;
+        case Op::BGE:
+            branch(sa >= sb);
+            break;
+        case Op::BLTU:
+            branch(a < b);
+            break;
+        case Op::BGEU:
+            branch(a >= b);
+            break;
+        case Op::LB:
+        case Op::LBU:
+            if (!memAddr(1, false)) {
+                stop = true;
+                break;
+            }
+            rd = load(a + static_cast<uint32_t>(d.imm), 1);
+            if (d.op == Op::LB)
+                rd = static_cast<uint32_t>(static_cast<int8_t>(rd));
+            break;
+        case Op::LH:
+        case Op::LHU:
+            if (!memAddr(2, false)) {
+                stop = true;
+                break;
+            }
+            rd = load(a + static_cast<uint32_t>(d.imm), 2);
+            if (d.op == Op::LH)
+                rd = static_cast<uint32_t>(static_cast<int16_t>(rd));
+            break;
+        case Op::LW:
+            if (!memAddr(4, false)) {
+                stop = true;
+                break;
+            }
+            rd = load(a + static_cast<uint32_t>(d.imm), 4);
+            break;
+        case Op::SB:
+        case Op::SH:
+        case Op::SW: {
+            const uint32_t size = d.op == Op::SB ? 1 : d.op == Op::SH ? 2 : 4;
+            if (!memAddr(size, true)) {
+                stop = true;
+                break;
+            }
+            store(a + static_cast<uint32_t>(d.imm), size, b);
+            break;
+        }
+        case Op::ADDI:
+            rd = a + static_cast<uint32_t>(d.imm);
+            break;
+        case Op::SLTI:
+            rd = sa < d.imm;
+            break;
+        case Op::SLTIU:
+            rd = a < static_cast<uint32_t>(d.imm);
+            break;
+        case Op::XORI:
+            rd = a ^ static_cast<uint32_t>(d.imm);
+            break;
+        case Op::ORI:
+            rd = a | static_cast<uint32_t>(d.imm);
+            break;
+        case Op::ANDI:
+            rd = a & static_cast<uint32_t>(d.imm);
+            break;
+        case Op::SLLI:
+            rd = a << d.imm;
+            break;
+        case Op::SRLI:
+            rd = a >> d.imm;
+            break;
+        case Op::SRAI:
+            rd = static_cast<uint32_t>(sa >> d.imm);
+            break;
+        case Op::ADD:
+            rd = a + b;
+            break;
+        case Op::SUB:
+            rd = a - b;
+            break;
+        case Op::SLL:
+            rd = a << (b & 31);
+            break;
+        case Op::SLT:
+            rd = sa < sb;
+            break;
+        case Op::SLTU:
+            rd = a < b;
+            break;
+        case Op::XOR:
+            rd = a ^ b;
+            break;
+        case Op::SRL:
+            rd = a >> (b & 31);
+            break;
+        case Op::SRA:
+            rd = static_cast<uint32_t>(sa >> (b & 31));
+            break;
+        case Op::OR:
+            rd = a | b;
+            break;
+        case Op::AND:
+            rd = a & b;
+            break;
+        case Op::MUL:
+            ++s.mulDiv;
+            rd = a * b;
+            break;
+        case Op::MULH:
+            ++s.mulDiv;
+            rd = static_cast<uint32_t>((int64_t(sa) * int64_t(sb)) >> 32);
+            break;
+        case Op::MULHSU:
+            ++s.mulDiv;
+            rd = static_cast<uint32_t>((int64_t(sa) * int64_t(uint64_t(b))) >> 32);
+            break;
+        case Op::MULHU:
+            ++s.mulDiv;
+            rd = static_cast<uint32_t>((uint64_t(a) * uint64_t(b)) >> 32);
+            break;
+        case Op::DIV:
+            ++s.mulDiv;
+            rd = static_cast<uint32_t>(sdiv(sa, sb));
+            break;
+        case Op::DIVU:
+            ++s.mulDiv;
+            rd = b == 0 ? ~0u : a / b;
+            break;
+        case Op::REM:
+            ++s.mulDiv;
+            rd = static_cast<uint32_t>(srem(sa, sb));
+            break;
+        case Op::REMU:
+            ++s.mulDiv;
+            rd = b == 0 ? a : a % b;
+            break;
+        case Op::FENCE:
+            break;
+        case Op::ECALL:
+            stop = !syscall(pc);
+            break;
+        case Op::EBREAK:
+            stop = !fault(pc, "ebreak");
+            break;
+        case Op::VSETVLI: {
+            ++s.vector;
+            vtype_ = static_cast<uint32_t>(d.imm);
+            if (d.rs1 != 0)
+                vl_ = std::min(a, kVLMax);
+            else if (d.rd != 0)
+                vl_ = kVLMax;
+            rd = vl_;
+            break;
+        }
+        case Op::VADD_VV:
+        case Op::VSUB_VV:
+        case Op::VMUL_VV:
+        case Op::VDIV_VV:
+        case Op::VREM_VV:
+        case Op::VADD_VX: {
+            if (!vectorCheck()) {
+                stop = true;
+                break;
+            }
+            auto &vd = v_[d.rd];
+            const auto &vs2 = v_[d.rs1], &vs1 = v_[d.rs2];
+            for (uint32_t k = 0; k < vl_; ++k) {
+                const uint32_t l = vs2[k], r = d.op == Op::VADD_VX ? b : vs1[k];
+                const int32_t sl = static_cast<int32_t>(l), sr = static_cast<int32_t>(r);
+                vd[k] = d.op == Op::VADD_VV || d.op == Op::VADD_VX ? l + r
+                        : d.op == Op::VSUB_VV                     ? l - r
+                        : d.op == Op::VMUL_VV                     ? l * r
+                        : d.op == Op::VDIV_VV ? static_cast<uint32_t>(sdiv(sl, sr))
+                                              : static_cast<uint32_t>(srem(sl, sr));
+            }
+            break;
+        }
+        case Op::VMV_V_X:
+            if (!vectorCheck()) {
+                stop = true;
+                break;
+            }
+            for (uint32_t k = 0; k < vl_; ++k)
+                v_[d.rd][k] = b;
+            break;
+        case Op::VID_V:
+            if (!vectorCheck()) {
+                stop = true;
+                break;
+            }
+            for (uint32_t k = 0; k < vl_; ++k)
+                v_[d.rd][k] = k;
+            break;
+        case Op::VREDSUM_VS: {
+            if (!vectorCheck()) {
+                stop = true;
+                break;
+            }
+            if (vl_ == 0)
+                break;
+            uint32_t sum = v_[d.rs2][0];
+            for (uint32_t k = 0; k < vl_; ++k)
+                sum += v_[d.rs1][k];
+            v_[d.rd][0] = sum;
+            break;
+        }
+        case Op::VMV_S_X:
+            if (!vectorCheck()) {
+                stop = true;
+                break;
+            }
+            if (vl_ > 0)
+                v_[d.rd][0] = b;
+            break;
+        case Op::VMV_X_S:
+            if (!vectorCheck()) {
+                stop = true;
+                break;
+            }
+            rd = v_[d.rs1][0];
+            break;
+        case Op::Illegal:
+        case Op::Undecoded: {
+            const uint32_t word = d.size == 2 ? load(pc, 2) : load(pc, 4);
+            std::snprintf(buf, sizeof(buf), "illegal instruction 0x%0*x", d.size * 2, word);
+            stop = !fault(pc, buf);
+            break;
+        }
+        }
+        x_[0] = 0;
+        pc = next;
+    }
+    s.cycles = t;
+    return result_;
+}
+
+} // namespace
+
+Result run(const Image &image, const Options &options) {
+    Machine machine(image, options);
+    Result result = machine.run();
+    return result;
+}
+
+#pragma endregion
+
+} // namespace toyc::sim
@@ -0,0 +1,103 @@
+#include "source_buffer.h"
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TOYC_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace toyc {
+
+namespace {
+
+// readWhole：整块读取文件（无法映射时的退路；可定位的文件按大小预留，只分配一次）
+std::string readWhole(const std::string &path) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.is_open())
+        throw std::runtime_error("cannot open file");
+    std::string text;
+    auto *buf = ifs.rdbuf();
+    auto end = buf->pubseekoff(0, std::ios::end, std::ios::in); // 管道等不可定位时返回 -1
+    if (end > 0) {
+        text.reserve(static_cast<size_t>(end));
+        buf->pubseekpos(0, std::ios::in);
+    }
+    char chunk[4096];
+    while (ifs.read(chunk, sizeof(chunk)) || ifs.gcount() > 0)
+        text.append(chunk, static_cast<size_t>(ifs.gcount()));
+    return text;
+}
+
+} // namespace
+
+/**
+ * @brief 打开源文件
+ * @details 非空普通文件使用 mmap(PROT_READ, MAP_PRIVATE) 映射，映射建立后即可关闭描述符；
+ *   mmap 失败（或空文件 / 非普通文件）时退化为 readWhole 读入自有字符串
+ */
+SourceBuffer SourceBuffer::open(const std::string &path) {
+    SourceBuffer buf;
+#ifdef TOYC_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("cannot open file");
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        size_t len = static_cast<size_t>(st.st_size);
+        void *p = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            ::madvise(p, len, MADV_SEQUENTIAL); // 词法分析按顺序扫描一遍
+            ::close(fd);
+            buf.data_ = static_cast<const char *>(p);
+            buf.size_ = len;
+            buf.mapped_ = true;
+            return buf;
+        }
+    }
+    ::close(fd);
+#endif
+    buf.owned_ = readWhole(path);
+    return buf;
+}
+
+SourceBuffer SourceBuffer::fromString(std::string text) {
+    SourceBuffer buf;
+    buf.owned_ = std::move(text);
+    return buf;
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)),
+      mapped_(std::exchange(other.mapped_, false)), owned_(std::move(other.owned_)) {}
+
+SourceBuffer &SourceBuffer::operator=(SourceBuffer &&other) noexcept {
+    if (this != &other) {
+        release();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        mapped_ = std::exchange(other.mapped_, false);
+        owned_ = std::move(other.owned_);
+    }
+    return *this;
+}
+
+SourceBuffer::~SourceBuffer() { release(); }
+
+// release：解除映射并清空内容
+void SourceBuffer::release() {
+#ifdef TOYC_HAVE_MMAP
+    if (mapped_)
+        ::munmap(const_cast<char *>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    owned_.clear();
+}
+
+} // namespace toyc
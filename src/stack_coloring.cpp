@@ -0,0 +1,232 @@
+#include "reg_alloc.h"
+#include "statistics.h"
+#include <algorithm>
+#include <map>
+
+namespace toyc {
+
+using namespace ir;
+
+namespace {
+
+// overlaps：两个区间（范围按起点排序、互不重叠）是否有公共位置
+bool overlaps(const LiveInterval &a, const LiveInterval &b) {
+    size_t i = 0, j = 0;
+    while (i < a.ranges.size() && j < b.ranges.size()) {
+        if (a.ranges[i].overlaps(b.ranges[j]))
+            return true;
+        if (a.ranges[i].end < b.ranges[j].end)
+            ++i;
+        else
+            ++j;
+    }
+    return false;
+}
+
+// numberInstructions：按 RPO 顺序为指令编号（与线性扫描的 assignInstrPositions 相同）
+void numberInstructions(Function &F) {
+    int pos = 0;
+    for (auto *block : F.rpoOrder)
+        for (auto *inst : block->insts) {
+            inst->index = pos++;
+            inst->blockId = block->id;
+        }
+}
+
+/**
+ * @brief 溢出栈槽着色
+ * @details 同一栈槽的 vreg（分裂片段与其根 vreg、图着色合并的 vreg）作为一组，组的活跃区间取成员
+ *   区间之并；按起点先适配（first-fit）地把组放进区间互不相交的新栈槽。代码生成在 def 之后写回、
+ *   在 use 之前读取，区间不相交的两组在同一位置不会同时持有值。成员都没有区间的组（只出现在不可达
+ *   块中）独占栈槽
+ */
+int colorSpillSlots(Function &F, AllocationResult &result) {
+    std::map<int, std::vector<int>> bySlot; // 栈槽 → 使用它的 vreg
+    for (auto [vreg, slot] : result.vregToStack)
+        if (slot < 0)
+            bySlot[slot].push_back(vreg);
+    if (bySlot.size() < 2)
+        return 0;
+
+    LivenessAnalysis LA;
+    LA.run(F);
+    numberInstructions(F);
+    LiveIntervalTable intervals = LiveIntervalBuilder(F, LA).build();
+
+    struct Group {
+        int slot;
+        LiveInterval live;
+    };
+    std::vector<Group> groups;
+    for (auto it = bySlot.rbegin(); it != bySlot.rend(); ++it) { // -4, -8, ... 的原有顺序
+        Group group{it->first, LiveInterval(-1)};
+        for (int vreg : it->second)
+            if (const LiveInterval *iv = intervals.get(vreg))
+                for (const LiveRange &r : iv->ranges)
+                    group.live.addRange(r.start, r.end);
+        groups.push_back(std::move(group));
+    }
+    std::stable_sort(groups.begin(), groups.end(), [](const Group &a, const Group &b) {
+        if (a.live.empty() || b.live.empty())
+            return !a.live.empty() && b.live.empty();
+        return a.live.start() < b.live.start();
+    });
+
+    std::vector<LiveInterval> colors; // 新栈槽 → 已放入的组的区间之并
+    std::vector<bool> shareable;      // 新栈槽能否再放入其它组
+    std::unordered_map<int, int> newSlot;
+    for (const Group &group : groups) {
+        size_t c = 0;
+        while (c < colors.size() &&
+               (group.live.empty() || !shareable[c] || overlaps(colors[c], group.live)))
+            ++c;
+        if (c == colors.size()) {
+            colors.emplace_back(-1);
+            shareable.push_back(!group.live.empty());
+        }
+        for (const LiveRange &r : group.live.ranges)
+            colors[c].addRange(r.start, r.end);
+        newSlot[group.slot] = -static_cast<int>(c + 1) * 4;
+    }
+    for (auto &[vreg, slot] : result.vregToStack)
+        if (slot < 0)
+            slot = newSlot[slot];
+    return static_cast<int>(groups.size() - colors.size());
+}
+
+/**
+ * @brief alloca 着色
+ * @details 在 alloca 的内存上做反向活跃性分析（load 为 use，store 整体覆盖为 def）：store 某个
+ *   alloca 时仍活跃的其它 alloca 与它冲突，入口处活跃（可能先读后写）的 alloca 两两冲突。按出现
+ *   顺序贪心地取第一个没有冲突成员的颜色。
+ *   IRBuilder 在 break / return 之后留下不会执行的终结指令，而 buildCFG 只看块的最后一条，
+ *   所以这里不用 BasicBlock::succs：每个块只扫描到第一条终结指令，后继取自这条指令
+ *   （没有终结指令时顺序落入下一块）
+ */
+int colorAllocas(const Function &F, AllocationResult &result) {
+    std::vector<int> allocas;           // 颜色下标 → alloca vreg（按出现顺序）
+    std::unordered_map<int, int> index; // alloca vreg → 下标
+    for (const auto &bb : F.blocks)
+        for (const Instruction *inst : bb->insts)
+            if (inst->opcode == Opcode::Alloca) {
+                index.emplace(inst->defReg(), static_cast<int>(allocas.size()));
+                allocas.push_back(inst->defReg());
+            }
+    const size_t n = allocas.size();
+    if (n < 2) {
+        for (size_t i = 0; i < n; ++i)
+            result.allocaColors[allocas[i]] = static_cast<int>(i);
+        return 0;
+    }
+    // accessed：load / store 访问的 alloca 下标（其它指令为 -1）
+    auto accessed = [&](const Instruction &inst) {
+        const Operand *ptr = inst.opcode == Opcode::Load    ? &inst.ops[0]
+                             : inst.opcode == Opcode::Store ? &inst.ops[1]
+                                                            : nullptr;
+        if (!ptr || !ptr->isVReg())
+            return -1;
+        auto it = index.find(ptr->regId());
+        return it == index.end() ? -1 : it->second;
+    };
+
+    // 每个块实际执行的指令数（到第一条终结指令为止）与后继
+    const size_t nb = F.blocks.size();
+    std::vector<size_t> length(nb);
+    std::vector<std::vector<size_t>> succs(nb);
+    for (size_t b = 0; b < nb; ++b) {
+        const auto &insts = F.blocks[b]->insts;
+        auto term = std::find_if(insts.begin(), insts.end(),
+                                 [](const Instruction *I) { return I->isTerminator(); });
+        length[b] = static_cast<size_t>(term - insts.begin()) + (term != insts.end());
+        if (term == insts.end()) {
+            if (b + 1 < nb)
+                succs[b].push_back(b + 1);
+            continue;
+        }
+        for (const std::string &label : (*term)->branchTargets())
+            if (auto it = F.blockMap.find(label); it != F.blockMap.end())
+                succs[b].push_back(static_cast<size_t>(it->second->id));
+    }
+
+    // 块内先读后写（gen）与写（kill），再迭代求 liveIn / liveOut
+    std::vector<BitVector> gen(nb, BitVector(n)), kill(nb, BitVector(n));
+    std::vector<BitVector> liveIn(nb, BitVector(n)), liveOut(nb, BitVector(n));
+    for (size_t b = 0; b < nb; ++b)
+        for (size_t i = 0; i < length[b]; ++i) {
+            const Instruction *inst = F.blocks[b]->insts[i];
+            int a = accessed(*inst);
+            if (a < 0)
+                continue;
+            if (inst->opcode == Opcode::Load && !kill[b].test(a))
+                gen[b].set(a);
+            else if (inst->opcode == Opcode::Store)
+                kill[b].set(a);
+        }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t b = nb; b-- > 0;) {
+            for (size_t succ : succs[b])
+                liveOut[b].unionWith(liveIn[succ]);
+            changed |= liveIn[b].assignUnionDiff(gen[b], liveOut[b], kill[b]);
+        }
+    }
+
+    std::vector<BitVector> interferes(n, BitVector(n));
+    auto addEdge = [&](int a, int b) {
+        interferes[a].set(b);
+        interferes[b].set(a);
+    };
+    for (size_t b = 0; b < nb; ++b) {
+        BitVector live = liveOut[b];
+        const auto &insts = F.blocks[b]->insts;
+        for (auto it = insts.rend() - static_cast<std::ptrdiff_t>(length[b]); it != insts.rend();
+             ++it) {
+            int a = accessed(**it);
+            if (a < 0)
+                continue;
+            if ((*it)->opcode == Opcode::Store) {
+                live.forEach([&](int other) {
+                    if (other != a)
+                        addEdge(a, other);
+                });
+                live.reset(a);
+            } else {
+                live.set(a);
+            }
+        }
+    }
+    liveIn[0].forEach([&](int a) {
+        liveIn[0].forEach([&](int b) {
+            if (a != b)
+                addEdge(a, b);
+        });
+    });
+
+    std::vector<std::vector<int>> members; // 颜色 → alloca 下标
+    for (size_t i = 0; i < n; ++i) {
+        size_t c = 0;
+        while (c < members.size() &&
+               std::any_of(members[c].begin(), members[c].end(),
+                           [&](int m) { return interferes[i].test(m); }))
+            ++c;
+        if (c == members.size())
+            members.emplace_back();
+        members[c].push_back(static_cast<int>(i));
+        result.allocaColors[allocas[i]] = static_cast<int>(c);
+    }
+    return static_cast<int>(n - members.size());
+}
+
+} // namespace
+
+/**
+ * @brief 栈槽着色
+ * @details 分配结束后执行一次：溢出栈槽按活跃区间、alloca 按内存活跃性分别着色，互不冲突的
+ *   共用同一块栈空间。栈帧随同时活跃的数量而不是总数增长，深递归时每层占用的栈也更少
+ */
+void colorStackSlots(Function &F, AllocationResult &result) {
+    int shared = colorSpillSlots(F, result) + colorAllocas(F, result);
+    stats::add(stats::Counter::StackSlotsShared, static_cast<uint64_t>(shared));
+}
+
+} // namespace toyc
@@ -0,0 +1,171 @@
+#include "statistics.h"
+#include <cstdio>
+#include <sys/resource.h>
+
+namespace toyc {
+namespace stats {
+
+namespace detail {
+std::atomic<bool> enabled{false};
+} // namespace detail
+
+namespace {
+
+// PhaseData：一个阶段的累计数据（各线程并发更新）
+struct PhaseData {
+    std::atomic<int64_t> nanos{0};
+    std::atomic<uint64_t> calls{0};
+    std::atomic<long> peakRssKB{0};
+};
+
+constexpr size_t kNumPhases = static_cast<size_t>(Phase::Count);
+constexpr size_t kNumCounters = static_cast<size_t>(Counter::Count);
+
+PhaseData gPhases[kNumPhases];
+std::atomic<uint64_t> gCounters[kNumCounters];
+std::chrono::steady_clock::time_point gStart;
+
+const char *const kPhaseNames[kNumPhases] = {
+    "parse",     "ir-build",    "ir-load",     "opt",  "liveness",
+    "intervals", "linear-scan", "graph-color", "isel", "emit",
+};
+
+const char *const kCounterNames[kNumCounters] = {
+    "functions",     "ir-instructions", "vregs",      "intervals",
+    "spills",        "machine-insts",   "cache-hits", "cache-misses",
+    "promoted-allocas", "spill-cost", "split-pieces", "call-save-restores",
+    "coalesced-moves", "propagated-copies", "folded-constants",
+    "gvn-eliminated", "dead-insts", "removed-blocks", "licm-hoisted",
+    "strength-reduced", "inlined-calls", "tail-recursions", "tail-calls",
+    "peephole-removed", "fused-compares", "sched-stalls-removed",
+    "compressed-insts", "text-bytes", "frameless-leaves", "shrink-wrapped",
+    "stack-slots-shared", "rematerialized", "vectorized-loops",
+};
+
+// peakRssKB：进程至今的 RSS 高水位（KiB）
+long peakRssKB() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+// wallMillis：enable() 至今的墙钟时间
+double wallMillis() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - gStart)
+        .count();
+}
+
+double phaseMillis(const PhaseData &p) { return p.nanos.load(std::memory_order_relaxed) / 1e6; }
+
+} // namespace
+
+void detail::recordPhase(Phase phase, std::chrono::steady_clock::duration elapsed) {
+    PhaseData &p = gPhases[static_cast<size_t>(phase)];
+    p.nanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                      std::memory_order_relaxed);
+    p.calls.fetch_add(1, std::memory_order_relaxed);
+    long rss = peakRssKB();
+    long prev = p.peakRssKB.load(std::memory_order_relaxed);
+    while (prev < rss &&
+           !p.peakRssKB.compare_exchange_weak(prev, rss, std::memory_order_relaxed)) {
+    }
+}
+
+void detail::addCounter(Counter counter, uint64_t n) {
+    gCounters[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+}
+
+// enable：清零所有数据后打开开关
+void enable() {
+    for (auto &p : gPhases) {
+        p.nanos.store(0, std::memory_order_relaxed);
+        p.calls.store(0, std::memory_order_relaxed);
+        p.peakRssKB.store(0, std::memory_order_relaxed);
+    }
+    for (auto &c : gCounters)
+        c.store(0, std::memory_order_relaxed);
+    gStart = std::chrono::steady_clock::now();
+    detail::enabled.store(true, std::memory_order_relaxed);
+}
+
+// counter：读取计数器
+uint64_t counter(Counter c) {
+    return gCounters[static_cast<size_t>(c)].load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief 输出阶段耗时表
+ * @details 占比相对于各阶段耗时之和；未被调用过的阶段不输出。
+ *   -j N 时阶段耗时为各线程之和，因此合计可能超过墙钟总时间
+ */
+void reportTimes(std::ostream &os) {
+    double total = 0;
+    for (const auto &p : gPhases)
+        total += phaseMillis(p);
+
+    char line[128];
+    os << "===-------------------------------------------------------------===\n"
+       << "                    ToyC pass execution timing\n"
+       << "===-------------------------------------------------------------===\n";
+    std::snprintf(line, sizeof(line), "  Total wall time: %.3f ms (phases: %.3f ms)\n\n",
+                  wallMillis(), total);
+    os << line;
+    os << "   Time (ms)  %Total      Calls  Peak RSS (KB)  Phase\n";
+    for (size_t i = 0; i < kNumPhases; ++i) {
+        const PhaseData &p = gPhases[i];
+        uint64_t calls = p.calls.load(std::memory_order_relaxed);
+        if (calls == 0)
+            continue;
+        double ms = phaseMillis(p);
+        std::snprintf(line, sizeof(line), "  %10.3f  %5.1f%%  %9llu  %13ld  %s\n", ms,
+                      total > 0 ? 100.0 * ms / total : 0.0, static_cast<unsigned long long>(calls),
+                      p.peakRssKB.load(std::memory_order_relaxed), kPhaseNames[i]);
+        os << line;
+    }
+}
+
+// reportCounters：输出计数器表（全部输出，包括为 0 的项）
+void reportCounters(std::ostream &os) {
+    char line[96];
+    os << "===-------------------------------------------------------------===\n"
+       << "                          ToyC statistics\n"
+       << "===-------------------------------------------------------------===\n";
+    for (size_t i = 0; i < kNumCounters; ++i) {
+        std::snprintf(line, sizeof(line), "  %12llu  %s\n",
+                      static_cast<unsigned long long>(gCounters[i].load(std::memory_order_relaxed)),
+                      kCounterNames[i]);
+        os << line;
+    }
+}
+
+/**
+ * @brief 输出 JSON 格式的统计
+ * @details {"wall_ms": ..., "phases": {"parse": {"ms", "calls", "peak_rss_kb"}, ...},
+ *   "counters": {"functions": ..., ...}}；未被调用过的阶段同样输出（calls 为 0）
+ */
+void reportJson(std::ostream &os) {
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "{\n  \"wall_ms\": %.3f,\n  \"phases\": {\n", wallMillis());
+    os << buf;
+    for (size_t i = 0; i < kNumPhases; ++i) {
+        const PhaseData &p = gPhases[i];
+        std::snprintf(buf, sizeof(buf),
+                      "    \"%s\": {\"ms\": %.3f, \"calls\": %llu, \"peak_rss_kb\": %ld}%s\n",
+                      kPhaseNames[i], phaseMillis(p),
+                      static_cast<unsigned long long>(p.calls.load(std::memory_order_relaxed)),
+                      p.peakRssKB.load(std::memory_order_relaxed),
+                      i + 1 < kNumPhases ? "," : "");
+        os << buf;
+    }
+    os << "  },\n  \"counters\": {\n";
+    for (size_t i = 0; i < kNumCounters; ++i) {
+        std::snprintf(buf, sizeof(buf), "    \"%s\": %llu%s\n", kCounterNames[i],
+                      static_cast<unsigned long long>(gCounters[i].load(std::memory_order_relaxed)),
+                      i + 1 < kNumCounters ? "," : "");
+        os << buf;
+    }
+    os << "  }\n}\n";
+}
+
+} // namespace stats
+} // namespace toyc
@@ -0,0 +1,332 @@
+#include "ir_passes.h"
+#include "statistics.h"
+#include <algorithm>
+#include <optional>
+
+namespace toyc {
+namespace opt {
+
+using namespace ir;
+
+namespace {
+
+// isReturnOf：I 是否为返回 call 结果的 ret（无返回值的调用后紧跟 ret void 也算）
+bool isReturnOf(const Instruction *I, const Instruction *call) {
+    if (I->opcode == Opcode::RetVoid)
+        return true;
+    return I->opcode == Opcode::Ret && call->def.isVReg() && I->ops[0].isVReg() &&
+           I->ops[0].regId() == call->defReg();
+}
+
+// isAccumulatorOp：可以改写为累加器的运算（32 位回绕下满足结合律与交换律）
+bool isAccumulatorOp(Opcode op) { return op == Opcode::Add || op == Opcode::Mul; }
+
+// RecursiveReturn：一处自递归返回
+//   纯尾调用：  %r = call @F(args); ret %r
+//   累加器形式：%r = call @F(args); %v = op %x, %r（或 op %r, %x）; ret %v   op ∈ {add, mul}
+struct RecursiveReturn {
+    BasicBlock *block;
+    Instruction *call;
+    Instruction *combine = nullptr; // 累加器形式的 op（纯尾调用为空）
+    Operand other;                  // op 的另一个操作数 %x
+};
+
+// TailRecursionEliminator：把自递归的返回改写为跳回函数开头的循环
+class TailRecursionEliminator {
+  public:
+    explicit TailRecursionEliminator(Function &F) : F_(F) {}
+
+    int run();
+
+  private:
+    Function &F_;
+
+    bool isSelfCall(const Instruction *I) const {
+        return I->opcode == Opcode::Call && I->callee.str() == F_.name &&
+               I->ops.size() == F_.paramVregs.size();
+    }
+    std::optional<RecursiveReturn> matchReturn(BasicBlock *bb) const;
+    bool foldReturnsIntoPredecessors();
+    BasicBlock *splitEntry();
+    Operand newVreg() { return Operand::vreg(++F_.maxVregId); }
+};
+
+/**
+ * @brief 识别块末尾的自递归返回
+ * @details 只看块的最后两条或三条指令：调用与 ret 之间最多隔一条结合 / 交换的运算，
+ *   且运算的另一个操作数不是调用结果本身（%r * %r 不能改写）
+ */
+std::optional<RecursiveReturn> TailRecursionEliminator::matchReturn(BasicBlock *bb) const {
+    const auto &insts = bb->insts;
+    const size_t n = insts.size();
+    if (n < 2 || !(insts[n - 1]->opcode == Opcode::Ret || insts[n - 1]->opcode == Opcode::RetVoid))
+        return std::nullopt;
+    if (isSelfCall(insts[n - 2]) && isReturnOf(insts[n - 1], insts[n - 2]))
+        return RecursiveReturn{bb, insts[n - 2], nullptr, Operand()};
+    if (n < 3 || !isSelfCall(insts[n - 3]) || insts[n - 1]->opcode != Opcode::Ret)
+        return std::nullopt;
+    Instruction *call = insts[n - 3], *combine = insts[n - 2];
+    if (!isAccumulatorOp(combine->opcode) || !isReturnOf(insts[n - 1], combine) ||
+        !call->def.isVReg())
+        return std::nullopt;
+    const int r = call->defReg();
+    const Operand &a = combine->ops[0], &b = combine->ops[1];
+    const bool aIsR = a.isVReg() && a.regId() == r, bIsR = b.isVReg() && b.regId() == r;
+    if (aIsR == bIsR)
+        return std::nullopt;
+    return RecursiveReturn{bb, call, combine, aIsR ? b : a};
+}
+
+/**
+ * @brief 把只含 phi 与 ret 的返回块复制到以自递归调用（及其累加运算）结尾、无条件跳来的前驱中
+ * @details IRBuilder 把 "r = ...; return r;" 的多条路径汇合到一个返回块，调用与 ret 被 phi 隔开。
+ *   前驱 B 的 br R 改为 ret 它经 R 的 phi 带入的值，R 的 phi 删除来自 B 的入口。
+ *   R 的 ret 操作数若不是 R 的 phi，则它的定义支配 R，也就支配 B，可以原样返回
+ */
+bool TailRecursionEliminator::foldReturnsIntoPredecessors() {
+    bool changed = false;
+    for (auto &block : F_.blocks) {
+        BasicBlock *R = block.get();
+        Instruction *ret = R->insts.empty() ? nullptr : R->insts.back();
+        if (!ret || ret->opcode != Opcode::Ret ||
+            !std::all_of(R->insts.begin(), R->insts.end() - 1,
+                         [](const Instruction *I) { return I->opcode == Opcode::Phi; }))
+            continue;
+        const Instruction *phi = nullptr;
+        for (const Instruction *I : R->insts)
+            if (I->opcode == Opcode::Phi && ret->ops[0].isVReg() &&
+                I->defReg() == ret->ops[0].regId())
+                phi = I;
+        const std::vector<BasicBlock *> preds = R->preds;
+        for (BasicBlock *B : preds) {
+            const auto &insts = B->insts;
+            if (insts.size() < 2 || insts.back()->opcode != Opcode::Br)
+                continue;
+            const Instruction *last = insts[insts.size() - 2];
+            bool endsInRecursion =
+                isSelfCall(last) || (insts.size() >= 3 && isAccumulatorOp(last->opcode) &&
+                                     isSelfCall(insts[insts.size() - 3]));
+            if (!endsInRecursion)
+                continue;
+            const Symbol bName(B->name);
+            Operand value = ret->ops[0];
+            if (phi)
+                for (size_t k = 0; k < phi->numIncoming(); ++k)
+                    if (phi->incomingBlock(k) == bName)
+                        value = phi->incomingValue(k);
+            Instruction *newRet = F_.newInst(Instruction::makeRet(ret->type.str(), value));
+            newRet->blockId = B->id;
+            B->insts.back() = newRet;
+            for (Instruction *I : R->insts) {
+                if (I->opcode != Opcode::Phi)
+                    break;
+                OperandList kept;
+                for (size_t k = 0; k < I->numIncoming(); ++k)
+                    if (I->incomingBlock(k) != bName) {
+                        kept.push_back(I->incomingValue(k));
+                        kept.push_back(I->ops[2 * k + 1]);
+                    }
+                I->ops = kept;
+            }
+            changed = true;
+        }
+    }
+    if (changed) {
+        F_.buildCFG();
+        removeUnreachableBlocks(F_);
+        prunePhiIncomings(F_);
+    }
+    return changed;
+}
+
+/**
+ * @brief 把入口块拆为 entry（只留 alloca 与 br）与循环头 tailrecurse（原入口的其余指令）
+ * @details 入口块不能有前驱，自递归改成的回边只能跳到新的头结点。
+ *   原入口的后继中来自入口的 phi 入口改记为头结点；返回头结点（已重新编号并重建 CFG）
+ */
+BasicBlock *TailRecursionEliminator::splitEntry() {
+    BasicBlock *entry = F_.entryBlock();
+    auto header = std::make_unique<BasicBlock>();
+    header->name = "tailrecurse";
+    while (F_.blockMap.count(header->name))
+        header->name += "_";
+    F_.blockMap[header->name] = header.get();
+    const Symbol entryName(entry->name), headerName(header->name);
+
+    std::vector<Instruction *> kept;
+    for (Instruction *I : entry->insts)
+        (I->opcode == Opcode::Alloca ? kept : header->insts).push_back(I);
+    entry->insts = std::move(kept);
+    entry->insts.push_back(F_.newInst(Instruction::makeBr(Operand::label(headerName))));
+    for (BasicBlock *S : entry->succs)
+        for (Instruction *I : S->insts) {
+            if (I->opcode != Opcode::Phi)
+                break;
+            for (size_t k = 0; k < I->numIncoming(); ++k)
+                if (I->incomingBlock(k) == entryName)
+                    I->ops[2 * k + 1] = Operand::label(headerName);
+        }
+
+    BasicBlock *H = header.get();
+    F_.blocks.insert(F_.blocks.begin() + 1, std::move(header));
+    for (size_t i = 0; i < F_.blocks.size(); ++i) {
+        BasicBlock *bb = F_.blocks[i].get();
+        bb->id = static_cast<int>(i);
+        for (Instruction *I : bb->insts)
+            I->blockId = bb->id;
+    }
+    F_.buildCFG();
+    return H;
+}
+
+/**
+ * @brief 自递归改写为循环
+ * @details 1. 返回块复制进以自递归结尾的前驱（foldReturnsIntoPredecessors）
+ *   2. 收集自递归返回；累加器形式只保留与第一处相同的运算（add 与 mul 不能共用一个累加器）
+ *   3. 入口拆出头结点，每个形参在头结点得到一个 phi [形参, entry]，函数中形参的 use 改读 phi；
+ *      有累加器形式时再加 %acc = phi [单位元, entry]（add 为 0，mul 为 1）
+ *   4. 每处自递归返回改为 br 头结点：实参成为形参 phi 的入口，累加器入口为 %acc op %x（纯尾调用为 %acc）
+ *   5. 有累加器时，其余每个 ret v 改为 ret %acc op v
+ *   32 位回绕的 add / mul 满足结合律与交换律，改写后结果与递归计算逐位相同。返回消除的递归调用数
+ */
+int TailRecursionEliminator::run() {
+    if (F_.blocks.empty())
+        return 0;
+    F_.buildCFG();
+    foldReturnsIntoPredecessors();
+
+    std::vector<RecursiveReturn> sites;
+    std::optional<Opcode> accOp;
+    for (auto &bb : F_.blocks) {
+        auto site = matchReturn(bb.get());
+        if (!site)
+            continue;
+        if (site->combine) {
+            if (accOp && *accOp != site->combine->opcode)
+                continue;
+            accOp = site->combine->opcode;
+        }
+        sites.push_back(*site);
+    }
+    if (sites.empty())
+        return 0;
+
+    BasicBlock *H = splitEntry();
+    const Symbol entryName(F_.entryBlock()->name), headerName(H->name);
+    auto prepend = [&](Instruction inst) {
+        Instruction *I = F_.newInst(std::move(inst));
+        I->blockId = H->id;
+        H->insts.insert(H->insts.begin(), I);
+        return I;
+    };
+
+    // 形参 phi：函数中形参的 use 全部改读 phi（入口块之外只剩 phi 自己的入口读取形参）
+    std::vector<Instruction *> paramPhis;
+    for (size_t k = 0; k < F_.paramVregs.size(); ++k) {
+        const int p = F_.paramVregs[k];
+        const Operand phiDef = newVreg();
+        auto rename = [&](Operand &op) {
+            if (op.isVReg() && op.regId() == p)
+                op = phiDef;
+        };
+        for (auto &bb : F_.blocks)
+            for (Instruction *I : bb->insts)
+                for (Operand &op : I->ops)
+                    rename(op);
+        for (RecursiveReturn &site : sites)
+            rename(site.other);
+        Instruction phi = Instruction::makePhi(phiDef, F_.params[k].type);
+        phi.addIncoming(Operand::vreg(p), entryName);
+        paramPhis.push_back(prepend(std::move(phi)));
+    }
+    Instruction *acc = nullptr;
+    const std::string type = sites.front().call->type.str();
+    const int identity = accOp == Opcode::Mul ? 1 : 0;
+    if (accOp) {
+        Instruction phi = Instruction::makePhi(newVreg(), type);
+        phi.addIncoming(Operand::imm(identity), entryName);
+        acc = prepend(std::move(phi));
+    }
+
+    // 自递归返回 → 回边
+    for (const RecursiveReturn &site : sites) {
+        BasicBlock *B = site.block;
+        const Symbol bName(B->name);
+        for (size_t k = 0; k < paramPhis.size(); ++k)
+            paramPhis[k]->addIncoming(site.call->ops[k], bName);
+        auto pos = std::find(B->insts.begin(), B->insts.end(), site.call);
+        B->insts.erase(pos, B->insts.end());
+        if (acc) {
+            Operand next = acc->def;
+            if (site.combine) {
+                next = newVreg();
+                Instruction combine = Instruction::makeBinOp(*accOp, next, type, acc->def,
+                                                             site.other);
+                combine.nsw = false;
+                Instruction *I = F_.newInst(std::move(combine));
+                I->blockId = B->id;
+                B->insts.push_back(I);
+            }
+            acc->addIncoming(next, bName);
+        }
+        Instruction *br = F_.newInst(Instruction::makeBr(Operand::label(headerName)));
+        br->blockId = B->id;
+        B->insts.push_back(br);
+    }
+
+    // 其余返回：ret v → ret %acc op v（v 为单位元时直接 ret %acc）
+    if (acc)
+        for (auto &bb : F_.blocks) {
+            Instruction *ret = bb->insts.empty() ? nullptr : bb->insts.back();
+            if (!ret || ret->opcode != Opcode::Ret)
+                continue;
+            if (ret->ops[0].isImm() && ret->ops[0].immValue() == identity) {
+                ret->ops[0] = acc->def;
+                continue;
+            }
+            const Operand result = newVreg();
+            Instruction combine =
+                Instruction::makeBinOp(*accOp, result, type, acc->def, ret->ops[0]);
+            combine.nsw = false;
+            Instruction *I = F_.newInst(std::move(combine));
+            I->blockId = bb->id;
+            bb->insts.insert(bb->insts.end() - 1, I);
+            ret->ops[0] = result;
+        }
+
+    F_.buildCFG();
+    return static_cast<int>(sites.size());
+}
+
+} // namespace
+
+// eliminateTailRecursion：对单个函数执行自递归消除
+int eliminateTailRecursion(Function &F) {
+    int eliminated = TailRecursionEliminator(F).run();
+    stats::add(stats::Counter::TailRecursions, static_cast<uint64_t>(eliminated));
+    return eliminated;
+}
+
+/**
+ * @brief 标记尾调用
+ * @details call 紧跟返回其结果的 ret（或无返回值的调用后紧跟 ret void）时置 tail，否则清除
+ *   （内联或化简可能把原来的尾调用移到别处）。ToyC 没有取地址，被调函数不会访问调用者的栈帧，
+ *   位置满足即可撤销栈帧后跳转；实参超过 8 个的调用由代码生成按普通调用处理
+ */
+int markTailCalls(Function &F) {
+    int marked = 0;
+    for (auto &bb : F.blocks) {
+        const auto &insts = bb->insts;
+        for (size_t i = 0; i < insts.size(); ++i) {
+            Instruction *I = insts[i];
+            if (I->opcode != Opcode::Call)
+                continue;
+            I->tail = i + 1 < insts.size() && isReturnOf(insts[i + 1], I);
+            marked += I->tail;
+        }
+    }
+    return marked;
+}
+
+} // namespace opt
+} // namespace toyc
@@ -1,32 +1,110 @@
 // ToyC 统一测试程序
 // 遍历测试目录下所有 .c 文件，依次执行完整编译流水线：
-//   解析 → AST → IR 用生成 → IR round-trip → 寄存器分配 → 代码生成
+//   解析 → AST → IR 生成 → IR round-trip → 二进制 IR round-trip → 寄存器分配 → 代码生成
+//   → ELF 目标文件 → 并行代码生成 → 按需加载的流水线代码生成 → 增量编译缓存 → 阶段统计
+//   → -O1 优化（mem2reg）→ 支配树 / 循环分析 → 区间分裂 → 图着色分配 → 拷贝传播与寄存器偏好
+//   → 稀疏条件常量传播 → 全局值编号 → 死代码删除与 CFG 化简 → 循环不变量外提与强度削减
+//   → 函数内联 → 自递归消除与尾调用标记 → 常量乘除的移位改写 → 窥孔优化与块布局 → 比较-分支融合
+//   → 静态分支预测的块布局 → 剖析插桩与剖析反馈 → 指令调度 → RV32C 压缩指令
+//   → 过程间寄存器分配 → 省略帧指针 → 叶函数栈帧与收缩包装 → 栈槽着色 → 常量重物化
+//   → 循环向量化 → 内置模拟器 → 编译服务 → 嵌入式编译接口
+// 之后一次性运行与输入无关的固定程序回归测试
 // 任一阶段失败则报告 FAIL，全部通过则返回 0
+// -j N 时每个文件在独立的子进程中测试，N 个文件同时进行，输出仍按文件名顺序
 
+#include "asm_emitter.h"
 #include "ast.h"
+#include "codegen_cache.h"
+#include "compile_server.h"
+#include "compiler.h"
 #include "ir.h"
+#include "ir_analysis.h"
+#include "ir_binary.h"
 #include "ir_builder.h"
 #include "ir_parser.h"
+#include "ir_passes.h"
+#include "machine_ir.h"
 #include "parser.h"
+#include "profile.h"
 #include "reg_alloc.h"
 #include "riscv_codegen.h"
+#include "simulator.h"
+#include "source_buffer.h"
+#include "statistics.h"
+#include "thread_pool.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <sstream>
 #include <string>
+#include <sys/wait.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
-// readFile：读取文件全部内容
-static std::string readFile(const std::string &path) {
-    std::ifstream ifs(path);
-    if (!ifs.is_open()) {
+// readFile：映射文件内容（无法打开时返回空缓冲区）
+static toyc::SourceBuffer readFile(const std::string &path) {
+    try {
+        return toyc::SourceBuffer::open(path);
+    } catch (const std::runtime_error &) {
         std::cerr << "  [ERROR] Cannot open: " << path << "\n";
-        return "";
+        return {};
     }
-    return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+/**
+ * @brief 检查分配结果是否是合法的着色
+ * @param F 已完成分配的函数（liveIn / liveOut 为分配时的活跃性分析结果）
+ * @param checkSlots 是否同样检查溢出栈槽（栈槽着色之后可能共用）；区间分裂的片段与其根 vreg 持有
+ *   同一个值、共用栈槽，分裂时不检查
+ * @details 反向扫描每个可达块：定义所在的寄存器（与溢出栈槽）不能被此后仍活跃的其他 vreg 占用
+ *   （copy 的来源除外，两者值相同），且每个出现的 vreg 都有寄存器、栈位置或重物化的常量
+ */
+static bool coloringIsValid(const toyc::ir::Function &F, const toyc::AllocationResult &r,
+                            bool checkSlots = false) {
+    auto physOf = [&](int v) {
+        auto it = r.vregToPhys.find(v);
+        return it == r.vregToPhys.end() ? -1 : it->second;
+    };
+    auto slotOf = [&](int v) {
+        auto it = r.vregToStack.find(v);
+        return it == r.vregToStack.end() || physOf(v) >= 0 ? 0 : it->second;
+    };
+    for (const auto *bb : F.rpoOrder) {
+        std::set<int> live = bb->liveOut.toSet();
+        for (auto it = bb->insts.rbegin(); it != bb->insts.rend(); ++it) {
+            const toyc::ir::Instruction &inst = **it;
+            int d = inst.defReg();
+            if (d >= 0 && inst.opcode != toyc::ir::Opcode::Alloca) {
+                if (physOf(d) < 0 && !r.vregToStack.count(d) && !r.rematValues.count(d))
+                    return false;
+                int src = inst.opcode == toyc::ir::Opcode::Copy && inst.ops[0].isVReg()
+                              ? inst.ops[0].regId()
+                              : -1;
+                for (int v : live)
+                    if (v != d && v != src &&
+                        ((physOf(d) >= 0 && physOf(v) == physOf(d)) ||
+                         (checkSlots && slotOf(d) < 0 && slotOf(v) == slotOf(d))))
+                        return false;
+            }
+            live.erase(d);
+            for (int u : inst.useRegs())
+                live.insert(u);
+        }
+    }
+    return true;
 }
 
 /**
@@ -34,10 +112,32 @@ static std::string readFile(const std::string &path) {
  * @param path    测试文件路径
  * @param verbose 是否输出详细的 IR/ASM
  * @return true 表示测试通过
- * @details 流程：解析 → IR 生成 → IR 重新解析（round-trip 验证）→ 寄存器分配 → 代码生成
+ * @details 流程：解析 → IR 生成 → IR 重新解析（round-trip 验证）→ 二进制 IR 写出再读回
+ *   （IR 文本与汇编均须与原模块一致）→ 寄存器分配 → 代码生成 → 直接编码 ELF 目标文件（检查文件头）
+ *   → 多线程代码生成（须与串行输出逐字节一致）→ 从 IR 文本逐函数加载的流水线代码生成
+ *   （串行与并行均须与整模块输出一致；源码按函数边界切片同样如此）→ 增量编译缓存（冷缓存写入、热缓存全部命中，输出不变）
+ *   → 开启阶段统计（输出不变，计数器与模块一致）→ -O1 mem2reg（内存访问全部消除，
+ *   带 phi 的 IR 文本 / 二进制 round-trip 无损，还原模块的汇编一致）→ 支配树 / 后支配树 / 循环森林
+ *   （自洽，分析缓存在 CFG 重建后失效）→ 区间分裂（4 个寄存器）→ 图着色分配（-O0 / -O1 汇编的
+ *   并行与串行一致，4 个寄存器时着色合法）→ 拷贝传播（不留下未定义的 use）与线性扫描的着色合法性
+ *   → SCCP（不留下可折叠的常量运算与常量条件分支，phi 入口与前驱一致，再次执行无变化）
+ *   → GVN（不留下未定义的 use，再次执行无冗余）→ DCE 与 CFG 化简（块都可达、没有可合并的直线块、
+ *   纯指令的结果都被使用，再次执行无变化）→ 循环优化（循环内没有可外提的不变量与可削减的乘法）
+ *   → 函数内联（阈值足够大时只剩递归调用，内联后的 IR round-trip 无损）
+ *   → 自递归消除（尾位置与累加器位置的自递归都已改写为循环，tail 标记与位置一致且 round-trip 无损）
+ *   → 常量乘除（乘数 / 除数为 2 的幂时不再生成 mul / div / rem）
+ *   → 窥孔优化与块布局（没有跳向下一块的转移与冗余的拷贝 / 重新加载，再次执行无变化）
+ *   → 比较-分支融合（&& / || 的布尔 phi 已穿透，分支不再读取刚物化的比较结果）
+ *   → 块布局（循环已旋转，循环中提前 return 的块放在循环之后）
+ *   → 剖析插桩与剖析反馈（每块一个计数器，.profraw 可解析回原计数，未执行的块排在最后）
+ *   → 指令调度（只在块内重排、依赖保持原有先后，按延迟模型模拟的周期数不增加）
+ *   → RV32C（压缩汇编逐行还原为原指令且满足编码约束，目标文件带 RVC 标志且 .text 更小）
+ *   → 过程间寄存器分配（调用之后不读取被调函数改写的寄存器）→ 省略帧指针（不再以 s0 寻址）
+ *   → 叶函数栈帧与收缩包装（叶函数不保存 ra，prologue 至多一处且不在环上）
+ *   → 栈槽着色（共用栈空间的 alloca / 溢出槽互不冲突，溢出槽编号连续）
  */
 static bool testFile(const std::string &path, bool verbose) {
-    std::string source = readFile(path);
+    toyc::SourceBuffer source = readFile(path);
     if (source.empty())
         return false;
 
@@ -46,21 +146,25 @@ static bool testFile(const std::string &path, bool verbose) {
 
     try {
         // 1. 词法分析 + 语法分析
-        Parser parser(source);
-        auto funcs = parser.parseCompUnit();
-        if (funcs.empty()) {
+        Parser parser(source.text());
+        CompUnit unit = parser.parseCompUnit();
+        if (unit.empty()) {
             std::cout << "FAIL (no functions parsed)\n";
             return false;
         }
 
-        // 2. AST → 结构化 IR
+        // 2. AST → 结构化 IR；同一个 IRBuilder 再生成一遍须逐字相同（每个函数开始时符号表完全复位）
         toyc::IRBuilder builder;
-        auto mod = builder.buildModule(funcs);
+        auto mod = builder.buildModule(unit);
         std::string irText = mod->toString();
         if (irText.empty()) {
             std::cout << "FAIL (empty IR)\n";
             return false;
         }
+        if (builder.buildModule(unit)->toString() != irText) {
+            std::cout << "FAIL (rebuilt IR differs)\n";
+            return false;
+        }
 
         if (verbose) {
             std::cout << "\n--- IR ---\n" << irText << "\n";
@@ -74,14 +178,24 @@ static bool testFile(const std::string &path, bool verbose) {
             return false;
         }
 
-        // 4. 寄存器分配（验证分配器不崩溃）
+        // 4. IR → .bir → 重新读取（二进制格式须无损还原模块）
+        std::ostringstream birStream;
+        toyc::writeBinaryIR(*mod, birStream);
+        std::string bir = birStream.str();
+        auto birMod = toyc::BinaryIRReader(bir).readModule();
+        if (birMod->toString() != irText) {
+            std::cout << "FAIL (binary IR round-trip differs)\n";
+            return false;
+        }
+
+        // 5. 寄存器分配（验证分配器不崩溃）
         toyc::RegInfo regInfo;
         for (auto &func : mod->functions) {
             toyc::LinearScanAllocator allocator(regInfo);
             auto result = allocator.allocate(*func);
         }
 
-        // 5. RISC-V 代码生成
+        // 6. RISC-V 代码生成
         std::string asmOutput = toyc::generateRISCVAssembly(*mod);
         if (asmOutput.empty()) {
             std::cout << "FAIL (empty assembly)\n";
@@ -92,6 +206,1823 @@ static bool testFile(const std::string &path, bool verbose) {
             std::cout << "--- ASM ---\n" << asmOutput << "\n";
         }
 
+        // 7. ELF 目标文件（验证所有指令可编码，文件头为 ELF32 / 小端 / EM_RISCV）
+        std::ostringstream objStream;
+        toyc::generateRISCVObject(*mod, objStream);
+        std::string obj = objStream.str();
+        if (obj.size() < 52 || obj.compare(0, 4, "\x7f" "ELF") != 0 || obj[4] != 1 ||
+            obj[5] != 1 || static_cast<unsigned char>(obj[18]) != 243) {
+            std::cout << "FAIL (bad ELF object)\n";
+            return false;
+        }
+
+        // 8. 并行代码生成（输出顺序与内容必须与串行结果一致）
+        if (toyc::generateRISCVAssembly(*mod, 4) != asmOutput) {
+            std::cout << "FAIL (parallel codegen output differs)\n";
+            return false;
+        }
+
+        // 9. 由 .bir 读回的模块生成的汇编须与原模块一致
+        if (toyc::generateRISCVAssembly(*birMod) != asmOutput) {
+            std::cout << "FAIL (binary IR codegen output differs)\n";
+            return false;
+        }
+
+        // 10. 按需加载：函数体在编译时才从 IR 文本（或源码片段）解析，编译后立即释放；
+        //     源码的函数边界与整体解析一致，片段中的行号与原文件相同
+        for (unsigned threads : {1u, 4u}) {
+            toyc::LazyIRModule lazy(irText);
+            toyc::LazySourceModule lazySource(source.text());
+            std::ostringstream lazyAsm, streamAsm;
+            toyc::generateRISCVAssembly(
+                lazy.size(), [&](size_t i) { return lazy.take(i); }, lazyAsm, threads);
+            toyc::generateRISCVAssembly(
+                lazySource.size(), [&](size_t i) { return lazySource.take(i); }, streamAsm,
+                threads);
+            if (lazyAsm.str() != asmOutput || streamAsm.str() != asmOutput) {
+                std::cout << "FAIL (lazy pipeline codegen output differs)\n";
+                return false;
+            }
+        }
+        {
+            auto spans = Parser::indexFunctions(source.text());
+            bool ok = spans.size() == unit.funcs.size();
+            for (size_t i = 0; ok && i < spans.size(); ++i)
+                ok = spans[i].name == unit.funcs[i]->name &&
+                     spans[i].line == 1 + static_cast<int>(std::count(
+                                              source.text().data(), spans[i].text.data(), '\n'));
+            toyc::LazySourceModule broken("int f() { return 1; }\n\nint g( { return 2; }\n");
+            int errorLine = 0;
+            try {
+                broken.take(1);
+            } catch (const ParseError &e) {
+                errorLine = e.line;
+            }
+            if (!ok || broken.size() != 2 || broken.take(0)->name != "f" || errorLine != 3) {
+                std::cout << "FAIL (source function index differs from parse)\n";
+                return false;
+            }
+        }
+
+        // 11. 增量编译缓存：第一次全部写入，第二次全部命中，两次输出都与无缓存时一致
+        fs::path cacheDir = fs::temp_directory_path() / ("toyc_test_cache_" + filename);
+        fs::remove_all(cacheDir);
+        bool cacheOk;
+        {
+            toyc::CodeGenCache cold(cacheDir), warm(cacheDir);
+            const size_t n = mod->functions.size();
+            cacheOk = toyc::generateRISCVAssembly(*mod, 1, &cold) == asmOutput &&
+                      toyc::generateRISCVAssembly(*mod, 4, &warm) == asmOutput &&
+                      cold.misses() + cold.hits() == n && warm.hits() == n;
+        }
+        fs::remove_all(cacheDir);
+        if (!cacheOk) {
+            std::cout << "FAIL (codegen cache round-trip differs)\n";
+            return false;
+        }
+
+        // 12. 阶段统计：开启后输出不变，函数 / IR 指令计数与模块一致
+        {
+            size_t numInsts = 0;
+            for (const auto &func : mod->functions)
+                for (const auto &bb : func->blocks)
+                    numInsts += bb->insts.size();
+            toyc::stats::enable();
+            bool same = toyc::generateRISCVAssembly(*mod, 4) == asmOutput;
+            using toyc::stats::Counter;
+            if (!same || toyc::stats::counter(Counter::Functions) != mod->functions.size() ||
+                toyc::stats::counter(Counter::IRInstructions) != numInsts ||
+                toyc::stats::counter(Counter::MachineInsts) == 0) {
+                std::cout << "FAIL (statistics differ or change output)\n";
+                return false;
+            }
+        }
+
+        // 13. -O1：mem2reg 后不再有 alloca / load / store（ToyC 没有取地址），
+        //     含 phi 的 IR 文本与 .bir 均可无损还原，且由还原模块生成的汇编一致
+        {
+            auto optMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*optMod, 1);
+            for (const auto &func : optMod->functions)
+                for (const auto &bb : func->blocks)
+                    for (const auto *inst : bb->insts)
+                        if (inst->opcode == toyc::ir::Opcode::Alloca ||
+                            inst->opcode == toyc::ir::Opcode::Load ||
+                            inst->opcode == toyc::ir::Opcode::Store) {
+                            std::cout << "FAIL (memory access left after mem2reg)\n";
+                            return false;
+                        }
+            std::string optText = optMod->toString();
+            auto optReparsed = irParser.parseModule(optText);
+            std::ostringstream optBirStream;
+            toyc::writeBinaryIR(*optMod, optBirStream);
+            std::string optBir = optBirStream.str();
+            auto optBirMod = toyc::BinaryIRReader(optBir).readModule();
+            if (optReparsed->toString() != optText || optBirMod->toString() != optText) {
+                std::cout << "FAIL (optimized IR round-trip differs)\n";
+                return false;
+            }
+            std::string optAsm = toyc::generateRISCVAssembly(*optMod);
+            if (optAsm.empty() || toyc::generateRISCVAssembly(*optReparsed, 4) != optAsm) {
+                std::cout << "FAIL (optimized codegen output differs)\n";
+                return false;
+            }
+        }
+
+        // 14. CFG 分析：紧凑 CFG 的 CSR 边与各块的 succs / preds 逐项相同，RPO 从入口开始、
+        //     覆盖全部可达块；支配树 / 后支配树自洽，循环头都是 while 条件块，缓存命中且 CFG 重建后失效
+        for (auto &func : mod->functions) {
+            const toyc::ir::CFG &cfg = func->cfg;
+            bool sameEdges = cfg.size() == func->blocks.size();
+            for (size_t b = 0; sameEdges && b < cfg.size(); ++b) {
+                const toyc::ir::BasicBlock *bb = func->blocks[b].get();
+                auto sameAs = [&](std::span<const uint32_t> ids, const auto &blocks) {
+                    return std::equal(ids.begin(), ids.end(), blocks.begin(), blocks.end(),
+                                      [](uint32_t id, const auto *x) { return x->id == int(id); });
+                };
+                sameEdges = sameAs(cfg.succs(b), bb->succs) && sameAs(cfg.preds(b), bb->preds);
+            }
+            auto rpo = toyc::LivenessAnalysis::buildRPO(*func);
+            toyc::AnalysisManager &am = func->analyses();
+            const toyc::DominatorTree &dt = am.domTree();
+            const toyc::PostDominatorTree &pdt = am.postDomTree();
+            const toyc::LoopInfo &li = am.loops();
+            bool ok = sameEdges && !rpo.empty() && rpo.front() == func->entryBlock() &&
+                      rpo == dt.rpo() && &dt == &am.domTree() && !dt.idom(func->entryBlock()) &&
+                      li.loopDepth(func->entryBlock()) == 0;
+            for (const auto &bb : func->blocks) {
+                const toyc::ir::BasicBlock *b = bb.get();
+                if (dt.idom(b) && !dt.dominates(dt.idom(b), b))
+                    ok = false;
+                if (pdt.idom(b) && !pdt.dominates(pdt.idom(b), b))
+                    ok = false;
+                if (li.isLoopHeader(b) && b->name.rfind("while_cond", 0) != 0)
+                    ok = false;
+            }
+            size_t numLoops = li.size(); // buildCFG 之后 dt / pdt / li 即失效
+            uint64_t version = func->cfgVersion;
+            func->buildCFG();
+            if (!ok || func->cfgVersion == version || am.loops().size() != numLoops) {
+                std::cout << "FAIL (CFG analysis inconsistent)\n";
+                return false;
+            }
+        }
+
+        // 15. 区间分裂：只留 4 个可分配寄存器迫使溢出与分裂；分配不改写原函数，
+        //     重复分配结果一致，分配所用函数中每个被读取的 vreg 都有位置；
+        //     记录的每个溢出决定最终都在栈上（或改为重物化），有溢出时记录非空
+        {
+            auto splitMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*splitMod, 1);
+            toyc::RegInfo fewRegs;
+            while (fewRegs.allocatableRegs.size() > 4)
+                fewRegs.allocatableRegs.erase(std::prev(fewRegs.allocatableRegs.end()));
+            for (auto &func : splitMod->functions) {
+                toyc::LinearScanAllocator first(fewRegs);
+                auto r1 = first.allocate(*func);
+                std::string before = func->toString();
+                toyc::LinearScanAllocator second(fewRegs);
+                std::vector<toyc::SpillDecision> spills;
+                second.setSpillLog(&spills);
+                auto r2 = second.allocate(*func);
+                const toyc::ir::Function &allocated =
+                    second.splitFunction() ? *second.splitFunction() : *func;
+                bool ok = func->toString() == before && r1.vregToPhys == r2.vregToPhys &&
+                          r1.vregToStack == r2.vregToStack;
+                for (const auto &d : spills)
+                    ok = ok && d.round >= 1 && d.reason != toyc::SpillReason::Uncolorable &&
+                         (r2.vregToStack.count(d.vreg) || r2.rematValues.count(d.vreg));
+                ok = ok && (r2.spillCost == 0 || !spills.empty());
+                for (const auto &bb : allocated.blocks)
+                    for (const auto *inst : bb->insts)
+                        for (int v : inst->useRegs()) {
+                            auto phys = r2.vregToPhys.find(v);
+                            if ((phys == r2.vregToPhys.end() || phys->second < 0) &&
+                                !r2.vregToStack.count(v) && !r2.rematValues.count(v))
+                                ok = false;
+                        }
+                if (!ok) {
+                    std::cout << "FAIL (live range splitting inconsistent)\n";
+                    return false;
+                }
+            }
+        }
+
+        // 16. 图着色分配：-O0 / -O1 的汇编非空且并行与串行一致；只留 4 个可分配寄存器
+        //     迫使溢出时着色仍然合法（见 coloringIsValid），记录的溢出决定都是着色失败的节点，
+        //     权重之和即 spillCost
+        for (int level : {0, 1}) {
+            auto gcMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*gcMod, level);
+            const auto graph = toyc::RegAllocKind::Graph;
+            std::string gcAsm = toyc::generateRISCVAssembly(*gcMod, 1, nullptr, graph);
+            if (gcAsm.empty() || toyc::generateRISCVAssembly(*gcMod, 4, nullptr, graph) != gcAsm) {
+                std::cout << "FAIL (graph coloring codegen output differs)\n";
+                return false;
+            }
+            toyc::RegInfo fewRegs;
+            while (fewRegs.allocatableRegs.size() > 4)
+                fewRegs.allocatableRegs.erase(std::prev(fewRegs.allocatableRegs.end()));
+            for (auto &func : gcMod->functions) {
+                toyc::GraphColoringAllocator allocator(fewRegs);
+                std::vector<toyc::SpillDecision> spills;
+                allocator.setSpillLog(&spills);
+                auto result = allocator.allocate(*func);
+                uint64_t logged = 0;
+                bool ok = coloringIsValid(*func, result, true);
+                for (const auto &d : spills) {
+                    logged += d.weight;
+                    ok = ok && d.reason == toyc::SpillReason::Uncolorable &&
+                         (result.vregToStack.count(d.vreg) || result.rematValues.count(d.vreg));
+                }
+                if (!ok || logged != result.spillCost) {
+                    std::cout << "FAIL (graph coloring produced an invalid assignment)\n";
+                    return false;
+                }
+            }
+        }
+
+        // 17. 拷贝传播与寄存器偏好：phi 消除 + 拷贝传播后每个被读取的 vreg 仍有定义（或是参数）；
+        //     线性扫描（接过在定义处结束的寄存器、调用约定偏好）在全部 / 4 个寄存器下着色合法，
+        //     不分裂时共用的溢出栈槽也不冲突
+        {
+            auto cpMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*cpMod, 1);
+            for (auto &func : cpMod->functions) {
+                toyc::opt::eliminatePhis(*func);
+                toyc::opt::propagateCopies(*func);
+                std::set<int> defined(func->paramVregs.begin(), func->paramVregs.end());
+                for (const auto &bb : func->blocks)
+                    for (const auto *inst : bb->insts)
+                        defined.insert(inst->defReg());
+                for (const auto &bb : func->blocks)
+                    for (const auto *inst : bb->insts)
+                        for (int v : inst->useRegs())
+                            if (!defined.count(v)) {
+                                std::cout << "FAIL (copy propagation left an undefined use)\n";
+                                return false;
+                            }
+            }
+            toyc::RegInfo fewRegs;
+            while (fewRegs.allocatableRegs.size() > 4)
+                fewRegs.allocatableRegs.erase(std::prev(fewRegs.allocatableRegs.end()));
+            for (const toyc::RegInfo *info : {&regInfo, &fewRegs})
+                for (auto &func : cpMod->functions)
+                    for (bool splitting : {true, false}) {
+                        toyc::LinearScanAllocator allocator(*info);
+                        allocator.setSplitting(splitting);
+                        auto result = allocator.allocate(*func);
+                        const toyc::ir::Function &allocated =
+                            allocator.splitFunction() ? *allocator.splitFunction() : *func;
+                        if (!coloringIsValid(allocated, result, !splitting)) {
+                            std::cout << "FAIL (linear scan produced an invalid assignment)\n";
+                            return false;
+                        }
+                    }
+        }
+
+        // 18. SCCP：-O1 之后不再有两个操作数都是常量的可折叠运算（除数为 0 或 INT_MIN / -1 的
+        //     除法保留）、常量条件的分支，phi 的入口与前驱一一对应；再次执行 SCCP 无可折叠项
+        {
+            using toyc::ir::Opcode;
+            auto scMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*scMod, 1);
+            for (auto &func : scMod->functions) {
+                func->buildCFG();
+                bool ok = true;
+                for (const auto &bb : func->blocks)
+                    for (const auto *inst : bb->insts) {
+                        auto isConst = [](const toyc::ir::Operand &op) {
+                            return op.isImm() || op.isBoolLit();
+                        };
+                        switch (inst->opcode) {
+                        case Opcode::Add:
+                        case Opcode::Sub:
+                        case Opcode::Mul:
+                        case Opcode::ICmp:
+                            ok = ok && !(isConst(inst->ops[0]) && isConst(inst->ops[1]));
+                            break;
+                        case Opcode::SDiv:
+                        case Opcode::SRem:
+                            ok = ok && !(isConst(inst->ops[0]) && inst->ops[1].isImm() &&
+                                         inst->ops[1].immValue() != 0 &&
+                                         !(inst->ops[1].immValue() == -1 &&
+                                           inst->ops[0].isImm() &&
+                                           inst->ops[0].immValue() == INT32_MIN));
+                            break;
+                        case Opcode::CondBr:
+                            ok = ok && inst->ops[0].isVReg();
+                            break;
+                        case Opcode::Phi:
+                            ok = ok && inst->numIncoming() == bb->preds.size();
+                            break;
+                        default:
+                            break;
+                        }
+                    }
+                if (!ok || toyc::opt::propagateConstants(*func) != 0) {
+                    std::cout << "FAIL (constant left unfolded after SCCP)\n";
+                    return false;
+                }
+            }
+        }
+
+        // 19. GVN：-O1 之后每个被读取的 vreg 仍有定义（或是参数），再次执行 GVN 无冗余可删
+        {
+            auto gvnMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*gvnMod, 1);
+            for (auto &func : gvnMod->functions) {
+                std::set<int> defined(func->paramVregs.begin(), func->paramVregs.end());
+                for (const auto &bb : func->blocks)
+                    for (const auto *inst : bb->insts)
+                        defined.insert(inst->defReg());
+                bool ok = true;
+                for (const auto &bb : func->blocks)
+                    for (const auto *inst : bb->insts)
+                        for (int v : inst->useRegs())
+                            ok = ok && defined.count(v);
+                if (!ok || toyc::opt::eliminateCommonSubexpressions(*func) != 0) {
+                    std::cout << "FAIL (redundant expression left after GVN)\n";
+                    return false;
+                }
+            }
+        }
+
+        // 20. DCE 与 CFG 化简：-O1 之后每个块都可达，没有可以并入唯一前驱的块，
+        //     纯指令的结果都被使用；再次执行两者都无变化。
+        //     def-use 链与逐条扫描 useRegs / defReg 的计数一致，uses(v) 中的指令都读取 v
+        {
+            using toyc::ir::Opcode;
+            auto dceMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*dceMod, 1);
+            for (auto &func : dceMod->functions) {
+                func->buildCFG();
+                const toyc::DominatorTree &dt = func->analyses().domTree();
+                const toyc::DefUseChains chains(*func);
+                std::map<int, size_t> defCount, useCount;
+                for (const auto &bb : func->blocks)
+                    for (const auto *inst : bb->insts) {
+                        if (inst->defReg() >= 0)
+                            ++defCount[inst->defReg()];
+                        for (int v : inst->useRegs())
+                            ++useCount[v];
+                    }
+                bool ok = true;
+                for (size_t v = 0; v < chains.size(); ++v) {
+                    int r = static_cast<int>(v);
+                    ok = ok && chains.numDefs(r) == (defCount.count(r) ? defCount[r] : 0) &&
+                         chains.numUses(r) == (useCount.count(r) ? useCount[r] : 0);
+                    for (const auto *inst : chains.uses(r))
+                        ok = ok && inst->readsReg(r);
+                    for (const auto *inst : chains.defs(r))
+                        ok = ok && inst->defReg() == r;
+                }
+                if (!ok) {
+                    std::cout << "FAIL (def-use chains disagree with instruction operands)\n";
+                    return false;
+                }
+                auto used = [&](int v) { return chains.numUses(v) != 0; };
+                for (const auto &bb : func->blocks) {
+                    ok = ok && dt.isReachable(bb.get());
+                    const auto *term = bb->insts.back();
+                    if (term->opcode == Opcode::Br) {
+                        const auto *next = func->blockMap.at(term->ops[0].labelName());
+                        ok = ok && !(next->preds.size() == 1 && next != func->entryBlock());
+                    }
+                    for (const auto *inst : bb->insts)
+                        if (inst->defReg() >= 0 && inst->opcode != Opcode::Call)
+                            ok = ok && used(inst->defReg());
+                }
+                if (!ok || toyc::opt::eliminateDeadCode(*func) != 0 ||
+                    toyc::opt::simplifyCFG(*func) != 0) {
+                    std::cout << "FAIL (dead code or mergeable block left after simplification)\n";
+                    return false;
+                }
+            }
+        }
+
+        // 21. 循环优化：-O1 之后循环内不再有操作数都在循环外定义的纯运算（已外提到前置块），
+        //     也不再有基本归纳变量（回边入口都是 phi ± 常数的头结点 phi）与循环外的值或常数的乘法；
+        //     再次执行 optimizeLoops 无可外提或削减的指令
+        {
+            using toyc::ir::Opcode;
+            auto loopMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*loopMod, 1);
+            for (auto &func : loopMod->functions) {
+                func->buildCFG();
+                const toyc::LoopInfo &li = func->analyses().loops();
+                std::map<int, const toyc::ir::Instruction *> defs;
+                for (const auto &bb : func->blocks)
+                    for (const auto *inst : bb->insts)
+                        defs[inst->defReg()] = inst;
+                bool ok = true;
+                for (const auto &bb : func->blocks) {
+                    const toyc::Loop *loop = li.loopFor(bb.get());
+                    if (!loop)
+                        continue;
+                    std::set<int> loopDefs, ivs;
+                    for (const auto *member : loop->blocks)
+                        for (const auto *inst : member->insts)
+                            loopDefs.insert(inst->defReg());
+                    for (const auto *phi : loop->header->insts) {
+                        if (phi->opcode != Opcode::Phi)
+                            break;
+                        bool iv = true, hasBackedge = false;
+                        for (size_t k = 0; k < phi->numIncoming(); ++k) {
+                            const auto &value = phi->incomingValue(k);
+                            if (!value.isVReg() || !loopDefs.count(value.regId()))
+                                continue;
+                            const auto *next = defs.at(value.regId());
+                            hasBackedge = true;
+                            bool step = next->opcode == Opcode::Add || next->opcode == Opcode::Sub;
+                            iv = iv && step && next->ops[0].isVReg() &&
+                                 next->ops[0].regId() == phi->defReg() && next->ops[1].isImm();
+                        }
+                        if (iv && hasBackedge)
+                            ivs.insert(phi->defReg());
+                    }
+                    for (const auto *inst : bb->insts) {
+                        if (inst->opcode == Opcode::Mul)
+                            for (size_t side = 0; side < 2; ++side) {
+                                const auto &a = inst->ops[side], &b = inst->ops[1 - side];
+                                ok = ok && !(a.isVReg() && ivs.count(a.regId()) &&
+                                             (b.isImm() || !loopDefs.count(b.regId())));
+                            }
+                        bool pure = inst->opcode == Opcode::Add || inst->opcode == Opcode::Sub ||
+                                    inst->opcode == Opcode::Mul || inst->opcode == Opcode::SDiv ||
+                                    inst->opcode == Opcode::SRem || inst->opcode == Opcode::ICmp;
+                        auto uses = inst->useRegs();
+                        ok = ok && !(pure && std::none_of(uses.begin(), uses.end(), [&](int v) {
+                                         return loopDefs.count(v) != 0;
+                                     }));
+                    }
+                }
+                if (!ok || toyc::opt::optimizeLoops(*func) != 0) {
+                    std::cout << "FAIL (loop-invariant or reducible instruction left in loop)\n";
+                    return false;
+                }
+            }
+        }
+
+        // 22. 函数内联：阈值足够大时，剩下的调用只指向递归函数或与调用者互相递归的函数；
+        //     内联后的 IR 文本可无损还原，由还原模块生成的汇编一致
+        {
+            auto inlMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*inlMod, 1, 1 << 20);
+            toyc::CallGraph cg(*inlMod);
+            bool ok = true;
+            for (auto &func : inlMod->functions)
+                for (const auto &bb : func->blocks)
+                    for (const auto *inst : bb->insts) {
+                        if (inst->opcode != toyc::ir::Opcode::Call)
+                            continue;
+                        const toyc::ir::Function *callee = cg.function(inst->callee);
+                        ok = ok && (!callee || cg.isRecursive(callee) ||
+                                    cg.sameSCC(func.get(), callee));
+                    }
+            std::string inlText = inlMod->toString();
+            auto inlReparsed = irParser.parseModule(inlText);
+            if (!ok || inlReparsed->toString() != inlText ||
+                toyc::generateRISCVAssembly(*inlReparsed) != toyc::generateRISCVAssembly(*inlMod)) {
+                std::cout << "FAIL (inlinable call left or inlined IR round-trip differs)\n";
+                return false;
+            }
+        }
+
+        // 23. 自递归消除与尾调用：不内联时也不再有处于尾位置（或累加器位置）的自递归调用；
+        //     call 紧跟返回其结果的 ret 当且仅当标记为 tail，tail 标记经 IR 文本与 .bir 无损还原
+        {
+            using toyc::ir::Opcode;
+            auto tailMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*tailMod, 1, 0);
+            auto returnsResult = [](const toyc::ir::Instruction *I, const toyc::ir::Instruction *v) {
+                return I->opcode == Opcode::RetVoid ||
+                       (I->opcode == Opcode::Ret && I->ops[0].isVReg() && v->def.isVReg() &&
+                        I->ops[0].regId() == v->defReg());
+            };
+            bool ok = true;
+            for (const auto &func : tailMod->functions)
+                for (const auto &bb : func->blocks) {
+                    const auto &insts = bb->insts;
+                    for (size_t i = 0; i < insts.size(); ++i) {
+                        const auto *inst = insts[i];
+                        if (inst->opcode != Opcode::Call)
+                            continue;
+                        const bool atReturn = i + 1 < insts.size() && returnsResult(insts[i + 1], inst);
+                        ok = ok && inst->tail == atReturn;
+                        if (inst->callee.str() != func->name)
+                            continue;
+                        ok = ok && !atReturn;
+                        if (i + 2 < insts.size()) {
+                            const auto *next = insts[i + 1];
+                            bool accumulates = next->opcode == Opcode::Add || next->opcode == Opcode::Mul;
+                            ok = ok && !(accumulates && returnsResult(insts[i + 2], next));
+                        }
+                    }
+                }
+            std::string tailText = tailMod->toString();
+            std::ostringstream tailBirStream;
+            toyc::writeBinaryIR(*tailMod, tailBirStream);
+            std::string tailBir = tailBirStream.str();
+            if (!ok || irParser.parseModule(tailText)->toString() != tailText ||
+                toyc::BinaryIRReader(tailBir).readModule()->toString() != tailText) {
+                std::cout << "FAIL (tail recursion left or tail-call marks inconsistent)\n";
+                return false;
+            }
+        }
+
+        // 24. 常量乘除：-O0 / -O1 的汇编里，乘数为 0 / ±2^k、除数为 ±2^k（INT_MIN 除外）的
+        //     mul / div / rem 都已改写为移位序列——不再有紧跟在 li 之后、以该常量为第二操作数的这三种指令
+        for (int level : {0, 1}) {
+            auto mdMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*mdMod, level);
+            std::istringstream lines(toyc::generateRISCVAssembly(*mdMod));
+            auto isPow2 = [](long long v) { return v != 0 && (v & (v - 1)) == 0; };
+            std::string line, liReg;
+            long long liValue = 0;
+            bool ok = true;
+            while (std::getline(lines, line)) {
+                std::replace(line.begin(), line.end(), ',', ' ');
+                std::istringstream fields(line);
+                std::string op, rd, rs1, rs2;
+                fields >> op >> rd >> rs1 >> rs2;
+                if ((op == "mul" || op == "div" || op == "rem") && rs2 == liReg) {
+                    const long long m = liValue < 0 ? -liValue : liValue;
+                    ok = ok && !(m == 1 || (isPow2(m) && m != 2147483648LL) || (op == "mul" && m == 0));
+                }
+                liReg.clear();
+                if (op == "li" && !rs1.empty()) {
+                    liReg = rd;
+                    liValue = std::stoll(rs1);
+                }
+            }
+            if (!ok) {
+                std::cout << "FAIL (multiply / divide by a power of two left unlowered)\n";
+                return false;
+            }
+        }
+
+        // 25. 窥孔优化与块布局：-O0 / -O1 的机器代码里入口在首位、跳转目标都在范围内，
+        //     没有跳向下一块的 j、没有以下一块为目标的 "bcc; j" 对、没有 mv r, r 与同一槽的 sw → lw，
+        //     再次执行 runPeephole 不再删除任何指令
+        for (int level : {0, 1}) {
+            using toyc::mir::MOpcode;
+            auto phMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*phMod, level);
+            bool ok = true;
+            toyc::RISCVCodeGen(1).generateMachineCode(*phMod, [&](const toyc::mir::MachineFunction &MF) {
+                const int n = static_cast<int>(MF.blocks.size());
+                for (int bi = 0; bi < n; ++bi) {
+                    const auto &insts = MF.blocks[bi].insts;
+                    for (size_t i = 0; i < insts.size(); ++i) {
+                        const auto &MI = insts[i];
+                        if (MI.opcode == MOpcode::J || MI.isBranch())
+                            ok = ok && MI.target > 0 && MI.target < n;
+                        ok = ok && !(MI.opcode == MOpcode::MV && MI.rd == MI.rs1);
+                        if (i + 1 < insts.size() && MI.opcode == MOpcode::SW)
+                            ok = ok && !(insts[i + 1].opcode == MOpcode::LW &&
+                                         insts[i + 1].rs1 == MI.rs1 && insts[i + 1].imm == MI.imm);
+                    }
+                    if (!insts.empty() && insts.back().opcode == MOpcode::J) {
+                        ok = ok && insts.back().target != bi + 1;
+                        if (insts.size() >= 2 && insts[insts.size() - 2].isBranch())
+                            ok = ok && insts[insts.size() - 2].target != bi + 1;
+                    }
+                }
+                toyc::mir::MachineFunction again = MF;
+                ok = ok && toyc::mir::runPeephole(again) == 0;
+            });
+            if (!ok) {
+                std::cout << "FAIL (peephole left a redundant jump, move or reload)\n";
+                return false;
+            }
+        }
+
+        // 26. 比较-分支融合：-O1 之后不再有只含 "phi i1 + br i1" 的 && / || 汇合块；
+        //     每个紧挨在条件分支前、只被它读取的 icmp 都融合进分支（不再落到寄存器），
+        //     -O0 / -O1 的汇编里也没有紧跟在 slt/seqz/snez/xori 之后、读取其结果的 bnez
+        {
+            using toyc::ir::Opcode;
+            auto fuseMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*fuseMod, 1);
+            bool ok = true;
+            uint64_t fusible = 0;
+            for (const auto &func : fuseMod->functions) {
+                std::map<int, int> uses;
+                for (const auto &bb : func->blocks)
+                    for (const auto *inst : bb->insts)
+                        for (int reg : inst->useRegs())
+                            ++uses[reg];
+                for (const auto &bb : func->blocks) {
+                    const auto &insts = bb->insts;
+                    const size_t n = insts.size();
+                    ok = ok && !(n == 2 && insts[0]->opcode == Opcode::Phi &&
+                                 insts[0]->type == "i1" &&
+                                 insts[1]->branchCondReg() == insts[0]->defReg());
+                    if (n >= 2 && insts[n - 2]->opcode == Opcode::ICmp &&
+                        insts[n - 1]->branchCondReg() == insts[n - 2]->defReg() &&
+                        uses[insts[n - 2]->defReg()] == 1)
+                        ++fusible;
+                }
+            }
+            for (int level : {0, 1}) {
+                auto asmMod = level == 0 ? builder.buildModule(unit) : std::move(fuseMod);
+                if (level == 1)
+                    toyc::stats::enable();
+                std::istringstream lines(toyc::generateRISCVAssembly(*asmMod));
+                if (level == 1)
+                    ok = ok && toyc::stats::counter(toyc::stats::Counter::FusedCompares) >= fusible;
+                std::string line, prevOp, prevRd;
+                while (std::getline(lines, line)) {
+                    std::replace(line.begin(), line.end(), ',', ' ');
+                    std::istringstream fields(line);
+                    std::string op, rd;
+                    fields >> op >> rd;
+                    bool setsFlag = prevOp == "slt" || prevOp == "seqz" || prevOp == "snez" ||
+                                    prevOp == "xori";
+                    ok = ok && !(op == "bnez" && setsFlag && rd == prevRd);
+                    prevOp = op;
+                    prevRd = rd;
+                }
+            }
+            if (!ok) {
+                std::cout << "FAIL (compare not fused into its branch)\n";
+                return false;
+            }
+        }
+
+        // 27. 静态分支预测的块布局：循环条件在头结点的循环中，只从循环体跳来的 return 块（预测不走）
+        //     放在整个循环之后；以 "bcc; j" 退出的循环都已旋转，头结点由循环内的块落空进入
+        for (int level : {0, 1}) {
+            auto lyMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*lyMod, level);
+            // 代码生成会改写 IR（phi 消除），先按块标签记下每个循环
+            struct LoopShape {
+                std::string header;
+                std::set<std::string> blocks;
+                std::vector<std::string> earlyReturns;
+            };
+            std::map<std::string, std::vector<LoopShape>> shapes;
+            for (auto &func : lyMod->functions) {
+                const toyc::LoopInfo &li = func->analyses().loops();
+                const std::string prefix = "." + func->name + "_";
+                std::vector<const toyc::Loop *> work(li.topLevelLoops().begin(),
+                                                     li.topLevelLoops().end());
+                while (!work.empty()) {
+                    const toyc::Loop *L = work.back();
+                    work.pop_back();
+                    work.insert(work.end(), L->subLoops.begin(), L->subLoops.end());
+                    auto inLoop = [&](const toyc::ir::BasicBlock *b) { return L->contains(li.loopFor(b)); };
+                    bool headerExits = false;
+                    for (const auto *s : L->header->succs)
+                        headerExits = headerExits || !inLoop(s);
+                    if (!headerExits)
+                        continue;
+                    LoopShape shape{prefix + L->header->name, {}, {}};
+                    for (const auto *b : L->blocks)
+                        shape.blocks.insert(prefix + b->name);
+                    for (const auto &bb : func->blocks) {
+                        bool returns = false, fromBody = !bb->preds.empty() && !inLoop(bb.get());
+                        for (const auto *inst : bb->insts)
+                            returns = returns || inst->opcode == toyc::ir::Opcode::Ret ||
+                                      inst->opcode == toyc::ir::Opcode::RetVoid;
+                        for (const auto *p : bb->preds)
+                            fromBody = fromBody && inLoop(p) && p != L->header;
+                        if (returns && fromBody)
+                            shape.earlyReturns.push_back(prefix + bb->name);
+                    }
+                    shapes[func->name].push_back(std::move(shape));
+                }
+            }
+            bool ok = true;
+            toyc::RISCVCodeGen(1).generateMachineCode(*lyMod, [&](const toyc::mir::MachineFunction &MF) {
+                std::map<std::string, int> pos;
+                for (size_t bi = 0; bi < MF.blocks.size(); ++bi)
+                    pos[MF.blocks[bi].label] = static_cast<int>(bi);
+                for (const LoopShape &shape : shapes[MF.name]) {
+                    int last = -1;
+                    for (const auto &label : shape.blocks)
+                        if (pos.count(label))
+                            last = std::max(last, pos[label]);
+                    for (const auto &label : shape.earlyReturns)
+                        ok = ok && (!pos.count(label) || pos[label] > last);
+                    const int h = pos.count(shape.header) ? pos[shape.header] : -1;
+                    const auto &insts = h >= 0 ? MF.blocks[h].insts : MF.blocks[0].insts;
+                    if (h > 0 && !insts.empty() && insts.back().isBranch())
+                        ok = ok && shape.blocks.count(MF.blocks[h - 1].label) != 0;
+                }
+            });
+            if (!ok) {
+                std::cout << "FAIL (loop not rotated or early return laid out inside its loop)\n";
+                return false;
+            }
+        }
+
+        // 28. 剖析插桩与剖析反馈：插桩构建的每个机器块以计数器自增开头、计数器编号各不相同；
+        //     按 profileBlocks 拼出的 .profraw 能解析回原计数（拼接即合并，截断则报错）；
+        //     用它标注后，计数为 0 的块都排在有计数的块之后
+        {
+            auto pgMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*pgMod, 1);
+            toyc::RISCVCodeGen instrGen(1);
+            instrGen.setProfileGenerate(true);
+            std::map<std::string, std::vector<std::string>> profileBlocks;
+            bool ok = true;
+            instrGen.generateMachineCode(*pgMod, [&](const toyc::mir::MachineFunction &MF) {
+                std::set<int> seen;
+                for (const auto &MBB : MF.blocks) {
+                    const bool counted = !MBB.insts.empty() &&
+                                         MBB.insts.front().opcode == toyc::mir::MOpcode::ProfCount;
+                    ok = ok && counted &&
+                         MBB.insts.front().sym.str() == toyc::mir::profileCounterLabel(MF.name) &&
+                         MBB.insts.front().imm / 4 < static_cast<int>(MF.profileBlocks.size()) &&
+                         seen.insert(MBB.insts.front().imm).second;
+                }
+                profileBlocks[MF.name] = MF.profileBlocks;
+            });
+            if (!ok) {
+                std::cout << "FAIL (block without its own profile counter)\n";
+                return false;
+            }
+
+            // 合成计数：入口块 1 次，其余块奇数编号 0 次、偶数编号 5 次
+            auto word = [](std::string &out, uint32_t v) {
+                for (int i = 0; i < 4; ++i)
+                    out.push_back(static_cast<char>(v >> (8 * i)));
+            };
+            std::string raw;
+            for (const auto &[name, blocks] : profileBlocks) {
+                std::string names = name + "\n";
+                for (const auto &block : blocks)
+                    names += block + "\n";
+                word(raw, static_cast<uint32_t>(blocks.size()));
+                word(raw, static_cast<uint32_t>(names.size()));
+                raw += names;
+                raw.append((4 - names.size() % 4) % 4, '\0');
+                for (size_t k = 0; k < blocks.size(); ++k)
+                    word(raw, k == 0 ? 1 : k % 2 ? 0 : 5);
+            }
+            auto expected = [&](size_t k) -> int64_t { return k == 0 ? 1 : k % 2 ? 0 : 5; };
+            toyc::ProfileData profile = toyc::ProfileData::parse(raw);
+            toyc::ProfileData merged = toyc::ProfileData::parse(raw + raw);
+            ok = profile.numFunctions() == profileBlocks.size() && profile.count("__none", "entry") < 0;
+            for (const auto &[name, blocks] : profileBlocks)
+                for (size_t k = 0; k < blocks.size(); ++k)
+                    ok = ok && profile.count(name, blocks[k]) == expected(k) &&
+                         merged.count(name, blocks[k]) == 2 * expected(k);
+            bool truncatedRejected = false;
+            try {
+                toyc::ProfileData::parse(std::string_view(raw).substr(0, raw.size() - 1));
+            } catch (const std::runtime_error &) {
+                truncatedRejected = true;
+            }
+            if (!ok || !truncatedRejected) {
+                std::cout << "FAIL (profile data does not round-trip)\n";
+                return false;
+            }
+
+            auto useMod = builder.buildModule(unit);
+            profile.annotate(*useMod);
+            toyc::opt::optimizeModule(*useMod, 1);
+            profile.annotate(*useMod);
+            toyc::RISCVCodeGen(1).generateMachineCode(*useMod, [&](const toyc::mir::MachineFunction &MF) {
+                ok = ok && MF.profileBlocks.empty() && MF.blockCounts.size() == MF.blocks.size();
+                bool coldSeen = false;
+                for (size_t bi = 0; ok && bi < MF.blockCounts.size(); ++bi) {
+                    ok = !(coldSeen && MF.blockCounts[bi] > 0);
+                    coldSeen = coldSeen || MF.blockCounts[bi] == 0;
+                    for (const auto &MI : MF.blocks[bi].insts)
+                        ok = ok && MI.opcode != toyc::mir::MOpcode::ProfCount;
+                }
+            });
+            if (!ok) {
+                std::cout << "FAIL (never-executed block laid out before executed code)\n";
+                return false;
+            }
+        }
+
+        // 29. 指令调度：只在块内重排（块、标签、转移与调用的位置不变），有寄存器读写关系的指令
+        //     与访问同一地址的访存保持原有先后；按模型逐条模拟发射，调度后的周期数不多于原顺序
+        {
+            auto parsed = toyc::mir::parseLatencyModel("generic,load=3");
+            if (!parsed || parsed->load != 3 || parsed->mul != 3 ||
+                toyc::mir::parseLatencyModel(parsed->toString())->toString() != parsed->toString() ||
+                toyc::mir::parseLatencyModel("generic,load=0") ||
+                toyc::mir::parseLatencyModel("no-such-core")) {
+                std::cout << "FAIL (latency model spec not parsed)\n";
+                return false;
+            }
+            const toyc::mir::LatencyModel model = *parsed;
+            using toyc::mir::MachineInstr;
+            using toyc::mir::MOpcode;
+            auto isFixed = [](const MachineInstr &MI) {
+                return MI.isBranch() || MI.opcode == MOpcode::J || MI.opcode == MOpcode::CALL ||
+                       MI.opcode == MOpcode::TAIL || MI.opcode == MOpcode::RET ||
+                       MI.opcode == MOpcode::ProfCount;
+            };
+            auto writes = [&](const MachineInstr &MI) {
+                return isFixed(MI) || MI.opcode == MOpcode::SW || MI.opcode == MOpcode::SB ? -1
+                                                                                           : MI.rd;
+            };
+            auto isMem = [](const MachineInstr &MI) {
+                return MI.opcode == MOpcode::LW || MI.opcode == MOpcode::LB ||
+                       MI.opcode == MOpcode::SW || MI.opcode == MOpcode::SB;
+            };
+            auto isStore = [](const MachineInstr &MI) {
+                return MI.opcode == MOpcode::SW || MI.opcode == MOpcode::SB;
+            };
+            auto sameInst = [](const MachineInstr &a, const MachineInstr &b) {
+                return a.opcode == b.opcode && a.rd == b.rd && a.rs1 == b.rs1 && a.rs2 == b.rs2 &&
+                       a.imm == b.imm && a.target == b.target && a.sym == b.sym;
+            };
+            // cycles：单发射顺序流水线逐条发射所需的周期数（只计块内的写后读停顿）
+            auto cycles = [&](const std::vector<MachineInstr> &insts) {
+                int ready[32] = {}, cycle = 0;
+                for (const auto &MI : insts) {
+                    ++cycle;
+                    for (int reg : {MI.rs1, MI.rs2})
+                        if (reg > 0)
+                            cycle = std::max(cycle, ready[reg]);
+                    if (writes(MI) > 0)
+                        ready[writes(MI)] = cycle + model.latency(MI);
+                }
+                return cycle;
+            };
+            for (int level : {0, 1}) {
+                std::map<std::string, toyc::mir::MachineFunction> plain;
+                auto plainMod = builder.buildModule(unit);
+                toyc::opt::optimizeModule(*plainMod, level);
+                toyc::RISCVCodeGen(1).generateMachineCode(
+                    *plainMod, [&](const toyc::mir::MachineFunction &MF) { plain[MF.name] = MF; });
+                auto schedMod = builder.buildModule(unit);
+                toyc::opt::optimizeModule(*schedMod, level);
+                toyc::RISCVCodeGen schedGen(1);
+                schedGen.setSchedule(model);
+                bool ok = true;
+                schedGen.generateMachineCode(*schedMod, [&](const toyc::mir::MachineFunction &MF) {
+                    const auto &orig = plain[MF.name];
+                    ok = ok && orig.blocks.size() == MF.blocks.size();
+                    for (size_t bi = 0; ok && bi < MF.blocks.size(); ++bi) {
+                        const auto &before = orig.blocks[bi].insts, &after = MF.blocks[bi].insts;
+                        ok = orig.blocks[bi].label == MF.blocks[bi].label &&
+                             before.size() == after.size() && cycles(after) <= cycles(before);
+                        // pos[k]：原第 k 条指令在调度后的位置（相同的指令按出现次序对应）
+                        std::vector<int> pos(before.size(), -1);
+                        std::vector<bool> used(after.size(), false);
+                        for (size_t k = 0; ok && k < before.size(); ++k) {
+                            for (size_t m = 0; m < after.size() && pos[k] < 0; ++m)
+                                if (!used[m] && sameInst(before[k], after[m])) {
+                                    pos[k] = static_cast<int>(m);
+                                    used[m] = true;
+                                }
+                            ok = pos[k] >= 0 && (!isFixed(before[k]) || pos[k] == static_cast<int>(k));
+                        }
+                        for (size_t i = 0; ok && i < before.size(); ++i)
+                            for (size_t j = i + 1; ok && j < before.size(); ++j) {
+                                const MachineInstr &a = before[i], &b = before[j];
+                                const int wa = writes(a), wb = writes(b);
+                                const bool regDep =
+                                    (wa > 0 && (b.rs1 == wa || b.rs2 == wa || wb == wa)) ||
+                                    (wb > 0 && (a.rs1 == wb || a.rs2 == wb));
+                                const bool memDep = isMem(a) && isMem(b) &&
+                                                    (isStore(a) || isStore(b)) &&
+                                                    a.rs1 == b.rs1 && a.imm == b.imm;
+                                ok = !(regDep || memDep) || pos[i] < pos[j];
+                            }
+                    }
+                });
+                if (!ok) {
+                    std::cout << "FAIL (scheduling broke a dependence or added stalls at -O"
+                              << level << ")\n";
+                    return false;
+                }
+            }
+        }
+
+        // 30. RV32C：同一机器函数分别按 RV32IM / RV32IMC 打印，c.* 行还原后与原指令逐行相同，
+        //     且寄存器（3 位字段只能是 x8-x15）与立即数满足各自的编码约束；压缩目标文件
+        //     置 EF_RISCV_RVC 标志，.text 比不压缩时小
+        {
+            auto cMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*cMod, 1);
+            toyc::RISCVCodeGen cGen(1);
+            cGen.setCompressed(true);
+            std::ostringstream plainAsm, compressedAsm;
+            toyc::AsmEmitter plainOut(plainAsm), compressedOut(compressedAsm);
+            toyc::mir::AsmPrinter plainPrinter(plainOut), compressedPrinter(compressedOut, true);
+            cGen.generateMachineCode(*cMod, [&](const toyc::mir::MachineFunction &MF) {
+                plainPrinter.printFunction(MF);
+                compressedPrinter.printFunction(MF);
+            });
+            auto lines = [](const std::string &text) {
+                std::vector<std::string> out;
+                std::istringstream is(text);
+                for (std::string line; std::getline(is, line);)
+                    out.push_back(line.substr(std::min(line.find_first_not_of(' '), line.size())));
+                return out;
+            };
+            const std::set<std::string> cregs = {"s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5"};
+            auto inRange = [](int v, int lo, int hi, int scale) {
+                return v >= lo && v <= hi && v % scale == 0;
+            };
+            // expand：c.* 行 → 对应的原指令（可能有两种写法）；约束不满足时返回空
+            auto expand = [&](const std::string &line) -> std::vector<std::string> {
+                size_t sp = line.find(' ');
+                std::string op = line.substr(2, sp == std::string::npos ? sp : sp - 2);
+                std::vector<std::string> ops;
+                if (sp != std::string::npos) {
+                    std::istringstream is(line.substr(sp + 1));
+                    for (std::string o; std::getline(is, o, ',');)
+                        ops.push_back(o.substr(o.find_first_not_of(' ')));
+                }
+                auto imm = [](const std::string &o) { return std::atoi(o.c_str()); };
+                auto memBase = [&](const std::string &o) {
+                    return o.substr(o.find('(') + 1, o.size() - o.find('(') - 2);
+                };
+                const bool rdOk = !ops.empty() && ops[0] != "zero";
+                if (op == "jr" && ops.size() == 1 && ops[0] == "ra")
+                    return {"ret"};
+                if (ops.size() == 2) {
+                    const std::string &rd = ops[0], &x = ops[1];
+                    if (op == "li" && rdOk && inRange(imm(x), -32, 31, 1))
+                        return {"li " + rd + ", " + x};
+                    if (op == "mv" && rdOk && x != "zero")
+                        return {"mv " + rd + ", " + x, "addi " + rd + ", " + x + ", 0"};
+                    if (op == "add" && rdOk && x != "zero")
+                        return {"add " + rd + ", " + rd + ", " + x, "add " + rd + ", " + x + ", " + rd};
+                    if (op == "sub" && cregs.count(rd) && cregs.count(x))
+                        return {"sub " + rd + ", " + rd + ", " + x};
+                    if (op == "addi" && rdOk && imm(x) != 0 && inRange(imm(x), -32, 31, 1))
+                        return {"addi " + rd + ", " + rd + ", " + x};
+                    if (op == "addi16sp" && rd == "sp" && imm(x) != 0 && inRange(imm(x), -512, 496, 16))
+                        return {"addi sp, sp, " + x};
+                    if (op == "andi" && cregs.count(rd) && inRange(imm(x), -32, 31, 1))
+                        return {"andi " + rd + ", " + rd + ", " + x};
+                    if ((op == "slli" ? rdOk : cregs.count(rd) > 0) &&
+                        (op == "slli" || op == "srli" || op == "srai") && inRange(imm(x), 1, 31, 1))
+                        return {op + " " + rd + ", " + rd + ", " + x};
+                    const std::string base = memBase(x);
+                    const int off = imm(x);
+                    if ((op == "lw" || op == "sw") && cregs.count(rd) && cregs.count(base) &&
+                        inRange(off, 0, 124, 4))
+                        return {op + " " + rd + ", " + x};
+                    if ((op == "lwsp" ? rdOk : op == "swsp") && base == "sp" && inRange(off, 0, 252, 4))
+                        return {op.substr(0, 2) + " " + rd + ", " + x};
+                }
+                if (op == "addi4spn" && ops.size() == 3 && cregs.count(ops[0]) && ops[1] == "sp" &&
+                    inRange(imm(ops[2]), 4, 1020, 4))
+                    return {"addi " + ops[0] + ", sp, " + ops[2]};
+                return {};
+            };
+            const auto plain = lines(plainAsm.str()), compressed = lines(compressedAsm.str());
+            bool ok = plain.size() == compressed.size();
+            size_t numCompressed = 0;
+            for (size_t i = 0; ok && i < plain.size(); ++i) {
+                if (compressed[i].compare(0, 2, "c.") != 0) {
+                    ok = compressed[i] == plain[i];
+                    continue;
+                }
+                ++numCompressed;
+                auto forms = expand(compressed[i]);
+                ok = std::find(forms.begin(), forms.end(), plain[i]) != forms.end();
+                if (!ok)
+                    std::cout << "FAIL (bad compressed form '" << compressed[i] << "' for '"
+                              << plain[i] << "')\n";
+            }
+            if (!ok || numCompressed == 0) {
+                if (ok)
+                    std::cout << "FAIL (no compressed instructions)\n";
+                else if (plain.size() != compressed.size())
+                    std::cout << "FAIL (compressed assembly has a different shape)\n";
+                return false;
+            }
+            std::ostringstream plainObj, compressedObj;
+            toyc::generateRISCVObject(*cMod, plainObj);
+            toyc::generateRISCVObject(*cMod, compressedObj, 1, nullptr, toyc::RegAllocKind::Linear,
+                                      nullptr, true);
+            const std::string po = plainObj.str(), co = compressedObj.str();
+            // textSize：按节头表找到 .text 的 sh_size（目标文件整体大小含节对齐填充，小函数
+            // 压缩省下的字节可能正好被填充抵消）
+            auto textSize = [](const std::string &obj) -> uint32_t {
+                auto u16 = [&](size_t at) {
+                    return static_cast<uint32_t>(static_cast<uint8_t>(obj[at])) |
+                           static_cast<uint32_t>(static_cast<uint8_t>(obj[at + 1])) << 8;
+                };
+                auto u32 = [&](size_t at) { return u16(at) | u16(at + 2) << 16; };
+                const uint32_t shoff = u32(32), shnum = u16(48);
+                const uint32_t strtab = u32(shoff + u16(50) * 40 + 16);
+                for (uint32_t i = 0; i < shnum; ++i)
+                    if (std::strcmp(obj.c_str() + strtab + u32(shoff + i * 40), ".text") == 0)
+                        return u32(shoff + i * 40 + 20);
+                return 0;
+            };
+            if (po[36] != 0 || co[36] != 1 || textSize(co) == 0 ||
+                textSize(co) >= textSize(po)) {
+                std::cout << "FAIL (compressed object lacks RVC flag or is not smaller)\n";
+                return false;
+            }
+        }
+
+        // 31. 过程间寄存器分配：不内联的 -O1 模块按 -fipra 生成，每个调用之后（同一块内）
+        //     读取的调用者保存寄存器不在被调函数（传递闭包）改写的寄存器中；两种分配器的
+        //     调用点保存都不多于按 ABI 保存，多线程结果与单线程相同
+        {
+            using toyc::mir::MachineInstr;
+            using toyc::mir::MOpcode;
+            using toyc::RegMask;
+            constexpr int kSP = 2, kA0 = 10;
+            const RegMask abi = toyc::RegInfo::shared(false).callerSavedMask();
+            for (auto kind : {toyc::RegAllocKind::Linear, toyc::RegAllocKind::Graph}) {
+                auto abiMod = builder.buildModule(unit);
+                toyc::opt::optimizeModule(*abiMod, 1, 0);
+                toyc::RISCVCodeGen abiGen(1);
+                abiGen.setRegAlloc(kind);
+                size_t abiSaves = 0, ipraSaves = 0;
+                auto countSaves = [](const toyc::mir::MachineFunction &MF) {
+                    size_t n = 0;
+                    for (const auto &MBB : MF.blocks)
+                        for (const MachineInstr &MI : MBB.insts)
+                            n += MI.opcode == MOpcode::SW && MI.rs1 == kSP;
+                    return n;
+                };
+                abiGen.generateMachineCode(*abiMod, [&](const toyc::mir::MachineFunction &MF) {
+                    abiSaves += countSaves(MF);
+                });
+                auto ipraMod = builder.buildModule(unit);
+                toyc::opt::optimizeModule(*ipraMod, 1, 0);
+                std::map<std::string, toyc::mir::MachineFunction> funcs;
+                toyc::RISCVCodeGen ipraGen(1);
+                ipraGen.setRegAlloc(kind);
+                ipraGen.setIPRA(true);
+                ipraGen.generateMachineCode(*ipraMod, [&](const toyc::mir::MachineFunction &MF) {
+                    funcs[MF.name] = MF;
+                    ipraSaves += countSaves(MF);
+                });
+                // clobbers：各函数改写的调用者保存寄存器（沿调用图传递到不动点）
+                std::map<std::string, RegMask> clobbers;
+                for (bool changed = true; changed;) {
+                    changed = false;
+                    for (const auto &[name, MF] : funcs) {
+                        RegMask mask = 0;
+                        for (const auto &MBB : MF.blocks)
+                            for (const MachineInstr &MI : MBB.insts) {
+                                if (MI.rd >= 0)
+                                    mask |= toyc::regBit(MI.rd);
+                                if (MI.opcode == MOpcode::CALL || MI.opcode == MOpcode::TAIL)
+                                    mask |= funcs.count(MI.sym.str()) ? clobbers[MI.sym.str()]
+                                                                      : abi;
+                            }
+                        mask &= abi;
+                        changed = changed || mask != clobbers[name];
+                        clobbers[name] = mask;
+                    }
+                }
+                bool ok = true;
+                for (const auto &[name, MF] : funcs)
+                    for (const auto &MBB : MF.blocks)
+                        for (size_t i = 0; ok && i < MBB.insts.size(); ++i) {
+                            if (MBB.insts[i].opcode != MOpcode::CALL)
+                                continue;
+                            const RegMask dead = clobbers[MBB.insts[i].sym.str()];
+                            RegMask written = toyc::regBit(kA0);
+                            for (size_t j = i + 1; ok && j < MBB.insts.size(); ++j) {
+                                const MachineInstr &MI = MBB.insts[j];
+                                if (MI.opcode == MOpcode::CALL)
+                                    break;
+                                for (int reg : {MI.rs1, MI.rs2})
+                                    if (reg > 0 && (dead & ~written & toyc::regBit(reg))) {
+                                        ok = false;
+                                        std::cout << "FAIL (" << name << " reads x" << reg
+                                                  << " after " << MBB.insts[i].sym.str()
+                                                  << " clobbered it)\n";
+                                    }
+                                if (MI.rd > 0 && MI.opcode != MOpcode::SW &&
+                                    MI.opcode != MOpcode::SB)
+                                    written |= toyc::regBit(MI.rd);
+                            }
+                        }
+                if (!ok)
+                    return false;
+                if (ipraSaves > abiSaves) {
+                    std::cout << "FAIL (-fipra stored more registers than the ABI allocation)\n";
+                    return false;
+                }
+                auto threadedMod = builder.buildModule(unit);
+                toyc::opt::optimizeModule(*threadedMod, 1, 0);
+                if (toyc::generateRISCVAssembly(*threadedMod, 4, nullptr, kind, false, nullptr,
+                                                false, true) !=
+                    toyc::generateRISCVAssembly(*ipraMod, 1, nullptr, kind, false, nullptr, false,
+                                                true)) {
+                    std::cout << "FAIL (-fipra output depends on the thread count)\n";
+                    return false;
+                }
+            }
+        }
+
+        // 32. 省略帧指针：-O1 下每个函数不再以 s0 为基址访存，sp 相对的访问都落在本函数的栈帧或
+        //     调用者的出栈参数区内；改写 s0 的函数把它列为被调用者保存寄存器
+        {
+            using toyc::mir::MachineInstr;
+            using toyc::mir::MOpcode;
+            constexpr int kSP = 2, kS0 = 8;
+            auto fpMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*fpMod, 1);
+            toyc::RISCVCodeGen fpGen(1);
+            fpGen.setOmitFramePointer(true);
+            bool ok = true;
+            fpGen.generateMachineCode(*fpMod, [&](const toyc::mir::MachineFunction &MF) {
+                const bool savesS0 = std::find(MF.calleeSavedRegs.begin(), MF.calleeSavedRegs.end(),
+                                               kS0) != MF.calleeSavedRegs.end();
+                for (const auto &MBB : MF.blocks)
+                    for (const MachineInstr &MI : MBB.insts) {
+                        const bool isMem = MI.opcode == MOpcode::LW || MI.opcode == MOpcode::LB ||
+                                           MI.opcode == MOpcode::SW || MI.opcode == MOpcode::SB;
+                        const bool isStore = MI.opcode == MOpcode::SW || MI.opcode == MOpcode::SB;
+                        if (!ok)
+                            return;
+                        if (isMem && MI.rs1 == kS0) {
+                            std::cout << "FAIL (" << MF.name
+                                      << " still addresses the frame from s0)\n";
+                            ok = false;
+                        } else if (isMem && MI.rs1 == kSP && (MI.imm < 0 || MI.imm % 4 != 0)) {
+                            std::cout << "FAIL (" << MF.name << " accesses " << MI.imm
+                                      << "(sp) outside the frame)\n";
+                            ok = false;
+                        } else if (!isStore && MI.rd == kS0 && !savesS0) {
+                            std::cout << "FAIL (" << MF.name << " writes s0 without saving it)\n";
+                            ok = false;
+                        }
+                    }
+            });
+            if (!ok)
+                return false;
+        }
+
+        // 33. 叶函数栈帧与收缩包装：不内联的 -O1 模块中，没有 call 的函数不保存 ra，frameSize 为 0
+        //     的函数不调整 sp；每个函数至多一处 prologue（addi sp, sp, -N），且它所在的块不在环上
+        {
+            using toyc::mir::MachineInstr;
+            using toyc::mir::MOpcode;
+            constexpr int kRA = 1, kSP = 2;
+            for (bool omitFP : {false, true}) {
+                auto swMod = builder.buildModule(unit);
+                toyc::opt::optimizeModule(*swMod, 1, 0);
+                toyc::RISCVCodeGen swGen(1);
+                swGen.setOmitFramePointer(omitFP);
+                bool ok = true;
+                swGen.generateMachineCode(*swMod, [&](const toyc::mir::MachineFunction &MF) {
+                    auto fail = [&](const char *why) {
+                        if (ok)
+                            std::cout << "FAIL (" << MF.name << ": " << why << ")\n";
+                        ok = false;
+                    };
+                    const int n = static_cast<int>(MF.blocks.size());
+                    bool leaf = true, savesRA = false;
+                    int prologues = 0, prologueBlock = -1;
+                    std::vector<std::vector<int>> succs(n);
+                    for (int bi = 0; bi < n; ++bi) {
+                        const auto &insts = MF.blocks[bi].insts;
+                        for (const MachineInstr &MI : insts) {
+                            leaf = leaf && MI.opcode != MOpcode::CALL;
+                            savesRA = savesRA || (MI.opcode == MOpcode::SW && MI.rs2 == kRA);
+                            if (MI.opcode == MOpcode::ADDI && MI.rd == kSP && MI.rs1 == kSP &&
+                                MI.imm < 0) {
+                                ++prologues;
+                                prologueBlock = bi;
+                            } else if (MF.frameSize == 0 && MI.rd == kSP) {
+                                fail("frameless function writes sp");
+                            }
+                            if (MI.opcode == MOpcode::J || MI.isBranch())
+                                succs[bi].push_back(MI.target);
+                        }
+                        const MOpcode last = insts.empty() ? MOpcode::ADDI : insts.back().opcode;
+                        if (bi + 1 < n && last != MOpcode::J && last != MOpcode::RET &&
+                            last != MOpcode::TAIL)
+                            succs[bi].push_back(bi + 1);
+                    }
+                    if (leaf && savesRA)
+                        fail("leaf function saves ra");
+                    if (prologues > 1 || (prologues == 0) != (MF.frameSize == 0))
+                        fail("frame is not set up exactly once");
+                    if (prologueBlock < 0)
+                        return;
+                    std::vector<char> seen(n, 0);
+                    std::vector<int> work = succs[prologueBlock];
+                    while (!work.empty()) {
+                        const int bi = work.back();
+                        work.pop_back();
+                        if (bi == prologueBlock)
+                            fail("prologue runs inside a loop");
+                        if (seen[bi])
+                            continue;
+                        seen[bi] = 1;
+                        work.insert(work.end(), succs[bi].begin(), succs[bi].end());
+                    }
+                });
+                if (!ok)
+                    return false;
+            }
+        }
+
+        // 34. 栈槽着色：-O0 下每个 alloca 都有颜色，颜色相同的 alloca 在任何一次 store 处都不同时
+        //     活跃（内存活跃性：load 为 use，store 为 def）；只留 4 个寄存器时两种分配器的溢出栈槽
+        //     编号连续（-4, -8, ...）
+        {
+            using toyc::ir::Opcode;
+            auto scMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*scMod, 0);
+            auto ptrOf = [](const toyc::ir::Instruction &inst) {
+                const int i = inst.opcode == Opcode::Load    ? 0
+                              : inst.opcode == Opcode::Store ? 1
+                                                             : -1;
+                return i >= 0 && inst.ops[i].isVReg() ? inst.ops[i].regId() : -1;
+            };
+            for (auto &func : scMod->functions) {
+                toyc::LinearScanAllocator allocator(regInfo);
+                auto result = allocator.allocate(*func);
+                // 块只执行到第一条终结指令（其后是 break / return 留下的死指令），后继取自这条指令
+                using Block = toyc::ir::BasicBlock;
+                std::map<const Block *, size_t> length;
+                std::map<const Block *, std::vector<const Block *>> succs;
+                for (size_t b = 0; b < func->blocks.size(); ++b) {
+                    const Block *bb = func->blocks[b].get();
+                    auto term = std::find_if(bb->insts.begin(), bb->insts.end(),
+                                             [](const auto *inst) { return inst->isTerminator(); });
+                    length[bb] = static_cast<size_t>(term - bb->insts.begin()) +
+                                 (term != bb->insts.end());
+                    if (term == bb->insts.end() && b + 1 < func->blocks.size())
+                        succs[bb].push_back(func->blocks[b + 1].get());
+                    else if (term != bb->insts.end())
+                        for (const std::string &label : (*term)->branchTargets())
+                            succs[bb].push_back(func->blockMap.at(label));
+                }
+                std::map<const Block *, std::set<int>> liveIn;
+                // scan：反向扫描块，每个 store 之前（含被 store 的 alloca）调用 onStore(ptr, live)
+                auto scan = [&](const Block *bb, auto &&onStore) {
+                    std::set<int> live;
+                    for (const Block *succ : succs[bb])
+                        live.insert(liveIn[succ].begin(), liveIn[succ].end());
+                    for (auto it = bb->insts.rend() - static_cast<std::ptrdiff_t>(length[bb]);
+                         it != bb->insts.rend(); ++it) {
+                        const int ptr = ptrOf(**it);
+                        if (ptr < 0)
+                            continue;
+                        if ((*it)->opcode == Opcode::Store) {
+                            onStore(ptr, live);
+                            live.erase(ptr);
+                        } else {
+                            live.insert(ptr);
+                        }
+                    }
+                    return live;
+                };
+                for (bool changed = true; changed;) {
+                    changed = false;
+                    for (const auto &bb : func->blocks) {
+                        auto in = scan(bb.get(), [](int, const std::set<int> &) {});
+                        changed = changed || in != liveIn[bb.get()];
+                        liveIn[bb.get()] = std::move(in);
+                    }
+                }
+                bool ok = true;
+                for (const auto &bb : func->blocks) {
+                    for (const auto *inst : bb->insts)
+                        ok = ok && (inst->opcode != Opcode::Alloca ||
+                                    result.allocaColors.count(inst->defReg()));
+                    scan(bb.get(), [&](int ptr, const std::set<int> &live) {
+                        for (int v : live)
+                            ok = ok && (v == ptr || !result.allocaColors.count(v) ||
+                                        result.allocaColors.at(v) != result.allocaColors.at(ptr));
+                    });
+                }
+                if (!ok) {
+                    std::cout << "FAIL (" << func->name << ": allocas sharing a slot overlap)\n";
+                    return false;
+                }
+            }
+            auto slotMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*slotMod, 1);
+            toyc::RegInfo fewRegs;
+            while (fewRegs.allocatableRegs.size() > 4)
+                fewRegs.allocatableRegs.erase(std::prev(fewRegs.allocatableRegs.end()));
+            for (auto kind : {toyc::RegAllocKind::Linear, toyc::RegAllocKind::Graph})
+                for (auto &func : slotMod->functions) {
+                    auto allocator = toyc::createRegisterAllocator(kind, fewRegs);
+                    auto result = allocator->allocate(*func);
+                    std::set<int> slots;
+                    for (auto [vreg, slot] : result.vregToStack)
+                        if (slot < 0)
+                            slots.insert(-slot);
+                    if (!slots.empty() && (*slots.begin() != 4 ||
+                                           *slots.rbegin() != 4 * static_cast<int>(slots.size()))) {
+                        std::cout << "FAIL (" << func->name
+                                  << ": spill slots are not contiguous)\n";
+                        return false;
+                    }
+                }
+        }
+
+        // 35. 常量重物化：只留 4 个寄存器时，-O1 下两种分配器重物化的 vreg 不在寄存器或栈槽中，
+        //     它的每个 def 都是同一常量或另一个 vreg 的 copy，分配结果仍是合法着色；手写的高压函数中
+        //     只由 copy 7 定义的 vreg 被重物化，生成的代码在每个 use 前 li 7，不写回栈槽
+        {
+            using toyc::ir::Opcode;
+            auto rmMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*rmMod, 1);
+            toyc::RegInfo fewRegs;
+            while (fewRegs.allocatableRegs.size() > 4)
+                fewRegs.allocatableRegs.erase(std::prev(fewRegs.allocatableRegs.end()));
+            for (auto kind : {toyc::RegAllocKind::Linear, toyc::RegAllocKind::Graph})
+                for (auto &func : rmMod->functions) {
+                    auto allocator = toyc::createRegisterAllocator(kind, fewRegs);
+                    auto result = allocator->allocate(*func);
+                    const toyc::ir::Function &allocated =
+                        allocator->splitFunction() ? *allocator->splitFunction() : *func;
+                    bool ok = coloringIsValid(allocated, result);
+                    for (auto [vreg, value] : result.rematValues)
+                        ok = ok && !result.vregToStack.count(vreg) &&
+                             !result.vregToPhys.count(vreg);
+                    for (const auto &bb : allocated.blocks)
+                        for (const auto *inst : bb->insts) {
+                            auto remat = result.rematValues.find(inst->defReg());
+                            if (remat == result.rematValues.end())
+                                continue;
+                            if (inst->opcode != Opcode::Copy) {
+                                ok = false;
+                                continue;
+                            }
+                            const auto &src = inst->ops[0];
+                            const int value = src.isImm()       ? src.immValue()
+                                              : src.isBoolLit() ? src.boolValue() ? 1 : 0
+                                                                : remat->second;
+                            ok = ok && (src.isVReg() || value == remat->second);
+                        }
+                    if (!ok) {
+                        std::cout << "FAIL (" << func->name << ": invalid rematerialization)\n";
+                        return false;
+                    }
+                }
+
+            // %2 活跃范围最长、引用最少，4 个寄存器时两种分配器都溢出它
+            const char *rematText = "define i32 @remat(i32 %0, i32 %1) {\n"
+                                    "  %2 = copy i32 7\n"
+                                    "  %3 = add nsw i32 %0, %1\n"
+                                    "  %4 = mul nsw i32 %3, %0\n"
+                                    "  %5 = sub nsw i32 %4, %1\n"
+                                    "  %6 = mul nsw i32 %5, %3\n"
+                                    "  %7 = add nsw i32 %6, %2\n"
+                                    "  %8 = add nsw i32 %7, %3\n"
+                                    "  %9 = add nsw i32 %8, %4\n"
+                                    "  %10 = add nsw i32 %9, %5\n"
+                                    "  %11 = add nsw i32 %10, %6\n"
+                                    "  %12 = add nsw i32 %11, %2\n"
+                                    "  ret i32 %12\n"
+                                    "}\n";
+            for (auto kind : {toyc::RegAllocKind::Linear, toyc::RegAllocKind::Graph}) {
+                toyc::IRParser rmParser;
+                auto rmFunc = std::move(rmParser.parseModule(rematText)->functions.front());
+                auto allocator = toyc::createRegisterAllocator(kind, fewRegs);
+                auto result = allocator->allocate(*rmFunc);
+                bool ok = result.rematValues.count(2) && result.rematValues.at(2) == 7;
+                auto MF = toyc::FunctionCodeGen(fewRegs, *allocator, *rmFunc).run();
+                // 直线代码中每个溢出的 vreg 恰有一个 def（一条写回），其余 sw 保存被调用者保存寄存器
+                size_t loads = 0, stores = 0;
+                for (const auto &MBB : MF.blocks)
+                    for (const auto &MI : MBB.insts) {
+                        loads += MI.opcode == toyc::mir::MOpcode::LI && MI.imm == 7;
+                        stores += MI.opcode == toyc::mir::MOpcode::SW;
+                    }
+                if (!ok || loads != 2 ||
+                    stores != MF.calleeSavedRegs.size() + result.vregToStack.size()) {
+                    std::cout << "FAIL (constant 7 not rematerialized at both uses)\n";
+                    return false;
+                }
+            }
+        }
+
+        // 36. 循环向量化：-O1 之后新增的函数恰是各个内核，都带有 VectorKernel 描述（运算只引用在前的
+        //     值，结果是运算），形参不超过 8 个，原函数中调用内核的次数等于向量化的循环数；内核的
+        //     机器代码是不保存 ra 的叶函数、含 vsetvli 与 vredsum.vs 而不访存。手写的归约循环被向量化，
+        //     循环体含 call 的循环不被向量化；加数为 true 的归约向量化后模拟运行的结果正确
+        {
+            using toyc::ir::Opcode;
+            using toyc::mir::MOpcode;
+            using Kind = toyc::ir::VectorKernel::Value::Kind;
+            auto vecMod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*vecMod, 1);
+            const size_t original = vecMod->functions.size();
+            const int vectorized = toyc::opt::vectorizeLoops(*vecMod);
+            bool ok = vecMod->functions.size() == original + static_cast<size_t>(vectorized);
+            int kernelCalls = 0;
+            for (size_t i = 0; i < vecMod->functions.size() && ok; ++i) {
+                const auto &func = vecMod->functions[i];
+                for (const auto &bb : func->blocks)
+                    for (const auto *inst : bb->insts)
+                        kernelCalls += inst->opcode == Opcode::Call &&
+                                       inst->callee.str().rfind("__vec_", 0) == 0;
+                const toyc::ir::VectorKernel *kernel = func->vectorKernel.get();
+                if (i < original) {
+                    ok = !kernel;
+                    continue;
+                }
+                ok = kernel && func->params.size() <= 8 && kernel->result >= 0 &&
+                     kernel->values[kernel->result].kind == Kind::Op;
+                for (size_t v = 0; ok && v < kernel->values.size(); ++v) {
+                    const auto &value = kernel->values[v];
+                    ok = value.kind != Kind::Op ||
+                         (value.lhs >= 0 && value.rhs >= 0 && static_cast<size_t>(value.lhs) < v &&
+                          static_cast<size_t>(value.rhs) < v);
+                }
+            }
+            if (!ok || kernelCalls != vectorized) {
+                std::cout << "FAIL (malformed vector kernel)\n";
+                return false;
+            }
+            auto checkKernels = [](toyc::ir::Module &mod) {
+                bool valid = true;
+                toyc::RISCVCodeGen vecGen(1);
+                vecGen.generateMachineCode(mod, [&](const toyc::mir::MachineFunction &MF) {
+                    if (!MF.usesVector)
+                        return;
+                    bool vsetvli = false, reduce = false;
+                    for (const auto &MBB : MF.blocks)
+                        for (const auto &MI : MBB.insts) {
+                            vsetvli = vsetvli || MI.opcode == MOpcode::VSETVLI;
+                            reduce = reduce || MI.opcode == MOpcode::VREDSUM_VS;
+                            valid = valid && MI.opcode != MOpcode::CALL &&
+                                    MI.opcode != MOpcode::LW && MI.opcode != MOpcode::SW;
+                        }
+                    valid = valid && vsetvli && reduce && !MF.savesReturnAddress;
+                });
+                return valid;
+            };
+            if (!checkKernels(*vecMod)) {
+                std::cout << "FAIL (vector kernel machine code)\n";
+                return false;
+            }
+
+            const char *vecText = "define i32 @vsum(i32 %0, i32 %1) {\n"
+                                  "  br label %loop\n"
+                                  "loop:\n"
+                                  "  %2 = phi i32 [ 0, %entry ], [ %5, %body ]\n"
+                                  "  %3 = phi i32 [ 0, %entry ], [ %6, %body ]\n"
+                                  "  %4 = icmp slt i32 %3, %0\n"
+                                  "  br i1 %4, label %body, label %exit\n"
+                                  "body:\n"
+                                  "  %7 = mul nsw i32 %3, %1\n"
+                                  "  %5 = add nsw i32 %2, %7\n"
+                                  "  %6 = add nsw i32 %3, 1\n"
+                                  "  br label %loop\n"
+                                  "exit:\n"
+                                  "  ret i32 %2\n"
+                                  "}\n"
+                                  "define i32 @vcall(i32 %0) {\n"
+                                  "  br label %loop\n"
+                                  "loop:\n"
+                                  "  %2 = phi i32 [ 0, %entry ], [ %5, %body ]\n"
+                                  "  %3 = phi i32 [ 0, %entry ], [ %6, %body ]\n"
+                                  "  %4 = icmp slt i32 %3, %0\n"
+                                  "  br i1 %4, label %body, label %exit\n"
+                                  "body:\n"
+                                  "  %7 = call i32 @vsum(i32 noundef %3, i32 noundef %0)\n"
+                                  "  %5 = add nsw i32 %2, %7\n"
+                                  "  %6 = add nsw i32 %3, 1\n"
+                                  "  br label %loop\n"
+                                  "exit:\n"
+                                  "  ret i32 %2\n"
+                                  "}\n";
+            toyc::IRParser vecParser;
+            auto handMod = vecParser.parseModule(vecText);
+            if (toyc::opt::vectorizeLoops(*handMod) != 1 || handMod->functions.size() != 3 ||
+                !handMod->functions.back()->vectorKernel || !checkKernels(*handMod)) {
+                std::cout << "FAIL (reduction loop not vectorized exactly once)\n";
+                return false;
+            }
+
+            // SCCP 与 || 的穿透会留下布尔字面量操作数：内核把 true 当作常量 1，而不是没有定义的形参
+            const char *boolText = "define i32 @main() {\n"
+                                   "  br label %loop\n"
+                                   "loop:\n"
+                                   "  %0 = phi i32 [ 0, %entry ], [ %3, %body ]\n"
+                                   "  %1 = phi i32 [ 0, %entry ], [ %4, %body ]\n"
+                                   "  %2 = icmp slt i32 %1, 6\n"
+                                   "  br i1 %2, label %body, label %exit\n"
+                                   "body:\n"
+                                   "  %5 = mul nsw i32 %1, 3\n"
+                                   "  %6 = add nsw i32 %0, true\n"
+                                   "  %3 = add nsw i32 %6, %5\n"
+                                   "  %4 = add nsw i32 %1, 1\n"
+                                   "  br label %loop\n"
+                                   "exit:\n"
+                                   "  ret i32 %0\n"
+                                   "}\n";
+            auto boolMod = vecParser.parseModule(boolText);
+            const bool boolVectorized = toyc::opt::vectorizeLoops(*boolMod) == 1;
+            toyc::sim::Result boolRun = toyc::sim::run(toyc::sim::link(
+                {toyc::sim::loadObject(toyc::generateRISCVAssembly(*boolMod), "bool-addend")}));
+            if (!boolVectorized || boolRun.status != toyc::sim::Result::Status::Exited ||
+                boolRun.exitCode != 51) {
+                std::cout << "FAIL (boolean operand in a vector kernel)\n";
+                return false;
+            }
+        }
+
+        // 37. 内置模拟器：-O0 / -O1 / RV32IMC / RVV 的汇编文本与 ELF 目标文件链接内置 crt0 后都正常退出、
+        //     退出码一致；同一配置下汇编与目标文件的动态计数完全相同，压缩编码不改变执行的指令数。
+        //     手写汇编覆盖数据段、%hi / %lo、数字标号、c.* 与 write 输出、越界分支的放宽，
+        //     未定义符号与死循环报错
+        {
+            namespace sim = toyc::sim;
+            auto runText = [](const std::string &text, const std::string &name) {
+                return sim::run(sim::link({sim::loadObject(text, name)}));
+            };
+            auto sameStats = [](const sim::Stats &a, const sim::Stats &b) {
+                return a.instructions == b.instructions && a.loads == b.loads &&
+                       a.stores == b.stores && a.stackLoads == b.stackLoads &&
+                       a.branchesTaken == b.branchesTaken && a.calls == b.calls &&
+                       a.cycles == b.cycles;
+            };
+            std::vector<sim::Result> runs;
+            bool ok = true;
+            for (int level : {0, 1}) {
+                auto simMod = builder.buildModule(unit);
+                if (level > 0)
+                    toyc::opt::optimizeModule(*simMod, level);
+                std::ostringstream obj, cObj;
+                toyc::generateRISCVObject(*simMod, obj);
+                toyc::generateRISCVObject(*simMod, cObj, 1, nullptr, toyc::RegAllocKind::Linear,
+                                          nullptr, true);
+                sim::Result fromAsm = runText(toyc::generateRISCVAssembly(*simMod), "asm");
+                sim::Result fromObj = runText(obj.str(), "obj");
+                sim::Result fromCObj = runText(cObj.str(), "cobj");
+                ok = ok && sameStats(fromAsm.stats, fromObj.stats) &&
+                     fromCObj.stats.instructions == fromObj.stats.instructions &&
+                     fromObj.stats.compressed == 0 &&
+                     (fromCObj.stats.compressed > 0 || fromObj.stats.instructions == 0);
+                runs.insert(runs.end(), {fromAsm, fromObj, fromCObj});
+                if (level > 0) {
+                    toyc::opt::vectorizeLoops(*simMod);
+                    runs.push_back(runText(toyc::generateRISCVAssembly(*simMod), "vec"));
+                }
+            }
+            for (const sim::Result &r : runs)
+                ok = ok && r.status == sim::Result::Status::Exited &&
+                     r.exitCode == runs.front().exitCode && r.output.empty();
+            if (!ok) {
+                std::cout << "FAIL (simulated runs disagree)\n";
+                return false;
+            }
+
+            const char *handAsm = "    .text\n"
+                                  "    .globl main\n"
+                                  "main:\n"
+                                  "    lui a1, %hi(msg)\n"
+                                  "    addi a1, a1, %lo(msg)\n"
+                                  "    li a0, 1\n"
+                                  "    li a2, 3\n"
+                                  "    li a7, 64\n"
+                                  "    ecall\n"
+                                  "    la a3, table\n"
+                                  "    c.li a0, 0\n"
+                                  "    li t0, 0\n"
+                                  "1:  lw a4, 0(a3)\n"
+                                  "    c.add a0, a4\n"
+                                  "    addi a3, a3, 4\n"
+                                  "    addi t0, t0, 1\n"
+                                  "    li t1, 3\n"
+                                  "    blt t0, t1, 1b\n"
+                                  "    ret\n"
+                                  "    .data\n"
+                                  "msg:\n"
+                                  "    .ascii \"ok\\n\"\n"
+                                  "    .p2align 2\n"
+                                  "table:\n"
+                                  "    .word 10, 0x20, 012\n";
+            // 成立的分支：循环回跳两次，加上 crt0 中跳过 __toyc_prof_dump 的一次
+            sim::Result hand = runText(handAsm, "hand.s");
+            if (hand.status != sim::Result::Status::Exited || hand.exitCode != 52 ||
+                hand.output != "ok\n" || hand.stats.loads != 3 || hand.stats.branchesTaken != 3 ||
+                hand.stats.compressed != 4) {
+                std::cout << "FAIL (hand-written assembly simulated incorrectly)\n";
+                return false;
+            }
+            // 超出 ±4 KiB 的条件分支（向前与向后各一条）放宽为反转分支 + jal
+            std::string farAsm = "    .globl main\nmain:\n    li a1, 0\n    li t0, 0\n"
+                                 "2:  beqz t0, 1f\n";
+            for (int i = 0; i < 1100; ++i)
+                farAsm += "    addi a1, a1, 1\n";
+            farAsm += "1:  addi t0, t0, 1\n    li t1, 2\n    blt t0, t1, 2b\n"
+                      "    addi a0, a1, -1000\n    ret\n";
+            sim::Result far = runText(farAsm, "far.s");
+            if (far.status != sim::Result::Status::Exited || far.exitCode != 100) {
+                std::cout << "FAIL (out-of-range branches not relaxed by the assembler)\n";
+                return false;
+            }
+            bool undefinedCaught = false;
+            try {
+                runText("    .globl main\nmain:\n    call missing\n    ret\n", "undef.s");
+            } catch (const std::runtime_error &) {
+                undefinedCaught = true;
+            }
+            sim::Options limited;
+            limited.maxSteps = 1000;
+            sim::ObjectFile spinObj = sim::assemble("    .globl main\nmain:\n    j main\n", "spin.s");
+            sim::Result spin = sim::run(sim::link({std::move(spinObj)}), limited);
+            if (!undefinedCaught || spin.status != sim::Result::Status::StepLimit ||
+                spin.stats.instructions != 1000) {
+                std::cout << "FAIL (simulator errors not reported)\n";
+                return false;
+            }
+        }
+
+        // 38. 编译服务：同一个 CompileServer 连续处理请求，-O0 汇编与 -O2 目标文件都与直接编译一致、
+        //     重复请求结果不变，非法选项只返回诊断；经由描述符的请求流按 "头 + 负载" 逐个应答
+        {
+            toyc::ServerOptions serverOpts;
+            serverOpts.jobs = 2;
+            toyc::CompileServer server(serverOpts);
+            const std::string text(source.text());
+            auto o2Mod = builder.buildModule(unit);
+            toyc::opt::optimizeModule(*o2Mod, 2);
+            const toyc::mir::LatencyModel schedModel; // -O2 默认调度，-mtune=generic
+            std::ostringstream o2Obj;
+            toyc::generateRISCVObject(*o2Mod, o2Obj, 1, nullptr, toyc::RegAllocKind::Linear,
+                                      &schedModel, false, true);
+            std::string first, second, obj, diag;
+            bool ok = server.compile({}, text, first) && first == asmOutput &&
+                      server.compile({}, text, second) && second == asmOutput &&
+                      server.compile({"-O2", "-c"}, text, obj) && obj == o2Obj.str() &&
+                      !server.compile({"-O7"}, text, diag) && !diag.empty();
+
+            fs::path dir = fs::temp_directory_path() / ("toyc_test_server_" + filename);
+            fs::create_directories(dir);
+            {
+                std::ofstream req(dir / "requests", std::ios::binary);
+                req << "ping\ncompile " << text.size() << "\n" << text << "bogus\nquit\n";
+            }
+            int in = ::open((dir / "requests").c_str(), O_RDONLY);
+            int out = ::open((dir / "responses").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            bool keepRunning = in >= 0 && out >= 0 && server.serve(in, out);
+            ::close(in);
+            ::close(out);
+            std::ifstream resp(dir / "responses", std::ios::binary);
+            std::string responses((std::istreambuf_iterator<char>(resp)), {});
+            fs::remove_all(dir);
+            const std::string expected = "ok 0\nok " + std::to_string(asmOutput.size()) + "\n" +
+                                         asmOutput + "error 23\nunknown command 'bogus'";
+            if (!ok || !keepRunning || responses != expected || server.requests() != 5) {
+                std::cout << "FAIL (compile server responses differ)\n";
+                return false;
+            }
+        }
+
+        // 39. 嵌入式编译接口：同一个 CompilerContext 编译内存中的源码与其 IR 文本，汇编都与直接编译
+        //     一致；语法错误（带行号）、无法解析的 IR、不存在的函数与非法选项各自返回对应种类的诊断
+        {
+            using Kind = toyc::Diagnostic::Kind;
+            toyc::CompilerContext context(2);
+            const std::string text(source.text());
+            auto failsWith = [](const toyc::CompileResult &r, Kind kind) {
+                return r.diagnostics.size() == 1 && r.diagnostics[0].kind == kind &&
+                       !r.diagnostics[0].message.empty();
+            };
+            toyc::CompileOptions opts, irOpts, pick;
+            std::ostringstream fromSource, fromIR, sink;
+            irOpts.language = toyc::InputLanguage::IR;
+            pick.functions.push_back("no_such_function");
+            bool ok = context.compile(text, opts, fromSource).ok() &&
+                      fromSource.str() == asmOutput &&
+                      context.compile(mod->toString(), irOpts, fromIR).ok() &&
+                      fromIR.str() == asmOutput;
+            toyc::CompileResult syntax = context.compile(text + "\nint broken( {", opts, sink);
+            ok = ok && failsWith(syntax, Kind::SyntaxError) &&
+                 syntax.diagnostics[0].line > static_cast<int>(std::count(
+                                                  text.begin(), text.end(), '\n')) &&
+                 failsWith(context.compile("define i32 @f( {", irOpts, sink), Kind::InvalidIR) &&
+                 failsWith(context.compile(text, pick, sink), Kind::UnknownFunction) &&
+                 failsWith(toyc::parseCompileOptions({"--march=rv64gc"}, opts),
+                           Kind::InvalidOption) &&
+                 sink.str().empty() && context.compilations() == 5;
+            if (!ok) {
+                std::cout << "FAIL (compiler context results differ)\n";
+                return false;
+            }
+        }
+
+        std::cout << "OK\n";
+        return true;
+    } catch (const std::exception &e) {
+        std::cout << "FAIL (" << e.what() << ")\n";
+        return false;
+    }
+}
+
+// simulate：编译一段 ToyC 程序（level > 0 时按该级别优化）并在内置模拟器上运行，返回退出码
+//（没有正常退出时为 -1）
+static int simulate(const std::string &text, int level = 0,
+                    int inlineLimit = toyc::opt::kDefaultInlineLimit) {
+    Parser parser(text);
+    CompUnit unit = parser.parseCompUnit();
+    toyc::IRBuilder builder;
+    auto mod = builder.buildModule(unit);
+    if (level > 0)
+        toyc::opt::optimizeModule(*mod, level, inlineLimit);
+    toyc::sim::Result r = toyc::sim::run(
+        toyc::sim::link({toyc::sim::loadObject(toyc::generateRISCVAssembly(*mod), "program")}));
+    return r.status == toyc::sim::Result::Status::Exited ? r.exitCode : -1;
+}
+
+/**
+ * @brief 固定程序的回归测试
+ * @return true 表示全部通过
+ * @details 与测试目录中的输入无关，只运行一次（不计入 N/N 的文件数）
+ */
+static bool testPrograms() {
+    std::cout << "Testing: regression programs ... ";
+    try {
+        // R1. 栈槽着色：break 之后留下的死 br 不是块的出边，循环携带的 c 在 break 之后仍活跃，
+        //     不能与 break 前写入的块内变量 t 共用栈槽（-O0）
+        const char *breakLive = "int main() {\n"
+                                "    int c = 0;\n"
+                                "    int i = 0;\n"
+                                "    while (i < 7) {\n"
+                                "        if (!(i <= i)) {\n"
+                                "        } else {\n"
+                                "            if (c) {\n"
+                                "                int t = c > 2;\n"
+                                "                break;\n"
+                                "            }\n"
+                                "            c = 2;\n"
+                                "        }\n"
+                                "        i = i + 1;\n"
+                                "    }\n"
+                                "    return c * 3 + i * 50;\n"
+                                "}\n";
+        if (simulate(breakLive) != 56) {
+            std::cout << "FAIL (alloca live across break shares a stack slot)\n";
+            return false;
+        }
+
+        // R2. 符号表：内层同名变量退出作用域后，外层变量不会命中内层的已加载值缓存（返回 1 而不是 2）
+        if (simulate("int main() { int x = 1; { int x = 2; int y = x; } return x; }") != 1) {
+            std::cout << "FAIL (scoped symbol lookup)\n";
+            return false;
+        }
+
+        // R3. 第 9 个参数经栈传入（不算溢出）：跨调用活跃的值较多、却没有可分裂的区间时，
+        //     调用点仍须保存调用者保存寄存器，-O1 / -O2 关闭内联的结果与 -O0 一致
+        const char *stackArgs =
+            "int f0(int x) { return x * 3 + 1; }\n"
+            "int f1(int p0, int p1, int p2, int p3, int p4, int p5, int p6, int p7, int p8) {\n"
+            "    int i = 0; int s = p8;\n"
+            "    int v0 = p0; int v1 = p1 + 1; int v2 = p2 + 2; int v3 = p3 + 3;\n"
+            "    int v4 = p4 + 4; int v5 = p5 + 5; int v6 = p6 + 6; int v7 = p7 + 7;\n"
+            "    int v8 = p0 + 8;\n"
+            "    while (i < p0) {\n"
+            "        s = s + f0(i);\n"
+            "        v0 = v0 + i; v1 = v1 + i; v2 = v2 + i; v3 = v3 + i; v4 = v4 + i;\n"
+            "        v5 = v5 + i; v6 = v6 + i; v7 = v7 + i; v8 = v8 + i;\n"
+            "        i = i + 1;\n"
+            "    }\n"
+            "    return (s + v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8) % 256;\n"
+            "}\n"
+            "int main() { return f1(5, 1, 2, 3, 4, 5, 6, 7, 8); }\n";
+        for (int level : {0, 1, 2})
+            if (simulate(stackArgs, level, 0) != 207) {
+                std::cout << "FAIL (caller-saved registers lost around a call with stack args)\n";
+                return false;
+            }
+
+        // R4. CFG 化简：顺序落入空块 b 的前驱 a 没有可改写的标签，b 保留，化简在有限轮内结束
+        const char *fallText = "define void @fall(i32 %0) {\n"
+                               "  %2 = icmp sgt i32 %0, 1\n"
+                               "  br i1 %2, label %a, label %b\n"
+                               "a:\n"
+                               "  %3 = add nsw i32 %0, 1\n"
+                               "b:\n"
+                               "  br label %c\n"
+                               "c:\n"
+                               "  ret void\n"
+                               "}\n";
+        toyc::IRParser fallParser;
+        auto fallMod = fallParser.parseModule(fallText);
+        toyc::ir::Function &fall = *fallMod->functions.front();
+        toyc::opt::simplifyCFG(fall);
+        if (!fall.blockMap.count("b") || fall.blockMap.at("a")->succs.size() != 1 ||
+            fall.blockMap.at("a")->succs.front() != fall.blockMap.at("b")) {
+            std::cout << "FAIL (empty block threaded past a fall-through predecessor)\n";
+            return false;
+        }
+
+        // R5. 函数内联：调用是 void 调用者末块（没有终结指令）的最后一条指令，拆分时先补上 ret void
+        if (simulate("void g(int x) { x = x + 1; }\n"
+                     "void h(int x) { if (x > 1) { return; } g(x); }\n"
+                     "int main() { h(5); h(0); return 1; }\n",
+                     1, 1 << 20) != 1) {
+            std::cout << "FAIL (call at the end of an unterminated block inlined incorrectly)\n";
+            return false;
+        }
+
         std::cout << "OK\n";
         return true;
     } catch (const std::exception &e) {
@@ -100,18 +2031,117 @@ static bool testFile(const std::string &path, bool verbose) {
     }
 }
 
+// shellQuote：把参数包成单引号字符串（其中的单引号写作 '\''）
+static std::string shellQuote(const std::string &s) {
+    std::string out = "'";
+    for (char c : s)
+        out += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    return out + "'";
+}
+
+/**
+ * @brief 在子进程中测试一个文件（self --run-one <file>），返回它的全部输出
+ * @details 阶段统计的计数器是进程级的（第 12 步检查计数），每个测试放在子进程中互不干扰；
+ *   子进程崩溃或被信号终止也只影响这一个测试，输出补上 FAIL 行
+ */
+static std::string runIsolated(const std::string &self, const std::string &file, bool verbose,
+                               bool &passed) {
+    std::string cmd = shellQuote(self) + " --run-one " + shellQuote(file) +
+                      (verbose ? " --verbose" : "") + " 2>&1";
+    std::string log;
+    passed = false;
+    FILE *pipe = popen(cmd.c_str(), "r");
+    if (!pipe)
+        return "Testing: " + fs::path(file).filename().string() + " ... FAIL (cannot start)\n";
+    char buf[4096];
+    for (size_t n; (n = std::fread(buf, 1, sizeof(buf), pipe)) > 0;)
+        log.append(buf, n);
+    int status = pclose(pipe);
+    passed = status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (!passed && (log.empty() || log.back() != '\n')) {
+        log += WIFSIGNALED(status) ? "FAIL (killed by signal " + std::to_string(WTERMSIG(status)) +
+                                         ")\n"
+                                   : std::string("FAIL (test process exited abnormally)\n");
+    }
+    return log;
+}
+
+/**
+ * @brief 用 jobs 个工作线程并行测试全部文件，返回通过的个数
+ * @details 每个工作线程一次驱动一个子进程，同时在途的测试数由线程池大小限定；子进程的输出
+ *   先收进各自的缓冲区，主线程按文件顺序等待并依次输出，结果与串行运行逐字节相同
+ */
+static int runParallel(const std::string &self, const std::vector<std::string> &files,
+                       bool verbose, unsigned jobs) {
+    struct Slot {
+        std::string log;
+        bool passed = false;
+        bool done = false;
+    };
+    std::vector<Slot> slots(files.size());
+    std::mutex mu;
+    std::condition_variable cv;
+    int passed = 0;
+
+    toyc::ThreadPool pool(jobs);
+    for (size_t i = 0; i < files.size(); ++i) {
+        pool.submit([&, i] {
+            bool ok = false;
+            std::string log = runIsolated(self, files[i], verbose, ok);
+            {
+                std::lock_guard lock(mu);
+                slots[i].log = std::move(log);
+                slots[i].passed = ok;
+                slots[i].done = true;
+            }
+            cv.notify_all();
+        });
+    }
+    for (Slot &slot : slots) {
+        std::unique_lock lock(mu);
+        cv.wait(lock, [&] { return slot.done; });
+        std::cout << slot.log << std::flush;
+        passed += slot.passed;
+    }
+    return passed;
+}
+
+// parseJobs：解析 -j 参数（0 表示使用全部硬件线程，格式错误时返回 nullopt）
+static std::optional<unsigned> parseJobs(const char *arg) {
+    char *end = nullptr;
+    long n = std::strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || n < 0)
+        return std::nullopt;
+    return n == 0 ? toyc::ThreadPool::hardwareThreads() : static_cast<unsigned>(n);
+}
+
 int main(int argc, char *argv[]) {
     // 解析命令行参数
     bool verbose = false;
+    unsigned jobs = 1;
     std::string testDir = "examples/compiler_inputs";
+    std::string single; // --run-one：只测试这一个文件，不输出标题与汇总（-j 的子进程）
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
-        if (arg == "-v" || arg == "--verbose")
+        if (arg == "-v" || arg == "--verbose") {
             verbose = true;
-        else
+        } else if (arg == "--run-one" && i + 1 < argc) {
+            single = argv[++i];
+        } else if (arg == "-j" || arg.compare(0, 2, "-j") == 0) {
+            const char *value = arg == "-j" ? (i + 1 < argc ? argv[++i] : "") : argv[i] + 2;
+            std::optional<unsigned> n = parseJobs(value);
+            if (!n) {
+                std::cerr << "Invalid job count '" << value << "'\n";
+                return 1;
+            }
+            jobs = *n;
+        } else {
             testDir = arg;
+        }
     }
+    if (!single.empty())
+        return testFile(single, verbose) ? 0 : 1;
 
     if (!fs::exists(testDir)) {
         std::cerr << "Test directory not found: " << testDir << "\n";
@@ -131,12 +2161,18 @@ int main(int argc, char *argv[]) {
     }
     std::sort(files.begin(), files.end());
 
-    for (auto &file : files) {
-        total++;
-        if (testFile(file, verbose))
-            passed++;
+    total = static_cast<int>(files.size());
+    if (jobs > 1 && files.size() > 1) {
+        passed = runParallel(argv[0], files, verbose, jobs);
+    } else {
+        for (auto &file : files) {
+            if (testFile(file, verbose))
+                passed++;
+        }
     }
 
+    const bool programsPassed = testPrograms();
+
     std::cout << "\n=== Results: " << passed << "/" << total << " passed ===\n";
-    return (passed == total) ? 0 : 1;
+    return (passed == total && programsPassed) ? 0 : 1;
 }
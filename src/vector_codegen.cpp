@@ -0,0 +1,111 @@
+#include "riscv_codegen.h"
+#include "statistics.h"
+#include <stdexcept>
+
+namespace toyc {
+
+using namespace ir;
+using mir::MachineInstr;
+using mir::MOpcode;
+
+namespace {
+
+constexpr int kZero = 0, kT0 = 5, kT1 = 6, kA0 = 10;
+
+// vectorOpcode：标量二元运算 → 对应的 .vv 向量指令
+MOpcode vectorOpcode(Opcode op) {
+    switch (op) {
+    case Opcode::Add:
+        return MOpcode::VADD_VV;
+    case Opcode::Sub:
+        return MOpcode::VSUB_VV;
+    case Opcode::Mul:
+        return MOpcode::VMUL_VV;
+    case Opcode::SDiv:
+        return MOpcode::VDIV_VV;
+    case Opcode::SRem:
+        return MOpcode::VREM_VV;
+    default:
+        throw std::logic_error("generateVectorKernel: unsupported operation");
+    }
+}
+
+} // namespace
+
+/**
+ * @brief 生成向量内核的机器代码
+ * @details 内核 @k(cnt, p1, ..., pm) 是叶函数，只用 a0-a7、t0 / t1 与向量寄存器，不需要栈帧，
+ *   也不经过寄存器分配：a0 为剩余迭代次数（AVL），t0 为每段的 vl，t1 装入广播用的常量；
+ *   向量寄存器按 allocatableVectorRegs 依次分给序号 j（vid.v 起步，每段加 vl）、累加器、
+ *   归约临时值，其余为广播值与各运算的结果，最终运算直接写回累加器
+ *     entry: vsetvli t0, zero（VLMAX）；vid.v；累加器清零；广播形参与常量；cnt 为 0 时到 exit
+ *     loop:  vsetvli t0, a0（tu：最后一段之外的尾部元素保留已有的部分和）；各运算；
+ *            序号加 vl；a0 -= vl；a0 != 0 时继续
+ *     exit:  vsetvli t0, zero；vredsum.vs 把累加器各元素归约到元素 0，vmv.x.s 取到 a0 后返回
+ */
+mir::MachineFunction generateVectorKernel(const Function &func, const RegInfo &regInfo) {
+    stats::ScopedTimer timer(stats::Phase::InstSelect);
+    const VectorKernel &kernel = *func.vectorKernel;
+    const std::vector<int> &vregs = regInfo.allocatableVectorRegs;
+    const int index = vregs[0], acc = vregs[1], scratch = vregs[2];
+    size_t next = 3;
+    if (kernel.values.size() + next > vregs.size())
+        throw std::logic_error("generateVectorKernel: too many vector values in " + func.name);
+
+    mir::MachineFunction MF;
+    MF.name = func.name;
+    MF.savesReturnAddress = false;
+    MF.usesVector = true;
+    for (const char *label : {"", "_vec_loop", "_vec_exit"}) {
+        MF.blocks.emplace_back();
+        MF.blocks.back().label = "." + func.name + label;
+    }
+    auto &entry = MF.blocks[0].insts, &loop = MF.blocks[1].insts, &exit = MF.blocks[2].insts;
+    const int vlmax = mir::vtypeE32M1(true), tail = mir::vtypeE32M1(false);
+
+    // 各值所在的向量寄存器：广播在 entry 中完成，运算在 loop 中按顺序计算
+    std::vector<int> reg(kernel.values.size(), -1);
+    entry.push_back(MachineInstr::vsetvli(kT0, kZero, vlmax));
+    entry.push_back(MachineInstr::rr(MOpcode::VID_V, index, -1));
+    entry.push_back(MachineInstr::rr(MOpcode::VMV_V_X, acc, kZero));
+    loop.push_back(MachineInstr::vsetvli(kT0, kA0, tail));
+    for (size_t i = 0; i < kernel.values.size(); ++i) {
+        const VectorKernel::Value &v = kernel.values[i];
+        switch (v.kind) {
+        case VectorKernel::Value::Kind::Param:
+            reg[i] = vregs[next++];
+            entry.push_back(MachineInstr::rr(MOpcode::VMV_V_X, reg[i], kA0 + v.imm));
+            break;
+        case VectorKernel::Value::Kind::Const:
+            reg[i] = vregs[next++];
+            if (v.imm != 0)
+                entry.push_back(MachineInstr::li(kT1, v.imm));
+            entry.push_back(MachineInstr::rr(MOpcode::VMV_V_X, reg[i], v.imm != 0 ? kT1 : kZero));
+            break;
+        case VectorKernel::Value::Kind::Index:
+            reg[i] = index;
+            break;
+        case VectorKernel::Value::Kind::Acc:
+            reg[i] = acc;
+            break;
+        case VectorKernel::Value::Kind::Op:
+            reg[i] = static_cast<int>(i) == kernel.result ? acc : vregs[next++];
+            loop.push_back(
+                MachineInstr::rrr(vectorOpcode(v.opcode), reg[i], reg[v.lhs], reg[v.rhs]));
+            break;
+        }
+    }
+    entry.push_back(MachineInstr::branch(MOpcode::BEQ, kA0, kZero, 2));
+    loop.push_back(MachineInstr::rrr(MOpcode::VADD_VX, index, index, kT0));
+    loop.push_back(MachineInstr::rrr(MOpcode::SUB, kA0, kA0, kT0));
+    loop.push_back(MachineInstr::bnez(kA0, 1));
+
+    exit.push_back(MachineInstr::vsetvli(kT0, kZero, vlmax));
+    exit.push_back(MachineInstr::rr(MOpcode::VMV_S_X, scratch, kZero));
+    exit.push_back(MachineInstr::rrr(MOpcode::VREDSUM_VS, scratch, acc, scratch));
+    exit.push_back(MachineInstr::rr(MOpcode::VMV_X_S, kA0, scratch));
+    exit.push_back(MachineInstr::ret());
+    return MF;
+}
+
+} // namespace toyc